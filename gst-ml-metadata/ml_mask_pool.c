@@ -0,0 +1,395 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "ml_mask_pool.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+#ifdef HAVE_LINUX_MSM_ION_H
+#include <linux/ion.h>
+#include <linux/msm_ion.h>
+#endif
+
+#define GST_IS_MEMFD_MEMORY_TYPE(type) \
+    (type == g_quark_from_static_string (GST_ML_MASK_POOL_TYPE_MEMFD))
+
+#define GST_IS_ION_MEMORY_TYPE(type) \
+    (type == g_quark_from_static_string (GST_ML_MASK_POOL_TYPE_ION))
+
+#define DEFAULT_ION_ALIGNMENT 4096
+
+GST_DEBUG_CATEGORY_STATIC (gst_ml_mask_pool_debug);
+#define GST_CAT_DEFAULT gst_ml_mask_pool_debug
+
+struct _GstMLMaskPoolPrivate
+{
+  guint size;
+
+  GstAllocator *allocator;
+  GQuark memtype;
+
+  gint devicefd;
+
+  // Map of data FDs and ION handles in case legacy ION ABI is used.
+  GHashTable *datamap;
+};
+
+#define gst_ml_mask_pool_parent_class parent_class
+G_DEFINE_TYPE_WITH_PRIVATE (GstMLMaskPool, gst_ml_mask_pool,
+    GST_TYPE_BUFFER_POOL);
+
+static GstMemory *
+memfd_alloc (GstMLMaskPool * mpool)
+{
+  GstMLMaskPoolPrivate *priv = mpool->priv;
+  gint fd = -1;
+
+#ifdef __NR_memfd_create
+  fd = syscall (__NR_memfd_create, "ml-mask", 0);
+#endif
+  if (fd < 0) {
+    GST_ERROR_OBJECT (mpool, "Failed to create memfd!");
+    return NULL;
+  }
+
+  if (ftruncate (fd, priv->size) != 0) {
+    GST_ERROR_OBJECT (mpool, "Failed to resize memfd %d to %u bytes!",
+        fd, priv->size);
+    close (fd);
+    return NULL;
+  }
+
+  GST_DEBUG_OBJECT (mpool, "Allocated memfd memory FD %d", fd);
+
+  // The FD allocator takes ownership and closes the FD with the memory.
+  return gst_fd_allocator_alloc (priv->allocator, fd, priv->size,
+      GST_FD_MEMORY_FLAG_NONE);
+}
+
+static gboolean
+open_ion_device (GstMLMaskPool * mpool)
+{
+#ifdef HAVE_LINUX_MSM_ION_H
+  GstMLMaskPoolPrivate *priv = mpool->priv;
+
+  priv->devicefd = open ("/dev/ion", O_RDWR);
+  if (priv->devicefd < 0) {
+    GST_ERROR_OBJECT (mpool, "Failed to open ION device FD!");
+    return FALSE;
+  }
+
+#ifndef TARGET_ION_ABI_VERSION
+  priv->datamap = g_hash_table_new (NULL, NULL);
+#endif
+
+  GST_INFO_OBJECT (mpool, "Opened ION device FD %d", priv->devicefd);
+  return TRUE;
+#else
+  GST_ERROR_OBJECT (mpool, "ION memory is not supported!");
+  return FALSE;
+#endif
+}
+
+static void
+close_ion_device (GstMLMaskPool * mpool)
+{
+  GstMLMaskPoolPrivate *priv = mpool->priv;
+
+  if (priv->devicefd >= 0) {
+    GST_INFO_OBJECT (mpool, "Closing ION device FD %d", priv->devicefd);
+    close (priv->devicefd);
+  }
+
+  if (priv->datamap != NULL)
+    g_hash_table_destroy (priv->datamap);
+}
+
+static GstMemory *
+ion_device_alloc (GstMLMaskPool * mpool)
+{
+#ifdef HAVE_LINUX_MSM_ION_H
+  GstMLMaskPoolPrivate *priv = mpool->priv;
+  gint result = 0, fd = -1;
+
+#ifndef TARGET_ION_ABI_VERSION
+  struct ion_fd_data fd_data;
+#endif
+  struct ion_allocation_data alloc_data;
+
+  alloc_data.len = priv->size;
+#ifndef TARGET_ION_ABI_VERSION
+  alloc_data.align = DEFAULT_ION_ALIGNMENT;
+#endif
+  alloc_data.heap_id_mask = ION_HEAP(ION_SYSTEM_HEAP_ID);
+  alloc_data.flags = 0;
+
+  result = ioctl (priv->devicefd, ION_IOC_ALLOC, &alloc_data);
+  if (result != 0) {
+    GST_ERROR_OBJECT (mpool, "Failed to allocate ION memory!");
+    return NULL;
+  }
+
+#ifndef TARGET_ION_ABI_VERSION
+  fd_data.handle = alloc_data.handle;
+
+  result = ioctl (priv->devicefd, ION_IOC_MAP, &fd_data);
+  if (result != 0) {
+    GST_ERROR_OBJECT (mpool, "Failed to map memory to FD!");
+    ioctl (priv->devicefd, ION_IOC_FREE, &alloc_data.handle);
+    return NULL;
+  }
+
+  fd = fd_data.fd;
+
+  g_hash_table_insert (priv->datamap, GINT_TO_POINTER (fd),
+      GINT_TO_POINTER (alloc_data.handle));
+#else
+  fd = alloc_data.fd;
+#endif
+
+  GST_DEBUG_OBJECT (mpool, "Allocated ION memory FD %d", fd);
+
+  // Wrap the allocated FD in FD backed allocator.
+  return gst_fd_allocator_alloc (priv->allocator, fd, priv->size,
+      GST_FD_MEMORY_FLAG_DONT_CLOSE);
+#else
+  GST_ERROR_OBJECT (mpool, "ION memory is not supported!");
+  return NULL;
+#endif
+}
+
+static void
+ion_device_free (GstMLMaskPool * mpool, gint fd)
+{
+  GST_DEBUG_OBJECT (mpool, "Closing ION memory FD %d", fd);
+
+#if defined(HAVE_LINUX_MSM_ION_H) && !defined(TARGET_ION_ABI_VERSION)
+  GstMLMaskPoolPrivate *priv = mpool->priv;
+  ion_user_handle_t handle = GPOINTER_TO_INT (
+      g_hash_table_lookup (priv->datamap, GINT_TO_POINTER (fd)));
+
+  if (ioctl (priv->devicefd, ION_IOC_FREE, &handle) < 0) {
+    GST_ERROR_OBJECT (mpool, "Failed to free handle for memory FD %d!", fd);
+  }
+
+  g_hash_table_remove (priv->datamap, GINT_TO_POINTER (fd));
+#endif
+
+  close (fd);
+}
+
+static gboolean
+ml_mask_pool_set_config (GstBufferPool * pool, GstStructure * config)
+{
+  GstMLMaskPool *mpool = GST_ML_MASK_POOL_CAST (pool);
+  GstMLMaskPoolPrivate *priv = mpool->priv;
+
+  GstCaps *caps = NULL;
+  guint size, minbuffers, maxbuffers;
+  GstAllocator *allocator = NULL;
+  GstAllocationParams params;
+
+  if (!gst_buffer_pool_config_get_params (config, &caps, &size,
+      &minbuffers, &maxbuffers)) {
+    GST_ERROR_OBJECT (mpool, "Invalid configuration!");
+    return FALSE;
+  } else if (size == 0) {
+    GST_ERROR_OBJECT (mpool, "Mask size missing from configuration");
+    return FALSE;
+  }
+
+  gst_buffer_pool_config_get_allocator (config, &allocator, &params);
+
+  if (allocator != NULL && !GST_IS_FD_ALLOCATOR (allocator)) {
+    GST_ERROR_OBJECT (mpool, "Allocator %p is not FD backed!", allocator);
+    return FALSE;
+  }
+
+  // Remove cached allocator.
+  if (priv->allocator)
+    gst_object_unref (priv->allocator);
+
+  priv->allocator = (allocator != NULL) ?
+      gst_object_ref (allocator) : gst_fd_allocator_new ();
+  priv->size = size;
+
+  GST_DEBUG_OBJECT (mpool, "Mask size %u, buffers %u - %u", size,
+      minbuffers, maxbuffers);
+
+  return GST_BUFFER_POOL_CLASS (parent_class)->set_config (pool, config);
+}
+
+static GstFlowReturn
+ml_mask_pool_alloc (GstBufferPool * pool, GstBuffer ** buffer,
+    GstBufferPoolAcquireParams * params)
+{
+  GstMLMaskPool *mpool = GST_ML_MASK_POOL_CAST (pool);
+  GstMLMaskPoolPrivate *priv = mpool->priv;
+  GstMemory *memory = NULL;
+  GstBuffer *newbuffer = NULL;
+
+  if (GST_IS_MEMFD_MEMORY_TYPE (priv->memtype)) {
+    memory = memfd_alloc (mpool);
+  } else if (GST_IS_ION_MEMORY_TYPE (priv->memtype)) {
+    memory = ion_device_alloc (mpool);
+  }
+
+  if (NULL == memory) {
+    GST_WARNING_OBJECT (pool, "Failed to allocate memory!");
+    return GST_FLOW_ERROR;
+  }
+
+  // Create a GstBuffer and append the FD backed memory to it.
+  newbuffer = gst_buffer_new ();
+  gst_buffer_append_memory (newbuffer, memory);
+
+  *buffer = newbuffer;
+  return GST_FLOW_OK;
+}
+
+static void
+ml_mask_pool_free (GstBufferPool * pool, GstBuffer * buffer)
+{
+  GstMLMaskPool *mpool = GST_ML_MASK_POOL_CAST (pool);
+  gint fd = gst_fd_memory_get_fd (gst_buffer_peek_memory (buffer, 0));
+
+  if (GST_IS_ION_MEMORY_TYPE (mpool->priv->memtype)) {
+    ion_device_free (mpool, fd);
+  }
+  gst_buffer_unref (buffer);
+}
+
+static void
+gst_ml_mask_pool_finalize (GObject * object)
+{
+  GstMLMaskPool *mpool = GST_ML_MASK_POOL_CAST (object);
+  GstMLMaskPoolPrivate *priv = mpool->priv;
+
+  GST_INFO_OBJECT (mpool, "Finalize mask buffer pool %p", mpool);
+
+  if (priv->allocator) {
+    GST_INFO_OBJECT (mpool, "Free buffer pool allocator %p", priv->allocator);
+    gst_object_unref (priv->allocator);
+  }
+
+  if (GST_IS_ION_MEMORY_TYPE (priv->memtype)) {
+    close_ion_device (mpool);
+  }
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gst_ml_mask_pool_class_init (GstMLMaskPoolClass * klass)
+{
+  GObjectClass *object = G_OBJECT_CLASS (klass);
+  GstBufferPoolClass *pool = GST_BUFFER_POOL_CLASS (klass);
+
+  object->finalize = gst_ml_mask_pool_finalize;
+
+  pool->set_config = ml_mask_pool_set_config;
+  pool->alloc_buffer = ml_mask_pool_alloc;
+  pool->free_buffer = ml_mask_pool_free;
+
+  GST_DEBUG_CATEGORY_INIT (gst_ml_mask_pool_debug,
+      "ml-mask-pool", 0, "ml-mask-pool object");
+}
+
+static void
+gst_ml_mask_pool_init (GstMLMaskPool * mpool)
+{
+  mpool->priv = gst_ml_mask_pool_get_instance_private (mpool);
+  mpool->priv->devicefd = -1;
+  mpool->priv->datamap = NULL;
+}
+
+GstBufferPool *
+gst_ml_mask_pool_new (const gchar * type)
+{
+  GstMLMaskPool *mpool;
+  gboolean success = FALSE;
+
+  g_return_val_if_fail (type != NULL, NULL);
+
+  mpool = g_object_new (GST_TYPE_ML_MASK_POOL, NULL);
+
+  mpool->priv->memtype = g_quark_from_static_string (type);
+
+  if (GST_IS_MEMFD_MEMORY_TYPE (mpool->priv->memtype)) {
+    GST_INFO_OBJECT (mpool, "Using memfd memory");
+    success = TRUE;
+  } else if (GST_IS_ION_MEMORY_TYPE (mpool->priv->memtype)) {
+    GST_INFO_OBJECT (mpool, "Using ION memory");
+    success = open_ion_device (mpool);
+  }
+
+  if (!success) {
+    gst_object_unref (mpool);
+    return NULL;
+  }
+
+  GST_INFO_OBJECT (mpool, "New mask buffer pool %p", mpool);
+  return GST_BUFFER_POOL_CAST (mpool);
+}
+
+GstBufferPool *
+gst_ml_mask_pool_new_configured (const gchar * type, guint size,
+    guint min_buffers, guint max_buffers)
+{
+  GstBufferPool *pool = NULL;
+  GstStructure *config = NULL;
+
+  g_return_val_if_fail (size != 0, NULL);
+
+  pool = gst_ml_mask_pool_new (type);
+  if (NULL == pool) {
+    return NULL;
+  }
+
+  config = gst_buffer_pool_get_config (pool);
+  gst_buffer_pool_config_set_params (config, NULL, size, min_buffers,
+      max_buffers);
+
+  if (!gst_buffer_pool_set_config (pool, config)) {
+    GST_ERROR_OBJECT (pool, "Failed to set pool configuration!");
+    gst_object_unref (pool);
+    return NULL;
+  }
+
+  if (!gst_buffer_pool_set_active (pool, TRUE)) {
+    GST_ERROR_OBJECT (pool, "Failed to activate pool!");
+    gst_object_unref (pool);
+    return NULL;
+  }
+  return pool;
+}
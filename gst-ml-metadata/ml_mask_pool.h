@@ -0,0 +1,103 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef __GST_ML_MASK_POOL_H__
+#define __GST_ML_MASK_POOL_H__
+
+#include <gst/gst.h>
+#include <gst/allocators/allocators.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_ML_MASK_POOL \
+  (gst_ml_mask_pool_get_type ())
+#define GST_ML_MASK_POOL(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST ((obj), GST_TYPE_ML_MASK_POOL, GstMLMaskPool))
+#define GST_ML_MASK_POOL_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST ((klass), GST_TYPE_ML_MASK_POOL, \
+      GstMLMaskPoolClass))
+#define GST_IS_ML_MASK_POOL(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GST_TYPE_ML_MASK_POOL))
+#define GST_IS_ML_MASK_POOL_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE ((klass), GST_TYPE_ML_MASK_POOL))
+#define GST_ML_MASK_POOL_CAST(obj) ((GstMLMaskPool*)(obj))
+
+typedef struct _GstMLMaskPool GstMLMaskPool;
+typedef struct _GstMLMaskPoolClass GstMLMaskPoolClass;
+typedef struct _GstMLMaskPoolPrivate GstMLMaskPoolPrivate;
+
+#define GST_ML_MASK_POOL_TYPE_MEMFD "GstBufferPoolTypeMemfdMemory"
+#define GST_ML_MASK_POOL_TYPE_ION   "GstBufferPoolTypeIonMemory"
+
+struct _GstMLMaskPool
+{
+  GstBufferPool parent;
+
+  GstMLMaskPoolPrivate *priv;
+};
+
+struct _GstMLMaskPoolClass
+{
+  GstBufferPoolClass parent;
+};
+
+GST_EXPORT
+GType gst_ml_mask_pool_get_type (void);
+
+/**
+ * gst_ml_mask_pool_new:
+ * @type: GST_ML_MASK_POOL_TYPE_MEMFD or GST_ML_MASK_POOL_TYPE_ION
+ *
+ * Creates a buffer pool of FD backed memory for segmentation masks. Each
+ * buffer holds a single #GstFdMemory which consumers can import by FD.
+ * The pool still has to be configured and activated by the caller.
+ *
+ */
+GST_EXPORT
+GstBufferPool * gst_ml_mask_pool_new (const gchar * type);
+
+/**
+ * gst_ml_mask_pool_new_configured:
+ * @type: GST_ML_MASK_POOL_TYPE_MEMFD or GST_ML_MASK_POOL_TYPE_ION
+ * @size: size of a single mask in bytes
+ * @min_buffers: number of masks allocated upfront
+ * @max_buffers: maximum number of masks, 0 for unlimited
+ *
+ * Convenience wrapper which creates, configures and activates the pool.
+ * Returns NULL on failure.
+ *
+ */
+GST_EXPORT
+GstBufferPool * gst_ml_mask_pool_new_configured (const gchar * type,
+    guint size, guint min_buffers, guint max_buffers);
+
+G_END_DECLS
+
+#endif /* __GST_ML_MASK_POOL_H__ */
@@ -29,6 +29,11 @@
 
 #include "ml_meta.h"
 
+#include <gst/allocators/allocators.h>
+
+#include <stdlib.h>
+#include <string.h>
+
 #ifndef GST_DISABLE_GST_DEBUG
 #define GST_CAT_DEFAULT ensure_debug_category()
 static GstDebugCategory *
@@ -50,6 +55,17 @@ ensure_debug_category (void)
 #define ensure_debug_category() /* NOOP */
 #endif /* GST_DISABLE_GST_DEBUG */
 
+static gboolean gst_ml_detection_transform (GstBuffer * dest, GstMeta * meta,
+    GstBuffer * src, GQuark type, gpointer data);
+static gboolean gst_ml_segmentation_transform (GstBuffer * dest,
+    GstMeta * meta, GstBuffer * src, GQuark type, gpointer data);
+static gboolean gst_ml_classification_transform (GstBuffer * dest,
+    GstMeta * meta, GstBuffer * src, GQuark type, gpointer data);
+static gboolean gst_ml_posenet_transform (GstBuffer * dest, GstMeta * meta,
+    GstBuffer * src, GQuark type, gpointer data);
+static gboolean gst_ml_detection_batch_transform (GstBuffer * dest,
+    GstMeta * meta, GstBuffer * src, GQuark type, gpointer data);
+
 static gboolean
 gst_ml_detection_init (GstMeta * meta, gpointer params, GstBuffer * buffer)
 {
@@ -59,11 +75,19 @@ gst_ml_detection_init (GstMeta * meta, gpointer params, GstBuffer * buffer)
   return TRUE;
 }
 
+static void
+gst_ml_classification_result_free (gpointer data)
+{
+  GstMLClassificationResult *result = (GstMLClassificationResult *) data;
+  gst_ml_classification_result_clear (result);
+  free(result);
+}
+
 static void
 gst_ml_detection_free (GstMeta *meta, GstBuffer *buffer)
 {
   GstMLDetectionMeta *bb_meta = (GstMLDetectionMeta *) meta;
-  g_slist_free_full(bb_meta->box_info, free);
+  g_slist_free_full(bb_meta->box_info, gst_ml_classification_result_free);
   GST_DEBUG ("free detection meta ts: %llu ", buffer->pts);
 }
 
@@ -71,7 +95,8 @@ GType
 gst_ml_detection_get_type (void)
 {
   static volatile GType type = 0;
-  static const gchar *tags[] = { NULL };
+  static const gchar *tags[] = { GST_META_TAG_VIDEO_STR,
+      GST_META_TAG_VIDEO_ORIENTATION_STR, GST_META_TAG_VIDEO_SIZE_STR, NULL };
 
   if (g_once_init_enter (&type)) {
     GType _type = gst_meta_api_type_register ("GstMLDetectionMetaAPI", tags);
@@ -91,7 +116,7 @@ gst_ml_detection_get_info (void)
             "GstMLDetectionMeta", (gsize) sizeof (GstMLDetectionMeta),
             (GstMetaInitFunction) gst_ml_detection_init,
             (GstMetaFreeFunction) gst_ml_detection_free,
-            (GstMetaTransformFunction) NULL);
+            (GstMetaTransformFunction) gst_ml_detection_transform);
     g_once_init_leave ((GstMetaInfo **) & ml_meta_info, (GstMetaInfo *) meta);
   }
   return ml_meta_info;
@@ -107,16 +132,34 @@ gst_ml_segmentation_init (GstMeta * meta, gpointer params, GstBuffer * buffer)
   img_meta->img_size = 0;
   img_meta->img_format = GST_VIDEO_FORMAT_UNKNOWN;
   img_meta->img_stride = 0;
+  img_meta->palette = NULL;
+  img_meta->n_colors = 0;
+  img_meta->mask = NULL;
   return TRUE;
 }
 
+static void
+gst_ml_segmentation_release_image (GstMLSegmentationMeta * img_meta)
+{
+  if (img_meta->mask) {
+    // Unmap before unref so the buffer can go back to its pool.
+    gst_buffer_unmap (img_meta->mask, &img_meta->mask_map);
+    gst_buffer_unref (img_meta->mask);
+    img_meta->mask = NULL;
+  } else if (img_meta->img_buffer) {
+    free(img_meta->img_buffer);
+  }
+  img_meta->img_buffer = NULL;
+}
+
 static void
 gst_ml_segmentation_free (GstMeta *meta, GstBuffer *buffer)
 {
   GstMLSegmentationMeta *img_meta = (GstMLSegmentationMeta *) meta;
-  if (img_meta->img_buffer) {
-    free(img_meta->img_buffer);
-    img_meta->img_buffer = NULL;
+  gst_ml_segmentation_release_image (img_meta);
+  if (img_meta->palette) {
+    free(img_meta->palette);
+    img_meta->palette = NULL;
   }
   GST_DEBUG ("free segmentation meta ts: %llu ", buffer->pts);
 }
@@ -125,7 +168,8 @@ GType
 gst_ml_segmentation_get_type (void)
 {
   static volatile GType type = 0;
-  static const gchar *tags[] = { NULL };
+  static const gchar *tags[] = { GST_META_TAG_VIDEO_STR,
+      GST_META_TAG_VIDEO_ORIENTATION_STR, GST_META_TAG_VIDEO_SIZE_STR, NULL };
 
   if (g_once_init_enter (&type)) {
     GType _type = gst_meta_api_type_register ("GstMLSegmentationMetaAPI", tags);
@@ -145,7 +189,7 @@ gst_ml_segmentation_get_info (void)
             "GstMLSegmentationMeta", (gsize) sizeof (GstMLSegmentationMeta),
             (GstMetaInitFunction) gst_ml_segmentation_init,
             (GstMetaFreeFunction) gst_ml_segmentation_free,
-            (GstMetaTransformFunction) NULL);
+            (GstMetaTransformFunction) gst_ml_segmentation_transform);
     g_once_init_leave ((GstMetaInfo **) & ml_meta_info, (GstMetaInfo *) meta);
   }
   return ml_meta_info;
@@ -157,6 +201,8 @@ gst_ml_classification_init (GstMeta * meta, gpointer params, GstBuffer * buffer)
   GstMLClassificationMeta *l_meta = (GstMLClassificationMeta *) meta;
   l_meta->result.name = NULL;
   l_meta->result.confidence = 0.0;
+  l_meta->result.class_id = 0;
+  l_meta->result.labels = NULL;
   return TRUE;
 }
 
@@ -164,10 +210,7 @@ static void
 gst_ml_classification_free (GstMeta *meta, GstBuffer *buffer)
 {
   GstMLClassificationMeta *l_meta = (GstMLClassificationMeta *) meta;
-  if (l_meta->result.name) {
-    free(l_meta->result.name);
-    l_meta->result.name = NULL;
-  }
+  gst_ml_classification_result_clear (&l_meta->result);
   GST_DEBUG ("free classification meta ts: %llu ", buffer->pts);
 }
 
@@ -196,7 +239,7 @@ gst_ml_classification_get_info (void)
             "GstMLClassificationMeta", (gsize) sizeof (GstMLClassificationMeta),
             (GstMetaInitFunction) gst_ml_classification_init,
             (GstMetaFreeFunction) gst_ml_classification_free,
-            (GstMetaTransformFunction) NULL);
+            (GstMetaTransformFunction) gst_ml_classification_transform);
     g_once_init_leave ((GstMetaInfo **) & ml_meta_info, (GstMetaInfo *) meta);
   }
   return ml_meta_info;
@@ -215,7 +258,8 @@ GType
 gst_ml_posenet_get_type (void)
 {
   static volatile GType type = 0;
-  static const gchar *tags[] = { NULL };
+  static const gchar *tags[] = { GST_META_TAG_VIDEO_STR,
+      GST_META_TAG_VIDEO_ORIENTATION_STR, GST_META_TAG_VIDEO_SIZE_STR, NULL };
 
   if (g_once_init_enter (&type)) {
     GType _type =
@@ -236,7 +280,167 @@ gst_ml_posenet_get_info (void)
             "GstMLPoseNetMeta", (gsize) sizeof (GstMLPoseNetMeta),
             (GstMetaInitFunction) gst_ml_posenet_init,
             (GstMetaFreeFunction) NULL,
-            (GstMetaTransformFunction) NULL);
+            (GstMetaTransformFunction) gst_ml_posenet_transform);
+    g_once_init_leave ((GstMetaInfo **) & ml_meta_info, (GstMetaInfo *) meta);
+  }
+  return ml_meta_info;
+}
+
+/* Detection batch storage pool. Blocks are bucketed by power of two
+ * capacity and a few of each size are kept around, so steady state
+ * streams reuse the same blocks instead of hitting the heap per frame. */
+#define GST_ML_BATCH_MIN_CAPACITY   16
+#define GST_ML_BATCH_POOL_BUCKETS   8
+#define GST_ML_BATCH_POOL_DEPTH     8
+#define GST_ML_BATCH_BOX_SIZE       (6 * sizeof (guint) + sizeof (gfloat))
+
+typedef struct _GstMLDetectionBatchParams GstMLDetectionBatchParams;
+
+struct _GstMLDetectionBatchParams {
+  guint           capacity;
+  gboolean        track_ids;
+  GstMLLabelTable *labels;
+};
+
+static GMutex batch_pool_lock;
+static gpointer batch_pool[GST_ML_BATCH_POOL_BUCKETS];
+static guint batch_pool_depth[GST_ML_BATCH_POOL_BUCKETS];
+
+static guint
+gst_ml_batch_pool_bucket (guint capacity, guint * rounded)
+{
+  guint bucket = 0;
+  guint size = GST_ML_BATCH_MIN_CAPACITY;
+
+  while (size < capacity) {
+    size <<= 1;
+    bucket++;
+  }
+  *rounded = size;
+  return bucket;
+}
+
+static gpointer
+gst_ml_batch_pool_acquire (guint capacity)
+{
+  gpointer block = NULL;
+  guint bucket = gst_ml_batch_pool_bucket (capacity, &capacity);
+
+  if (bucket < GST_ML_BATCH_POOL_BUCKETS) {
+    g_mutex_lock (&batch_pool_lock);
+    block = batch_pool[bucket];
+    if (block) {
+      batch_pool[bucket] = *(gpointer *) block;
+      batch_pool_depth[bucket]--;
+    }
+    g_mutex_unlock (&batch_pool_lock);
+  }
+
+  if (!block) {
+    block = malloc (capacity * GST_ML_BATCH_BOX_SIZE);
+  }
+  return block;
+}
+
+static void
+gst_ml_batch_pool_release (gpointer block, guint capacity)
+{
+  guint bucket = gst_ml_batch_pool_bucket (capacity, &capacity);
+
+  if (bucket < GST_ML_BATCH_POOL_BUCKETS) {
+    g_mutex_lock (&batch_pool_lock);
+    if (batch_pool_depth[bucket] < GST_ML_BATCH_POOL_DEPTH) {
+      *(gpointer *) block = batch_pool[bucket];
+      batch_pool[bucket] = block;
+      batch_pool_depth[bucket]++;
+      block = NULL;
+    }
+    g_mutex_unlock (&batch_pool_lock);
+  }
+
+  if (block) {
+    free (block);
+  }
+}
+
+static gboolean
+gst_ml_detection_batch_init (GstMeta * meta, gpointer params,
+    GstBuffer * buffer)
+{
+  GstMLDetectionBatchMeta *b_meta = (GstMLDetectionBatchMeta *) meta;
+  GstMLDetectionBatchParams *b_params = (GstMLDetectionBatchParams *) params;
+  guint capacity = 0;
+
+  memset ((guint8 *) b_meta + sizeof (GstMeta), 0,
+      sizeof (GstMLDetectionBatchMeta) - sizeof (GstMeta));
+
+  if (!b_params) {
+    return TRUE;
+  }
+
+  gst_ml_batch_pool_bucket (MAX (b_params->capacity, 1), &capacity);
+  b_meta->block = gst_ml_batch_pool_acquire (capacity);
+  if (!b_meta->block) {
+    return FALSE;
+  }
+
+  b_meta->capacity = capacity;
+  b_meta->x = (guint *) b_meta->block;
+  b_meta->y = b_meta->x + capacity;
+  b_meta->width = b_meta->y + capacity;
+  b_meta->height = b_meta->width + capacity;
+  b_meta->class_id = b_meta->height + capacity;
+  b_meta->track_id = b_params->track_ids ? b_meta->class_id + capacity : NULL;
+  b_meta->confidence = (gfloat *) (b_meta->class_id + 2 * capacity);
+
+  if (b_params->labels) {
+    b_meta->labels = gst_ml_label_table_ref (b_params->labels);
+  }
+  return TRUE;
+}
+
+static void
+gst_ml_detection_batch_free (GstMeta *meta, GstBuffer *buffer)
+{
+  GstMLDetectionBatchMeta *b_meta = (GstMLDetectionBatchMeta *) meta;
+  if (b_meta->block) {
+    gst_ml_batch_pool_release (b_meta->block, b_meta->capacity);
+    b_meta->block = NULL;
+  }
+  if (b_meta->labels) {
+    gst_ml_label_table_unref (b_meta->labels);
+    b_meta->labels = NULL;
+  }
+  GST_DEBUG ("free detection batch meta ts: %llu ", buffer->pts);
+}
+
+GType
+gst_ml_detection_batch_get_type (void)
+{
+  static volatile GType type = 0;
+  static const gchar *tags[] = { GST_META_TAG_VIDEO_STR,
+      GST_META_TAG_VIDEO_ORIENTATION_STR, GST_META_TAG_VIDEO_SIZE_STR, NULL };
+
+  if (g_once_init_enter (&type)) {
+    GType _type =
+        gst_meta_api_type_register ("GstMLDetectionBatchMetaAPI", tags);
+    g_once_init_leave (&type, _type);
+  }
+  return type;
+}
+
+const GstMetaInfo *
+gst_ml_detection_batch_get_info (void)
+{
+  static const GstMetaInfo *ml_meta_info = NULL;
+
+  if (g_once_init_enter ((GstMetaInfo **) & ml_meta_info)) {
+    const GstMetaInfo *meta =
+        gst_meta_register (GST_ML_DETECTION_BATCH_API_TYPE,
+            "GstMLDetectionBatchMeta", (gsize) sizeof (GstMLDetectionBatchMeta),
+            (GstMetaInitFunction) gst_ml_detection_batch_init,
+            (GstMetaFreeFunction) gst_ml_detection_batch_free,
+            (GstMetaTransformFunction) gst_ml_detection_batch_transform);
     g_once_init_leave ((GstMetaInfo **) & ml_meta_info, (GstMetaInfo *) meta);
   }
   return ml_meta_info;
@@ -302,6 +506,86 @@ gst_buffer_get_segmentation_meta (GstBuffer * buffer)
   return meta_list;
 }
 
+gboolean
+gst_ml_segmentation_meta_set_mask (GstMLSegmentationMeta * meta,
+    GstBuffer * mask, guint size)
+{
+  GstMapFlags flags = GST_MAP_READ;
+
+  g_return_val_if_fail (meta != NULL, FALSE);
+  g_return_val_if_fail (mask != NULL, FALSE);
+
+  if (gst_buffer_get_size (mask) < size) {
+    GST_ERROR ("Mask buffer is too small: %" G_GSIZE_FORMAT " < %u",
+        gst_buffer_get_size (mask), size);
+    gst_buffer_unref (mask);
+    return FALSE;
+  }
+
+  // Masks shared with other metas are exposed read only.
+  if (gst_buffer_is_writable (mask)) {
+    gst_buffer_resize (mask, 0, size);
+    flags |= GST_MAP_WRITE;
+  }
+
+  gst_ml_segmentation_release_image (meta);
+
+  if (!gst_buffer_map (mask, &meta->mask_map, flags)) {
+    GST_ERROR ("Failed to map mask buffer %p", mask);
+    gst_buffer_unref (mask);
+    meta->img_size = 0;
+    return FALSE;
+  }
+
+  meta->mask = mask;
+  meta->img_buffer = meta->mask_map.data;
+  meta->img_size = size;
+  return TRUE;
+}
+
+gboolean
+gst_ml_segmentation_meta_alloc_mask (GstMLSegmentationMeta * meta,
+    GstBufferPool * pool, guint size)
+{
+  GstBufferPoolAcquireParams params = { 0, };
+  GstBuffer *mask = NULL;
+
+  g_return_val_if_fail (meta != NULL, FALSE);
+  g_return_val_if_fail (size != 0, FALSE);
+
+  // Never block the producer, fall back to heap memory instead.
+  params.flags = GST_BUFFER_POOL_ACQUIRE_FLAG_DONTWAIT;
+
+  if (pool && gst_buffer_pool_is_active (pool) &&
+      gst_buffer_pool_acquire_buffer (pool, &mask, &params) == GST_FLOW_OK) {
+    if (gst_buffer_get_size (mask) >= size) {
+      return gst_ml_segmentation_meta_set_mask (meta, mask, size);
+    }
+    gst_buffer_unref (mask);
+  }
+
+  gst_ml_segmentation_release_image (meta);
+
+  meta->img_buffer = calloc (1, size);
+  meta->img_size = meta->img_buffer ? size : 0;
+  return meta->img_buffer != NULL;
+}
+
+gint
+gst_ml_segmentation_meta_get_fd (GstMLSegmentationMeta * meta)
+{
+  GstMemory *memory = NULL;
+
+  g_return_val_if_fail (meta != NULL, -1);
+
+  if (!meta->mask || gst_buffer_n_memory (meta->mask) != 1) {
+    return -1;
+  }
+
+  memory = gst_buffer_peek_memory (meta->mask, 0);
+  return gst_is_fd_memory (memory) ? gst_fd_memory_get_fd (memory) : -1;
+}
+
 GstMLClassificationMeta *
 gst_buffer_add_classification_meta (GstBuffer * buffer)
 {
@@ -361,3 +645,926 @@ gst_buffer_get_posenet_meta (GstBuffer * buffer)
   }
   return meta_list;
 }
+
+GstMLLabelTable *
+gst_ml_label_table_new (const gchar * const * labels, guint n_labels)
+{
+  GstMLLabelTable *table = NULL;
+  guint i = 0;
+
+  g_return_val_if_fail (labels != NULL || n_labels == 0, NULL);
+
+  table = (GstMLLabelTable *) malloc (sizeof (GstMLLabelTable));
+  if (!table) {
+    return NULL;
+  }
+
+  table->refcount = 1;
+  table->n_labels = n_labels;
+  table->labels = (gchar **) calloc (MAX (n_labels, 1), sizeof (gchar *));
+  table->quarks = (GQuark *) calloc (MAX (n_labels, 1), sizeof (GQuark));
+  if (!table->labels || !table->quarks) {
+    free (table->labels);
+    free (table->quarks);
+    free (table);
+    return NULL;
+  }
+
+  // Interned strings live as long as the process, nothing to free later.
+  for (i = 0; i < n_labels; i++) {
+    table->quarks[i] = labels[i] ? g_quark_from_string (labels[i]) : 0;
+    table->labels[i] = (gchar *) g_quark_to_string (table->quarks[i]);
+  }
+  return table;
+}
+
+GstMLLabelTable *
+gst_ml_label_table_ref (GstMLLabelTable * table)
+{
+  g_return_val_if_fail (table != NULL, NULL);
+
+  g_atomic_int_inc (&table->refcount);
+  return table;
+}
+
+void
+gst_ml_label_table_unref (GstMLLabelTable * table)
+{
+  g_return_if_fail (table != NULL);
+
+  if (!g_atomic_int_dec_and_test (&table->refcount)) {
+    return;
+  }
+
+  free (table->labels);
+  free (table->quarks);
+  free (table);
+}
+
+const gchar *
+gst_ml_label_table_get_name (GstMLLabelTable * table, guint class_id)
+{
+  g_return_val_if_fail (table != NULL, NULL);
+
+  return (class_id < table->n_labels) ? table->labels[class_id] : NULL;
+}
+
+GQuark
+gst_ml_label_table_get_quark (GstMLLabelTable * table, guint class_id)
+{
+  g_return_val_if_fail (table != NULL, 0);
+
+  return (class_id < table->n_labels) ? table->quarks[class_id] : 0;
+}
+
+gint
+gst_ml_label_table_lookup (GstMLLabelTable * table, const gchar * name)
+{
+  GQuark quark = 0;
+  guint i = 0;
+
+  g_return_val_if_fail (table != NULL, -1);
+  g_return_val_if_fail (name != NULL, -1);
+
+  // A string which was never interned can not be in any table.
+  quark = g_quark_try_string (name);
+  if (quark == 0) {
+    return -1;
+  }
+
+  for (i = 0; i < table->n_labels; i++) {
+    if (table->quarks[i] == quark) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+GstMLClassificationResult *
+gst_ml_classification_result_new (void)
+{
+  // Zeroed, clear() takes a non NULL labels pointer as a reference.
+  return (GstMLClassificationResult *) calloc (1,
+      sizeof (GstMLClassificationResult));
+}
+
+void
+gst_ml_classification_result_set_label (GstMLClassificationResult * result,
+    GstMLLabelTable * labels, guint class_id)
+{
+  g_return_if_fail (result != NULL);
+  g_return_if_fail (labels != NULL);
+
+  gst_ml_label_table_ref (labels);
+  gst_ml_classification_result_clear (result);
+
+  result->labels = labels;
+  result->class_id = class_id;
+  result->name = (gchar *) gst_ml_label_table_get_name (labels, class_id);
+}
+
+GQuark
+gst_ml_classification_result_get_quark (GstMLClassificationResult * result)
+{
+  g_return_val_if_fail (result != NULL, 0);
+
+  if (result->labels) {
+    return gst_ml_label_table_get_quark (result->labels, result->class_id);
+  }
+  return result->name ? g_quark_from_string (result->name) : 0;
+}
+
+void
+gst_ml_classification_result_clear (GstMLClassificationResult * result)
+{
+  g_return_if_fail (result != NULL);
+
+  if (result->labels) {
+    gst_ml_label_table_unref (result->labels);
+    result->labels = NULL;
+  } else if (result->name) {
+    free (result->name);
+  }
+  result->name = NULL;
+}
+
+GstMLDetectionBatchMeta *
+gst_buffer_add_detection_batch_meta (GstBuffer * buffer, guint capacity,
+    gboolean track_ids, GstMLLabelTable * labels)
+{
+  GstMLDetectionBatchParams params;
+
+  g_return_val_if_fail (buffer != NULL, NULL);
+
+  params.capacity = capacity;
+  params.track_ids = track_ids;
+  params.labels = labels;
+
+  GstMLDetectionBatchMeta *meta =
+      (GstMLDetectionBatchMeta *) gst_buffer_add_meta (buffer,
+          GST_ML_DETECTION_BATCH_INFO, &params);
+
+  return meta;
+}
+
+GstMLDetectionBatchMeta *
+gst_buffer_get_detection_batch_meta (GstBuffer * buffer)
+{
+  g_return_val_if_fail (buffer != NULL, NULL);
+
+  return (GstMLDetectionBatchMeta *) gst_buffer_get_meta (buffer,
+      GST_ML_DETECTION_BATCH_API_TYPE);
+}
+
+gboolean
+gst_ml_detection_batch_meta_add_box (GstMLDetectionBatchMeta * meta,
+    const GstMLBoundingBox * box, gfloat confidence, guint class_id,
+    guint track_id)
+{
+  guint idx = 0;
+
+  g_return_val_if_fail (meta != NULL, FALSE);
+  g_return_val_if_fail (box != NULL, FALSE);
+
+  if (meta->n_boxes >= meta->capacity) {
+    return FALSE;
+  }
+
+  idx = meta->n_boxes++;
+  meta->x[idx] = box->x;
+  meta->y[idx] = box->y;
+  meta->width[idx] = box->width;
+  meta->height[idx] = box->height;
+  meta->confidence[idx] = confidence;
+  meta->class_id[idx] = class_id;
+  if (meta->track_id) {
+    meta->track_id[idx] = track_id;
+  }
+  return TRUE;
+}
+
+const gchar *
+gst_ml_detection_batch_meta_get_label (GstMLDetectionBatchMeta * meta,
+    guint index)
+{
+  g_return_val_if_fail (meta != NULL, NULL);
+
+  if (index >= meta->n_boxes || !meta->labels ||
+      meta->class_id[index] >= meta->labels->n_labels) {
+    return NULL;
+  }
+  return meta->labels->labels[meta->class_id[index]];
+}
+
+GQuark
+gst_ml_detection_batch_meta_get_quark (GstMLDetectionBatchMeta * meta,
+    guint index)
+{
+  g_return_val_if_fail (meta != NULL, 0);
+
+  if (index >= meta->n_boxes || !meta->labels) {
+    return 0;
+  }
+  return gst_ml_label_table_get_quark (meta->labels, meta->class_id[index]);
+}
+
+static gchar *
+gst_ml_meta_strdup (const gchar * str)
+{
+  gchar *copy = NULL;
+
+  if (str) {
+    gsize size = strlen (str) + 1;
+    copy = (gchar *) malloc (size);
+    if (copy) {
+      memcpy (copy, str, size);
+    }
+  }
+  return copy;
+}
+
+static void
+gst_ml_classification_result_copy (GstMLClassificationResult * dresult,
+    GstMLClassificationResult * sresult)
+{
+  if (sresult->labels) {
+    gst_ml_classification_result_set_label (dresult, sresult->labels,
+        sresult->class_id);
+  } else {
+    dresult->name = gst_ml_meta_strdup (sresult->name);
+    dresult->class_id = sresult->class_id;
+  }
+  dresult->confidence = sresult->confidence;
+}
+
+static GstMLDetectionMeta *
+gst_ml_detection_copy (GstBuffer * dest, GstMLDetectionMeta * smeta)
+{
+  GstMLDetectionMeta *dmeta = gst_buffer_add_detection_meta (dest);
+  GSList *list = NULL;
+
+  if (!dmeta) {
+    return NULL;
+  }
+
+  dmeta->bounding_box = smeta->bounding_box;
+
+  for (list = smeta->box_info; list != NULL; list = list->next) {
+    GstMLClassificationResult *sresult =
+        (GstMLClassificationResult *) list->data;
+    GstMLClassificationResult *dresult = gst_ml_classification_result_new ();
+    if (!dresult) {
+      return NULL;
+    }
+    gst_ml_classification_result_copy (dresult, sresult);
+    dmeta->box_info = g_slist_append (dmeta->box_info, dresult);
+  }
+  return dmeta;
+}
+
+static GstMLSegmentationMeta *
+gst_ml_segmentation_copy (GstBuffer * dest, GstMLSegmentationMeta * smeta)
+{
+  GstMLSegmentationMeta *dmeta = gst_buffer_add_segmentation_meta (dest);
+
+  if (!dmeta) {
+    return NULL;
+  }
+
+  if (smeta->mask) {
+    // Pooled masks are immutable once attached, share instead of copying.
+    if (!gst_ml_segmentation_meta_set_mask (dmeta, gst_buffer_ref (smeta->mask),
+        smeta->img_size)) {
+      return NULL;
+    }
+  } else if (smeta->img_buffer && smeta->img_size) {
+    dmeta->img_buffer = malloc (smeta->img_size);
+    if (!dmeta->img_buffer) {
+      return NULL;
+    }
+    memcpy (dmeta->img_buffer, smeta->img_buffer, smeta->img_size);
+  }
+  dmeta->img_width = smeta->img_width;
+  dmeta->img_height = smeta->img_height;
+  dmeta->img_size = smeta->img_size;
+  dmeta->img_format = smeta->img_format;
+  dmeta->img_stride = smeta->img_stride;
+
+  if (smeta->palette && smeta->n_colors) {
+    dmeta->palette = malloc (smeta->n_colors * sizeof (guint32));
+    if (!dmeta->palette) {
+      return NULL;
+    }
+    memcpy (dmeta->palette, smeta->palette, smeta->n_colors * sizeof (guint32));
+    dmeta->n_colors = smeta->n_colors;
+  }
+  return dmeta;
+}
+
+static GstMLClassificationMeta *
+gst_ml_classification_copy (GstBuffer * dest, GstMLClassificationMeta * smeta)
+{
+  GstMLClassificationMeta *dmeta = gst_buffer_add_classification_meta (dest);
+
+  if (!dmeta) {
+    return NULL;
+  }
+
+  gst_ml_classification_result_copy (&dmeta->result, &smeta->result);
+  return dmeta;
+}
+
+static GstMLPoseNetMeta *
+gst_ml_posenet_copy (GstBuffer * dest, GstMLPoseNetMeta * smeta)
+{
+  GstMLPoseNetMeta *dmeta = gst_buffer_add_posenet_meta (dest);
+
+  if (!dmeta) {
+    return NULL;
+  }
+
+  memcpy (dmeta->points, smeta->points, sizeof (dmeta->points));
+  dmeta->score = smeta->score;
+  return dmeta;
+}
+
+static GstMLDetectionBatchMeta *
+gst_ml_detection_batch_copy (GstBuffer * dest, GstMLDetectionBatchMeta * smeta)
+{
+  GstMLDetectionBatchMeta *dmeta = gst_buffer_add_detection_batch_meta (dest,
+      smeta->n_boxes, smeta->track_id != NULL, smeta->labels);
+  gsize size = smeta->n_boxes * sizeof (guint);
+
+  if (!dmeta) {
+    return NULL;
+  }
+
+  if (smeta->n_boxes == 0) {
+    return dmeta;
+  }
+
+  memcpy (dmeta->x, smeta->x, size);
+  memcpy (dmeta->y, smeta->y, size);
+  memcpy (dmeta->width, smeta->width, size);
+  memcpy (dmeta->height, smeta->height, size);
+  memcpy (dmeta->class_id, smeta->class_id, size);
+  memcpy (dmeta->confidence, smeta->confidence,
+      smeta->n_boxes * sizeof (gfloat));
+  if (smeta->track_id) {
+    memcpy (dmeta->track_id, smeta->track_id, size);
+  }
+  dmeta->n_boxes = smeta->n_boxes;
+  return dmeta;
+}
+
+/* Input region and output size of a geometry transform. Points are
+ * mapped the same way as the C2D converter does it: crop, mirror, rotate
+ * and scale to the output frame. */
+typedef struct _GstMLGeometry GstMLGeometry;
+
+struct _GstMLGeometry {
+  gdouble         in_width;
+  gdouble         in_height;
+  gdouble         x;
+  gdouble         y;
+  gdouble         width;
+  gdouble         height;
+  gdouble         out_width;
+  gdouble         out_height;
+  gboolean        flip_h;
+  gboolean        flip_v;
+  GstMLMetaRotate rotate;
+};
+
+#define GST_ML_ROUND(value) ((guint) ((value) + 0.5))
+
+static gboolean
+gst_ml_geometry_init (GstMLGeometry * geom, GQuark type, gpointer data)
+{
+  GstVideoInfo *in_info = NULL, *out_info = NULL;
+  gint in_width = 0, in_height = 0;
+
+  memset (geom, 0, sizeof (*geom));
+
+  if (GST_VIDEO_META_TRANSFORM_IS_SCALE (type)) {
+    GstVideoMetaTransform *trans = (GstVideoMetaTransform *) data;
+
+    in_info = trans->in_info;
+    out_info = trans->out_info;
+  } else if (type == GST_ML_META_TRANSFORM_GEOMETRY) {
+    GstMLMetaTransformGeometry *trans = (GstMLMetaTransformGeometry *) data;
+
+    in_info = trans->in_info;
+    out_info = trans->out_info;
+    geom->flip_h = trans->flip_h;
+    geom->flip_v = trans->flip_v;
+    geom->rotate = trans->rotate;
+
+    in_width = GST_VIDEO_INFO_WIDTH (in_info);
+    in_height = GST_VIDEO_INFO_HEIGHT (in_info);
+
+    if (trans->crop.w > 0 && trans->crop.x < in_width) {
+      geom->x = trans->crop.x;
+      geom->width = MIN (trans->crop.w, in_width - trans->crop.x);
+    }
+    if (trans->crop.h > 0 && trans->crop.y < in_height) {
+      geom->y = trans->crop.y;
+      geom->height = MIN (trans->crop.h, in_height - trans->crop.y);
+    }
+  } else {
+    return FALSE;
+  }
+
+  geom->in_width = GST_VIDEO_INFO_WIDTH (in_info);
+  geom->in_height = GST_VIDEO_INFO_HEIGHT (in_info);
+  geom->out_width = GST_VIDEO_INFO_WIDTH (out_info);
+  geom->out_height = GST_VIDEO_INFO_HEIGHT (out_info);
+
+  if (geom->width <= 0) {
+    geom->width = geom->in_width;
+  }
+  if (geom->height <= 0) {
+    geom->height = geom->in_height;
+  }
+  return geom->width > 0 && geom->height > 0;
+}
+
+static void
+gst_ml_geometry_map_point (const GstMLGeometry * geom, gdouble x, gdouble y,
+    gdouble * out_x, gdouble * out_y)
+{
+  gdouble u = (x - geom->x) / geom->width;
+  gdouble v = (y - geom->y) / geom->height;
+  gdouble tmp = 0.0;
+
+  if (geom->flip_h) {
+    u = 1.0 - u;
+  }
+  if (geom->flip_v) {
+    v = 1.0 - v;
+  }
+
+  switch (geom->rotate) {
+    case GST_ML_META_ROTATE_90_CW:
+      tmp = u;
+      u = 1.0 - v;
+      v = tmp;
+      break;
+    case GST_ML_META_ROTATE_90_CCW:
+      tmp = u;
+      u = v;
+      v = 1.0 - tmp;
+      break;
+    case GST_ML_META_ROTATE_180:
+      u = 1.0 - u;
+      v = 1.0 - v;
+      break;
+    default:
+      break;
+  }
+
+  *out_x = u * geom->out_width;
+  *out_y = v * geom->out_height;
+}
+
+/* Clips the box to the input region and maps it to output coordinates.
+ * Returns FALSE when nothing of the box is left. */
+static gboolean
+gst_ml_geometry_map_box (const GstMLGeometry * geom, GstMLBoundingBox * box)
+{
+  gdouble x0 = MAX ((gdouble) box->x, geom->x);
+  gdouble y0 = MAX ((gdouble) box->y, geom->y);
+  gdouble x1 = MIN ((gdouble) box->x + box->width, geom->x + geom->width);
+  gdouble y1 = MIN ((gdouble) box->y + box->height, geom->y + geom->height);
+  gdouble ax = 0.0, ay = 0.0, bx = 0.0, by = 0.0;
+
+  if (x1 <= x0 || y1 <= y0) {
+    return FALSE;
+  }
+
+  gst_ml_geometry_map_point (geom, x0, y0, &ax, &ay);
+  gst_ml_geometry_map_point (geom, x1, y1, &bx, &by);
+
+  box->x = GST_ML_ROUND (MIN (ax, bx));
+  box->y = GST_ML_ROUND (MIN (ay, by));
+  box->width = GST_ML_ROUND (MAX (ax, bx)) - box->x;
+  box->height = GST_ML_ROUND (MAX (ay, by)) - box->y;
+  return TRUE;
+}
+
+static gboolean
+gst_ml_detection_transform (GstBuffer * dest, GstMeta * meta,
+    GstBuffer * src, GQuark type, gpointer data)
+{
+  GstMLDetectionMeta *smeta = (GstMLDetectionMeta *) meta;
+  GstMLDetectionMeta *dmeta = NULL;
+  GstMLBoundingBox box = smeta->bounding_box;
+  GstMLGeometry geom;
+
+  if (GST_META_TRANSFORM_IS_COPY (type)) {
+    return gst_ml_detection_copy (dest, smeta) != NULL;
+  }
+
+  if (!gst_ml_geometry_init (&geom, type, data)) {
+    return FALSE;
+  }
+
+  // Objects outside of the cropped region are not carried over.
+  if (!gst_ml_geometry_map_box (&geom, &box)) {
+    return TRUE;
+  }
+
+  dmeta = gst_ml_detection_copy (dest, smeta);
+  if (!dmeta) {
+    return FALSE;
+  }
+  dmeta->bounding_box = box;
+  return TRUE;
+}
+
+static gboolean
+gst_ml_detection_batch_transform (GstBuffer * dest, GstMeta * meta,
+    GstBuffer * src, GQuark type, gpointer data)
+{
+  GstMLDetectionBatchMeta *smeta = (GstMLDetectionBatchMeta *) meta;
+  GstMLDetectionBatchMeta *dmeta = NULL;
+  GstMLBoundingBox box;
+  GstMLGeometry geom;
+  guint i = 0;
+
+  if (GST_META_TRANSFORM_IS_COPY (type)) {
+    return gst_ml_detection_batch_copy (dest, smeta) != NULL;
+  }
+
+  if (!gst_ml_geometry_init (&geom, type, data)) {
+    return FALSE;
+  }
+
+  dmeta = gst_buffer_add_detection_batch_meta (dest, smeta->n_boxes,
+      smeta->track_id != NULL, smeta->labels);
+  if (!dmeta) {
+    return FALSE;
+  }
+
+  for (i = 0; i < smeta->n_boxes; i++) {
+    box.x = smeta->x[i];
+    box.y = smeta->y[i];
+    box.width = smeta->width[i];
+    box.height = smeta->height[i];
+
+    if (!gst_ml_geometry_map_box (&geom, &box)) {
+      continue;
+    }
+
+    gst_ml_detection_batch_meta_add_box (dmeta, &box, smeta->confidence[i],
+        smeta->class_id[i], smeta->track_id ? smeta->track_id[i] : 0);
+  }
+  return TRUE;
+}
+
+static gboolean
+gst_ml_segmentation_transform (GstBuffer * dest, GstMeta * meta,
+    GstBuffer * src, GQuark type, gpointer data)
+{
+  GstMLSegmentationMeta *smeta = (GstMLSegmentationMeta *) meta;
+  GstMLSegmentationMeta *dmeta = NULL;
+  const GstVideoFormatInfo *finfo = NULL;
+  GstMLGeometry geom;
+  gdouble rx, ry, rw, rh;
+  guint width, height, bpp, i, j;
+  guint8 *pixels = NULL;
+
+  // The image covers the whole frame, scaling alone does not change it.
+  if (GST_META_TRANSFORM_IS_COPY (type) ||
+      GST_VIDEO_META_TRANSFORM_IS_SCALE (type)) {
+    return gst_ml_segmentation_copy (dest, smeta) != NULL;
+  }
+
+  if (!gst_ml_geometry_init (&geom, type, data)) {
+    return FALSE;
+  }
+
+  finfo = gst_video_format_get_info (smeta->img_format);
+  bpp = finfo ? GST_VIDEO_FORMAT_INFO_PSTRIDE (finfo, 0) : 0;
+  if (!smeta->img_buffer || !smeta->img_width || !smeta->img_height ||
+      bpp == 0 || GST_VIDEO_FORMAT_INFO_N_PLANES (finfo) != 1) {
+    return gst_ml_segmentation_copy (dest, smeta) != NULL;
+  }
+
+  // Input region in segmentation image coordinates.
+  rx = geom.x * smeta->img_width / geom.in_width;
+  ry = geom.y * smeta->img_height / geom.in_height;
+  rw = geom.width * smeta->img_width / geom.in_width;
+  rh = geom.height * smeta->img_height / geom.in_height;
+
+  if (geom.rotate == GST_ML_META_ROTATE_90_CW ||
+      geom.rotate == GST_ML_META_ROTATE_90_CCW) {
+    width = MAX (GST_ML_ROUND (rh), 1);
+    height = MAX (GST_ML_ROUND (rw), 1);
+  } else {
+    width = MAX (GST_ML_ROUND (rw), 1);
+    height = MAX (GST_ML_ROUND (rh), 1);
+  }
+
+  dmeta = gst_buffer_add_segmentation_meta (dest);
+  if (!dmeta) {
+    return FALSE;
+  }
+
+  // Reuse the pool of the source mask when there is one.
+  if (!gst_ml_segmentation_meta_alloc_mask (dmeta,
+      smeta->mask ? smeta->mask->pool : NULL, width * height * bpp)) {
+    return FALSE;
+  }
+  dmeta->img_width = width;
+  dmeta->img_height = height;
+  dmeta->img_stride = width * bpp;
+  dmeta->img_format = smeta->img_format;
+
+  if (smeta->palette && smeta->n_colors) {
+    dmeta->palette = malloc (smeta->n_colors * sizeof (guint32));
+    if (!dmeta->palette) {
+      return FALSE;
+    }
+    memcpy (dmeta->palette, smeta->palette, smeta->n_colors * sizeof (guint32));
+    dmeta->n_colors = smeta->n_colors;
+  }
+
+  // Nearest neighbour resampling, every output pixel is mapped back to
+  // the source image by inverting the rotation and the mirroring.
+  pixels = (guint8 *) dmeta->img_buffer;
+  for (j = 0; j < height; j++) {
+    for (i = 0; i < width; i++) {
+      gdouble u = (i + 0.5) / width;
+      gdouble v = (j + 0.5) / height;
+      gdouble tmp = 0.0;
+      guint sx, sy;
+
+      switch (geom.rotate) {
+        case GST_ML_META_ROTATE_90_CW:
+          tmp = u;
+          u = v;
+          v = 1.0 - tmp;
+          break;
+        case GST_ML_META_ROTATE_90_CCW:
+          tmp = u;
+          u = 1.0 - v;
+          v = tmp;
+          break;
+        case GST_ML_META_ROTATE_180:
+          u = 1.0 - u;
+          v = 1.0 - v;
+          break;
+        default:
+          break;
+      }
+      if (geom.flip_h) {
+        u = 1.0 - u;
+      }
+      if (geom.flip_v) {
+        v = 1.0 - v;
+      }
+
+      sx = MIN ((guint) (rx + u * rw), smeta->img_width - 1);
+      sy = MIN ((guint) (ry + v * rh), smeta->img_height - 1);
+
+      memcpy (pixels + j * dmeta->img_stride + i * bpp,
+          (guint8 *) smeta->img_buffer + sy * smeta->img_stride + sx * bpp,
+          bpp);
+    }
+  }
+  return TRUE;
+}
+
+static gboolean
+gst_ml_classification_transform (GstBuffer * dest, GstMeta * meta,
+    GstBuffer * src, GQuark type, gpointer data)
+{
+  // Classification results describe the whole frame and do not depend on
+  // its geometry, so every transform is a plain copy.
+  return gst_ml_classification_copy (dest,
+      (GstMLClassificationMeta *) meta) != NULL;
+}
+
+static gboolean
+gst_ml_posenet_transform (GstBuffer * dest, GstMeta * meta,
+    GstBuffer * src, GQuark type, gpointer data)
+{
+  GstMLPoseNetMeta *smeta = (GstMLPoseNetMeta *) meta;
+  GstMLPoseNetMeta *dmeta = NULL;
+  GstMLGeometry geom;
+  guint i = 0;
+
+  if (GST_META_TRANSFORM_IS_COPY (type)) {
+    return gst_ml_posenet_copy (dest, smeta) != NULL;
+  }
+
+  if (!gst_ml_geometry_init (&geom, type, data)) {
+    return FALSE;
+  }
+
+  dmeta = gst_ml_posenet_copy (dest, smeta);
+  if (!dmeta) {
+    return FALSE;
+  }
+
+  for (i = 0; i < KEY_POINTS_COUNT; i++) {
+    gdouble x = CLAMP ((gdouble) smeta->points[i].x, geom.x,
+        geom.x + geom.width);
+    gdouble y = CLAMP ((gdouble) smeta->points[i].y, geom.y,
+        geom.y + geom.height);
+
+    gst_ml_geometry_map_point (&geom, x, y, &x, &y);
+    dmeta->points[i].x = GST_ML_ROUND (x);
+    dmeta->points[i].y = GST_ML_ROUND (y);
+  }
+  return TRUE;
+}
+
+guint
+gst_buffer_copy_ml_meta (GstBuffer * dest, GstBuffer * src)
+{
+  gpointer state = NULL;
+  GstMeta *meta = NULL;
+  gboolean success = TRUE;
+  guint n_metas = 0;
+
+  g_return_val_if_fail (dest != NULL, 0);
+  g_return_val_if_fail (src != NULL, 0);
+
+  while (success && (meta = gst_buffer_iterate_meta (src, &state))) {
+    if (meta->info->api == GST_ML_DETECTION_API_TYPE) {
+      success =
+          gst_ml_detection_copy (dest, (GstMLDetectionMeta *) meta) != NULL;
+    } else if (meta->info->api == GST_ML_SEGMENTATION_API_TYPE) {
+      success = gst_ml_segmentation_copy (dest,
+          (GstMLSegmentationMeta *) meta) != NULL;
+    } else if (meta->info->api == GST_ML_CLASSIFICATION_API_TYPE) {
+      success = gst_ml_classification_copy (dest,
+          (GstMLClassificationMeta *) meta) != NULL;
+    } else if (meta->info->api == GST_ML_POSENET_API_TYPE) {
+      success = gst_ml_posenet_copy (dest, (GstMLPoseNetMeta *) meta) != NULL;
+    } else if (meta->info->api == GST_ML_DETECTION_BATCH_API_TYPE) {
+      success = gst_ml_detection_batch_copy (dest,
+          (GstMLDetectionBatchMeta *) meta) != NULL;
+    } else {
+      continue;
+    }
+
+    if (success) {
+      n_metas++;
+    } else {
+      GST_WARNING ("Failed to copy %s", g_type_name (meta->info->api));
+    }
+  }
+  return n_metas;
+}
+
+GstMeta *
+gst_buffer_iterate_ml_meta (GstBuffer * buffer, gpointer * state, GType api)
+{
+  GstMeta *meta = NULL;
+
+  g_return_val_if_fail (buffer != NULL, NULL);
+  g_return_val_if_fail (state != NULL, NULL);
+
+  while ((meta = gst_buffer_iterate_meta (buffer, state))) {
+    if (meta->info->api == api) {
+      return meta;
+    }
+  }
+  return NULL;
+}
+
+guint
+gst_buffer_get_n_ml_meta (GstBuffer * buffer, GType api)
+{
+  gpointer state = NULL;
+  guint n_metas = 0;
+
+  g_return_val_if_fail (buffer != NULL, 0);
+
+  while (gst_buffer_iterate_ml_meta (buffer, &state, api)) {
+    n_metas++;
+  }
+  return n_metas;
+}
+
+GstMLDetectionMeta *
+gst_buffer_iterate_detection_meta (GstBuffer * buffer, gpointer * state)
+{
+  return (GstMLDetectionMeta *) gst_buffer_iterate_ml_meta (buffer, state,
+      GST_ML_DETECTION_API_TYPE);
+}
+
+GstMLSegmentationMeta *
+gst_buffer_iterate_segmentation_meta (GstBuffer * buffer, gpointer * state)
+{
+  return (GstMLSegmentationMeta *) gst_buffer_iterate_ml_meta (buffer, state,
+      GST_ML_SEGMENTATION_API_TYPE);
+}
+
+GstMLClassificationMeta *
+gst_buffer_iterate_classification_meta (GstBuffer * buffer, gpointer * state)
+{
+  return (GstMLClassificationMeta *) gst_buffer_iterate_ml_meta (buffer,
+      state, GST_ML_CLASSIFICATION_API_TYPE);
+}
+
+GstMLPoseNetMeta *
+gst_buffer_iterate_posenet_meta (GstBuffer * buffer, gpointer * state)
+{
+  return (GstMLPoseNetMeta *) gst_buffer_iterate_ml_meta (buffer, state,
+      GST_ML_POSENET_API_TYPE);
+}
+
+gboolean
+gst_buffer_visit_ml_meta (GstBuffer * buffer,
+    const GstMLMetaVisitor * visitor, gpointer user_data)
+{
+  gpointer state = NULL;
+  GstMeta *meta = NULL;
+  GType api = 0;
+
+  g_return_val_if_fail (buffer != NULL, FALSE);
+  g_return_val_if_fail (visitor != NULL, FALSE);
+
+  while ((meta = gst_buffer_iterate_meta (buffer, &state))) {
+    gboolean proceed = TRUE;
+
+    api = meta->info->api;
+    if (api == GST_ML_DETECTION_API_TYPE && visitor->detection) {
+      proceed = visitor->detection ((GstMLDetectionMeta *) meta, user_data);
+    } else if (api == GST_ML_DETECTION_BATCH_API_TYPE &&
+        visitor->detection_batch) {
+      proceed = visitor->detection_batch (
+          (GstMLDetectionBatchMeta *) meta, user_data);
+    } else if (api == GST_ML_SEGMENTATION_API_TYPE && visitor->segmentation) {
+      proceed = visitor->segmentation (
+          (GstMLSegmentationMeta *) meta, user_data);
+    } else if (api == GST_ML_CLASSIFICATION_API_TYPE &&
+        visitor->classification) {
+      proceed = visitor->classification (
+          (GstMLClassificationMeta *) meta, user_data);
+    } else if (api == GST_ML_POSENET_API_TYPE && visitor->posenet) {
+      proceed = visitor->posenet ((GstMLPoseNetMeta *) meta, user_data);
+    }
+
+    if (!proceed) {
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+GQuark
+gst_ml_meta_transform_geometry_get_quark (void)
+{
+  static gsize quark = 0;
+
+  if (g_once_init_enter (&quark)) {
+    GQuark _quark =
+        g_quark_from_static_string ("gst-ml-meta-transform-geometry");
+    g_once_init_leave (&quark, _quark);
+  }
+  return (GQuark) quark;
+}
+
+gboolean
+gst_ml_meta_is_ml (GstMeta * meta)
+{
+  g_return_val_if_fail (meta != NULL, FALSE);
+
+  return meta->info->api == GST_ML_DETECTION_API_TYPE ||
+      meta->info->api == GST_ML_DETECTION_BATCH_API_TYPE ||
+      meta->info->api == GST_ML_SEGMENTATION_API_TYPE ||
+      meta->info->api == GST_ML_CLASSIFICATION_API_TYPE ||
+      meta->info->api == GST_ML_POSENET_API_TYPE;
+}
+
+guint
+gst_buffer_transform_ml_meta (GstBuffer * dest, GstBuffer * src,
+    GstMLMetaTransformGeometry * geometry)
+{
+  gpointer state = NULL;
+  GstMeta *meta = NULL;
+  guint n_metas = 0;
+
+  g_return_val_if_fail (dest != NULL, 0);
+  g_return_val_if_fail (src != NULL, 0);
+  g_return_val_if_fail (geometry != NULL, 0);
+
+  while ((meta = gst_buffer_iterate_meta (src, &state))) {
+    if (!gst_ml_meta_is_ml (meta)) {
+      continue;
+    }
+
+    if (meta->info->transform_func (dest, meta, src,
+            GST_ML_META_TRANSFORM_GEOMETRY, geometry)) {
+      n_metas++;
+    } else {
+      GST_WARNING ("Failed to transform %s", g_type_name (meta->info->api));
+    }
+  }
+  return n_metas;
+}
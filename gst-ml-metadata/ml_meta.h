@@ -45,6 +45,12 @@ typedef struct _GstMLKeyPoint GstMLKeyPoint;
 typedef struct _GstMLPose GstMLPose;
 typedef struct _GstMLPoseNetMeta GstMLPoseNetMeta;
 
+typedef struct _GstMLLabelTable GstMLLabelTable;
+typedef struct _GstMLDetectionBatchMeta GstMLDetectionBatchMeta;
+
+typedef struct _GstMLMetaTransformGeometry GstMLMetaTransformGeometry;
+typedef struct _GstMLMetaVisitor GstMLMetaVisitor;
+
 #define GST_ML_DETECTION_API_TYPE (gst_ml_detection_get_type())
 #define GST_ML_DETECTION_INFO (gst_ml_detection_get_info())
 
@@ -57,6 +63,12 @@ typedef struct _GstMLPoseNetMeta GstMLPoseNetMeta;
 #define GST_ML_POSENET_API_TYPE (gst_ml_posenet_get_type())
 #define GST_ML_POSENET_INFO (gst_ml_posenet_get_info())
 
+#define GST_ML_DETECTION_BATCH_API_TYPE (gst_ml_detection_batch_get_type())
+#define GST_ML_DETECTION_BATCH_INFO (gst_ml_detection_batch_get_info())
+
+#define GST_ML_META_TRANSFORM_GEOMETRY \
+    (gst_ml_meta_transform_geometry_get_quark())
+
 
 /**
  * GstMLBoundingBox:
@@ -78,12 +90,20 @@ struct _GstMLBoundingBox {
  * GstMLClassificationResult:
  * @name: name for given object
  * @confidence: confidence for given object
+ * @class_id: index of the object class in @labels
+ * @labels: label table @name comes from, NULL if @name is owned
  *
- * Name and confidence handle
+ * Name and confidence handle. Results filled with
+ * gst_ml_classification_result_set_label() borrow @name from the shared
+ * @labels table, otherwise @name is a malloc'd string owned by the result.
+ * Results start zeroed, as from gst_ml_classification_result_new(), since
+ * a non NULL @labels is taken as a reference held by the result.
  */
 struct _GstMLClassificationResult {
-  gchar  *name;
-  gfloat confidence;
+  gchar           *name;
+  gfloat          confidence;
+  guint           class_id;
+  GstMLLabelTable *labels;
 };
 
 /**
@@ -109,8 +129,14 @@ struct _GstMLDetectionMeta {
  * @img_size: size of image buffer in bytes
  * @img_format: the segmentation image pixel format
  * @img_stride: the segmentation image bytes per line
+ * @palette: RGBA colors indexed by class, used when @img_format is GRAY8
+ * @n_colors: number of entries in @palette
+ * @mask: optional buffer backing @img_buffer, NULL for malloc'd images
  *
- * Machine learning segmentation image models properties
+ * Machine learning segmentation image models properties. When @img_format
+ * is GRAY8 each pixel of @img_buffer holds a class index instead of a color.
+ * When @mask is set @img_buffer points into its mapping, the meta holds a
+ * reference to @mask and returns it to its pool once the meta is freed.
  */
 struct _GstMLSegmentationMeta {
   GstMeta         parent;
@@ -120,6 +146,12 @@ struct _GstMLSegmentationMeta {
   guint           img_size;
   GstVideoFormat  img_format;
   guint           img_stride;
+  guint32         *palette;
+  guint           n_colors;
+  GstBuffer       *mask;
+
+  /*< private >*/
+  GstMapInfo      mask_map;
 };
 
 /**
@@ -190,6 +222,120 @@ struct _GstMLPoseNetMeta {
   gfloat            score;
 };
 
+/**
+ * GstMLLabelTable:
+ * @refcount: number of references held on the table
+ * @n_labels: number of entries in @labels and @quarks
+ * @labels: interned label names indexed by class id
+ * @quarks: #GQuark of every label, 0 for unnamed classes
+ *
+ * Immutable table of class names. Created once per model by the producer
+ * and shared by reference between all metas it attaches. Names are
+ * interned, consumers can compare labels by #GQuark instead of strcmp().
+ */
+struct _GstMLLabelTable {
+  gint              refcount;
+  guint             n_labels;
+  gchar             **labels;
+  GQuark            *quarks;
+};
+
+/**
+ * GstMLDetectionBatchMeta:
+ * @parent: parent #GstMeta
+ * @n_boxes: number of valid entries in the arrays below
+ * @capacity: number of entries the arrays can hold
+ * @x: horizontal start positions
+ * @y: vertical start positions
+ * @width: box widths
+ * @height: box heights
+ * @confidence: box confidences
+ * @class_id: box class ids, used as index in @labels
+ * @track_id: box track ids or NULL when tracking is not used
+ * @labels: label table for @class_id, may be NULL
+ * @block: storage backing all arrays, owned by the meta
+ *
+ * All detections of a frame stored in struct-of-arrays layout. The arrays
+ * live in a single block taken from a process wide pool, so attaching the
+ * results of a frame costs one meta and no per-box allocations.
+ */
+struct _GstMLDetectionBatchMeta {
+  GstMeta           parent;
+  guint             n_boxes;
+  guint             capacity;
+  guint             *x;
+  guint             *y;
+  guint             *width;
+  guint             *height;
+  gfloat            *confidence;
+  guint             *class_id;
+  guint             *track_id;
+  GstMLLabelTable   *labels;
+  gpointer          block;
+};
+
+/**
+ * GstMLMetaRotate:
+ * @GST_ML_META_ROTATE_NONE: no rotation
+ * @GST_ML_META_ROTATE_90_CW: rotate by 90 degrees clockwise
+ * @GST_ML_META_ROTATE_90_CCW: rotate by 90 degrees counter-clockwise
+ * @GST_ML_META_ROTATE_180: rotate by 180 degrees
+ *
+ * Rotation applied by a geometry transform.
+ */
+typedef enum {
+  GST_ML_META_ROTATE_NONE,
+  GST_ML_META_ROTATE_90_CW,
+  GST_ML_META_ROTATE_90_CCW,
+  GST_ML_META_ROTATE_180,
+} GstMLMetaRotate;
+
+/**
+ * GstMLMetaTransformGeometry:
+ * @in_info: the input video info
+ * @out_info: the output video info
+ * @crop: input region that is converted, zero width or height selects
+ *        the whole input frame
+ * @flip_h: whether the region is mirrored horizontally
+ * @flip_v: whether the region is mirrored vertically
+ * @rotate: rotation applied after mirroring
+ *
+ * Extra data passed to the metadata transform functions together with
+ * #GST_ML_META_TRANSFORM_GEOMETRY. The input region is cropped, mirrored,
+ * rotated and then scaled to the output frame, same as qtivtransform.
+ */
+struct _GstMLMetaTransformGeometry {
+  GstVideoInfo      *in_info;
+  GstVideoInfo      *out_info;
+  GstVideoRectangle crop;
+  gboolean          flip_h;
+  gboolean          flip_v;
+  GstMLMetaRotate   rotate;
+};
+
+/**
+ * GstMLMetaVisitor:
+ * @detection: called for every #GstMLDetectionMeta
+ * @detection_batch: called for every #GstMLDetectionBatchMeta
+ * @segmentation: called for every #GstMLSegmentationMeta
+ * @classification: called for every #GstMLClassificationMeta
+ * @posenet: called for every #GstMLPoseNetMeta
+ *
+ * Typed callbacks for gst_buffer_visit_ml_meta(). Unset callbacks skip
+ * the corresponding metadata type. A callback returning FALSE stops the
+ * walk.
+ */
+struct _GstMLMetaVisitor {
+  gboolean (*detection)       (GstMLDetectionMeta * meta, gpointer user_data);
+  gboolean (*detection_batch) (GstMLDetectionBatchMeta * meta,
+                               gpointer user_data);
+  gboolean (*segmentation)    (GstMLSegmentationMeta * meta,
+                               gpointer user_data);
+  gboolean (*classification)  (GstMLClassificationMeta * meta,
+                               gpointer user_data);
+  gboolean (*posenet)         (GstMLPoseNetMeta * meta, gpointer user_data);
+};
+
 
 GType gst_ml_detection_get_type (void);
 const GstMetaInfo * gst_ml_detection_get_info (void);
@@ -199,6 +345,9 @@ GType gst_ml_classification_get_type (void);
 const GstMetaInfo * gst_ml_classification_get_info (void);
 GType gst_ml_posenet_get_type (void);
 const GstMetaInfo * gst_ml_posenet_get_info (void);
+GType gst_ml_detection_batch_get_type (void);
+const GstMetaInfo * gst_ml_detection_batch_get_info (void);
+GQuark gst_ml_meta_transform_geometry_get_quark (void);
 
 /**
  * gst_buffer_add_detection_meta:
@@ -246,6 +395,47 @@ GstMLSegmentationMeta * gst_buffer_add_segmentation_meta (GstBuffer * buffer);
 GST_EXPORT
 GSList * gst_buffer_get_segmentation_meta (GstBuffer * buffer);
 
+/**
+ * gst_ml_segmentation_meta_set_mask:
+ * @meta: segmentation metadata
+ * @mask: (transfer full): buffer holding the segmentation image
+ * @size: size of the segmentation image in bytes
+ *
+ * Attaches @mask as backing storage of the segmentation image, @img_buffer
+ * and @img_size are updated accordingly. Previous image data is released.
+ * Returns FALSE if @mask is smaller than @size or can not be mapped.
+ *
+ */
+GST_EXPORT
+gboolean gst_ml_segmentation_meta_set_mask (GstMLSegmentationMeta * meta,
+    GstBuffer * mask, guint size);
+
+/**
+ * gst_ml_segmentation_meta_alloc_mask:
+ * @meta: segmentation metadata
+ * @pool: (allow-none): active mask pool, see gst_ml_mask_pool_new()
+ * @size: size of the segmentation image in bytes
+ *
+ * Acquires a mask buffer from @pool and attaches it to @meta. Falls back
+ * to zeroed heap memory if @pool is NULL, has no free buffer or its
+ * buffers are smaller than @size. Contents of pooled masks are undefined.
+ *
+ */
+GST_EXPORT
+gboolean gst_ml_segmentation_meta_alloc_mask (GstMLSegmentationMeta * meta,
+    GstBufferPool * pool, guint size);
+
+/**
+ * gst_ml_segmentation_meta_get_fd:
+ * @meta: segmentation metadata
+ *
+ * Returns the FD of the memory backing the segmentation image or -1 if
+ * the image is not FD backed.
+ *
+ */
+GST_EXPORT
+gint gst_ml_segmentation_meta_get_fd (GstMLSegmentationMeta * meta);
+
 /**
  * gst_buffer_add_classification_meta:
  * @buffer: the buffer new metadata belongs to
@@ -292,6 +482,322 @@ GstMLPoseNetMeta * gst_buffer_add_posenet_meta (GstBuffer * buffer);
 GST_EXPORT
 GSList * gst_buffer_get_posenet_meta (GstBuffer * buffer);
 
+/**
+ * gst_ml_label_table_new:
+ * @labels: array of label names
+ * @n_labels: number of entries in @labels
+ *
+ * Creates new label table with refcount of one. Every label is interned
+ * as #GQuark, the table only references the interned strings.
+ *
+ */
+GST_EXPORT
+GstMLLabelTable * gst_ml_label_table_new (const gchar * const * labels,
+    guint n_labels);
+
+/**
+ * gst_ml_label_table_ref:
+ * @table: the label table
+ *
+ * Increases the refcount of @table and returns it.
+ *
+ */
+GST_EXPORT
+GstMLLabelTable * gst_ml_label_table_ref (GstMLLabelTable * table);
+
+/**
+ * gst_ml_label_table_unref:
+ * @table: the label table
+ *
+ * Decreases the refcount of @table and frees it when it reaches zero.
+ *
+ */
+GST_EXPORT
+void gst_ml_label_table_unref (GstMLLabelTable * table);
+
+/**
+ * gst_ml_label_table_get_name:
+ * @table: the label table
+ * @class_id: class index
+ *
+ * Returns the interned name of @class_id or NULL when out of range.
+ *
+ */
+GST_EXPORT
+const gchar * gst_ml_label_table_get_name (GstMLLabelTable * table,
+    guint class_id);
+
+/**
+ * gst_ml_label_table_get_quark:
+ * @table: the label table
+ * @class_id: class index
+ *
+ * Returns the #GQuark of @class_id or 0 when out of range.
+ *
+ */
+GST_EXPORT
+GQuark gst_ml_label_table_get_quark (GstMLLabelTable * table,
+    guint class_id);
+
+/**
+ * gst_ml_label_table_lookup:
+ * @table: the label table
+ * @name: label name
+ *
+ * Returns the class id of @name or -1 if @table has no such label.
+ * Does not allocate, unknown names are not interned.
+ *
+ */
+GST_EXPORT
+gint gst_ml_label_table_lookup (GstMLLabelTable * table, const gchar * name);
+
+/**
+ * gst_ml_classification_result_set_label:
+ * @result: the classification result
+ * @labels: label table, the result takes its own reference
+ * @class_id: class index in @labels
+ *
+ * Sets the class of @result. The name is borrowed from @labels, no
+ * string is copied.
+ *
+ */
+GST_EXPORT
+void gst_ml_classification_result_set_label (
+    GstMLClassificationResult * result, GstMLLabelTable * labels,
+    guint class_id);
+
+/**
+ * gst_ml_classification_result_get_quark:
+ * @result: the classification result
+ *
+ * Returns the #GQuark of the result label or 0 if it has none. Results
+ * with owned names are interned on demand.
+ *
+ */
+GST_EXPORT
+GQuark gst_ml_classification_result_get_quark (
+    GstMLClassificationResult * result);
+
+/**
+ * gst_ml_classification_result_new:
+ *
+ * Allocates a result without name and label table. Results in the
+ * @box_info list of a #GstMLDetectionMeta are freed together with it.
+ *
+ */
+GST_EXPORT
+GstMLClassificationResult * gst_ml_classification_result_new (void);
+
+/**
+ * gst_ml_classification_result_clear:
+ * @result: the classification result
+ *
+ * Releases the name or the label table reference held by @result.
+ *
+ */
+GST_EXPORT
+void gst_ml_classification_result_clear (GstMLClassificationResult * result);
+
+/**
+ * gst_buffer_add_detection_batch_meta:
+ * @buffer: the buffer new metadata belongs to
+ * @capacity: max number of boxes the meta will hold
+ * @track_ids: whether to reserve track id storage
+ * @labels: (allow-none): label table, the meta takes its own reference
+ *
+ * Creates new detection batch entry with room for @capacity boxes and
+ * returns pointer to it. Boxes are appended with
+ * gst_ml_detection_batch_meta_add_box().
+ *
+ */
+GST_EXPORT
+GstMLDetectionBatchMeta * gst_buffer_add_detection_batch_meta (
+    GstBuffer * buffer, guint capacity, gboolean track_ids,
+    GstMLLabelTable * labels);
+
+/**
+ * gst_buffer_get_detection_batch_meta:
+ * @buffer: the buffer metadata comes from
+ *
+ * Returns the detection batch entry of @buffer or NULL. Producers attach
+ * at most one batch per frame, so no list is allocated.
+ *
+ */
+GST_EXPORT
+GstMLDetectionBatchMeta * gst_buffer_get_detection_batch_meta (
+    GstBuffer * buffer);
+
+/**
+ * gst_ml_detection_batch_meta_add_box:
+ * @meta: the detection batch
+ * @box: box coordinates
+ * @confidence: box confidence
+ * @class_id: box class id
+ * @track_id: box track id, ignored when track ids were not reserved
+ *
+ * Appends one box to @meta. Returns FALSE when @meta is full.
+ *
+ */
+GST_EXPORT
+gboolean gst_ml_detection_batch_meta_add_box (GstMLDetectionBatchMeta * meta,
+    const GstMLBoundingBox * box, gfloat confidence, guint class_id,
+    guint track_id);
+
+/**
+ * gst_ml_detection_batch_meta_get_label:
+ * @meta: the detection batch
+ * @index: box index
+ *
+ * Returns the label name of box @index or NULL when it has no label.
+ *
+ */
+GST_EXPORT
+const gchar * gst_ml_detection_batch_meta_get_label (
+    GstMLDetectionBatchMeta * meta, guint index);
+
+/**
+ * gst_ml_detection_batch_meta_get_quark:
+ * @meta: the detection batch
+ * @index: box index
+ *
+ * Returns the label #GQuark of box @index or 0 when it has no label.
+ *
+ */
+GST_EXPORT
+GQuark gst_ml_detection_batch_meta_get_quark (
+    GstMLDetectionBatchMeta * meta, guint index);
+
+/**
+ * gst_buffer_iterate_ml_meta:
+ * @buffer: the buffer metadata comes from
+ * @state: an opaque state pointer, NULL on the first call
+ * @api: the metadata API type to look for
+ *
+ * Returns the next metadata entry of type @api or NULL when there are
+ * no more entries. Walks the buffer metadata in place without allocating.
+ *
+ */
+GST_EXPORT
+GstMeta * gst_buffer_iterate_ml_meta (GstBuffer * buffer, gpointer * state,
+    GType api);
+
+/**
+ * gst_buffer_get_n_ml_meta:
+ * @buffer: the buffer metadata comes from
+ * @api: the metadata API type to count
+ *
+ * Returns the number of metadata entries of type @api.
+ *
+ */
+GST_EXPORT
+guint gst_buffer_get_n_ml_meta (GstBuffer * buffer, GType api);
+
+/**
+ * gst_buffer_iterate_detection_meta:
+ * @buffer: the buffer metadata comes from
+ * @state: an opaque state pointer, NULL on the first call
+ *
+ * Returns the next detection entry or NULL. Allocation free
+ * alternative of gst_buffer_get_detection_meta().
+ *
+ */
+GST_EXPORT
+GstMLDetectionMeta * gst_buffer_iterate_detection_meta (GstBuffer * buffer,
+    gpointer * state);
+
+/**
+ * gst_buffer_iterate_segmentation_meta:
+ * @buffer: the buffer metadata comes from
+ * @state: an opaque state pointer, NULL on the first call
+ *
+ * Returns the next segmentation entry or NULL. Allocation free
+ * alternative of gst_buffer_get_segmentation_meta().
+ *
+ */
+GST_EXPORT
+GstMLSegmentationMeta * gst_buffer_iterate_segmentation_meta (
+    GstBuffer * buffer, gpointer * state);
+
+/**
+ * gst_buffer_iterate_classification_meta:
+ * @buffer: the buffer metadata comes from
+ * @state: an opaque state pointer, NULL on the first call
+ *
+ * Returns the next classification entry or NULL. Allocation free
+ * alternative of gst_buffer_get_classification_meta().
+ *
+ */
+GST_EXPORT
+GstMLClassificationMeta * gst_buffer_iterate_classification_meta (
+    GstBuffer * buffer, gpointer * state);
+
+/**
+ * gst_buffer_iterate_posenet_meta:
+ * @buffer: the buffer metadata comes from
+ * @state: an opaque state pointer, NULL on the first call
+ *
+ * Returns the next posenet entry or NULL. Allocation free alternative
+ * of gst_buffer_get_posenet_meta().
+ *
+ */
+GST_EXPORT
+GstMLPoseNetMeta * gst_buffer_iterate_posenet_meta (GstBuffer * buffer,
+    gpointer * state);
+
+/**
+ * gst_buffer_visit_ml_meta:
+ * @buffer: the buffer metadata comes from
+ * @visitor: typed callbacks
+ * @user_data: data passed to the callbacks
+ *
+ * Calls the matching @visitor callback for every machine learning
+ * metadata entry of @buffer in attach order. Returns FALSE when a
+ * callback stopped the walk.
+ *
+ */
+GST_EXPORT
+gboolean gst_buffer_visit_ml_meta (GstBuffer * buffer,
+    const GstMLMetaVisitor * visitor, gpointer user_data);
+
+/**
+ * gst_buffer_copy_ml_meta:
+ * @dest: the buffer copied metadata is attached to
+ * @src: the buffer metadata comes from
+ *
+ * Deep copies all detection, detection batch, segmentation,
+ * classification and posenet metadata entries of @src and attaches them
+ * to @dest. Used by elements that reuse the results of a previous frame.
+ * Returns number of copied entries.
+ *
+ */
+GST_EXPORT
+guint gst_buffer_copy_ml_meta (GstBuffer * dest, GstBuffer * src);
+
+/**
+ * gst_ml_meta_is_ml:
+ * @meta: the metadata to check
+ *
+ * Returns TRUE when @meta is one of the machine learning metadata types.
+ *
+ */
+GST_EXPORT
+gboolean gst_ml_meta_is_ml (GstMeta * meta);
+
+/**
+ * gst_buffer_transform_ml_meta:
+ * @dest: the buffer transformed metadata is attached to
+ * @src: the buffer metadata comes from
+ * @geometry: crop, flip, rotate and scale applied between @src and @dest
+ *
+ * Attaches to @dest the machine learning metadata of @src with all
+ * coordinates remapped by @geometry. Boxes left outside the cropped
+ * region are dropped. Returns number of transformed entries.
+ *
+ */
+GST_EXPORT
+guint gst_buffer_transform_ml_meta (GstBuffer * dest, GstBuffer * src,
+    GstMLMetaTransformGeometry * geometry);
+
 G_END_DECLS
 
 #endif /* __GST_ML_META_H__ */
@@ -0,0 +1,829 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "ml_meta_serialize.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef GST_DISABLE_GST_DEBUG
+#define GST_CAT_DEFAULT ensure_debug_category()
+static GstDebugCategory *
+ensure_debug_category (void)
+{
+  static gsize category = 0;
+
+  if (g_once_init_enter (&category)) {
+    gsize cat_done;
+
+    cat_done = (gsize) _gst_debug_category_new("gstmlmeta", 0, "gstmlmeta");
+
+    g_once_init_leave (&category, cat_done);
+  }
+
+  return (GstDebugCategory *) category;
+}
+#else
+#define ensure_debug_category() /* NOOP */
+#endif /* GST_DISABLE_GST_DEBUG */
+
+// All values are little endian. Buffer header: magic (4), version (2),
+// reserved (2), number of records (4). Record header: type (1),
+// reserved (1), flags (2), payload size (4).
+#define GST_ML_SERIAL_HEADER_SIZE 12
+#define GST_ML_SERIAL_RECORD_HEADER_SIZE 8
+
+// Detection batch record flags.
+#define GST_ML_SERIAL_FLAG_TRACK_IDS (1 << 0)
+
+// Upper bound of class ids accepted by the reader.
+#define GST_ML_SERIAL_MAX_CLASS_ID 65535
+
+typedef struct _GstMLWriter GstMLWriter;
+typedef struct _GstMLReader GstMLReader;
+
+// Writes only while the data fits but always advances the offset, so the
+// same code path computes the required size.
+struct _GstMLWriter {
+  guint8  *data;
+  gsize   size;
+  gsize   offset;
+};
+
+struct _GstMLReader {
+  const guint8  *data;
+  gsize         size;
+  gsize         offset;
+  gboolean      error;
+};
+
+static inline gboolean
+gst_ml_writer_fits (GstMLWriter * writer, gsize n)
+{
+  return writer->data != NULL && writer->offset + n <= writer->size;
+}
+
+// Overwrites a value written before, once the value is known.
+static inline void
+gst_ml_writer_patch_uint32 (GstMLWriter * writer, gsize offset, guint32 value)
+{
+  if (writer->data != NULL && offset + 4 <= writer->size) {
+    GST_WRITE_UINT32_LE (writer->data + offset, value);
+  }
+}
+
+static inline void
+gst_ml_writer_put_uint8 (GstMLWriter * writer, guint8 value)
+{
+  if (gst_ml_writer_fits (writer, 1)) {
+    GST_WRITE_UINT8 (writer->data + writer->offset, value);
+  }
+  writer->offset += 1;
+}
+
+static inline void
+gst_ml_writer_put_uint16 (GstMLWriter * writer, guint16 value)
+{
+  if (gst_ml_writer_fits (writer, 2)) {
+    GST_WRITE_UINT16_LE (writer->data + writer->offset, value);
+  }
+  writer->offset += 2;
+}
+
+static inline void
+gst_ml_writer_put_uint32 (GstMLWriter * writer, guint32 value)
+{
+  if (gst_ml_writer_fits (writer, 4)) {
+    GST_WRITE_UINT32_LE (writer->data + writer->offset, value);
+  }
+  writer->offset += 4;
+}
+
+static inline void
+gst_ml_writer_put_float (GstMLWriter * writer, gfloat value)
+{
+  if (gst_ml_writer_fits (writer, 4)) {
+    GST_WRITE_FLOAT_LE (writer->data + writer->offset, value);
+  }
+  writer->offset += 4;
+}
+
+static inline void
+gst_ml_writer_put_data (GstMLWriter * writer, gconstpointer data, gsize n)
+{
+  if (n > 0 && gst_ml_writer_fits (writer, n)) {
+    memcpy (writer->data + writer->offset, data, n);
+  }
+  writer->offset += n;
+}
+
+// Strings are stored as 16 bit length followed by the bytes, without
+// terminator. Zero length stands for NULL.
+static void
+gst_ml_writer_put_string (GstMLWriter * writer, const gchar * str)
+{
+  gsize length = str ? MIN (strlen (str), G_MAXUINT16) : 0;
+
+  gst_ml_writer_put_uint16 (writer, length);
+  gst_ml_writer_put_data (writer, str, length);
+}
+
+static inline gboolean
+gst_ml_reader_check (GstMLReader * reader, gsize n)
+{
+  if (reader->error || reader->size - reader->offset < n) {
+    reader->error = TRUE;
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static guint8
+gst_ml_reader_get_uint8 (GstMLReader * reader)
+{
+  guint8 value = 0;
+
+  if (gst_ml_reader_check (reader, 1)) {
+    value = GST_READ_UINT8 (reader->data + reader->offset);
+    reader->offset += 1;
+  }
+  return value;
+}
+
+static guint16
+gst_ml_reader_get_uint16 (GstMLReader * reader)
+{
+  guint16 value = 0;
+
+  if (gst_ml_reader_check (reader, 2)) {
+    value = GST_READ_UINT16_LE (reader->data + reader->offset);
+    reader->offset += 2;
+  }
+  return value;
+}
+
+static guint32
+gst_ml_reader_get_uint32 (GstMLReader * reader)
+{
+  guint32 value = 0;
+
+  if (gst_ml_reader_check (reader, 4)) {
+    value = GST_READ_UINT32_LE (reader->data + reader->offset);
+    reader->offset += 4;
+  }
+  return value;
+}
+
+static gfloat
+gst_ml_reader_get_float (GstMLReader * reader)
+{
+  gfloat value = 0.0;
+
+  if (gst_ml_reader_check (reader, 4)) {
+    value = GST_READ_FLOAT_LE (reader->data + reader->offset);
+    reader->offset += 4;
+  }
+  return value;
+}
+
+static const guint8 *
+gst_ml_reader_get_data (GstMLReader * reader, gsize n)
+{
+  const guint8 *data = NULL;
+
+  if (gst_ml_reader_check (reader, n)) {
+    data = reader->data + reader->offset;
+    reader->offset += n;
+  }
+  return data;
+}
+
+// Returns a malloc'd copy of the string or NULL for empty strings.
+static gchar *
+gst_ml_reader_dup_string (GstMLReader * reader)
+{
+  guint16 length = gst_ml_reader_get_uint16 (reader);
+  const guint8 *data = gst_ml_reader_get_data (reader, length);
+  gchar *str = NULL;
+
+  if (data == NULL || length == 0) {
+    return NULL;
+  }
+
+  str = (gchar *) malloc (length + 1);
+  if (str) {
+    memcpy (str, data, length);
+    str[length] = '\0';
+  }
+  return str;
+}
+
+static void
+gst_ml_serialize_result (GstMLWriter * writer,
+    GstMLClassificationResult * result)
+{
+  gst_ml_writer_put_float (writer, result->confidence);
+  gst_ml_writer_put_uint32 (writer, result->class_id);
+  gst_ml_writer_put_string (writer, result->name);
+}
+
+static gboolean
+gst_ml_deserialize_result (GstMLReader * reader,
+    GstMLClassificationResult * result)
+{
+  result->confidence = gst_ml_reader_get_float (reader);
+  result->class_id = gst_ml_reader_get_uint32 (reader);
+  result->labels = NULL;
+  result->name = gst_ml_reader_dup_string (reader);
+  return !reader->error;
+}
+
+static void
+gst_ml_serialize_detection (GstMLWriter * writer, GstMLDetectionMeta * meta)
+{
+  GSList *list = NULL;
+
+  gst_ml_writer_put_uint32 (writer, meta->bounding_box.x);
+  gst_ml_writer_put_uint32 (writer, meta->bounding_box.y);
+  gst_ml_writer_put_uint32 (writer, meta->bounding_box.width);
+  gst_ml_writer_put_uint32 (writer, meta->bounding_box.height);
+  gst_ml_writer_put_uint32 (writer, g_slist_length (meta->box_info));
+
+  for (list = meta->box_info; list != NULL; list = list->next) {
+    gst_ml_serialize_result (writer, (GstMLClassificationResult *) list->data);
+  }
+}
+
+static gboolean
+gst_ml_deserialize_detection (GstMLReader * reader, GstBuffer * buffer)
+{
+  GstMLDetectionMeta *meta = gst_buffer_add_detection_meta (buffer);
+  guint32 i = 0, n_results = 0;
+
+  if (!meta) {
+    return FALSE;
+  }
+
+  meta->bounding_box.x = gst_ml_reader_get_uint32 (reader);
+  meta->bounding_box.y = gst_ml_reader_get_uint32 (reader);
+  meta->bounding_box.width = gst_ml_reader_get_uint32 (reader);
+  meta->bounding_box.height = gst_ml_reader_get_uint32 (reader);
+  n_results = gst_ml_reader_get_uint32 (reader);
+
+  for (i = 0; i < n_results && !reader->error; i++) {
+    GstMLClassificationResult *result = gst_ml_classification_result_new ();
+    if (!result) {
+      return FALSE;
+    }
+    // Attach first so the meta releases the result on failure.
+    meta->box_info = g_slist_append (meta->box_info, result);
+    if (!gst_ml_deserialize_result (reader, result)) {
+      return FALSE;
+    }
+  }
+  return !reader->error;
+}
+
+static void
+gst_ml_serialize_detection_batch (GstMLWriter * writer,
+    GstMLDetectionBatchMeta * meta)
+{
+  // One bit for every class id the reader accepts, on the stack since the
+  // serializer does not allocate.
+  guint64 seen[(GST_ML_SERIAL_MAX_CLASS_ID + 1) / 64];
+  guint i = 0, n_classes = 0, n_labels = 0;
+  gsize offset = 0;
+
+  gst_ml_writer_put_uint32 (writer, meta->n_boxes);
+
+  for (i = 0; i < meta->n_boxes; i++) {
+    gst_ml_writer_put_uint32 (writer, meta->x[i]);
+    gst_ml_writer_put_uint32 (writer, meta->y[i]);
+    gst_ml_writer_put_uint32 (writer, meta->width[i]);
+    gst_ml_writer_put_uint32 (writer, meta->height[i]);
+    gst_ml_writer_put_float (writer, meta->confidence[i]);
+    gst_ml_writer_put_uint32 (writer, meta->class_id[i]);
+    if (meta->track_id) {
+      gst_ml_writer_put_uint32 (writer, meta->track_id[i]);
+    }
+  }
+
+  // Only labels referenced by the boxes are written, not the whole table.
+  // Each class is written once, in a single pass, the count is patched in
+  // afterwards.
+  if (meta->labels) {
+    n_classes = MIN (meta->labels->n_labels, GST_ML_SERIAL_MAX_CLASS_ID + 1);
+  }
+  memset (seen, 0, ((n_classes + 63) / 64) * sizeof (guint64));
+
+  offset = writer->offset;
+  gst_ml_writer_put_uint32 (writer, 0);
+
+  for (i = 0; i < meta->n_boxes; i++) {
+    guint class_id = meta->class_id[i];
+    guint64 bit = G_GUINT64_CONSTANT (1) << (class_id % 64);
+    const gchar *label = NULL;
+
+    if (class_id >= n_classes || (seen[class_id / 64] & bit)) {
+      continue;
+    }
+    seen[class_id / 64] |= bit;
+
+    label = gst_ml_label_table_get_name (meta->labels, class_id);
+    if (label == NULL) {
+      continue;
+    }
+
+    gst_ml_writer_put_uint32 (writer, class_id);
+    gst_ml_writer_put_string (writer, label);
+    n_labels++;
+  }
+
+  gst_ml_writer_patch_uint32 (writer, offset, n_labels);
+}
+
+static GstMLLabelTable *
+gst_ml_deserialize_label_table (GstMLReader * reader)
+{
+  GstMLLabelTable *table = NULL;
+  guint32 i = 0, n_labels = gst_ml_reader_get_uint32 (reader);
+  guint32 *ids = NULL, max_id = 0;
+  gchar **names = NULL;
+  const gchar **labels = NULL;
+
+  // Every entry takes at least six bytes, reject bogus counts early.
+  if (n_labels == 0 || n_labels > (reader->size - reader->offset) / 6) {
+    reader->error = reader->error || n_labels != 0;
+    return NULL;
+  }
+
+  ids = (guint32 *) calloc (n_labels, sizeof (guint32));
+  names = (gchar **) calloc (n_labels, sizeof (gchar *));
+
+  for (i = 0; ids && names && i < n_labels && !reader->error; i++) {
+    ids[i] = gst_ml_reader_get_uint32 (reader);
+    names[i] = gst_ml_reader_dup_string (reader);
+    max_id = MAX (max_id, ids[i]);
+  }
+
+  if (ids && names && !reader->error && max_id <= GST_ML_SERIAL_MAX_CLASS_ID) {
+    labels = (const gchar **) calloc (max_id + 1, sizeof (gchar *));
+  }
+
+  if (labels) {
+    for (i = 0; i < n_labels; i++) {
+      labels[ids[i]] = names[i];
+    }
+    table = gst_ml_label_table_new (labels, max_id + 1);
+  } else {
+    reader->error = TRUE;
+  }
+
+  for (i = 0; names && i < n_labels; i++) {
+    free (names[i]);
+  }
+  free ((gpointer) labels);
+  free (names);
+  free (ids);
+  return table;
+}
+
+static gboolean
+gst_ml_deserialize_detection_batch (GstMLReader * reader, guint16 flags,
+    GstBuffer * buffer)
+{
+  GstMLDetectionBatchMeta *meta = NULL;
+  GstMLLabelTable *table = NULL;
+  gboolean track_ids = (flags & GST_ML_SERIAL_FLAG_TRACK_IDS) != 0;
+  guint32 i = 0, n_boxes = gst_ml_reader_get_uint32 (reader);
+  gsize box_size = track_ids ? 28 : 24;
+  gsize offset = 0, end = 0;
+
+  if (reader->error || n_boxes > (reader->size - reader->offset) / box_size) {
+    reader->error = TRUE;
+    return FALSE;
+  }
+
+  // Labels follow the boxes but the table is needed to create the meta.
+  offset = reader->offset;
+  reader->offset += n_boxes * box_size;
+  table = gst_ml_deserialize_label_table (reader);
+  if (reader->error) {
+    return FALSE;
+  }
+
+  meta = gst_buffer_add_detection_batch_meta (buffer, n_boxes, track_ids,
+      table);
+  if (table) {
+    gst_ml_label_table_unref (table);
+  }
+  if (!meta) {
+    return FALSE;
+  }
+
+  // Rewind to the boxes and restore the offset after the labels.
+  end = reader->offset;
+  reader->offset = offset;
+
+  for (i = 0; i < n_boxes; i++) {
+    GstMLBoundingBox box;
+    gfloat confidence;
+    guint32 class_id, track_id = 0;
+
+    box.x = gst_ml_reader_get_uint32 (reader);
+    box.y = gst_ml_reader_get_uint32 (reader);
+    box.width = gst_ml_reader_get_uint32 (reader);
+    box.height = gst_ml_reader_get_uint32 (reader);
+    confidence = gst_ml_reader_get_float (reader);
+    class_id = gst_ml_reader_get_uint32 (reader);
+    if (track_ids) {
+      track_id = gst_ml_reader_get_uint32 (reader);
+    }
+
+    gst_ml_detection_batch_meta_add_box (meta, &box, confidence, class_id,
+        track_id);
+  }
+
+  reader->offset = end;
+  return !reader->error;
+}
+
+static void
+gst_ml_serialize_segmentation (GstMLWriter * writer,
+    GstMLSegmentationMeta * meta)
+{
+  guint i = 0;
+  guint size = meta->img_buffer ? meta->img_size : 0;
+
+  gst_ml_writer_put_uint32 (writer, meta->img_width);
+  gst_ml_writer_put_uint32 (writer, meta->img_height);
+  gst_ml_writer_put_uint32 (writer, meta->img_stride);
+  gst_ml_writer_put_uint32 (writer, meta->img_format);
+  gst_ml_writer_put_uint32 (writer, size);
+  gst_ml_writer_put_data (writer, meta->img_buffer, size);
+
+  gst_ml_writer_put_uint32 (writer, meta->palette ? meta->n_colors : 0);
+  for (i = 0; meta->palette && i < meta->n_colors; i++) {
+    gst_ml_writer_put_uint32 (writer, meta->palette[i]);
+  }
+}
+
+// Whether @size bytes of pixels hold @meta->img_height lines of
+// @meta->img_stride bytes, each wide enough for @meta->img_width pixels.
+// Consumers index the image by stride and height without further checks.
+static gboolean
+gst_ml_segmentation_fits (GstMLSegmentationMeta * meta, guint32 size)
+{
+  const GstVideoFormatInfo *finfo = NULL;
+  GEnumClass *formats = NULL;
+  guint64 bpp = 0, stride = 0;
+
+  // Unknown enum values would trigger criticals in the video library.
+  formats = (GEnumClass *) g_type_class_ref (GST_TYPE_VIDEO_FORMAT);
+  if (g_enum_get_value (formats, meta->img_format) != NULL) {
+    finfo = gst_video_format_get_info (meta->img_format);
+  }
+  g_type_class_unref (formats);
+
+  if (finfo == NULL || GST_VIDEO_FORMAT_INFO_N_PLANES (finfo) != 1) {
+    return FALSE;
+  }
+
+  bpp = GST_VIDEO_FORMAT_INFO_PSTRIDE (finfo, 0);
+  if (bpp == 0 || meta->img_width == 0 || meta->img_height == 0) {
+    return FALSE;
+  }
+
+  // Zero stride stands for tightly packed lines.
+  stride = meta->img_stride ? meta->img_stride : meta->img_width * bpp;
+
+  return stride >= meta->img_width * bpp &&
+      stride * meta->img_height <= size;
+}
+
+static gboolean
+gst_ml_deserialize_segmentation (GstMLReader * reader, GstBuffer * buffer)
+{
+  GstMLSegmentationMeta *meta = gst_buffer_add_segmentation_meta (buffer);
+  const guint8 *pixels = NULL;
+  guint32 i = 0, size = 0, n_colors = 0;
+
+  if (!meta) {
+    return FALSE;
+  }
+
+  meta->img_width = gst_ml_reader_get_uint32 (reader);
+  meta->img_height = gst_ml_reader_get_uint32 (reader);
+  meta->img_stride = gst_ml_reader_get_uint32 (reader);
+  meta->img_format = (GstVideoFormat) gst_ml_reader_get_uint32 (reader);
+  size = gst_ml_reader_get_uint32 (reader);
+  pixels = gst_ml_reader_get_data (reader, size);
+
+  if (pixels && size > 0 && !gst_ml_segmentation_fits (meta, size)) {
+    GST_WARNING ("Segmentation image %ux%u stride %u format %d does not "
+        "fit in %u bytes", meta->img_width, meta->img_height,
+        meta->img_stride, meta->img_format, size);
+    reader->error = TRUE;
+    return FALSE;
+  }
+
+  if (pixels && size > 0) {
+    if (!gst_ml_segmentation_meta_alloc_mask (meta, NULL, size)) {
+      return FALSE;
+    }
+    memcpy (meta->img_buffer, pixels, size);
+  }
+
+  n_colors = gst_ml_reader_get_uint32 (reader);
+  if (n_colors > (reader->size - reader->offset) / 4) {
+    reader->error = TRUE;
+    return FALSE;
+  }
+
+  if (n_colors > 0) {
+    meta->palette = (guint32 *) malloc (n_colors * sizeof (guint32));
+    if (!meta->palette) {
+      return FALSE;
+    }
+    for (i = 0; i < n_colors; i++) {
+      meta->palette[i] = gst_ml_reader_get_uint32 (reader);
+    }
+    meta->n_colors = n_colors;
+  }
+  return !reader->error;
+}
+
+static void
+gst_ml_serialize_classification (GstMLWriter * writer,
+    GstMLClassificationMeta * meta)
+{
+  gst_ml_serialize_result (writer, &meta->result);
+}
+
+static gboolean
+gst_ml_deserialize_classification (GstMLReader * reader, GstBuffer * buffer)
+{
+  GstMLClassificationMeta *meta = gst_buffer_add_classification_meta (buffer);
+
+  if (!meta) {
+    return FALSE;
+  }
+  return gst_ml_deserialize_result (reader, &meta->result);
+}
+
+static void
+gst_ml_serialize_posenet (GstMLWriter * writer, GstMLPoseNetMeta * meta)
+{
+  guint i = 0;
+
+  gst_ml_writer_put_float (writer, meta->score);
+  gst_ml_writer_put_uint32 (writer, KEY_POINTS_COUNT);
+
+  for (i = 0; i < KEY_POINTS_COUNT; i++) {
+    gst_ml_writer_put_uint32 (writer, (guint32) meta->points[i].x);
+    gst_ml_writer_put_uint32 (writer, (guint32) meta->points[i].y);
+    gst_ml_writer_put_float (writer, meta->points[i].score);
+  }
+}
+
+static gboolean
+gst_ml_deserialize_posenet (GstMLReader * reader, GstBuffer * buffer)
+{
+  GstMLPoseNetMeta *meta = gst_buffer_add_posenet_meta (buffer);
+  guint32 i = 0, n_points = 0;
+
+  if (!meta) {
+    return FALSE;
+  }
+
+  meta->score = gst_ml_reader_get_float (reader);
+  n_points = gst_ml_reader_get_uint32 (reader);
+
+  // Key points added by newer writers are skipped.
+  for (i = 0; i < n_points && !reader->error; i++) {
+    gint x = (gint) gst_ml_reader_get_uint32 (reader);
+    gint y = (gint) gst_ml_reader_get_uint32 (reader);
+    gfloat score = gst_ml_reader_get_float (reader);
+
+    if (i < KEY_POINTS_COUNT) {
+      meta->points[i].x = x;
+      meta->points[i].y = y;
+      meta->points[i].score = score;
+    }
+  }
+  return !reader->error;
+}
+
+gsize
+gst_ml_meta_serialize (GstMeta * meta, guint8 * data, gsize size)
+{
+  GstMLWriter writer = { data, size, 0 };
+  GType api = 0;
+  guint8 type = 0;
+  guint16 flags = 0;
+
+  g_return_val_if_fail (meta != NULL, 0);
+
+  api = meta->info->api;
+
+  if (api == GST_ML_DETECTION_API_TYPE) {
+    type = GST_ML_META_SERIAL_DETECTION;
+  } else if (api == GST_ML_DETECTION_BATCH_API_TYPE) {
+    type = GST_ML_META_SERIAL_DETECTION_BATCH;
+    if (((GstMLDetectionBatchMeta *) meta)->track_id) {
+      flags |= GST_ML_SERIAL_FLAG_TRACK_IDS;
+    }
+  } else if (api == GST_ML_SEGMENTATION_API_TYPE) {
+    type = GST_ML_META_SERIAL_SEGMENTATION;
+  } else if (api == GST_ML_CLASSIFICATION_API_TYPE) {
+    type = GST_ML_META_SERIAL_CLASSIFICATION;
+  } else if (api == GST_ML_POSENET_API_TYPE) {
+    type = GST_ML_META_SERIAL_POSENET;
+  } else {
+    return 0;
+  }
+
+  // Payload size is patched in once the payload is written.
+  gst_ml_writer_put_uint8 (&writer, type);
+  gst_ml_writer_put_uint8 (&writer, 0);
+  gst_ml_writer_put_uint16 (&writer, flags);
+  gst_ml_writer_put_uint32 (&writer, 0);
+
+  switch (type) {
+    case GST_ML_META_SERIAL_DETECTION:
+      gst_ml_serialize_detection (&writer, (GstMLDetectionMeta *) meta);
+      break;
+    case GST_ML_META_SERIAL_DETECTION_BATCH:
+      gst_ml_serialize_detection_batch (&writer,
+          (GstMLDetectionBatchMeta *) meta);
+      break;
+    case GST_ML_META_SERIAL_SEGMENTATION:
+      gst_ml_serialize_segmentation (&writer, (GstMLSegmentationMeta *) meta);
+      break;
+    case GST_ML_META_SERIAL_CLASSIFICATION:
+      gst_ml_serialize_classification (&writer,
+          (GstMLClassificationMeta *) meta);
+      break;
+    case GST_ML_META_SERIAL_POSENET:
+      gst_ml_serialize_posenet (&writer, (GstMLPoseNetMeta *) meta);
+      break;
+  }
+
+  if (data != NULL && writer.offset <= size) {
+    GST_WRITE_UINT32_LE (data + 4,
+        writer.offset - GST_ML_SERIAL_RECORD_HEADER_SIZE);
+  }
+  return writer.offset;
+}
+
+gsize
+gst_buffer_serialize_ml_meta (GstBuffer * buffer, guint8 * data, gsize size)
+{
+  gpointer state = NULL;
+  GstMeta *meta = NULL;
+  gsize offset = GST_ML_SERIAL_HEADER_SIZE;
+  guint32 n_records = 0;
+
+  g_return_val_if_fail (buffer != NULL, 0);
+
+  while ((meta = gst_buffer_iterate_meta (buffer, &state))) {
+    gsize length = gst_ml_meta_serialize (meta,
+        (data != NULL && offset <= size) ? data + offset : NULL,
+        (offset <= size) ? size - offset : 0);
+
+    n_records += (length != 0) ? 1 : 0;
+    offset += length;
+  }
+
+  if (data != NULL && size >= GST_ML_SERIAL_HEADER_SIZE) {
+    GST_WRITE_UINT32_LE (data, GST_ML_META_SERIAL_MAGIC);
+    GST_WRITE_UINT16_LE (data + 4, GST_ML_META_SERIAL_VERSION);
+    GST_WRITE_UINT16_LE (data + 6, 0);
+    GST_WRITE_UINT32_LE (data + 8, n_records);
+  }
+  return offset;
+}
+
+GBytes *
+gst_buffer_serialize_ml_meta_to_bytes (GstBuffer * buffer)
+{
+  guint8 *data = NULL;
+  gsize size = 0;
+
+  g_return_val_if_fail (buffer != NULL, NULL);
+
+  size = gst_buffer_serialize_ml_meta (buffer, NULL, 0);
+  data = (guint8 *) g_malloc (size);
+  gst_buffer_serialize_ml_meta (buffer, data, size);
+
+  return g_bytes_new_take (data, size);
+}
+
+gint
+gst_buffer_deserialize_ml_meta (GstBuffer * buffer, const guint8 * data,
+    gsize size)
+{
+  GstMLReader reader = { data, size, 0, FALSE };
+  guint32 i = 0, n_records = 0;
+  guint16 version = 0;
+  gint n_metas = 0;
+
+  g_return_val_if_fail (buffer != NULL, -1);
+  g_return_val_if_fail (data != NULL || size == 0, -1);
+
+  if (gst_ml_reader_get_uint32 (&reader) != GST_ML_META_SERIAL_MAGIC) {
+    GST_WARNING ("Invalid ML metadata magic");
+    return -1;
+  }
+
+  version = gst_ml_reader_get_uint16 (&reader);
+  if (version == 0 || version > GST_ML_META_SERIAL_VERSION) {
+    GST_WARNING ("Unsupported ML metadata version %u", version);
+    return -1;
+  }
+
+  gst_ml_reader_get_uint16 (&reader);
+  n_records = gst_ml_reader_get_uint32 (&reader);
+
+  for (i = 0; i < n_records && !reader.error; i++) {
+    guint8 type = gst_ml_reader_get_uint8 (&reader);
+    guint16 flags = 0;
+    guint32 length = 0;
+    GstMLReader record;
+    gboolean success = TRUE;
+
+    gst_ml_reader_get_uint8 (&reader);
+    flags = gst_ml_reader_get_uint16 (&reader);
+    length = gst_ml_reader_get_uint32 (&reader);
+
+    // Every record is parsed within its own bounds.
+    record.data = gst_ml_reader_get_data (&reader, length);
+    record.size = length;
+    record.offset = 0;
+    record.error = FALSE;
+
+    if (reader.error) {
+      break;
+    }
+
+    switch (type) {
+      case GST_ML_META_SERIAL_DETECTION:
+        success = gst_ml_deserialize_detection (&record, buffer);
+        break;
+      case GST_ML_META_SERIAL_DETECTION_BATCH:
+        success = gst_ml_deserialize_detection_batch (&record, flags, buffer);
+        break;
+      case GST_ML_META_SERIAL_SEGMENTATION:
+        success = gst_ml_deserialize_segmentation (&record, buffer);
+        break;
+      case GST_ML_META_SERIAL_CLASSIFICATION:
+        success = gst_ml_deserialize_classification (&record, buffer);
+        break;
+      case GST_ML_META_SERIAL_POSENET:
+        success = gst_ml_deserialize_posenet (&record, buffer);
+        break;
+      default:
+        GST_DEBUG ("Skipping unknown ML metadata record %u", type);
+        continue;
+    }
+
+    if (!success) {
+      GST_WARNING ("Malformed ML metadata record %u", type);
+      return -1;
+    }
+    n_metas++;
+  }
+
+  if (reader.error) {
+    GST_WARNING ("Truncated ML metadata");
+    return -1;
+  }
+  return n_metas;
+}
@@ -0,0 +1,132 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef __GST_ML_META_SERIALIZE_H__
+#define __GST_ML_META_SERIALIZE_H__
+
+#include "ml_meta.h"
+
+G_BEGIN_DECLS
+
+/**
+ * GST_ML_META_SERIAL_MAGIC:
+ *
+ * First four bytes of a serialized buffer, "GMLM" in little endian.
+ */
+#define GST_ML_META_SERIAL_MAGIC 0x4d4c4d47
+
+/**
+ * GST_ML_META_SERIAL_VERSION:
+ *
+ * Version of the serialization format. Readers accept data with the same
+ * or a lower version and skip records of unknown type.
+ */
+#define GST_ML_META_SERIAL_VERSION 1
+
+/**
+ * GstMLMetaSerialType:
+ * @GST_ML_META_SERIAL_DETECTION: #GstMLDetectionMeta record
+ * @GST_ML_META_SERIAL_DETECTION_BATCH: #GstMLDetectionBatchMeta record
+ * @GST_ML_META_SERIAL_SEGMENTATION: #GstMLSegmentationMeta record
+ * @GST_ML_META_SERIAL_CLASSIFICATION: #GstMLClassificationMeta record
+ * @GST_ML_META_SERIAL_POSENET: #GstMLPoseNetMeta record
+ *
+ * Record types of the serialization format. Values are part of the wire
+ * format and must never change.
+ */
+typedef enum {
+  GST_ML_META_SERIAL_DETECTION       = 1,
+  GST_ML_META_SERIAL_DETECTION_BATCH = 2,
+  GST_ML_META_SERIAL_SEGMENTATION    = 3,
+  GST_ML_META_SERIAL_CLASSIFICATION  = 4,
+  GST_ML_META_SERIAL_POSENET         = 5,
+} GstMLMetaSerialType;
+
+/**
+ * gst_ml_meta_serialize:
+ * @meta: machine learning metadata
+ * @data: (allow-none): destination of the record
+ * @size: size of @data in bytes
+ *
+ * Serializes a single metadata entry into a self describing record. The
+ * record is written only if it fits in @size bytes, pass NULL and 0 to
+ * query the required size. Does not allocate, intended for payloaders.
+ * Returns the size of the record or 0 if @meta is not machine learning
+ * metadata.
+ *
+ */
+GST_EXPORT
+gsize gst_ml_meta_serialize (GstMeta * meta, guint8 * data, gsize size);
+
+/**
+ * gst_buffer_serialize_ml_meta:
+ * @buffer: the buffer metadata comes from
+ * @data: (allow-none): destination of the serialized metadata
+ * @size: size of @data in bytes
+ *
+ * Serializes all machine learning metadata of @buffer, prefixed by a
+ * header holding magic, version and number of records. Data is written
+ * only if it fits in @size bytes. Returns the required size.
+ *
+ */
+GST_EXPORT
+gsize gst_buffer_serialize_ml_meta (GstBuffer * buffer, guint8 * data,
+    gsize size);
+
+/**
+ * gst_buffer_serialize_ml_meta_to_bytes:
+ * @buffer: the buffer metadata comes from
+ *
+ * Same as gst_buffer_serialize_ml_meta() but returns newly allocated
+ * #GBytes holding the serialized metadata.
+ *
+ */
+GST_EXPORT
+GBytes * gst_buffer_serialize_ml_meta_to_bytes (GstBuffer * buffer);
+
+/**
+ * gst_buffer_deserialize_ml_meta:
+ * @buffer: the buffer new metadata belongs to
+ * @data: serialized metadata
+ * @size: size of @data in bytes
+ *
+ * Attaches the metadata serialized with gst_buffer_serialize_ml_meta()
+ * to @buffer. Returns the number of attached entries or -1 if @data is
+ * malformed or of a newer version. Entries parsed before an error was
+ * detected stay attached.
+ *
+ */
+GST_EXPORT
+gint gst_buffer_deserialize_ml_meta (GstBuffer * buffer, const guint8 * data,
+    gsize size);
+
+G_END_DECLS
+
+#endif /* __GST_ML_META_SERIALIZE_H__ */
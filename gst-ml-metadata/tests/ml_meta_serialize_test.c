@@ -0,0 +1,740 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <gst/gst.h>
+
+#include "ml_meta_serialize.h"
+
+// Serialization round trips of every metadata type, and deserialization
+// of truncated and corrupt input.
+
+static const gchar *labels[] = { "background", "person", NULL, "car" };
+
+typedef struct _TestWriter TestWriter;
+
+// Little endian record builder for hand made, possibly corrupt, input.
+struct _TestWriter {
+  GByteArray  *array;
+};
+
+static void
+test_put_uint8 (TestWriter * writer, guint8 value)
+{
+  g_byte_array_append (writer->array, &value, 1);
+}
+
+static void
+test_put_uint16 (TestWriter * writer, guint16 value)
+{
+  guint8 data[2];
+
+  GST_WRITE_UINT16_LE (data, value);
+  g_byte_array_append (writer->array, data, sizeof (data));
+}
+
+static void
+test_put_uint32 (TestWriter * writer, guint32 value)
+{
+  guint8 data[4];
+
+  GST_WRITE_UINT32_LE (data, value);
+  g_byte_array_append (writer->array, data, sizeof (data));
+}
+
+static void
+test_put_header (TestWriter * writer, guint16 version, guint32 n_records)
+{
+  test_put_uint32 (writer, GST_ML_META_SERIAL_MAGIC);
+  test_put_uint16 (writer, version);
+  test_put_uint16 (writer, 0);
+  test_put_uint32 (writer, n_records);
+}
+
+// Record header, the caller appends exactly @length payload bytes.
+static void
+test_put_record (TestWriter * writer, guint8 type, guint16 flags,
+    guint32 length)
+{
+  test_put_uint8 (writer, type);
+  test_put_uint8 (writer, 0);
+  test_put_uint16 (writer, flags);
+  test_put_uint32 (writer, length);
+}
+
+static void
+test_put_segmentation (TestWriter * writer, guint32 width, guint32 height,
+    guint32 stride, guint32 format, guint32 size)
+{
+  guint32 i = 0;
+
+  test_put_record (writer, GST_ML_META_SERIAL_SEGMENTATION, 0,
+      20 + size + 4);
+  test_put_uint32 (writer, width);
+  test_put_uint32 (writer, height);
+  test_put_uint32 (writer, stride);
+  test_put_uint32 (writer, format);
+  test_put_uint32 (writer, size);
+  for (i = 0; i < size; i++) {
+    test_put_uint8 (writer, i & 0xff);
+  }
+  test_put_uint32 (writer, 0);
+}
+
+static gint
+test_deserialize (const guint8 * data, gsize size)
+{
+  GstBuffer *buffer = gst_buffer_new ();
+  gint n_metas = gst_buffer_deserialize_ml_meta (buffer, data, size);
+
+  gst_buffer_unref (buffer);
+  return n_metas;
+}
+
+static gint
+test_deserialize_array (GByteArray * array)
+{
+  return test_deserialize (array->data, array->len);
+}
+
+static GstBuffer *
+test_round_trip (GstBuffer * src, gint n_metas)
+{
+  GstBuffer *dest = gst_buffer_new ();
+  GBytes *bytes = gst_buffer_serialize_ml_meta_to_bytes (src);
+  gsize size = 0;
+  const guint8 *data = (const guint8 *) g_bytes_get_data (bytes, &size);
+
+  g_assert_cmpuint (size, ==, gst_buffer_serialize_ml_meta (src, NULL, 0));
+  g_assert_cmpint (gst_buffer_deserialize_ml_meta (dest, data, size), ==,
+      n_metas);
+
+  g_bytes_unref (bytes);
+  return dest;
+}
+
+static GstMLClassificationResult *
+test_new_result (const gchar * name, gfloat confidence, guint class_id)
+{
+  GstMLClassificationResult *result = gst_ml_classification_result_new ();
+
+  result->name = name ? strdup (name) : NULL;
+  result->confidence = confidence;
+  result->class_id = class_id;
+  return result;
+}
+
+static void
+test_add_segmentation (GstBuffer * buffer, GstVideoFormat format,
+    guint width, guint height, guint stride)
+{
+  GstMLSegmentationMeta *meta = gst_buffer_add_segmentation_meta (buffer);
+  guint i = 0;
+
+  g_assert_true (gst_ml_segmentation_meta_alloc_mask (meta, NULL,
+      stride * height));
+  for (i = 0; i < stride * height; i++) {
+    ((guint8 *) meta->img_buffer)[i] = (i * 7) & 0xff;
+  }
+
+  meta->img_width = width;
+  meta->img_height = height;
+  meta->img_stride = stride;
+  meta->img_format = format;
+
+  if (format == GST_VIDEO_FORMAT_GRAY8) {
+    meta->palette = (guint32 *) malloc (3 * sizeof (guint32));
+    meta->palette[0] = 0x00000000;
+    meta->palette[1] = 0xff0000ff;
+    meta->palette[2] = 0x00ff00ff;
+    meta->n_colors = 3;
+  }
+}
+
+// Buffer with metadata of every type, used as valid input.
+static GstBuffer *
+test_new_buffer (void)
+{
+  GstBuffer *buffer = gst_buffer_new ();
+  GstMLLabelTable *table = gst_ml_label_table_new (labels, 4);
+  GstMLDetectionMeta *detection = NULL;
+  GstMLDetectionBatchMeta *batch = NULL;
+  GstMLClassificationMeta *classification = NULL;
+  GstMLPoseNetMeta *pose = NULL;
+  GstMLBoundingBox box = { 1, 2, 3, 4 };
+  guint i = 0;
+
+  detection = gst_buffer_add_detection_meta (buffer);
+  detection->bounding_box = box;
+  detection->box_info = g_slist_append (detection->box_info,
+      test_new_result ("dog", 0.75, 12));
+
+  batch = gst_buffer_add_detection_batch_meta (buffer, 4, TRUE, table);
+  for (i = 0; i < 4; i++) {
+    gst_ml_detection_batch_meta_add_box (batch, &box, 0.5, i, 100 + i);
+  }
+
+  test_add_segmentation (buffer, GST_VIDEO_FORMAT_GRAY8, 5, 3, 8);
+
+  classification = gst_buffer_add_classification_meta (buffer);
+  classification->result.name = strdup ("cat");
+  classification->result.confidence = 0.25;
+  classification->result.class_id = 3;
+
+  pose = gst_buffer_add_posenet_meta (buffer);
+  pose->score = 0.5;
+  for (i = 0; i < KEY_POINTS_COUNT; i++) {
+    pose->points[i].x = i;
+    pose->points[i].y = 2 * i;
+    pose->points[i].score = 0.125;
+  }
+
+  gst_ml_label_table_unref (table);
+  return buffer;
+}
+
+static void
+test_detection (void)
+{
+  GstBuffer *src = gst_buffer_new ();
+  GstMLLabelTable *table = gst_ml_label_table_new (labels, 4);
+  GstMLDetectionMeta *meta = gst_buffer_add_detection_meta (src);
+  GstMLClassificationResult *result = NULL;
+  GstBuffer *dest = NULL;
+  gpointer state = NULL;
+  GSList *list = NULL;
+
+  meta->bounding_box.x = 10;
+  meta->bounding_box.y = 20;
+  meta->bounding_box.width = 300;
+  meta->bounding_box.height = 400;
+
+  // Owned name, borrowed label table name and no name at all.
+  meta->box_info = g_slist_append (meta->box_info,
+      test_new_result ("dog", 0.75, 12));
+  result = test_new_result (NULL, 0.5, 0);
+  gst_ml_classification_result_set_label (result, table, 3);
+  meta->box_info = g_slist_append (meta->box_info, result);
+  meta->box_info = g_slist_append (meta->box_info,
+      test_new_result (NULL, 0.25, 7));
+
+  dest = test_round_trip (src, 1);
+  meta = gst_buffer_iterate_detection_meta (dest, &state);
+  g_assert_nonnull (meta);
+  g_assert_null (gst_buffer_iterate_detection_meta (dest, &state));
+
+  g_assert_cmpuint (meta->bounding_box.x, ==, 10);
+  g_assert_cmpuint (meta->bounding_box.y, ==, 20);
+  g_assert_cmpuint (meta->bounding_box.width, ==, 300);
+  g_assert_cmpuint (meta->bounding_box.height, ==, 400);
+  g_assert_cmpuint (g_slist_length (meta->box_info), ==, 3);
+
+  list = meta->box_info;
+  result = (GstMLClassificationResult *) list->data;
+  g_assert_cmpstr (result->name, ==, "dog");
+  g_assert_cmpfloat (result->confidence, ==, 0.75);
+  g_assert_cmpuint (result->class_id, ==, 12);
+
+  list = list->next;
+  result = (GstMLClassificationResult *) list->data;
+  g_assert_cmpstr (result->name, ==, "car");
+  g_assert_cmpfloat (result->confidence, ==, 0.5);
+  g_assert_cmpuint (result->class_id, ==, 3);
+
+  list = list->next;
+  result = (GstMLClassificationResult *) list->data;
+  g_assert_null (result->name);
+  g_assert_cmpfloat (result->confidence, ==, 0.25);
+  g_assert_cmpuint (result->class_id, ==, 7);
+
+  gst_ml_label_table_unref (table);
+  gst_buffer_unref (dest);
+  gst_buffer_unref (src);
+}
+
+static void
+test_detection_batch (void)
+{
+  GstBuffer *src = gst_buffer_new ();
+  GstMLLabelTable *table = gst_ml_label_table_new (labels, 4);
+  GstMLDetectionBatchMeta *meta = NULL;
+  GstBuffer *dest = NULL;
+  // Repeated classes, an unnamed class and one past the table.
+  const guint class_ids[] = { 1, 3, 1, 2, 9, 3, 0 };
+  const guint n_boxes = G_N_ELEMENTS (class_ids);
+  guint i = 0;
+
+  meta = gst_buffer_add_detection_batch_meta (src, n_boxes, TRUE, table);
+  for (i = 0; i < n_boxes; i++) {
+    GstMLBoundingBox box = { i, i + 1, 10 * i, 20 * i };
+    gst_ml_detection_batch_meta_add_box (meta, &box, i / 10.0, class_ids[i],
+        1000 + i);
+  }
+
+  dest = test_round_trip (src, 1);
+  meta = gst_buffer_get_detection_batch_meta (dest);
+  g_assert_nonnull (meta);
+  g_assert_cmpuint (meta->n_boxes, ==, n_boxes);
+  g_assert_nonnull (meta->track_id);
+
+  for (i = 0; i < n_boxes; i++) {
+    g_assert_cmpuint (meta->x[i], ==, i);
+    g_assert_cmpuint (meta->y[i], ==, i + 1);
+    g_assert_cmpuint (meta->width[i], ==, 10 * i);
+    g_assert_cmpuint (meta->height[i], ==, 20 * i);
+    g_assert_cmpfloat (meta->confidence[i], ==, (gfloat) (i / 10.0));
+    g_assert_cmpuint (meta->class_id[i], ==, class_ids[i]);
+    g_assert_cmpuint (meta->track_id[i], ==, 1000 + i);
+    g_assert_cmpstr (gst_ml_detection_batch_meta_get_label (meta, i), ==,
+        class_ids[i] < 4 ? labels[class_ids[i]] : NULL);
+  }
+
+  gst_buffer_unref (dest);
+  gst_buffer_unref (src);
+
+  // Neither track ids nor labels.
+  src = gst_buffer_new ();
+  meta = gst_buffer_add_detection_batch_meta (src, 2, FALSE, NULL);
+  for (i = 0; i < 2; i++) {
+    GstMLBoundingBox box = { 1, 2, 3, 4 };
+    gst_ml_detection_batch_meta_add_box (meta, &box, 0.5, i, 0);
+  }
+
+  dest = test_round_trip (src, 1);
+  meta = gst_buffer_get_detection_batch_meta (dest);
+  g_assert_nonnull (meta);
+  g_assert_cmpuint (meta->n_boxes, ==, 2);
+  g_assert_null (meta->track_id);
+  g_assert_null (gst_ml_detection_batch_meta_get_label (meta, 0));
+  g_assert_cmpuint (meta->class_id[1], ==, 1);
+
+  gst_ml_label_table_unref (table);
+  gst_buffer_unref (dest);
+  gst_buffer_unref (src);
+}
+
+static void
+test_segmentation (void)
+{
+  GstBuffer *src = gst_buffer_new ();
+  GstMLSegmentationMeta *smeta = NULL, *dmeta = NULL;
+  GstBuffer *dest = NULL;
+  gpointer state = NULL;
+
+  // Class map with padded lines and an RGBA mask.
+  test_add_segmentation (src, GST_VIDEO_FORMAT_GRAY8, 5, 3, 8);
+  test_add_segmentation (src, GST_VIDEO_FORMAT_RGBA, 4, 2, 16);
+
+  dest = test_round_trip (src, 2);
+
+  while ((smeta = gst_buffer_iterate_segmentation_meta (src, &state))) {
+    gpointer dstate = NULL;
+
+    // Order is not part of the format, match the metas by format.
+    while ((dmeta = gst_buffer_iterate_segmentation_meta (dest, &dstate))) {
+      if (dmeta->img_format == smeta->img_format) {
+        break;
+      }
+    }
+
+    g_assert_nonnull (dmeta);
+    g_assert_cmpuint (dmeta->img_width, ==, smeta->img_width);
+    g_assert_cmpuint (dmeta->img_height, ==, smeta->img_height);
+    g_assert_cmpuint (dmeta->img_stride, ==, smeta->img_stride);
+    g_assert_cmpuint (dmeta->img_size, ==, smeta->img_size);
+    g_assert_cmpmem (dmeta->img_buffer, dmeta->img_size, smeta->img_buffer,
+        smeta->img_size);
+    g_assert_cmpuint (dmeta->n_colors, ==, smeta->n_colors);
+    if (smeta->n_colors > 0) {
+      g_assert_cmpmem (dmeta->palette, dmeta->n_colors * sizeof (guint32),
+          smeta->palette, smeta->n_colors * sizeof (guint32));
+    }
+  }
+
+  gst_buffer_unref (dest);
+  gst_buffer_unref (src);
+
+  // Meta without image keeps its geometry only.
+  src = gst_buffer_new ();
+  smeta = gst_buffer_add_segmentation_meta (src);
+  smeta->img_width = 4;
+  smeta->img_height = 4;
+
+  dest = test_round_trip (src, 1);
+  state = NULL;
+  dmeta = gst_buffer_iterate_segmentation_meta (dest, &state);
+  g_assert_nonnull (dmeta);
+  g_assert_null (dmeta->img_buffer);
+  g_assert_cmpuint (dmeta->img_size, ==, 0);
+  g_assert_cmpuint (dmeta->img_width, ==, 4);
+
+  gst_buffer_unref (dest);
+  gst_buffer_unref (src);
+}
+
+static void
+test_classification (void)
+{
+  GstBuffer *src = gst_buffer_new ();
+  GstMLClassificationMeta *meta = gst_buffer_add_classification_meta (src);
+  GstBuffer *dest = NULL;
+  gpointer state = NULL;
+
+  meta->result.name = strdup ("cat");
+  meta->result.confidence = 0.625;
+  meta->result.class_id = 281;
+
+  dest = test_round_trip (src, 1);
+  meta = gst_buffer_iterate_classification_meta (dest, &state);
+  g_assert_nonnull (meta);
+  g_assert_cmpstr (meta->result.name, ==, "cat");
+  g_assert_cmpfloat (meta->result.confidence, ==, 0.625);
+  g_assert_cmpuint (meta->result.class_id, ==, 281);
+  g_assert_null (meta->result.labels);
+
+  gst_buffer_unref (dest);
+  gst_buffer_unref (src);
+}
+
+static void
+test_posenet (void)
+{
+  GstBuffer *src = gst_buffer_new ();
+  GstMLPoseNetMeta *meta = gst_buffer_add_posenet_meta (src);
+  GstBuffer *dest = NULL;
+  gpointer state = NULL;
+  guint i = 0;
+
+  meta->score = 0.875;
+  for (i = 0; i < KEY_POINTS_COUNT; i++) {
+    // Key points may lie outside of the frame.
+    meta->points[i].x = (gint) i - 5;
+    meta->points[i].y = 3 * i;
+    meta->points[i].score = i / 32.0;
+  }
+
+  dest = test_round_trip (src, 1);
+  meta = gst_buffer_iterate_posenet_meta (dest, &state);
+  g_assert_nonnull (meta);
+  g_assert_cmpfloat (meta->score, ==, 0.875);
+  for (i = 0; i < KEY_POINTS_COUNT; i++) {
+    g_assert_cmpint (meta->points[i].x, ==, (gint) i - 5);
+    g_assert_cmpint (meta->points[i].y, ==, 3 * i);
+    g_assert_cmpfloat (meta->points[i].score, ==, (gfloat) (i / 32.0));
+  }
+
+  gst_buffer_unref (dest);
+  gst_buffer_unref (src);
+}
+
+static void
+test_all (void)
+{
+  GstBuffer *src = test_new_buffer ();
+  GstBuffer *dest = test_round_trip (src, 5);
+
+  g_assert_cmpuint (gst_buffer_get_n_ml_meta (dest,
+      GST_ML_DETECTION_API_TYPE), ==, 1);
+  g_assert_cmpuint (gst_buffer_get_n_ml_meta (dest,
+      GST_ML_DETECTION_BATCH_API_TYPE), ==, 1);
+  g_assert_cmpuint (gst_buffer_get_n_ml_meta (dest,
+      GST_ML_SEGMENTATION_API_TYPE), ==, 1);
+  g_assert_cmpuint (gst_buffer_get_n_ml_meta (dest,
+      GST_ML_CLASSIFICATION_API_TYPE), ==, 1);
+  g_assert_cmpuint (gst_buffer_get_n_ml_meta (dest,
+      GST_ML_POSENET_API_TYPE), ==, 1);
+
+  gst_buffer_unref (dest);
+  gst_buffer_unref (src);
+}
+
+static void
+test_short_output (void)
+{
+  GstBuffer *buffer = test_new_buffer ();
+  gsize size = gst_buffer_serialize_ml_meta (buffer, NULL, 0);
+  guint8 *data = (guint8 *) g_malloc (size + 16);
+  gsize i = 0;
+
+  // Nothing is written past the given size, the required size is returned.
+  memset (data, 0xa5, size + 16);
+  g_assert_cmpuint (gst_buffer_serialize_ml_meta (buffer, data, size - 1), ==,
+      size);
+  for (i = size - 1; i < size + 16; i++) {
+    g_assert_cmpuint (data[i], ==, 0xa5);
+  }
+
+  g_assert_cmpuint (gst_buffer_serialize_ml_meta (buffer, data, size), ==,
+      size);
+  g_assert_cmpuint (data[size], ==, 0xa5);
+  g_assert_cmpint (test_deserialize (data, size), ==, 5);
+
+  g_free (data);
+  gst_buffer_unref (buffer);
+}
+
+static void
+test_truncated (void)
+{
+  GstBuffer *buffer = test_new_buffer ();
+  GBytes *bytes = gst_buffer_serialize_ml_meta_to_bytes (buffer);
+  gsize size = 0, i = 0;
+  const guint8 *data = (const guint8 *) g_bytes_get_data (bytes, &size);
+
+  // Every prefix misses part of a record or a whole one. Prefixes are
+  // copied so reads past them hit the end of the allocation.
+  for (i = 0; i < size; i++) {
+    guint8 *copy = (guint8 *) g_malloc (MAX (i, 1));
+
+    memcpy (copy, data, i);
+    g_assert_cmpint (test_deserialize (copy, i), ==, -1);
+    g_free (copy);
+  }
+  g_assert_cmpint (test_deserialize (data, size), ==, 5);
+
+  g_bytes_unref (bytes);
+  gst_buffer_unref (buffer);
+}
+
+static void
+test_corrupt_header (void)
+{
+  GstBuffer *buffer = test_new_buffer ();
+  GBytes *bytes = gst_buffer_serialize_ml_meta_to_bytes (buffer);
+  gsize size = 0;
+  guint8 *data = (guint8 *) g_bytes_unref_to_data (bytes, &size);
+
+  data[0] ^= 0xff;
+  g_assert_cmpint (test_deserialize (data, size), ==, -1);
+  data[0] ^= 0xff;
+
+  GST_WRITE_UINT16_LE (data + 4, 0);
+  g_assert_cmpint (test_deserialize (data, size), ==, -1);
+  GST_WRITE_UINT16_LE (data + 4, GST_ML_META_SERIAL_VERSION + 1);
+  g_assert_cmpint (test_deserialize (data, size), ==, -1);
+  GST_WRITE_UINT16_LE (data + 4, GST_ML_META_SERIAL_VERSION);
+
+  // More records announced than present.
+  GST_WRITE_UINT32_LE (data + 8, 6);
+  g_assert_cmpint (test_deserialize (data, size), ==, -1);
+  GST_WRITE_UINT32_LE (data + 8, 5);
+  g_assert_cmpint (test_deserialize (data, size), ==, 5);
+
+  g_free (data);
+  gst_buffer_unref (buffer);
+}
+
+static void
+test_corrupt_records (void)
+{
+  TestWriter writer;
+
+  // Unknown record types are skipped.
+  writer.array = g_byte_array_new ();
+  test_put_header (&writer, GST_ML_META_SERIAL_VERSION, 2);
+  test_put_record (&writer, 200, 0, 4);
+  test_put_uint32 (&writer, 0);
+  test_put_segmentation (&writer, 4, 2, 4, GST_VIDEO_FORMAT_GRAY8, 8);
+  g_assert_cmpint (test_deserialize_array (writer.array), ==, 1);
+  g_byte_array_unref (writer.array);
+
+  // Record longer than the data.
+  writer.array = g_byte_array_new ();
+  test_put_header (&writer, GST_ML_META_SERIAL_VERSION, 1);
+  test_put_record (&writer, GST_ML_META_SERIAL_CLASSIFICATION, 0, 1000);
+  test_put_uint32 (&writer, 0);
+  g_assert_cmpint (test_deserialize_array (writer.array), ==, -1);
+  g_byte_array_unref (writer.array);
+
+  // Payload shorter than its own fields claim.
+  writer.array = g_byte_array_new ();
+  test_put_header (&writer, GST_ML_META_SERIAL_VERSION, 1);
+  test_put_record (&writer, GST_ML_META_SERIAL_DETECTION, 0, 20);
+  test_put_uint32 (&writer, 1);
+  test_put_uint32 (&writer, 2);
+  test_put_uint32 (&writer, 3);
+  test_put_uint32 (&writer, 4);
+  test_put_uint32 (&writer, 1000000);
+  g_assert_cmpint (test_deserialize_array (writer.array), ==, -1);
+  g_byte_array_unref (writer.array);
+
+  // Box count beyond the payload.
+  writer.array = g_byte_array_new ();
+  test_put_header (&writer, GST_ML_META_SERIAL_VERSION, 1);
+  test_put_record (&writer, GST_ML_META_SERIAL_DETECTION_BATCH, 0, 8);
+  test_put_uint32 (&writer, G_MAXUINT32);
+  test_put_uint32 (&writer, 0);
+  g_assert_cmpint (test_deserialize_array (writer.array), ==, -1);
+  g_byte_array_unref (writer.array);
+
+  // Label count beyond the payload.
+  writer.array = g_byte_array_new ();
+  test_put_header (&writer, GST_ML_META_SERIAL_VERSION, 1);
+  test_put_record (&writer, GST_ML_META_SERIAL_DETECTION_BATCH, 0, 8);
+  test_put_uint32 (&writer, 0);
+  test_put_uint32 (&writer, G_MAXUINT32);
+  g_assert_cmpint (test_deserialize_array (writer.array), ==, -1);
+  g_byte_array_unref (writer.array);
+
+  // Class id too large for a label table.
+  writer.array = g_byte_array_new ();
+  test_put_header (&writer, GST_ML_META_SERIAL_VERSION, 1);
+  test_put_record (&writer, GST_ML_META_SERIAL_DETECTION_BATCH, 0, 17);
+  test_put_uint32 (&writer, 0);
+  test_put_uint32 (&writer, 1);
+  test_put_uint32 (&writer, G_MAXUINT32);
+  test_put_uint16 (&writer, 1);
+  test_put_uint8 (&writer, 'a');
+  g_assert_cmpint (test_deserialize_array (writer.array), ==, -1);
+  g_byte_array_unref (writer.array);
+}
+
+static void
+test_corrupt_segmentation (void)
+{
+  const struct {
+    guint32 width, height, stride, format, size;
+    gint result;
+  } cases[] = {
+    // Valid, padded lines and tightly packed lines.
+    { 3, 2, 4, GST_VIDEO_FORMAT_GRAY8, 8, 1 },
+    { 4, 2, 0, GST_VIDEO_FORMAT_GRAY8, 8, 1 },
+    { 2, 2, 8, GST_VIDEO_FORMAT_RGBA, 16, 1 },
+    // Lines past the pixel data.
+    { 4, 4, 4, GST_VIDEO_FORMAT_GRAY8, 12, -1 },
+    { 4, 3, 0, GST_VIDEO_FORMAT_RGBA, 32, -1 },
+    // Stride shorter than a line.
+    { 8, 2, 4, GST_VIDEO_FORMAT_GRAY8, 16, -1 },
+    { 4, 1, 8, GST_VIDEO_FORMAT_RGBA, 16, -1 },
+    // Stride times height overflows 32 bits.
+    { 1, 0x10000, 0x10000, GST_VIDEO_FORMAT_GRAY8, 16, -1 },
+    { 1, 0x10001, 0xffff, GST_VIDEO_FORMAT_GRAY8, 16, -1 },
+    // Empty geometry with pixels.
+    { 0, 2, 4, GST_VIDEO_FORMAT_GRAY8, 8, -1 },
+    { 4, 0, 4, GST_VIDEO_FORMAT_GRAY8, 8, -1 },
+    // Unknown, multi plane and out of range formats.
+    { 4, 2, 4, GST_VIDEO_FORMAT_UNKNOWN, 8, -1 },
+    { 4, 2, 4, GST_VIDEO_FORMAT_NV12, 16, -1 },
+    { 4, 2, 4, 0x7fffffff, 8, -1 },
+  };
+  guint i = 0;
+
+  for (i = 0; i < G_N_ELEMENTS (cases); i++) {
+    TestWriter writer;
+
+    writer.array = g_byte_array_new ();
+    test_put_header (&writer, GST_ML_META_SERIAL_VERSION, 1);
+    test_put_segmentation (&writer, cases[i].width, cases[i].height,
+        cases[i].stride, cases[i].format, cases[i].size);
+
+    g_test_message ("case %u", i);
+    g_assert_cmpint (test_deserialize_array (writer.array), ==,
+        cases[i].result);
+    g_byte_array_unref (writer.array);
+  }
+}
+
+// Whether the attached segmentation images can be indexed safely.
+static void
+test_check_segmentation (GstBuffer * buffer)
+{
+  GstMLSegmentationMeta *meta = NULL;
+  gpointer state = NULL;
+
+  while ((meta = gst_buffer_iterate_segmentation_meta (buffer, &state))) {
+    if (meta->img_buffer == NULL) {
+      continue;
+    }
+    g_assert_cmpuint (meta->img_width, >, 0);
+    g_assert_cmpuint ((guint64) meta->img_stride * meta->img_height, <=,
+        meta->img_size);
+  }
+}
+
+static void
+test_corrupt_bytes (void)
+{
+  GstBuffer *buffer = test_new_buffer ();
+  GBytes *bytes = gst_buffer_serialize_ml_meta_to_bytes (buffer);
+  gsize size = 0, i = 0;
+  guint8 *data = (guint8 *) g_bytes_unref_to_data (bytes, &size);
+  const guint8 patterns[] = { 0xff, 0x80, 0x01 };
+
+  // Any single corrupt byte either parses or fails cleanly, never leaves
+  // metadata consumers would read out of bounds.
+  for (i = 0; i < size; i++) {
+    guint j = 0;
+
+    for (j = 0; j < G_N_ELEMENTS (patterns); j++) {
+      GstBuffer *dest = gst_buffer_new ();
+      gint n_metas = 0;
+
+      data[i] ^= patterns[j];
+      n_metas = gst_buffer_deserialize_ml_meta (dest, data, size);
+      data[i] ^= patterns[j];
+
+      g_assert_cmpint (n_metas, >=, -1);
+      g_assert_cmpint (n_metas, <=, 5);
+      test_check_segmentation (dest);
+      gst_buffer_unref (dest);
+    }
+  }
+
+  g_free (data);
+  gst_buffer_unref (buffer);
+}
+
+int
+main (int argc, char ** argv)
+{
+  gst_init (&argc, &argv);
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/ml-meta/serialize/detection", test_detection);
+  g_test_add_func ("/ml-meta/serialize/detection-batch",
+      test_detection_batch);
+  g_test_add_func ("/ml-meta/serialize/segmentation", test_segmentation);
+  g_test_add_func ("/ml-meta/serialize/classification",
+      test_classification);
+  g_test_add_func ("/ml-meta/serialize/posenet", test_posenet);
+  g_test_add_func ("/ml-meta/serialize/all", test_all);
+  g_test_add_func ("/ml-meta/serialize/short-output", test_short_output);
+  g_test_add_func ("/ml-meta/deserialize/truncated", test_truncated);
+  g_test_add_func ("/ml-meta/deserialize/corrupt-header",
+      test_corrupt_header);
+  g_test_add_func ("/ml-meta/deserialize/corrupt-records",
+      test_corrupt_records);
+  g_test_add_func ("/ml-meta/deserialize/corrupt-segmentation",
+      test_corrupt_segmentation);
+  g_test_add_func ("/ml-meta/deserialize/corrupt-bytes", test_corrupt_bytes);
+
+  return g_test_run ();
+}
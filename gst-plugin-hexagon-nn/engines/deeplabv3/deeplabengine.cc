@@ -191,6 +191,19 @@ int32_t DeepLabv3Engine::Init(const NNSourceInfo* source_info)
     return NN_FAIL;
   }
 
+  // Prefer ION on target, memfd is available on any Linux system.
+  uint32_t mask_size = scale_width_ * scale_height_ * kOutBytesPerPixel;
+  mask_pool_ = gst_ml_mask_pool_new_configured (GST_ML_MASK_POOL_TYPE_ION,
+      mask_size, kMaskPoolMinBuffers, kMaskPoolMaxBuffers);
+  if (nullptr == mask_pool_) {
+    mask_pool_ = gst_ml_mask_pool_new_configured (
+        GST_ML_MASK_POOL_TYPE_MEMFD, mask_size, kMaskPoolMinBuffers,
+        kMaskPoolMaxBuffers);
+  }
+  if (nullptr == mask_pool_) {
+    ALOGE("Failed to create mask pool, using heap memory");
+  }
+
   for (uint32_t i = 0; i < scale_width_ * scale_height_; i++) {
     ((uint32_t*)result_buff_)[i] =
         static_cast<uint32_t>(color_table[0].red)  |
@@ -209,6 +222,13 @@ void DeepLabv3Engine::DeInit()
     result_buff_ = nullptr;
   }
 
+  // Masks still attached to buffers keep the pool alive until released.
+  if (nullptr != mask_pool_) {
+    gst_buffer_pool_set_active (mask_pool_, FALSE);
+    gst_object_unref (mask_pool_);
+    mask_pool_ = nullptr;
+  }
+
   EngineDeInit();
 }
 
@@ -222,17 +242,15 @@ void * DeepLabv3Engine::GenerateMeta(GstBuffer * gst_buffer)
 
   uint32_t image_size = scale_width_ * scale_height_ * kOutBytesPerPixel;
 
-  if (img_meta->img_buffer == nullptr) {
-    img_meta->img_buffer = (gpointer) calloc (1, image_size);
-    if (!img_meta->img_buffer) {
-      ALOGE(" Failed to allocate image buffer");
-      return nullptr;
-    }
+  // Mask buffers are recycled through the pool once the meta is freed.
+  if (!gst_ml_segmentation_meta_alloc_mask (img_meta, mask_pool_,
+      image_size)) {
+    ALOGE(" Failed to allocate image buffer");
+    return nullptr;
   }
 
   img_meta->img_width  = scale_width_;
   img_meta->img_height = scale_height_;
-  img_meta->img_size   = image_size;
   img_meta->img_format = GST_VIDEO_FORMAT_RGBA;
   img_meta->img_stride = scale_width_ * kOutBytesPerPixel;
 
@@ -30,13 +30,17 @@
 #ifndef DEEPLABENGINE_H
 #define DEEPLABENGINE_H
 
+#include <ml-meta/ml_mask_pool.h>
+
 #include "nnengine.h"
 
 class DeepLabv3Engine : public NNEngine {
 public:
 
   DeepLabv3Engine ()
-          : NNEngine(kModelLib, kPadWidth, kPadHeight, kNumOutputs, kInFormat)
+          : NNEngine(kModelLib, kPadWidth, kPadHeight, kNumOutputs, kInFormat),
+            result_buff_(nullptr),
+            mask_pool_(nullptr)
             {};
 
   int32_t Init(const NNSourceInfo* pSourceInfo) override;
@@ -66,9 +70,16 @@ private:
   static const uint32_t       kOutSize0         =
                                 kPadWidth * kPadHeight * kOutBytesPerPixel;
 
+  // segmentation mask pool
+  static const uint32_t       kMaskPoolMinBuffers = 2;
+  static const uint32_t       kMaskPoolMaxBuffers = 4;
+
   // local copy of inference result for async oprating mode
   uint8_t*                    result_buff_;
   std::mutex                  lock_;
+
+  // fd backed buffers recycled as segmentation masks
+  GstBufferPool*              mask_pool_;
 };
 
 #endif // DEEPLABENGINE_H
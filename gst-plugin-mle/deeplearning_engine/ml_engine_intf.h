@@ -87,7 +87,9 @@ enum class EngineOutput {
   kSingle = 0,
   kMulti,
   kSqueezenet,
-  kSingleSSD
+  kSingleSSD,
+  kSegmentation,
+  kPoseNet
 };
 
 enum class PreprocessingMode {
@@ -154,6 +156,12 @@ struct MLConfig {
   uint32_t number_of_threads;
   uint32_t use_nnapi;
 
+  //pose estimation
+  uint32_t max_poses;
+
+  //detection
+  uint32_t batch_detections;
+
   //snpe layers
   std::string input_layer;
   std::vector<std::string> output_layers;
@@ -0,0 +1,618 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <cstdlib>
+#include <cstring>
+#include <cfloat>
+#include <cmath>
+#include <algorithm>
+#include <queue>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "common_utils.h"
+#include "postprocess_utils.h"
+
+namespace mle {
+
+template <typename T>
+static inline uint8_t ClampClassIndex(const T index) {
+  if (index <= 0) {
+    return 0;
+  }
+  return (index < static_cast<T>(kMaxSegmentationClasses)) ?
+      static_cast<uint8_t>(index) : kMaxSegmentationClasses - 1;
+}
+
+static inline uint8_t ArgMaxScalar(const float* data, uint32_t start,
+                                   const uint32_t channels, uint32_t best_idx,
+                                   float best) {
+  for (uint32_t c = start; c < channels; c++) {
+    if (data[c] > best) {
+      best = data[c];
+      best_idx = c;
+    }
+  }
+  return static_cast<uint8_t>(best_idx);
+}
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+static inline uint8_t ArgMaxPixel(const float* data, const uint32_t channels) {
+  float32x4_t vmax = vdupq_n_f32(-FLT_MAX);
+  uint32x4_t vidx = vdupq_n_u32(0);
+  const uint32_t init[4] = {0, 1, 2, 3};
+  uint32x4_t vcur = vld1q_u32(init);
+  const uint32x4_t vstep = vdupq_n_u32(4);
+  uint32_t c = 0;
+
+  for (; c + 4 <= channels; c += 4) {
+    float32x4_t v = vld1q_f32(data + c);
+    uint32x4_t gt = vcgtq_f32(v, vmax);
+    vmax = vbslq_f32(gt, v, vmax);
+    vidx = vbslq_u32(gt, vcur, vidx);
+    vcur = vaddq_u32(vcur, vstep);
+  }
+
+  float lanes[4];
+  uint32_t indices[4];
+  vst1q_f32(lanes, vmax);
+  vst1q_u32(indices, vidx);
+
+  float best = lanes[0];
+  uint32_t best_idx = indices[0];
+  for (uint32_t l = 1; l < 4; l++) {
+    if (lanes[l] > best || (lanes[l] == best && indices[l] < best_idx)) {
+      best = lanes[l];
+      best_idx = indices[l];
+    }
+  }
+  return ArgMaxScalar(data, c, channels, best_idx, best);
+}
+#elif defined(__SSE2__)
+static inline uint8_t ArgMaxPixel(const float* data, const uint32_t channels) {
+  __m128 vmax = _mm_set1_ps(-FLT_MAX);
+  __m128i vidx = _mm_setzero_si128();
+  __m128i vcur = _mm_setr_epi32(0, 1, 2, 3);
+  const __m128i vstep = _mm_set1_epi32(4);
+  uint32_t c = 0;
+
+  for (; c + 4 <= channels; c += 4) {
+    __m128 v = _mm_loadu_ps(data + c);
+    __m128i gt = _mm_castps_si128(_mm_cmpgt_ps(v, vmax));
+    vmax = _mm_max_ps(v, vmax);
+    vidx = _mm_or_si128(_mm_and_si128(gt, vcur), _mm_andnot_si128(gt, vidx));
+    vcur = _mm_add_epi32(vcur, vstep);
+  }
+
+  float lanes[4];
+  uint32_t indices[4];
+  _mm_storeu_ps(lanes, vmax);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(indices), vidx);
+
+  float best = lanes[0];
+  uint32_t best_idx = indices[0];
+  for (uint32_t l = 1; l < 4; l++) {
+    if (lanes[l] > best || (lanes[l] == best && indices[l] < best_idx)) {
+      best = lanes[l];
+      best_idx = indices[l];
+    }
+  }
+  return ArgMaxScalar(data, c, channels, best_idx, best);
+}
+#else
+static inline uint8_t ArgMaxPixel(const float* data, const uint32_t channels) {
+  return ArgMaxScalar(data, 1, channels, 0, data[0]);
+}
+#endif
+
+void ArgMaxChannels(const float* data, const uint32_t num_pixels,
+                    const uint32_t channels, uint8_t* classes) {
+  if (channels == 1) {
+    // Model already contains the argmax layer.
+    for (uint32_t i = 0; i < num_pixels; i++) {
+      classes[i] = ClampClassIndex(data[i]);
+    }
+    return;
+  }
+
+  for (uint32_t i = 0; i < num_pixels; i++, data += channels) {
+    classes[i] = ArgMaxPixel(data, channels);
+  }
+}
+
+void ArgMaxChannels(const uint8_t* data, const uint32_t num_pixels,
+                    const uint32_t channels, uint8_t* classes) {
+  if (channels == 1) {
+    memcpy(classes, data, num_pixels);
+    return;
+  }
+
+  for (uint32_t i = 0; i < num_pixels; i++, data += channels) {
+    uint32_t c = 0;
+    uint8_t best = 0;
+#if defined(__aarch64__)
+    // Find the max value of the pixel 16 channels at a time and
+    // then look up its position.
+    uint8x16_t vmax = vdupq_n_u8(0);
+    for (; c + 16 <= channels; c += 16) {
+      vmax = vmaxq_u8(vmax, vld1q_u8(data + c));
+    }
+    best = vmaxvq_u8(vmax);
+#endif
+    for (; c < channels; c++) {
+      best = data[c] > best ? data[c] : best;
+    }
+    classes[i] = static_cast<uint8_t>(
+        static_cast<const uint8_t*>(memchr(data, best, channels)) - data);
+  }
+}
+
+void ClassIndices(const int32_t* indices, const uint32_t num_pixels,
+                  uint8_t* classes) {
+  for (uint32_t i = 0; i < num_pixels; i++) {
+    classes[i] = ClampClassIndex(indices[i]);
+  }
+}
+
+void ClassIndices(const int64_t* indices, const uint32_t num_pixels,
+                  uint8_t* classes) {
+  for (uint32_t i = 0; i < num_pixels; i++) {
+    classes[i] = ClampClassIndex(indices[i]);
+  }
+}
+
+static inline void ArgMaxPerChannelScalar(const float* data,
+                                          const uint32_t num_pixels,
+                                          const uint32_t channels,
+                                          const uint32_t start,
+                                          float* max_values,
+                                          uint32_t* max_indices) {
+  for (uint32_t c = start; c < channels; c++) {
+    max_values[c] = data[c];
+    max_indices[c] = 0;
+  }
+  for (uint32_t i = 1; i < num_pixels; i++) {
+    const float* pixel = data + i * channels;
+    for (uint32_t c = start; c < channels; c++) {
+      if (pixel[c] > max_values[c]) {
+        max_values[c] = pixel[c];
+        max_indices[c] = i;
+      }
+    }
+  }
+}
+
+void ArgMaxPerChannel(const float* data, const uint32_t num_pixels,
+                      const uint32_t channels, float* max_values,
+                      uint32_t* max_indices) {
+  uint32_t c = 0;
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+  for (; c + 4 <= channels; c += 4) {
+    float32x4_t vmax = vld1q_f32(data + c);
+    uint32x4_t vidx = vdupq_n_u32(0);
+    for (uint32_t i = 1; i < num_pixels; i++) {
+      float32x4_t v = vld1q_f32(data + i * channels + c);
+      uint32x4_t gt = vcgtq_f32(v, vmax);
+      vmax = vbslq_f32(gt, v, vmax);
+      vidx = vbslq_u32(gt, vdupq_n_u32(i), vidx);
+    }
+    vst1q_f32(max_values + c, vmax);
+    vst1q_u32(max_indices + c, vidx);
+  }
+#elif defined(__SSE2__)
+  for (; c + 4 <= channels; c += 4) {
+    __m128 vmax = _mm_loadu_ps(data + c);
+    __m128i vidx = _mm_setzero_si128();
+    for (uint32_t i = 1; i < num_pixels; i++) {
+      __m128 v = _mm_loadu_ps(data + i * channels + c);
+      __m128i gt = _mm_castps_si128(_mm_cmpgt_ps(v, vmax));
+      __m128i vcur = _mm_set1_epi32(i);
+      vmax = _mm_max_ps(v, vmax);
+      vidx = _mm_or_si128(_mm_and_si128(gt, vcur), _mm_andnot_si128(gt, vidx));
+    }
+    _mm_storeu_ps(max_values + c, vmax);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(max_indices + c), vidx);
+  }
+#endif
+
+  if (c < channels) {
+    ArgMaxPerChannelScalar(data, num_pixels, channels, c, max_values,
+                           max_indices);
+  }
+}
+
+// Parent -> child keypoint pairs of the PoseNet skeleton, ordered from the
+// nose outwards.
+static const uint32_t kPoseEdges[][2] = {
+  {NOSE, LEFT_EYE}, {LEFT_EYE, LEFT_EAR}, {NOSE, RIGHT_EYE},
+  {RIGHT_EYE, RIGHT_EAR}, {NOSE, LEFT_SHOULDER},
+  {LEFT_SHOULDER, LEFT_ELBOW}, {LEFT_ELBOW, LEFT_WRIST},
+  {LEFT_SHOULDER, LEFT_HIP}, {LEFT_HIP, LEFT_KNEE},
+  {LEFT_KNEE, LEFT_ANKLE}, {NOSE, RIGHT_SHOULDER},
+  {RIGHT_SHOULDER, RIGHT_ELBOW}, {RIGHT_ELBOW, RIGHT_WRIST},
+  {RIGHT_SHOULDER, RIGHT_HIP}, {RIGHT_HIP, RIGHT_KNEE},
+  {RIGHT_KNEE, RIGHT_ANKLE}
+};
+static const uint32_t kNumPoseEdges = sizeof(kPoseEdges) / sizeof(kPoseEdges[0]);
+static const uint32_t kOffsetRefineSteps = 2;
+static const int32_t kLocalMaximumRadius = 1;
+
+struct PosePart {
+  float score;
+  uint32_t y;
+  uint32_t x;
+  uint32_t id;
+  bool operator<(const PosePart& other) const { return score < other.score; }
+};
+
+static inline float Sigmoid(const float x) {
+  return 1.0f / (1.0f + std::exp(-x));
+}
+
+static inline uint32_t Clamp(const float value, const uint32_t max) {
+  int32_t v = static_cast<int32_t>(std::lround(value));
+  if (v < 0) {
+    return 0;
+  }
+  return (static_cast<uint32_t>(v) > max) ? max : static_cast<uint32_t>(v);
+}
+
+// Image position of a keypoint located in heatmap cell (y, x).
+static inline void KeypointPosition(const PoseNetOutputs& out,
+                                    const uint32_t y, const uint32_t x,
+                                    const uint32_t id, PoseKeypoint& kp) {
+  const float* offsets =
+      out.offsets + (y * out.width + x) * KEY_POINTS_COUNT * 2;
+  kp.y = y * out.output_stride + offsets[id];
+  kp.x = x * out.output_stride + offsets[id + KEY_POINTS_COUNT];
+}
+
+static bool IsLocalMaximum(const PoseNetOutputs& out, const PosePart& part,
+                           const float logit) {
+  const int32_t py = part.y, px = part.x;
+  int32_t y_start = std::max<int32_t>(py - kLocalMaximumRadius, 0);
+  int32_t y_end = std::min<int32_t>(py + kLocalMaximumRadius + 1, out.height);
+  int32_t x_start = std::max<int32_t>(px - kLocalMaximumRadius, 0);
+  int32_t x_end = std::min<int32_t>(px + kLocalMaximumRadius + 1, out.width);
+
+  for (int32_t y = y_start; y < y_end; y++) {
+    for (int32_t x = x_start; x < x_end; x++) {
+      if (out.heatmaps[(y * out.width + x) * KEY_POINTS_COUNT + part.id] >
+          logit) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static bool WithinNmsRadius(const std::vector<Pose>& poses,
+                            const float squared_radius,
+                            const PoseKeypoint& kp, const uint32_t id) {
+  for (const auto& pose : poses) {
+    float dy = pose.keypoints[id].y - kp.y;
+    float dx = pose.keypoints[id].x - kp.x;
+    if (dy * dy + dx * dx <= squared_radius) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Follows the displacement field of an edge from the source keypoint and
+// refines the landing point with the target keypoint offsets.
+static void TraverseToTarget(const PoseNetOutputs& out,
+                             const float* displacements, const uint32_t edge,
+                             const PoseKeypoint& source,
+                             const uint32_t target_id, PoseKeypoint& target) {
+  const uint32_t max_y = out.height - 1;
+  const uint32_t max_x = out.width - 1;
+  const float stride = out.output_stride;
+
+  uint32_t y = Clamp(source.y / stride, max_y);
+  uint32_t x = Clamp(source.x / stride, max_x);
+  const float* displacement =
+      displacements + (y * out.width + x) * kNumPoseEdges * 2;
+
+  target.y = source.y + displacement[edge];
+  target.x = source.x + displacement[edge + kNumPoseEdges];
+
+  for (uint32_t step = 0; step < kOffsetRefineSteps; step++) {
+    y = Clamp(target.y / stride, max_y);
+    x = Clamp(target.x / stride, max_x);
+    KeypointPosition(out, y, x, target_id, target);
+  }
+
+  y = Clamp(target.y / stride, max_y);
+  x = Clamp(target.x / stride, max_x);
+  target.score = Sigmoid(
+      out.heatmaps[(y * out.width + x) * KEY_POINTS_COUNT + target_id]);
+}
+
+static void DecodeSinglePose(const PoseNetOutputs& out,
+                             const float score_threshold,
+                             std::vector<Pose>& poses) {
+  float max_values[KEY_POINTS_COUNT];
+  uint32_t max_indices[KEY_POINTS_COUNT];
+
+  ArgMaxPerChannel(out.heatmaps, out.height * out.width, KEY_POINTS_COUNT,
+                   max_values, max_indices);
+
+  Pose pose;
+  pose.score = 0.0;
+  for (uint32_t id = 0; id < KEY_POINTS_COUNT; id++) {
+    PoseKeypoint& kp = pose.keypoints[id];
+    KeypointPosition(out, max_indices[id] / out.width,
+                     max_indices[id] % out.width, id, kp);
+    kp.score = Sigmoid(max_values[id]);
+    pose.score += kp.score;
+  }
+  pose.score /= KEY_POINTS_COUNT;
+
+  if (pose.score >= score_threshold) {
+    poses.push_back(pose);
+  }
+}
+
+static void DecodeMultiplePoses(const PoseNetOutputs& out,
+                                const uint32_t max_poses,
+                                const float score_threshold,
+                                const float nms_radius,
+                                std::vector<Pose>& poses) {
+  // Sigmoid is monotonic, so candidates are selected on the raw logits
+  // and only the scores of the chosen keypoints are converted.
+  const float threshold = (score_threshold <= 0.0) ? -FLT_MAX :
+      (score_threshold >= 1.0) ? FLT_MAX :
+      std::log(score_threshold / (1.0f - score_threshold));
+  const float squared_radius = nms_radius * nms_radius;
+  std::priority_queue<PosePart> queue;
+
+  for (uint32_t y = 0; y < out.height; y++) {
+    for (uint32_t x = 0; x < out.width; x++) {
+      const float* logits = out.heatmaps + (y * out.width + x) * KEY_POINTS_COUNT;
+      for (uint32_t id = 0; id < KEY_POINTS_COUNT; id++) {
+        if (logits[id] < threshold) {
+          continue;
+        }
+        PosePart part = { logits[id], y, x, id };
+        if (IsLocalMaximum(out, part, logits[id])) {
+          queue.push(part);
+        }
+      }
+    }
+  }
+
+  while (poses.size() < max_poses && !queue.empty()) {
+    PosePart root = queue.top();
+    queue.pop();
+
+    PoseKeypoint root_kp;
+    KeypointPosition(out, root.y, root.x, root.id, root_kp);
+    if (WithinNmsRadius(poses, squared_radius, root_kp, root.id)) {
+      continue;
+    }
+
+    Pose pose;
+    bool decoded[KEY_POINTS_COUNT] = { false };
+    root_kp.score = Sigmoid(root.score);
+    pose.keypoints[root.id] = root_kp;
+    decoded[root.id] = true;
+
+    // Walk towards the nose first, then out to the limbs.
+    for (int32_t edge = kNumPoseEdges - 1; edge >= 0; edge--) {
+      uint32_t source = kPoseEdges[edge][1];
+      uint32_t target = kPoseEdges[edge][0];
+      if (decoded[source] && !decoded[target]) {
+        TraverseToTarget(out, out.displacements_bwd, edge,
+                         pose.keypoints[source], target,
+                         pose.keypoints[target]);
+        decoded[target] = true;
+      }
+    }
+    for (uint32_t edge = 0; edge < kNumPoseEdges; edge++) {
+      uint32_t source = kPoseEdges[edge][0];
+      uint32_t target = kPoseEdges[edge][1];
+      if (decoded[source] && !decoded[target]) {
+        TraverseToTarget(out, out.displacements_fwd, edge,
+                         pose.keypoints[source], target,
+                         pose.keypoints[target]);
+        decoded[target] = true;
+      }
+    }
+
+    // Keypoints which overlap an already decoded pose do not count.
+    pose.score = 0.0;
+    for (uint32_t id = 0; id < KEY_POINTS_COUNT; id++) {
+      if (!WithinNmsRadius(poses, squared_radius, pose.keypoints[id], id)) {
+        pose.score += pose.keypoints[id].score;
+      }
+    }
+    pose.score /= KEY_POINTS_COUNT;
+    poses.push_back(pose);
+  }
+}
+
+void DecodePoses(const PoseNetOutputs& outputs, const uint32_t max_poses,
+                 const float score_threshold, const float nms_radius,
+                 std::vector<Pose>& poses) {
+  poses.clear();
+
+  if (max_poses == 0 || outputs.height == 0 || outputs.width == 0) {
+    return;
+  }
+
+  if (max_poses == 1 || !outputs.displacements_fwd ||
+      !outputs.displacements_bwd) {
+    DecodeSinglePose(outputs, score_threshold, poses);
+  } else {
+    DecodeMultiplePoses(outputs, max_poses, score_threshold, nms_radius,
+                        poses);
+  }
+}
+
+void GenerateSegmentationPalette(const uint32_t num_classes,
+                                 std::vector<uint32_t>& palette) {
+  palette.resize(num_classes);
+
+  for (uint32_t idx = 0; idx < num_classes; idx++) {
+    uint32_t red = 0, green = 0, blue = 0;
+    uint32_t label = idx;
+
+    for (int32_t shift = 7; shift >= 0 && label; shift--, label >>= 3) {
+      red |= ((label >> 0) & 1) << shift;
+      green |= ((label >> 1) & 1) << shift;
+      blue |= ((label >> 2) & 1) << shift;
+    }
+
+    uint32_t alpha = (idx == 0) ? 0 : 128;
+    palette[idx] = red | (green << 8) | (blue << 16) | (alpha << 24);
+  }
+}
+
+GstMLPoseNetMeta* AddPoseNetMeta(GstBuffer* buffer, const Pose& pose,
+                                 const float scale_x, const float scale_y,
+                                 const uint32_t x_offset,
+                                 const uint32_t y_offset) {
+  GstMLPoseNetMeta *meta = gst_buffer_add_posenet_meta(buffer);
+  if (!meta) {
+    VAM_ML_LOGE("Failed to create metadata");
+    return nullptr;
+  }
+
+  for (uint32_t id = 0; id < KEY_POINTS_COUNT; id++) {
+    const PoseKeypoint& kp = pose.keypoints[id];
+    meta->points[id].x = std::lround(kp.x * scale_x) + x_offset;
+    meta->points[id].y = std::lround(kp.y * scale_y) + y_offset;
+    meta->points[id].score = kp.score;
+  }
+  meta->score = pose.score;
+
+  return meta;
+}
+
+GstBufferPool* CreateMaskPool(const uint32_t size) {
+  static const uint32_t kMinMasks = 2;
+  static const uint32_t kMaxMasks = 4;
+
+  GstBufferPool* pool = gst_ml_mask_pool_new_configured(
+      GST_ML_MASK_POOL_TYPE_ION, size, kMinMasks, kMaxMasks);
+  if (nullptr == pool) {
+    pool = gst_ml_mask_pool_new_configured(
+        GST_ML_MASK_POOL_TYPE_MEMFD, size, kMinMasks, kMaxMasks);
+  }
+  if (nullptr == pool) {
+    VAM_ML_LOGE("Failed to create mask pool, using heap memory");
+  }
+  return pool;
+}
+
+GstMLSegmentationMeta* AddSegmentationMeta(GstBuffer* buffer,
+                                           const uint32_t width,
+                                           const uint32_t height,
+                                           const std::vector<uint32_t>& palette,
+                                           GstBufferPool* pool) {
+  GstMLSegmentationMeta *meta = gst_buffer_add_segmentation_meta(buffer);
+  if (!meta) {
+    VAM_ML_LOGE("Failed to create metadata");
+    return nullptr;
+  }
+
+  bool mask = gst_ml_segmentation_meta_alloc_mask(meta, pool, width * height);
+  meta->palette = static_cast<guint32*>(malloc(palette.size() * sizeof(guint32)));
+  if (!mask || !meta->palette) {
+    VAM_ML_LOGE("Failed to allocate segmentation map");
+    return nullptr;
+  }
+  memcpy(meta->palette, palette.data(), palette.size() * sizeof(guint32));
+
+  meta->n_colors = palette.size();
+  meta->img_width = width;
+  meta->img_height = height;
+  meta->img_stride = width;
+  meta->img_format = GST_VIDEO_FORMAT_GRAY8;
+
+  return meta;
+}
+
+GstMLLabelTable* CreateLabelTable(const std::vector<std::string>& labels) {
+  std::vector<const gchar*> names;
+  names.reserve(labels.size());
+  for (auto& label : labels) {
+    names.push_back(label.c_str());
+  }
+  return gst_ml_label_table_new(names.data(), names.size());
+}
+
+bool AddDetectionMeta(GstBuffer* buffer, GstMLDetectionBatchMeta** batch,
+                      const uint32_t capacity, GstMLLabelTable* labels,
+                      const GstMLBoundingBox& box, const float confidence,
+                      const uint32_t class_id) {
+  if (batch) {
+    if (!*batch) {
+      *batch = gst_buffer_add_detection_batch_meta(buffer, capacity, FALSE,
+                                                   labels);
+      if (!*batch) {
+        VAM_ML_LOGE("Failed to create metadata");
+        return false;
+      }
+    }
+    return gst_ml_detection_batch_meta_add_box(*batch, &box, confidence,
+                                               class_id, 0);
+  }
+
+  GstMLDetectionMeta *meta = gst_buffer_add_detection_meta(buffer);
+  if (!meta) {
+    VAM_ML_LOGE("Failed to create metadata");
+    return false;
+  }
+
+  GstMLClassificationResult *box_info = gst_ml_classification_result_new();
+  if (!box_info) {
+    VAM_ML_LOGE("Failed to allocate detection result");
+    return false;
+  }
+
+  // The name is borrowed from the shared table, nothing is copied.
+  if (labels) {
+    gst_ml_classification_result_set_label(box_info, labels, class_id);
+  }
+  box_info->class_id = class_id;
+  box_info->confidence = confidence;
+  meta->box_info = g_slist_append(meta->box_info, box_info);
+  meta->bounding_box = box;
+
+  return true;
+}
+
+}; // namespace mle
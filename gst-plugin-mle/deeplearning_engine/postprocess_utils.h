@@ -0,0 +1,212 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <ml-meta/ml_meta.h>
+#include <ml-meta/ml_mask_pool.h>
+
+namespace mle {
+
+// Class maps hold one byte per pixel.
+static const uint32_t kMaxSegmentationClasses = 256;
+
+/** ArgMaxChannels
+ *    @data: network output in NHWC layout
+ *    @num_pixels: number of pixels (H * W) in the output
+ *    @channels: number of channels (classes) per pixel, at most
+ *               kMaxSegmentationClasses
+ *    @classes: destination with one byte per pixel
+ *
+ * Stores the index of the highest scoring channel for every pixel.
+ * A single channel already holds the class index, which is clamped to
+ * the class map range. Uses NEON or SSE when available.
+ *
+ **/
+void ArgMaxChannels(const float* data, const uint32_t num_pixels,
+                    const uint32_t channels, uint8_t* classes);
+void ArgMaxChannels(const uint8_t* data, const uint32_t num_pixels,
+                    const uint32_t channels, uint8_t* classes);
+
+/** ClassIndices
+ *    @indices: class index of every pixel, from a model with the argmax
+ *              in its graph
+ *    @num_pixels: number of pixels (H * W) in the output
+ *    @classes: destination with one byte per pixel
+ *
+ * Stores the class indices clamped to the class map range, so that
+ * indices past kMaxSegmentationClasses do not wrap to the background.
+ *
+ **/
+void ClassIndices(const int32_t* indices, const uint32_t num_pixels,
+                  uint8_t* classes);
+void ClassIndices(const int64_t* indices, const uint32_t num_pixels,
+                  uint8_t* classes);
+
+/** GenerateSegmentationPalette
+ *    @num_classes: number of classes in the segmentation model
+ *    @palette: output RGBA colors, one per class
+ *
+ * Generates the PASCAL VOC color map. Class 0 is background and is left
+ * fully transparent.
+ *
+ **/
+void GenerateSegmentationPalette(const uint32_t num_classes,
+                                 std::vector<uint32_t>& palette);
+
+/** CreateMaskPool
+ *    @size: size of a single class map in bytes
+ *
+ * Creates an active pool of fd backed class maps. ION is used when
+ * available, memfd otherwise. Returns nullptr on failure.
+ *
+ **/
+GstBufferPool* CreateMaskPool(const uint32_t size);
+
+/** AddSegmentationMeta
+ *    @buffer: the buffer new metadata belongs to
+ *    @width: class map width
+ *    @height: class map height
+ *    @palette: RGBA colors indexed by class
+ *    @pool: optional pool the class map is acquired from
+ *
+ * Attaches segmentation metadata with an uninitialized GRAY8 class map
+ * of the given dimensions and a copy of the palette.
+ *
+ **/
+GstMLSegmentationMeta* AddSegmentationMeta(GstBuffer* buffer,
+                                           const uint32_t width,
+                                           const uint32_t height,
+                                           const std::vector<uint32_t>& palette,
+                                           GstBufferPool* pool);
+
+/** ArgMaxPerChannel
+ *    @data: network output in NHWC layout
+ *    @num_pixels: number of pixels (H * W) in the output
+ *    @channels: number of channels per pixel
+ *    @max_values: destination with the max value of every channel
+ *    @max_indices: destination with the pixel index of every channel max
+ *
+ * Finds the spatial position of the maximum in every channel. The search
+ * is vectorized across channels so the NHWC data is read sequentially.
+ *
+ **/
+void ArgMaxPerChannel(const float* data, const uint32_t num_pixels,
+                      const uint32_t channels, float* max_values,
+                      uint32_t* max_indices);
+
+struct PoseNetOutputs {
+  // Keypoint heatmaps (H x W x K), raw logits.
+  const float* heatmaps;
+  // Keypoint offsets (H x W x 2K), y offsets followed by x offsets.
+  const float* offsets;
+  // Edge displacements (H x W x 2E), required for multi-person decoding.
+  const float* displacements_fwd;
+  const float* displacements_bwd;
+  uint32_t height;
+  uint32_t width;
+  uint32_t output_stride;
+};
+
+struct PoseKeypoint {
+  float x;
+  float y;
+  float score;
+};
+
+struct Pose {
+  PoseKeypoint keypoints[KEY_POINTS_COUNT];
+  float score;
+};
+
+/** DecodePoses
+ *    @outputs: PoseNet output tensors
+ *    @max_poses: maximum number of poses to decode
+ *    @score_threshold: minimum keypoint score used as pose root
+ *    @nms_radius: radius in model pixels used to suppress duplicate poses
+ *    @poses: decoded poses, keypoints are in model input coordinates
+ *
+ * Decodes PoseNet outputs. A single pose is decoded with a per keypoint
+ * heatmap argmax. Multiple poses are decoded greedily from the heatmap
+ * local maxima by following the displacement fields along the skeleton.
+ *
+ **/
+void DecodePoses(const PoseNetOutputs& outputs, const uint32_t max_poses,
+                 const float score_threshold, const float nms_radius,
+                 std::vector<Pose>& poses);
+
+/** AddPoseNetMeta
+ *    @buffer: the buffer new metadata belongs to
+ *    @pose: decoded pose in model input coordinates
+ *    @scale_x: horizontal scale from model input to frame coordinates
+ *    @scale_y: vertical scale from model input to frame coordinates
+ *    @x_offset: horizontal offset of the model input in the frame
+ *    @y_offset: vertical offset of the model input in the frame
+ *
+ * Attaches PoseNet metadata with the pose keypoints in frame coordinates.
+ *
+ **/
+GstMLPoseNetMeta* AddPoseNetMeta(GstBuffer* buffer, const Pose& pose,
+                                 const float scale_x, const float scale_y,
+                                 const uint32_t x_offset,
+                                 const uint32_t y_offset);
+
+/** CreateLabelTable
+ *    @labels: label names indexed by class id
+ *
+ * Creates the label table shared by all classification and detection
+ * metadata of an engine. Caller owns the returned reference.
+ *
+ **/
+GstMLLabelTable* CreateLabelTable(const std::vector<std::string>& labels);
+
+/** AddDetectionMeta
+ *    @buffer: the buffer new metadata belongs to
+ *    @batch: detection batch of the frame or nullptr for legacy metadata
+ *    @capacity: max number of detections in the frame
+ *    @labels: label table used to resolve @class_id
+ *    @box: object bounding box in frame coordinates
+ *    @confidence: object confidence
+ *    @class_id: object class id
+ *
+ * Attaches one detected object to the buffer. When @batch is given the
+ * object is appended to the frame batch, which is created on first use
+ * with room for @capacity objects. Otherwise one GstMLDetectionMeta is
+ * added per object.
+ *
+ **/
+bool AddDetectionMeta(GstBuffer* buffer, GstMLDetectionBatchMeta** batch,
+                      const uint32_t capacity, GstMLLabelTable* labels,
+                      const GstMLBoundingBox& box, const float confidence,
+                      const uint32_t class_id);
+
+}; // namespace mle
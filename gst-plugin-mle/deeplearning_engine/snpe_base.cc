@@ -54,6 +54,7 @@ static const auto kOneFrameProcessTimeout = std::chrono::milliseconds(10);
 #endif
 
 static const int kBufferAlign                 = 4096;
+static const size_t kTensorAlign              = 128;
 
 SNPEBase::SNPEBase(MLConfig &config) : MLEngine() {
   fcvSetOperationMode(FASTCV_OP_PERFORMANCE);
@@ -72,8 +73,15 @@ SNPEBase::SNPEBase(MLConfig &config) : MLEngine() {
   config_.labels_file = config.labels_file;
   config_.output_layers = config.output_layers;
   config_.result_layers = config.result_layers;
+  config_.max_poses = config.max_poses;
+  config_.batch_detections = config.batch_detections;
 
   init_params_.conf_threshold = config.conf_threshold;
+
+  snpe_params_.arena.fd = -1;
+  snpe_params_.arena.handle = -1;
+  snpe_params_.arena.size = 0;
+  label_table_ = nullptr;
 }
 
 int32_t SNPEBase::ConfigureRuntime(MLConfig &config) {
@@ -196,6 +204,112 @@ int32_t SNPEBase::PopulateMap(BufferType type) {
   return result;
 }
 
+size_t SNPEBase::ElementSize(BufferType type) const {
+  // ITensors always hold float data, staged through a float input buffer.
+  if (config_.io_type == NetworkIO::kITensor) {
+    return sizeof(float);
+  }
+  // Input user buffers hold the pre-processed frame, TF8 encoded for 8 bit
+  // formats. Outputs are float whatever their encoding in the model, SNPE
+  // dequantizes into them and every post-processing reads floats.
+  if ((type == BufferType::kInput) &&
+      ((config_.input_format == InputFormat::kBgr) ||
+       (config_.input_format == InputFormat::kRgb))) {
+    return sizeof(uint8_t);
+  }
+  return sizeof(float);
+}
+
+size_t SNPEBase::TensorSize(const char* name, const size_t& element_size) {
+  auto attr_opt = snpe_params_.snpe->getInputOutputBufferAttributes(name);
+  if (!attr_opt) {
+    throw std::runtime_error(
+        std::string("Error obtaining attributes for tensor ") + name);
+  }
+  const zdl::DlSystem::TensorShape& shape = (*attr_opt)->getDims();
+  return CalculateSizeFromDims(shape.rank(), shape.getDimensions(),
+                               element_size);
+}
+
+int32_t SNPEBase::AllocateArena() {
+  struct TensorPlan {
+    std::string name;
+    BufferType type;
+    size_t elem_size;
+    size_t offset;
+    size_t size;
+  };
+  std::vector<TensorPlan> plan;
+  size_t total = 0;
+
+  // Inputs always need backing memory. ITensor outputs are owned by SNPE
+  // and are read back through the tensor map, so they are not planned.
+  std::vector<BufferType> types = { BufferType::kInput };
+  if (config_.io_type == NetworkIO::kUserBuffer) {
+    types.push_back(BufferType::kOutput);
+  }
+
+  for (auto type : types) {
+    zdl::DlSystem::Optional <zdl::DlSystem::StringList> names_opt =
+        (type == BufferType::kInput) ?
+        snpe_params_.snpe->getInputTensorNames() :
+        snpe_params_.snpe->getOutputTensorNames();
+    const zdl::DlSystem::StringList& names = *names_opt;
+
+    for (const char *name : names) {
+      TensorPlan tensor;
+      tensor.name = name;
+      tensor.type = type;
+      tensor.elem_size = ElementSize(type);
+      tensor.size = TensorSize(name, tensor.elem_size);
+      tensor.offset = total;
+      total += (tensor.size + kTensorAlign - 1) & ~(kTensorAlign - 1);
+      plan.push_back(tensor);
+    }
+  }
+
+  if (0 == total) {
+    VAM_ML_LOGE("%s: Nothing to allocate", __func__);
+    return MLE_FAIL;
+  }
+
+  snpe_params_.arena = AllocateBuffer(total, config_.input_format);
+  if (nullptr == snpe_params_.arena.addr &&
+      nullptr == snpe_params_.arena.addr_f) {
+    VAM_ML_LOGE("%s: Arena allocation failed", __func__);
+    ReleaseBuffer(snpe_params_.arena);
+    return MLE_FAIL;
+  }
+
+  uint8_t* base = snpe_params_.arena.addr ? snpe_params_.arena.addr :
+      reinterpret_cast<uint8_t*>(snpe_params_.arena.addr_f);
+
+  // Each view is typed by its own elements, not by the arena mapping.
+  for (const auto& tensor : plan) {
+    IONBuffer view = snpe_params_.arena;
+    view.addr = nullptr;
+    view.addr_f = nullptr;
+    if (sizeof(uint8_t) == tensor.elem_size) {
+      view.addr = base + tensor.offset;
+    } else {
+      view.addr_f = reinterpret_cast<float*>(base + tensor.offset);
+    }
+    view.offset = tensor.offset;
+    view.size = tensor.size;
+
+    auto *heap_map = (tensor.type == BufferType::kInput) ?
+        &snpe_params_.in_heap_map : &snpe_params_.out_heap_map;
+    heap_map->emplace(tensor.name, view);
+
+    VAM_ML_LOGD("%s: %s offset %zu size %zu", __func__, tensor.name.c_str(),
+                tensor.offset, tensor.size);
+  }
+
+  VAM_ML_LOGI("%s: %zu tensors in %u bytes arena", __func__, plan.size(),
+              snpe_params_.arena.size);
+  return MLE_OK;
+}
+
 int32_t SNPEBase::CreateUserBuffer(BufferType type, const char * name) {
   zdl::DlSystem::IUserBufferFactory& ub_factory =
       zdl::SNPE::SNPEFactory::getUserBufferFactory();
@@ -208,17 +322,7 @@ int32_t SNPEBase::CreateUserBuffer(BufferType type, const char * name) {
     throw std::runtime_error(
         std::string("Error obtaining attributes for tensor ") + name);
   }
-  const zdl::DlSystem::TensorShape& buffer_shape = (*uba_opt)->getDims();
-
-  size_t elem_size = sizeof(uint8_t);
-  if ((config_.input_format == InputFormat::kBgrFloat) ||
-      (config_.input_format == InputFormat::kRgbFloat)) {
-    elem_size = sizeof(float);
-  }
-
-  size_t buf_size = CalculateSizeFromDims(buffer_shape.rank(),
-                                          buffer_shape.getDimensions(),
-                                          elem_size);
+  size_t elem_size = ElementSize(type);
 
   auto *heap_map = &snpe_params_.in_heap_map;
   auto *ub_map = &snpe_params_.input_ub_map;
@@ -227,17 +331,16 @@ int32_t SNPEBase::CreateUserBuffer(BufferType type, const char * name) {
     ub_map = &snpe_params_.output_ub_map;
   }
 
-  IONBuffer ion_buf = AllocateBuffer(buf_size, config_.input_format);
-  if (nullptr == ion_buf.addr && nullptr == ion_buf.addr_f) {
-    VAM_ML_LOGE(" Buffer allocation failed");
-    ReleaseBuffer(ion_buf);
+  // Memory was planned and carved out of the arena by AllocateArena()
+  auto it = heap_map->find(name);
+  if (it == heap_map->end()) {
+    VAM_ML_LOGE(" No arena buffer for tensor %s", name);
     return MLE_FAIL;
   }
+  const IONBuffer& ion_buf = it->second;
+  size_t buf_size = ion_buf.size;
 
-  heap_map->emplace(name, ion_buf);
-
-  if ((config_.input_format == InputFormat::kBgr) ||
-      (config_.input_format == InputFormat::kRgb)) {
+  if (sizeof(uint8_t) == elem_size) {
     snpe_params_.ub_list.push_back(ub_factory.createUserBuffer(
         ion_buf.addr, buf_size,
         GetStrides((*uba_opt)->getDims(), elem_size), ub_encoding_uint8));
@@ -264,25 +367,12 @@ int32_t SNPEBase::CreateTensor(BufferType type, const char* name) {
         std::string("Error obtaining attributes for tensor ") + name);
   }
   const zdl::DlSystem::TensorShape& tensor_shape = (*tensor_opt)->getDims();
-  size_t buf_size = CalculateSizeFromDims(tensor_shape.rank(),
-                                          tensor_shape.getDimensions(),
-                                          sizeof(float));
 
-  auto *heap_map = &snpe_params_.in_heap_map;
   auto *tensor_map = &snpe_params_.input_tensor_map;
   if (type == BufferType::kOutput) {
-    heap_map = &snpe_params_.out_heap_map;
     tensor_map = &snpe_params_.output_tensor_map;
   }
 
-  IONBuffer ion_buf = AllocateBuffer(buf_size, config_.input_format);
-  if (nullptr == ion_buf.addr && nullptr == ion_buf.addr_f) {
-    VAM_ML_LOGE(" Buffer allocation failed");
-    ReleaseBuffer(ion_buf);
-    return MLE_FAIL;
-  }
-
-  heap_map->emplace(name, ion_buf);
   snpe_params_.tensor_list.push_back(tensor_factory.createTensor(tensor_shape));
   tensor_map->add(name, snpe_params_.tensor_list.back().get());
 
@@ -395,27 +485,49 @@ int32_t SNPEBase::PreProcessBuffer(const SourceFrame* frame_info) {
   }
 
   if (config_.io_type == NetworkIO::kITensor) {
+    // The algorithm writes into ION memory, bulk copy it into the tensor.
     auto *tensor =
         snpe_params_.input_tensor_map.getTensor(config_.input_layer.c_str());
+    float *data = InputTensorData(tensor);
+    size_t size = tensor->getSize();
     if ((config_.input_format == InputFormat::kBgr) ||
         (config_.input_format == InputFormat::kRgb)) {
       if (ion_buf->addr != nullptr) {
-        uint8_t *t = ion_buf->addr;
-        for (auto it = tensor->begin(); it != tensor->end(); it++, t++) {
-          *it = *t;
+        if (nullptr != data) {
+          const uint8_t *src = ion_buf->addr;
+          for (size_t i = 0; i < size; i++) {
+            data[i] = src[i];
+          }
+        } else {
+          std::copy(ion_buf->addr, ion_buf->addr + size, tensor->begin());
         }
       }
     } else {
       if (ion_buf->addr_f != nullptr) {
-        float *t = ion_buf->addr_f;
-        for (auto it = tensor->begin(); it != tensor->end(); it++, t++) {
-          *it = *t;
+        if (nullptr != data) {
+          memcpy(data, ion_buf->addr_f, size * sizeof(float));
+        } else {
+          std::copy(ion_buf->addr_f, ion_buf->addr_f + size, tensor->begin());
         }
       }
     }
   }
 #else
-  float *snpe_buf = snpe_params_.in_heap_map[config_.input_layer.c_str()].addr_f;
+  zdl::DlSystem::ITensor *tensor = nullptr;
+  float *snpe_buf = nullptr;
+
+  // Pre-process straight into the input tensor storage when possible,
+  // otherwise stage in the ION buffer and bulk copy afterwards.
+  if (config_.io_type == NetworkIO::kITensor) {
+    tensor =
+        snpe_params_.input_tensor_map.getTensor(config_.input_layer.c_str());
+    snpe_buf = InputTensorData(tensor);
+  }
+  float *staging_buf =
+      snpe_params_.in_heap_map[config_.input_layer.c_str()].addr_f;
+  if (!snpe_buf) {
+    snpe_buf = staging_buf;
+  }
   if (!snpe_buf) {
     VAM_ML_LOGE("%s: SNPE buffer is null", __func__);
     return MLE_NULLPTR;
@@ -435,21 +547,8 @@ int32_t SNPEBase::PreProcessBuffer(const SourceFrame* frame_info) {
     MeanSubtract(init_params_.bgr_buf, scale_width_, scale_height_, snpe_buf);
   }
 
-  if (config_.io_type == NetworkIO::kITensor) {
-  //   auto *input_vec = &snpe_params_.in_heap_map[config_.input_layers.c_str()];
-  //   auto tensor_size = snpe_params_.input_tensor_map.getTensor(
-  //       config_.input_layers.c_str())->getSize();
-  //   if (input_vec->size() == tensor_size) {
-  //     std::copy(
-  //         input_vec->begin(),
-  //         input_vec->end(),
-  //         snpe_params_.input_tensor_map.getTensor(config_.input_layers.c_str())->begin());
-  //   } else {
-  //     VAM_ML_LOGE("%s: Invalid tensor size %d", __func__, tensor_size);
-
-  //   //temporary disable Itensor support
-  //     return MLE_FAIL;
-  //   }
+  if (nullptr != tensor && snpe_buf == staging_buf) {
+    std::copy(staging_buf, staging_buf + tensor->getSize(), tensor->begin());
   }
 #endif
   return MLE_OK;
@@ -615,6 +714,41 @@ void SNPEBase::MeanSubtract(uint8_t* input_buf, const uint32_t width,
 
 #endif // !QMMF_ALG
 
+float* SNPEBase::InputTensorData(zdl::DlSystem::ITensor* tensor) {
+  if (nullptr == tensor) {
+    return nullptr;
+  }
+  // Tensors created by the factory own contiguous float storage
+  return tensor->begin().dataPointer();
+}
+
+const float* SNPEBase::OutputData(const char* name, size_t& size) {
+  size = 0;
+  if (config_.io_type == NetworkIO::kUserBuffer) {
+    auto it = snpe_params_.out_heap_map.find(name);
+    if (it == snpe_params_.out_heap_map.end()) {
+      return nullptr;
+    }
+    // Output user buffers are float views into the arena
+    size = it->second.size / sizeof(float);
+    return it->second.addr_f;
+  }
+
+  const zdl::DlSystem::ITensor *tensor =
+      snpe_params_.output_tensor_map.getTensor(name);
+  if (nullptr == tensor) {
+    return nullptr;
+  }
+  // Tensors created by the factory own contiguous float storage
+  const float *data = tensor->cbegin().dataPointer();
+  if (nullptr == data) {
+    VAM_ML_LOGE("%s: Output tensor %s is not contiguous", __func__, name);
+    return nullptr;
+  }
+  size = tensor->getSize();
+  return data;
+}
+
 int32_t SNPEBase::ExecuteSNPE() {
   if (config_.io_type == NetworkIO::kUserBuffer) {
     if (!snpe_params_.snpe->execute(snpe_params_.input_ub_map,
@@ -638,52 +772,20 @@ int32_t SNPEBase::ExecuteSNPE() {
 }
 
 int32_t SNPEBase::EnginePostProcess(GstBuffer* buffer) {
-  std::vector<float> score_buf;
-  const zdl::DlSystem::StringList &output_buf_names =
-      snpe_params_.output_ub_map.getUserBufferNames();
-  const zdl::DlSystem::StringList &output_tensor_names =
-      snpe_params_.output_tensor_map.getTensorNames();
-  const zdl::DlSystem::StringList *output_names = &output_buf_names;
-  if (config_.io_type == NetworkIO::kITensor) {
-    output_names = &output_tensor_names;
-  }
-  std::for_each(
-      output_names->begin(),
-      output_names->end(),
-      [&](const char* name)
-      {
-        if (0 == std::strcmp(name, config_.result_layers[0].c_str())) {
-          if (config_.io_type == NetworkIO::kUserBuffer) {
-            IONBuffer b = snpe_params_.out_heap_map.at(name);
-            if ((config_.input_format == InputFormat::kBgr) ||
-               (config_.input_format == InputFormat::kRgb)) {
-              for (size_t i = 0; i < b.size / sizeof(uint8_t); i++) {
-                score_buf.push_back(b.addr[i]);
-              }
-            } else {
-              for (size_t i = 0; i < b.size / sizeof(float); i++) {
-                score_buf.push_back(b.addr_f[i]);
-              }
-            }
-          } else if (config_.io_type == NetworkIO::kITensor) {
-            auto t = snpe_params_.output_tensor_map.getTensor(name);
-            for (auto it = t->begin(); it != t->end(); it++) {
-              score_buf.push_back(*it);
-            }
-          }
-        }
-      });
+  size_t num_scores = 0;
+  const float *scores =
+      OutputData(config_.result_layers[0].c_str(), num_scores);
 
   uint32_t top_score_idx = 0;
   float top_score = 0.0;
 
-  for (size_t i = 0; i < score_buf.size(); i++) {
-    if (score_buf[i] > top_score) {
-      top_score = score_buf[i];
+  for (size_t i = 0; i < num_scores; i++) {
+    if (scores[i] > top_score) {
+      top_score = scores[i];
       top_score_idx = i;
     }
   }
-  if (top_score_idx < labels_.size() &&
+  if (top_score_idx < labels_.size() && label_table_ &&
       top_score > init_params_.conf_threshold) {
 
     GstMLClassificationMeta *meta =
@@ -694,9 +796,8 @@ int32_t SNPEBase::EnginePostProcess(GstBuffer* buffer) {
     }
 
     meta->result.confidence = top_score * 100;
-    uint32_t label_size = labels_.at(top_score_idx).size() + 1;
-    meta->result.name = (gchar *)malloc(label_size);
-    snprintf(meta->result.name, label_size, "%s", labels_.at(top_score_idx).c_str());
+    gst_ml_classification_result_set_label(&meta->result, label_table_,
+                                           top_score_idx);
   }
 
   return MLE_OK;
@@ -836,9 +937,13 @@ int32_t SNPEBase::InitSNPE() {
       for (std::string a; std::getline(labels_file, a);) {
         labels_.push_back(a);
       }
+      label_table_ = CreateLabelTable(labels_);
     }
   }
 
+  if (MLE_OK == res) {
+    res = AllocateArena();
+  }
   if (MLE_OK == res) {
     res = PopulateMap(BufferType::kInput);
   }
@@ -869,13 +974,16 @@ void SNPEBase::Deinit() {
   ReleaseBuffer(scale_ion_buffer_);
 #endif
 
-  for (auto it : snpe_params_.in_heap_map) {
-    ReleaseBuffer(it.second);
-  }
-  for (auto it : snpe_params_.out_heap_map) {
-    ReleaseBuffer(it.second);
-  }
+  // Heap map entries are views into the arena
+  snpe_params_.in_heap_map.clear();
+  snpe_params_.out_heap_map.clear();
+  ReleaseBuffer(snpe_params_.arena);
   close(ion_device_);
+
+  if (nullptr != label_table_) {
+    gst_ml_label_table_unref(label_table_);
+    label_table_ = nullptr;
+  }
 #ifdef QMMF_ALG
   DeinitAlgo();
 #endif
@@ -883,14 +991,16 @@ void SNPEBase::Deinit() {
 
 #ifdef QMMF_ALG
 void IONBuffer::GetAlgBuffer(AlgBuffer* buf, const InputFormat& format) {
+  // Arena views share the FD of the arena, the plane starts at the offset
+  // of the view and the buffer spans the FD memory up to its end.
   BufferPlane plane(this->width,
                     this->height,
                     this->stride,
-                    0,
+                    this->offset,
                     this->size);
   buf->cached_ = false;
   buf->fd_ = this->fd;
-  buf->size_ = this->size;
+  buf->size_ = this->offset + this->size;
   buf->plane_.push_back(plane);
   switch (format) {
     case InputFormat::kBgrFloat:
@@ -911,9 +1021,9 @@ void IONBuffer::GetAlgBuffer(AlgBuffer* buf, const InputFormat& format) {
 
   if ((format == InputFormat::kBgr) ||
       (format == InputFormat::kRgb)) {
-    buf->vaddr_ = this->addr;
+    buf->vaddr_ = this->addr - this->offset;
   } else {
-    buf->vaddr_ = reinterpret_cast<uint8_t*>(this->addr_f);
+    buf->vaddr_ = reinterpret_cast<uint8_t*>(this->addr_f) - this->offset;
   }
 
   VAM_ML_LOGE(
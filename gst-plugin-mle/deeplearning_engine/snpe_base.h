@@ -62,6 +62,7 @@
 #include "DlSystem/IBufferAttributes.hpp"
 #include "common_utils.h"
 #include "ml_engine_intf.h"
+#include "postprocess_utils.h"
 
 namespace mle {
 
@@ -70,6 +71,8 @@ struct IONBuffer {
   float* addr_f = nullptr;
   uint32_t size;
   int32_t fd;
+  // Offset of addr within the FD memory, non-zero for arena views
+  uint32_t offset = 0;
   int32_t handle;
   bool cached;
   uint32_t width;
@@ -105,8 +108,12 @@ struct SNPEParams {
   zdl::DlSystem::TensorMap output_tensor_map;
   zdl::DlSystem::TensorMap input_tensor_map;
 
+  // Views into the tensor arena, one per input/output tensor
   std::unordered_map<std::string, IONBuffer> in_heap_map;
   std::unordered_map<std::string, IONBuffer> out_heap_map;
+
+  // Single ION allocation backing all tensors in the heap maps
+  IONBuffer arena;
 };
 
 #ifdef QMMF_ALG
@@ -133,7 +140,11 @@ class SNPEBase : public MLEngine {
   int32_t ExecuteSNPE();
   virtual int32_t EnginePostProcess(GstBuffer* buffer);
 
+  float* InputTensorData(zdl::DlSystem::ITensor* tensor);
+  const float* OutputData(const char* name, size_t& size);
+
   std::vector<std::string> labels_;
+  GstMLLabelTable* label_table_;
   int32_t ion_device_;
 
   uint32_t scale_stride_;
@@ -157,6 +168,9 @@ class SNPEBase : public MLEngine {
   virtual std::vector<size_t> GetStrides(zdl::DlSystem::TensorShape dims,
                                          const size_t& element_size);
 
+  size_t ElementSize(BufferType type) const;
+  size_t TensorSize(const char* name, const size_t& element_size);
+  int32_t AllocateArena();
   int32_t PopulateMap(BufferType type);
   int32_t CreateUserBuffer(BufferType type, const char* name);
   int32_t CreateTensor(BufferType type, const char* name);
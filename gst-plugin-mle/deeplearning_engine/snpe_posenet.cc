@@ -0,0 +1,128 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <vector>
+#include "snpe_posenet.h"
+
+namespace mle {
+
+// Suppression radius of duplicate poses in model input pixels
+static const float kPoseNmsRadius = 20.0;
+
+SNPEPoseNet::SNPEPoseNet(MLConfig &config) : SNPEBase(config) {}
+SNPEPoseNet::~SNPEPoseNet() {}
+
+int32_t SNPEPoseNet::EnginePostProcess(GstBuffer* buffer) {
+  VAM_ML_LOGI("%s: Enter", __func__);
+
+  // Result layers order: heatmaps, offsets and optionally forward and
+  // backward displacements for multi-person decoding.
+  if (config_.result_layers.size() != 2 && config_.result_layers.size() != 4) {
+    VAM_ML_LOGE("%s: Expected 2 or 4 result layers, got %zu", __func__,
+                config_.result_layers.size());
+    return MLE_FAIL;
+  }
+
+  const char* heatmaps = config_.result_layers[0].c_str();
+  auto attr_opt = snpe_params_.snpe->getInputOutputBufferAttributes(heatmaps);
+  const zdl::DlSystem::TensorShape& dims = (*attr_opt)->getDims();
+  if (dims.rank() != 4 || dims[3] != KEY_POINTS_COUNT) {
+    VAM_ML_LOGE("%s: Unsupported heatmaps shape", __func__);
+    return MLE_FAIL;
+  }
+
+  const float* outputs[4] = { nullptr, nullptr, nullptr, nullptr };
+  for (size_t i = 0; i < config_.result_layers.size(); i++) {
+    size_t size = 0;
+    outputs[i] = OutputData(config_.result_layers[i].c_str(), size);
+    if (nullptr == outputs[i]) {
+      return MLE_FAIL;
+    }
+  }
+
+  PoseNetOutputs posenet;
+  posenet.heatmaps = outputs[0];
+  posenet.offsets = outputs[1];
+  posenet.displacements_fwd = outputs[2];
+  posenet.displacements_bwd = outputs[3];
+  posenet.height = dims[1];
+  posenet.width = dims[2];
+  posenet.output_stride = (posenet.height > 1) ?
+      (scale_height_ - 1) / (posenet.height - 1) : scale_height_;
+
+  DecodePoses(posenet, config_.max_poses, init_params_.conf_threshold,
+              kPoseNmsRadius, poses_);
+
+  uint32_t width = init_params_.width;
+  uint32_t height = init_params_.height;
+
+  if (config_.preprocess_mode == PreprocessingMode::kKeepAR) {
+    width = po_.width;
+    height = po_.height;
+  }
+
+  float scale_x = static_cast<float>(width) / scale_width_;
+  float scale_y = static_cast<float>(height) / scale_height_;
+
+  for (const auto& pose : poses_) {
+    if (!AddPoseNetMeta(buffer, pose, scale_x, scale_y, po_.x_offset,
+                        po_.y_offset)) {
+      return MLE_NULLPTR;
+    }
+  }
+
+  VAM_ML_LOGI("%s: Exit", __func__);
+  return MLE_OK;
+}
+
+int32_t SNPEPoseNet::Process(struct SourceFrame* frame_info,
+                             GstBuffer* buffer) {
+  int32_t result = MLE_OK;
+
+  result = PreProcessBuffer(frame_info);
+  if (MLE_OK != result) {
+    VAM_ML_LOGE("PreProcessBuffer failed");
+    return result;
+  }
+
+  result = ExecuteSNPE();
+  if (MLE_OK != result) {
+    VAM_ML_LOGE("SNPE execution failed");
+    return result;
+  }
+
+  result = EnginePostProcess(buffer);
+  if (MLE_OK != result) {
+    VAM_ML_LOGE("EnginePostProcess failed");
+  }
+
+  return result;
+}
+
+}; // namespace mle
@@ -0,0 +1,122 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <vector>
+#include "snpe_segmentation.h"
+#include "postprocess_utils.h"
+
+namespace mle {
+
+SNPESegmentation::SNPESegmentation(MLConfig &config)
+    : SNPEBase(config), mask_pool_(nullptr) {}
+
+SNPESegmentation::~SNPESegmentation() {
+  if (nullptr != mask_pool_) {
+    gst_buffer_pool_set_active(mask_pool_, FALSE);
+    gst_object_unref(mask_pool_);
+  }
+}
+
+int32_t SNPESegmentation::EnginePostProcess(GstBuffer* buffer) {
+  VAM_ML_LOGI("%s: Enter", __func__);
+
+  const char* name = config_.result_layers[0].c_str();
+  auto attr_opt = snpe_params_.snpe->getInputOutputBufferAttributes(name);
+  const zdl::DlSystem::TensorShape& dims = (*attr_opt)->getDims();
+  if (dims.rank() != 4) {
+    VAM_ML_LOGE("%s: Unsupported output rank %zu", __func__, dims.rank());
+    return MLE_FAIL;
+  }
+
+  // Output is in NHWC layout, channels hold the per class scores or
+  // a single class index when the model already performs the argmax.
+  uint32_t height = dims[1];
+  uint32_t width = dims[2];
+  uint32_t channels = dims[3];
+  if (channels > kMaxSegmentationClasses) {
+    VAM_ML_LOGE("%s: No support for %u classes, class maps hold up to %u",
+                __func__, channels, kMaxSegmentationClasses);
+    return MLE_FAIL;
+  }
+
+  if (palette_.empty()) {
+    uint32_t num_classes = labels_.size() ? labels_.size() : channels;
+    GenerateSegmentationPalette(std::min(num_classes, kMaxSegmentationClasses),
+                                palette_);
+  }
+
+  // Output dimensions are known only once the network is loaded.
+  if (nullptr == mask_pool_) {
+    mask_pool_ = CreateMaskPool(width * height);
+  }
+
+  GstMLSegmentationMeta *meta =
+      AddSegmentationMeta(buffer, width, height, palette_, mask_pool_);
+  if (!meta) {
+    return MLE_NULLPTR;
+  }
+  uint8_t* classes = static_cast<uint8_t*>(meta->img_buffer);
+
+  size_t size = 0;
+  const float *data = OutputData(name, size);
+  if (nullptr == data || size < width * height * channels) {
+    VAM_ML_LOGE("%s: Invalid output tensor %s", __func__, name);
+    return MLE_FAIL;
+  }
+  ArgMaxChannels(data, width * height, channels, classes);
+
+  VAM_ML_LOGI("%s: Exit", __func__);
+  return MLE_OK;
+}
+
+int32_t SNPESegmentation::Process(struct SourceFrame* frame_info,
+                                  GstBuffer* buffer) {
+  int32_t result = MLE_OK;
+
+  result = PreProcessBuffer(frame_info);
+  if (MLE_OK != result) {
+    VAM_ML_LOGE("PreProcessBuffer failed");
+    return result;
+  }
+
+  result = ExecuteSNPE();
+  if (MLE_OK != result) {
+    VAM_ML_LOGE("SNPE execution failed");
+    return result;
+  }
+
+  result = EnginePostProcess(buffer);
+  if (MLE_OK != result) {
+    VAM_ML_LOGE("EnginePostProcess failed");
+  }
+
+  return result;
+}
+
+}; // namespace mle
@@ -41,39 +41,15 @@ SNPESingleSSD::~SNPESingleSSD() {}
 int32_t SNPESingleSSD::EnginePostProcess(GstBuffer* buffer) {
   VAM_ML_LOGI("%s: Enter", __func__);
 
-  std::vector<float> result_buf;
-  const zdl::DlSystem::StringList &output_buf_names =
-      snpe_params_.output_ub_map.getUserBufferNames();
-  const zdl::DlSystem::StringList *output_names = &output_buf_names;
-
-  std::for_each(
-      output_names->begin(),
-      output_names->end(),
-      [&](const char* name)
-      {
-    // Currently, singleSSD supports only UserBuffers
-        if (config_.io_type == NetworkIO::kUserBuffer) {
-          if ((config_.input_format == InputFormat::kBgr) ||
-              (config_.input_format == InputFormat::kRgb)) {
-            if (0 == std::strcmp(name, config_.result_layers[0].c_str())) {
-              IONBuffer b = snpe_params_.out_heap_map.at(name);
-              for (size_t i = 0; i < b.size / sizeof(uint8_t); i++) {
-                result_buf.push_back(b.addr[i]);
-              }
-            }
-          } else {
-            if (0 == std::strcmp(name, config_.result_layers[0].c_str())) {
-              IONBuffer b = snpe_params_.out_heap_map.at(name);
-              for (size_t i = 0; i < b.size / sizeof(float); i++) {
-                result_buf.push_back(b.addr_f[i]);
-              }
-            }
-          }
-        }
-      });
-
-  if (result_buf.size()) {
-    output_params_ = reinterpret_cast<OutputParams*>(result_buf.data());
+  // Currently, singleSSD supports only UserBuffers
+  size_t size = 0;
+  const float *result = nullptr;
+  if (config_.io_type == NetworkIO::kUserBuffer) {
+    result = OutputData(config_.result_layers[0].c_str(), size);
+  }
+
+  if (size >= kMaxNumObjects * sizeof(OutputParams) / sizeof(float)) {
+    output_params_ = reinterpret_cast<const OutputParams*>(result);
 
     uint32_t width = init_params_.width;
     uint32_t height = init_params_.height;
@@ -83,6 +59,10 @@ int32_t SNPESingleSSD::EnginePostProcess(GstBuffer* buffer) {
       height = po_.height;
     }
 
+    GstMLDetectionBatchMeta *batch = nullptr;
+    GstMLDetectionBatchMeta **batch_ptr =
+        config_.batch_detections ? &batch : nullptr;
+
     for (size_t i = 0; i < kMaxNumObjects; i++) {
       if (output_params_[i].score < init_params_.conf_threshold) {
         continue;
@@ -94,35 +74,21 @@ int32_t SNPESingleSSD::EnginePostProcess(GstBuffer* buffer) {
         continue;
       }
 
-      GstMLDetectionMeta *meta = gst_buffer_add_detection_meta(buffer);
-      if (!meta) {
-        VAM_ML_LOGE("Failed to create metadata");
-        return MLE_NULLPTR;
-      }
-
-      GstMLClassificationResult *box_info = (GstMLClassificationResult*)malloc(
-          sizeof(GstMLClassificationResult));
-
-      uint32_t label_size = labels_.at(
-          static_cast<uint32_t>(output_params_[i].label + 0.5)).size() + 1;
-      box_info->name = (gchar *)malloc(label_size);
-      snprintf(
-          box_info->name,
-          label_size,
-          "%s",
-          labels_.at(
-              static_cast<uint32_t>(output_params_[i].label + 0.5)).c_str());
-      box_info->confidence = output_params_[i].score;
-      meta->box_info = g_slist_append (meta->box_info, box_info);
-
-      meta->bounding_box.x = std::lround(output_params_[i].boxes.x_min * width) +
+      GstMLBoundingBox box;
+      box.x = std::lround(output_params_[i].boxes.x_min * width) +
           po_.x_offset;
-      meta->bounding_box.y = std::lround(output_params_[i].boxes.y_min * height) +
+      box.y = std::lround(output_params_[i].boxes.y_min * height) +
           po_.y_offset;
-      meta->bounding_box.width = (std::lround(output_params_[i].boxes.x_max * width) +
-          po_.x_offset) - meta->bounding_box.x;
-      meta->bounding_box.height = (std::lround(output_params_[i].boxes.y_max * width) +
-          po_.x_offset) - meta->bounding_box.y;
+      box.width = (std::lround(output_params_[i].boxes.x_max * width) +
+          po_.x_offset) - box.x;
+      box.height = (std::lround(output_params_[i].boxes.y_max * width) +
+          po_.x_offset) - box.y;
+
+      if (!AddDetectionMeta(buffer, batch_ptr, kMaxNumObjects, label_table_,
+                            box, output_params_[i].score,
+                            static_cast<uint32_t>(output_params_[i].label + 0.5))) {
+        return MLE_NULLPTR;
+      }
     }
   }
 
@@ -61,7 +61,7 @@ class SNPESingleSSD : public SNPEBase {
                                  const size_t& element_size);
 
  private:
-  OutputParams *output_params_;
+  const OutputParams *output_params_;
 };
 
 }; // namespace mle
@@ -30,6 +30,8 @@
 #include <fstream>
 #include <vector>
 #include <string>
+#include <cmath>
+#include <algorithm>
 #include <fastcv/fastcv.h>
 #include <tensorflow/lite/delegates/nnapi/nnapi_delegate.h>
 #include <tensorflow/lite/examples/label_image/get_top_n.h>
@@ -42,6 +44,9 @@ namespace mle {
 
 static const uint32_t delegate_preferences = 00300000;
 
+// Suppression radius of duplicate poses in model input pixels
+static const float kPoseNmsRadius = 20.0;
+
 // Takes a file name, and loads a list of labels from it, one per line, and
 // returns a vector of the strings. It pads with empty strings so the length
 // of the result is a multiple of 16, because our model expects that.
@@ -67,12 +72,18 @@ TfLiteStatus TFLBase::ReadLabelsFile(const std::string& file_name,
 }
 
 TFLBase::TFLBase(MLConfig &config) {
+  config_.engine_output = config.engine_output;
+  config_.preprocess_mode = config.preprocess_mode;
   config_.conf_threshold = config.conf_threshold;
   config_.model_file = config.model_file;
   config_.labels_file = config.labels_file;
   config_.number_of_threads = config.number_of_threads;
   config_.use_nnapi = config.use_nnapi;
+  config_.max_poses = config.max_poses;
+  config_.batch_detections = config.batch_detections;
   input_params_.scale_buf = nullptr;
+  engine_params_.label_table = nullptr;
+  engine_params_.mask_pool = nullptr;
 }
 
 TfLiteDelegatePtrMap TFLBase::GetDelegates() {
@@ -121,10 +132,12 @@ int32_t TFLBase::Init(const struct MLEInputParams* source_info) {
   }
   VAM_ML_LOGI("%s: Loaded %d labels from %s", __func__,
                    engine_params_.label_count, labels_file_name.c_str());
+  engine_params_.label_table = CreateLabelTable(engine_params_.labels);
 
   // Gather input configuration parameters
   input_params_.width  = source_info->width;
   input_params_.height = source_info->height;
+  input_params_.stride = source_info->stride;
   input_params_.format = source_info->format;
 
   VAM_ML_LOGI("%s: Input data: format %d, height %d, width %d", __func__,
@@ -153,9 +166,37 @@ int32_t TFLBase::Init(const struct MLEInputParams* source_info) {
   // Since fast-cv based color conversion is used, no need to
   // append frame_l_data[0], frame_l_data[1] & frame_l_data[2]
 
+  // Region of the frame fed to the model. For pose models preserving the
+  // aspect ratio crops the centre of the frame to the aspect ratio of the
+  // model input. Other models keep scaling the whole frame.
+  po_.x_offset = 0;
+  po_.y_offset = 0;
+  po_.width = input_params_.width;
+  po_.height = input_params_.height;
+
+  if (config_.engine_output == EngineOutput::kPoseNet &&
+      config_.preprocess_mode == PreprocessingMode::kKeepAR) {
+    double in_ar = static_cast<double>(input_params_.width) /
+        input_params_.height;
+    double out_ar = static_cast<double>(engine_params_.width) /
+        engine_params_.height;
+
+    // Offsets are kept even, chroma samples cover two pixels.
+    if (in_ar > out_ar) {
+      po_.width = static_cast<uint32_t>(out_ar * input_params_.height) & ~1u;
+      po_.x_offset = ((input_params_.width - po_.width) / 2) & ~1u;
+    } else if (in_ar < out_ar) {
+      po_.height = static_cast<uint32_t>(input_params_.width / out_ar) & ~1u;
+      po_.y_offset = ((input_params_.height - po_.height) / 2) & ~1u;
+    }
+  }
+
+  VAM_ML_LOGI("%s: Model input region: x %d y %d width %d height %d",
+              __func__, po_.x_offset, po_.y_offset, po_.width, po_.height);
+
   // Check if rescaling is required or not
-  if ((input_params_.width != engine_params_.width) ||
-      (input_params_.height != engine_params_.height)) {
+  if ((po_.width != engine_params_.width) ||
+      (po_.height != engine_params_.height)) {
     engine_params_.do_rescale = true;
 
     // Allocate output buffer for pre-processing
@@ -217,6 +258,15 @@ void TFLBase::Deinit() {
     free(input_params_.scale_buf);
     input_params_.scale_buf = nullptr;
   }
+  if (nullptr != engine_params_.label_table) {
+    gst_ml_label_table_unref(engine_params_.label_table);
+    engine_params_.label_table = nullptr;
+  }
+  if (nullptr != engine_params_.mask_pool) {
+    gst_buffer_pool_set_active(engine_params_.mask_pool, FALSE);
+    gst_object_unref(engine_params_.mask_pool);
+    engine_params_.mask_pool = nullptr;
+  }
   VAM_ML_LOGI("%s: Exit", __func__);
 }
 
@@ -305,7 +355,102 @@ int32_t TFLBase::ValidateModelInfo() {
                 engine_params_.num_outputs);
     return MLE_FAIL;
   }
-  if (engine_params_.num_outputs == 1) {
+  if (config_.engine_output == EngineOutput::kSegmentation) {
+    // Segmentation model (e.g. DeepLabv3)
+    //   - output tensor (1, float or uint8_t, 1 X height X width X classes)
+    //   - or with the argmax in the graph (1, int32_t or int64_t,
+    //     1 X height X width)
+    if (engine_params_.num_outputs != 1) {
+      VAM_ML_LOGE("%s: No support for %d segmentation output nodes", __func__,
+                  engine_params_.num_outputs);
+      return MLE_FAIL;
+    }
+    int output = engine_params_.interpreter->outputs()[0];
+
+    TfLiteType output_type = engine_params_.interpreter->tensor(output)->type;
+    switch (output_type) {
+      case kTfLiteUInt8:
+      case kTfLiteFloat32:
+      case kTfLiteInt32:
+      case kTfLiteInt64:
+        break;
+      default:
+        VAM_ML_LOGE("%s: No support for %d output type", __func__, output_type);
+        return MLE_FAIL;
+    }
+
+    TfLiteIntArray* output_dims = engine_params_.interpreter->tensor(output)->dims;
+    if (output_dims->size != 3 && output_dims->size != 4) {
+      VAM_ML_LOGE("%s: No support for %d output dimensions", __func__,
+                  output_dims->size);
+      return MLE_FAIL;
+    }
+    engine_params_.out_height = output_dims->data[1];
+    engine_params_.out_width = output_dims->data[2];
+    engine_params_.out_channels =
+        (output_dims->size == 4) ? output_dims->data[3] : 1;
+
+    if ((output_type == kTfLiteInt32 || output_type == kTfLiteInt64) &&
+        engine_params_.out_channels != 1) {
+      VAM_ML_LOGE("%s: Integer output must hold class indices", __func__);
+      return MLE_FAIL;
+    }
+
+    if (engine_params_.out_channels > kMaxSegmentationClasses) {
+      VAM_ML_LOGE("%s: No support for %u classes, class maps hold up to %u",
+                  __func__, engine_params_.out_channels,
+                  kMaxSegmentationClasses);
+      return MLE_FAIL;
+    }
+
+    uint32_t num_classes = engine_params_.label_count ?
+        engine_params_.label_count : engine_params_.out_channels;
+    GenerateSegmentationPalette(std::min(num_classes, kMaxSegmentationClasses),
+                                engine_params_.palette);
+    engine_params_.mask_pool = CreateMaskPool(
+        engine_params_.out_width * engine_params_.out_height);
+
+    VAM_ML_LOGI("%s: Output tensor: type %d, %dx%d, channels %d", __func__,
+                output_type, engine_params_.out_width,
+                engine_params_.out_height, engine_params_.out_channels);
+  } else if (config_.engine_output == EngineOutput::kPoseNet) {
+    // PoseNet model
+    //   - output tensors (float, 1 X height X width X 17) heatmaps,
+    //     (float, 1 X height X width X 34) offsets
+    //   - optionally (float, 1 X height X width X 32) forward and backward
+    //     displacements, required for multi-person decoding
+    if (engine_params_.num_outputs != 2 && engine_params_.num_outputs != 4) {
+      VAM_ML_LOGE("%s: No support for %d PoseNet output nodes", __func__,
+                  engine_params_.num_outputs);
+      return MLE_FAIL;
+    }
+    for (uint32_t i = 0; i < engine_params_.num_outputs; ++i) {
+      int output = engine_params_.interpreter->outputs()[i];
+      TfLiteType output_type = engine_params_.interpreter->tensor(output)->type;
+      if (output_type != kTfLiteFloat32) {
+        VAM_ML_LOGE("%s: For output node %d, no support for %d output type",
+                    __func__, i, output_type);
+        return MLE_FAIL;
+      }
+    }
+
+    int output = engine_params_.interpreter->outputs()[0];
+    TfLiteIntArray* output_dims = engine_params_.interpreter->tensor(output)->dims;
+    if (output_dims->size != 4 ||
+        output_dims->data[3] != KEY_POINTS_COUNT) {
+      VAM_ML_LOGE("%s: Unsupported heatmaps shape", __func__);
+      return MLE_FAIL;
+    }
+    engine_params_.out_height = output_dims->data[1];
+    engine_params_.out_width = output_dims->data[2];
+    engine_params_.output_stride = (engine_params_.out_height > 1) ?
+        (engine_params_.height - 1) / (engine_params_.out_height - 1) :
+        engine_params_.height;
+
+    VAM_ML_LOGI("%s: Heatmaps: %dx%d, output stride %d", __func__,
+                engine_params_.out_width, engine_params_.out_height,
+                engine_params_.output_stride);
+  } else if (engine_params_.num_outputs == 1) {
     int output = engine_params_.interpreter->outputs()[0];
 
     // Check for output tensor type
@@ -370,6 +515,7 @@ void TFLBase::PreProcessScale(
   uint8_t*       pDst,
   const uint32_t srcWidth,
   const uint32_t srcHeight,
+  const uint32_t srcStride,
   const uint32_t scaleWidth,
   const uint32_t scaleHeight,
   MLEImageFormat format)
@@ -379,7 +525,7 @@ void TFLBase::PreProcessScale(
     fcvScaleDownMNu8(pSrcLuma,
                      srcWidth,
                      srcHeight,
-                     0,
+                     srcStride,
                      pDst,
                      scaleWidth,
                      scaleHeight,
@@ -387,7 +533,7 @@ void TFLBase::PreProcessScale(
     fcvScaleDownMNu8(pSrcChroma,
                      srcWidth,
                      srcHeight/2,
-                     0,
+                     srcStride,
                      pDst + (scaleWidth*scaleHeight),
                      scaleWidth,
                      scaleHeight/2,
@@ -417,12 +563,21 @@ void TFLBase::PreProcessColorConvertRGB(
 
 int32_t TFLBase::PreProcessInput(SourceFrame* frame_info) {
   VAM_ML_LOGI("%s: Enter", __func__);
+
+  // Start of the model input region in both planes.
+  uint32_t stride = input_params_.stride;
+  uint8_t* luma = frame_info->frame_data[0] + po_.y_offset * stride +
+      po_.x_offset;
+  uint8_t* chroma = frame_info->frame_data[1] + (po_.y_offset / 2) * stride +
+      po_.x_offset;
+
   if (engine_params_.do_rescale) {
-    PreProcessScale(frame_info->frame_data[0],
-                    frame_info->frame_data[1],
+    PreProcessScale(luma,
+                    chroma,
                     input_params_.scale_buf,
-                    input_params_.width,
-                    input_params_.height,
+                    po_.width,
+                    po_.height,
+                    stride,
                     engine_params_.width,
                     engine_params_.height,
                     input_params_.format);
@@ -435,10 +590,10 @@ int32_t TFLBase::PreProcessInput(SourceFrame* frame_info) {
                               input_params_.format);
   } else {
     //Color conversion
-    fcvColorYCbCr420PseudoPlanarToRGB888u8(frame_info->frame_data[0],
-                                           frame_info->frame_data[1],
-                                           input_params_.width,
-                                           input_params_.height, 0, 0,
+    fcvColorYCbCr420PseudoPlanarToRGB888u8(luma,
+                                           chroma,
+                                           po_.width,
+                                           po_.height, stride, stride,
                                            engine_params_.input_buffer, 0);
   }
   VAM_ML_LOGI("%s: Exit", __func__);
@@ -455,41 +610,110 @@ int32_t TFLBase::PostProcessMultiOutput(GstBuffer* buffer) {
 
   float num_box = num_boxes[0];
   VAM_ML_LOGI("%s: Found %f boxes", __func__, num_box);
+
+  uint32_t width = input_params_.width;
+  uint32_t height = input_params_.height;
+  GstMLDetectionBatchMeta *batch = nullptr;
+  GstMLDetectionBatchMeta **batch_ptr =
+      config_.batch_detections ? &batch : nullptr;
+
   for (int i = 0; i < num_box; i++) {
     if (detected_scores[i] < config_.conf_threshold) continue;
 
-    uint32_t width = input_params_.width;
-    uint32_t height = input_params_.height;
-
-    GstMLDetectionMeta *meta = gst_buffer_add_detection_meta(buffer);
-    if (!meta) {
-      VAM_ML_LOGE("Failed to create metadata");
+    GstMLBoundingBox box;
+    box.x = static_cast<uint32_t>(detected_boxes[i * 4 + 1] * width);
+    box.y = static_cast<uint32_t>(detected_boxes[i * 4] * height);
+    box.width = static_cast<uint32_t>(detected_boxes[i * 4 + 3] * width) -
+        box.x;
+    box.height = static_cast<uint32_t>(detected_boxes[i * 4 + 2] * height) -
+        box.y;
+
+    if (!AddDetectionMeta(buffer, batch_ptr, std::ceil(num_box),
+                          engine_params_.label_table, box, detected_scores[i],
+                          static_cast<uint32_t>(detected_classes[i] + 1))) {
       return MLE_NULLPTR;
     }
+  }
+  VAM_ML_LOGI("%s: Exit", __func__);
+  return MLE_OK;
+}
+
+int32_t TFLBase::PostProcessSegmentation(GstBuffer* buffer) {
+  VAM_ML_LOGI("%s: Enter", __func__);
+
+  uint32_t width = engine_params_.out_width;
+  uint32_t height = engine_params_.out_height;
+  uint32_t num_pixels = width * height;
+
+  GstMLSegmentationMeta *meta =
+      AddSegmentationMeta(buffer, width, height, engine_params_.palette,
+                          engine_params_.mask_pool);
+  if (!meta) {
+    return MLE_NULLPTR;
+  }
+  uint8_t* classes = static_cast<uint8_t*>(meta->img_buffer);
+
+  int output = engine_params_.interpreter->outputs()[0];
+  switch (engine_params_.interpreter->tensor(output)->type) {
+    case kTfLiteFloat32:
+      ArgMaxChannels(engine_params_.interpreter->typed_output_tensor<float>(0),
+                     num_pixels, engine_params_.out_channels, classes);
+      break;
+    case kTfLiteUInt8:
+      ArgMaxChannels(engine_params_.interpreter->typed_output_tensor<uint8_t>(0),
+                     num_pixels, engine_params_.out_channels, classes);
+      break;
+    case kTfLiteInt32:
+      ClassIndices(engine_params_.interpreter->typed_output_tensor<int32_t>(0),
+                   num_pixels, classes);
+      break;
+    case kTfLiteInt64:
+      ClassIndices(engine_params_.interpreter->typed_output_tensor<int64_t>(0),
+                   num_pixels, classes);
+      break;
+    default:
+      VAM_ML_LOGE("%s: Invalid output tensor type %d", __func__,
+                  engine_params_.interpreter->tensor(output)->type);
+      return MLE_FAIL;
+  }
+
+  VAM_ML_LOGI("%s: Exit", __func__);
+  return MLE_OK;
+}
+
+int32_t TFLBase::PostProcessPoseNet(GstBuffer* buffer) {
+  VAM_ML_LOGI("%s: Enter", __func__);
+
+  PoseNetOutputs outputs;
+  outputs.heatmaps = engine_params_.interpreter->typed_output_tensor<float>(0);
+  outputs.offsets = engine_params_.interpreter->typed_output_tensor<float>(1);
+  outputs.displacements_fwd = nullptr;
+  outputs.displacements_bwd = nullptr;
+  if (engine_params_.num_outputs == 4) {
+    outputs.displacements_fwd =
+        engine_params_.interpreter->typed_output_tensor<float>(2);
+    outputs.displacements_bwd =
+        engine_params_.interpreter->typed_output_tensor<float>(3);
+  }
+  outputs.height = engine_params_.out_height;
+  outputs.width = engine_params_.out_width;
+  outputs.output_stride = engine_params_.output_stride;
+
+  DecodePoses(outputs, config_.max_poses, config_.conf_threshold,
+              kPoseNmsRadius, engine_params_.poses);
+  VAM_ML_LOGI("%s: Found %zu poses", __func__, engine_params_.poses.size());
+
+  // Keypoints are in model input pixels, map them into the frame region.
+  float scale_x = static_cast<float>(po_.width) / engine_params_.width;
+  float scale_y = static_cast<float>(po_.height) / engine_params_.height;
 
-    GstMLClassificationResult *box_info = (GstMLClassificationResult*)malloc(
-        sizeof(GstMLClassificationResult));
-
-    uint32_t label_size =
-        engine_params_.labels[detected_classes[i] + 1].size() + 1;
-    box_info->name = (gchar *)malloc(label_size);
-    snprintf(
-        box_info->name,
-        label_size,
-        "%s",
-        engine_params_.labels[detected_classes[i] + 1].c_str());
-    box_info->confidence = detected_scores[i];
-    meta->box_info = g_slist_append (meta->box_info, box_info);
-
-    meta->bounding_box.x = static_cast<uint32_t>(
-        detected_boxes[i * 4 + 1] * width);
-    meta->bounding_box.y = static_cast<uint32_t>(
-        detected_boxes[i * 4] * height);
-    meta->bounding_box.width = static_cast<uint32_t>(
-        detected_boxes[i * 4 + 3] * width) - meta->bounding_box.x;
-    meta->bounding_box.height = static_cast<uint32_t>(
-        detected_boxes[i * 4 + 2] * height) - meta->bounding_box.y;
+  for (const auto& pose : engine_params_.poses) {
+    if (!AddPoseNetMeta(buffer, pose, scale_x, scale_y, po_.x_offset,
+                        po_.y_offset)) {
+      return MLE_NULLPTR;
+    }
   }
+
   VAM_ML_LOGI("%s: Exit", __func__);
   return MLE_OK;
 }
@@ -497,6 +721,24 @@ int32_t TFLBase::PostProcessMultiOutput(GstBuffer* buffer) {
 int32_t TFLBase::PostProcessOutput(GstBuffer* buffer) {
   VAM_ML_LOGI("%s: Enter", __func__);
 
+  if (config_.engine_output == EngineOutput::kPoseNet) {
+    if (PostProcessPoseNet(buffer) != MLE_OK) {
+      VAM_ML_LOGE("%s: PostProcessPoseNet Failed!!!", __func__);
+      return MLE_FAIL;
+    }
+    VAM_ML_LOGI("%s: Exit", __func__);
+    return MLE_OK;
+  }
+
+  if (config_.engine_output == EngineOutput::kSegmentation) {
+    if (PostProcessSegmentation(buffer) != MLE_OK) {
+      VAM_ML_LOGE("%s: PostProcessSegmentation Failed!!!", __func__);
+      return MLE_FAIL;
+    }
+    VAM_ML_LOGI("%s: Exit", __func__);
+    return MLE_OK;
+  }
+
   if (engine_params_.num_outputs == 4) {
     // post-processing the output results from 4 nodes
     if (PostProcessMultiOutput(buffer) != MLE_OK) {
@@ -546,14 +788,14 @@ int32_t TFLBase::PostProcessOutput(GstBuffer* buffer) {
       return MLE_FAIL;
       break;
   }
-  VAM_ML_LOGI("%s: Found %d objects", __func__, top_results.size());
+  VAM_ML_LOGI("%s: Found %zu objects", __func__, top_results.size());
 
   // If found, return the label with most confidence level
   if (top_results.size() > 0) {
     const auto& result = top_results.front();
     const float confidence = result.first;
     const int index = result.second;
-    if (confidence > config_.conf_threshold) {
+    if (confidence > config_.conf_threshold && engine_params_.label_table) {
       VAM_ML_LOGI("%s: confidence %f, index %d, label %s", __func__,
                       confidence, index, engine_params_.labels[index].c_str());
 
@@ -565,10 +807,9 @@ int32_t TFLBase::PostProcessOutput(GstBuffer* buffer) {
       }
 
       meta->result.confidence = confidence;
-      uint32_t label_size = engine_params_.labels[index].size() + 1;
-      meta->result.name = (gchar *)malloc(label_size);
-      snprintf(meta->result.name, label_size, "%s",
-               engine_params_.labels[index].c_str());
+      gst_ml_classification_result_set_label(&meta->result,
+                                             engine_params_.label_table,
+                                             index);
     }
   }
 
@@ -41,6 +41,7 @@
 
 #include "ml_engine_intf.h"
 #include "common_utils.h"
+#include "postprocess_utils.h"
 
 namespace mle {
 
@@ -50,6 +51,7 @@ using TfLiteDelegatePtrMap = std::map<std::string, TfLiteDelegatePtr>;
 struct TFLiteEngineInputParams {
   uint32_t width;
   uint32_t height;
+  uint32_t stride;
   MLEImageFormat format;
   uint8_t* scale_buf;
 };
@@ -69,6 +71,14 @@ struct TFLiteEngineParams {
   float* input_buffer_f;
   std::vector<std::string> labels;
   size_t label_count;
+  GstMLLabelTable* label_table;
+  uint32_t out_height;
+  uint32_t out_width;
+  uint32_t out_channels;
+  std::vector<uint32_t> palette;
+  GstBufferPool* mask_pool;
+  uint32_t output_stride;
+  std::vector<Pose> poses;
 };
 
 class TFLBase : public MLEngine {
@@ -83,6 +93,8 @@ class TFLBase : public MLEngine {
   int32_t ValidateModelInfo();
   int32_t PreProcessInput(SourceFrame* frame_info);
   int32_t PostProcessMultiOutput(GstBuffer* buffer);
+  int32_t PostProcessSegmentation(GstBuffer* buffer);
+  int32_t PostProcessPoseNet(GstBuffer* buffer);
   int32_t PostProcessOutput(GstBuffer* buffer);
   TfLiteStatus ReadLabelsFile(const std::string& file_name,
                               std::vector<std::string>& result,
@@ -92,6 +104,7 @@ class TFLBase : public MLEngine {
                       uint8_t*       pDst,
                       const uint32_t srcWidth,
                       const uint32_t srcHeight,
+                      const uint32_t srcStride,
                       const uint32_t scaleWidth,
                       const uint32_t scaleHeight,
                       MLEImageFormat format);
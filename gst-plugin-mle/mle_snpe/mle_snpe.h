@@ -81,6 +81,20 @@ struct _GstMLESNPE {
   gchar *result_layers;
   guint preprocessing_type;
   gfloat conf_threshold;
+  guint max_poses;
+  gboolean batch_detections;
+  guint qos_policy;
+  guint qos_max_interval;
+
+  // QoS state, updated from downstream QoS events under the object lock.
+  gdouble qos_proportion;
+  GstClockTime qos_earliest_time;
+
+  // Results of the last processed frame, reused for skipped frames.
+  GstBuffer *last_results;
+  guint consecutive_skips;
+  guint64 processed;
+  guint64 dropped;
 };
 
 struct _GstMLESNPEClass {
@@ -29,6 +29,7 @@
 
 #include <json/json.h>
 #include <cstring>
+#include <cmath>
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
@@ -47,6 +48,11 @@ G_DEFINE_TYPE (GstMLETFLite, gst_mle_tflite, GST_TYPE_VIDEO_FILTER);
 #define DEFAULT_PROP_MLE_TFLITE_CONF_THRESHOLD 0.5
 #define DEFAULT_PROP_MLE_TFLITE_PREPROCESSING_TYPE 0
 #define DEFAULT_TFLITE_NUM_THREADS 2
+#define DEFAULT_PROP_MLE_TFLITE_OUTPUT 0 //kSingle
+#define DEFAULT_PROP_MLE_MAX_POSES 5
+#define DEFAULT_PROP_MLE_BATCH_DETECTIONS FALSE
+#define DEFAULT_PROP_MLE_QOS_POLICY 1 //Skip late frames
+#define DEFAULT_PROP_MLE_QOS_MAX_INTERVAL 8
 #define GST_MLE_UNUSED(var) ((void)var)
 
 enum {
@@ -58,12 +64,38 @@ enum {
   PROP_MLE_CONF_THRESHOLD,
   PROP_MLE_TFLITE_USE_NNAPI,
   PROP_MLE_TFLITE_NUM_THREADS,
+  PROP_MLE_TFLITE_OUTPUT,
+  PROP_MLE_MAX_POSES,
+  PROP_MLE_BATCH_DETECTIONS,
+  PROP_MLE_QOS_POLICY,
+  PROP_MLE_QOS_MAX_INTERVAL,
+};
+
+enum {
+  GST_MLE_QOS_POLICY_NONE,
+  GST_MLE_QOS_POLICY_SKIP,
+  GST_MLE_QOS_POLICY_THROTTLE,
 };
 
 
 static GstStaticCaps gst_mle_tflite_format_caps =
     GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE_WITH_FEATURES ("ANY", GST_ML_VIDEO_FORMATS));
 
+// Either the base class or the element handles QoS, never both. With a
+// policy the element needs late frames to reuse the last results, so the
+// base class must not drop them.
+static void
+gst_mle_tflite_update_qos_owner(GstMLETFLite *mle)
+{
+  gboolean enable;
+
+  GST_OBJECT_LOCK (mle);
+  enable = (mle->qos_policy == GST_MLE_QOS_POLICY_NONE);
+  GST_OBJECT_UNLOCK (mle);
+
+  gst_base_transform_set_qos_enabled(GST_BASE_TRANSFORM (mle), enable);
+}
+
 static void
 gst_mle_tflite_set_property_mask(guint &mask, guint property_id)
 {
@@ -112,11 +144,32 @@ gst_mle_tflite_set_property(GObject *object, guint property_id,
       gst_mle_tflite_set_property_mask(mle->property_mask, property_id);
       mle->num_threads = g_value_get_uint (value);
       break;
+    case PROP_MLE_TFLITE_OUTPUT:
+      gst_mle_tflite_set_property_mask(mle->property_mask, property_id);
+      mle->output = g_value_get_uint (value);
+      break;
+    case PROP_MLE_MAX_POSES:
+      gst_mle_tflite_set_property_mask(mle->property_mask, property_id);
+      mle->max_poses = g_value_get_uint (value);
+      break;
+    case PROP_MLE_BATCH_DETECTIONS:
+      gst_mle_tflite_set_property_mask(mle->property_mask, property_id);
+      mle->batch_detections = g_value_get_boolean (value);
+      break;
+    case PROP_MLE_QOS_POLICY:
+      mle->qos_policy = g_value_get_uint (value);
+      break;
+    case PROP_MLE_QOS_MAX_INTERVAL:
+      mle->qos_max_interval = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
   }
   GST_OBJECT_UNLOCK (mle);
+
+  if (property_id == PROP_MLE_QOS_POLICY)
+    gst_mle_tflite_update_qos_owner(mle);
 }
 
 static void
@@ -148,6 +201,21 @@ gst_mle_tflite_get_property(GObject *object, guint property_id,
     case PROP_MLE_TFLITE_NUM_THREADS:
       g_value_set_uint (value, mle->num_threads);
       break;
+    case PROP_MLE_TFLITE_OUTPUT:
+      g_value_set_uint (value, mle->output);
+      break;
+    case PROP_MLE_MAX_POSES:
+      g_value_set_uint (value, mle->max_poses);
+      break;
+    case PROP_MLE_BATCH_DETECTIONS:
+      g_value_set_boolean (value, mle->batch_detections);
+      break;
+    case PROP_MLE_QOS_POLICY:
+      g_value_set_uint (value, mle->qos_policy);
+      break;
+    case PROP_MLE_QOS_MAX_INTERVAL:
+      g_value_set_uint (value, mle->qos_max_interval);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -170,6 +238,9 @@ gst_mle_tflite_finalize(GObject * object)
   if (mle->labels_filename) {
     g_free(mle->labels_filename);
   }
+  if (mle->last_results) {
+    gst_buffer_unref(mle->last_results);
+  }
 
   G_OBJECT_CLASS(parent_class)->finalize(G_OBJECT(mle));
 }
@@ -210,10 +281,16 @@ gst_mle_tflite_parse_config(gchar *config_location,
     Json::Value val;
     if (reader.parse(in, val)) {
       configuration.conf_threshold = val.get("ConfThreshold", 0.0).asFloat();
+      configuration.max_poses =
+          val.get("MaxPoses", DEFAULT_PROP_MLE_MAX_POSES).asUInt();
+      configuration.batch_detections =
+          val.get("BatchDetections", DEFAULT_PROP_MLE_BATCH_DETECTIONS).asBool();
       configuration.model_file = val.get("MODEL_FILENAME", "").asString();
       configuration.labels_file = val.get("LABELS_FILENAME", "").asString();
       configuration.number_of_threads = val.get("NUM_THREADS", 2).asInt();
       configuration.use_nnapi = val.get("USE_NNAPI", 0).asInt();
+      configuration.engine_output =
+          (mle::EngineOutput)val.get("EngineOutput", 0).asInt();
       rc = TRUE;
     }
     in.close();
@@ -235,6 +312,11 @@ gst_mle_create_engine(GstMLETFLite *mle) {
   configuration.conf_threshold = mle->conf_threshold;
   configuration.use_nnapi = mle->use_nnapi;
   configuration.number_of_threads = mle->num_threads;
+  configuration.engine_output = (mle::EngineOutput)mle->output;
+  configuration.preprocess_mode =
+      (mle::PreprocessingMode)mle->preprocessing_type;
+  configuration.max_poses = mle->max_poses;
+  configuration.batch_detections = mle->batch_detections;
 
   // Set configuration values from json config file
   if (mle->config_location) {
@@ -256,6 +338,16 @@ gst_mle_create_engine(GstMLETFLite *mle) {
   if (gst_mle_check_is_set(mle->property_mask, PROP_MLE_CONF_THRESHOLD)) {
     configuration.conf_threshold = mle->conf_threshold;
   }
+  if (gst_mle_check_is_set(mle->property_mask, PROP_MLE_PREPROCESSING_TYPE)) {
+    configuration.preprocess_mode =
+        (mle::PreprocessingMode)mle->preprocessing_type;
+  }
+  if (gst_mle_check_is_set(mle->property_mask, PROP_MLE_MAX_POSES)) {
+    configuration.max_poses = mle->max_poses;
+  }
+  if (gst_mle_check_is_set(mle->property_mask, PROP_MLE_BATCH_DETECTIONS)) {
+    configuration.batch_detections = mle->batch_detections;
+  }
 
   if (gst_mle_check_is_set(mle->property_mask, PROP_MLE_TFLITE_NUM_THREADS)) {
     configuration.number_of_threads = mle->num_threads;
@@ -263,6 +355,9 @@ gst_mle_create_engine(GstMLETFLite *mle) {
   if (gst_mle_check_is_set(mle->property_mask, PROP_MLE_TFLITE_USE_NNAPI)) {
     configuration.use_nnapi = mle->use_nnapi;
   }
+  if (gst_mle_check_is_set(mle->property_mask, PROP_MLE_TFLITE_OUTPUT)) {
+    configuration.engine_output = mle::EngineOutput(mle->output);
+  }
   mle->engine = new mle::TFLBase(configuration);
   if (nullptr == mle->engine) {
     GST_ERROR_OBJECT (mle, "Failed to create TFLite instance.");
@@ -310,6 +405,10 @@ gst_mle_tflite_set_info(GstVideoFilter *filter, GstCaps *in,
       mle->engine->Deinit();
       mle->engine = nullptr;
       mle->is_init = FALSE;
+      if (mle->last_results) {
+        gst_buffer_unref(mle->last_results);
+        mle->last_results = nullptr;
+      }
     } else {
       return TRUE;
     }
@@ -346,11 +445,158 @@ gst_mle_tflite_set_info(GstVideoFilter *filter, GstCaps *in,
   return rc;
 }
 
+static void
+gst_mle_tflite_reset_qos(GstMLETFLite *mle)
+{
+  GST_OBJECT_LOCK (mle);
+  mle->qos_proportion = 1.0;
+  mle->qos_earliest_time = GST_CLOCK_TIME_NONE;
+  GST_OBJECT_UNLOCK (mle);
+
+  mle->consecutive_skips = 0;
+}
+
+static gboolean
+gst_mle_tflite_src_event(GstBaseTransform *trans, GstEvent *event)
+{
+  GstMLETFLite *mle = GST_MLE_TFLITE (trans);
+
+  // The base class keeps its own QoS state when it handles QoS.
+  if (GST_EVENT_TYPE (event) == GST_EVENT_QOS &&
+      !gst_base_transform_is_qos_enabled(trans)) {
+    GstQOSType type;
+    gdouble proportion;
+    GstClockTimeDiff diff;
+    GstClockTime timestamp;
+
+    gst_event_parse_qos(event, &type, &proportion, &diff, &timestamp);
+
+    GST_OBJECT_LOCK (mle);
+    mle->qos_proportion = proportion;
+    if (G_UNLIKELY (diff > 0)) {
+      // Frames are late, leave some headroom for the next ones.
+      mle->qos_earliest_time = timestamp + 2 * diff;
+    } else if ((GstClockTime) -diff < timestamp) {
+      mle->qos_earliest_time = timestamp + diff;
+    } else {
+      mle->qos_earliest_time = 0;
+    }
+    GST_OBJECT_UNLOCK (mle);
+
+    GST_LOG_OBJECT (mle, "QoS proportion %f, earliest time %" GST_TIME_FORMAT,
+        proportion, GST_TIME_ARGS (timestamp + diff));
+  }
+
+  return GST_BASE_TRANSFORM_CLASS (parent_class)->src_event(trans, event);
+}
+
+static gboolean
+gst_mle_tflite_sink_event(GstBaseTransform *trans, GstEvent *event)
+{
+  GstMLETFLite *mle = GST_MLE_TFLITE (trans);
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_FLUSH_STOP:
+    case GST_EVENT_STREAM_START:
+      gst_mle_tflite_reset_qos(mle);
+      break;
+    default:
+      break;
+  }
+
+  return GST_BASE_TRANSFORM_CLASS (parent_class)->sink_event(trans, event);
+}
+
+static gboolean
+gst_mle_tflite_skip_inference(GstMLETFLite *mle, GstClockTime running_time)
+{
+  guint policy, max_interval, interval;
+  gdouble proportion;
+  GstClockTime earliest_time;
+  gboolean late;
+
+  GST_OBJECT_LOCK (mle);
+  policy = mle->qos_policy;
+  max_interval = mle->qos_max_interval;
+  proportion = mle->qos_proportion;
+  earliest_time = mle->qos_earliest_time;
+  GST_OBJECT_UNLOCK (mle);
+
+  // Nothing to reuse or the results became too old, inference is mandatory.
+  if (GST_MLE_QOS_POLICY_NONE == policy || nullptr == mle->last_results ||
+      (mle->consecutive_skips + 1) >= max_interval) {
+    return FALSE;
+  }
+
+  late = GST_CLOCK_TIME_IS_VALID (running_time) &&
+      GST_CLOCK_TIME_IS_VALID (earliest_time) &&
+      running_time <= earliest_time;
+
+  if (late) {
+    GST_DEBUG_OBJECT (mle, "Frame late by %" GST_TIME_FORMAT,
+        GST_TIME_ARGS (earliest_time - running_time));
+    return TRUE;
+  }
+
+  if (GST_MLE_QOS_POLICY_THROTTLE == policy) {
+    // Downstream can't keep up, run the model only on every Nth frame.
+    interval = (guint) ceil(proportion);
+    interval = CLAMP (interval, 1, max_interval);
+    return (mle->consecutive_skips + 1) < interval;
+  }
+
+  return FALSE;
+}
+
+static void
+gst_mle_tflite_post_qos(GstMLETFLite *mle, GstBuffer *buffer,
+                      GstClockTime running_time)
+{
+  GstBaseTransform *trans = GST_BASE_TRANSFORM (mle);
+  GstClockTime timestamp = GST_BUFFER_PTS (buffer);
+  GstClockTime stream_time;
+  GstClockTime earliest_time;
+  gdouble proportion;
+  GstMessage *msg;
+
+  stream_time = gst_segment_to_stream_time(&trans->segment, GST_FORMAT_TIME,
+      timestamp);
+
+  GST_OBJECT_LOCK (mle);
+  proportion = mle->qos_proportion;
+  earliest_time = mle->qos_earliest_time;
+  GST_OBJECT_UNLOCK (mle);
+
+  msg = gst_message_new_qos(GST_OBJECT_CAST (mle), FALSE, running_time,
+      stream_time, timestamp, GST_BUFFER_DURATION (buffer));
+  gst_message_set_qos_values(msg,
+      GST_CLOCK_TIME_IS_VALID (earliest_time) ?
+          GST_CLOCK_DIFF (running_time, earliest_time) : 0,
+      proportion, 1000000);
+  gst_message_set_qos_stats(msg, GST_FORMAT_BUFFERS, mle->processed,
+      mle->dropped);
+  gst_element_post_message(GST_ELEMENT_CAST (mle), msg);
+}
+
 static GstFlowReturn gst_mle_tflite_transform_frame_ip(GstVideoFilter *filter,
                                                        GstVideoFrame *frame)
 {
   GstMemory *memory = NULL;
   GstMLETFLite *mle = GST_MLE_TFLITE (filter);
+  GstClockTime running_time;
+  guint policy;
+
+  running_time = gst_segment_to_running_time(
+      &GST_BASE_TRANSFORM (filter)->segment, GST_FORMAT_TIME,
+      GST_BUFFER_PTS (frame->buffer));
+
+  if (gst_mle_tflite_skip_inference(mle, running_time)) {
+    gst_buffer_copy_ml_meta(frame->buffer, mle->last_results);
+    mle->consecutive_skips++;
+    mle->dropped++;
+    gst_mle_tflite_post_qos(mle, frame->buffer, running_time);
+    return GST_FLOW_OK;
+  }
 
   memory = gst_buffer_peek_memory (frame->buffer, 0);
   if (!gst_is_fd_memory (memory)) {
@@ -367,6 +613,22 @@ static GstFlowReturn gst_mle_tflite_transform_frame_ip(GstVideoFilter *filter,
     return GST_FLOW_ERROR;
   }
 
+  mle->consecutive_skips = 0;
+  mle->processed++;
+
+  GST_OBJECT_LOCK (mle);
+  policy = mle->qos_policy;
+  GST_OBJECT_UNLOCK (mle);
+
+  // Keep a copy of the results in case next frames have to be skipped.
+  if (policy != GST_MLE_QOS_POLICY_NONE) {
+    if (mle->last_results) {
+      gst_buffer_unref(mle->last_results);
+    }
+    mle->last_results = gst_buffer_new();
+    gst_buffer_copy_ml_meta(mle->last_results, frame->buffer);
+  }
+
   return GST_FLOW_OK;
 }
 
@@ -375,6 +637,7 @@ gst_mle_tflite_class_init (GstMLETFLiteClass * klass)
 {
   GObjectClass *gobject            = G_OBJECT_CLASS (klass);
   GstElementClass *element         = GST_ELEMENT_CLASS (klass);
+  GstBaseTransformClass *transform = GST_BASE_TRANSFORM_CLASS (klass);
   GstVideoFilterClass *filter      = GST_VIDEO_FILTER_CLASS (klass);
 
   gobject->set_property = GST_DEBUG_FUNCPTR(gst_mle_tflite_set_property);
@@ -466,6 +729,72 @@ gst_mle_tflite_class_init (GstMLETFLiteClass * klass)
           static_cast<GParamFlags>(G_PARAM_READWRITE |
                                    G_PARAM_STATIC_STRINGS)));
 
+  g_object_class_install_property(
+      gobject,
+      PROP_MLE_TFLITE_OUTPUT,
+      g_param_spec_uint(
+          "output",
+          "TFLite output",
+          "Model output type: Eg.: 0 - classification or SSD; "
+          "4 - segmentation; 5 - posenet",
+          0,
+          5,
+          DEFAULT_PROP_MLE_TFLITE_OUTPUT,
+          static_cast<GParamFlags>(G_PARAM_READWRITE |
+                                   G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property(
+      gobject,
+      PROP_MLE_MAX_POSES,
+      g_param_spec_uint(
+          "max-poses",
+          "Max poses",
+          "Max number of poses decoded by pose estimation models",
+          1,
+          100,
+          DEFAULT_PROP_MLE_MAX_POSES,
+          static_cast<GParamFlags>(G_PARAM_READWRITE |
+                                   G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property(
+      gobject,
+      PROP_MLE_BATCH_DETECTIONS,
+      g_param_spec_boolean(
+          "batch-detections",
+          "Batch detections",
+          "Attach all detected objects of a frame as a single detection "
+          "batch meta instead of one detection meta per object",
+          DEFAULT_PROP_MLE_BATCH_DETECTIONS,
+          static_cast<GParamFlags>(G_PARAM_READWRITE |
+                                   G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property(
+      gobject,
+      PROP_MLE_QOS_POLICY,
+      g_param_spec_uint(
+          "qos-policy",
+          "QoS policy",
+          "0 - drop late frames; 1 - skip late frames and reuse last results; "
+          "2 - skip late frames and lower inference rate by QoS proportion",
+          0,
+          2,
+          DEFAULT_PROP_MLE_QOS_POLICY,
+          static_cast<GParamFlags>(G_PARAM_READWRITE |
+                                   G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property(
+      gobject,
+      PROP_MLE_QOS_MAX_INTERVAL,
+      g_param_spec_uint(
+          "qos-max-interval",
+          "QoS max interval",
+          "Max number of frames between two inferences when QoS is active",
+          1,
+          G_MAXUINT,
+          DEFAULT_PROP_MLE_QOS_MAX_INTERVAL,
+          static_cast<GParamFlags>(G_PARAM_READWRITE |
+                                   G_PARAM_STATIC_STRINGS)));
+
   gst_element_class_set_static_metadata(
       element, "MLE TFLite", "Execute TFLite NN models",
       "Pre-process, execute NN model, post-process", "QTI");
@@ -475,6 +804,9 @@ gst_mle_tflite_class_init (GstMLETFLiteClass * klass)
   gst_element_class_add_pad_template(element,
                                      gst_mle_src_template());
 
+  transform->src_event = GST_DEBUG_FUNCPTR (gst_mle_tflite_src_event);
+  transform->sink_event = GST_DEBUG_FUNCPTR (gst_mle_tflite_sink_event);
+
   filter->set_info = GST_DEBUG_FUNCPTR (gst_mle_tflite_set_info);
   filter->transform_frame_ip =
       GST_DEBUG_FUNCPTR (gst_mle_tflite_transform_frame_ip);
@@ -491,6 +823,18 @@ gst_mle_tflite_init (GstMLETFLite * mle)
   mle->conf_threshold = DEFAULT_PROP_MLE_TFLITE_CONF_THRESHOLD;
   mle->num_threads = DEFAULT_TFLITE_NUM_THREADS;
   mle->use_nnapi = 0;
+  mle->output = DEFAULT_PROP_MLE_TFLITE_OUTPUT;
+  mle->max_poses = DEFAULT_PROP_MLE_MAX_POSES;
+  mle->batch_detections = DEFAULT_PROP_MLE_BATCH_DETECTIONS;
+  mle->qos_policy = DEFAULT_PROP_MLE_QOS_POLICY;
+  mle->qos_max_interval = DEFAULT_PROP_MLE_QOS_MAX_INTERVAL;
+  mle->qos_proportion = 1.0;
+  mle->qos_earliest_time = GST_CLOCK_TIME_NONE;
+  gst_mle_tflite_update_qos_owner(mle);
+  mle->last_results = nullptr;
+  mle->consecutive_skips = 0;
+  mle->processed = 0;
+  mle->dropped = 0;
 
   GST_DEBUG_CATEGORY_INIT (mle_tflite_debug, "mletflite", 0,
       "QTI Machine Learning Engine");
@@ -0,0 +1,654 @@
+/*
+* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "ml_meta_mux.h"
+
+#include <ml-meta/ml_meta.h>
+
+#define GST_CAT_DEFAULT ml_meta_mux_debug
+GST_DEBUG_CATEGORY_STATIC (ml_meta_mux_debug);
+
+#define gst_ml_meta_mux_parent_class parent_class
+G_DEFINE_TYPE (GstMLMetaMux, gst_ml_meta_mux, GST_TYPE_ELEMENT);
+
+#define DEFAULT_PROP_TOLERANCE    (10 * GST_MSECOND)
+#define DEFAULT_PROP_MAX_LATENCY  (100 * GST_MSECOND)
+#define DEFAULT_PROP_REUSE_LAST   TRUE
+
+// Upper bound of results waiting for a matching video frame.
+#define MAX_PENDING_RESULTS       32
+
+enum
+{
+  PROP_0,
+  PROP_TOLERANCE,
+  PROP_MAX_LATENCY,
+  PROP_REUSE_LAST,
+};
+
+static GstStaticPadTemplate gst_ml_meta_mux_sink_template =
+    GST_STATIC_PAD_TEMPLATE ("sink", GST_PAD_SINK, GST_PAD_ALWAYS,
+        GST_STATIC_CAPS ("video/x-raw(ANY)"));
+
+static GstStaticPadTemplate gst_ml_meta_mux_meta_template =
+    GST_STATIC_PAD_TEMPLATE ("analytics", GST_PAD_SINK, GST_PAD_ALWAYS,
+        GST_STATIC_CAPS_ANY);
+
+static GstStaticPadTemplate gst_ml_meta_mux_src_template =
+    GST_STATIC_PAD_TEMPLATE ("src", GST_PAD_SRC, GST_PAD_ALWAYS,
+        GST_STATIC_CAPS ("video/x-raw(ANY)"));
+
+static void
+gst_ml_meta_mux_clear_results (GstMLMetaMux * mux)
+{
+  GstBuffer *results = NULL;
+
+  while ((results = g_queue_pop_head (&mux->results))) {
+    gst_buffer_unref (results);
+  }
+  gst_buffer_replace (&mux->last, NULL);
+}
+
+static void
+gst_ml_meta_mux_expire_head (GstMLMetaMux * mux)
+{
+  GstBuffer *results = g_queue_pop_head (&mux->results);
+
+  // The expired results are newer than the previous last ones.
+  gst_buffer_replace (&mux->last, results);
+  gst_buffer_unref (results);
+}
+
+// Whether results at or past the given timestamp have been received,
+// i.e. waiting longer will not bring a better match.
+static gboolean
+gst_ml_meta_mux_results_ready (GstMLMetaMux * mux, GstClockTime pts)
+{
+  GstBuffer *newest = NULL;
+
+  if (!GST_CLOCK_TIME_IS_VALID (pts) || mux->meta_eos || mux->meta_flushing ||
+      !gst_pad_is_linked (mux->metapad)) {
+    return TRUE;
+  }
+
+  newest = g_queue_peek_tail (&mux->results);
+  return (newest != NULL) && (GST_BUFFER_PTS (newest) + mux->tolerance >= pts);
+}
+
+// Returns the pending results closest to the given timestamp that are within
+// the tolerance. Older results are dropped, the match is kept for reuse.
+static GstBuffer *
+gst_ml_meta_mux_find_results (GstMLMetaMux * mux, GstClockTime pts)
+{
+  GstBuffer *results = NULL, *match = NULL;
+  GstClockTimeDiff delta = 0, best = G_MAXINT64;
+  GList *list = NULL;
+
+  if (!GST_CLOCK_TIME_IS_VALID (pts)) {
+    return NULL;
+  }
+
+  while ((results = g_queue_peek_head (&mux->results)) &&
+      (GST_BUFFER_PTS (results) + mux->tolerance < pts)) {
+    gst_ml_meta_mux_expire_head (mux);
+  }
+
+  for (list = mux->results.head; list != NULL; list = list->next) {
+    results = GST_BUFFER (list->data);
+
+    if (GST_BUFFER_PTS (results) > pts + mux->tolerance) {
+      break;
+    }
+
+    delta = ABS (GST_CLOCK_DIFF (GST_BUFFER_PTS (results), pts));
+    if (delta < best) {
+      best = delta;
+      match = results;
+    }
+  }
+
+  if (match != NULL) {
+    gst_buffer_replace (&mux->last, match);
+    return gst_buffer_ref (match);
+  }
+
+  return NULL;
+}
+
+static void
+gst_ml_meta_mux_attach_results (GstMLMetaMux * mux, GstBuffer * buffer,
+    GstBuffer * results, GstVideoInfo * minfo)
+{
+  GstVideoMetaTransform trans = { minfo, &mux->vinfo };
+  GstMeta *meta = NULL;
+  gpointer state = NULL;
+  guint n_metas = 0;
+
+  // Without analytics video info the coordinates are used as they are.
+  if (minfo == NULL) {
+    n_metas = gst_buffer_copy_ml_meta (buffer, results);
+  } else {
+    while ((meta = gst_buffer_iterate_meta (results, &state))) {
+      if (!gst_ml_meta_is_ml (meta)) {
+        continue;
+      }
+
+      if (meta->info->transform_func (buffer, meta, results,
+              gst_video_meta_transform_scale_get_quark (), &trans)) {
+        n_metas++;
+      } else {
+        GST_WARNING_OBJECT (mux, "Failed to rescale %s",
+            g_type_name (meta->info->api));
+      }
+    }
+  }
+
+  GST_LOG_OBJECT (mux, "Attached %u metas from %" GST_TIME_FORMAT " to %"
+      GST_TIME_FORMAT, n_metas, GST_TIME_ARGS (GST_BUFFER_PTS (results)),
+      GST_TIME_ARGS (GST_BUFFER_PTS (buffer)));
+}
+
+static GstFlowReturn
+gst_ml_meta_mux_sink_chain (GstPad * pad, GstObject * parent,
+    GstBuffer * buffer)
+{
+  GstMLMetaMux *mux = GST_ML_META_MUX (parent);
+  GstBuffer *results = NULL;
+  GstVideoInfo minfo;
+  GstClockTime pts = GST_BUFFER_PTS (buffer);
+  gboolean has_minfo = FALSE;
+  gint64 deadline = 0;
+
+  g_mutex_lock (&mux->lock);
+
+  // Inference runs behind the video, give it some time to catch up.
+  deadline = g_get_monotonic_time () + GST_TIME_AS_USECONDS (mux->maxlatency);
+
+  while (!mux->flushing && !gst_ml_meta_mux_results_ready (mux, pts)) {
+    if (!g_cond_wait_until (&mux->wakeup, &mux->lock, deadline)) {
+      GST_DEBUG_OBJECT (mux, "No results for %" GST_TIME_FORMAT " within "
+          "max latency", GST_TIME_ARGS (pts));
+      break;
+    }
+  }
+
+  if (mux->flushing) {
+    g_mutex_unlock (&mux->lock);
+    gst_buffer_unref (buffer);
+    return GST_FLOW_FLUSHING;
+  }
+
+  results = gst_ml_meta_mux_find_results (mux, pts);
+
+  if ((results == NULL) && mux->reuselast && (mux->last != NULL)) {
+    GST_LOG_OBJECT (mux, "Reusing results from %" GST_TIME_FORMAT,
+        GST_TIME_ARGS (GST_BUFFER_PTS (mux->last)));
+    results = gst_buffer_ref (mux->last);
+  }
+
+  minfo = mux->minfo;
+  has_minfo = mux->has_minfo;
+
+  g_mutex_unlock (&mux->lock);
+
+  if (results != NULL) {
+    buffer = gst_buffer_make_writable (buffer);
+    gst_ml_meta_mux_attach_results (mux, buffer, results,
+        has_minfo ? &minfo : NULL);
+    gst_buffer_unref (results);
+  }
+
+  return gst_pad_push (mux->srcpad, buffer);
+}
+
+static GstFlowReturn
+gst_ml_meta_mux_meta_chain (GstPad * pad, GstObject * parent,
+    GstBuffer * buffer)
+{
+  GstMLMetaMux *mux = GST_ML_META_MUX (parent);
+  GstBuffer *results = NULL;
+
+  // Keep only the metadata, the analytics frame goes back to its pool.
+  results = gst_buffer_new ();
+  gst_buffer_copy_into (results, buffer, GST_BUFFER_COPY_TIMESTAMPS, 0, 0);
+  gst_buffer_copy_ml_meta (results, buffer);
+  gst_buffer_unref (buffer);
+
+  g_mutex_lock (&mux->lock);
+
+  if (mux->meta_flushing) {
+    g_mutex_unlock (&mux->lock);
+    gst_buffer_unref (results);
+    return GST_FLOW_FLUSHING;
+  }
+
+  // Results without timestamp cannot be matched, they are only reused.
+  if (!GST_BUFFER_PTS_IS_VALID (results)) {
+    GST_DEBUG_OBJECT (mux, "Results without timestamp");
+    gst_buffer_replace (&mux->last, results);
+    g_mutex_unlock (&mux->lock);
+    gst_buffer_unref (results);
+    return GST_FLOW_OK;
+  }
+
+  g_queue_push_tail (&mux->results, results);
+
+  if (g_queue_get_length (&mux->results) > MAX_PENDING_RESULTS) {
+    GST_DEBUG_OBJECT (mux, "Too many pending results, dropping oldest");
+    gst_ml_meta_mux_expire_head (mux);
+  }
+
+  g_cond_signal (&mux->wakeup);
+  g_mutex_unlock (&mux->lock);
+
+  return GST_FLOW_OK;
+}
+
+static gboolean
+gst_ml_meta_mux_sink_event (GstPad * pad, GstObject * parent,
+    GstEvent * event)
+{
+  GstMLMetaMux *mux = GST_ML_META_MUX (parent);
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_CAPS:
+    {
+      GstCaps *caps = NULL;
+      GstVideoInfo info;
+
+      gst_event_parse_caps (event, &caps);
+
+      if (!gst_video_info_from_caps (&info, caps)) {
+        GST_ERROR_OBJECT (mux, "Failed to parse caps %" GST_PTR_FORMAT, caps);
+        gst_event_unref (event);
+        return FALSE;
+      }
+
+      g_mutex_lock (&mux->lock);
+      mux->vinfo = info;
+      g_mutex_unlock (&mux->lock);
+      break;
+    }
+    case GST_EVENT_FLUSH_START:
+      g_mutex_lock (&mux->lock);
+      mux->flushing = TRUE;
+      g_cond_signal (&mux->wakeup);
+      g_mutex_unlock (&mux->lock);
+      break;
+    case GST_EVENT_FLUSH_STOP:
+      g_mutex_lock (&mux->lock);
+      mux->flushing = FALSE;
+      gst_buffer_replace (&mux->last, NULL);
+      g_mutex_unlock (&mux->lock);
+      break;
+    default:
+      break;
+  }
+
+  return gst_pad_event_default (pad, parent, event);
+}
+
+static gboolean
+gst_ml_meta_mux_meta_event (GstPad * pad, GstObject * parent,
+    GstEvent * event)
+{
+  GstMLMetaMux *mux = GST_ML_META_MUX (parent);
+
+  g_mutex_lock (&mux->lock);
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_CAPS:
+    {
+      GstCaps *caps = NULL;
+
+      gst_event_parse_caps (event, &caps);
+
+      // Non video analytics streams carry coordinates of the main stream.
+      mux->has_minfo = gst_video_info_from_caps (&mux->minfo, caps);
+      break;
+    }
+    case GST_EVENT_STREAM_START:
+      mux->meta_eos = FALSE;
+      break;
+    case GST_EVENT_EOS:
+      mux->meta_eos = TRUE;
+      g_cond_signal (&mux->wakeup);
+      break;
+    case GST_EVENT_FLUSH_START:
+      mux->meta_flushing = TRUE;
+      g_cond_signal (&mux->wakeup);
+      break;
+    case GST_EVENT_FLUSH_STOP:
+      mux->meta_flushing = FALSE;
+      mux->meta_eos = FALSE;
+      gst_ml_meta_mux_clear_results (mux);
+      break;
+    default:
+      break;
+  }
+
+  g_mutex_unlock (&mux->lock);
+
+  // The analytics stream ends here, only the main stream is forwarded.
+  gst_event_unref (event);
+  return TRUE;
+}
+
+static gboolean
+gst_ml_meta_mux_src_query (GstPad * pad, GstObject * parent, GstQuery * query)
+{
+  GstMLMetaMux *mux = GST_ML_META_MUX (parent);
+
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_LATENCY:
+    {
+      GstClockTime min = 0, max = 0;
+      gboolean live = FALSE;
+
+      if (!gst_pad_peer_query (mux->sinkpad, query)) {
+        return FALSE;
+      }
+
+      gst_query_parse_latency (query, &live, &min, &max);
+
+      // Buffers may be held back waiting for the analytics results.
+      min += mux->maxlatency;
+      if (GST_CLOCK_TIME_IS_VALID (max)) {
+        max += mux->maxlatency;
+      }
+
+      gst_query_set_latency (query, live, min, max);
+      return TRUE;
+    }
+    default:
+      break;
+  }
+
+  return gst_pad_query_default (pad, parent, query);
+}
+
+static GstIterator *
+gst_ml_meta_mux_iterate_internal_links (GstPad * pad, GstObject * parent)
+{
+  GstMLMetaMux *mux = GST_ML_META_MUX (parent);
+  GstIterator *it = NULL;
+  GstPad *opad = NULL;
+  GValue value = G_VALUE_INIT;
+
+  // Only the main stream is linked through, the analytics pad is a dead end.
+  if (pad == mux->srcpad) {
+    opad = mux->sinkpad;
+  } else if (pad == mux->sinkpad) {
+    opad = mux->srcpad;
+  } else {
+    return gst_iterator_new_single (GST_TYPE_PAD, NULL);
+  }
+
+  g_value_init (&value, GST_TYPE_PAD);
+  g_value_set_object (&value, opad);
+  it = gst_iterator_new_single (GST_TYPE_PAD, &value);
+  g_value_unset (&value);
+
+  return it;
+}
+
+static GstStateChangeReturn
+gst_ml_meta_mux_change_state (GstElement * element, GstStateChange transition)
+{
+  GstMLMetaMux *mux = GST_ML_META_MUX (element);
+  GstStateChangeReturn ret = GST_STATE_CHANGE_SUCCESS;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+      g_mutex_lock (&mux->lock);
+      mux->flushing = FALSE;
+      mux->meta_flushing = FALSE;
+      mux->meta_eos = FALSE;
+      mux->has_minfo = FALSE;
+      g_mutex_unlock (&mux->lock);
+      break;
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      // Release a waiting main stream before the pads are deactivated.
+      g_mutex_lock (&mux->lock);
+      mux->flushing = TRUE;
+      mux->meta_flushing = TRUE;
+      g_cond_signal (&mux->wakeup);
+      g_mutex_unlock (&mux->lock);
+      break;
+    default:
+      break;
+  }
+
+  ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+  if (ret == GST_STATE_CHANGE_FAILURE) {
+    GST_ERROR_OBJECT (mux, "Failure");
+    return ret;
+  }
+
+  switch (transition) {
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      g_mutex_lock (&mux->lock);
+      gst_ml_meta_mux_clear_results (mux);
+      g_mutex_unlock (&mux->lock);
+      break;
+    default:
+      break;
+  }
+
+  return ret;
+}
+
+static void
+gst_ml_meta_mux_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstMLMetaMux *mux = GST_ML_META_MUX (object);
+
+  g_mutex_lock (&mux->lock);
+
+  switch (prop_id) {
+    case PROP_TOLERANCE:
+      mux->tolerance = g_value_get_uint64 (value);
+      break;
+    case PROP_MAX_LATENCY:
+      mux->maxlatency = g_value_get_uint64 (value);
+      break;
+    case PROP_REUSE_LAST:
+      mux->reuselast = g_value_get_boolean (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+
+  g_mutex_unlock (&mux->lock);
+}
+
+static void
+gst_ml_meta_mux_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstMLMetaMux *mux = GST_ML_META_MUX (object);
+
+  g_mutex_lock (&mux->lock);
+
+  switch (prop_id) {
+    case PROP_TOLERANCE:
+      g_value_set_uint64 (value, mux->tolerance);
+      break;
+    case PROP_MAX_LATENCY:
+      g_value_set_uint64 (value, mux->maxlatency);
+      break;
+    case PROP_REUSE_LAST:
+      g_value_set_boolean (value, mux->reuselast);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+
+  g_mutex_unlock (&mux->lock);
+}
+
+static void
+gst_ml_meta_mux_finalize (GObject * object)
+{
+  GstMLMetaMux *mux = GST_ML_META_MUX (object);
+
+  gst_ml_meta_mux_clear_results (mux);
+
+  g_cond_clear (&mux->wakeup);
+  g_mutex_clear (&mux->lock);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gst_ml_meta_mux_class_init (GstMLMetaMuxClass * klass)
+{
+  GObjectClass *gobject            = G_OBJECT_CLASS (klass);
+  GstElementClass *element         = GST_ELEMENT_CLASS (klass);
+
+  gobject->set_property = GST_DEBUG_FUNCPTR (gst_ml_meta_mux_set_property);
+  gobject->get_property = GST_DEBUG_FUNCPTR (gst_ml_meta_mux_get_property);
+  gobject->finalize     = GST_DEBUG_FUNCPTR (gst_ml_meta_mux_finalize);
+
+  g_object_class_install_property (gobject, PROP_TOLERANCE,
+      g_param_spec_uint64 ("tolerance", "Tolerance",
+          "Max timestamp difference in nanoseconds between a video frame "
+          "and the analytics results attached to it",
+          0, GST_SECOND, DEFAULT_PROP_TOLERANCE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+  g_object_class_install_property (gobject, PROP_MAX_LATENCY,
+      g_param_spec_uint64 ("max-latency", "Max latency",
+          "Max time in nanoseconds a video frame is held back waiting for "
+          "its analytics results", 0, 10 * GST_SECOND, DEFAULT_PROP_MAX_LATENCY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+  g_object_class_install_property (gobject, PROP_REUSE_LAST,
+      g_param_spec_boolean ("reuse-last", "Reuse last",
+          "Attach the most recent results to frames without matching ones",
+          DEFAULT_PROP_REUSE_LAST,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+
+  gst_element_class_set_static_metadata (element,
+      "ML metadata muxer", "Filter/Video/Metadata",
+      "Attaches ML results from an analytics stream to the matching frames "
+      "of a main video stream, rescaling their coordinates", "QTI");
+
+  gst_element_class_add_static_pad_template (element,
+      &gst_ml_meta_mux_sink_template);
+  gst_element_class_add_static_pad_template (element,
+      &gst_ml_meta_mux_meta_template);
+  gst_element_class_add_static_pad_template (element,
+      &gst_ml_meta_mux_src_template);
+
+  element->change_state = GST_DEBUG_FUNCPTR (gst_ml_meta_mux_change_state);
+}
+
+static void
+gst_ml_meta_mux_init (GstMLMetaMux * mux)
+{
+  mux->sinkpad = gst_pad_new_from_static_template (
+      &gst_ml_meta_mux_sink_template, "sink");
+  gst_pad_set_chain_function (mux->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_ml_meta_mux_sink_chain));
+  gst_pad_set_event_function (mux->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_ml_meta_mux_sink_event));
+  gst_pad_set_iterate_internal_links_function (mux->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_ml_meta_mux_iterate_internal_links));
+  GST_PAD_SET_PROXY_CAPS (mux->sinkpad);
+  GST_PAD_SET_PROXY_ALLOCATION (mux->sinkpad);
+  gst_element_add_pad (GST_ELEMENT (mux), mux->sinkpad);
+
+  mux->metapad = gst_pad_new_from_static_template (
+      &gst_ml_meta_mux_meta_template, "analytics");
+  gst_pad_set_chain_function (mux->metapad,
+      GST_DEBUG_FUNCPTR (gst_ml_meta_mux_meta_chain));
+  gst_pad_set_event_function (mux->metapad,
+      GST_DEBUG_FUNCPTR (gst_ml_meta_mux_meta_event));
+  gst_pad_set_iterate_internal_links_function (mux->metapad,
+      GST_DEBUG_FUNCPTR (gst_ml_meta_mux_iterate_internal_links));
+  gst_element_add_pad (GST_ELEMENT (mux), mux->metapad);
+
+  mux->srcpad = gst_pad_new_from_static_template (
+      &gst_ml_meta_mux_src_template, "src");
+  gst_pad_set_query_function (mux->srcpad,
+      GST_DEBUG_FUNCPTR (gst_ml_meta_mux_src_query));
+  gst_pad_set_iterate_internal_links_function (mux->srcpad,
+      GST_DEBUG_FUNCPTR (gst_ml_meta_mux_iterate_internal_links));
+  GST_PAD_SET_PROXY_CAPS (mux->srcpad);
+  gst_element_add_pad (GST_ELEMENT (mux), mux->srcpad);
+
+  mux->tolerance = DEFAULT_PROP_TOLERANCE;
+  mux->maxlatency = DEFAULT_PROP_MAX_LATENCY;
+  mux->reuselast = DEFAULT_PROP_REUSE_LAST;
+
+  g_mutex_init (&mux->lock);
+  g_cond_init (&mux->wakeup);
+
+  gst_video_info_init (&mux->vinfo);
+  gst_video_info_init (&mux->minfo);
+  mux->has_minfo = FALSE;
+
+  g_queue_init (&mux->results);
+  mux->last = NULL;
+
+  mux->flushing = FALSE;
+  mux->meta_flushing = FALSE;
+  mux->meta_eos = FALSE;
+
+  GST_DEBUG_CATEGORY_INIT (ml_meta_mux_debug, "qtimlmetamux", 0,
+      "QTI ML metadata muxer");
+}
+
+static gboolean
+plugin_init (GstPlugin * plugin)
+{
+  return gst_element_register (plugin, "qtimlmetamux", GST_RANK_NONE,
+          GST_TYPE_ML_META_MUX);
+}
+
+GST_PLUGIN_DEFINE (
+    GST_VERSION_MAJOR,
+    GST_VERSION_MINOR,
+    qtimlmetamux,
+    "Attaches ML results from an analytics stream to a main video stream",
+    plugin_init,
+    PACKAGE_VERSION,
+    PACKAGE_LICENSE,
+    PACKAGE_SUMMARY,
+    PACKAGE_ORIGIN
+)
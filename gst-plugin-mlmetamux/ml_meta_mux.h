@@ -0,0 +1,93 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __GST_QTI_ML_META_MUX_H__
+#define __GST_QTI_ML_META_MUX_H__
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_ML_META_MUX \
+  (gst_ml_meta_mux_get_type())
+#define GST_ML_META_MUX(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_ML_META_MUX,GstMLMetaMux))
+#define GST_ML_META_MUX_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_ML_META_MUX,GstMLMetaMuxClass))
+#define GST_IS_ML_META_MUX(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_ML_META_MUX))
+#define GST_IS_ML_META_MUX_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_ML_META_MUX))
+#define GST_ML_META_MUX_CAST(obj)       ((GstMLMetaMux *)(obj))
+
+typedef struct _GstMLMetaMux GstMLMetaMux;
+typedef struct _GstMLMetaMuxClass GstMLMetaMuxClass;
+
+struct _GstMLMetaMux {
+  GstElement    parent;
+
+  /// Full resolution video, analytics results and output pads.
+  GstPad        *sinkpad;
+  GstPad        *metapad;
+  GstPad        *srcpad;
+
+  /// Properties.
+  GstClockTime  tolerance;
+  GstClockTime  maxlatency;
+  gboolean      reuselast;
+
+  /// Protects everything below, signalled when new results arrive.
+  GMutex        lock;
+  GCond         wakeup;
+
+  /// Video info of the main and the analytics streams.
+  GstVideoInfo  vinfo;
+  GstVideoInfo  minfo;
+  gboolean      has_minfo;
+
+  /// Metadata only buffers holding pending results, in ascending PTS.
+  GQueue        results;
+  /// Most recent results older than the current frame, for reuse.
+  GstBuffer     *last;
+
+  gboolean      flushing;
+  gboolean      meta_flushing;
+  gboolean      meta_eos;
+};
+
+struct _GstMLMetaMuxClass {
+  GstElementClass parent;
+};
+
+G_GNUC_INTERNAL GType gst_ml_meta_mux_get_type (void);
+
+G_END_DECLS
+
+#endif // __GST_QTI_ML_META_MUX_H__
@@ -0,0 +1,190 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "ml_meta_reader.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ml_meta_ring.h"
+
+struct _MLMetaReader {
+  MLMetaRingHeader *header;
+  uint64_t         size;
+
+  // Sequence number of the next frame to read.
+  uint64_t         next;
+  uint64_t         dropped;
+
+  // Private copy of the last frame payload.
+  uint8_t          *data;
+};
+
+MLMetaReader *
+ml_meta_reader_open (const char * name)
+{
+  MLMetaReader *reader = NULL;
+  MLMetaRingHeader *header = NULL;
+  struct stat info;
+  int fd = -1;
+
+  if (name == NULL) {
+    return NULL;
+  }
+
+  fd = shm_open (name, O_RDONLY, 0);
+  if (fd < 0) {
+    return NULL;
+  }
+
+  if (fstat (fd, &info) != 0 || (size_t) info.st_size < sizeof (*header)) {
+    close (fd);
+    return NULL;
+  }
+
+  header = (MLMetaRingHeader *) mmap (NULL, info.st_size, PROT_READ,
+      MAP_SHARED, fd, 0);
+  close (fd);
+
+  if (header == MAP_FAILED) {
+    return NULL;
+  }
+
+  // Reject segments not written by a compatible sink.
+  if (header->magic != ML_META_RING_MAGIC ||
+      header->version != ML_META_RING_VERSION || header->n_slots == 0 ||
+      ml_meta_ring_size (header->n_slots, header->slot_size) >
+          (uint64_t) info.st_size) {
+    munmap (header, info.st_size);
+    return NULL;
+  }
+
+  reader = (MLMetaReader *) calloc (1, sizeof (*reader));
+  if (reader != NULL) {
+    reader->data = (uint8_t *) malloc (header->slot_size ? header->slot_size : 1);
+  }
+
+  if (reader == NULL || reader->data == NULL) {
+    free (reader);
+    munmap (header, info.st_size);
+    return NULL;
+  }
+
+  reader->header = header;
+  reader->size = info.st_size;
+  reader->next = __atomic_load_n (&header->write_seq, __ATOMIC_ACQUIRE);
+  return reader;
+}
+
+void
+ml_meta_reader_close (MLMetaReader * reader)
+{
+  if (reader == NULL) {
+    return;
+  }
+
+  munmap (reader->header, reader->size);
+  free (reader->data);
+  free (reader);
+}
+
+int
+ml_meta_reader_read (MLMetaReader * reader, MLMetaFrame * frame)
+{
+  MLMetaRingHeader *header = NULL;
+
+  if (reader == NULL || frame == NULL) {
+    return -1;
+  }
+
+  header = reader->header;
+
+  while (1) {
+    uint64_t written = __atomic_load_n (&header->write_seq, __ATOMIC_ACQUIRE);
+    MLMetaRingSlot *slot = NULL;
+    uint64_t seq = 0, expected = 0;
+
+    if (reader->next >= written) {
+      if (!__atomic_load_n (&header->eos, __ATOMIC_ACQUIRE)) {
+        return 0;
+      }
+
+      // The writer may have published more frames since write_seq was
+      // loaded, the end is reached only once those are read as well.
+      if (reader->next >=
+          __atomic_load_n (&header->write_seq, __ATOMIC_ACQUIRE)) {
+        return -1;
+      }
+      continue;
+    }
+
+    // The writer lapped us, skip to the oldest frame still in the ring.
+    if (written - reader->next > header->n_slots) {
+      reader->dropped += written - header->n_slots - reader->next;
+      reader->next = written - header->n_slots;
+    }
+
+    slot = ml_meta_ring_get_slot (header, reader->next);
+    expected = 2 * reader->next + 2;
+
+    seq = __atomic_load_n (&slot->seq, __ATOMIC_ACQUIRE);
+    if (seq == expected) {
+      frame->seq = reader->next;
+      frame->pts = slot->pts;
+      frame->dts = slot->dts;
+      frame->duration = slot->duration;
+      frame->stream_id = slot->stream_id;
+      frame->size = slot->size < header->slot_size ?
+          slot->size : header->slot_size;
+      memcpy (reader->data, ml_meta_ring_slot_data (slot), frame->size);
+      frame->data = reader->data;
+
+      // Sequence lock check, the copy is valid only if nothing changed.
+      __atomic_thread_fence (__ATOMIC_ACQUIRE);
+      if (__atomic_load_n (&slot->seq, __ATOMIC_RELAXED) == seq) {
+        reader->next++;
+        return 1;
+      }
+    }
+
+    // Slot was overwritten by a newer frame while we were reading it.
+    reader->dropped++;
+    reader->next++;
+  }
+}
+
+uint64_t
+ml_meta_reader_get_dropped (MLMetaReader * reader)
+{
+  return (reader != NULL) ? reader->dropped : 0;
+}
@@ -0,0 +1,110 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __ML_META_READER_H__
+#define __ML_META_READER_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _MLMetaReader MLMetaReader;
+typedef struct _MLMetaFrame MLMetaFrame;
+
+/**
+ * MLMetaFrame:
+ * @seq: frame sequence number assigned by the sink
+ * @pts: presentation timestamp in nanoseconds, UINT64_MAX if unknown
+ * @dts: decoding timestamp in nanoseconds, UINT64_MAX if unknown
+ * @duration: frame duration in nanoseconds, UINT64_MAX if unknown
+ * @stream_id: stream id configured on the sink
+ * @size: size of @data in bytes
+ * @data: metadata serialized with gst_buffer_serialize_ml_meta(), owned
+ *        by the reader and valid until the next read
+ *
+ * Machine learning results of a single frame.
+ */
+struct _MLMetaFrame {
+  uint64_t      seq;
+  uint64_t      pts;
+  uint64_t      dts;
+  uint64_t      duration;
+  uint32_t      stream_id;
+  uint32_t      size;
+  const uint8_t *data;
+};
+
+/**
+ * ml_meta_reader_open:
+ * @name: shared memory name set on the qtimlmetasink shm-name property
+ *
+ * Maps the shared memory ring read only. Reading starts with the next
+ * frame published after this call. Returns NULL on failure.
+ *
+ */
+MLMetaReader * ml_meta_reader_open (const char * name);
+
+/**
+ * ml_meta_reader_close:
+ * @reader: the reader
+ *
+ * Unmaps the ring and frees the reader.
+ *
+ */
+void ml_meta_reader_close (MLMetaReader * reader);
+
+/**
+ * ml_meta_reader_read:
+ * @reader: the reader
+ * @frame: filled with the next frame
+ *
+ * Copies the next frame out of the ring without blocking. Frames which
+ * were overwritten before they could be read are counted as dropped.
+ * Returns 1 if @frame was filled, 0 if no new frame is available and -1
+ * once the sink stopped and all frames were read.
+ *
+ */
+int ml_meta_reader_read (MLMetaReader * reader, MLMetaFrame * frame);
+
+/**
+ * ml_meta_reader_get_dropped:
+ * @reader: the reader
+ *
+ * Returns the number of frames this reader missed so far.
+ *
+ */
+uint64_t ml_meta_reader_get_dropped (MLMetaReader * reader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __ML_META_READER_H__
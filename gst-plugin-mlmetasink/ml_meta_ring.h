@@ -0,0 +1,105 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __ML_META_RING_H__
+#define __ML_META_RING_H__
+
+#include <stdint.h>
+
+// Layout of the shared memory segment written by qtimlmetasink. It is
+// shared with the reader library and must not depend on GStreamer.
+//
+// The segment starts with MLMetaRingHeader followed by n_slots slots.
+// Every slot is an MLMetaRingSlot followed by slot_size payload bytes
+// holding the metadata serialized with gst_buffer_serialize_ml_meta().
+//
+// There is a single writer. Every slot is protected by a sequence lock:
+// while frame N is written the slot sequence is 2N + 1, once complete it
+// is 2N + 2. Readers copy the slot and retry if the sequence changed.
+
+#define ML_META_RING_MAGIC     0x474e5252 // "RRNG"
+#define ML_META_RING_VERSION   1
+#define ML_META_RING_ALIGNMENT 64
+
+#define ML_META_RING_ALIGN(value) \
+    (((value) + ML_META_RING_ALIGNMENT - 1) & ~((uint64_t) ML_META_RING_ALIGNMENT - 1))
+
+typedef struct _MLMetaRingHeader MLMetaRingHeader;
+typedef struct _MLMetaRingSlot MLMetaRingSlot;
+
+struct _MLMetaRingHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t n_slots;
+  uint32_t slot_size;
+  // Number of published frames, updated atomically after every frame.
+  uint64_t write_seq;
+  // Non zero once the writer has stopped.
+  uint32_t eos;
+  uint32_t reserved[9];
+};
+
+struct _MLMetaRingSlot {
+  uint64_t seq;
+  uint64_t pts;
+  uint64_t dts;
+  uint64_t duration;
+  uint32_t stream_id;
+  uint32_t size;
+  uint32_t reserved[6];
+};
+
+static inline uint64_t
+ml_meta_ring_slot_stride (uint32_t slot_size)
+{
+  return sizeof (MLMetaRingSlot) + ML_META_RING_ALIGN (slot_size);
+}
+
+static inline uint64_t
+ml_meta_ring_size (uint32_t n_slots, uint32_t slot_size)
+{
+  return sizeof (MLMetaRingHeader) +
+      (uint64_t) n_slots * ml_meta_ring_slot_stride (slot_size);
+}
+
+static inline MLMetaRingSlot *
+ml_meta_ring_get_slot (MLMetaRingHeader * header, uint64_t frame)
+{
+  uint8_t *slots = (uint8_t *) header + sizeof (MLMetaRingHeader);
+  return (MLMetaRingSlot *) (slots + (frame % header->n_slots) *
+      ml_meta_ring_slot_stride (header->slot_size));
+}
+
+static inline uint8_t *
+ml_meta_ring_slot_data (MLMetaRingSlot * slot)
+{
+  return (uint8_t *) slot + sizeof (MLMetaRingSlot);
+}
+
+#endif // __ML_META_RING_H__
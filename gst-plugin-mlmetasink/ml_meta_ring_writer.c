@@ -0,0 +1,149 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "ml_meta_ring_writer.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+int
+ml_meta_ring_writer_open (MLMetaRingWriter * writer, const char * name,
+    uint32_t n_slots, uint32_t slot_size)
+{
+  uint64_t size = ml_meta_ring_size (n_slots, slot_size);
+  void *data = NULL;
+  int fd = -1, error = 0;
+
+  if (strlen (name) >= sizeof (writer->name)) {
+    return -ENAMETOOLONG;
+  }
+
+  strcpy (writer->name, name);
+  writer->header = NULL;
+  writer->size = 0;
+
+  fd = shm_open (writer->name, O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (fd < 0) {
+    return -errno;
+  }
+
+  if (ftruncate (fd, size) != 0) {
+    error = errno;
+    close (fd);
+    shm_unlink (writer->name);
+    return -error;
+  }
+
+  data = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  error = errno;
+  close (fd);
+
+  if (data == MAP_FAILED) {
+    shm_unlink (writer->name);
+    return -error;
+  }
+
+  writer->header = (MLMetaRingHeader *) data;
+  writer->size = size;
+
+  writer->header->version = ML_META_RING_VERSION;
+  writer->header->n_slots = n_slots;
+  writer->header->slot_size = slot_size;
+  writer->header->write_seq = 0;
+  writer->header->eos = 0;
+  return 0;
+}
+
+void
+ml_meta_ring_writer_publish (MLMetaRingWriter * writer)
+{
+  // Readers validate the magic, publish it once the header is complete.
+  __atomic_store_n (&writer->header->magic, ML_META_RING_MAGIC,
+      __ATOMIC_RELEASE);
+}
+
+MLMetaRingSlot *
+ml_meta_ring_writer_begin (MLMetaRingWriter * writer)
+{
+  MLMetaRingHeader *header = writer->header;
+  // Only this thread writes the sequence number, no need for atomics.
+  uint64_t frame = header->write_seq;
+  MLMetaRingSlot *slot = ml_meta_ring_get_slot (header, frame);
+
+  __atomic_store_n (&slot->seq, 2 * frame + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence (__ATOMIC_RELEASE);
+  return slot;
+}
+
+void
+ml_meta_ring_writer_end (MLMetaRingWriter * writer, MLMetaRingSlot * slot)
+{
+  MLMetaRingHeader *header = writer->header;
+  uint64_t frame = header->write_seq;
+
+  __atomic_store_n (&slot->seq, 2 * frame + 2, __ATOMIC_RELEASE);
+  __atomic_store_n (&header->write_seq, frame + 1, __ATOMIC_RELEASE);
+}
+
+void
+ml_meta_ring_writer_write (MLMetaRingWriter * writer, const uint8_t * data,
+    uint32_t size, uint64_t pts)
+{
+  MLMetaRingSlot *slot = ml_meta_ring_writer_begin (writer);
+
+  memcpy (ml_meta_ring_slot_data (slot), data, size);
+  slot->pts = pts;
+  slot->dts = UINT64_MAX;
+  slot->duration = UINT64_MAX;
+  slot->stream_id = 0;
+  slot->size = size;
+
+  ml_meta_ring_writer_end (writer, slot);
+}
+
+void
+ml_meta_ring_writer_eos (MLMetaRingWriter * writer)
+{
+  // Readers keep their mapping, let them drain the ring before EOS.
+  __atomic_store_n (&writer->header->eos, 1, __ATOMIC_RELEASE);
+}
+
+void
+ml_meta_ring_writer_close (MLMetaRingWriter * writer)
+{
+  munmap (writer->header, writer->size);
+  shm_unlink (writer->name);
+
+  writer->header = NULL;
+  writer->size = 0;
+}
@@ -0,0 +1,137 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __ML_META_RING_WRITER_H__
+#define __ML_META_RING_WRITER_H__
+
+#include <limits.h>
+#include <stdint.h>
+
+#include "ml_meta_ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Single writer side of the shared memory ring, used by qtimlmetasink and
+// by the reader tests. It must not depend on GStreamer.
+
+typedef struct _MLMetaRingWriter MLMetaRingWriter;
+
+struct _MLMetaRingWriter {
+  char             name[NAME_MAX + 1];
+  MLMetaRingHeader *header;
+  uint64_t         size;
+};
+
+/**
+ * ml_meta_ring_writer_open:
+ * @writer: the writer
+ * @name: shared memory name, must not exist yet
+ * @n_slots: number of slots in the ring
+ * @slot_size: maximum payload size of a slot in bytes
+ *
+ * Creates and maps the shared memory ring. Readers reject it until
+ * ml_meta_ring_writer_publish() is called.
+ * Returns 0 on success or a negative errno value, -EEXIST if a segment
+ * with the same name is already present.
+ *
+ */
+int ml_meta_ring_writer_open (MLMetaRingWriter * writer, const char * name,
+    uint32_t n_slots, uint32_t slot_size);
+
+/**
+ * ml_meta_ring_writer_publish:
+ * @writer: the writer
+ *
+ * Makes the ring visible to readers. Separate from open so tests can
+ * check that unpublished segments are rejected.
+ *
+ */
+void ml_meta_ring_writer_publish (MLMetaRingWriter * writer);
+
+/**
+ * ml_meta_ring_writer_begin:
+ * @writer: the writer
+ *
+ * Marks the slot of the next frame as being written. The caller fills
+ * the payload and the slot fields and completes the frame with
+ * ml_meta_ring_writer_end().
+ * Returns the slot of the next frame.
+ *
+ */
+MLMetaRingSlot * ml_meta_ring_writer_begin (MLMetaRingWriter * writer);
+
+/**
+ * ml_meta_ring_writer_end:
+ * @writer: the writer
+ * @slot: slot returned by ml_meta_ring_writer_begin()
+ *
+ * Publishes the frame started with ml_meta_ring_writer_begin().
+ *
+ */
+void ml_meta_ring_writer_end (MLMetaRingWriter * writer,
+    MLMetaRingSlot * slot);
+
+/**
+ * ml_meta_ring_writer_write:
+ * @writer: the writer
+ * @data: payload to copy into the slot
+ * @size: size of @data in bytes, at most the slot size
+ * @pts: presentation timestamp of the frame
+ *
+ * Publishes a frame with unknown DTS and duration on stream 0.
+ *
+ */
+void ml_meta_ring_writer_write (MLMetaRingWriter * writer,
+    const uint8_t * data, uint32_t size, uint64_t pts);
+
+/**
+ * ml_meta_ring_writer_eos:
+ * @writer: the writer
+ *
+ * Tells readers that no more frames will be published.
+ *
+ */
+void ml_meta_ring_writer_eos (MLMetaRingWriter * writer);
+
+/**
+ * ml_meta_ring_writer_close:
+ * @writer: the writer
+ *
+ * Unmaps and removes the shared memory. Readers keep their mapping.
+ *
+ */
+void ml_meta_ring_writer_close (MLMetaRingWriter * writer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __ML_META_RING_WRITER_H__
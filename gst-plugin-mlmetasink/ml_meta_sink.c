@@ -0,0 +1,312 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "ml_meta_sink.h"
+
+#include <errno.h>
+#include <sys/mman.h>
+
+#include <ml-meta/ml_meta_serialize.h>
+
+#define GST_CAT_DEFAULT ml_meta_sink_debug
+GST_DEBUG_CATEGORY_STATIC (ml_meta_sink_debug);
+
+#define gst_ml_meta_sink_parent_class parent_class
+G_DEFINE_TYPE (GstMLMetaSink, gst_ml_meta_sink, GST_TYPE_BASE_SINK);
+
+#define DEFAULT_PROP_SHM_NAME   "/qtimlmeta"
+#define DEFAULT_PROP_SLOTS      64
+#define DEFAULT_PROP_SLOT_SIZE  65536
+#define DEFAULT_PROP_STREAM_ID  0
+#define DEFAULT_PROP_FORCE      FALSE
+
+#define MIN_SLOTS               2
+#define MAX_SLOTS               4096
+#define MIN_SLOT_SIZE           1024
+#define MAX_SLOT_SIZE           (16 * 1024 * 1024)
+
+enum
+{
+  PROP_0,
+  PROP_SHM_NAME,
+  PROP_SLOTS,
+  PROP_SLOT_SIZE,
+  PROP_STREAM_ID,
+  PROP_FORCE,
+};
+
+static GstStaticPadTemplate gst_ml_meta_sink_template =
+    GST_STATIC_PAD_TEMPLATE ("sink", GST_PAD_SINK, GST_PAD_ALWAYS,
+        GST_STATIC_CAPS_ANY);
+
+static gboolean
+gst_ml_meta_sink_start (GstBaseSink * bsink)
+{
+  GstMLMetaSink *sink = GST_ML_META_SINK (bsink);
+  gint ret = 0;
+
+  // A segment left behind by a crashed instance is only removed on request,
+  // it may as well belong to another sink that is still running.
+  if (sink->force && shm_unlink (sink->shmname) == 0) {
+    GST_WARNING_OBJECT (sink, "Removed existing shared memory %s",
+        sink->shmname);
+  }
+
+  ret = ml_meta_ring_writer_open (&sink->ring, sink->shmname, sink->nslots,
+      sink->slotsize);
+  if (ret == -EEXIST) {
+    GST_ELEMENT_ERROR (sink, RESOURCE, BUSY,
+        ("Shared memory %s already exists", sink->shmname),
+        ("Another sink uses the name or a previous one did not clean up, "
+         "set the force property to replace it"));
+    return FALSE;
+  } else if (ret != 0) {
+    GST_ELEMENT_ERROR (sink, RESOURCE, OPEN_WRITE,
+        ("Failed to create shared memory %s", sink->shmname),
+        ("%s", g_strerror (-ret)));
+    return FALSE;
+  }
+
+  ml_meta_ring_writer_publish (&sink->ring);
+
+  GST_INFO_OBJECT (sink, "Created ring %s with %u slots of %u bytes",
+      sink->shmname, sink->nslots, sink->slotsize);
+  return TRUE;
+}
+
+static gboolean
+gst_ml_meta_sink_stop (GstBaseSink * bsink)
+{
+  GstMLMetaSink *sink = GST_ML_META_SINK (bsink);
+
+  if (sink->ring.header == NULL) {
+    return TRUE;
+  }
+
+  ml_meta_ring_writer_eos (&sink->ring);
+  ml_meta_ring_writer_close (&sink->ring);
+
+  GST_INFO_OBJECT (sink, "Removed ring %s", sink->shmname);
+  return TRUE;
+}
+
+static GstFlowReturn
+gst_ml_meta_sink_render (GstBaseSink * bsink, GstBuffer * buffer)
+{
+  GstMLMetaSink *sink = GST_ML_META_SINK (bsink);
+  MLMetaRingHeader *header = sink->ring.header;
+  MLMetaRingSlot *slot = NULL;
+  gsize size = 0;
+
+  slot = ml_meta_ring_writer_begin (&sink->ring);
+
+  // Serialize straight into the shared memory, no intermediate copy.
+  size = gst_buffer_serialize_ml_meta (buffer,
+      ml_meta_ring_slot_data (slot), header->slot_size);
+
+  if (size > header->slot_size) {
+    GST_WARNING_OBJECT (sink, "Metadata of %" G_GSIZE_FORMAT " bytes does "
+        "not fit in slot of %u bytes, dropping it", size, header->slot_size);
+    size = 0;
+  }
+
+  slot->pts = GST_BUFFER_PTS (buffer);
+  slot->dts = GST_BUFFER_DTS (buffer);
+  slot->duration = GST_BUFFER_DURATION (buffer);
+  slot->stream_id = sink->streamid;
+  slot->size = size;
+
+  ml_meta_ring_writer_end (&sink->ring, slot);
+
+  GST_LOG_OBJECT (sink, "Published frame %" G_GUINT64_FORMAT " with %"
+      G_GSIZE_FORMAT " bytes of metadata", header->write_seq - 1, size);
+  return GST_FLOW_OK;
+}
+
+static void
+gst_ml_meta_sink_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstMLMetaSink *sink = GST_ML_META_SINK (object);
+
+  switch (prop_id) {
+    case PROP_SHM_NAME:
+      g_free (sink->shmname);
+      sink->shmname = g_value_dup_string (value);
+      break;
+    case PROP_SLOTS:
+      sink->nslots = g_value_get_uint (value);
+      break;
+    case PROP_SLOT_SIZE:
+      sink->slotsize = g_value_get_uint (value);
+      break;
+    case PROP_STREAM_ID:
+      sink->streamid = g_value_get_uint (value);
+      break;
+    case PROP_FORCE:
+      sink->force = g_value_get_boolean (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_ml_meta_sink_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstMLMetaSink *sink = GST_ML_META_SINK (object);
+
+  switch (prop_id) {
+    case PROP_SHM_NAME:
+      g_value_set_string (value, sink->shmname);
+      break;
+    case PROP_SLOTS:
+      g_value_set_uint (value, sink->nslots);
+      break;
+    case PROP_SLOT_SIZE:
+      g_value_set_uint (value, sink->slotsize);
+      break;
+    case PROP_STREAM_ID:
+      g_value_set_uint (value, sink->streamid);
+      break;
+    case PROP_FORCE:
+      g_value_set_boolean (value, sink->force);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_ml_meta_sink_finalize (GObject * object)
+{
+  GstMLMetaSink *sink = GST_ML_META_SINK (object);
+
+  g_free (sink->shmname);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gst_ml_meta_sink_class_init (GstMLMetaSinkClass * klass)
+{
+  GObjectClass *gobject            = G_OBJECT_CLASS (klass);
+  GstElementClass *element         = GST_ELEMENT_CLASS (klass);
+  GstBaseSinkClass *basesink       = GST_BASE_SINK_CLASS (klass);
+
+  gobject->set_property = GST_DEBUG_FUNCPTR (gst_ml_meta_sink_set_property);
+  gobject->get_property = GST_DEBUG_FUNCPTR (gst_ml_meta_sink_get_property);
+  gobject->finalize     = GST_DEBUG_FUNCPTR (gst_ml_meta_sink_finalize);
+
+  g_object_class_install_property (gobject, PROP_SHM_NAME,
+      g_param_spec_string ("shm-name", "Shared memory name",
+          "Name of the POSIX shared memory segment holding the ring",
+          DEFAULT_PROP_SHM_NAME,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+  g_object_class_install_property (gobject, PROP_SLOTS,
+      g_param_spec_uint ("slots", "Slots",
+          "Number of frames the ring holds", MIN_SLOTS, MAX_SLOTS,
+          DEFAULT_PROP_SLOTS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+  g_object_class_install_property (gobject, PROP_SLOT_SIZE,
+      g_param_spec_uint ("slot-size", "Slot size",
+          "Max size in bytes of the serialized metadata of a frame",
+          MIN_SLOT_SIZE, MAX_SLOT_SIZE, DEFAULT_PROP_SLOT_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+  g_object_class_install_property (gobject, PROP_STREAM_ID,
+      g_param_spec_uint ("stream-id", "Stream ID",
+          "Identifier stored with every frame to tell streams apart",
+          0, G_MAXUINT, DEFAULT_PROP_STREAM_ID,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+  g_object_class_install_property (gobject, PROP_FORCE,
+      g_param_spec_boolean ("force", "Force",
+          "Replace an existing shared memory segment with the same name",
+          DEFAULT_PROP_FORCE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  gst_element_class_set_static_metadata (element,
+      "ML metadata shared memory sink", "Sink/Metadata",
+      "Exports machine learning metadata to a shared memory ring", "QTI");
+
+  gst_element_class_add_static_pad_template (element,
+      &gst_ml_meta_sink_template);
+
+  basesink->start = GST_DEBUG_FUNCPTR (gst_ml_meta_sink_start);
+  basesink->stop = GST_DEBUG_FUNCPTR (gst_ml_meta_sink_stop);
+  basesink->render = GST_DEBUG_FUNCPTR (gst_ml_meta_sink_render);
+}
+
+static void
+gst_ml_meta_sink_init (GstMLMetaSink * sink)
+{
+  sink->shmname = g_strdup (DEFAULT_PROP_SHM_NAME);
+  sink->nslots = DEFAULT_PROP_SLOTS;
+  sink->slotsize = DEFAULT_PROP_SLOT_SIZE;
+  sink->streamid = DEFAULT_PROP_STREAM_ID;
+  sink->force = DEFAULT_PROP_FORCE;
+  sink->ring.header = NULL;
+  sink->ring.size = 0;
+
+  // Results are consumed by other processes, do not wait for the clock.
+  gst_base_sink_set_sync (GST_BASE_SINK (sink), FALSE);
+
+  GST_DEBUG_CATEGORY_INIT (ml_meta_sink_debug, "qtimlmetasink", 0,
+      "QTI ML metadata sink");
+}
+
+static gboolean
+plugin_init (GstPlugin * plugin)
+{
+  return gst_element_register (plugin, "qtimlmetasink", GST_RANK_NONE,
+          GST_TYPE_ML_META_SINK);
+}
+
+GST_PLUGIN_DEFINE (
+    GST_VERSION_MAJOR,
+    GST_VERSION_MINOR,
+    qtimlmetasink,
+    "Exports machine learning metadata to shared memory",
+    plugin_init,
+    PACKAGE_VERSION,
+    PACKAGE_LICENSE,
+    PACKAGE_SUMMARY,
+    PACKAGE_ORIGIN
+)
@@ -0,0 +1,225 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ml_meta_reader.h"
+#include "ml_meta_ring_writer.h"
+
+// Throughput of the shared memory ring.
+//
+// Usage: ml_meta_reader_bench [payload bytes] [frames] [slots]
+//
+// Measures the writer alone, a writer and reader alternating on one thread
+// and both running concurrently on their own threads.
+
+#define DEFAULT_PAYLOAD 4096
+#define DEFAULT_FRAMES  1000000
+#define DEFAULT_SLOTS   64
+
+typedef struct _BenchContext BenchContext;
+
+struct _BenchContext {
+  MLMetaRingWriter writer;
+  uint8_t          *payload;
+  uint32_t         size;
+  uint64_t         n_frames;
+};
+
+static char shmname[64];
+
+static double
+now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+report (const char * name, uint64_t n_frames, uint32_t size, double seconds)
+{
+  printf ("%-12s %10" PRIu64 " frames %8.3f s %12.0f frames/s %9.1f MB/s\n",
+      name, n_frames, seconds, n_frames / seconds,
+      n_frames * (double) size / seconds / 1e6);
+}
+
+static int
+bench_open (BenchContext * ctx, uint32_t n_slots)
+{
+  int ret = ml_meta_ring_writer_open (&ctx->writer, shmname, n_slots,
+      ctx->size);
+
+  if (ret != 0) {
+    fprintf (stderr, "Failed to create ring %s: %s\n", shmname,
+        strerror (-ret));
+    return -1;
+  }
+
+  ml_meta_ring_writer_publish (&ctx->writer);
+  return 0;
+}
+
+static void
+bench_write (BenchContext * ctx)
+{
+  double start = 0.0;
+
+  start = now ();
+  for (uint64_t i = 0; i < ctx->n_frames; i++) {
+    ml_meta_ring_writer_write (&ctx->writer, ctx->payload, ctx->size, i);
+  }
+  report ("write", ctx->n_frames, ctx->size, now () - start);
+}
+
+static void
+bench_lockstep (BenchContext * ctx)
+{
+  MLMetaReader *reader = ml_meta_reader_open (shmname);
+  MLMetaFrame frame;
+  double start = 0.0;
+
+  if (reader == NULL) {
+    fprintf (stderr, "Failed to open reader\n");
+    exit (EXIT_FAILURE);
+  }
+
+  start = now ();
+  for (uint64_t i = 0; i < ctx->n_frames; i++) {
+    ml_meta_ring_writer_write (&ctx->writer, ctx->payload, ctx->size, i);
+    if (ml_meta_reader_read (reader, &frame) != 1) {
+      fprintf (stderr, "Frame %" PRIu64 " not read\n", i);
+      exit (EXIT_FAILURE);
+    }
+  }
+  report ("lockstep", ctx->n_frames, ctx->size, now () - start);
+
+  ml_meta_reader_close (reader);
+}
+
+static void *
+bench_writer (void * data)
+{
+  BenchContext *ctx = (BenchContext *) data;
+
+  for (uint64_t i = 0; i < ctx->n_frames; i++) {
+    ml_meta_ring_writer_write (&ctx->writer, ctx->payload, ctx->size, i);
+  }
+
+  ml_meta_ring_writer_eos (&ctx->writer);
+  return NULL;
+}
+
+static void
+bench_concurrent (BenchContext * ctx)
+{
+  MLMetaReader *reader = ml_meta_reader_open (shmname);
+  MLMetaFrame frame;
+  pthread_t thread;
+  uint64_t n_read = 0;
+  double start = 0.0;
+  int res = 0;
+
+  if (reader == NULL) {
+    fprintf (stderr, "Failed to open reader\n");
+    exit (EXIT_FAILURE);
+  }
+
+  start = now ();
+  if (pthread_create (&thread, NULL, bench_writer, ctx) != 0) {
+    fprintf (stderr, "Failed to start writer\n");
+    exit (EXIT_FAILURE);
+  }
+
+  while ((res = ml_meta_reader_read (reader, &frame)) >= 0) {
+    if (res == 0) {
+      sched_yield ();
+    }
+    n_read += res;
+  }
+
+  pthread_join (thread, NULL);
+  report ("concurrent", n_read, ctx->size, now () - start);
+
+  printf ("%-12s %10" PRIu64 " frames dropped (%.2f%%)\n", "",
+      ml_meta_reader_get_dropped (reader),
+      100.0 * ml_meta_reader_get_dropped (reader) / ctx->n_frames);
+
+  ml_meta_reader_close (reader);
+}
+
+int
+main (int argc, char ** argv)
+{
+  BenchContext ctx;
+  uint32_t n_slots = DEFAULT_SLOTS;
+
+  memset (&ctx, 0, sizeof (ctx));
+  ctx.size = (argc > 1) ? strtoul (argv[1], NULL, 0) : DEFAULT_PAYLOAD;
+  ctx.n_frames = (argc > 2) ? strtoull (argv[2], NULL, 0) : DEFAULT_FRAMES;
+  n_slots = (argc > 3) ? strtoul (argv[3], NULL, 0) : DEFAULT_SLOTS;
+
+  if (ctx.size == 0 || ctx.n_frames == 0 || n_slots == 0) {
+    fprintf (stderr, "Usage: %s [payload bytes] [frames] [slots]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  snprintf (shmname, sizeof (shmname), "/mlmetareader-bench-%d",
+      (int) getpid ());
+
+  ctx.payload = (uint8_t *) malloc (ctx.size);
+  memset (ctx.payload, 0x5a, ctx.size);
+
+  printf ("%u byte payload, %u slots\n", ctx.size, n_slots);
+
+  if (bench_open (&ctx, n_slots) != 0) {
+    return EXIT_FAILURE;
+  }
+  bench_write (&ctx);
+  bench_lockstep (&ctx);
+  ml_meta_ring_writer_close (&ctx.writer);
+
+  // Fresh ring, the reader starts at the next published frame.
+  if (bench_open (&ctx, n_slots) != 0) {
+    return EXIT_FAILURE;
+  }
+  bench_concurrent (&ctx);
+  ml_meta_ring_writer_close (&ctx.writer);
+
+  free (ctx.payload);
+  return EXIT_SUCCESS;
+}
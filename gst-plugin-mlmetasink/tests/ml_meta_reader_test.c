@@ -0,0 +1,325 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ml_meta_reader.h"
+#include "ml_meta_ring_writer.h"
+
+#define CHECK(expr) \
+  do { \
+    if (!(expr)) { \
+      fprintf (stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+          #expr); \
+      exit (EXIT_FAILURE); \
+    } \
+  } while (0)
+
+#define N_SLOTS   4
+#define SLOT_SIZE 1024
+
+// Frames of the concurrent test, enough for many laps of a small ring.
+#define N_STRESS_FRAMES 200000
+#define N_STRESS_SLOTS  8
+
+static char shmname[64];
+
+// Payload of a frame is derived from its sequence number, so any mix of
+// two frames in a torn copy is detected.
+static uint32_t
+payload_size (uint64_t seq)
+{
+  return 16 + (seq * 7) % 240;
+}
+
+static void
+payload_fill (uint8_t * data, uint64_t seq)
+{
+  memset (data, (int) ((seq * 31) & 0xff), payload_size (seq));
+}
+
+static int
+payload_check (const MLMetaFrame * frame)
+{
+  uint8_t value = (uint8_t) ((frame->seq * 31) & 0xff);
+
+  if (frame->size != payload_size (frame->seq) || frame->pts != frame->seq) {
+    return 0;
+  }
+
+  for (uint32_t i = 0; i < frame->size; i++) {
+    if (frame->data[i] != value) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static void
+write_frames (MLMetaRingWriter * writer, uint64_t n_frames)
+{
+  uint8_t data[SLOT_SIZE];
+
+  for (uint64_t i = 0; i < n_frames; i++) {
+    uint64_t seq = writer->header->write_seq;
+
+    payload_fill (data, seq);
+    ml_meta_ring_writer_write (writer, data, payload_size (seq), seq);
+  }
+}
+
+static void
+test_open (void)
+{
+  MLMetaRingWriter writer;
+  MLMetaReader *reader = NULL;
+
+  CHECK (ml_meta_reader_open (NULL) == NULL);
+  CHECK (ml_meta_reader_open (shmname) == NULL);
+
+  CHECK (ml_meta_ring_writer_open (&writer, shmname, N_SLOTS,
+      SLOT_SIZE) == 0);
+
+  // The header is not complete until the magic is published.
+  CHECK (ml_meta_reader_open (shmname) == NULL);
+
+  ml_meta_ring_writer_publish (&writer);
+  reader = ml_meta_reader_open (shmname);
+  CHECK (reader != NULL);
+
+  ml_meta_reader_close (reader);
+  ml_meta_ring_writer_close (&writer);
+}
+
+static void
+test_read (void)
+{
+  MLMetaRingWriter writer;
+  MLMetaReader *reader = NULL;
+  MLMetaFrame frame;
+
+  CHECK (ml_meta_ring_writer_open (&writer, shmname, N_SLOTS,
+      SLOT_SIZE) == 0);
+  ml_meta_ring_writer_publish (&writer);
+
+  // Frames published before the reader opened are not returned.
+  write_frames (&writer, 2);
+  reader = ml_meta_reader_open (shmname);
+  CHECK (reader != NULL);
+  CHECK (ml_meta_reader_read (reader, &frame) == 0);
+
+  write_frames (&writer, 3);
+  for (uint64_t seq = 2; seq < 5; seq++) {
+    CHECK (ml_meta_reader_read (reader, &frame) == 1);
+    CHECK (frame.seq == seq);
+    CHECK (payload_check (&frame));
+  }
+
+  CHECK (ml_meta_reader_read (reader, &frame) == 0);
+  CHECK (ml_meta_reader_get_dropped (reader) == 0);
+
+  // Remaining frames are still returned once the writer stopped.
+  write_frames (&writer, 2);
+  ml_meta_ring_writer_eos (&writer);
+
+  CHECK (ml_meta_reader_read (reader, &frame) == 1);
+  CHECK (frame.seq == 5);
+  CHECK (ml_meta_reader_read (reader, &frame) == 1);
+  CHECK (frame.seq == 6);
+  CHECK (ml_meta_reader_read (reader, &frame) == -1);
+  CHECK (ml_meta_reader_get_dropped (reader) == 0);
+
+  ml_meta_reader_close (reader);
+  ml_meta_ring_writer_close (&writer);
+}
+
+static void
+test_lap (void)
+{
+  MLMetaRingWriter writer;
+  MLMetaReader *reader = NULL;
+  MLMetaFrame frame;
+
+  CHECK (ml_meta_ring_writer_open (&writer, shmname, N_SLOTS,
+      SLOT_SIZE) == 0);
+  ml_meta_ring_writer_publish (&writer);
+
+  reader = ml_meta_reader_open (shmname);
+  CHECK (reader != NULL);
+
+  // The writer laps the reader by 3 frames, reading resumes with the
+  // oldest frame still in the ring.
+  write_frames (&writer, N_SLOTS + 3);
+
+  for (uint64_t seq = 3; seq < N_SLOTS + 3; seq++) {
+    CHECK (ml_meta_reader_read (reader, &frame) == 1);
+    CHECK (frame.seq == seq);
+    CHECK (payload_check (&frame));
+  }
+
+  CHECK (ml_meta_reader_read (reader, &frame) == 0);
+  CHECK (ml_meta_reader_get_dropped (reader) == 3);
+
+  ml_meta_reader_close (reader);
+  ml_meta_ring_writer_close (&writer);
+}
+
+static void
+test_overwritten (void)
+{
+  MLMetaRingWriter writer;
+  MLMetaReader *reader = NULL;
+  MLMetaRingSlot *slot = NULL;
+  MLMetaFrame frame;
+
+  CHECK (ml_meta_ring_writer_open (&writer, shmname, N_SLOTS,
+      SLOT_SIZE) == 0);
+  ml_meta_ring_writer_publish (&writer);
+
+  reader = ml_meta_reader_open (shmname);
+  CHECK (reader != NULL);
+
+  write_frames (&writer, 2);
+
+  // Frame 0 was read from the write sequence but its slot is rewritten
+  // for frame N_SLOTS before the reader gets to it.
+  slot = ml_meta_ring_get_slot (writer.header, 0);
+  __atomic_store_n (&slot->seq, 2 * N_SLOTS + 1, __ATOMIC_RELEASE);
+
+  CHECK (ml_meta_reader_read (reader, &frame) == 1);
+  CHECK (frame.seq == 1);
+  CHECK (payload_check (&frame));
+  CHECK (ml_meta_reader_get_dropped (reader) == 1);
+
+  // A completed newer frame in the slot is not mistaken for frame 0 either.
+  write_frames (&writer, 2);
+  slot = ml_meta_ring_get_slot (writer.header, 2);
+  __atomic_store_n (&slot->seq, 2 * (N_SLOTS + 2) + 2, __ATOMIC_RELEASE);
+
+  CHECK (ml_meta_reader_read (reader, &frame) == 1);
+  CHECK (frame.seq == 3);
+  CHECK (ml_meta_reader_get_dropped (reader) == 2);
+
+  ml_meta_reader_close (reader);
+  ml_meta_ring_writer_close (&writer);
+}
+
+static void *
+stress_writer (void * data)
+{
+  MLMetaRingWriter *writer = (MLMetaRingWriter *) data;
+
+  uint64_t n_written = 0, burst = 0;
+
+  // Publish in bursts of varying length, some of them lap the reader, so
+  // completed, torn and skipped reads are all exercised.
+  while (n_written < N_STRESS_FRAMES) {
+    uint64_t n_frames = 1 + (burst++ % (2 * N_STRESS_SLOTS));
+
+    if (n_frames > N_STRESS_FRAMES - n_written) {
+      n_frames = N_STRESS_FRAMES - n_written;
+    }
+
+    write_frames (writer, n_frames);
+    n_written += n_frames;
+    sched_yield ();
+  }
+
+  ml_meta_ring_writer_eos (writer);
+  return NULL;
+}
+
+static void
+test_concurrent (void)
+{
+  MLMetaRingWriter writer;
+  MLMetaReader *reader = NULL;
+  MLMetaFrame frame;
+  pthread_t thread;
+  uint64_t n_read = 0, last = 0;
+  int res = 0;
+
+  CHECK (ml_meta_ring_writer_open (&writer, shmname, N_STRESS_SLOTS,
+      SLOT_SIZE) == 0);
+  ml_meta_ring_writer_publish (&writer);
+
+  reader = ml_meta_reader_open (shmname);
+  CHECK (reader != NULL);
+
+  CHECK (pthread_create (&thread, NULL, stress_writer, &writer) == 0);
+
+  // Every frame returned must be a consistent copy, torn reads have to be
+  // retried or dropped by the sequence lock.
+  while ((res = ml_meta_reader_read (reader, &frame)) >= 0) {
+    if (res == 0) {
+      sched_yield ();
+      continue;
+    }
+
+    CHECK (payload_check (&frame));
+    CHECK (n_read == 0 || frame.seq > last);
+
+    last = frame.seq;
+    n_read++;
+  }
+
+  CHECK (pthread_join (thread, NULL) == 0);
+
+  // No frame is lost without being accounted for.
+  CHECK (n_read + ml_meta_reader_get_dropped (reader) == N_STRESS_FRAMES);
+  CHECK (n_read > 0);
+
+  printf ("concurrent: read %" PRIu64 " frames, dropped %" PRIu64 "\n",
+      n_read, ml_meta_reader_get_dropped (reader));
+
+  ml_meta_reader_close (reader);
+  ml_meta_ring_writer_close (&writer);
+}
+
+int
+main (void)
+{
+  snprintf (shmname, sizeof (shmname), "/mlmetareader-test-%d",
+      (int) getpid ());
+
+  test_open ();
+  test_read ();
+  test_lap ();
+  test_overwritten ();
+  test_concurrent ();
+
+  printf ("All ml_meta_reader tests passed\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,936 @@
+/*
+* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "cpu_overlay_renderer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// CPU_OVERLAY_NO_SIMD leaves only the portable paths, used by the tests.
+#if defined(CPU_OVERLAY_NO_SIMD)
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define CPU_OVERLAY_USE_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define CPU_OVERLAY_USE_SSE2
+#endif
+
+#define CPU_OVERLAY_MIN(a, b)  (((a) < (b)) ? (a) : (b))
+#define CPU_OVERLAY_MAX(a, b)  (((a) > (b)) ? (a) : (b))
+#define CPU_OVERLAY_ABS(a)     (((a) < 0) ? -(a) : (a))
+
+/* Even bytes of a 64 bit word, each in its own 16 bit lane */
+#define CPU_OVERLAY_LANE_MASK  0x00FF00FF00FF00FFULL
+#define CPU_OVERLAY_LANE_ROUND 0x0080008000800080ULL
+
+#define CPU_OVERLAY_FIRST_GLYPH ' '
+#define CPU_OVERLAY_LAST_GLYPH  '~'
+
+/* Glyph atlas for printable ASCII, one byte per row, MSB is the leftmost
+ * of the CPU_OVERLAY_GLYPH_WIDTH columns. */
+static const uint8_t glyphs[][CPU_OVERLAY_GLYPH_HEIGHT] = {
+  { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, /* space */
+  { 0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x04 }, /* ! */
+  { 0x0a, 0x0a, 0x0a, 0x00, 0x00, 0x00, 0x00 }, /* " */
+  { 0x0a, 0x0a, 0x1f, 0x0a, 0x1f, 0x0a, 0x0a }, /* # */
+  { 0x04, 0x0f, 0x14, 0x0e, 0x05, 0x1e, 0x04 }, /* $ */
+  { 0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03 }, /* % */
+  { 0x0c, 0x12, 0x14, 0x08, 0x15, 0x12, 0x0d }, /* & */
+  { 0x04, 0x04, 0x08, 0x00, 0x00, 0x00, 0x00 }, /* ' */
+  { 0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02 }, /* ( */
+  { 0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08 }, /* ) */
+  { 0x00, 0x04, 0x15, 0x0e, 0x15, 0x04, 0x00 }, /* asterisk */
+  { 0x00, 0x04, 0x04, 0x1f, 0x04, 0x04, 0x00 }, /* + */
+  { 0x00, 0x00, 0x00, 0x00, 0x0c, 0x04, 0x08 }, /* , */
+  { 0x00, 0x00, 0x00, 0x1f, 0x00, 0x00, 0x00 }, /* - */
+  { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x0c }, /* . */
+  { 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00 }, /* slash */
+  { 0x0e, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0e }, /* 0 */
+  { 0x04, 0x0c, 0x04, 0x04, 0x04, 0x04, 0x0e }, /* 1 */
+  { 0x0e, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1f }, /* 2 */
+  { 0x1f, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0e }, /* 3 */
+  { 0x02, 0x06, 0x0a, 0x12, 0x1f, 0x02, 0x02 }, /* 4 */
+  { 0x1f, 0x10, 0x1e, 0x01, 0x01, 0x11, 0x0e }, /* 5 */
+  { 0x06, 0x08, 0x10, 0x1e, 0x11, 0x11, 0x0e }, /* 6 */
+  { 0x1f, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 }, /* 7 */
+  { 0x0e, 0x11, 0x11, 0x0e, 0x11, 0x11, 0x0e }, /* 8 */
+  { 0x0e, 0x11, 0x11, 0x0f, 0x01, 0x02, 0x0c }, /* 9 */
+  { 0x00, 0x0c, 0x0c, 0x00, 0x0c, 0x0c, 0x00 }, /* : */
+  { 0x00, 0x0c, 0x0c, 0x00, 0x0c, 0x04, 0x08 }, /* ; */
+  { 0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02 }, /* < */
+  { 0x00, 0x00, 0x1f, 0x00, 0x1f, 0x00, 0x00 }, /* = */
+  { 0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08 }, /* > */
+  { 0x0e, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 }, /* ? */
+  { 0x0e, 0x11, 0x01, 0x0d, 0x15, 0x15, 0x0e }, /* @ */
+  { 0x0e, 0x11, 0x11, 0x1f, 0x11, 0x11, 0x11 }, /* A */
+  { 0x1e, 0x11, 0x11, 0x1e, 0x11, 0x11, 0x1e }, /* B */
+  { 0x0e, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0e }, /* C */
+  { 0x1c, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1c }, /* D */
+  { 0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x1f }, /* E */
+  { 0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x10 }, /* F */
+  { 0x0e, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0f }, /* G */
+  { 0x11, 0x11, 0x11, 0x1f, 0x11, 0x11, 0x11 }, /* H */
+  { 0x0e, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0e }, /* I */
+  { 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0c }, /* J */
+  { 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 }, /* K */
+  { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1f }, /* L */
+  { 0x11, 0x1b, 0x15, 0x15, 0x11, 0x11, 0x11 }, /* M */
+  { 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 }, /* N */
+  { 0x0e, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e }, /* O */
+  { 0x1e, 0x11, 0x11, 0x1e, 0x10, 0x10, 0x10 }, /* P */
+  { 0x0e, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0d }, /* Q */
+  { 0x1e, 0x11, 0x11, 0x1e, 0x14, 0x12, 0x11 }, /* R */
+  { 0x0f, 0x10, 0x10, 0x0e, 0x01, 0x01, 0x1e }, /* S */
+  { 0x1f, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 }, /* T */
+  { 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e }, /* U */
+  { 0x11, 0x11, 0x11, 0x11, 0x11, 0x0a, 0x04 }, /* V */
+  { 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0a }, /* W */
+  { 0x11, 0x11, 0x0a, 0x04, 0x0a, 0x11, 0x11 }, /* X */
+  { 0x11, 0x11, 0x11, 0x0a, 0x04, 0x04, 0x04 }, /* Y */
+  { 0x1f, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1f }, /* Z */
+  { 0x0e, 0x08, 0x08, 0x08, 0x08, 0x08, 0x0e }, /* [ */
+  { 0x00, 0x10, 0x08, 0x04, 0x02, 0x01, 0x00 }, /* \\ */
+  { 0x0e, 0x02, 0x02, 0x02, 0x02, 0x02, 0x0e }, /* ] */
+  { 0x04, 0x0a, 0x11, 0x00, 0x00, 0x00, 0x00 }, /* ^ */
+  { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1f }, /* _ */
+  { 0x08, 0x04, 0x02, 0x00, 0x00, 0x00, 0x00 }, /* ` */
+  { 0x00, 0x00, 0x0e, 0x01, 0x0f, 0x11, 0x0f }, /* a */
+  { 0x10, 0x10, 0x16, 0x19, 0x11, 0x11, 0x1e }, /* b */
+  { 0x00, 0x00, 0x0e, 0x10, 0x10, 0x11, 0x0e }, /* c */
+  { 0x01, 0x01, 0x0d, 0x13, 0x11, 0x11, 0x0f }, /* d */
+  { 0x00, 0x00, 0x0e, 0x11, 0x1f, 0x10, 0x0e }, /* e */
+  { 0x06, 0x09, 0x08, 0x1c, 0x08, 0x08, 0x08 }, /* f */
+  { 0x00, 0x0f, 0x11, 0x11, 0x0f, 0x01, 0x0e }, /* g */
+  { 0x10, 0x10, 0x16, 0x19, 0x11, 0x11, 0x11 }, /* h */
+  { 0x04, 0x00, 0x0c, 0x04, 0x04, 0x04, 0x0e }, /* i */
+  { 0x02, 0x00, 0x06, 0x02, 0x02, 0x12, 0x0c }, /* j */
+  { 0x10, 0x10, 0x12, 0x14, 0x18, 0x14, 0x12 }, /* k */
+  { 0x0c, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0e }, /* l */
+  { 0x00, 0x00, 0x1a, 0x15, 0x15, 0x11, 0x11 }, /* m */
+  { 0x00, 0x00, 0x16, 0x19, 0x11, 0x11, 0x11 }, /* n */
+  { 0x00, 0x00, 0x0e, 0x11, 0x11, 0x11, 0x0e }, /* o */
+  { 0x00, 0x00, 0x1e, 0x11, 0x1e, 0x10, 0x10 }, /* p */
+  { 0x00, 0x00, 0x0d, 0x13, 0x0f, 0x01, 0x01 }, /* q */
+  { 0x00, 0x00, 0x16, 0x19, 0x10, 0x10, 0x10 }, /* r */
+  { 0x00, 0x00, 0x0e, 0x10, 0x0e, 0x01, 0x1e }, /* s */
+  { 0x08, 0x08, 0x1c, 0x08, 0x08, 0x09, 0x06 }, /* t */
+  { 0x00, 0x00, 0x11, 0x11, 0x11, 0x13, 0x0d }, /* u */
+  { 0x00, 0x00, 0x11, 0x11, 0x11, 0x0a, 0x04 }, /* v */
+  { 0x00, 0x00, 0x11, 0x11, 0x15, 0x15, 0x0a }, /* w */
+  { 0x00, 0x00, 0x11, 0x0a, 0x04, 0x0a, 0x11 }, /* x */
+  { 0x00, 0x00, 0x11, 0x11, 0x0f, 0x01, 0x0e }, /* y */
+  { 0x00, 0x00, 0x1f, 0x02, 0x04, 0x08, 0x1f }, /* z */
+  { 0x02, 0x04, 0x04, 0x08, 0x04, 0x04, 0x02 }, /* { */
+  { 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 }, /* | */
+  { 0x08, 0x04, 0x04, 0x02, 0x04, 0x04, 0x08 }, /* } */
+  { 0x00, 0x00, 0x08, 0x15, 0x02, 0x00, 0x00 }, /* ~ */
+};
+
+typedef struct _CpuOverlayColor CpuOverlayColor;
+typedef struct _CpuOverlayRect CpuOverlayRect;
+
+/* Color in the frame color space. Alpha is scaled to 0..256 so that blending
+ * is a shift instead of a division and opaque colors replace the pixels. */
+struct _CpuOverlayColor {
+  uint8_t  y;
+  uint8_t  uv[2];
+  uint32_t alpha;
+};
+
+struct _CpuOverlayRect {
+  int32_t x;
+  int32_t y;
+  int32_t width;
+  int32_t height;
+};
+
+struct _CpuOverlayText {
+  uint32_t        color;
+  int32_t         width;
+  int32_t         height;
+  uint32_t        n_rects;
+  CpuOverlayRect  *rects;
+};
+
+struct _CpuOverlayLayer {
+  uint32_t        n_rects;
+  uint32_t        n_allocated;
+  CpuOverlayRect  *rects;
+  /* RGBA color of each rectangle, converted when drawn as the chroma order
+   * depends on the frame */
+  uint32_t        *colors;
+};
+
+static inline uint8_t
+cpu_overlay_clamp (int32_t value)
+{
+  return (uint8_t) CPU_OVERLAY_MIN (CPU_OVERLAY_MAX (value, 0), 255);
+}
+
+// BT.601 limited range conversion.
+static inline void
+cpu_overlay_convert_color (const CpuOverlayFrame * frame, uint8_t r,
+    uint8_t g, uint8_t b, uint8_t a, CpuOverlayColor * color)
+{
+  uint8_t u =
+      cpu_overlay_clamp (((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+  uint8_t v =
+      cpu_overlay_clamp (((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+
+  color->y = cpu_overlay_clamp (((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+  color->uv[0] = frame->swap_uv ? v : u;
+  color->uv[1] = frame->swap_uv ? u : v;
+  color->alpha = a + (a >> 7);
+}
+
+static inline void
+cpu_overlay_unpack_color (const CpuOverlayFrame * frame, uint32_t rgba,
+    CpuOverlayColor * color)
+{
+  cpu_overlay_convert_color (frame, (rgba >> 24) & 0xFF, (rgba >> 16) & 0xFF,
+      (rgba >> 8) & 0xFF, rgba & 0xFF, color);
+}
+
+static inline uint8_t
+cpu_overlay_blend (uint8_t dst, uint8_t src, uint32_t alpha)
+{
+  return (uint8_t) ((dst * (256 - alpha) + src * alpha + 128) >> 8);
+}
+
+/* Blends @pattern, repeated every two bytes, into @n_bytes of @row. With
+ * NEON or SSE2 sixteen bytes are blended at once in 16 bit lanes, otherwise
+ * eight bytes are split into even and odd bytes that each sit in a 16 bit
+ * lane of a 64 bit word. The lanes cannot overflow as the weights add up to
+ * 256. Results are identical to cpu_overlay_blend(). */
+static void
+cpu_overlay_blend_row (uint8_t * row, int32_t n_bytes,
+    const uint8_t pattern[2], uint32_t alpha)
+{
+  uint8_t bytes[8] = { pattern[0], pattern[1], pattern[0], pattern[1],
+      pattern[0], pattern[1], pattern[0], pattern[1] };
+  uint64_t src = 0, even = 0, odd = 0, word = 0;
+  uint32_t inverse = 256 - alpha;
+  int32_t i = 0;
+
+#if defined(CPU_OVERLAY_USE_NEON) || defined(CPU_OVERLAY_USE_SSE2)
+  uint16_t lanes[8];
+
+  for (i = 0; i < 8; i++) {
+    lanes[i] = (uint16_t) (pattern[i & 1] * alpha + 128);
+  }
+#endif
+
+#if defined(CPU_OVERLAY_USE_NEON)
+  {
+    uint16x8_t vsrc = vld1q_u16 (lanes);
+    uint16x8_t vinverse = vdupq_n_u16 ((uint16_t) inverse);
+
+    for (i = 0; i + 16 <= n_bytes; i += 16) {
+      uint8x16_t pixels = vld1q_u8 (row + i);
+      uint16x8_t low = vmlaq_u16 (vsrc, vmovl_u8 (vget_low_u8 (pixels)),
+          vinverse);
+      uint16x8_t high = vmlaq_u16 (vsrc, vmovl_u8 (vget_high_u8 (pixels)),
+          vinverse);
+
+      vst1q_u8 (row + i, vcombine_u8 (vshrn_n_u16 (low, 8),
+          vshrn_n_u16 (high, 8)));
+    }
+  }
+#elif defined(CPU_OVERLAY_USE_SSE2)
+  {
+    __m128i vsrc = _mm_loadu_si128 ((const __m128i *) lanes);
+    __m128i vinverse = _mm_set1_epi16 ((short) inverse);
+    __m128i zero = _mm_setzero_si128 ();
+
+    for (i = 0; i + 16 <= n_bytes; i += 16) {
+      __m128i pixels = _mm_loadu_si128 ((const __m128i *) (row + i));
+      __m128i low = _mm_add_epi16 (vsrc,
+          _mm_mullo_epi16 (_mm_unpacklo_epi8 (pixels, zero), vinverse));
+      __m128i high = _mm_add_epi16 (vsrc,
+          _mm_mullo_epi16 (_mm_unpackhi_epi8 (pixels, zero), vinverse));
+
+      _mm_storeu_si128 ((__m128i *) (row + i), _mm_packus_epi16 (
+          _mm_srli_epi16 (low, 8), _mm_srli_epi16 (high, 8)));
+    }
+  }
+#endif
+
+  memcpy (&src, bytes, sizeof (src));
+  even = (src & CPU_OVERLAY_LANE_MASK) * alpha + CPU_OVERLAY_LANE_ROUND;
+  odd = ((src >> 8) & CPU_OVERLAY_LANE_MASK) * alpha + CPU_OVERLAY_LANE_ROUND;
+
+  for (; i + 8 <= n_bytes; i += 8) {
+    memcpy (&word, row + i, sizeof (word));
+    word = ((((word & CPU_OVERLAY_LANE_MASK) * inverse + even) >> 8) &
+        CPU_OVERLAY_LANE_MASK) |
+        ((((word >> 8) & CPU_OVERLAY_LANE_MASK) * inverse + odd) &
+        ~CPU_OVERLAY_LANE_MASK);
+    memcpy (row + i, &word, sizeof (word));
+  }
+
+  for (; i < n_bytes; i++) {
+    row[i] = cpu_overlay_blend (row[i], pattern[i & 1], alpha);
+  }
+}
+
+static void
+cpu_overlay_fill_row (uint8_t * row, int32_t n_bytes, const uint8_t pattern[2])
+{
+  int32_t i = 0;
+
+  if (pattern[0] == pattern[1]) {
+    memset (row, pattern[0], n_bytes);
+    return;
+  }
+
+  for (; i + 1 < n_bytes; i += 2) {
+    row[i] = pattern[0];
+    row[i + 1] = pattern[1];
+  }
+}
+
+static void
+cpu_overlay_paint_rect (const CpuOverlayFrame * frame, int32_t x, int32_t y,
+    int32_t width, int32_t height, const CpuOverlayColor * color)
+{
+  const uint8_t luma[2] = { color->y, color->y };
+  int32_t x0, y0, x1, y1, row;
+
+  if (color->alpha == 0) {
+    return;
+  }
+
+  x0 = CPU_OVERLAY_MAX (x, 0);
+  y0 = CPU_OVERLAY_MAX (y, 0);
+  x1 = CPU_OVERLAY_MIN (x + width, frame->width);
+  y1 = CPU_OVERLAY_MIN (y + height, frame->height);
+
+  if (x0 >= x1 || y0 >= y1) {
+    return;
+  }
+
+  for (row = y0; row < y1; row++) {
+    uint8_t *line = frame->luma + row * frame->luma_stride + x0;
+
+    if (color->alpha == 256) {
+      cpu_overlay_fill_row (line, x1 - x0, luma);
+    } else {
+      cpu_overlay_blend_row (line, x1 - x0, luma, color->alpha);
+    }
+  }
+
+  // Chroma blocks touched by the rectangle, two bytes per block.
+  x0 = x0 / 2;
+  y0 = y0 / 2;
+  x1 = (x1 + 1) / 2;
+  y1 = (y1 + 1) / 2;
+
+  for (row = y0; row < y1; row++) {
+    uint8_t *line = frame->chroma + row * frame->chroma_stride + x0 * 2;
+
+    if (color->alpha == 256) {
+      cpu_overlay_fill_row (line, (x1 - x0) * 2, color->uv);
+    } else {
+      cpu_overlay_blend_row (line, (x1 - x0) * 2, color->uv, color->alpha);
+    }
+  }
+}
+
+void
+cpu_overlay_fill_rect (CpuOverlayFrame * frame, int32_t x, int32_t y,
+    int32_t width, int32_t height, uint32_t color)
+{
+  CpuOverlayColor yuv;
+
+  cpu_overlay_unpack_color (frame, color, &yuv);
+  cpu_overlay_paint_rect (frame, x, y, width, height, &yuv);
+}
+
+void
+cpu_overlay_draw_rect (CpuOverlayFrame * frame, int32_t x, int32_t y,
+    int32_t width, int32_t height, int32_t thickness, uint32_t color)
+{
+  CpuOverlayColor yuv;
+
+  if (width <= 0 || height <= 0 || thickness <= 0) {
+    return;
+  }
+
+  thickness = CPU_OVERLAY_MIN (thickness, CPU_OVERLAY_MIN (width, height) / 2);
+  thickness = CPU_OVERLAY_MAX (thickness, 1);
+
+  cpu_overlay_unpack_color (frame, color, &yuv);
+
+  // Sides do not overlap so translucent borders blend evenly.
+  cpu_overlay_paint_rect (frame, x, y, width, thickness, &yuv);
+  cpu_overlay_paint_rect (frame, x, y + height - thickness, width, thickness,
+      &yuv);
+  cpu_overlay_paint_rect (frame, x, y + thickness, thickness,
+      height - 2 * thickness, &yuv);
+  cpu_overlay_paint_rect (frame, x + width - thickness, y + thickness,
+      thickness, height - 2 * thickness, &yuv);
+}
+
+void
+cpu_overlay_draw_line (CpuOverlayFrame * frame, int32_t x0, int32_t y0,
+    int32_t x1, int32_t y1, int32_t thickness, uint32_t color)
+{
+  CpuOverlayColor yuv;
+  int32_t dx = CPU_OVERLAY_ABS (x1 - x0), dy = -CPU_OVERLAY_ABS (y1 - y0);
+  int32_t sx = (x0 < x1) ? 1 : -1, sy = (y0 < y1) ? 1 : -1;
+  int32_t error = dx + dy, step = 0, offset = 0;
+
+  if (thickness <= 0) {
+    return;
+  }
+
+  cpu_overlay_unpack_color (frame, color, &yuv);
+  offset = thickness / 2;
+
+  // Bresenham, the pen is a square of thickness pixels. Opaque colors are
+  // expected, overlapping pen positions blend twice otherwise.
+  while (1) {
+    cpu_overlay_paint_rect (frame, x0 - offset, y0 - offset, thickness,
+        thickness, &yuv);
+
+    if (x0 == x1 && y0 == y1) {
+      break;
+    }
+
+    // Both moves are decided on the error before either is taken.
+    step = 2 * error;
+    if (step >= dy) {
+      error += dy;
+      x0 += sx;
+    }
+    if (step <= dx) {
+      error += dx;
+      y0 += sy;
+    }
+  }
+}
+
+int32_t
+cpu_overlay_text_width (const char * text, int32_t scale)
+{
+  int32_t length = (text != NULL) ? (int32_t) strlen (text) : 0;
+
+  if (length == 0 || scale <= 0) {
+    return 0;
+  }
+
+  return (length * CPU_OVERLAY_CELL_WIDTH - 1) * scale;
+}
+
+static inline const uint8_t *
+cpu_overlay_get_glyph (char c)
+{
+  int32_t index = (uint8_t) c;
+
+  if (index < CPU_OVERLAY_FIRST_GLYPH || index > CPU_OVERLAY_LAST_GLYPH) {
+    index = '?';
+  }
+  return glyphs[index - CPU_OVERLAY_FIRST_GLYPH];
+}
+
+CpuOverlayText *
+cpu_overlay_text_new (const char * text, int32_t scale, uint32_t color)
+{
+  CpuOverlayText *run = NULL;
+  int32_t length = 0, row = 0, column = 0, start = -1;
+  uint32_t idx = 0, capacity = 0;
+
+  if (text == NULL || scale <= 0) {
+    return NULL;
+  }
+
+  run = (CpuOverlayText *) calloc (1, sizeof (CpuOverlayText));
+  if (run == NULL) {
+    return NULL;
+  }
+
+  length = (int32_t) strlen (text);
+  run->color = color;
+  run->width = cpu_overlay_text_width (text, scale);
+  run->height = CPU_OVERLAY_CELL_HEIGHT * scale;
+
+  // Upper bound, every other column of every glyph row set.
+  capacity = length * CPU_OVERLAY_GLYPH_HEIGHT *
+      ((CPU_OVERLAY_GLYPH_WIDTH + 1) / 2);
+  if (capacity > 0) {
+    run->rects = (CpuOverlayRect *) malloc (capacity * sizeof (CpuOverlayRect));
+    if (run->rects == NULL) {
+      free (run);
+      return NULL;
+    }
+  }
+
+  for (row = 0; row < CPU_OVERLAY_GLYPH_HEIGHT; row++) {
+    for (column = 0; column <= length * CPU_OVERLAY_CELL_WIDTH; column++) {
+      int32_t cell = column % CPU_OVERLAY_CELL_WIDTH;
+      int32_t set = 0;
+
+      if (column < length * CPU_OVERLAY_CELL_WIDTH &&
+          cell < CPU_OVERLAY_GLYPH_WIDTH) {
+        const uint8_t *glyph =
+            cpu_overlay_get_glyph (text[column / CPU_OVERLAY_CELL_WIDTH]);
+        set = glyph[row] & (1 << (CPU_OVERLAY_GLYPH_WIDTH - 1 - cell));
+      }
+
+      if (set && start < 0) {
+        start = column;
+      } else if (!set && start >= 0) {
+        CpuOverlayRect *rect = NULL;
+
+        // Extend a rectangle ending on the previous row with the same span.
+        for (idx = 0; idx < run->n_rects; idx++) {
+          rect = &run->rects[idx];
+
+          if (rect->x == start * scale &&
+              rect->width == (column - start) * scale &&
+              rect->y + rect->height == row * scale) {
+            break;
+          }
+        }
+
+        if (idx < run->n_rects) {
+          rect->height += scale;
+        } else {
+          rect = &run->rects[run->n_rects++];
+          rect->x = start * scale;
+          rect->y = row * scale;
+          rect->width = (column - start) * scale;
+          rect->height = scale;
+        }
+        start = -1;
+      }
+    }
+  }
+
+  return run;
+}
+
+void
+cpu_overlay_text_free (CpuOverlayText * run)
+{
+  if (run == NULL) {
+    return;
+  }
+
+  free (run->rects);
+  free (run);
+}
+
+void
+cpu_overlay_text_get_size (const CpuOverlayText * run, int32_t * width,
+    int32_t * height)
+{
+  if (width != NULL) {
+    *width = run->width;
+  }
+
+  if (height != NULL) {
+    *height = run->height;
+  }
+}
+
+void
+cpu_overlay_draw_text_run (CpuOverlayFrame * frame, int32_t x, int32_t y,
+    const CpuOverlayText * run)
+{
+  CpuOverlayColor yuv;
+  uint32_t idx = 0;
+
+  cpu_overlay_unpack_color (frame, run->color, &yuv);
+
+  for (idx = 0; idx < run->n_rects; idx++) {
+    const CpuOverlayRect *rect = &run->rects[idx];
+
+    cpu_overlay_paint_rect (frame, x + rect->x, y + rect->y, rect->width,
+        rect->height, &yuv);
+  }
+}
+
+int32_t
+cpu_overlay_draw_text (CpuOverlayFrame * frame, int32_t x, int32_t y,
+    const char * text, int32_t scale, uint32_t color)
+{
+  CpuOverlayText *run = cpu_overlay_text_new (text, scale, color);
+  int32_t width = 0, height = 0;
+
+  if (run == NULL) {
+    return 0;
+  }
+
+  cpu_overlay_draw_text_run (frame, x, y, run);
+  cpu_overlay_text_get_size (run, &width, &height);
+  cpu_overlay_text_free (run);
+
+  return width;
+}
+
+/* Color of the mask sample at @column of @line. Class maps look it up in
+ * @table, RGBA masks are converted. Returns the raw sample so runs of equal
+ * samples can be detected without converting every pixel. */
+static inline uint32_t
+cpu_overlay_mask_sample (const uint8_t * line, int32_t column,
+    const CpuOverlayColor * table)
+{
+  uint32_t sample = 0;
+
+  if (table != NULL) {
+    return line[column];
+  }
+
+  memcpy (&sample, line + column * 4, sizeof (sample));
+  return sample;
+}
+
+static inline void
+cpu_overlay_mask_color (const CpuOverlayFrame * frame, uint32_t sample,
+    const CpuOverlayColor * table, CpuOverlayColor * color)
+{
+  uint8_t pixel[4];
+
+  if (table != NULL) {
+    *color = table[sample];
+    return;
+  }
+
+  memcpy (pixel, &sample, sizeof (pixel));
+  cpu_overlay_convert_color (frame, pixel[0], pixel[1], pixel[2], pixel[3],
+      color);
+}
+
+/* Blends one line of mask samples. @columns maps each of the @n_samples
+ * destination samples to a mask column, consecutive samples with the same
+ * mask value are blended as one run of @n_bytes bytes per sample. */
+static void
+cpu_overlay_blend_mask_line (const CpuOverlayFrame * frame, uint8_t * row,
+    int32_t n_bytes, const uint8_t * line, const int32_t * columns,
+    int32_t n_samples, const CpuOverlayColor * table)
+{
+  CpuOverlayColor color;
+  int32_t start = 0, end = 0;
+
+  while (start < n_samples) {
+    uint32_t sample = cpu_overlay_mask_sample (line, columns[start], table);
+    const uint8_t *pattern = NULL;
+    uint8_t luma[2];
+
+    for (end = start + 1; end < n_samples; end++) {
+      if (columns[end] != columns[end - 1] &&
+          cpu_overlay_mask_sample (line, columns[end], table) != sample) {
+        break;
+      }
+    }
+
+    cpu_overlay_mask_color (frame, sample, table, &color);
+
+    // Background classes are transparent and skipped entirely.
+    if (color.alpha != 0) {
+      luma[0] = luma[1] = color.y;
+      pattern = (n_bytes == 1) ? luma : color.uv;
+
+      if (color.alpha == 256) {
+        cpu_overlay_fill_row (row + start * n_bytes,
+            (end - start) * n_bytes, pattern);
+      } else {
+        cpu_overlay_blend_row (row + start * n_bytes,
+            (end - start) * n_bytes, pattern, color.alpha);
+      }
+    }
+
+    start = end;
+  }
+}
+
+static void
+cpu_overlay_blend_samples (CpuOverlayFrame * frame, int32_t x, int32_t y,
+    int32_t width, int32_t height, const uint8_t * mask, int32_t mask_width,
+    int32_t mask_height, int32_t mask_stride, const CpuOverlayColor * table)
+{
+  int32_t x0, y0, x1, y1, cx0, cx1, row, column;
+  int32_t *columns = NULL, *chroma_columns = NULL;
+
+  if (mask == NULL || width <= 0 || height <= 0 ||
+      mask_width <= 0 || mask_height <= 0) {
+    return;
+  }
+
+  x0 = CPU_OVERLAY_MAX (x, 0);
+  y0 = CPU_OVERLAY_MAX (y, 0);
+  x1 = CPU_OVERLAY_MIN (x + width, frame->width);
+  y1 = CPU_OVERLAY_MIN (y + height, frame->height);
+
+  if (x0 >= x1 || y0 >= y1) {
+    return;
+  }
+
+  cx0 = x0 / 2;
+  cx1 = (x1 + 1) / 2;
+
+  // Nearest neighbour upsampling, the column mapping is shared by all rows.
+  columns = (int32_t *) malloc (((x1 - x0) + (cx1 - cx0)) * sizeof (int32_t));
+  if (columns == NULL) {
+    return;
+  }
+  chroma_columns = columns + (x1 - x0);
+
+  for (column = x0; column < x1; column++) {
+    columns[column - x0] =
+        (int32_t) ((int64_t) (column - x) * mask_width / width);
+  }
+
+  // A chroma sample takes the color of the first luma pixel of its block.
+  for (column = cx0; column < cx1; column++) {
+    chroma_columns[column - cx0] =
+        columns[CPU_OVERLAY_MAX (column * 2, x0) - x0];
+  }
+
+  for (row = y0; row < y1; row++) {
+    const uint8_t *line = mask +
+        (int64_t) (row - y) * mask_height / height * mask_stride;
+
+    cpu_overlay_blend_mask_line (frame,
+        frame->luma + row * frame->luma_stride + x0, 1, line, columns,
+        x1 - x0, table);
+  }
+
+  for (row = y0 / 2; row < (y1 + 1) / 2; row++) {
+    const uint8_t *line = mask + (int64_t) (CPU_OVERLAY_MAX (row * 2, y0) -
+        y) * mask_height / height * mask_stride;
+
+    cpu_overlay_blend_mask_line (frame,
+        frame->chroma + row * frame->chroma_stride + cx0 * 2, 2, line,
+        chroma_columns, cx1 - cx0, table);
+  }
+
+  free (columns);
+}
+
+void
+cpu_overlay_blend_mask (CpuOverlayFrame * frame, int32_t x, int32_t y,
+    int32_t width, int32_t height, const uint8_t * mask, int32_t mask_width,
+    int32_t mask_height, int32_t mask_stride, const uint32_t * palette,
+    uint32_t n_colors)
+{
+  CpuOverlayColor table[256];
+  uint8_t pixel[4];
+  uint32_t idx = 0;
+
+  // Classes without a palette entry stay transparent.
+  memset (table, 0, sizeof (table));
+
+  for (idx = 0; palette != NULL && idx < CPU_OVERLAY_MIN (n_colors, 256);
+       idx++) {
+    memcpy (pixel, &palette[idx], sizeof (pixel));
+    cpu_overlay_convert_color (frame, pixel[0], pixel[1], pixel[2], pixel[3],
+        &table[idx]);
+  }
+
+  cpu_overlay_blend_samples (frame, x, y, width, height, mask, mask_width,
+      mask_height, mask_stride, table);
+}
+
+CpuOverlayLayer *
+cpu_overlay_layer_new (void)
+{
+  return (CpuOverlayLayer *) calloc (1, sizeof (CpuOverlayLayer));
+}
+
+void
+cpu_overlay_layer_free (CpuOverlayLayer * layer)
+{
+  if (layer == NULL) {
+    return;
+  }
+
+  free (layer->rects);
+  free (layer->colors);
+  free (layer);
+}
+
+void
+cpu_overlay_layer_clear (CpuOverlayLayer * layer)
+{
+  layer->n_rects = 0;
+}
+
+static int32_t
+cpu_overlay_layer_add (CpuOverlayLayer * layer, int32_t x, int32_t y,
+    int32_t width, int32_t height, uint32_t color)
+{
+  CpuOverlayRect *rect = NULL;
+
+  if (width <= 0 || height <= 0 || (color & 0xFF) == 0) {
+    return 0;
+  }
+
+  if (layer->n_rects == layer->n_allocated) {
+    uint32_t n_allocated = CPU_OVERLAY_MAX (layer->n_allocated * 2, 16);
+    CpuOverlayRect *rects = (CpuOverlayRect *) realloc (layer->rects,
+        n_allocated * sizeof (CpuOverlayRect));
+    uint32_t *colors = NULL;
+
+    if (rects == NULL) {
+      return -1;
+    }
+    layer->rects = rects;
+
+    colors = (uint32_t *) realloc (layer->colors,
+        n_allocated * sizeof (uint32_t));
+    if (colors == NULL) {
+      return -1;
+    }
+    layer->colors = colors;
+
+    layer->n_allocated = n_allocated;
+  }
+
+  rect = &layer->rects[layer->n_rects];
+  rect->x = x;
+  rect->y = y;
+  rect->width = width;
+  rect->height = height;
+  layer->colors[layer->n_rects] = color;
+  layer->n_rects++;
+
+  return 0;
+}
+
+int32_t
+cpu_overlay_layer_fill_rect (CpuOverlayLayer * layer, int32_t x, int32_t y,
+    int32_t width, int32_t height, uint32_t color)
+{
+  return cpu_overlay_layer_add (layer, x, y, width, height, color);
+}
+
+int32_t
+cpu_overlay_layer_draw_rect (CpuOverlayLayer * layer, int32_t x, int32_t y,
+    int32_t width, int32_t height, int32_t thickness, uint32_t color)
+{
+  int32_t ret = 0;
+
+  if (width <= 0 || height <= 0 || thickness <= 0) {
+    return 0;
+  }
+
+  // Same sides as cpu_overlay_draw_rect().
+  thickness = CPU_OVERLAY_MIN (thickness, CPU_OVERLAY_MIN (width, height) / 2);
+  thickness = CPU_OVERLAY_MAX (thickness, 1);
+
+  ret |= cpu_overlay_layer_add (layer, x, y, width, thickness, color);
+  ret |= cpu_overlay_layer_add (layer, x, y + height - thickness, width,
+      thickness, color);
+  ret |= cpu_overlay_layer_add (layer, x, y + thickness, thickness,
+      height - 2 * thickness, color);
+  ret |= cpu_overlay_layer_add (layer, x + width - thickness, y + thickness,
+      thickness, height - 2 * thickness, color);
+
+  return ret;
+}
+
+int32_t
+cpu_overlay_layer_draw_text_run (CpuOverlayLayer * layer, int32_t x,
+    int32_t y, const CpuOverlayText * run)
+{
+  uint32_t idx = 0;
+
+  for (idx = 0; idx < run->n_rects; idx++) {
+    const CpuOverlayRect *rect = &run->rects[idx];
+
+    if (cpu_overlay_layer_add (layer, x + rect->x, y + rect->y, rect->width,
+        rect->height, run->color) != 0) {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+void
+cpu_overlay_layer_get_bounds (const CpuOverlayLayer * layer, int32_t * x,
+    int32_t * y, int32_t * width, int32_t * height)
+{
+  int32_t x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+  uint32_t idx = 0;
+
+  for (idx = 0; idx < layer->n_rects; idx++) {
+    const CpuOverlayRect *rect = &layer->rects[idx];
+
+    if (idx == 0) {
+      x0 = rect->x;
+      y0 = rect->y;
+      x1 = rect->x + rect->width;
+      y1 = rect->y + rect->height;
+      continue;
+    }
+
+    x0 = CPU_OVERLAY_MIN (x0, rect->x);
+    y0 = CPU_OVERLAY_MIN (y0, rect->y);
+    x1 = CPU_OVERLAY_MAX (x1, rect->x + rect->width);
+    y1 = CPU_OVERLAY_MAX (y1, rect->y + rect->height);
+  }
+
+  *x = x0;
+  *y = y0;
+  *width = x1 - x0;
+  *height = y1 - y0;
+}
+
+void
+cpu_overlay_draw_layer (CpuOverlayFrame * frame,
+    const CpuOverlayLayer * layer)
+{
+  CpuOverlayColor yuv;
+  uint32_t idx = 0;
+
+  for (idx = 0; idx < layer->n_rects; idx++) {
+    const CpuOverlayRect *rect = &layer->rects[idx];
+
+    // Consecutive rectangles mostly share their color.
+    if (idx == 0 || layer->colors[idx] != layer->colors[idx - 1]) {
+      cpu_overlay_unpack_color (frame, layer->colors[idx], &yuv);
+    }
+
+    cpu_overlay_paint_rect (frame, rect->x, rect->y, rect->width,
+        rect->height, &yuv);
+  }
+}
+
+void
+cpu_overlay_blend_image (CpuOverlayFrame * frame, int32_t x, int32_t y,
+    int32_t width, int32_t height, const uint8_t * image,
+    int32_t image_width, int32_t image_height, int32_t image_stride)
+{
+  cpu_overlay_blend_samples (frame, x, y, width, height, image, image_width,
+      image_height, image_stride, NULL);
+}
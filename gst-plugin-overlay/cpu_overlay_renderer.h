@@ -0,0 +1,301 @@
+/*
+* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __CPU_OVERLAY_RENDERER_H__
+#define __CPU_OVERLAY_RENDERER_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Software renderer drawing directly into the planes of NV12 and NV21
+ * frames. It has no dependencies besides libc so it can be exercised on any
+ * Linux host. Colors are 0xRRGGBBAA words, images are R, G, B, A bytes.
+ * Everything is clipped to the frame. */
+
+#define CPU_OVERLAY_GLYPH_WIDTH   5
+#define CPU_OVERLAY_GLYPH_HEIGHT  7
+/* Glyph cell size including the spacing to the next glyph and line */
+#define CPU_OVERLAY_CELL_WIDTH    6
+#define CPU_OVERLAY_CELL_HEIGHT   9
+
+typedef struct _CpuOverlayFrame CpuOverlayFrame;
+typedef struct _CpuOverlayText CpuOverlayText;
+typedef struct _CpuOverlayLayer CpuOverlayLayer;
+
+/**
+ * CpuOverlayFrame:
+ * @luma: Y plane
+ * @chroma: interleaved UV (NV12) or VU (NV21) plane
+ * @width: frame width in pixels
+ * @height: frame height in pixels
+ * @luma_stride: Y plane stride in bytes
+ * @chroma_stride: UV plane stride in bytes
+ * @swap_uv: non zero for NV21
+ */
+struct _CpuOverlayFrame {
+  uint8_t  *luma;
+  uint8_t  *chroma;
+  int32_t  width;
+  int32_t  height;
+  int32_t  luma_stride;
+  int32_t  chroma_stride;
+  int32_t  swap_uv;
+};
+
+/**
+ * cpu_overlay_fill_rect:
+ * @frame: target frame
+ * @x, @y, @width, @height: rectangle
+ * @color: fill color, alpha blended
+ *
+ * Fills a rectangle. Chroma covers the 2x2 blocks touched by the rectangle.
+ */
+void cpu_overlay_fill_rect (CpuOverlayFrame * frame, int32_t x, int32_t y,
+    int32_t width, int32_t height, uint32_t color);
+
+/**
+ * cpu_overlay_draw_rect:
+ * @frame: target frame
+ * @x, @y, @width, @height: rectangle
+ * @thickness: border thickness in pixels, drawn inside the rectangle
+ * @color: border color
+ *
+ * Draws the outline of a rectangle.
+ */
+void cpu_overlay_draw_rect (CpuOverlayFrame * frame, int32_t x, int32_t y,
+    int32_t width, int32_t height, int32_t thickness, uint32_t color);
+
+/**
+ * cpu_overlay_draw_line:
+ * @frame: target frame
+ * @x0, @y0: start point
+ * @x1, @y1: end point
+ * @thickness: line thickness in pixels
+ * @color: line color
+ *
+ * Draws a straight line with square pen.
+ */
+void cpu_overlay_draw_line (CpuOverlayFrame * frame, int32_t x0, int32_t y0,
+    int32_t x1, int32_t y1, int32_t thickness, uint32_t color);
+
+/**
+ * cpu_overlay_draw_text:
+ * @frame: target frame
+ * @x, @y: top left corner of the first glyph cell
+ * @text: ASCII string, other characters are drawn as '?'
+ * @scale: integer glyph magnification
+ * @color: text color
+ *
+ * Draws a single line of text from the built in glyph atlas.
+ *
+ * Returns: width in pixels of the text
+ */
+int32_t cpu_overlay_draw_text (CpuOverlayFrame * frame, int32_t x, int32_t y,
+    const char * text, int32_t scale, uint32_t color);
+
+/**
+ * cpu_overlay_text_width:
+ * @text: ASCII string
+ * @scale: integer glyph magnification
+ *
+ * Returns: width in pixels cpu_overlay_draw_text() would draw
+ */
+int32_t cpu_overlay_text_width (const char * text, int32_t scale);
+
+/**
+ * cpu_overlay_text_new:
+ * @text: ASCII string, other characters are drawn as '?'
+ * @scale: integer glyph magnification
+ * @color: text color
+ *
+ * Rasterizes a line of text once into the rectangles covering its glyphs,
+ * horizontal runs and identical runs on consecutive rows are merged. The
+ * result is drawn with cpu_overlay_draw_text_run() as often as needed.
+ *
+ * Returns: new text run or NULL on allocation failure
+ */
+CpuOverlayText * cpu_overlay_text_new (const char * text, int32_t scale,
+    uint32_t color);
+
+/**
+ * cpu_overlay_text_free:
+ * @run: text run
+ *
+ * Frees a text run created with cpu_overlay_text_new().
+ */
+void cpu_overlay_text_free (CpuOverlayText * run);
+
+/**
+ * cpu_overlay_text_get_size:
+ * @run: text run
+ * @width: (out) (optional): width in pixels
+ * @height: (out) (optional): height in pixels of a glyph cell
+ */
+void cpu_overlay_text_get_size (const CpuOverlayText * run, int32_t * width,
+    int32_t * height);
+
+/**
+ * cpu_overlay_draw_text_run:
+ * @frame: target frame
+ * @x, @y: top left corner of the first glyph cell
+ * @run: text run
+ *
+ * Draws a text run, same output as cpu_overlay_draw_text().
+ */
+void cpu_overlay_draw_text_run (CpuOverlayFrame * frame, int32_t x,
+    int32_t y, const CpuOverlayText * run);
+
+/**
+ * cpu_overlay_layer_new:
+ *
+ * Creates an empty layer. A layer records solid rectangles, borders and
+ * text runs once and replays them into any number of frames. Drawing a
+ * layer gives the same result as drawing its content directly.
+ *
+ * Returns: new layer or NULL on allocation failure
+ */
+CpuOverlayLayer * cpu_overlay_layer_new (void);
+
+/**
+ * cpu_overlay_layer_free:
+ * @layer: layer
+ */
+void cpu_overlay_layer_free (CpuOverlayLayer * layer);
+
+/**
+ * cpu_overlay_layer_clear:
+ * @layer: layer
+ *
+ * Removes the content of the layer, keeping its memory for the next use.
+ */
+void cpu_overlay_layer_clear (CpuOverlayLayer * layer);
+
+/**
+ * cpu_overlay_layer_fill_rect:
+ * @layer: layer
+ * @x, @y, @width, @height: rectangle
+ * @color: fill color
+ *
+ * Records cpu_overlay_fill_rect().
+ *
+ * Returns: 0 on success, -1 on allocation failure
+ */
+int32_t cpu_overlay_layer_fill_rect (CpuOverlayLayer * layer, int32_t x,
+    int32_t y, int32_t width, int32_t height, uint32_t color);
+
+/**
+ * cpu_overlay_layer_draw_rect:
+ * @layer: layer
+ * @x, @y, @width, @height: rectangle
+ * @thickness: border thickness in pixels
+ * @color: border color
+ *
+ * Records cpu_overlay_draw_rect().
+ *
+ * Returns: 0 on success, -1 on allocation failure
+ */
+int32_t cpu_overlay_layer_draw_rect (CpuOverlayLayer * layer, int32_t x,
+    int32_t y, int32_t width, int32_t height, int32_t thickness,
+    uint32_t color);
+
+/**
+ * cpu_overlay_layer_draw_text_run:
+ * @layer: layer
+ * @x, @y: top left corner of the first glyph cell
+ * @run: text run, it may be freed afterwards
+ *
+ * Records cpu_overlay_draw_text_run().
+ *
+ * Returns: 0 on success, -1 on allocation failure
+ */
+int32_t cpu_overlay_layer_draw_text_run (CpuOverlayLayer * layer, int32_t x,
+    int32_t y, const CpuOverlayText * run);
+
+/**
+ * cpu_overlay_layer_get_bounds:
+ * @layer: layer
+ * @x, @y, @width, @height: (out): bounding box of the content, all zero
+ *     when the layer is empty
+ */
+void cpu_overlay_layer_get_bounds (const CpuOverlayLayer * layer,
+    int32_t * x, int32_t * y, int32_t * width, int32_t * height);
+
+/**
+ * cpu_overlay_draw_layer:
+ * @frame: target frame
+ * @layer: layer
+ *
+ * Draws the recorded content of @layer in recording order.
+ */
+void cpu_overlay_draw_layer (CpuOverlayFrame * frame,
+    const CpuOverlayLayer * layer);
+
+/**
+ * cpu_overlay_blend_image:
+ * @frame: target frame
+ * @x, @y, @width, @height: destination rectangle
+ * @image: RGBA image
+ * @image_width, @image_height: image size in pixels
+ * @image_stride: image stride in bytes
+ *
+ * Scales an RGBA image to the destination rectangle with nearest neighbour
+ * sampling and alpha blends it, e.g. a segmentation mask. Transparent pixels
+ * are skipped. Chroma takes the color of the first pixel of each 2x2 block.
+ */
+void cpu_overlay_blend_image (CpuOverlayFrame * frame, int32_t x, int32_t y,
+    int32_t width, int32_t height, const uint8_t * image,
+    int32_t image_width, int32_t image_height, int32_t image_stride);
+
+/**
+ * cpu_overlay_blend_mask:
+ * @frame: target frame
+ * @x, @y, @width, @height: destination rectangle
+ * @mask: one class index per pixel
+ * @mask_width, @mask_height: mask size in pixels
+ * @mask_stride: mask stride in bytes
+ * @palette: colors indexed by class, R, G, B, A bytes like images
+ * @n_colors: number of entries in @palette
+ *
+ * Same as cpu_overlay_blend_image() for a class map at model resolution.
+ * The palette is converted once and pixels of transparent classes, usually
+ * the background, are skipped. Classes past @n_colors are transparent.
+ */
+void cpu_overlay_blend_mask (CpuOverlayFrame * frame, int32_t x, int32_t y,
+    int32_t width, int32_t height, const uint8_t * mask, int32_t mask_width,
+    int32_t mask_height, int32_t mask_stride, const uint32_t * palette,
+    uint32_t n_colors);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __CPU_OVERLAY_RENDERER_H__
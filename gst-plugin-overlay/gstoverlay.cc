@@ -32,7 +32,6 @@
 #endif
 
 #include <string.h>
-#include <gst/allocators/gstfdmemory.h>
 #include <ml-meta/ml_meta.h>
 
 #include "gstoverlay.h"
@@ -54,9 +53,15 @@ G_DEFINE_TYPE (GstOverlay, gst_overlay, GST_TYPE_VIDEO_FILTER);
 #define DEFAULT_PROP_OVERLAY_DATE_COLOR  kColorRed
 #define DEFAULT_PROP_OVERLAY_TEXT_COLOR  kColorYellow
 #define DEFAULT_PROP_OVERLAY_POSE_COLOR  kColorLightGreen
+#define DEFAULT_PROP_OVERLAY_BACKEND     GST_OVERLAY_BACKEND_QMMF
+#define DEFAULT_PROP_OVERLAY_ASYNC       FALSE
+#define DEFAULT_PROP_OVERLAY_MAX_STALENESS 2
 
 #define GST_OVERLAY_UNUSED(var) ((void)var)
 
+/* Frames an unused overlay item stays alive (disabled) before deletion */
+#define GST_OVERLAY_ITEM_MAX_IDLE        30
+
 static GstMLKeyPointsType PoseChain [][2] {
   {LEFT_SHOULDER,  RIGHT_SHOULDER},
   {LEFT_SHOULDER,  LEFT_ELBOW},
@@ -80,323 +85,464 @@ enum {
   PROP_OVERLAY_BBOX_COLOR,
   PROP_OVERLAY_DATE_COLOR,
   PROP_OVERLAY_TEXT_COLOR,
-  PROP_OVERLAY_POSE_COLOR
+  PROP_OVERLAY_POSE_COLOR,
+  PROP_OVERLAY_BACKEND,
+  PROP_OVERLAY_STATS,
+  PROP_OVERLAY_ASYNC,
+  PROP_OVERLAY_MAX_STALENESS
 };
 
+static GType
+gst_overlay_backend_get_type (void)
+{
+  static GType overlay_backend_type = 0;
+  static const GEnumValue backends[] = {
+    {GST_OVERLAY_BACKEND_QMMF, "Compose with the qmmf overlay library", "qmmf"},
+    {GST_OVERLAY_BACKEND_CPU, "Draw into the frame on the CPU", "cpu"},
+    {0, NULL, NULL},
+  };
+  if (!overlay_backend_type) {
+    overlay_backend_type =
+        g_enum_register_static ("GstOverlayBackendType", backends);
+  }
+  return overlay_backend_type;
+}
+
 static GstStaticCaps gst_overlay_format_caps =
     GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE (GST_VIDEO_FORMATS) ";"
     GST_VIDEO_CAPS_MAKE_WITH_FEATURES ("ANY", GST_VIDEO_FORMATS));
 
 /**
- * GstOverlayMetaApplyFunc:
+ * GstOverlayMetaPrepareFunc:
  * @gst_overlay: context
+ * @state: state receiving the overlay parameters
  * @meta: metadata payload
- * @item_id: overlay item unique id
  *
- * Function called when overlay is configured by metadata.
+ * Function called when overlay is configured by metadata. It may run on the
+ * worker thread, so it only reads the metadata and the element settings.
  */
-typedef gboolean (*GstOverlayMetaApplyFunc)
-    (GstOverlay *gst_overlay, gpointer meta, uint32_t * item_id);
+typedef gboolean (*GstOverlayMetaPrepareFunc)
+    (GstOverlay *gst_overlay, GstOverlayState * state, gpointer meta);
 
 
 static void
-gst_overlay_destroy_overlay_item (gpointer data, gpointer user_data)
+gst_overlay_item_disable (GstOverlay *gst_overlay, GstOverlayItem * item)
 {
-  uint32_t *item_id = (uint32_t *) data;
-  GstOverlay *gst_overlay = (GstOverlay *) user_data;
+  if (!item->enabled) {
+    return;
+  }
 
-  int32_t ret = gst_overlay->overlay->DisableOverlayItem (*item_id);
+  int32_t ret = gst_overlay->overlay->DisableOverlayItem (item->id);
   if (ret != 0) {
     GST_ERROR_OBJECT (gst_overlay, "Overlay disable failed!");
   }
 
-  ret = gst_overlay->overlay->DeleteOverlayItem (*item_id);
+  item->enabled = FALSE;
+  gst_overlay->n_enabled--;
+}
+
+static void
+gst_overlay_item_destroy (GstOverlay *gst_overlay, GstOverlayItem * item)
+{
+  if (!item->id) {
+    return;
+  }
+
+  gst_overlay_item_disable (gst_overlay, item);
+
+  int32_t ret = gst_overlay->overlay->DeleteOverlayItem (item->id);
   if (ret != 0) {
     GST_ERROR_OBJECT (gst_overlay, "Overlay delete failed!");
   }
 
-  *item_id = 0;
+  item->id = 0;
+  item->idle = 0;
 }
 
-static gboolean gst_overlay_apply_item_list (GstOverlay *gst_overlay,
-  GSList * meta_list, GstOverlayMetaApplyFunc apply_func, GSequence * ov_id)
+static void
+gst_overlay_destroy_overlay_item (gpointer data, gpointer user_data)
 {
-  gboolean res = TRUE;
+  gst_overlay_item_destroy ((GstOverlay *) user_data, (GstOverlayItem *) data);
+}
 
-  guint meta_num = g_slist_length (meta_list);
-  if (meta_num) {
-    for (uint32_t i = g_sequence_get_length (ov_id);
-        i < meta_num; i++) {
-      g_sequence_append(ov_id, calloc(1, sizeof(uint32_t)));
+/* Hands @ov_param over to the overlay library and enables the item. The
+ * library is called only when the parameters differ from the cached ones,
+ * unless @force is set because the content behind a pointer changed. Both
+ * @ov_param and the cache are zero filled, so they compare byte wise. */
+static gboolean
+gst_overlay_item_apply (GstOverlay *gst_overlay, GstOverlayItem * item,
+    OverlayParam * ov_param, gboolean force)
+{
+  int32_t ret = 0;
+
+  if (!item->id) {
+    ret = gst_overlay->overlay->CreateOverlayItem (*ov_param, &item->id);
+    if (ret != 0) {
+      GST_ERROR_OBJECT (gst_overlay, "Overlay create failed! ret: %d", ret);
+      item->id = 0;
+      return FALSE;
     }
+    memcpy (&item->param, ov_param, sizeof (OverlayParam));
+  } else if (force ||
+      memcmp (&item->param, ov_param, sizeof (OverlayParam)) != 0) {
+    ret = gst_overlay->overlay->UpdateOverlayParams (item->id, *ov_param);
+    if (ret != 0) {
+      GST_ERROR_OBJECT (gst_overlay, "Overlay set param failed! ret: %d", ret);
+      return FALSE;
+    }
+    memcpy (&item->param, ov_param, sizeof (OverlayParam));
+  }
 
-    for (uint32_t i = 0; i < meta_num; i++) {
-      res = apply_func (gst_overlay, g_slist_nth_data (meta_list, 0),
-          (uint32_t *) g_sequence_get (g_sequence_get_iter_at_pos (ov_id, i)));
-      if (!res) {
-        GST_ERROR_OBJECT (gst_overlay, "Overlay create failed!");
-        return res;
-      }
-      meta_list = meta_list->next;
+  if (!item->enabled) {
+    ret = gst_overlay->overlay->EnableOverlayItem (item->id);
+    if (ret != 0) {
+      GST_ERROR_OBJECT (gst_overlay, "Overlay enable failed! ret: %d", ret);
+      return FALSE;
     }
+    item->enabled = TRUE;
+    gst_overlay->n_enabled++;
+  }
+
+  item->idle = 0;
+  return TRUE;
+}
+
+/* Returns the overlay item at @iter and advances it. Items are created on
+ * demand, so the sequence grows to the largest number of metadata entries
+ * seen recently. */
+static GstOverlayItem *
+gst_overlay_next_item (GSequence * items, GSequenceIter ** iter)
+{
+  GstOverlayItem *item = NULL;
+
+  if (g_sequence_iter_is_end (*iter)) {
+    *iter = g_sequence_append (items, g_new0 (GstOverlayItem, 1));
+  }
+  item = (GstOverlayItem *) g_sequence_get (*iter);
+  *iter = g_sequence_iter_next (*iter);
+
+  return item;
+}
+
+/* Disables the items past the first @num. They are deleted only after being
+ * unused for GST_OVERLAY_ITEM_MAX_IDLE frames, so a fluctuating number of
+ * detections does not create and delete items every frame. */
+static void
+gst_overlay_release_items (GstOverlay *gst_overlay, GSequence * items,
+    guint num)
+{
+  GSequenceIter *iter = g_sequence_get_iter_at_pos (items, num);
+  GstOverlayItem *item = NULL;
+
+  for (; !g_sequence_iter_is_end (iter); iter = g_sequence_iter_next (iter)) {
+    item = (GstOverlayItem *) g_sequence_get (iter);
+    gst_overlay_item_disable (gst_overlay, item);
+    item->idle++;
   }
-  if ((guint) g_sequence_get_length (ov_id) > meta_num) {
-    g_sequence_foreach_range (
-        g_sequence_get_iter_at_pos (ov_id, meta_num),
-        g_sequence_get_end_iter (ov_id),
+
+  // Items at the end have been idle the longest.
+  while ((guint) g_sequence_get_length (items) > num) {
+    iter = g_sequence_iter_prev (g_sequence_get_end_iter (items));
+    item = (GstOverlayItem *) g_sequence_get (iter);
+
+    if (item->idle <= GST_OVERLAY_ITEM_MAX_IDLE) {
+      break;
+    }
+
+    gst_overlay_item_destroy (gst_overlay, item);
+    g_sequence_remove (iter);
+  }
+}
+
+static void
+gst_overlay_destroy_items (GstOverlay *gst_overlay)
+{
+  for (guint i = 0; i < GST_OVERLAY_KIND_MAX; i++) {
+    g_sequence_foreach (gst_overlay->items[i],
         gst_overlay_destroy_overlay_item, gst_overlay);
-    g_sequence_remove_range (
-        g_sequence_get_iter_at_pos (ov_id, meta_num),
-        g_sequence_get_end_iter (ov_id));
+    g_sequence_remove_range (g_sequence_get_begin_iter (gst_overlay->items[i]),
+        g_sequence_get_end_iter (gst_overlay->items[i]));
+  }
+
+  gst_overlay_item_destroy (gst_overlay, &gst_overlay->user_text_item);
+  gst_overlay_item_destroy (gst_overlay, &gst_overlay->date_item);
+}
+
+static gboolean
+gst_overlay_prepare_item_list (GstOverlay *gst_overlay,
+    GstOverlayState * state, GstBuffer * buffer, GType api,
+    GstOverlayMetaPrepareFunc prepare_func)
+{
+  gpointer iter = NULL;
+  GstMeta *meta = NULL;
+
+  while ((meta = gst_buffer_iterate_ml_meta (buffer, &iter, api))) {
+    if (!prepare_func (gst_overlay, state, meta)) {
+      GST_ERROR_OBJECT (gst_overlay, "Overlay create failed!");
+      return FALSE;
+    }
   }
 
   return TRUE;
 }
 
 static gboolean
-gst_overlay_apply_bbox_item (GstOverlay * gst_overlay, gpointer metadata,
-    uint32_t * item_id)
+gst_overlay_prepare_bbox (GstOverlay * gst_overlay, GstOverlayState * state,
+    const GstMLBoundingBox * box, const gchar * name)
 {
   OverlayParam ov_param;
-  int32_t ret = 0;
 
+  if (!name) {
+    name = "";
+  }
+
+  memset (&ov_param, 0, sizeof (ov_param));
+  ov_param.type = OverlayType::kBoundingBox;
+  ov_param.location = OverlayLocationType::kTopLeft;
+  ov_param.color = gst_overlay->bbox_color;
+  ov_param.dst_rect.start_x = box->x;
+  ov_param.dst_rect.start_y = box->y;
+  ov_param.dst_rect.width = box->width;
+  ov_param.dst_rect.height = box->height;
+
+  if (sizeof (ov_param.bounding_box.box_name) < strlen (name)) {
+    GST_ERROR_OBJECT (gst_overlay, "Text size exceeded %d < %d",
+      sizeof (ov_param.bounding_box.box_name), strlen (name));
+    return FALSE;
+  }
+  g_strlcpy (ov_param.bounding_box.box_name, name,
+      sizeof (ov_param.bounding_box.box_name));
+
+  g_array_append_val (state->params[GST_OVERLAY_KIND_BBOX], ov_param);
+  return TRUE;
+}
+
+static gboolean
+gst_overlay_prepare_bbox_item (GstOverlay * gst_overlay,
+    GstOverlayState * state, gpointer metadata)
+{
   g_return_val_if_fail (gst_overlay != NULL, FALSE);
   g_return_val_if_fail (metadata != NULL, FALSE);
-  g_return_val_if_fail (item_id != NULL, FALSE);
 
   GstMLDetectionMeta * meta = (GstMLDetectionMeta *) metadata;
   GstMLClassificationResult * result =
       (GstMLClassificationResult *) g_slist_nth_data (meta->box_info, 0);
 
-  if (!(*item_id)) {
-    ov_param = {};
-    ov_param.type = OverlayType::kBoundingBox;
-    ov_param.location = OverlayLocationType::kTopLeft;
-    ov_param.color = gst_overlay->bbox_color;
-    ov_param.dst_rect.start_x = meta->bounding_box.x;
-    ov_param.dst_rect.start_y = meta->bounding_box.y;
-    ov_param.dst_rect.width = meta->bounding_box.width;
-    ov_param.dst_rect.height = meta->bounding_box.height;
-
-    if (sizeof (ov_param.bounding_box.box_name) < strlen (result->name)) {
-      GST_ERROR_OBJECT (gst_overlay, "Text size exceeded %d < %d",
-        sizeof (ov_param.bounding_box.box_name), strlen (result->name));
-      return FALSE;
-    }
-    g_strlcpy (ov_param.bounding_box.box_name, result->name,
-        sizeof (ov_param.bounding_box.box_name));
+  return gst_overlay_prepare_bbox (gst_overlay, state, &meta->bounding_box,
+      result ? result->name : NULL);
+}
 
-    ret = gst_overlay->overlay->CreateOverlayItem (ov_param, item_id);
-    if (ret != 0) {
-      GST_ERROR_OBJECT (gst_overlay, "Overlay create failed! ret: %d", ret);
-      return FALSE;
-    }
+/* Prepares bounding boxes of both the per object detection metas and the
+ * detection batch meta. Both share the bounding box overlay items, batch
+ * boxes come first. */
+static gboolean
+gst_overlay_prepare_bbox_items (GstOverlay * gst_overlay,
+    GstOverlayState * state, GstBuffer * buffer)
+{
+  GstMLDetectionBatchMeta *batch = gst_buffer_get_detection_batch_meta (buffer);
+  GstMLDetectionMeta *meta = NULL;
+  gpointer iter = NULL;
+  gboolean res = TRUE;
 
-    ret = gst_overlay->overlay->EnableOverlayItem (*item_id);
-    if (ret != 0) {
-      GST_ERROR_OBJECT (gst_overlay, "Overlay enable failed! ret: %d", ret);
-      return FALSE;
-    }
-  } else {
-    ret = gst_overlay->overlay->GetOverlayParams (*item_id, ov_param);
-    if (ret != 0) {
-      GST_ERROR_OBJECT (gst_overlay, "Overlay get param failed! ret: %d", ret);
-      return FALSE;
-    }
+  for (guint i = 0; res && batch && i < batch->n_boxes; i++) {
+    GstMLBoundingBox box;
+    box.x = batch->x[i];
+    box.y = batch->y[i];
+    box.width = batch->width[i];
+    box.height = batch->height[i];
 
-    ov_param.dst_rect.start_x = meta->bounding_box.x;
-    ov_param.dst_rect.start_y = meta->bounding_box.y;
-    ov_param.dst_rect.width = meta->bounding_box.width;
-    ov_param.dst_rect.height = meta->bounding_box.height;
+    res = gst_overlay_prepare_bbox (gst_overlay, state, &box,
+        gst_ml_detection_batch_meta_get_label (batch, i));
+  }
 
-    if (sizeof (ov_param.bounding_box.box_name) < strlen (result->name)) {
-      GST_ERROR_OBJECT (gst_overlay, "Text size exceeded %d < %d",
-        sizeof (ov_param.bounding_box.box_name), strlen (result->name));
-      return FALSE;
-    }
-    g_strlcpy (ov_param.bounding_box.box_name, result->name,
-        sizeof (ov_param.bounding_box.box_name));
+  while (res && (meta = gst_buffer_iterate_detection_meta (buffer, &iter))) {
+    res = gst_overlay_prepare_bbox_item (gst_overlay, state, meta);
+  }
 
-    ret = gst_overlay->overlay->UpdateOverlayParams (*item_id, ov_param);
-    if (ret != 0) {
-      GST_ERROR_OBJECT (gst_overlay, "Overlay set param failed! ret: %d", ret);
-      return FALSE;
-    }
+  if (!res) {
+    GST_ERROR_OBJECT (gst_overlay, "Overlay create failed!");
+    return FALSE;
   }
+
   return TRUE;
 }
 
+/* Expands a GRAY8 class index map into the RGBA image expected by the
+ * overlay library. The RGBA buffers are owned by the state and reused for
+ * every frame, metadata itself only carries one byte per pixel. Each image
+ * item of a frame expands into its own buffer at @index. */
+static gpointer
+gst_overlay_expand_class_map (GstOverlayState * state,
+    GstMLSegmentationMeta *meta, guint index, guint *size)
+{
+  guint8 *classes = (guint8 *) meta->img_buffer;
+  GByteArray *buffer = NULL;
+  guint32 *rgba = NULL;
+  guint n_pixels = meta->img_width * meta->img_height;
+
+  if (index >= state->simg_rgba->len)
+    g_ptr_array_add (state->simg_rgba, g_byte_array_new ());
+
+  buffer = (GByteArray *) g_ptr_array_index (state->simg_rgba, index);
+  g_byte_array_set_size (buffer, n_pixels * 4);
+  rgba = (guint32 *) buffer->data;
+
+  for (guint y = 0; y < meta->img_height; y++) {
+    guint8 *line = classes + y * meta->img_stride;
+    for (guint x = 0; x < meta->img_width; x++) {
+      guint idx = line[x];
+      *rgba++ = (idx < meta->n_colors) ? meta->palette[idx] : 0;
+    }
+  }
+
+  *size = n_pixels * 4;
+  return buffer->data;
+}
+
 static gboolean
-gst_overlay_apply_simg_item (GstOverlay *gst_overlay, gpointer metadata,
-    uint32_t *item_id)
+gst_overlay_prepare_simg_item (GstOverlay *gst_overlay,
+    GstOverlayState * state, gpointer metadata)
 {
   OverlayParam ov_param;
-  int32_t ret = 0;
+  gpointer image_buffer = NULL;
+  guint image_size = 0;
 
   g_return_val_if_fail (gst_overlay != NULL, FALSE);
   g_return_val_if_fail (metadata != NULL, FALSE);
-  g_return_val_if_fail (item_id != NULL, FALSE);
 
   GstMLSegmentationMeta *meta = (GstMLSegmentationMeta *) metadata;
 
-  if (!(*item_id)) {
-    ov_param = {};
-    ov_param.type = OverlayType::kStaticImage;
-    ov_param.location = OverlayLocationType::kRandom;
-    ov_param.dst_rect.start_x = 0;
-    ov_param.dst_rect.start_y = 0;
-    ov_param.dst_rect.width = gst_overlay->width;
-    ov_param.dst_rect.height = gst_overlay->height;
-    ov_param.image_info.image_type = OverlayImageType::kBlobType;
-    ov_param.image_info.source_rect.start_x = 0;
-    ov_param.image_info.source_rect.start_y = 0;
-    ov_param.image_info.source_rect.width = meta->img_width;
-    ov_param.image_info.source_rect.height = meta->img_height;
-    ov_param.image_info.image_buffer = (char *)meta->img_buffer;
-    ov_param.image_info.image_size = meta->img_size;
-    ov_param.image_info.buffer_updated = true;
-
-    ret = gst_overlay->overlay->CreateOverlayItem (ov_param, item_id);
-    if (ret != 0) {
-      GST_ERROR_OBJECT (gst_overlay, "Overlay create failed! ret: %d", ret);
-      return FALSE;
-    }
+  // Masks are blended at model resolution, without RGBA expansion or an
+  // overlay item. The meta stays on the buffer, no copy is needed.
+  if (gst_overlay->use_masks) {
+    gboolean indexed = (meta->img_format == GST_VIDEO_FORMAT_GRAY8);
+    OverlayMask mask;
 
-    ret = gst_overlay->overlay->EnableOverlayItem (*item_id);
-    if (ret != 0) {
-      GST_ERROR_OBJECT (gst_overlay, "Overlay enable failed! ret: %d", ret);
-      return FALSE;
+    if (indexed && !meta->palette) {
+      GST_WARNING_OBJECT (gst_overlay, "Class map without palette, skip");
+      return TRUE;
     }
+
+    mask.data = (const uint8_t *) meta->img_buffer;
+    mask.width = meta->img_width;
+    mask.height = meta->img_height;
+    mask.stride = meta->img_stride ? meta->img_stride :
+        meta->img_width * (indexed ? 1 : 4);
+    mask.palette = indexed ? meta->palette : NULL;
+    mask.n_colors = indexed ? meta->n_colors : 0;
+    mask.dst_rect.start_x = 0;
+    mask.dst_rect.start_y = 0;
+    mask.dst_rect.width = gst_overlay->width;
+    mask.dst_rect.height = gst_overlay->height;
+
+    g_array_append_val (state->masks, mask);
+    return TRUE;
+  }
+
+  if (meta->img_format == GST_VIDEO_FORMAT_GRAY8 && meta->palette) {
+    image_buffer = gst_overlay_expand_class_map (state, meta,
+        state->params[GST_OVERLAY_KIND_SIMG]->len, &image_size);
   } else {
-    ret = gst_overlay->overlay->GetOverlayParams (*item_id, ov_param);
-    if (ret != 0) {
-      GST_ERROR_OBJECT (gst_overlay, "Overlay get param failed! ret: %d", ret);
-      return FALSE;
-    }
+    // Pooled masks stay mapped for the lifetime of the meta, hand the
+    // mapping over directly. The blob API takes CPU pointers only.
+    image_buffer = meta->img_buffer;
+    image_size = meta->img_size;
+    GST_LOG_OBJECT (gst_overlay, "Segmentation mask %p fd %d", image_buffer,
+        gst_ml_segmentation_meta_get_fd (meta));
+  }
 
-    ov_param.dst_rect.start_x = 0;
-    ov_param.dst_rect.start_y = 0;
-    ov_param.dst_rect.width = gst_overlay->width;
-    ov_param.dst_rect.height = gst_overlay->height;
-    ov_param.image_info.source_rect.start_x = 0;
-    ov_param.image_info.source_rect.start_y = 0;
-    ov_param.image_info.source_rect.width = meta->img_width;
-    ov_param.image_info.source_rect.height = meta->img_height;
-    ov_param.image_info.image_buffer = (char *)meta->img_buffer;
-    ov_param.image_info.image_size = meta->img_size;
-    ov_param.image_info.buffer_updated = true;
-
-    ret = gst_overlay->overlay->UpdateOverlayParams (*item_id, ov_param);
-    if (ret != 0) {
-      GST_ERROR_OBJECT (gst_overlay, "Overlay set param failed! ret: %d", ret);
-      return FALSE;
-    }
+  memset (&ov_param, 0, sizeof (ov_param));
+  ov_param.type = OverlayType::kStaticImage;
+  ov_param.location = OverlayLocationType::kRandom;
+  ov_param.dst_rect.start_x = 0;
+  ov_param.dst_rect.start_y = 0;
+  ov_param.dst_rect.width = gst_overlay->width;
+  ov_param.dst_rect.height = gst_overlay->height;
+  ov_param.image_info.image_type = OverlayImageType::kBlobType;
+  ov_param.image_info.source_rect.start_x = 0;
+  ov_param.image_info.source_rect.start_y = 0;
+  ov_param.image_info.source_rect.width = meta->img_width;
+  ov_param.image_info.source_rect.height = meta->img_height;
+  ov_param.image_info.image_buffer = (char *)image_buffer;
+  ov_param.image_info.image_size = image_size;
+  ov_param.image_info.buffer_updated = true;
+
+  g_array_append_val (state->params[GST_OVERLAY_KIND_SIMG], ov_param);
+  return TRUE;
+}
+
+static gboolean
+gst_overlay_fill_text_param (GstOverlay *gst_overlay, const gchar *name,
+  OverlayParam * ov_param)
+{
+  memset (ov_param, 0, sizeof (*ov_param));
+  ov_param->type = OverlayType::kUserText;
+  ov_param->color = gst_overlay->text_color;
+  ov_param->location = OverlayLocationType::kTopLeft;
+
+  if (sizeof (ov_param->user_text) < strlen (name)) {
+    GST_ERROR_OBJECT (gst_overlay, "Text size exceeded %d < %d",
+      sizeof (ov_param->user_text), strlen (name));
+    return FALSE;
   }
+  g_strlcpy (ov_param->user_text, name, sizeof (ov_param->user_text));
+
   return TRUE;
 }
 
 static gboolean
 gst_overlay_apply_user_text_item (GstOverlay *gst_overlay, gchar *name,
-  uint32_t * item_id)
+  GstOverlayItem * item)
 {
   OverlayParam ov_param;
-  int32_t ret = 0;
 
   g_return_val_if_fail (gst_overlay != NULL, FALSE);
   g_return_val_if_fail (name != NULL, FALSE);
-  g_return_val_if_fail (item_id != NULL, FALSE);;
-
-  if (!(*item_id)) {
-    ov_param = {};
-    ov_param.type = OverlayType::kUserText;
-    ov_param.color = gst_overlay->text_color;
-    ov_param.location = OverlayLocationType::kTopLeft;
-
-    if (sizeof (ov_param.bounding_box.box_name) < strlen (name)) {
-      GST_ERROR_OBJECT (gst_overlay, "Text size exceeded %d < %d",
-        sizeof (ov_param.bounding_box.box_name), strlen (name));
-      return FALSE;
-    }
-    g_strlcpy (ov_param.user_text, name, sizeof (ov_param.user_text));
+  g_return_val_if_fail (item != NULL, FALSE);
 
-    ret = gst_overlay->overlay->CreateOverlayItem (ov_param, item_id);
-    if (ret != 0) {
-      GST_ERROR_OBJECT (gst_overlay, "Overlay create failed! ret: %d", ret);
-      return FALSE;
-    }
-
-    ret = gst_overlay->overlay->EnableOverlayItem (*item_id);
-    if (ret != 0) {
-      GST_ERROR_OBJECT (gst_overlay, "Overlay enable failed! ret: %d", ret);
-      return FALSE;
-    }
-  } else {
-    ret = gst_overlay->overlay->GetOverlayParams (*item_id, ov_param);
-    if (ret != 0) {
-      GST_ERROR_OBJECT (gst_overlay, "Overlay get param failed! ret: %d", ret);
-      return FALSE;
-    }
-
-    if (sizeof (ov_param.bounding_box.box_name) < strlen (name)) {
-      GST_ERROR_OBJECT (gst_overlay, "Text size exceeded %d < %d",
-        sizeof (ov_param.bounding_box.box_name), strlen (name));
-      return FALSE;
-    }
-    g_strlcpy (ov_param.user_text, name, sizeof (ov_param.user_text));
-
-    ret = gst_overlay->overlay->UpdateOverlayParams (*item_id, ov_param);
-    if (ret != 0) {
-      GST_ERROR_OBJECT (gst_overlay, "Overlay set param failed! ret: %d", ret);
-      return FALSE;
-    }
+  if (!gst_overlay_fill_text_param (gst_overlay, name, &ov_param)) {
+    return FALSE;
   }
-  return TRUE;
+
+  return gst_overlay_item_apply (gst_overlay, item, &ov_param, FALSE);
 }
 
 static gboolean
-gst_overlay_apply_text_item (GstOverlay *gst_overlay, gpointer metadata,
-  uint32_t * item_id)
+gst_overlay_prepare_text_item (GstOverlay *gst_overlay,
+  GstOverlayState * state, gpointer metadata)
 {
   OverlayParam ov_param;
-  int32_t ret = 0;
 
-  g_return_val_if_fail (item_id != NULL, FALSE);
+  g_return_val_if_fail (gst_overlay != NULL, FALSE);
   g_return_val_if_fail (metadata != NULL, FALSE);
-  g_return_val_if_fail (item_id != NULL, FALSE);
 
   GstMLClassificationMeta * meta = (GstMLClassificationMeta *) metadata;
 
-  return gst_overlay_apply_user_text_item (gst_overlay, meta->result.name,
-      item_id);
+  if (!gst_overlay_fill_text_param (gst_overlay, meta->result.name,
+      &ov_param)) {
+    return FALSE;
+  }
+
+  g_array_append_val (state->params[GST_OVERLAY_KIND_TEXT], ov_param);
+  return TRUE;
 }
 
 static gboolean
-gst_overlay_apply_pose_item (GstOverlay *gst_overlay, gpointer metadata,
-  uint32_t * item_id)
+gst_overlay_prepare_pose_item (GstOverlay *gst_overlay,
+  GstOverlayState * state, gpointer metadata)
 {
   OverlayParam ov_param;
-  int32_t ret = 0;
 
   g_return_val_if_fail (gst_overlay != NULL, FALSE);
   g_return_val_if_fail (metadata != NULL, FALSE);
-  g_return_val_if_fail (item_id != NULL, FALSE);
 
   GstMLPoseNetMeta * pose = (GstMLPoseNetMeta *) metadata;
 
   static float kScoreTreshold = 0.1;
 
-  if (!(*item_id)) {
-    ov_param = {};
-    ov_param.type = OverlayType::kGraph;
-    ov_param.color = gst_overlay->pose_color;
-  } else {
-    ret = gst_overlay->overlay->GetOverlayParams (*item_id, ov_param);
-    if (ret != 0) {
-      GST_ERROR_OBJECT (gst_overlay, "Overlay get param failed! ret: %d", ret);
-      return FALSE;
-    }
-  }
-
+  memset (&ov_param, 0, sizeof (ov_param));
+  ov_param.type = OverlayType::kGraph;
+  ov_param.color = gst_overlay->pose_color;
   ov_param.dst_rect.start_x = 0;
   ov_param.dst_rect.start_y = 0;
   ov_param.dst_rect.width = gst_overlay->width;
@@ -539,95 +685,307 @@ gst_overlay_apply_pose_item (GstOverlay *gst_overlay, gpointer metadata,
   }
   ov_param.graph.chain_count = count;
 
-  if (!(*item_id)) {
-    ret = gst_overlay->overlay->CreateOverlayItem (ov_param, item_id);
-    if (ret != 0) {
-      GST_ERROR_OBJECT (gst_overlay, "Overlay create failed! ret: %d", ret);
-      return FALSE;
-    }
+  g_array_append_val (state->params[GST_OVERLAY_KIND_POSE], ov_param);
+  return TRUE;
+}
 
-    ret = gst_overlay->overlay->EnableOverlayItem (*item_id);
-    if (ret != 0) {
-      GST_ERROR_OBJECT (gst_overlay, "Overlay enable failed! ret: %d", ret);
-      return FALSE;
-    }
-  } else {
-    ret = gst_overlay->overlay->UpdateOverlayParams (*item_id, ov_param);
-    if (ret != 0) {
-      GST_ERROR_OBJECT (gst_overlay, "Overlay set param failed! ret: %d", ret);
-      return FALSE;
-    }
+static void
+gst_overlay_state_init (GstOverlayState * state)
+{
+  state->frame = 0;
+  state->buffer = NULL;
+  for (guint i = 0; i < GST_OVERLAY_KIND_MAX; i++) {
+    state->params[i] = g_array_new (FALSE, FALSE, sizeof (OverlayParam));
   }
+  state->masks = g_array_new (FALSE, FALSE, sizeof (OverlayMask));
+  state->simg_rgba =
+      g_ptr_array_new_with_free_func ((GDestroyNotify) g_byte_array_unref);
+}
 
-  return TRUE;
+/* Drops the prepared parameters and the metadata they point into. The
+ * arrays and the RGBA buffers are kept for the next frame. */
+static void
+gst_overlay_state_reset (GstOverlayState * state)
+{
+  state->frame = 0;
+  if (state->buffer) {
+    gst_buffer_unref (state->buffer);
+    state->buffer = NULL;
+  }
+  for (guint i = 0; i < GST_OVERLAY_KIND_MAX; i++) {
+    g_array_set_size (state->params[i], 0);
+  }
+  g_array_set_size (state->masks, 0);
+}
+
+static void
+gst_overlay_state_free (GstOverlayState * state)
+{
+  gst_overlay_state_reset (state);
+  for (guint i = 0; i < GST_OVERLAY_KIND_MAX; i++) {
+    g_array_free (state->params[i], TRUE);
+  }
+  g_array_free (state->masks, TRUE);
+  g_ptr_array_free (state->simg_rgba, TRUE);
+  state->simg_rgba = NULL;
 }
 
+/* Converts the metadata of @buffer into overlay parameters. Only reads the
+ * metadata and the element settings, never the backend or the items, so
+ * it is safe to run on the worker thread. */
 static gboolean
-gst_overlay_apply_date_item (GstOverlay *vtrans,
-  OverlayTimeFormatType time_format, OverlayDateFormatType date_format,
-  uint32_t * item_id)
+gst_overlay_prepare_state (GstOverlay *gst_overlay, GstOverlayState * state,
+    GstBuffer * buffer)
 {
-  OverlayParam ov_param;
-  int32_t ret = 0;
+  gboolean res = TRUE;
 
-  g_return_val_if_fail (vtrans != NULL, FALSE);
-  g_return_val_if_fail (item_id != NULL, FALSE);
+  for (guint i = 0; i < GST_OVERLAY_KIND_MAX; i++) {
+    g_array_set_size (state->params[i], 0);
+  }
+  g_array_set_size (state->masks, 0);
 
+  res = gst_overlay_prepare_bbox_items (gst_overlay, state, buffer);
+  if (!res) {
+    GST_ERROR_OBJECT (gst_overlay, "Overlay prepare bbox item list failed!");
+    return FALSE;
+  }
 
-  if (!(*item_id)) {
-    ov_param = {};
-    ov_param.type = OverlayType::kDateType;
-    ov_param.location = OverlayLocationType::kBottomRight;
-    ov_param.color = vtrans->date_color;
-    ov_param.date_time.time_format = time_format;
-    ov_param.date_time.date_format = date_format;
+  res = gst_overlay_prepare_item_list (gst_overlay, state, buffer,
+                            GST_ML_SEGMENTATION_API_TYPE,
+                            gst_overlay_prepare_simg_item);
+  if (!res) {
+    GST_ERROR_OBJECT (gst_overlay, "Overlay prepare image item list failed!");
+    return FALSE;
+  }
 
-    ret = vtrans->overlay->CreateOverlayItem (ov_param, item_id);
-    if (ret != 0) {
-      GST_ERROR_OBJECT (vtrans, "Overlay create failed! ret: %d", ret);
-      return FALSE;
+  res = gst_overlay_prepare_item_list (gst_overlay, state, buffer,
+                            GST_ML_CLASSIFICATION_API_TYPE,
+                            gst_overlay_prepare_text_item);
+  if (!res) {
+    GST_ERROR_OBJECT (gst_overlay,
+        "Overlay prepare classification item list failed!");
+    return FALSE;
+  }
+
+  res = gst_overlay_prepare_item_list (gst_overlay, state, buffer,
+                            GST_ML_POSENET_API_TYPE,
+                            gst_overlay_prepare_pose_item);
+  if (!res) {
+    GST_ERROR_OBJECT (gst_overlay,
+        "Overlay prepare pose item list failed!");
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* Hands the prepared parameters to the overlay items. Runs on the streaming
+ * thread, the backends are not thread safe. */
+static gboolean
+gst_overlay_apply_state (GstOverlay *gst_overlay, GstOverlayState * state)
+{
+  for (guint kind = 0; kind < GST_OVERLAY_KIND_MAX; kind++) {
+    GSequence *items = gst_overlay->items[kind];
+    GSequenceIter *iter = g_sequence_get_begin_iter (items);
+    GArray *params = state->params[kind];
+
+    for (guint i = 0; i < params->len; i++) {
+      GstOverlayItem *item = gst_overlay_next_item (items, &iter);
+
+      // The image content changes every frame, even behind the same pointer.
+      if (!gst_overlay_item_apply (gst_overlay, item,
+          &g_array_index (params, OverlayParam, i),
+          kind == GST_OVERLAY_KIND_SIMG)) {
+        GST_ERROR_OBJECT (gst_overlay, "Overlay create failed!");
+        return FALSE;
+      }
     }
+    gst_overlay_release_items (gst_overlay, items, params->len);
+  }
 
-    ret = vtrans->overlay->EnableOverlayItem (*item_id);
-    if (ret != 0) {
-      GST_ERROR_OBJECT (vtrans, "Overlay enable failed! ret: %d", ret);
-      return FALSE;
+  return TRUE;
+}
+
+/* Prepares the states posted by the streaming thread into the back state.
+ * Newer metadata replaces metadata the worker did not get to yet. */
+static gpointer
+gst_overlay_worker_func (gpointer userdata)
+{
+  GstOverlay *gst_overlay = GST_OVERLAY (userdata);
+  GstOverlayState *state = NULL;
+  GstBuffer *buffer = NULL;
+  guint64 frame = 0;
+
+  g_mutex_lock (&gst_overlay->lock);
+  while (TRUE) {
+    while (!gst_overlay->stopping && !gst_overlay->pending) {
+      g_cond_wait (&gst_overlay->cond, &gst_overlay->lock);
     }
-  } else {
-    ret = vtrans->overlay->GetOverlayParams (*item_id, ov_param);
-    if (ret != 0) {
-      GST_ERROR_OBJECT (vtrans, "Overlay get param failed! ret: %d", ret);
-      return FALSE;
+    if (gst_overlay->stopping) {
+      break;
     }
 
-    ov_param.date_time.time_format = time_format;
-    ov_param.date_time.date_format = date_format;
+    buffer = gst_overlay->pending;
+    frame = gst_overlay->pending_frame;
+    gst_overlay->pending = NULL;
 
-    ret = vtrans->overlay->UpdateOverlayParams (*item_id, ov_param);
-    if (ret != 0) {
-      GST_ERROR_OBJECT (vtrans, "Overlay set param failed! ret: %d", ret);
-      return FALSE;
+    // Not swapped in while being prepared, the front one stays in use.
+    gst_overlay->back_ready = FALSE;
+    state = gst_overlay->back;
+    g_mutex_unlock (&gst_overlay->lock);
+
+    gst_overlay_state_reset (state);
+    state->buffer = buffer;
+
+    if (!gst_overlay_prepare_state (gst_overlay, state, buffer)) {
+      // Draw nothing rather than stall the streaming thread.
+      gst_overlay_state_reset (state);
+      state->buffer = NULL;
     }
+    state->frame = frame;
+
+    g_mutex_lock (&gst_overlay->lock);
+    gst_overlay->back_ready = TRUE;
+    g_cond_broadcast (&gst_overlay->cond);
+  }
+  g_mutex_unlock (&gst_overlay->lock);
+
+  return NULL;
+}
+
+/* Posts the metadata of @buffer to the worker and returns the newest state
+ * at most max_staleness frames behind it, waiting for the worker if the
+ * prepared states are older. Metadata is copied into an empty buffer, the
+ * frame itself is not held back. */
+static GstOverlayState *
+gst_overlay_acquire_state (GstOverlay *gst_overlay, GstBuffer * buffer)
+{
+  GstBuffer *carrier = gst_buffer_new ();
+  GstOverlayState *state = NULL;
+  guint64 frame = 0;
+
+  gst_buffer_copy_ml_meta (carrier, buffer);
+
+  g_mutex_lock (&gst_overlay->lock);
+  frame = ++gst_overlay->n_frames;
+
+  if (gst_overlay->pending) {
+    gst_buffer_unref (gst_overlay->pending);
+  }
+  gst_overlay->pending = carrier;
+  gst_overlay->pending_frame = frame;
+  g_cond_broadcast (&gst_overlay->cond);
+
+  while (!gst_overlay->stopping) {
+    state = gst_overlay->back_ready ? gst_overlay->back : gst_overlay->front;
+    if (state->frame != 0 &&
+        state->frame + gst_overlay->max_staleness >= frame) {
+      break;
+    }
+    g_cond_wait (&gst_overlay->cond, &gst_overlay->lock);
+  }
+
+  // The worker only writes the back state and only when it is not ready.
+  if (gst_overlay->back_ready) {
+    state = gst_overlay->front;
+    gst_overlay->front = gst_overlay->back;
+    gst_overlay->back = state;
+    gst_overlay->back_ready = FALSE;
   }
+  state = gst_overlay->front;
+  g_mutex_unlock (&gst_overlay->lock);
+
+  return state;
+}
+
+/* Drops prepared states and pending metadata, the worker must be stopped */
+static void
+gst_overlay_flush_states (GstOverlay *gst_overlay)
+{
+  gst_overlay_state_reset (&gst_overlay->states[0]);
+  gst_overlay_state_reset (&gst_overlay->states[1]);
+
+  if (gst_overlay->pending) {
+    gst_buffer_unref (gst_overlay->pending);
+    gst_overlay->pending = NULL;
+  }
+  gst_overlay->pending_frame = 0;
+  gst_overlay->back_ready = FALSE;
+  gst_overlay->n_frames = 0;
+}
+
+static gboolean
+gst_overlay_start_worker (GstOverlay *gst_overlay)
+{
+  GError *error = NULL;
+  gboolean async = FALSE;
+
+  GST_OBJECT_LOCK (gst_overlay);
+  async = gst_overlay->async;
+  GST_OBJECT_UNLOCK (gst_overlay);
+
+  if (!async || gst_overlay->worker) {
+    return TRUE;
+  }
+
+  gst_overlay_flush_states (gst_overlay);
+  gst_overlay->stopping = FALSE;
+
+  gst_overlay->worker = g_thread_try_new ("qtioverlay-worker",
+      gst_overlay_worker_func, gst_overlay, &error);
+  if (!gst_overlay->worker) {
+    GST_ERROR_OBJECT (gst_overlay, "Failed to create worker thread: %s",
+        error->message);
+    g_error_free (error);
+    return FALSE;
+  }
+
   return TRUE;
 }
 
+static void
+gst_overlay_stop_worker (GstOverlay *gst_overlay)
+{
+  if (!gst_overlay->worker) {
+    return;
+  }
+
+  g_mutex_lock (&gst_overlay->lock);
+  gst_overlay->stopping = TRUE;
+  g_cond_broadcast (&gst_overlay->cond);
+  g_mutex_unlock (&gst_overlay->lock);
+
+  g_thread_join (gst_overlay->worker);
+  gst_overlay->worker = NULL;
+
+  gst_overlay_flush_states (gst_overlay);
+}
 
 static gboolean
-gst_overlay_apply_overlay (GstOverlay *gst_overlay, GstVideoFrame *frame)
+gst_overlay_apply_date_item (GstOverlay *vtrans,
+  OverlayTimeFormatType time_format, OverlayDateFormatType date_format,
+  GstOverlayItem * item)
 {
-  int32_t ret;
-  GstMemory *memory = gst_buffer_peek_memory (frame->buffer, 0);
-  guint fd = gst_fd_memory_get_fd (memory);
+  OverlayParam ov_param;
+
+  g_return_val_if_fail (vtrans != NULL, FALSE);
+  g_return_val_if_fail (item != NULL, FALSE);
+
+  memset (&ov_param, 0, sizeof (ov_param));
+  ov_param.type = OverlayType::kDateType;
+  ov_param.location = OverlayLocationType::kBottomRight;
+  ov_param.color = vtrans->date_color;
+  ov_param.date_time.time_format = time_format;
+  ov_param.date_time.date_format = date_format;
+
+  return gst_overlay_item_apply (vtrans, item, &ov_param, FALSE);
+}
 
-  OverlayTargetBuffer overlay_buf;
-  overlay_buf.width     = GST_VIDEO_FRAME_WIDTH (frame);
-  overlay_buf.height    = GST_VIDEO_FRAME_HEIGHT (frame);
-  overlay_buf.ion_fd    = fd;
-  overlay_buf.frame_len = GST_VIDEO_FRAME_SIZE (frame);
-  overlay_buf.format    = gst_overlay->format;
 
-  ret = gst_overlay->overlay->ApplyOverlay (overlay_buf);
+static gboolean
+gst_overlay_apply_overlay (GstOverlay *gst_overlay, GstVideoFrame *frame)
+{
+  int32_t ret = gst_overlay->overlay->ApplyOverlay (frame);
   if (ret != 0) {
     GST_ERROR_OBJECT (gst_overlay, "Overlay apply failed!");
     return FALSE;
@@ -635,6 +993,43 @@ gst_overlay_apply_overlay (GstOverlay *gst_overlay, GstVideoFrame *frame)
   return TRUE;
 }
 
+static gboolean
+gst_overlay_blend_masks (GstOverlay *gst_overlay, GstVideoFrame *frame,
+    GArray *masks)
+{
+  int32_t ret = gst_overlay->overlay->BlendMasks (frame,
+      (const OverlayMask *) masks->data, masks->len);
+  if (ret != 0) {
+    GST_ERROR_OBJECT (gst_overlay, "Overlay blend masks failed!");
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/* Snapshots the backend statistics together with the time spent drawing
+ * the frame and the number of frames the drawn metadata lags behind. Taken
+ * on the streaming thread so that readers of the property never touch the
+ * backend. */
+static void
+gst_overlay_update_stats (GstOverlay *gst_overlay, GstClockTime elapsed,
+    guint64 lag)
+{
+  GstStructure *stats = gst_overlay->overlay->GetStats ();
+
+  if (!stats) {
+    stats = gst_structure_new_empty ("overlay-stats");
+  }
+  gst_structure_set (stats, "composite-time", G_TYPE_UINT64, elapsed,
+      "state-lag", G_TYPE_UINT64, lag, NULL);
+
+  GST_OBJECT_LOCK (gst_overlay);
+  if (gst_overlay->stats) {
+    gst_structure_free (gst_overlay->stats);
+  }
+  gst_overlay->stats = stats;
+  GST_OBJECT_UNLOCK (gst_overlay);
+}
+
 static GstCaps *
 gst_overlay_caps (void)
 {
@@ -666,33 +1061,30 @@ gst_overlay_finalize (GObject * object)
 {
   GstOverlay *gst_overlay = GST_OVERLAY (object);
 
-  if (gst_overlay->overlay) {
-    g_sequence_foreach (gst_overlay->bbox_id, gst_overlay_destroy_overlay_item,
-        gst_overlay);
-    g_sequence_free (gst_overlay->bbox_id);
+  gst_overlay_stop_worker (gst_overlay);
 
-    g_sequence_foreach (gst_overlay->simg_id, gst_overlay_destroy_overlay_item,
-        gst_overlay);
-    g_sequence_free (gst_overlay->simg_id);
+  if (gst_overlay->overlay) {
+    gst_overlay_destroy_items (gst_overlay);
 
-    g_sequence_foreach (gst_overlay->text_id, gst_overlay_destroy_overlay_item,
-        gst_overlay);
-    g_sequence_free (gst_overlay->text_id);
+    delete (gst_overlay->overlay);
+    gst_overlay->overlay = nullptr;
+  }
 
-    g_sequence_foreach (gst_overlay->pose_id, gst_overlay_destroy_overlay_item,
-        gst_overlay);
-    g_sequence_free (gst_overlay->pose_id);
+  for (guint i = 0; i < GST_OVERLAY_KIND_MAX; i++) {
+    g_sequence_free (gst_overlay->items[i]);
+  }
 
-    if (gst_overlay->user_text_id) {
-      gst_overlay_destroy_overlay_item(&gst_overlay->user_text_id, gst_overlay);
-    }
+  g_free (gst_overlay->user_text);
+  gst_overlay->user_text = NULL;
 
-    if (gst_overlay->date_id) {
-      gst_overlay_destroy_overlay_item(&gst_overlay->date_id, gst_overlay);
-    }
+  gst_overlay_state_free (&gst_overlay->states[0]);
+  gst_overlay_state_free (&gst_overlay->states[1]);
+  g_mutex_clear (&gst_overlay->lock);
+  g_cond_clear (&gst_overlay->cond);
 
-    delete (gst_overlay->overlay);
-    gst_overlay->overlay = nullptr;
+  if (gst_overlay->stats) {
+    gst_structure_free (gst_overlay->stats);
+    gst_overlay->stats = NULL;
   }
 
   G_OBJECT_CLASS (parent_class)->finalize (G_OBJECT (gst_overlay));
@@ -715,6 +1107,7 @@ gst_overlay_set_property (GObject * object, guint prop_id,
   GST_OBJECT_LOCK (gst_overlay);
   switch (prop_id) {
     case PROP_OVERLAY_TEXT:
+      g_free (gst_overlay->user_text);
       gst_overlay->user_text = g_strdup(g_value_get_string (value));
       break;
     case PROP_OVERLAY_DATE:
@@ -732,6 +1125,25 @@ gst_overlay_set_property (GObject * object, guint prop_id,
     case PROP_OVERLAY_POSE_COLOR:
       gst_overlay->pose_color = g_value_get_uint (value);
       break;
+    case PROP_OVERLAY_BACKEND:
+      gst_overlay->backend = (GstOverlayBackendType) g_value_get_enum (value);
+      // Only allowed while not streaming, the next caps recreate it.
+      if (gst_overlay->overlay) {
+        gst_overlay_destroy_items (gst_overlay);
+        delete (gst_overlay->overlay);
+        gst_overlay->overlay = nullptr;
+      }
+      if (gst_overlay->stats) {
+        gst_structure_free (gst_overlay->stats);
+        gst_overlay->stats = NULL;
+      }
+      break;
+    case PROP_OVERLAY_ASYNC:
+      gst_overlay->async = g_value_get_boolean (value);
+      break;
+    case PROP_OVERLAY_MAX_STALENESS:
+      gst_overlay->max_staleness = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -765,6 +1177,18 @@ gst_overlay_get_property (GObject * object, guint prop_id, GValue * value,
     case PROP_OVERLAY_POSE_COLOR:
       g_value_set_uint (value, gst_overlay->pose_color);
       break;
+    case PROP_OVERLAY_BACKEND:
+      g_value_set_enum (value, gst_overlay->backend);
+      break;
+    case PROP_OVERLAY_STATS:
+      gst_value_set_structure (value, gst_overlay->stats);
+      break;
+    case PROP_OVERLAY_ASYNC:
+      g_value_set_boolean (value, gst_overlay->async);
+      break;
+    case PROP_OVERLAY_MAX_STALENESS:
+      g_value_set_uint (value, gst_overlay->max_staleness);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -785,6 +1209,9 @@ gst_overlay_set_info (GstVideoFilter * filter, GstCaps * in,
 
   gst_base_transform_set_passthrough (GST_BASE_TRANSFORM (filter), FALSE);
 
+  // The worker reads the settings below, it is restarted once they change.
+  gst_overlay_stop_worker (gst_overlay);
+
   gst_overlay->width = GST_VIDEO_INFO_WIDTH (ininfo);
   gst_overlay->height = GST_VIDEO_INFO_HEIGHT (ininfo);
 
@@ -803,15 +1230,22 @@ gst_overlay_set_info (GstVideoFilter * filter, GstCaps * in,
 
   if (gst_overlay->overlay && gst_overlay->format == new_format) {
     GST_DEBUG_OBJECT (gst_overlay, "Overlay already initialized");
-    return TRUE;
+    return gst_overlay_start_worker (gst_overlay);
   }
 
+  // Items belong to the overlay instance, they are recreated on demand.
   if (gst_overlay->overlay) {
+    gst_overlay_destroy_items (gst_overlay);
     delete (gst_overlay->overlay);
   }
 
   gst_overlay->format = new_format;
-  gst_overlay->overlay = new Overlay();
+
+  if (gst_overlay->backend == GST_OVERLAY_BACKEND_CPU) {
+    gst_overlay->overlay = new CpuOverlayBackend();
+  } else {
+    gst_overlay->overlay = new QmmfOverlayBackend();
+  }
 
   int32_t ret = gst_overlay->overlay->Init (gst_overlay->format);
   if (ret != 0) {
@@ -821,6 +1255,24 @@ gst_overlay_set_info (GstVideoFilter * filter, GstCaps * in,
     gst_overlay->overlay = nullptr;
     return FALSE;
   }
+  gst_overlay->use_masks = gst_overlay->overlay->SupportsMasks ();
+
+  return gst_overlay_start_worker (gst_overlay);
+}
+
+static gboolean
+gst_overlay_start (GstBaseTransform * trans)
+{
+  return gst_overlay_start_worker (GST_OVERLAY (trans));
+}
+
+static gboolean
+gst_overlay_stop (GstBaseTransform * trans)
+{
+  GstOverlay *gst_overlay = GST_OVERLAY (trans);
+
+  gst_overlay_stop_worker (gst_overlay);
+  gst_overlay_flush_states (gst_overlay);
 
   return TRUE;
 }
@@ -829,6 +1281,8 @@ static GstFlowReturn
 gst_overlay_transform_frame_ip (GstVideoFilter *filter, GstVideoFrame *frame)
 {
   GstOverlay *gst_overlay = GST_OVERLAY_CAST (filter);
+  GstOverlayState *state = NULL;
+  GstClockTime start = GST_CLOCK_TIME_NONE;
   gboolean res = TRUE;
 
   GST_DEBUG_OBJECT (gst_overlay,
@@ -841,41 +1295,23 @@ gst_overlay_transform_frame_ip (GstVideoFilter *filter, GstVideoFrame *frame)
     return GST_FLOW_ERROR;
   }
 
-  res = gst_overlay_apply_item_list (gst_overlay,
-                            gst_buffer_get_detection_meta (frame->buffer),
-                            gst_overlay_apply_bbox_item,
-                            gst_overlay->bbox_id);
-  if (!res) {
-    GST_ERROR_OBJECT (gst_overlay, "Overlay apply bbox item list failed!");
-    return GST_FLOW_ERROR;
-  }
-
-  res = gst_overlay_apply_item_list (gst_overlay,
-                            gst_buffer_get_segmentation_meta (frame->buffer),
-                            gst_overlay_apply_simg_item,
-                            gst_overlay->simg_id);
-  if (!res) {
-    GST_ERROR_OBJECT (gst_overlay, "Overlay apply image item list failed!");
-    return GST_FLOW_ERROR;
-  }
+  if (gst_overlay->worker) {
+    state = gst_overlay_acquire_state (gst_overlay, frame->buffer);
+  } else {
+    state = gst_overlay->front;
+    gst_overlay_state_reset (state);
 
-  res = gst_overlay_apply_item_list (gst_overlay,
-                            gst_buffer_get_classification_meta (frame->buffer),
-                            gst_overlay_apply_text_item,
-                            gst_overlay->text_id);
-  if (!res) {
-    GST_ERROR_OBJECT (gst_overlay,
-        "Overlay apply classification item list failed!");
-    return GST_FLOW_ERROR;
+    res = gst_overlay_prepare_state (gst_overlay, state, frame->buffer);
+    if (!res) {
+      GST_ERROR_OBJECT (gst_overlay, "Overlay prepare state failed!");
+      return GST_FLOW_ERROR;
+    }
+    state->frame = ++gst_overlay->n_frames;
   }
 
-  res = gst_overlay_apply_item_list (gst_overlay,
-                            gst_buffer_get_posenet_meta (frame->buffer),
-                            gst_overlay_apply_pose_item,
-                            gst_overlay->pose_id);
+  res = gst_overlay_apply_state (gst_overlay, state);
   if (!res) {
-    GST_ERROR_OBJECT (gst_overlay,
-        "Overlay apply pose item list failed!");
+    GST_ERROR_OBJECT (gst_overlay, "Overlay apply state failed!");
     return GST_FLOW_ERROR;
   }
 
@@ -883,38 +1319,53 @@ gst_overlay_transform_frame_ip (GstVideoFilter *filter, GstVideoFrame *frame)
     res = gst_overlay_apply_date_item (gst_overlay,
                                        OverlayTimeFormatType::kHHMMSS_24HR,
                                        OverlayDateFormatType::kMMDDYYYY,
-                                       &gst_overlay->date_id);
+                                       &gst_overlay->date_item);
     if (!res) {
       GST_ERROR_OBJECT (gst_overlay, "Overlay apply date item failed!");
       return GST_FLOW_ERROR;
     }
-  } else if (gst_overlay->date_id) {
-    gst_overlay_destroy_overlay_item(&gst_overlay->date_id, gst_overlay);
+  } else {
+    gst_overlay_item_disable (gst_overlay, &gst_overlay->date_item);
   }
 
-  if (gst_overlay->user_text) {
+  if (gst_overlay->user_text && gst_overlay->user_text[0] != '\0') {
     res = gst_overlay_apply_user_text_item(gst_overlay,
                                            gst_overlay->user_text,
-                                           &gst_overlay->user_text_id);
+                                           &gst_overlay->user_text_item);
     if (!res) {
       GST_ERROR_OBJECT (gst_overlay, "Overlay apply user text item failed!");
       return GST_FLOW_ERROR;
     }
-  }  else if (gst_overlay->user_text_id) {
-    gst_overlay_destroy_overlay_item(&gst_overlay->user_text_id, gst_overlay);
+  } else {
+    gst_overlay_item_disable (gst_overlay, &gst_overlay->user_text_item);
+  }
+
+  // Nothing to draw, leave the frame untouched.
+  if (gst_overlay->n_enabled == 0 && state->masks->len == 0) {
+    return GST_FLOW_OK;
   }
 
-  if (!g_sequence_is_empty (gst_overlay->bbox_id) ||
-      !g_sequence_is_empty (gst_overlay->simg_id) ||
-      !g_sequence_is_empty (gst_overlay->text_id) ||
-      !g_sequence_is_empty (gst_overlay->pose_id) ||
-      gst_overlay->user_text_id || gst_overlay->date_id) {
-    res = gst_overlay_apply_overlay (gst_overlay, frame);
+  start = gst_util_get_timestamp ();
+
+  if (state->masks->len > 0) {
+    res = gst_overlay_blend_masks (gst_overlay, frame, state->masks);
     if (!res) {
-      GST_ERROR_OBJECT (gst_overlay, "Overlay apply failed!");
+      GST_ERROR_OBJECT (gst_overlay, "Overlay blend masks failed!");
       return GST_FLOW_ERROR;
     }
   }
+
+  // Also called for masks only, so backends can close the frame.
+  res = gst_overlay_apply_overlay (gst_overlay, frame);
+  if (!res) {
+    GST_ERROR_OBJECT (gst_overlay, "Overlay apply failed!");
+    return GST_FLOW_ERROR;
+  }
+
+  gst_overlay_update_stats (gst_overlay,
+      GST_CLOCK_DIFF (start, gst_util_get_timestamp ()),
+      state->frame ? gst_overlay->n_frames - state->frame : 0);
+
   return GST_FLOW_OK;
 }
 
@@ -923,6 +1374,7 @@ gst_overlay_class_init (GstOverlayClass * klass)
 {
   GObjectClass *gobject            = G_OBJECT_CLASS (klass);
   GstElementClass *element         = GST_ELEMENT_CLASS (klass);
+  GstBaseTransformClass *trans     = GST_BASE_TRANSFORM_CLASS (klass);
   GstVideoFilterClass *filter      = GST_VIDEO_FILTER_CLASS (klass);
 
   gobject->set_property = GST_DEBUG_FUNCPTR (gst_overlay_set_property);
@@ -961,12 +1413,46 @@ gst_overlay_class_init (GstOverlayClass * klass)
       0, G_MAXUINT, DEFAULT_PROP_OVERLAY_POSE_COLOR, static_cast<GParamFlags>(
         G_PARAM_CONSTRUCT | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
 
+  g_object_class_install_property (gobject, PROP_OVERLAY_BACKEND,
+    g_param_spec_enum ("backend", "Backend",
+      "Renderer drawing the overlay items", gst_overlay_backend_get_type (),
+      DEFAULT_PROP_OVERLAY_BACKEND, static_cast<GParamFlags>(
+        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY)));
+
+  g_object_class_install_property (gobject, PROP_OVERLAY_STATS,
+    g_param_spec_boxed ("stats", "Statistics",
+      "Statistics of the last drawn frame: composite-time in nanoseconds "
+      "and backend specific fields, such as the dirty-area and overlay-area "
+      "in pixels and text cache hits and misses of the CPU backend",
+      GST_TYPE_STRUCTURE,
+      static_cast<GParamFlags>(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject, PROP_OVERLAY_ASYNC,
+    g_param_spec_boolean ("async", "Asynchronous preparation",
+      "Convert the metadata into overlay items on a worker thread, the "
+      "streaming thread only draws the latest prepared items",
+      DEFAULT_PROP_OVERLAY_ASYNC, static_cast<GParamFlags>(
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY)));
+
+  g_object_class_install_property (gobject, PROP_OVERLAY_MAX_STALENESS,
+    g_param_spec_uint ("max-staleness", "Max staleness",
+      "Maximum number of frames the drawn metadata may lag behind the frame "
+      "in async mode, the streaming thread waits for the worker beyond it",
+      0, G_MAXUINT, DEFAULT_PROP_OVERLAY_MAX_STALENESS,
+      static_cast<GParamFlags>(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY)));
+
   gst_element_class_set_static_metadata (element, "QTI Overlay", "Overlay",
       "Apply image, bounding boxes and text overlay.", "QTI");
 
   gst_element_class_add_pad_template (element, gst_overlay_sink_template ());
   gst_element_class_add_pad_template (element, gst_overlay_src_template ());
 
+  trans->start = GST_DEBUG_FUNCPTR (gst_overlay_start);
+  trans->stop = GST_DEBUG_FUNCPTR (gst_overlay_stop);
+
   filter->set_info = GST_DEBUG_FUNCPTR (gst_overlay_set_info);
   filter->transform_frame_ip =
       GST_DEBUG_FUNCPTR (gst_overlay_transform_frame_ip);
@@ -977,19 +1463,38 @@ gst_overlay_init (GstOverlay * gst_overlay)
 {
   gst_overlay->overlay = nullptr;
 
-  gst_overlay->bbox_id = g_sequence_new (free);
-  gst_overlay->simg_id = g_sequence_new (free);
-  gst_overlay->text_id = g_sequence_new (free);
-  gst_overlay->pose_id = g_sequence_new (free);
-
-  gst_overlay->user_text_id = 0;
-  gst_overlay->date_id = 0;
+  for (guint i = 0; i < GST_OVERLAY_KIND_MAX; i++) {
+    gst_overlay->items[i] = g_sequence_new (g_free);
+  }
+  gst_overlay->stats = NULL;
+
+  gst_overlay_state_init (&gst_overlay->states[0]);
+  gst_overlay_state_init (&gst_overlay->states[1]);
+  gst_overlay->front = &gst_overlay->states[0];
+  gst_overlay->back = &gst_overlay->states[1];
+  gst_overlay->n_frames = 0;
+
+  gst_overlay->worker = NULL;
+  g_mutex_init (&gst_overlay->lock);
+  g_cond_init (&gst_overlay->cond);
+  gst_overlay->stopping = FALSE;
+  gst_overlay->pending = NULL;
+  gst_overlay->pending_frame = 0;
+  gst_overlay->back_ready = FALSE;
+
+  memset (&gst_overlay->user_text_item, 0, sizeof (GstOverlayItem));
+  memset (&gst_overlay->date_item, 0, sizeof (GstOverlayItem));
+  gst_overlay->n_enabled = 0;
   gst_overlay->user_text = NULL;
   gst_overlay->date_overlay = DEFAULT_PROP_OVERLAY_DATE;
   gst_overlay->bbox_color = DEFAULT_PROP_OVERLAY_BBOX_COLOR;
   gst_overlay->date_color = DEFAULT_PROP_OVERLAY_DATE_COLOR;
   gst_overlay->text_color = DEFAULT_PROP_OVERLAY_TEXT_COLOR;
   gst_overlay->pose_color = DEFAULT_PROP_OVERLAY_POSE_COLOR;
+  gst_overlay->backend = DEFAULT_PROP_OVERLAY_BACKEND;
+  gst_overlay->use_masks = FALSE;
+  gst_overlay->async = DEFAULT_PROP_OVERLAY_ASYNC;
+  gst_overlay->max_staleness = DEFAULT_PROP_OVERLAY_MAX_STALENESS;
 
   GST_DEBUG_CATEGORY_INIT (overlay_debug, "qtioverlay", 0, "QTI overlay");
 }
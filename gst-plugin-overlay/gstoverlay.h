@@ -34,9 +34,8 @@
 #include <gst/gst.h>
 #include <gst/video/video.h>
 #include <gst/video/gstvideofilter.h>
-#include <qmmf-sdk/qmmf_overlay.h>
 
-using namespace qmmf::overlay;
+#include "overlay_backend.h"
 
 G_BEGIN_DECLS
 
@@ -52,22 +51,71 @@ G_BEGIN_DECLS
   (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_OVERLAY))
 #define GST_OVERLAY_CAST(obj)       ((GstOverlay *)(obj))
 
+typedef enum {
+  GST_OVERLAY_BACKEND_QMMF,
+  GST_OVERLAY_BACKEND_CPU,
+} GstOverlayBackendType;
+
+/* Kinds of metadata driven overlay items, each with its own item list */
+typedef enum {
+  GST_OVERLAY_KIND_BBOX,
+  GST_OVERLAY_KIND_SIMG,
+  GST_OVERLAY_KIND_TEXT,
+  GST_OVERLAY_KIND_POSE,
+  GST_OVERLAY_KIND_MAX,
+} GstOverlayKind;
+
 typedef struct _GstOverlay GstOverlay;
 typedef struct _GstOverlayClass GstOverlayClass;
+typedef struct _GstOverlayItem GstOverlayItem;
+typedef struct _GstOverlayState GstOverlayState;
+
+/* Overlay library item kept alive across frames. Unused items are only
+ * disabled and deleted after staying idle for a while. The parameters last
+ * handed to the library are cached so unchanged items are not updated. */
+struct _GstOverlayItem {
+  uint32_t            id;
+  gboolean            enabled;
+  guint               idle;
+  OverlayParam        param;
+};
+
+/* Overlay parameters prepared from the metadata of one frame, applied to
+ * the items afterwards. Parameters may point into the metadata of @buffer
+ * or into @simg_rgba, both stay valid until the state is prepared again. */
+struct _GstOverlayState {
+  /* Frame number the metadata comes from, 0 when empty */
+  guint64             frame;
+  /* Metadata copy when prepared asynchronously */
+  GstBuffer           *buffer;
+
+  /* OverlayParam entries for each GstOverlayKind */
+  GArray              *params[GST_OVERLAY_KIND_MAX];
+  /* OverlayMask entries, for backends blending segmentation masks */
+  GArray              *masks;
+
+  /* GByteArray RGBA expansions of segmentation class maps, one for each
+   * image item since the library reads all of them when applied */
+  GPtrArray           *simg_rgba;
+};
 
 struct _GstOverlay {
   GstVideoFilter      parent;
-  Overlay             *overlay;
+  OverlayBackend      *overlay;
   TargetBufferFormat  format;
-  GSequence           *bbox_id;
-  GSequence           *simg_id;
-  GSequence           *text_id;
-  GSequence           *pose_id;
-  guint               user_text_id;
+  GstOverlayBackendType backend;
+  /* GstOverlayItem lists for each GstOverlayKind */
+  GSequence           *items[GST_OVERLAY_KIND_MAX];
+  GstOverlayItem      user_text_item;
   gchar               *user_text;
-  guint               date_id;
+  GstOverlayItem      date_item;
   gboolean            date_overlay;
 
+  /* Number of enabled items, nothing is applied when there are none */
+  guint               n_enabled;
+  /* Backend blends segmentation masks itself */
+  gboolean            use_masks;
+
   guint               bbox_color;
   guint               date_color;
   guint               text_color;
@@ -75,6 +123,32 @@ struct _GstOverlay {
 
   guint               width;
   guint               height;
+
+  /* Double buffered states. The streaming thread applies the front one,
+   * the back one is prepared either in place or by the worker thread. */
+  GstOverlayState     states[2];
+  GstOverlayState     *front;
+  GstOverlayState     *back;
+  guint64             n_frames;
+
+  /* Prepare states on a worker thread, at most max_staleness frames
+   * behind the frame they are drawn on */
+  gboolean            async;
+  guint               max_staleness;
+
+  /* Worker thread, the fields below are protected by lock */
+  GThread             *worker;
+  GMutex              lock;
+  GCond               cond;
+  gboolean            stopping;
+  /* Metadata copy waiting for the worker and its frame number */
+  GstBuffer           *pending;
+  guint64             pending_frame;
+  /* Back state holds a prepared frame not yet swapped in */
+  gboolean            back_ready;
+
+  /* Backend statistics taken after the last applied frame */
+  GstStructure        *stats;
 };
 
 struct _GstOverlayClass {
@@ -0,0 +1,602 @@
+/*
+* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "overlay_backend.h"
+
+#include <string.h>
+#include <time.h>
+#include <gst/allocators/gstfdmemory.h>
+
+/* Reference height for the size of lines and text drawn on the CPU */
+#define CPU_OVERLAY_REFERENCE_HEIGHT  360
+/* Label text colors, picked by the brightness of the box color */
+#define CPU_OVERLAY_LABEL_TEXT_DARK   0x000000FF
+#define CPU_OVERLAY_LABEL_TEXT_LIGHT  0xFFFFFFFF
+/* Number of rasterized text runs kept between frames */
+#define CPU_OVERLAY_TEXT_CACHE_SIZE   256
+/* Granularity of the dirty region statistics */
+#define CPU_OVERLAY_TILE_SIZE         64
+
+QmmfOverlayBackend::QmmfOverlayBackend ()
+    : overlay_ (new Overlay ()),
+      format_ (TargetBufferFormat::kYUVNV12)
+{
+}
+
+QmmfOverlayBackend::~QmmfOverlayBackend ()
+{
+  delete overlay_;
+}
+
+int32_t
+QmmfOverlayBackend::Init (TargetBufferFormat format)
+{
+  format_ = format;
+  return overlay_->Init (format);
+}
+
+int32_t
+QmmfOverlayBackend::CreateOverlayItem (OverlayParam & param,
+    uint32_t * item_id)
+{
+  return overlay_->CreateOverlayItem (param, item_id);
+}
+
+int32_t
+QmmfOverlayBackend::DeleteOverlayItem (uint32_t item_id)
+{
+  return overlay_->DeleteOverlayItem (item_id);
+}
+
+int32_t
+QmmfOverlayBackend::EnableOverlayItem (uint32_t item_id)
+{
+  return overlay_->EnableOverlayItem (item_id);
+}
+
+int32_t
+QmmfOverlayBackend::DisableOverlayItem (uint32_t item_id)
+{
+  return overlay_->DisableOverlayItem (item_id);
+}
+
+int32_t
+QmmfOverlayBackend::UpdateOverlayParams (uint32_t item_id,
+    OverlayParam & param)
+{
+  return overlay_->UpdateOverlayParams (item_id, param);
+}
+
+int32_t
+QmmfOverlayBackend::ApplyOverlay (GstVideoFrame * frame)
+{
+  GstMemory *memory = gst_buffer_peek_memory (frame->buffer, 0);
+
+  if (!gst_is_fd_memory (memory)) {
+    return -1;
+  }
+
+  OverlayTargetBuffer overlay_buf;
+  overlay_buf.width     = GST_VIDEO_FRAME_WIDTH (frame);
+  overlay_buf.height    = GST_VIDEO_FRAME_HEIGHT (frame);
+  overlay_buf.ion_fd    = gst_fd_memory_get_fd (memory);
+  overlay_buf.frame_len = GST_VIDEO_FRAME_SIZE (frame);
+  overlay_buf.format    = format_;
+
+  return overlay_->ApplyOverlay (overlay_buf);
+}
+
+CpuOverlayBackend::CpuOverlayBackend ()
+    : text_cache_ (CPU_OVERLAY_TEXT_CACHE_SIZE),
+      next_id_ (0),
+      format_ (TargetBufferFormat::kYUVNV12),
+      width_ (0),
+      height_ (0),
+      dirty_area_ (0),
+      overlay_area_ (0),
+      layer_updates_ (0)
+{
+}
+
+CpuOverlayBackend::~CpuOverlayBackend ()
+{
+  for (auto & it : items_) {
+    cpu_overlay_layer_free (it.second.layer);
+  }
+}
+
+int32_t
+CpuOverlayBackend::Init (TargetBufferFormat format)
+{
+  if (format != TargetBufferFormat::kYUVNV12 &&
+      format != TargetBufferFormat::kYUVNV21) {
+    return -1;
+  }
+
+  format_ = format;
+  return 0;
+}
+
+int32_t
+CpuOverlayBackend::CreateOverlayItem (OverlayParam & param,
+    uint32_t * item_id)
+{
+  // Zero is reserved for items that do not exist.
+  if (++next_id_ == 0) {
+    next_id_++;
+  }
+
+  Item & item = items_[next_id_];
+  memcpy (&item.param, &param, sizeof (OverlayParam));
+  item.enabled = false;
+  item.layer = NULL;
+  item.dirty = true;
+  item.layer_y = 0;
+  item.drawn = false;
+
+  *item_id = next_id_;
+  return 0;
+}
+
+int32_t
+CpuOverlayBackend::DeleteOverlayItem (uint32_t item_id)
+{
+  auto it = items_.find (item_id);
+
+  if (it == items_.end ()) {
+    return -1;
+  }
+
+  Untrack (it->second);
+  cpu_overlay_layer_free (it->second.layer);
+  items_.erase (it);
+
+  return 0;
+}
+
+int32_t
+CpuOverlayBackend::EnableOverlayItem (uint32_t item_id)
+{
+  auto it = items_.find (item_id);
+
+  if (it == items_.end ()) {
+    return -1;
+  }
+
+  it->second.enabled = true;
+  return 0;
+}
+
+int32_t
+CpuOverlayBackend::DisableOverlayItem (uint32_t item_id)
+{
+  auto it = items_.find (item_id);
+
+  if (it == items_.end ()) {
+    return -1;
+  }
+
+  it->second.enabled = false;
+  Untrack (it->second);
+
+  return 0;
+}
+
+int32_t
+CpuOverlayBackend::UpdateOverlayParams (uint32_t item_id,
+    OverlayParam & param)
+{
+  auto it = items_.find (item_id);
+
+  if (it == items_.end ()) {
+    return -1;
+  }
+
+  memcpy (&it->second.param, &param, sizeof (OverlayParam));
+  it->second.dirty = true;
+
+  return 0;
+}
+
+void
+CpuOverlayBackend::Track (Item & item, const OverlayRect & bounds,
+    bool changed)
+{
+  if (changed || !item.drawn ||
+      memcmp (&item.bounds, &bounds, sizeof (OverlayRect)) != 0) {
+    if (item.drawn) {
+      damage_.push_back (item.bounds);
+    }
+    damage_.push_back (bounds);
+  }
+
+  item.bounds = bounds;
+  item.drawn = true;
+  item.dirty = false;
+  drawn_.push_back (bounds);
+}
+
+void
+CpuOverlayBackend::Untrack (Item & item)
+{
+  if (item.drawn) {
+    damage_.push_back (item.bounds);
+  }
+  item.drawn = false;
+}
+
+uint32_t
+CpuOverlayBackend::CountTiles (const std::vector<OverlayRect> & rects)
+{
+  uint32_t columns = (width_ + CPU_OVERLAY_TILE_SIZE - 1) /
+      CPU_OVERLAY_TILE_SIZE;
+  uint32_t rows = (height_ + CPU_OVERLAY_TILE_SIZE - 1) /
+      CPU_OVERLAY_TILE_SIZE;
+  uint32_t area = 0, column = 0, row = 0;
+
+  tiles_.assign (columns * rows, 0);
+
+  for (auto & rect : rects) {
+    int32_t x0 = MAX (rect.start_x, 0), y0 = MAX (rect.start_y, 0);
+    int32_t x1 = MIN (rect.start_x + (int32_t) rect.width, width_);
+    int32_t y1 = MIN (rect.start_y + (int32_t) rect.height, height_);
+
+    if (x0 >= x1 || y0 >= y1) {
+      continue;
+    }
+
+    for (row = y0 / CPU_OVERLAY_TILE_SIZE;
+         row <= (uint32_t) (y1 - 1) / CPU_OVERLAY_TILE_SIZE; row++) {
+      for (column = x0 / CPU_OVERLAY_TILE_SIZE;
+           column <= (uint32_t) (x1 - 1) / CPU_OVERLAY_TILE_SIZE; column++) {
+        tiles_[row * columns + column] = 1;
+      }
+    }
+  }
+
+  // Tiles on the right and bottom edges may be cut by the frame.
+  for (row = 0; row < rows; row++) {
+    for (column = 0; column < columns; column++) {
+      if (tiles_[row * columns + column]) {
+        area += MIN (CPU_OVERLAY_TILE_SIZE,
+            width_ - column * CPU_OVERLAY_TILE_SIZE) *
+            MIN (CPU_OVERLAY_TILE_SIZE, height_ - row * CPU_OVERLAY_TILE_SIZE);
+      }
+    }
+  }
+
+  return area;
+}
+
+static int32_t
+cpu_overlay_build_bbox (CpuOverlayLayer * layer, OverlayTextCache * cache,
+    const OverlayParam & param, int32_t thickness, int32_t scale)
+{
+  const CpuOverlayText *label = NULL;
+  const OverlayRect & rect = param.dst_rect;
+  int32_t height = CPU_OVERLAY_CELL_HEIGHT * scale;
+  int32_t y = 0, width = 0, ret = 0;
+  uint32_t luma = (66 * ((param.color >> 24) & 0xFF) +
+      129 * ((param.color >> 16) & 0xFF) +
+      25 * ((param.color >> 8) & 0xFF)) >> 8;
+
+  ret = cpu_overlay_layer_draw_rect (layer, rect.start_x, rect.start_y,
+      rect.width, rect.height, thickness, param.color);
+
+  if (ret != 0 || param.bounding_box.box_name[0] == '\0') {
+    return ret;
+  }
+
+  label = cache->Get (param.bounding_box.box_name, scale, (luma > 128) ?
+      CPU_OVERLAY_LABEL_TEXT_DARK : CPU_OVERLAY_LABEL_TEXT_LIGHT);
+  if (label == NULL) {
+    return -1;
+  }
+
+  // Label sits on top of the box, or inside when the box touches the top.
+  y = rect.start_y - height;
+  if (y < 0) {
+    y = rect.start_y;
+  }
+
+  cpu_overlay_text_get_size (label, &width, NULL);
+  ret = cpu_overlay_layer_fill_rect (layer, rect.start_x, y,
+      width + 2 * scale, height, param.color);
+  if (ret != 0) {
+    return ret;
+  }
+
+  return cpu_overlay_layer_draw_text_run (layer, rect.start_x + scale,
+      y + scale, label);
+}
+
+static void
+cpu_overlay_draw_graph (CpuOverlayFrame * target, const OverlayParam & param,
+    int32_t thickness)
+{
+  int32_t x = param.dst_rect.start_x, y = param.dst_rect.start_y;
+  uint32_t i = 0;
+
+  for (i = 0; i < (uint32_t) param.graph.chain_count; i++) {
+    uint32_t from = param.graph.chain[i][0];
+    uint32_t to = param.graph.chain[i][1];
+
+    if (from >= (uint32_t) param.graph.points_count ||
+        to >= (uint32_t) param.graph.points_count) {
+      continue;
+    }
+
+    cpu_overlay_draw_line (target,
+        x + param.graph.points[from].x, y + param.graph.points[from].y,
+        x + param.graph.points[to].x, y + param.graph.points[to].y,
+        thickness, param.color);
+  }
+
+  for (i = 0; i < (uint32_t) param.graph.points_count; i++) {
+    cpu_overlay_fill_rect (target, x + param.graph.points[i].x - thickness,
+        y + param.graph.points[i].y - thickness, 2 * thickness,
+        2 * thickness, param.color);
+  }
+}
+
+static bool
+cpu_overlay_format_date (const OverlayParam & param, gchar * text,
+    size_t size)
+{
+  const gchar *format = NULL;
+  struct tm local;
+  time_t now = time (NULL);
+
+  if (param.date_time.date_format == OverlayDateFormatType::kMMDDYYYY) {
+    format = (param.date_time.time_format ==
+        OverlayTimeFormatType::kHHMMSS_24HR) ? "%m/%d/%Y %H:%M:%S" :
+        "%m/%d/%Y %I:%M:%S %p";
+  } else {
+    format = (param.date_time.time_format ==
+        OverlayTimeFormatType::kHHMMSS_24HR) ? "%Y/%m/%d %H:%M:%S" :
+        "%Y/%m/%d %I:%M:%S %p";
+  }
+
+  return localtime_r (&now, &local) != NULL &&
+      strftime (text, size, format, &local) != 0;
+}
+
+static bool
+cpu_overlay_map_frame (GstVideoFrame * frame, CpuOverlayFrame * target)
+{
+  if (GST_VIDEO_FRAME_N_PLANES (frame) != 2) {
+    return false;
+  }
+
+  target->luma = (uint8_t *) GST_VIDEO_FRAME_PLANE_DATA (frame, 0);
+  target->chroma = (uint8_t *) GST_VIDEO_FRAME_PLANE_DATA (frame, 1);
+  target->width = GST_VIDEO_FRAME_WIDTH (frame);
+  target->height = GST_VIDEO_FRAME_HEIGHT (frame);
+  target->luma_stride = GST_VIDEO_FRAME_PLANE_STRIDE (frame, 0);
+  target->chroma_stride = GST_VIDEO_FRAME_PLANE_STRIDE (frame, 1);
+  target->swap_uv =
+      (GST_VIDEO_FRAME_FORMAT (frame) == GST_VIDEO_FORMAT_NV21);
+
+  return true;
+}
+
+int32_t
+CpuOverlayBackend::BlendMasks (GstVideoFrame * frame,
+    const OverlayMask * masks, uint32_t n_masks)
+{
+  CpuOverlayFrame target;
+  uint32_t i = 0;
+
+  if (!cpu_overlay_map_frame (frame, &target)) {
+    return -1;
+  }
+
+  for (i = 0; i < n_masks; i++) {
+    const OverlayMask & mask = masks[i];
+
+    if (mask.palette != NULL) {
+      cpu_overlay_blend_mask (&target, mask.dst_rect.start_x,
+          mask.dst_rect.start_y, mask.dst_rect.width, mask.dst_rect.height,
+          mask.data, mask.width, mask.height, mask.stride, mask.palette,
+          mask.n_colors);
+    } else {
+      cpu_overlay_blend_image (&target, mask.dst_rect.start_x,
+          mask.dst_rect.start_y, mask.dst_rect.width, mask.dst_rect.height,
+          mask.data, mask.width, mask.height, mask.stride);
+    }
+
+    // Every mask is a new inference result.
+    damage_.push_back (mask.dst_rect);
+    drawn_.push_back (mask.dst_rect);
+  }
+
+  return 0;
+}
+
+int32_t
+CpuOverlayBackend::ApplyOverlay (GstVideoFrame * frame)
+{
+  CpuOverlayFrame target;
+  const CpuOverlayText *run = NULL;
+  OverlayRect bounds;
+  gchar date[64];
+  int32_t scale = 0, thickness = 0, margin = 0, text_y = 0;
+  int32_t x = 0, y = 0, width = 0, height = 0;
+  bool changed = false;
+
+  if (!cpu_overlay_map_frame (frame, &target)) {
+    return -1;
+  }
+
+  // Layers are built for one resolution, rebuild all of them on change.
+  if (target.width != width_ || target.height != height_) {
+    for (auto & it : items_) {
+      it.second.dirty = true;
+      it.second.drawn = false;
+    }
+    width_ = target.width;
+    height_ = target.height;
+  }
+
+  // Lines and text keep the same proportion whatever the resolution.
+  scale = MAX (target.height / CPU_OVERLAY_REFERENCE_HEIGHT, 1);
+  thickness = 2 * scale;
+  margin = 4 * scale;
+  text_y = margin;
+  layer_updates_ = 0;
+
+  // Images such as segmentation masks go below everything else.
+  for (auto & it : items_) {
+    Item & item = it.second;
+    const OverlayParam & param = item.param;
+
+    if (!item.enabled || param.type != OverlayType::kStaticImage ||
+        param.image_info.image_type != OverlayImageType::kBlobType) {
+      continue;
+    }
+
+    cpu_overlay_blend_image (&target, param.dst_rect.start_x,
+        param.dst_rect.start_y, param.dst_rect.width, param.dst_rect.height,
+        (const uint8_t *) param.image_info.image_buffer,
+        param.image_info.source_rect.width,
+        param.image_info.source_rect.height,
+        param.image_info.source_rect.width * 4);
+    Track (item, param.dst_rect, item.dirty);
+  }
+
+  // Boxes, texts and the date are drawn from layers that are only rebuilt
+  // when their item changes. Poses move every frame and are drawn directly.
+  for (auto & it : items_) {
+    Item & item = it.second;
+    const OverlayParam & param = item.param;
+
+    if (!item.enabled) {
+      continue;
+    }
+
+    changed = item.dirty;
+
+    switch (param.type) {
+      case OverlayType::kBoundingBox:
+        break;
+      case OverlayType::kUserText:
+        // User texts are stacked from the top left corner down.
+        changed |= (item.layer_y != text_y);
+        break;
+      case OverlayType::kDateType:
+        if (!cpu_overlay_format_date (param, date, sizeof (date))) {
+          continue;
+        }
+        changed |= (item.text != date);
+        break;
+      case OverlayType::kGraph:
+        cpu_overlay_draw_graph (&target, param, thickness);
+        Track (item, param.dst_rect, changed);
+        continue;
+      default:
+        continue;
+    }
+
+    if (item.layer == NULL) {
+      item.layer = cpu_overlay_layer_new ();
+      if (item.layer == NULL) {
+        return -1;
+      }
+    }
+
+    if (changed) {
+      int32_t ret = 0;
+
+      cpu_overlay_layer_clear (item.layer);
+
+      if (param.type == OverlayType::kBoundingBox) {
+        ret = cpu_overlay_build_bbox (item.layer, &text_cache_, param,
+            thickness, scale);
+      } else if (param.type == OverlayType::kUserText) {
+        run = text_cache_.Get (param.user_text, scale, param.color);
+        ret = (run != NULL) ? cpu_overlay_layer_draw_text_run (item.layer,
+            margin, text_y, run) : -1;
+        item.layer_y = text_y;
+      } else {
+        // The date sits in the bottom right corner.
+        run = text_cache_.Get (date, scale, param.color);
+        if (run != NULL) {
+          cpu_overlay_text_get_size (run, &width, &height);
+          ret = cpu_overlay_layer_draw_text_run (item.layer,
+              target.width - width - margin,
+              target.height - height - margin, run);
+        } else {
+          ret = -1;
+        }
+        item.text = date;
+      }
+
+      if (ret != 0) {
+        return -1;
+      }
+      layer_updates_++;
+    }
+
+    if (param.type == OverlayType::kUserText) {
+      text_y += CPU_OVERLAY_CELL_HEIGHT * scale + margin;
+    }
+
+    cpu_overlay_draw_layer (&target, item.layer);
+
+    cpu_overlay_layer_get_bounds (item.layer, &x, &y, &width, &height);
+    bounds.start_x = x;
+    bounds.start_y = y;
+    bounds.width = width;
+    bounds.height = height;
+    Track (item, bounds, changed);
+  }
+
+  dirty_area_ = CountTiles (damage_);
+  overlay_area_ = CountTiles (drawn_);
+  damage_.clear ();
+  drawn_.clear ();
+
+  return 0;
+}
+
+GstStructure *
+CpuOverlayBackend::GetStats ()
+{
+  return gst_structure_new ("cpu-overlay-stats",
+      "dirty-area", G_TYPE_UINT, dirty_area_,
+      "overlay-area", G_TYPE_UINT, overlay_area_,
+      "layer-updates", G_TYPE_UINT, layer_updates_,
+      "text-cache-size", G_TYPE_UINT, (guint) text_cache_.GetSize (),
+      "text-cache-capacity", G_TYPE_UINT, (guint) text_cache_.GetCapacity (),
+      "text-cache-hits", G_TYPE_UINT64, (guint64) text_cache_.GetHits (),
+      "text-cache-misses", G_TYPE_UINT64, (guint64) text_cache_.GetMisses (),
+      "text-cache-evictions", G_TYPE_UINT64,
+      (guint64) text_cache_.GetEvictions (),
+      NULL);
+}
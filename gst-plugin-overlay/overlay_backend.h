@@ -0,0 +1,189 @@
+/*
+* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __GST_QTI_OVERLAY_BACKEND_H__
+#define __GST_QTI_OVERLAY_BACKEND_H__
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include <qmmf-sdk/qmmf_overlay.h>
+
+#include "cpu_overlay_renderer.h"
+#include "overlay_text_cache.h"
+
+using namespace qmmf::overlay;
+
+/* Segmentation mask at model resolution, stretched over @dst_rect. With a
+ * @palette each byte of @data is a class index, otherwise @data holds RGBA
+ * pixels. Palette entries are R, G, B, A bytes like the pixels. */
+struct OverlayMask {
+  const uint8_t   *data;
+  uint32_t        width;
+  uint32_t        height;
+  uint32_t        stride;
+  const uint32_t  *palette;
+  uint32_t        n_colors;
+  OverlayRect     dst_rect;
+};
+
+/* Draws overlay items into video frames. The interface follows the item
+ * based API of qmmf::overlay::Overlay, items are described with the same
+ * OverlayParam structures whatever backend renders them. All methods
+ * return 0 on success. */
+class OverlayBackend {
+ public:
+  virtual ~OverlayBackend () {};
+
+  virtual int32_t Init (TargetBufferFormat format) = 0;
+
+  virtual int32_t CreateOverlayItem (OverlayParam & param,
+                                     uint32_t * item_id) = 0;
+  virtual int32_t DeleteOverlayItem (uint32_t item_id) = 0;
+
+  virtual int32_t EnableOverlayItem (uint32_t item_id) = 0;
+  virtual int32_t DisableOverlayItem (uint32_t item_id) = 0;
+
+  virtual int32_t UpdateOverlayParams (uint32_t item_id,
+                                       OverlayParam & param) = 0;
+
+  /* Draws the enabled items into the mapped frame */
+  virtual int32_t ApplyOverlay (GstVideoFrame * frame) = 0;
+
+  /* Whether BlendMasks() is implemented. Otherwise masks are handed over as
+   * static image items. */
+  virtual bool SupportsMasks () { return false; }
+
+  /* Blends the masks into the mapped frame, below the items drawn by the
+   * next ApplyOverlay(). */
+  virtual int32_t BlendMasks (GstVideoFrame *, const OverlayMask *,
+                              uint32_t) { return -1; }
+
+  /* Rendering statistics of the backend, or NULL when it keeps none */
+  virtual GstStructure * GetStats () { return NULL; }
+};
+
+/* Composes through the qmmf overlay library, on the GPU */
+class QmmfOverlayBackend : public OverlayBackend {
+ public:
+  QmmfOverlayBackend ();
+  ~QmmfOverlayBackend ();
+
+  int32_t Init (TargetBufferFormat format) override;
+
+  int32_t CreateOverlayItem (OverlayParam & param,
+                             uint32_t * item_id) override;
+  int32_t DeleteOverlayItem (uint32_t item_id) override;
+
+  int32_t EnableOverlayItem (uint32_t item_id) override;
+  int32_t DisableOverlayItem (uint32_t item_id) override;
+
+  int32_t UpdateOverlayParams (uint32_t item_id,
+                               OverlayParam & param) override;
+
+  int32_t ApplyOverlay (GstVideoFrame * frame) override;
+
+ private:
+  Overlay             *overlay_;
+  TargetBufferFormat  format_;
+};
+
+/* Draws directly into the NV12/NV21 planes on the CPU */
+class CpuOverlayBackend : public OverlayBackend {
+ public:
+  CpuOverlayBackend ();
+  ~CpuOverlayBackend ();
+
+  int32_t Init (TargetBufferFormat format) override;
+
+  int32_t CreateOverlayItem (OverlayParam & param,
+                             uint32_t * item_id) override;
+  int32_t DeleteOverlayItem (uint32_t item_id) override;
+
+  int32_t EnableOverlayItem (uint32_t item_id) override;
+  int32_t DisableOverlayItem (uint32_t item_id) override;
+
+  int32_t UpdateOverlayParams (uint32_t item_id,
+                               OverlayParam & param) override;
+
+  int32_t ApplyOverlay (GstVideoFrame * frame) override;
+
+  bool SupportsMasks () override { return true; }
+  int32_t BlendMasks (GstVideoFrame * frame, const OverlayMask * masks,
+                      uint32_t n_masks) override;
+
+  GstStructure * GetStats () override;
+
+ private:
+  struct Item {
+    OverlayParam     param;
+    bool             enabled;
+    /* Pre-rendered content, rebuilt only when the item changes */
+    CpuOverlayLayer  *layer;
+    bool             dirty;
+    /* Position of a user text layer, it moves when texts above go away */
+    int32_t          layer_y;
+    /* Content of a date layer */
+    std::string      text;
+    /* Area covered on the last drawn frame */
+    OverlayRect      bounds;
+    bool             drawn;
+  };
+
+  /* Records the area drawn for @item, damaged when it changed or moved */
+  void Track (Item & item, const OverlayRect & bounds, bool changed);
+  /* Damages the area of an item that is no longer drawn */
+  void Untrack (Item & item);
+  /* Area in pixels of the tiles touched by @rects */
+  uint32_t CountTiles (const std::vector<OverlayRect> & rects);
+
+  std::map<uint32_t, Item>  items_;
+  OverlayTextCache          text_cache_;
+  uint32_t                  next_id_;
+  TargetBufferFormat        format_;
+
+  /* Frame size the layers were built for */
+  int32_t                   width_;
+  int32_t                   height_;
+
+  /* Areas changed and drawn since the last frame */
+  std::vector<OverlayRect>  damage_;
+  std::vector<OverlayRect>  drawn_;
+  std::vector<uint8_t>      tiles_;
+
+  /* Statistics of the last frame */
+  uint32_t                  dirty_area_;
+  uint32_t                  overlay_area_;
+  uint32_t                  layer_updates_;
+};
+
+#endif // __GST_QTI_OVERLAY_BACKEND_H__
@@ -0,0 +1,82 @@
+/*
+* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "overlay_text_cache.h"
+
+OverlayTextCache::OverlayTextCache (size_t capacity)
+    : capacity_ (capacity > 0 ? capacity : 1),
+      hits_ (0),
+      misses_ (0),
+      evictions_ (0)
+{
+}
+
+OverlayTextCache::~OverlayTextCache ()
+{
+  for (auto & entry : lru_) {
+    cpu_overlay_text_free (entry.run);
+  }
+}
+
+const CpuOverlayText *
+OverlayTextCache::Get (const char * text, int32_t scale, uint32_t color)
+{
+  // Scale and color are fixed size, put them first so the text ends the key.
+  std::string key (reinterpret_cast<const char *> (&scale), sizeof (scale));
+  key.append (reinterpret_cast<const char *> (&color), sizeof (color));
+  key.append (text);
+
+  auto it = index_.find (key);
+  if (it != index_.end ()) {
+    hits_++;
+    lru_.splice (lru_.begin (), lru_, it->second);
+    return it->second->run;
+  }
+
+  misses_++;
+
+  CpuOverlayText *run = cpu_overlay_text_new (text, scale, color);
+  if (run == NULL) {
+    return NULL;
+  }
+
+  if (index_.size () >= capacity_) {
+    Entry & oldest = lru_.back ();
+
+    index_.erase (oldest.key);
+    cpu_overlay_text_free (oldest.run);
+    lru_.pop_back ();
+    evictions_++;
+  }
+
+  lru_.push_front ({ key, run });
+  index_.emplace (key, lru_.begin ());
+
+  return run;
+}
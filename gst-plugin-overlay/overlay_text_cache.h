@@ -0,0 +1,75 @@
+/*
+* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __GST_QTI_OVERLAY_TEXT_CACHE_H__
+#define __GST_QTI_OVERLAY_TEXT_CACHE_H__
+
+#include <list>
+#include <string>
+#include <unordered_map>
+
+#include "cpu_overlay_renderer.h"
+
+/* Rasterized text runs keyed by text, scale and color. Labels such as class
+ * names and the date repeat across frames, so they are rasterized once and
+ * then drawn from the cache. The least recently used run is evicted when the
+ * cache is full. */
+class OverlayTextCache {
+ public:
+  OverlayTextCache (size_t capacity);
+  ~OverlayTextCache ();
+
+  /* Returns the run for the text, rasterizing it on a miss. The run stays
+   * valid until the next call. */
+  const CpuOverlayText * Get (const char * text, int32_t scale,
+                              uint32_t color);
+
+  size_t GetSize () const { return index_.size (); }
+  size_t GetCapacity () const { return capacity_; }
+  uint64_t GetHits () const { return hits_; }
+  uint64_t GetMisses () const { return misses_; }
+  uint64_t GetEvictions () const { return evictions_; }
+
+ private:
+  struct Entry {
+    std::string     key;
+    CpuOverlayText  *run;
+  };
+
+  size_t                  capacity_;
+  /* Most recently used first */
+  std::list<Entry>        lru_;
+  std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+
+  uint64_t                hits_;
+  uint64_t                misses_;
+  uint64_t                evictions_;
+};
+
+#endif // __GST_QTI_OVERLAY_TEXT_CACHE_H__
@@ -0,0 +1,252 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cpu_overlay_renderer.h"
+
+// Frame time of the CPU overlay renderer against the number of detections.
+//
+// Usage: cpu_overlay_renderer_bench [width] [height] [frames]
+//
+// Every detection is a box with a translucent label background and a text
+// label. The scene is drawn directly, with text runs prepared once and as a
+// recorded layer.
+
+#define DEFAULT_WIDTH  1920
+#define DEFAULT_HEIGHT 1080
+#define DEFAULT_FRAMES 200
+
+#define BOX_COLOR    0x00FF00FF
+#define LABEL_COLOR  0x00000080
+#define TEXT_COLOR   0xFFFFFFFF
+#define TEXT_SCALE   2
+
+static const int32_t counts[] = { 1, 4, 16, 64, 256 };
+
+static const char *labels[] = { "person 0.98", "car 0.87", "bicycle 0.76",
+    "dog 0.65", "traffic light 0.54", "bus 0.43" };
+
+#define N_LABELS (sizeof (labels) / sizeof (labels[0]))
+
+typedef struct _BenchBox BenchBox;
+
+struct _BenchBox {
+  int32_t x;
+  int32_t y;
+  int32_t width;
+  int32_t height;
+  const char *label;
+};
+
+static double
+now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+report (const char * name, int32_t n_boxes, int32_t n_frames, double seconds)
+{
+  printf ("%-8s %5d boxes %9.3f ms/frame %9.1f frames/s\n", name, n_boxes,
+      seconds * 1e3 / n_frames, n_frames / seconds);
+}
+
+// Boxes spread over the frame, the same every run.
+static void
+boxes_init (BenchBox * boxes, int32_t n_boxes, int32_t width, int32_t height)
+{
+  uint32_t state = 1;
+  int32_t idx = 0;
+
+  for (idx = 0; idx < n_boxes; idx++) {
+    state = state * 1103515245 + 12345;
+    boxes[idx].width = 64 + (state >> 8) % (width / 4);
+    state = state * 1103515245 + 12345;
+    boxes[idx].height = 64 + (state >> 8) % (height / 4);
+    state = state * 1103515245 + 12345;
+    boxes[idx].x = (state >> 8) % (width - boxes[idx].width);
+    state = state * 1103515245 + 12345;
+    boxes[idx].y = (state >> 8) % (height - boxes[idx].height);
+    boxes[idx].label = labels[idx % N_LABELS];
+  }
+}
+
+static void
+draw_direct (CpuOverlayFrame * frame, const BenchBox * boxes, int32_t n_boxes)
+{
+  int32_t idx = 0;
+
+  for (idx = 0; idx < n_boxes; idx++) {
+    const BenchBox *box = &boxes[idx];
+    int32_t width = cpu_overlay_text_width (box->label, TEXT_SCALE);
+
+    cpu_overlay_draw_rect (frame, box->x, box->y, box->width, box->height, 3,
+        BOX_COLOR);
+    cpu_overlay_fill_rect (frame, box->x, box->y,
+        width + 2 * TEXT_SCALE, CPU_OVERLAY_CELL_HEIGHT * TEXT_SCALE,
+        LABEL_COLOR);
+    cpu_overlay_draw_text (frame, box->x + TEXT_SCALE, box->y + TEXT_SCALE,
+        box->label, TEXT_SCALE, TEXT_COLOR);
+  }
+}
+
+static void
+draw_runs (CpuOverlayFrame * frame, const BenchBox * boxes, int32_t n_boxes,
+    CpuOverlayText ** runs)
+{
+  int32_t idx = 0, width = 0, height = 0;
+
+  for (idx = 0; idx < n_boxes; idx++) {
+    const BenchBox *box = &boxes[idx];
+    const CpuOverlayText *run = runs[idx % N_LABELS];
+
+    cpu_overlay_text_get_size (run, &width, &height);
+    cpu_overlay_draw_rect (frame, box->x, box->y, box->width, box->height, 3,
+        BOX_COLOR);
+    cpu_overlay_fill_rect (frame, box->x, box->y, width + 2 * TEXT_SCALE,
+        height, LABEL_COLOR);
+    cpu_overlay_draw_text_run (frame, box->x + TEXT_SCALE,
+        box->y + TEXT_SCALE, run);
+  }
+}
+
+static void
+record_layer (CpuOverlayLayer * layer, const BenchBox * boxes,
+    int32_t n_boxes, CpuOverlayText ** runs)
+{
+  int32_t idx = 0, width = 0, height = 0;
+
+  cpu_overlay_layer_clear (layer);
+
+  for (idx = 0; idx < n_boxes; idx++) {
+    const BenchBox *box = &boxes[idx];
+    const CpuOverlayText *run = runs[idx % N_LABELS];
+
+    cpu_overlay_text_get_size (run, &width, &height);
+    cpu_overlay_layer_draw_rect (layer, box->x, box->y, box->width,
+        box->height, 3, BOX_COLOR);
+    cpu_overlay_layer_fill_rect (layer, box->x, box->y,
+        width + 2 * TEXT_SCALE, height, LABEL_COLOR);
+    cpu_overlay_layer_draw_text_run (layer, box->x + TEXT_SCALE,
+        box->y + TEXT_SCALE, run);
+  }
+}
+
+int
+main (int argc, char ** argv)
+{
+  CpuOverlayText *runs[N_LABELS];
+  CpuOverlayLayer *layer = NULL;
+  CpuOverlayFrame frame;
+  BenchBox *boxes = NULL;
+  uint8_t *data = NULL;
+  int32_t n_frames = 0, n_boxes = 0, idx = 0, count = 0;
+  double start = 0.0;
+
+  memset (&frame, 0, sizeof (frame));
+  frame.width = (argc > 1) ? atoi (argv[1]) : DEFAULT_WIDTH;
+  frame.height = (argc > 2) ? atoi (argv[2]) : DEFAULT_HEIGHT;
+  n_frames = (argc > 3) ? atoi (argv[3]) : DEFAULT_FRAMES;
+
+  if (frame.width < 512 || frame.height < 256 || n_frames <= 0) {
+    fprintf (stderr, "Usage: %s [width >= 512] [height >= 256] [frames]\n",
+        argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  frame.luma_stride = frame.chroma_stride = (frame.width + 1) & ~1;
+  data = (uint8_t *) malloc ((size_t) frame.luma_stride *
+      (frame.height + (frame.height + 1) / 2));
+  boxes = (BenchBox *) malloc (counts[sizeof (counts) / sizeof (counts[0]) -
+      1] * sizeof (BenchBox));
+  layer = cpu_overlay_layer_new ();
+
+  if (data == NULL || boxes == NULL || layer == NULL) {
+    fprintf (stderr, "Out of memory\n");
+    return EXIT_FAILURE;
+  }
+
+  frame.luma = data;
+  frame.chroma = data + (size_t) frame.luma_stride * frame.height;
+  memset (data, 128, (size_t) frame.luma_stride *
+      (frame.height + (frame.height + 1) / 2));
+
+  for (idx = 0; idx < (int32_t) N_LABELS; idx++) {
+    runs[idx] = cpu_overlay_text_new (labels[idx], TEXT_SCALE, TEXT_COLOR);
+    if (runs[idx] == NULL) {
+      fprintf (stderr, "Out of memory\n");
+      return EXIT_FAILURE;
+    }
+  }
+
+  printf ("%dx%d NV12, %d frames\n", frame.width, frame.height, n_frames);
+
+  for (count = 0; count < (int32_t) (sizeof (counts) / sizeof (counts[0]));
+       count++) {
+    n_boxes = counts[count];
+    boxes_init (boxes, n_boxes, frame.width, frame.height);
+
+    start = now ();
+    for (idx = 0; idx < n_frames; idx++) {
+      draw_direct (&frame, boxes, n_boxes);
+    }
+    report ("direct", n_boxes, n_frames, now () - start);
+
+    start = now ();
+    for (idx = 0; idx < n_frames; idx++) {
+      draw_runs (&frame, boxes, n_boxes, runs);
+    }
+    report ("runs", n_boxes, n_frames, now () - start);
+
+    // Recording is part of every frame as detections change per frame.
+    start = now ();
+    for (idx = 0; idx < n_frames; idx++) {
+      record_layer (layer, boxes, n_boxes, runs);
+      cpu_overlay_draw_layer (&frame, layer);
+    }
+    report ("layer", n_boxes, n_frames, now () - start);
+  }
+
+  for (idx = 0; idx < (int32_t) N_LABELS; idx++) {
+    cpu_overlay_text_free (runs[idx]);
+  }
+
+  cpu_overlay_layer_free (layer);
+  free (boxes);
+  free (data);
+
+  return EXIT_SUCCESS;
+}
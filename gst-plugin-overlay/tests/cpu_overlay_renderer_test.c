@@ -0,0 +1,701 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu_overlay_renderer.h"
+
+#define CHECK(expr) \
+  do { \
+    if (!(expr)) { \
+      fprintf (stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+          #expr); \
+      exit (EXIT_FAILURE); \
+    } \
+  } while (0)
+
+// Bytes past the end of each plane row, must never be written.
+#define STRIDE_PADDING 7
+#define PADDING_VALUE  0xA5
+
+// FNV-1a hash of the frame drawn by test_golden_scene().
+#define GOLDEN_SCENE_HASH 0x2ade65157ea2a6d0ULL
+
+// Alphas of the translucent colors, 0 and 255 take the skip and fill paths.
+static const uint8_t alphas[] = { 0, 1, 64, 127, 128, 200, 254, 255 };
+
+typedef struct _TestFrame TestFrame;
+
+struct _TestFrame {
+  CpuOverlayFrame frame;
+  uint8_t         *data;
+  size_t          size;
+};
+
+typedef struct _RefColor RefColor;
+
+struct _RefColor {
+  uint8_t  y;
+  uint8_t  u;
+  uint8_t  v;
+  uint32_t alpha;
+};
+
+static uint32_t random_state = 1;
+
+static uint32_t
+random_next (void)
+{
+  random_state = random_state * 1103515245 + 12345;
+  return random_state >> 8;
+}
+
+static void
+frame_init (TestFrame * test, int32_t width, int32_t height, int32_t swap_uv)
+{
+  CpuOverlayFrame *frame = &test->frame;
+  int32_t chroma_height = (height + 1) / 2;
+
+  frame->width = width;
+  frame->height = height;
+  frame->luma_stride = width + STRIDE_PADDING;
+  frame->chroma_stride = ((width + 1) / 2) * 2 + STRIDE_PADDING;
+  frame->swap_uv = swap_uv;
+
+  test->size = (size_t) frame->luma_stride * height +
+      (size_t) frame->chroma_stride * chroma_height;
+  test->data = (uint8_t *) malloc (test->size);
+  CHECK (test->data != NULL);
+
+  frame->luma = test->data;
+  frame->chroma = test->data + (size_t) frame->luma_stride * height;
+}
+
+// Random content, the padding gets a fixed value.
+static void
+frame_randomize (TestFrame * test)
+{
+  CpuOverlayFrame *frame = &test->frame;
+  int32_t row = 0, column = 0;
+
+  memset (test->data, PADDING_VALUE, test->size);
+
+  for (row = 0; row < frame->height; row++) {
+    for (column = 0; column < frame->width; column++) {
+      frame->luma[row * frame->luma_stride + column] = random_next ();
+    }
+  }
+
+  for (row = 0; row < (frame->height + 1) / 2; row++) {
+    for (column = 0; column < ((frame->width + 1) / 2) * 2; column++) {
+      frame->chroma[row * frame->chroma_stride + column] = random_next ();
+    }
+  }
+}
+
+static void
+frame_copy (TestFrame * dst, const TestFrame * src)
+{
+  frame_init (dst, src->frame.width, src->frame.height, src->frame.swap_uv);
+  memcpy (dst->data, src->data, src->size);
+}
+
+static void
+frame_free (TestFrame * test)
+{
+  free (test->data);
+  test->data = NULL;
+}
+
+static int
+frame_equal (const TestFrame * a, const TestFrame * b)
+{
+  size_t idx = 0;
+
+  for (idx = 0; idx < a->size; idx++) {
+    if (a->data[idx] != b->data[idx]) {
+      fprintf (stderr, "frames differ at byte %zu: %u != %u\n", idx,
+          a->data[idx], b->data[idx]);
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+static uint64_t
+frame_hash (const TestFrame * test)
+{
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  size_t idx = 0;
+
+  // FNV-1a
+  for (idx = 0; idx < test->size; idx++) {
+    hash = (hash ^ test->data[idx]) * 0x100000001b3ULL;
+  }
+
+  return hash;
+}
+
+// Reference model, one pixel at a time.
+
+static uint8_t
+ref_clamp (int32_t value)
+{
+  return (value < 0) ? 0 : ((value > 255) ? 255 : value);
+}
+
+static void
+ref_color (uint8_t r, uint8_t g, uint8_t b, uint8_t a, RefColor * color)
+{
+  color->y = ref_clamp (((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+  color->u = ref_clamp (((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+  color->v = ref_clamp (((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+  color->alpha = a + (a >> 7);
+}
+
+static void
+ref_unpack (uint32_t rgba, RefColor * color)
+{
+  ref_color (rgba >> 24, (rgba >> 16) & 0xFF, (rgba >> 8) & 0xFF,
+      rgba & 0xFF, color);
+}
+
+static void
+ref_blend (uint8_t * pixel, uint8_t value, uint32_t alpha)
+{
+  *pixel = (*pixel * (256 - alpha) + value * alpha + 128) >> 8;
+}
+
+static void
+ref_blend_luma (CpuOverlayFrame * frame, int32_t x, int32_t y,
+    const RefColor * color)
+{
+  ref_blend (&frame->luma[y * frame->luma_stride + x], color->y,
+      color->alpha);
+}
+
+static void
+ref_blend_chroma (CpuOverlayFrame * frame, int32_t x, int32_t y,
+    const RefColor * color)
+{
+  uint8_t *pixel = &frame->chroma[y * frame->chroma_stride + x * 2];
+
+  ref_blend (&pixel[0], frame->swap_uv ? color->v : color->u, color->alpha);
+  ref_blend (&pixel[1], frame->swap_uv ? color->u : color->v, color->alpha);
+}
+
+static void
+ref_fill_rect (TestFrame * test, int32_t x, int32_t y, int32_t width,
+    int32_t height, uint32_t rgba)
+{
+  CpuOverlayFrame *frame = &test->frame;
+  RefColor color;
+  int32_t row = 0, column = 0;
+
+  ref_unpack (rgba, &color);
+
+  for (row = 0; row < frame->height; row++) {
+    for (column = 0; column < frame->width; column++) {
+      if (column >= x && column < x + width && row >= y && row < y + height)
+        ref_blend_luma (frame, column, row, &color);
+    }
+  }
+
+  // A chroma block is painted if any of its luma pixels is.
+  for (row = 0; row < (frame->height + 1) / 2; row++) {
+    for (column = 0; column < (frame->width + 1) / 2; column++) {
+      int32_t bx0 = column * 2, by0 = row * 2;
+      int32_t bx1 = bx0 + 2, by1 = by0 + 2;
+
+      bx1 = (bx1 > frame->width) ? frame->width : bx1;
+      by1 = (by1 > frame->height) ? frame->height : by1;
+
+      if (bx0 < x + width && bx1 > x && by0 < y + height && by1 > y)
+        ref_blend_chroma (frame, column, row, &color);
+    }
+  }
+}
+
+// Mask sample of the first covered luma pixel of a chroma block.
+static void
+ref_blend_samples (TestFrame * test, int32_t x, int32_t y, int32_t width,
+    int32_t height, const uint8_t * mask, int32_t mask_width,
+    int32_t mask_height, int32_t mask_stride, const uint32_t * palette)
+{
+  CpuOverlayFrame *frame = &test->frame;
+  RefColor color;
+  int32_t row = 0, column = 0;
+
+  for (row = 0; row < frame->height; row++) {
+    for (column = 0; column < frame->width; column++) {
+      const uint8_t *sample = NULL;
+      uint8_t pixel[4];
+      int32_t mx = 0, my = 0;
+
+      if (column < x || column >= x + width || row < y || row >= y + height)
+        continue;
+
+      mx = (column - x) * mask_width / width;
+      my = (row - y) * mask_height / height;
+      sample = mask + my * mask_stride;
+
+      // Palette entries hold R, G, B, A bytes like image pixels.
+      if (palette != NULL) {
+        memcpy (pixel, &palette[sample[mx]], sizeof (pixel));
+      } else {
+        memcpy (pixel, sample + mx * 4, sizeof (pixel));
+      }
+      ref_color (pixel[0], pixel[1], pixel[2], pixel[3], &color);
+      ref_blend_luma (frame, column, row, &color);
+
+      // The block is handled once, from its first covered pixel.
+      if ((column % 2 == 0 || column == x) && (row % 2 == 0 || row == y))
+        ref_blend_chroma (frame, column / 2, row / 2, &color);
+    }
+  }
+}
+
+static void
+test_colors (void)
+{
+  TestFrame nv12, nv21;
+  const uint8_t *block = NULL;
+
+  frame_init (&nv12, 4, 2, 0);
+  frame_init (&nv21, 4, 2, 1);
+  memset (nv12.data, 0, nv12.size);
+  memset (nv21.data, 0, nv21.size);
+
+  // Opaque red, BT.601 limited range.
+  cpu_overlay_fill_rect (&nv12.frame, 0, 0, 2, 2, 0xFF0000FF);
+  cpu_overlay_fill_rect (&nv21.frame, 0, 0, 2, 2, 0xFF0000FF);
+
+  CHECK (nv12.frame.luma[0] == 82 && nv12.frame.luma[1] == 82);
+  CHECK (nv12.frame.luma[2] == 0);
+  block = nv12.frame.chroma;
+  CHECK (block[0] == 90 && block[1] == 240);
+  block = nv21.frame.chroma;
+  CHECK (block[0] == 240 && block[1] == 90);
+
+  // Opaque white and black.
+  cpu_overlay_fill_rect (&nv12.frame, 2, 0, 2, 2, 0xFFFFFFFF);
+  CHECK (nv12.frame.luma[3] == 235);
+  CHECK (nv12.frame.chroma[2] == 128 && nv12.frame.chroma[3] == 128);
+  cpu_overlay_fill_rect (&nv12.frame, 2, 0, 2, 2, 0x000000FF);
+  CHECK (nv12.frame.luma[3] == 16);
+
+  // Half transparent white over black, alpha 128 becomes 129 of 256.
+  memset (nv12.data, 16, nv12.size);
+  cpu_overlay_fill_rect (&nv12.frame, 0, 0, 4, 2, 0xFFFFFF80);
+  CHECK (nv12.frame.luma[0] == (16 * 127 + 235 * 129 + 128) >> 8);
+
+  // Fully transparent colors leave the frame alone.
+  memset (nv12.data, 7, nv12.size);
+  cpu_overlay_fill_rect (&nv12.frame, 0, 0, 4, 2, 0xFFFFFF00);
+  CHECK (nv12.frame.luma[0] == 7 && nv12.frame.chroma[0] == 7);
+
+  frame_free (&nv12);
+  frame_free (&nv21);
+}
+
+// Every row length from a single byte to several SIMD blocks at every
+// alignment, in luma and chroma and with every alpha class.
+static void
+test_blend_rows (void)
+{
+  TestFrame frame, expected;
+  uint32_t rgb[] = { 0xFF000000, 0x00FF0000, 0x2050E000, 0xFFFFFF00 };
+  int32_t x = 0, width = 0;
+  uint32_t idx = 0, n_alphas = sizeof (alphas) / sizeof (alphas[0]);
+
+  frame_init (&frame, 96, 6, 0);
+
+  for (width = 1; width <= 72; width++) {
+    for (x = 0; x < 5; x++) {
+      for (idx = 0; idx < n_alphas * 2; idx++) {
+        uint32_t color = rgb[(width + x + idx) % 4] | alphas[idx % n_alphas];
+
+        frame.frame.swap_uv = idx >= n_alphas;
+        frame_randomize (&frame);
+        frame_copy (&expected, &frame);
+
+        cpu_overlay_fill_rect (&frame.frame, x, 1, width, 3, color);
+        ref_fill_rect (&expected, x, 1, width, 3, color);
+
+        if (!frame_equal (&frame, &expected)) {
+          fprintf (stderr, "x %d width %d color 0x%08x\n", x, width, color);
+          CHECK (0);
+        }
+        frame_free (&expected);
+      }
+    }
+  }
+
+  frame_free (&frame);
+}
+
+// Chroma covers every 2x2 block touched by the rectangle, odd edges round
+// outwards and the last block of odd sized frames is half covered.
+static void
+test_chroma_rounding (void)
+{
+  TestFrame frame, expected;
+  int32_t x = 0, y = 0, width = 0, height = 0;
+  uint8_t *chroma = NULL;
+
+  frame_init (&frame, 8, 4, 0);
+  memset (frame.data, 0, frame.size);
+
+  // Luma columns 3..4 and rows 1..2 touch chroma blocks 1..2 of rows 0..1.
+  cpu_overlay_fill_rect (&frame.frame, 3, 1, 2, 2, 0xFFFFFFFF);
+  chroma = frame.frame.chroma;
+  CHECK (chroma[0] == 0 && chroma[1] == 0);
+  CHECK (chroma[2] == 128 && chroma[3] == 128);
+  CHECK (chroma[4] == 128 && chroma[5] == 128);
+  CHECK (chroma[6] == 0 && chroma[7] == 0);
+  chroma += frame.frame.chroma_stride;
+  CHECK (chroma[0] == 0 && chroma[2] == 128 && chroma[4] == 128);
+  CHECK (chroma[6] == 0);
+  CHECK (frame.frame.luma[2] == 0 && frame.frame.luma[3] == 0);
+  CHECK (frame.frame.luma[frame.frame.luma_stride + 2] == 0);
+  CHECK (frame.frame.luma[frame.frame.luma_stride + 3] == 235);
+  CHECK (frame.frame.luma[frame.frame.luma_stride + 5] == 0);
+  frame_free (&frame);
+
+  // Every placement in an odd sized frame, including clipped ones.
+  frame_init (&frame, 13, 9, 0);
+
+  for (y = -2; y < 10; y++) {
+    for (height = 1; height < 6; height++) {
+      for (x = -3; x < 14; x++) {
+        for (width = 1; width < 7; width++) {
+          uint32_t color = (x & 1) ? 0x30C070C0 : 0xE0208090;
+
+          frame_randomize (&frame);
+          frame_copy (&expected, &frame);
+
+          cpu_overlay_fill_rect (&frame.frame, x, y, width, height, color);
+          ref_fill_rect (&expected, x, y, width, height, color);
+
+          if (!frame_equal (&frame, &expected)) {
+            fprintf (stderr, "rect %d,%d %dx%d\n", x, y, width, height);
+            CHECK (0);
+          }
+          frame_free (&expected);
+        }
+      }
+    }
+  }
+
+  frame_free (&frame);
+}
+
+static void
+test_draw_rect (void)
+{
+  TestFrame frame, expected;
+  int32_t thickness = 0, t = 0;
+
+  frame_init (&frame, 41, 23, 1);
+
+  for (thickness = 1; thickness < 12; thickness++) {
+    frame_randomize (&frame);
+    frame_copy (&expected, &frame);
+
+    cpu_overlay_draw_rect (&frame.frame, 3, 2, 31, 17, thickness, 0x10E0F0A0);
+
+    // Sides do not overlap, thickness is at most half the smaller side.
+    t = (thickness > 8) ? 8 : thickness;
+    ref_fill_rect (&expected, 3, 2, 31, t, 0x10E0F0A0);
+    ref_fill_rect (&expected, 3, 19 - t, 31, t, 0x10E0F0A0);
+    ref_fill_rect (&expected, 3, 2 + t, t, 17 - 2 * t, 0x10E0F0A0);
+    ref_fill_rect (&expected, 34 - t, 2 + t, t, 17 - 2 * t, 0x10E0F0A0);
+
+    // Chroma blocks shared by two sides are blended by both.
+    if (!frame_equal (&frame, &expected)) {
+      fprintf (stderr, "thickness %d\n", thickness);
+      CHECK (0);
+    }
+    frame_free (&expected);
+  }
+
+  frame_free (&frame);
+}
+
+// Opaque lines in every octant against a plain Bresenham walk, overlapping
+// pen positions fill the same pixels again.
+static void
+test_lines (void)
+{
+  static const int32_t ends[][2] = { { 30, 2 }, { 37, 19 }, { 22, 22 },
+      { 2, 21 }, { 1, 9 }, { 3, 0 }, { 20, 1 }, { 20, 11 }, { 33, 9 } };
+  TestFrame frame, expected;
+  int32_t idx = 0, thickness = 0;
+
+  frame_init (&frame, 39, 23, 0);
+
+  for (idx = 0; idx < (int32_t) (sizeof (ends) / sizeof (ends[0])); idx++) {
+    for (thickness = 1; thickness < 5; thickness++) {
+      int32_t x = 19, y = 11, x1 = ends[idx][0], y1 = ends[idx][1];
+      int32_t dx = abs (x1 - x), dy = -abs (y1 - y), error = dx + dy;
+      int32_t step = 0;
+
+      frame_randomize (&frame);
+      frame_copy (&expected, &frame);
+
+      cpu_overlay_draw_line (&frame.frame, x, y, x1, y1, thickness,
+          0x8020E0FF);
+
+      while (1) {
+        ref_fill_rect (&expected, x - thickness / 2, y - thickness / 2,
+            thickness, thickness, 0x8020E0FF);
+        if (x == x1 && y == y1)
+          break;
+
+        step = 2 * error;
+        if (step >= dy) {
+          error += dy;
+          x += (x < x1) ? 1 : -1;
+        }
+        if (step <= dx) {
+          error += dx;
+          y += (y < y1) ? 1 : -1;
+        }
+      }
+
+      if (!frame_equal (&frame, &expected)) {
+        fprintf (stderr, "line to %d,%d thickness %d\n", x1, y1, thickness);
+        CHECK (0);
+      }
+      frame_free (&expected);
+    }
+  }
+
+  frame_free (&frame);
+}
+
+static void
+test_text (void)
+{
+  // Glyph 'A' of the atlas at scale 2, '#' is text, '.' background.
+  static const char *golden[] = {
+    "..######..",
+    "..######..",
+    "##......##",
+    "##......##",
+    "##......##",
+    "##......##",
+    "##########",
+    "##########",
+    "##......##",
+    "##......##",
+    "##......##",
+    "##......##",
+    "##......##",
+    "##......##",
+  };
+  TestFrame frame, runs, layered;
+  CpuOverlayText *run = NULL;
+  CpuOverlayLayer *layer = NULL;
+  int32_t row = 0, column = 0, width = 0, height = 0;
+
+  frame_init (&frame, 16, 20, 0);
+  memset (frame.data, 16, frame.size);
+
+  CHECK (cpu_overlay_draw_text (&frame.frame, 2, 3, "A", 2, 0xFFFFFFFF) ==
+      cpu_overlay_text_width ("A", 2));
+  CHECK (cpu_overlay_text_width ("A", 2) == 10);
+
+  for (row = 0; row < frame.frame.height; row++) {
+    for (column = 0; column < frame.frame.width; column++) {
+      uint8_t expected = 16;
+
+      if (row >= 3 && row < 17 && column >= 2 && column < 12 &&
+          golden[row - 3][column - 2] == '#') {
+        expected = 235;
+      }
+      CHECK (frame.frame.luma[row * frame.frame.luma_stride + column] ==
+          expected);
+    }
+  }
+  frame_free (&frame);
+
+  // Direct text, text runs and layers draw the same pixels, clipped too.
+  frame_init (&frame, 80, 30, 0);
+  frame_randomize (&frame);
+  frame_copy (&runs, &frame);
+  frame_copy (&layered, &frame);
+
+  cpu_overlay_draw_text (&frame.frame, -3, 1, "person 0.97", 1, 0xFFFF00C0);
+  cpu_overlay_draw_text (&frame.frame, 5, 12, "Car~{}", 3, 0x00FFFF80);
+
+  run = cpu_overlay_text_new ("person 0.97", 1, 0xFFFF00C0);
+  CHECK (run != NULL);
+  cpu_overlay_text_get_size (run, &width, &height);
+  CHECK (width == cpu_overlay_text_width ("person 0.97", 1));
+  CHECK (height == CPU_OVERLAY_CELL_HEIGHT);
+  cpu_overlay_draw_text_run (&runs.frame, -3, 1, run);
+
+  layer = cpu_overlay_layer_new ();
+  CHECK (layer != NULL);
+  CHECK (cpu_overlay_layer_draw_text_run (layer, -3, 1, run) == 0);
+  cpu_overlay_text_free (run);
+
+  run = cpu_overlay_text_new ("Car~{}", 3, 0x00FFFF80);
+  CHECK (run != NULL);
+  cpu_overlay_draw_text_run (&runs.frame, 5, 12, run);
+  CHECK (cpu_overlay_layer_draw_text_run (layer, 5, 12, run) == 0);
+  cpu_overlay_text_free (run);
+
+  cpu_overlay_draw_layer (&layered.frame, layer);
+  cpu_overlay_layer_free (layer);
+
+  CHECK (frame_equal (&frame, &runs));
+  CHECK (frame_equal (&frame, &layered));
+
+  frame_free (&frame);
+  frame_free (&runs);
+  frame_free (&layered);
+}
+
+static void
+test_masks (void)
+{
+  static const uint32_t palette[] = { 0x00000000, 0xFF000080, 0x00FF00FF,
+      0x0000FFC0 };
+  uint8_t classes[5 * 8], image[6 * 4 * 5];
+  TestFrame frame, expected;
+  int32_t x = 0, y = 0, idx = 0;
+
+  for (idx = 0; idx < (int32_t) sizeof (classes); idx++) {
+    classes[idx] = random_next () % 4;
+  }
+
+  for (idx = 0; idx < (int32_t) sizeof (image); idx++) {
+    image[idx] = random_next ();
+  }
+
+  frame_init (&frame, 37, 21, 0);
+
+  for (y = -3; y < 4; y++) {
+    for (x = -3; x < 4; x++) {
+      frame.frame.swap_uv = (x + y) & 1;
+
+      // Class map of 5x4 with a stride of 8, upsampled to 29x15.
+      frame_randomize (&frame);
+      frame_copy (&expected, &frame);
+
+      cpu_overlay_blend_mask (&frame.frame, x, y, 29, 15, classes, 5, 4, 8,
+          palette, 4);
+      ref_blend_samples (&expected, x, y, 29, 15, classes, 5, 4, 8, palette);
+      CHECK (frame_equal (&frame, &expected));
+      frame_free (&expected);
+
+      // RGBA image of 5x4 with a stride of 6 pixels, scaled to 33x19.
+      frame_randomize (&frame);
+      frame_copy (&expected, &frame);
+
+      cpu_overlay_blend_image (&frame.frame, x + 5, y + 3, 33, 19, image, 5,
+          4, 6 * 4);
+      ref_blend_samples (&expected, x + 5, y + 3, 33, 19, image, 5, 4, 6 * 4,
+          NULL);
+      CHECK (frame_equal (&frame, &expected));
+      frame_free (&expected);
+    }
+  }
+
+  frame_free (&frame);
+}
+
+// Scene touching every primitive, its hash is the same for the NEON, SSE2
+// and portable builds.
+static void
+test_golden_scene (void)
+{
+  static const uint32_t palette[] = { 0x00000000, 0xFF00FF60, 0xFFFF00FF };
+  uint8_t classes[4 * 3] = { 0, 1, 1, 2, 0, 1, 2, 2, 0, 0, 1, 2 };
+  TestFrame frame;
+  int32_t row = 0, column = 0;
+  uint64_t hash = 0;
+
+  frame_init (&frame, 99, 67, 0);
+  memset (frame.data, PADDING_VALUE, frame.size);
+
+  for (row = 0; row < frame.frame.height; row++) {
+    for (column = 0; column < frame.frame.width; column++) {
+      frame.frame.luma[row * frame.frame.luma_stride + column] =
+          16 + (row * 3 + column * 2) % 220;
+    }
+  }
+
+  for (row = 0; row < (frame.frame.height + 1) / 2; row++) {
+    for (column = 0; column < frame.frame.width + 1; column++) {
+      frame.frame.chroma[row * frame.frame.chroma_stride + column] =
+          64 + (row * 5 + column * 3) % 128;
+    }
+  }
+
+  cpu_overlay_blend_mask (&frame.frame, 1, 33, 50, 33, classes, 4, 3, 4,
+      palette, 3);
+  cpu_overlay_fill_rect (&frame.frame, 5, 5, 40, 20, 0x20408080);
+  cpu_overlay_draw_rect (&frame.frame, 3, 3, 45, 25, 2, 0x00FF00FF);
+  cpu_overlay_draw_rect (&frame.frame, 51, 7, 47, 51, 3, 0xFF8000A0);
+  cpu_overlay_draw_text (&frame.frame, 6, 7, "car 0.81", 1, 0xFFFFFFFF);
+  cpu_overlay_draw_text (&frame.frame, 53, 40, "Hi!", 2, 0xFFFF0090);
+  cpu_overlay_draw_line (&frame.frame, 60, 12, 90, 35, 3, 0x0000FFFF);
+  cpu_overlay_draw_line (&frame.frame, 95, 60, 55, 20, 1, 0xFF00FFFF);
+
+  hash = frame_hash (&frame);
+  if (hash != GOLDEN_SCENE_HASH) {
+    fprintf (stderr, "scene hash 0x%016" PRIx64 "\n", hash);
+    CHECK (0);
+  }
+
+  frame_free (&frame);
+}
+
+int
+main (void)
+{
+  test_colors ();
+  test_blend_rows ();
+  test_chroma_rounding ();
+  test_draw_rect ();
+  test_lines ();
+  test_text ();
+  test_masks ();
+  test_golden_scene ();
+
+  printf ("All cpu_overlay_renderer tests passed\n");
+  return EXIT_SUCCESS;
+}
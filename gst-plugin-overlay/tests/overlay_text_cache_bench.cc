@@ -0,0 +1,252 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "cpu_overlay_renderer.h"
+#include "overlay_text_cache.h"
+
+// Scene with many labels, text rasterized per frame against the text cache.
+//
+// Usage: overlay_text_cache_bench [labels per frame] [frames] [classes]
+//
+// Every frame has the given number of labelled boxes with names picked from
+// a set of classes, plus a date that changes every 30 frames. Each frame is
+// recorded into a layer and drawn into a 1080p NV12 frame, as the CPU
+// backend does. The raster column times producing the text runs and
+// recording them, the total adds drawing the layer.
+
+#define DEFAULT_LABELS  100
+#define DEFAULT_FRAMES  300
+#define DEFAULT_CLASSES 20
+
+#define FRAME_WIDTH     1920
+#define FRAME_HEIGHT    1080
+#define FRAMES_PER_DATE 30
+#define TEXT_SCALE      2
+#define CACHE_SIZE      256
+
+static const char *classes[] = { "person", "bicycle", "car", "motorcycle",
+    "airplane", "bus", "train", "truck", "boat", "traffic light",
+    "fire hydrant", "stop sign", "parking meter", "bench", "bird", "cat",
+    "dog", "horse", "sheep", "cow", "elephant", "bear", "zebra", "giraffe",
+    "backpack", "umbrella", "handbag", "tie", "suitcase", "frisbee" };
+
+#define N_CLASSES (sizeof (classes) / sizeof (classes[0]))
+
+struct BenchLabel {
+  int32_t     x;
+  int32_t     y;
+  const char  *text;
+};
+
+struct BenchResult {
+  double  raster;
+  double  total;
+};
+
+static double
+now ()
+{
+  return std::chrono::duration<double> (
+      std::chrono::steady_clock::now ().time_since_epoch ()).count ();
+}
+
+static void
+report (const char * name, const BenchResult & result, uint32_t n_frames,
+    uint32_t n_labels)
+{
+  printf ("%-8s %9.3f ms/frame raster %9.3f ms/frame total "
+      "%8.2f us/label\n", name, result.raster * 1e3 / n_frames,
+      result.total * 1e3 / n_frames,
+      result.raster * 1e6 / ((double) n_frames * n_labels));
+}
+
+// Labels of a frame, detections move between frames.
+static void
+labels_init (std::vector<BenchLabel> & labels, uint32_t frame,
+    uint32_t n_classes)
+{
+  uint32_t state = frame * 2654435761u + 1;
+
+  for (auto & label : labels) {
+    state = state * 1103515245 + 12345;
+    label.x = (state >> 8) % (FRAME_WIDTH - 200);
+    state = state * 1103515245 + 12345;
+    label.y = (state >> 8) % (FRAME_HEIGHT - 32);
+    state = state * 1103515245 + 12345;
+    label.text = classes[(state >> 8) % n_classes];
+  }
+}
+
+static void
+date_string (char * date, size_t size, uint32_t frame)
+{
+  uint32_t seconds = frame / FRAMES_PER_DATE;
+
+  snprintf (date, size, "2020-06-01 12:%02u:%02u", seconds / 60 % 60,
+      seconds % 60);
+}
+
+// Rasterizes every label each frame, as without the cache.
+static BenchResult
+run_uncached (CpuOverlayFrame * frame, CpuOverlayLayer * layer,
+    std::vector<BenchLabel> & labels, uint32_t n_frames, uint32_t n_classes)
+{
+  std::vector<CpuOverlayText *> runs (labels.size () + 1);
+  BenchResult result = { 0.0, 0.0 };
+  char date[64];
+
+  for (uint32_t idx = 0; idx < n_frames; idx++) {
+    labels_init (labels, idx, n_classes);
+    date_string (date, sizeof (date), idx);
+
+    double start = now ();
+
+    cpu_overlay_layer_clear (layer);
+    for (size_t n = 0; n < labels.size (); n++) {
+      runs[n] = cpu_overlay_text_new (labels[n].text, TEXT_SCALE,
+          0xFFFFFFFF);
+      cpu_overlay_layer_draw_text_run (layer, labels[n].x, labels[n].y,
+          runs[n]);
+    }
+    runs[labels.size ()] = cpu_overlay_text_new (date, TEXT_SCALE,
+        0xFFFF00FF);
+    cpu_overlay_layer_draw_text_run (layer, 16, 16, runs[labels.size ()]);
+
+    double raster = now ();
+
+    cpu_overlay_draw_layer (frame, layer);
+
+    for (auto run : runs) {
+      cpu_overlay_text_free (run);
+    }
+
+    result.raster += raster - start;
+    result.total += now () - start;
+  }
+
+  return result;
+}
+
+static BenchResult
+run_cached (CpuOverlayFrame * frame, CpuOverlayLayer * layer,
+    OverlayTextCache & cache, std::vector<BenchLabel> & labels,
+    uint32_t n_frames, uint32_t n_classes)
+{
+  std::vector<const CpuOverlayText *> runs (labels.size () + 1);
+  BenchResult result = { 0.0, 0.0 };
+  char date[64];
+
+  for (uint32_t idx = 0; idx < n_frames; idx++) {
+    labels_init (labels, idx, n_classes);
+    date_string (date, sizeof (date), idx);
+
+    double start = now ();
+
+    // Runs are only valid until the next lookup, so each one is recorded
+    // right away like the CPU backend does.
+    cpu_overlay_layer_clear (layer);
+    for (size_t n = 0; n < labels.size (); n++) {
+      runs[n] = cache.Get (labels[n].text, TEXT_SCALE, 0xFFFFFFFF);
+      cpu_overlay_layer_draw_text_run (layer, labels[n].x, labels[n].y,
+          runs[n]);
+    }
+    runs[labels.size ()] = cache.Get (date, TEXT_SCALE, 0xFFFF00FF);
+    cpu_overlay_layer_draw_text_run (layer, 16, 16, runs[labels.size ()]);
+
+    double raster = now ();
+
+    cpu_overlay_draw_layer (frame, layer);
+
+    result.raster += raster - start;
+    result.total += now () - start;
+  }
+
+  return result;
+}
+
+int
+main (int argc, char ** argv)
+{
+  uint32_t n_labels = (argc > 1) ? strtoul (argv[1], NULL, 0) :
+      DEFAULT_LABELS;
+  uint32_t n_frames = (argc > 2) ? strtoul (argv[2], NULL, 0) :
+      DEFAULT_FRAMES;
+  uint32_t n_classes = (argc > 3) ? strtoul (argv[3], NULL, 0) :
+      DEFAULT_CLASSES;
+
+  if (n_labels == 0 || n_frames == 0 || n_classes == 0 ||
+      n_classes > N_CLASSES) {
+    fprintf (stderr, "Usage: %s [labels per frame] [frames] [classes <= %zu]"
+        "\n", argv[0], N_CLASSES);
+    return EXIT_FAILURE;
+  }
+
+  std::vector<uint8_t> data (FRAME_WIDTH * FRAME_HEIGHT * 3 / 2, 128);
+  std::vector<BenchLabel> labels (n_labels);
+  CpuOverlayFrame frame;
+
+  frame.luma = data.data ();
+  frame.chroma = data.data () + FRAME_WIDTH * FRAME_HEIGHT;
+  frame.width = FRAME_WIDTH;
+  frame.height = FRAME_HEIGHT;
+  frame.luma_stride = frame.chroma_stride = FRAME_WIDTH;
+  frame.swap_uv = 0;
+
+  CpuOverlayLayer *layer = cpu_overlay_layer_new ();
+  if (layer == NULL) {
+    fprintf (stderr, "Out of memory\n");
+    return EXIT_FAILURE;
+  }
+
+  printf ("%u labels of %u classes per frame, %u frames\n", n_labels,
+      n_classes, n_frames);
+
+  report ("uncached", run_uncached (&frame, layer, labels, n_frames,
+      n_classes), n_frames, n_labels + 1);
+
+  OverlayTextCache cache (CACHE_SIZE);
+
+  report ("cached", run_cached (&frame, layer, cache, labels, n_frames,
+      n_classes), n_frames, n_labels + 1);
+
+  printf ("cache    %zu of %zu entries, %llu hits, %llu misses, "
+      "%llu evictions\n", cache.GetSize (), cache.GetCapacity (),
+      (unsigned long long) cache.GetHits (),
+      (unsigned long long) cache.GetMisses (),
+      (unsigned long long) cache.GetEvictions ());
+
+  cpu_overlay_layer_free (layer);
+  return EXIT_SUCCESS;
+}
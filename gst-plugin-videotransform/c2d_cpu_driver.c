@@ -0,0 +1,568 @@
+/*
+* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "c2d_driver.h"
+#include "c2d_cpu_render.h"
+
+#include <string.h>
+
+#include <gst/gst.h>
+
+// CPU implementation of the C2D library. It keeps track of surfaces, draws
+// and timestamps with the same rules as the driver. Flushed draws are
+// rendered in submission order by a worker thread, which splits each draw
+// between the threads of the renderer. Supports NV12, NV21 and packed RGB.
+
+#define GST_CAT_DEFAULT ensure_debug_category()
+
+#define CPU_DRIVER_MAX_DIMENSION 32767
+
+typedef struct _CpuSurface CpuSurface;
+typedef struct _CpuBatch CpuBatch;
+
+struct _CpuSurface
+{
+  GstC2dCpuSurface surface;
+  // Sampling used for draws into this surface.
+  gboolean         bilinear;
+};
+
+// Draws flushed together, finished when the timestamp is reached.
+struct _CpuBatch
+{
+  GList            *draws;
+  gsize            timestamp;
+};
+
+static GstDebugCategory *
+ensure_debug_category (void)
+{
+  static gsize cat_gonce = 0;
+
+  if (g_once_init_enter (&cat_gonce)) {
+    gsize cat_done = (gsize) _gst_debug_category_new ("c2d-cpu-driver", 0,
+        "c2d-cpu-driver object");
+
+    g_once_init_leave (&cat_gonce, cat_done);
+  }
+
+  return (GstDebugCategory *) cat_gonce;
+}
+
+// The library API has no context argument, neither has the CPU driver.
+static GMutex lock;
+static GCond wakeup;
+static guint refcount = 0;
+static GHashTable *surfaces = NULL;
+static guint32 lastid = 0;
+// Draws submitted since the last flush.
+static GList *pending = NULL;
+// Flushed batches waiting for the worker, oldest first.
+static GQueue batches = G_QUEUE_INIT;
+// Last issued and last finished timestamp.
+static gsize timestamp = 0;
+static gsize completed = 0;
+static GThread *worker = NULL;
+static gboolean stopping = FALSE;
+
+static void
+cpu_driver_free_draws (GList * draws)
+{
+  g_list_free_full (draws, g_free);
+}
+
+static gpointer
+cpu_driver_worker (gpointer data)
+{
+  CpuBatch *batch = NULL;
+  GList *list = NULL;
+
+  g_mutex_lock (&lock);
+
+  while (TRUE) {
+    while (!stopping && g_queue_is_empty (&batches))
+      g_cond_wait (&wakeup, &lock);
+
+    // Flushed draws are finished before the worker stops.
+    if (g_queue_is_empty (&batches))
+      break;
+
+    batch = g_queue_pop_head (&batches);
+    g_mutex_unlock (&lock);
+
+    for (list = batch->draws; list != NULL; list = list->next) {
+      if (!gst_c2d_cpu_render (list->data))
+        GST_WARNING ("Unsupported draw in batch %" G_GSIZE_FORMAT,
+            batch->timestamp);
+    }
+
+    g_mutex_lock (&lock);
+
+    completed = batch->timestamp;
+    g_cond_broadcast (&wakeup);
+
+    cpu_driver_free_draws (batch->draws);
+    g_slice_free (CpuBatch, batch);
+  }
+
+  g_mutex_unlock (&lock);
+  return NULL;
+}
+
+static C2D_STATUS
+cpu_driver_init (C2D_DRIVER_SETUP_INFO * setup)
+{
+  g_mutex_lock (&lock);
+
+  if (refcount++ == 0) {
+    surfaces = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+
+    stopping = FALSE;
+    worker = g_thread_new ("c2d-cpu-driver", cpu_driver_worker, NULL);
+  }
+
+  g_mutex_unlock (&lock);
+  return C2D_STATUS_OK;
+}
+
+static C2D_STATUS
+cpu_driver_deinit (void)
+{
+  GThread *thread = NULL;
+
+  g_mutex_lock (&lock);
+
+  if (refcount > 0 && --refcount == 0) {
+    stopping = TRUE;
+    g_cond_broadcast (&wakeup);
+
+    thread = worker;
+    worker = NULL;
+  }
+
+  g_mutex_unlock (&lock);
+
+  if (thread == NULL)
+    return C2D_STATUS_OK;
+
+  g_thread_join (thread);
+
+  g_mutex_lock (&lock);
+
+  // Another user may have initialized the driver in the meantime.
+  if (refcount == 0) {
+    g_hash_table_destroy (surfaces);
+    surfaces = NULL;
+
+    cpu_driver_free_draws (pending);
+    pending = NULL;
+  }
+
+  g_mutex_unlock (&lock);
+  return C2D_STATUS_OK;
+}
+
+// Byte order of the packed RGB formats, from the first byte in memory.
+static const gchar *
+cpu_driver_rgb_order (uint32 format)
+{
+  gboolean swap = (format & C2D_FORMAT_SWAP_RB) != 0;
+
+  format &= ~(C2D_FORMAT_SWAP_RB | C2D_FORMAT_DISABLE_ALPHA);
+
+  // C2D names the components from the most significant bits of the pixel.
+  switch (format) {
+#if G_BYTE_ORDER == G_BIG_ENDIAN
+    case C2D_COLOR_FORMAT_888_RGB:
+      return swap ? "BGR" : "RGB";
+    case C2D_COLOR_FORMAT_8888_ARGB:
+      return swap ? "ABGR" : "ARGB";
+    case C2D_COLOR_FORMAT_8888_RGBA:
+      return swap ? "BGRA" : "RGBA";
+#else
+    case C2D_COLOR_FORMAT_888_RGB:
+      return swap ? "RGB" : "BGR";
+    case C2D_COLOR_FORMAT_8888_ARGB:
+      return swap ? "RGBA" : "BGRA";
+    case C2D_COLOR_FORMAT_8888_RGBA:
+      return swap ? "ARGB" : "ABGR";
+#endif
+    default:
+      break;
+  }
+  return NULL;
+}
+
+static gboolean
+cpu_driver_parse_surface (C2D_SURFACE_TYPE type, void * definition,
+    GstC2dCpuSurface * surface)
+{
+  memset (surface, 0x00, sizeof (*surface));
+
+  if (type & C2D_SURFACE_RGB_HOST) {
+    C2D_RGB_SURFACE_DEF *rgb = definition;
+    const gchar *order = cpu_driver_rgb_order (rgb->format);
+    guint idx;
+
+    if (NULL == order)
+      return FALSE;
+
+    surface->format = GST_C2D_CPU_FORMAT_RGB;
+    surface->width = rgb->width;
+    surface->height = rgb->height;
+    surface->planes[0] = rgb->buffer;
+    surface->strides[0] = rgb->stride;
+    surface->bpp = strlen (order);
+    surface->offsets[3] = -1;
+    surface->alpha = (surface->bpp == 4) &&
+        !(rgb->format & C2D_FORMAT_DISABLE_ALPHA);
+
+    for (idx = 0; idx < surface->bpp; idx++)
+      surface->offsets[strchr ("RGBA", order[idx]) - "RGBA"] = idx;
+  } else if (type & C2D_SURFACE_YUV_HOST) {
+    C2D_YUV_SURFACE_DEF *yuv = definition;
+
+    if (yuv->format == C2D_COLOR_FORMAT_420_Y_UV)
+      surface->format = GST_C2D_CPU_FORMAT_NV12;
+    else if (yuv->format == C2D_COLOR_FORMAT_420_Y_VU)
+      surface->format = GST_C2D_CPU_FORMAT_NV21;
+    else
+      return FALSE;
+
+    surface->width = yuv->width;
+    surface->height = yuv->height;
+    surface->planes[0] = yuv->plane0;
+    surface->planes[1] = yuv->plane1;
+    surface->strides[0] = yuv->stride0;
+    surface->strides[1] = yuv->stride1;
+  } else {
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static C2D_STATUS
+cpu_driver_create_surface (uint32 * id, uint32 bits, C2D_SURFACE_TYPE type,
+    void * definition)
+{
+  C2D_STATUS status = C2D_STATUS_OK;
+  CpuSurface *surface = NULL;
+
+  if (NULL == definition)
+    return C2D_STATUS_INVALID_PARAM;
+
+  surface = g_new0 (CpuSurface, 1);
+  surface->bilinear = TRUE;
+
+  if (!cpu_driver_parse_surface (type, definition, &surface->surface)) {
+    GST_ERROR ("Unsupported surface type %x", type);
+    g_free (surface);
+    return C2D_STATUS_NOT_SUPPORTED;
+  }
+
+  g_mutex_lock (&lock);
+
+  if (NULL == surfaces) {
+    status = C2D_STATUS_INVALID_PARAM;
+    g_free (surface);
+  } else {
+    // Surface IDs are never 0, the converter uses it as failure value.
+    *id = ++lastid;
+    g_hash_table_insert (surfaces, GUINT_TO_POINTER (*id), surface);
+  }
+
+  g_mutex_unlock (&lock);
+  return status;
+}
+
+static C2D_STATUS
+cpu_driver_destroy_surface (uint32 id)
+{
+  C2D_STATUS status = C2D_STATUS_OK;
+
+  g_mutex_lock (&lock);
+
+  if (NULL == surfaces ||
+      !g_hash_table_remove (surfaces, GUINT_TO_POINTER (id)))
+    status = C2D_STATUS_INVALID_PARAM;
+
+  g_mutex_unlock (&lock);
+  return status;
+}
+
+static C2D_STATUS
+cpu_driver_update_surface (uint32 id, uint32 bits, C2D_SURFACE_TYPE type,
+    void * definition)
+{
+  C2D_STATUS status = C2D_STATUS_OK;
+  GstC2dCpuSurface update;
+  CpuSurface *surface = NULL;
+
+  if (NULL == definition ||
+      !cpu_driver_parse_surface (type, definition, &update))
+    return C2D_STATUS_INVALID_PARAM;
+
+  g_mutex_lock (&lock);
+
+  surface = (surfaces != NULL) ?
+      g_hash_table_lookup (surfaces, GUINT_TO_POINTER (id)) : NULL;
+
+  if (NULL == surface)
+    status = C2D_STATUS_INVALID_PARAM;
+  else
+    surface->surface = update;
+
+  g_mutex_unlock (&lock);
+  return status;
+}
+
+static C2D_STATUS
+cpu_driver_set_surface_filter (uint32 id, gboolean bilinear)
+{
+  C2D_STATUS status = C2D_STATUS_OK;
+  CpuSurface *surface = NULL;
+
+  g_mutex_lock (&lock);
+
+  surface = (surfaces != NULL) ?
+      g_hash_table_lookup (surfaces, GUINT_TO_POINTER (id)) : NULL;
+
+  if (NULL == surface)
+    status = C2D_STATUS_INVALID_PARAM;
+  else
+    surface->bilinear = bilinear;
+
+  g_mutex_unlock (&lock);
+  return status;
+}
+
+// Captures the object with the current surface setup of both surfaces.
+static void
+cpu_driver_setup_draw (GstC2dCpuDraw * draw, const CpuSurface * target,
+    const CpuSurface * source, const C2D_OBJECT * object)
+{
+  uint32 mask = object->config_mask;
+  gint width, height;
+
+  draw->source = source->surface;
+  draw->target = target->surface;
+  draw->bilinear = target->bilinear;
+
+  if (mask & C2D_SOURCE_RECT_BIT) {
+    draw->srcrect.x = object->source_rect.x >> 16;
+    draw->srcrect.y = object->source_rect.y >> 16;
+    draw->srcrect.w = object->source_rect.width >> 16;
+    draw->srcrect.h = object->source_rect.height >> 16;
+  } else {
+    draw->srcrect.x = draw->srcrect.y = 0;
+    draw->srcrect.w = draw->source.width;
+    draw->srcrect.h = draw->source.height;
+  }
+
+  draw->flip_h = (mask & C2D_MIRROR_H_BIT) != 0;
+  draw->flip_v = (mask & C2D_MIRROR_V_BIT) != 0;
+  draw->rotate = 0;
+
+  // C2D rotates counter-clockwise, the renderer clockwise.
+  if (mask & C2D_OVERRIDE_GLOBAL_TARGET_ROTATE_CONFIG) {
+    if ((mask & C2D_OVERRIDE_TARGET_ROTATE_270) ==
+            C2D_OVERRIDE_TARGET_ROTATE_270)
+      draw->rotate = 90;
+    else if ((mask & C2D_OVERRIDE_TARGET_ROTATE_180) ==
+            C2D_OVERRIDE_TARGET_ROTATE_180)
+      draw->rotate = 180;
+    else if ((mask & C2D_OVERRIDE_TARGET_ROTATE_90) ==
+            C2D_OVERRIDE_TARGET_ROTATE_90)
+      draw->rotate = 270;
+  }
+
+  if (mask & C2D_TARGET_RECT_BIT) {
+    width = object->target_rect.width >> 16;
+    height = object->target_rect.height >> 16;
+
+    draw->destrect.x = object->target_rect.x >> 16;
+    draw->destrect.y = object->target_rect.y >> 16;
+
+    // The target rectangle is given before rotation.
+    draw->destrect.w = (draw->rotate % 180) ? height : width;
+    draw->destrect.h = (draw->rotate % 180) ? width : height;
+  } else {
+    draw->destrect.x = draw->destrect.y = 0;
+    draw->destrect.w = draw->target.width;
+    draw->destrect.h = draw->target.height;
+  }
+}
+
+static C2D_STATUS
+cpu_driver_draw (uint32 id, uint32 config, C2D_RECT * scissor, uint32 mask,
+    uint32 color_key, C2D_OBJECT * objects, uint32 count)
+{
+  C2D_STATUS status = C2D_STATUS_OK;
+  CpuSurface *target = NULL, *source = NULL;
+  GList *draws = NULL;
+  guint idx = 0;
+
+  g_mutex_lock (&lock);
+
+  target = (surfaces != NULL) ?
+      g_hash_table_lookup (surfaces, GUINT_TO_POINTER (id)) : NULL;
+
+  if (NULL == target) {
+    g_mutex_unlock (&lock);
+    return C2D_STATUS_INVALID_PARAM;
+  }
+
+  // Objects are chained through their next pointers, count is unused.
+  for (; objects != NULL; objects = objects->next, idx++) {
+    GstC2dCpuDraw *draw = NULL;
+
+    source = g_hash_table_lookup (surfaces,
+        GUINT_TO_POINTER (objects->surface_id));
+
+    if (NULL == source) {
+      status = C2D_STATUS_INVALID_PARAM;
+      break;
+    }
+
+    draw = g_new0 (GstC2dCpuDraw, 1);
+    cpu_driver_setup_draw (draw, target, source, objects);
+    draws = g_list_append (draws, draw);
+  }
+
+  if (C2D_STATUS_OK == status) {
+    GST_LOG ("Queued %u objects for target surface %x", idx, id);
+    pending = g_list_concat (pending, draws);
+  } else {
+    cpu_driver_free_draws (draws);
+  }
+
+  g_mutex_unlock (&lock);
+  return status;
+}
+
+static C2D_STATUS
+cpu_driver_flush (uint32 id, c2d_ts_handle * handle)
+{
+  CpuBatch *batch = NULL;
+
+  g_mutex_lock (&lock);
+
+  // Draws complete in submission order, a timestamp covers all draws
+  // queued before it.
+  batch = g_slice_new0 (CpuBatch);
+  batch->draws = pending;
+  batch->timestamp = ++timestamp;
+  pending = NULL;
+
+  GST_LOG ("Flushed %u draws for target surface %x",
+      g_list_length (batch->draws), id);
+
+  g_queue_push_tail (&batches, batch);
+  g_cond_broadcast (&wakeup);
+
+  *handle = (c2d_ts_handle) GSIZE_TO_POINTER (batch->timestamp);
+
+  g_mutex_unlock (&lock);
+  return C2D_STATUS_OK;
+}
+
+static C2D_STATUS
+cpu_driver_wait_timestamp (c2d_ts_handle handle)
+{
+  C2D_STATUS status = C2D_STATUS_OK;
+  gsize value = GPOINTER_TO_SIZE (handle);
+
+  g_mutex_lock (&lock);
+
+  if (value == 0 || value > timestamp)
+    status = C2D_STATUS_INVALID_PARAM;
+
+  while (C2D_STATUS_OK == status && completed < value)
+    g_cond_wait (&wakeup, &lock);
+
+  g_mutex_unlock (&lock);
+  return status;
+}
+
+static C2D_STATUS
+cpu_driver_finish (uint32 id)
+{
+  c2d_ts_handle handle = NULL;
+
+  cpu_driver_flush (id, &handle);
+  return cpu_driver_wait_timestamp (handle);
+}
+
+static C2D_STATUS
+cpu_driver_map_addr (int32_t fd, void * vaddr, uint32 size, uint32 offset,
+    uint32 flags, void ** gpuaddr)
+{
+  // There is no separate GPU address space, use the CPU mapping.
+  *gpuaddr = (guint8 *) vaddr + offset;
+  return C2D_STATUS_OK;
+}
+
+static C2D_STATUS
+cpu_driver_unmap_addr (void * gpuaddr)
+{
+  return C2D_STATUS_OK;
+}
+
+static C2D_STATUS
+cpu_driver_get_capabilities (C2D_DRIVER_INFO * caps)
+{
+  memset (caps, 0x00, sizeof (*caps));
+
+  caps->max_surface_width = CPU_DRIVER_MAX_DIMENSION;
+  caps->max_surface_height = CPU_DRIVER_MAX_DIMENSION;
+  return C2D_STATUS_OK;
+}
+
+void
+gst_c2d_cpu_driver_setup (GstC2dDriver * driver)
+{
+  driver->DriverInit = cpu_driver_init;
+  driver->DriverDeInit = cpu_driver_deinit;
+  driver->CreateSurface = cpu_driver_create_surface;
+  driver->DestroySurface = cpu_driver_destroy_surface;
+  driver->UpdateSurface = cpu_driver_update_surface;
+  driver->Draw = cpu_driver_draw;
+  driver->Flush = cpu_driver_flush;
+  driver->WaitTimestamp = cpu_driver_wait_timestamp;
+  driver->Finish = cpu_driver_finish;
+  driver->MapAddr = cpu_driver_map_addr;
+  driver->UnMapAddr = cpu_driver_unmap_addr;
+  driver->GetDriverCapabilities = cpu_driver_get_capabilities;
+  driver->SetSurfaceFilter = cpu_driver_set_surface_filter;
+}
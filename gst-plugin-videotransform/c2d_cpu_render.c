@@ -0,0 +1,897 @@
+/*
+* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "c2d_cpu_render.h"
+
+#include <string.h>
+
+// The tests build the renderer a second time with CPU_RENDER_NO_SIMD and
+// expect both builds to produce identical pixels.
+#if defined(CPU_RENDER_NO_SIMD)
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define CPU_RENDER_USE_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define CPU_RENDER_USE_SSE2
+#endif
+
+// Upper limit of threads working on a single draw, including the caller.
+#define CPU_RENDER_MAX_THREADS    8
+// Smaller slices are not worth the thread hand over.
+#define CPU_RENDER_MIN_SLICE_ROWS 32
+
+#define CPU_RENDER_FIXED(value) ((gint64) ((value) * 65536.0 + \
+    (((value) < 0) ? -0.5 : 0.5)))
+
+typedef struct _CpuPlane CpuPlane;
+typedef struct _CpuMapping CpuMapping;
+typedef struct _CpuContext CpuContext;
+typedef struct _CpuSlice CpuSlice;
+
+struct _CpuPlane
+{
+  const guint8 *data;
+  gint         stride;
+  gint         width;
+  gint         height;
+  gint         channels;
+};
+
+// Maps destination pixel centers to source coordinates in 16.16 fixed
+// point: source = origin + dx * step along x + dy * step along y.
+struct _CpuMapping
+{
+  gint64       x0;
+  gint64       xdx;
+  gint64       xdy;
+  gint64       y0;
+  gint64       ydx;
+  gint64       ydy;
+
+  // Without 90 degree rotation source columns depend only on dx and source
+  // rows only on dy, the columns are resolved once per draw.
+  gboolean     aligned;
+  gint         *xindex;
+  guint8       *xweight;
+  gint         xmin;
+  gint         xmax;
+  // Source columns are consecutive and unfiltered, rows are copied.
+  gboolean     contiguous;
+};
+
+struct _CpuContext
+{
+  const GstC2dCpuDraw *draw;
+
+  CpuPlane     luma;
+  CpuPlane     chroma;
+
+  // Mapping of the first source plane to the target pixels and of the
+  // chroma plane to the target chroma samples, or to the target pixels
+  // when the target is RGB.
+  CpuMapping   lmap;
+  CpuMapping   cmap;
+
+  gint         width;
+  gint         height;
+  gsize        scratchsize;
+};
+
+struct _CpuSlice
+{
+  CpuContext   *context;
+  gint         start;
+  gint         end;
+
+  // Completion of the slices handed to the pool.
+  GMutex       *lock;
+  GCond        *done;
+  guint        *remaining;
+};
+
+static GThreadPool *pool = NULL;
+static guint n_threads = 1;
+
+static inline guint8
+clamp_u8 (gint value)
+{
+  return (value < 0) ? 0 : ((value > 255) ? 255 : value);
+}
+
+static inline gboolean
+is_yuv (const GstC2dCpuSurface * surface)
+{
+  return surface->format == GST_C2D_CPU_FORMAT_NV12 ||
+      surface->format == GST_C2D_CPU_FORMAT_NV21;
+}
+
+// Blends two rows, weight is the share of the second row out of 256.
+static void
+blend_rows (guint8 * dest, const guint8 * row0, const guint8 * row1,
+    gint size, guint weight)
+{
+  const guint w0 = 256 - weight, w1 = weight;
+  gint idx = 0;
+
+#if defined(CPU_RENDER_USE_NEON)
+  const uint8x8_t v0 = vdup_n_u8 (w0), v1 = vdup_n_u8 (w1);
+
+  for (; (idx + 16) <= size; idx += 16) {
+    uint8x16_t a = vld1q_u8 (row0 + idx);
+    uint8x16_t b = vld1q_u8 (row1 + idx);
+    uint16x8_t lo = vmull_u8 (vget_low_u8 (a), v0);
+    uint16x8_t hi = vmull_u8 (vget_high_u8 (a), v0);
+
+    lo = vmlal_u8 (lo, vget_low_u8 (b), v1);
+    hi = vmlal_u8 (hi, vget_high_u8 (b), v1);
+
+    vst1q_u8 (dest + idx,
+        vcombine_u8 (vrshrn_n_u16 (lo, 8), vrshrn_n_u16 (hi, 8)));
+  }
+#elif defined(CPU_RENDER_USE_SSE2)
+  const __m128i zero = _mm_setzero_si128 ();
+  const __m128i v0 = _mm_set1_epi16 (w0), v1 = _mm_set1_epi16 (w1);
+  const __m128i round = _mm_set1_epi16 (128);
+
+  for (; (idx + 16) <= size; idx += 16) {
+    __m128i a = _mm_loadu_si128 ((const __m128i *) (row0 + idx));
+    __m128i b = _mm_loadu_si128 ((const __m128i *) (row1 + idx));
+    __m128i lo, hi;
+
+    lo = _mm_add_epi16 (_mm_mullo_epi16 (_mm_unpacklo_epi8 (a, zero), v0),
+        _mm_mullo_epi16 (_mm_unpacklo_epi8 (b, zero), v1));
+    hi = _mm_add_epi16 (_mm_mullo_epi16 (_mm_unpackhi_epi8 (a, zero), v0),
+        _mm_mullo_epi16 (_mm_unpackhi_epi8 (b, zero), v1));
+
+    lo = _mm_srli_epi16 (_mm_add_epi16 (lo, round), 8);
+    hi = _mm_srli_epi16 (_mm_add_epi16 (hi, round), 8);
+
+    _mm_storeu_si128 ((__m128i *) (dest + idx), _mm_packus_epi16 (lo, hi));
+  }
+#endif
+
+  for (; idx < size; idx++)
+    dest[idx] = (row0[idx] * w0 + row1[idx] * w1 + 128) >> 8;
+}
+
+// BT.601 limited range YUV to RGB, chroma holds one U and V pair per pixel.
+static void
+yuv_to_rgb_row (guint8 * red, guint8 * green, guint8 * blue,
+    const guint8 * luma, const guint8 * chroma, gint uoffset, gint width)
+{
+  const gint voffset = 1 - uoffset;
+  gint idx = 0;
+
+#if defined(CPU_RENDER_USE_NEON)
+  for (; (idx + 8) <= width; idx += 8) {
+    uint8x8x2_t uv = vld2_u8 (chroma + (idx * 2));
+    int16x8_t c = vreinterpretq_s16_u16 (
+        vsubl_u8 (vld1_u8 (luma + idx), vdup_n_u8 (16)));
+    int16x8_t d = vreinterpretq_s16_u16 (
+        vsubl_u8 (uv.val[uoffset], vdup_n_u8 (128)));
+    int16x8_t e = vreinterpretq_s16_u16 (
+        vsubl_u8 (uv.val[voffset], vdup_n_u8 (128)));
+    int32x4_t rl, rh, gl, gh, bl, bh;
+
+    rl = vmull_n_s16 (vget_low_s16 (c), 298);
+    rh = vmull_n_s16 (vget_high_s16 (c), 298);
+    gl = rl;
+    gh = rh;
+    bl = rl;
+    bh = rh;
+
+    rl = vmlal_n_s16 (rl, vget_low_s16 (e), 409);
+    rh = vmlal_n_s16 (rh, vget_high_s16 (e), 409);
+
+    gl = vmlal_n_s16 (gl, vget_low_s16 (d), -100);
+    gh = vmlal_n_s16 (gh, vget_high_s16 (d), -100);
+    gl = vmlal_n_s16 (gl, vget_low_s16 (e), -208);
+    gh = vmlal_n_s16 (gh, vget_high_s16 (e), -208);
+
+    bl = vmlal_n_s16 (bl, vget_low_s16 (d), 516);
+    bh = vmlal_n_s16 (bh, vget_high_s16 (d), 516);
+
+    vst1_u8 (red + idx, vqmovn_u16 (vcombine_u16 (
+        vqrshrun_n_s32 (rl, 8), vqrshrun_n_s32 (rh, 8))));
+    vst1_u8 (green + idx, vqmovn_u16 (vcombine_u16 (
+        vqrshrun_n_s32 (gl, 8), vqrshrun_n_s32 (gh, 8))));
+    vst1_u8 (blue + idx, vqmovn_u16 (vcombine_u16 (
+        vqrshrun_n_s32 (bl, 8), vqrshrun_n_s32 (bh, 8))));
+  }
+#elif defined(CPU_RENDER_USE_SSE2)
+  const __m128i zero = _mm_setzero_si128 ();
+  const __m128i mask = _mm_set1_epi16 (0x00FF);
+  const __m128i round = _mm_set1_epi32 (128);
+  const __m128i ycoef = _mm_set1_epi16 (16), ccoef = _mm_set1_epi16 (128);
+  // Coefficient pairs for the interleaved (Y, V), (Y, U) and (V, 0) terms.
+  const __m128i rcoef = _mm_set_epi16 (409, 298, 409, 298, 409, 298, 409,
+      298);
+  const __m128i gcoef0 = _mm_set_epi16 (-100, 298, -100, 298, -100, 298,
+      -100, 298);
+  const __m128i gcoef1 = _mm_set_epi16 (0, -208, 0, -208, 0, -208, 0, -208);
+  const __m128i bcoef = _mm_set_epi16 (516, 298, 516, 298, 516, 298, 516,
+      298);
+
+  for (; (idx + 8) <= width; idx += 8) {
+    __m128i y = _mm_loadl_epi64 ((const __m128i *) (luma + idx));
+    __m128i uv = _mm_loadu_si128 ((const __m128i *) (chroma + (idx * 2)));
+    __m128i even = _mm_and_si128 (uv, mask);
+    __m128i odd = _mm_srli_epi16 (uv, 8);
+    __m128i c, d, e, lo, hi, r, g, b;
+
+    c = _mm_sub_epi16 (_mm_unpacklo_epi8 (y, zero), ycoef);
+    d = _mm_sub_epi16 ((uoffset == 0) ? even : odd, ccoef);
+    e = _mm_sub_epi16 ((uoffset == 0) ? odd : even, ccoef);
+
+    lo = _mm_madd_epi16 (_mm_unpacklo_epi16 (c, e), rcoef);
+    hi = _mm_madd_epi16 (_mm_unpackhi_epi16 (c, e), rcoef);
+    lo = _mm_srai_epi32 (_mm_add_epi32 (lo, round), 8);
+    hi = _mm_srai_epi32 (_mm_add_epi32 (hi, round), 8);
+    r = _mm_packs_epi32 (lo, hi);
+
+    lo = _mm_add_epi32 (_mm_madd_epi16 (_mm_unpacklo_epi16 (c, d), gcoef0),
+        _mm_madd_epi16 (_mm_unpacklo_epi16 (e, zero), gcoef1));
+    hi = _mm_add_epi32 (_mm_madd_epi16 (_mm_unpackhi_epi16 (c, d), gcoef0),
+        _mm_madd_epi16 (_mm_unpackhi_epi16 (e, zero), gcoef1));
+    lo = _mm_srai_epi32 (_mm_add_epi32 (lo, round), 8);
+    hi = _mm_srai_epi32 (_mm_add_epi32 (hi, round), 8);
+    g = _mm_packs_epi32 (lo, hi);
+
+    lo = _mm_madd_epi16 (_mm_unpacklo_epi16 (c, d), bcoef);
+    hi = _mm_madd_epi16 (_mm_unpackhi_epi16 (c, d), bcoef);
+    lo = _mm_srai_epi32 (_mm_add_epi32 (lo, round), 8);
+    hi = _mm_srai_epi32 (_mm_add_epi32 (hi, round), 8);
+    b = _mm_packs_epi32 (lo, hi);
+
+    _mm_storel_epi64 ((__m128i *) (red + idx), _mm_packus_epi16 (r, r));
+    _mm_storel_epi64 ((__m128i *) (green + idx), _mm_packus_epi16 (g, g));
+    _mm_storel_epi64 ((__m128i *) (blue + idx), _mm_packus_epi16 (b, b));
+  }
+#endif
+
+  for (; idx < width; idx++) {
+    gint c = luma[idx] - 16;
+    gint d = chroma[(idx * 2) + uoffset] - 128;
+    gint e = chroma[(idx * 2) + voffset] - 128;
+
+    red[idx] = clamp_u8 ((298 * c + 409 * e + 128) >> 8);
+    green[idx] = clamp_u8 ((298 * c - 100 * d - 208 * e + 128) >> 8);
+    blue[idx] = clamp_u8 ((298 * c + 516 * d + 128) >> 8);
+  }
+}
+
+static inline guint8
+rgb_to_y (gint r, gint g, gint b)
+{
+  return clamp_u8 (((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+}
+
+static inline guint8
+rgb_to_u (gint r, gint g, gint b)
+{
+  return clamp_u8 (((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+}
+
+static inline guint8
+rgb_to_v (gint r, gint g, gint b)
+{
+  return clamp_u8 (((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+}
+
+static void
+mapping_init (CpuMapping * map, const GstC2dCpuDraw * draw,
+    const CpuPlane * plane, gdouble x, gdouble y, gdouble w, gdouble h,
+    gint width, gint height)
+{
+  gboolean swap = (draw->rotate == 90) || (draw->rotate == 270);
+  gint uwidth = swap ? height : width, uheight = swap ? width : height;
+  gint au, bu, cu, av, bv, cv, idx;
+  gdouble kx = w / uwidth, ky = h / uheight;
+
+  // Destination pixel (dx, dy) shows pixel (u, v) of the scaled and
+  // mirrored source region before rotation.
+  switch (draw->rotate) {
+    case 90:
+      au = 0; bu = 1; cu = 0;
+      av = -1; bv = 0; cv = uheight - 1;
+      break;
+    case 180:
+      au = -1; bu = 0; cu = uwidth - 1;
+      av = 0; bv = -1; cv = uheight - 1;
+      break;
+    case 270:
+      au = 0; bu = -1; cu = uwidth - 1;
+      av = 1; bv = 0; cv = 0;
+      break;
+    default:
+      au = 1; bu = 0; cu = 0;
+      av = 0; bv = 1; cv = 0;
+      break;
+  }
+
+  if (draw->flip_h) {
+    au = -au; bu = -bu; cu = uwidth - 1 - cu;
+  }
+
+  if (draw->flip_v) {
+    av = -av; bv = -bv; cv = uheight - 1 - cv;
+  }
+
+  map->x0 = CPU_RENDER_FIXED (x + kx * (cu + 0.5) - 0.5);
+  map->xdx = CPU_RENDER_FIXED (kx * au);
+  map->xdy = CPU_RENDER_FIXED (kx * bu);
+
+  map->y0 = CPU_RENDER_FIXED (y + ky * (cv + 0.5) - 0.5);
+  map->ydx = CPU_RENDER_FIXED (ky * av);
+  map->ydy = CPU_RENDER_FIXED (ky * bv);
+
+  map->aligned = (map->xdy == 0) && (map->ydx == 0);
+  map->xindex = NULL;
+  map->xweight = NULL;
+  map->contiguous = FALSE;
+
+  if (!map->aligned)
+    return;
+
+  map->xindex = g_new (gint, width);
+  map->xweight = g_new (guint8, width);
+  map->xmin = plane->width - 1;
+  map->xmax = 0;
+  map->contiguous = TRUE;
+
+  for (idx = 0; idx < width; idx++) {
+    gint64 sx = map->x0 + idx * map->xdx;
+    gint index, weight = 0;
+
+    if (draw->bilinear) {
+      index = (sx < 0) ? 0 : (gint) (sx >> 16);
+      weight = (sx < 0) ? 0 : (gint) ((sx >> 8) & 0xFF);
+
+      if (index >= (plane->width - 1)) {
+        index = plane->width - 1;
+        weight = 0;
+      }
+    } else {
+      index = CLAMP ((gint) ((sx + 32768) >> 16), 0, plane->width - 1);
+    }
+
+    map->xindex[idx] = index;
+    map->xweight[idx] = weight;
+
+    map->xmin = MIN (map->xmin, index);
+    map->xmax = MAX (map->xmax, (weight != 0) ? (index + 1) : index);
+
+    if (weight != 0 || (idx > 0 && index != (map->xindex[idx - 1] + 1)))
+      map->contiguous = FALSE;
+  }
+}
+
+static void
+mapping_clear (CpuMapping * map)
+{
+  g_free (map->xindex);
+  g_free (map->xweight);
+}
+
+// Samples one destination row of a plane, scratch holds a source row.
+static void
+sample_row (const CpuPlane * plane, const CpuMapping * map, gboolean bilinear,
+    gint dy, gint width, guint8 * dest, guint8 * scratch)
+{
+  const gint channels = plane->channels;
+  const guint8 *row = NULL;
+  gint idx, num;
+
+  if (map->aligned) {
+    gint64 sy = map->y0 + dy * map->ydy;
+    gint yindex, weight = 0;
+
+    if (bilinear) {
+      yindex = (sy < 0) ? 0 : (gint) (sy >> 16);
+      weight = (sy < 0) ? 0 : (gint) ((sy >> 8) & 0xFF);
+
+      if (yindex >= (plane->height - 1)) {
+        yindex = plane->height - 1;
+        weight = 0;
+      }
+    } else {
+      yindex = CLAMP ((gint) ((sy + 32768) >> 16), 0, plane->height - 1);
+    }
+
+    row = plane->data + (yindex * plane->stride) + (map->xmin * channels);
+
+    // Vertical pass over the used source columns only.
+    if (weight != 0) {
+      blend_rows (scratch, row, row + plane->stride,
+          (map->xmax - map->xmin + 1) * channels, weight);
+      row = scratch;
+    }
+
+    if (map->contiguous) {
+      memcpy (dest, row + ((map->xindex[0] - map->xmin) * channels),
+          width * channels);
+      return;
+    }
+
+    for (idx = 0; idx < width; idx++, dest += channels) {
+      const guint8 *pixel = row + ((map->xindex[idx] - map->xmin) * channels);
+      guint w1 = map->xweight[idx], w0 = 256 - w1;
+
+      if (w1 == 0) {
+        for (num = 0; num < channels; num++)
+          dest[num] = pixel[num];
+      } else {
+        for (num = 0; num < channels; num++)
+          dest[num] = (pixel[num] * w0 + pixel[num + channels] * w1 + 128) >> 8;
+      }
+    }
+    return;
+  }
+
+  // Rotated by 90 degrees, source coordinates change along both axes.
+  for (idx = 0; idx < width; idx++, dest += channels) {
+    gint64 sx = map->x0 + idx * map->xdx + dy * map->xdy;
+    gint64 sy = map->y0 + idx * map->ydx + dy * map->ydy;
+
+    if (bilinear) {
+      gint x0 = CLAMP ((gint) (sx >> 16), 0, plane->width - 1);
+      gint y0 = CLAMP ((gint) (sy >> 16), 0, plane->height - 1);
+      gint x1 = MIN (x0 + 1, plane->width - 1);
+      gint y1 = MIN (y0 + 1, plane->height - 1);
+      guint wx = (sx < 0) ? 0 : ((sx >> 8) & 0xFF);
+      guint wy = (sy < 0) ? 0 : ((sy >> 8) & 0xFF);
+      const guint8 *r0 = plane->data + (y0 * plane->stride);
+      const guint8 *r1 = plane->data + (y1 * plane->stride);
+
+      for (num = 0; num < channels; num++) {
+        guint top = r0[x0 * channels + num] * (256 - wx) +
+            r0[x1 * channels + num] * wx;
+        guint bottom = r1[x0 * channels + num] * (256 - wx) +
+            r1[x1 * channels + num] * wx;
+
+        dest[num] = (top * (256 - wy) + bottom * wy + 32768) >> 16;
+      }
+    } else {
+      gint x = CLAMP ((gint) ((sx + 32768) >> 16), 0, plane->width - 1);
+      gint y = CLAMP ((gint) ((sy + 32768) >> 16), 0, plane->height - 1);
+      const guint8 *pixel = plane->data + (y * plane->stride) + (x * channels);
+
+      for (num = 0; num < channels; num++)
+        dest[num] = pixel[num];
+    }
+  }
+}
+
+// Packs planar red, green and blue rows into the target pixel layout.
+static void
+pack_rgb_row (const GstC2dCpuSurface * target, guint8 * dest,
+    const guint8 * red, const guint8 * green, const guint8 * blue,
+    gint width)
+{
+  const gint roff = target->offsets[0], goff = target->offsets[1];
+  const gint boff = target->offsets[2], aoff = target->offsets[3];
+  const guint bpp = target->bpp;
+  gint idx;
+
+  for (idx = 0; idx < width; idx++, dest += bpp) {
+    dest[roff] = red[idx];
+    dest[goff] = green[idx];
+    dest[boff] = blue[idx];
+
+    if (aoff >= 0)
+      dest[aoff] = 0xFF;
+  }
+}
+
+// Reorders source RGB pixels into the target layout.
+static void
+convert_rgb_row (const GstC2dCpuSurface * source,
+    const GstC2dCpuSurface * target, guint8 * dest, const guint8 * src,
+    gint width)
+{
+  const gint sbpp = source->bpp, tbpp = target->bpp;
+  const gint *soff = source->offsets, *toff = target->offsets;
+  gboolean alpha = source->alpha && (soff[3] >= 0);
+  gint idx;
+
+  for (idx = 0; idx < width; idx++, dest += tbpp, src += sbpp) {
+    dest[toff[0]] = src[soff[0]];
+    dest[toff[1]] = src[soff[1]];
+    dest[toff[2]] = src[soff[2]];
+
+    if (toff[3] >= 0)
+      dest[toff[3]] = alpha ? src[soff[3]] : 0xFF;
+  }
+}
+
+static gboolean
+same_rgb_layout (const GstC2dCpuSurface * source,
+    const GstC2dCpuSurface * target)
+{
+  return (source->bpp == target->bpp) &&
+      (memcmp (source->offsets, target->offsets, sizeof (source->offsets))
+          == 0) && (source->alpha || !target->alpha);
+}
+
+static void
+render_yuv_to_yuv (CpuContext * context, gint start, gint end,
+    guint8 * scratch)
+{
+  const GstC2dCpuDraw *draw = context->draw;
+  const GstC2dCpuSurface *target = &draw->target;
+  gboolean swap = (draw->source.format != target->format);
+  gint dy, idx, cwidth = (context->width + 1) / 2;
+
+  for (dy = start; dy < end; dy++) {
+    gint y = draw->destrect.y + dy;
+    guint8 *dest = target->planes[0] + (y * target->strides[0]) +
+        draw->destrect.x;
+
+    sample_row (&context->luma, &context->lmap, draw->bilinear, dy,
+        context->width, dest, scratch);
+
+    if ((dy % 2) != 0)
+      continue;
+
+    dest = target->planes[1] + ((y / 2) * target->strides[1]) +
+        (draw->destrect.x & ~1);
+
+    sample_row (&context->chroma, &context->cmap, draw->bilinear, dy / 2,
+        cwidth, dest, scratch);
+
+    // NV12 and NV21 differ only in the order of the chroma samples.
+    for (idx = 0; swap && idx < cwidth; idx++) {
+      guint8 value = dest[idx * 2];
+
+      dest[idx * 2] = dest[idx * 2 + 1];
+      dest[idx * 2 + 1] = value;
+    }
+  }
+}
+
+static void
+render_yuv_to_rgb (CpuContext * context, gint start, gint end,
+    guint8 * scratch)
+{
+  const GstC2dCpuDraw *draw = context->draw;
+  const GstC2dCpuSurface *target = &draw->target;
+  const gint width = context->width;
+  gint dy, uoffset = (draw->source.format == GST_C2D_CPU_FORMAT_NV12) ? 0 : 1;
+  guint8 *luma = scratch, *chroma = luma + width, *red = chroma + width * 2;
+  guint8 *green = red + width, *blue = green + width;
+
+  scratch = blue + width;
+
+  for (dy = start; dy < end; dy++) {
+    gint y = draw->destrect.y + dy;
+    guint8 *dest = target->planes[0] + (y * target->strides[0]) +
+        (draw->destrect.x * target->bpp);
+
+    sample_row (&context->luma, &context->lmap, draw->bilinear, dy, width,
+        luma, scratch);
+    sample_row (&context->chroma, &context->cmap, draw->bilinear, dy, width,
+        chroma, scratch);
+
+    yuv_to_rgb_row (red, green, blue, luma, chroma, uoffset, width);
+    pack_rgb_row (target, dest, red, green, blue, width);
+  }
+}
+
+static void
+render_rgb_to_yuv (CpuContext * context, gint start, gint end,
+    guint8 * scratch)
+{
+  const GstC2dCpuDraw *draw = context->draw;
+  const GstC2dCpuSurface *source = &draw->source;
+  const GstC2dCpuSurface *target = &draw->target;
+  const gint width = context->width, bpp = source->bpp;
+  const gint *off = source->offsets;
+  gint uoffset = (target->format == GST_C2D_CPU_FORMAT_NV12) ? 0 : 1;
+  guint8 *rows[2] = { scratch, scratch + width * bpp };
+  gint dy, idx, num;
+
+  scratch = rows[1] + width * bpp;
+
+  // Slices start on even rows, chroma is taken from pairs of rows.
+  for (dy = start; dy < end; dy += 2) {
+    gint y = draw->destrect.y + dy;
+    gint n_rows = MIN (2, end - dy);
+    guint8 *dest = NULL;
+
+    for (num = 0; num < n_rows; num++) {
+      const guint8 *pixel = rows[num];
+
+      sample_row (&context->luma, &context->lmap, draw->bilinear, dy + num,
+          width, rows[num], scratch);
+
+      dest = target->planes[0] + ((y + num) * target->strides[0]) +
+          draw->destrect.x;
+
+      for (idx = 0; idx < width; idx++, pixel += bpp)
+        dest[idx] = rgb_to_y (pixel[off[0]], pixel[off[1]], pixel[off[2]]);
+    }
+
+    if (n_rows == 1)
+      memcpy (rows[1], rows[0], width * bpp);
+
+    dest = target->planes[1] + ((y / 2) * target->strides[1]) +
+        (draw->destrect.x & ~1);
+
+    for (idx = 0; idx < width; idx += 2, dest += 2) {
+      const guint8 *p0 = rows[0] + (idx * bpp), *p1 = rows[1] + (idx * bpp);
+      gint next = (idx + 1 < width) ? bpp : 0;
+      gint r, g, b;
+
+      r = (p0[off[0]] + p0[next + off[0]] + p1[off[0]] + p1[next + off[0]] +
+          2) >> 2;
+      g = (p0[off[1]] + p0[next + off[1]] + p1[off[1]] + p1[next + off[1]] +
+          2) >> 2;
+      b = (p0[off[2]] + p0[next + off[2]] + p1[off[2]] + p1[next + off[2]] +
+          2) >> 2;
+
+      dest[uoffset] = rgb_to_u (r, g, b);
+      dest[1 - uoffset] = rgb_to_v (r, g, b);
+    }
+  }
+}
+
+static void
+render_rgb_to_rgb (CpuContext * context, gint start, gint end,
+    guint8 * scratch)
+{
+  const GstC2dCpuDraw *draw = context->draw;
+  const GstC2dCpuSurface *source = &draw->source;
+  const GstC2dCpuSurface *target = &draw->target;
+  gboolean same = same_rgb_layout (source, target);
+  guint8 *row = scratch;
+  gint dy;
+
+  scratch = row + context->width * source->bpp;
+
+  for (dy = start; dy < end; dy++) {
+    gint y = draw->destrect.y + dy;
+    guint8 *dest = target->planes[0] + (y * target->strides[0]) +
+        (draw->destrect.x * target->bpp);
+
+    if (same) {
+      sample_row (&context->luma, &context->lmap, draw->bilinear, dy,
+          context->width, dest, scratch);
+    } else {
+      sample_row (&context->luma, &context->lmap, draw->bilinear, dy,
+          context->width, row, scratch);
+      convert_rgb_row (source, target, dest, row, context->width);
+    }
+  }
+}
+
+static void
+render_slice (CpuSlice * slice)
+{
+  CpuContext *context = slice->context;
+  const GstC2dCpuDraw *draw = context->draw;
+  guint8 *scratch = g_malloc (context->scratchsize);
+
+  if (is_yuv (&draw->source) && is_yuv (&draw->target))
+    render_yuv_to_yuv (context, slice->start, slice->end, scratch);
+  else if (is_yuv (&draw->source))
+    render_yuv_to_rgb (context, slice->start, slice->end, scratch);
+  else if (is_yuv (&draw->target))
+    render_rgb_to_yuv (context, slice->start, slice->end, scratch);
+  else
+    render_rgb_to_rgb (context, slice->start, slice->end, scratch);
+
+  g_free (scratch);
+}
+
+static void
+render_slice_func (gpointer data, gpointer userdata)
+{
+  CpuSlice *slice = data;
+
+  render_slice (slice);
+
+  g_mutex_lock (slice->lock);
+  if (--(*slice->remaining) == 0)
+    g_cond_signal (slice->done);
+  g_mutex_unlock (slice->lock);
+}
+
+static gpointer
+create_pool (gpointer data)
+{
+  n_threads = CLAMP (g_get_num_processors (), 1, CPU_RENDER_MAX_THREADS);
+
+  // The calling thread renders the first slice itself.
+  if (n_threads > 1)
+    pool = g_thread_pool_new (render_slice_func, NULL, n_threads - 1, FALSE,
+        NULL);
+
+  if (pool == NULL)
+    n_threads = 1;
+
+  return NULL;
+}
+
+static void
+plane_init (CpuPlane * plane, const GstC2dCpuSurface * surface, guint index)
+{
+  plane->data = surface->planes[index];
+  plane->stride = surface->strides[index];
+
+  if (surface->format == GST_C2D_CPU_FORMAT_RGB) {
+    plane->width = surface->width;
+    plane->height = surface->height;
+    plane->channels = surface->bpp;
+  } else if (index == 0) {
+    plane->width = surface->width;
+    plane->height = surface->height;
+    plane->channels = 1;
+  } else {
+    plane->width = (surface->width + 1) / 2;
+    plane->height = (surface->height + 1) / 2;
+    plane->channels = 2;
+  }
+}
+
+static gboolean
+surface_is_valid (const GstC2dCpuSurface * surface)
+{
+  if (surface->width <= 0 || surface->height <= 0 ||
+      surface->planes[0] == NULL)
+    return FALSE;
+
+  switch (surface->format) {
+    case GST_C2D_CPU_FORMAT_NV12:
+    case GST_C2D_CPU_FORMAT_NV21:
+      return surface->planes[1] != NULL;
+    case GST_C2D_CPU_FORMAT_RGB:
+      return surface->bpp == 3 || surface->bpp == 4;
+    default:
+      break;
+  }
+  return FALSE;
+}
+
+gboolean
+gst_c2d_cpu_render (const GstC2dCpuDraw * draw)
+{
+  static GOnce once = G_ONCE_INIT;
+  const GstC2dCpuSurface *source = &draw->source, *target = &draw->target;
+  const GstC2dCpuRect *srcrect = &draw->srcrect;
+  CpuContext context;
+  CpuSlice *slices = NULL;
+  GMutex lock;
+  GCond done;
+  guint idx, n_slices, remaining = 0;
+  gint rows, width;
+
+  if (!surface_is_valid (source) || !surface_is_valid (target))
+    return FALSE;
+
+  if (draw->rotate != 0 && draw->rotate != 90 && draw->rotate != 180 &&
+      draw->rotate != 270)
+    return FALSE;
+
+  // Regions are expected to be clamped to their surfaces.
+  if (srcrect->x < 0 || srcrect->y < 0 || srcrect->w <= 0 ||
+      srcrect->h <= 0 || (srcrect->x + srcrect->w) > source->width ||
+      (srcrect->y + srcrect->h) > source->height)
+    return FALSE;
+
+  if (draw->destrect.x < 0 || draw->destrect.y < 0 ||
+      draw->destrect.w <= 0 || draw->destrect.h <= 0 ||
+      (draw->destrect.x + draw->destrect.w) > target->width ||
+      (draw->destrect.y + draw->destrect.h) > target->height)
+    return FALSE;
+
+  // Chroma of the target is subsampled, keep the region on even pixels.
+  if (is_yuv (target) && ((draw->destrect.x % 2) || (draw->destrect.y % 2)))
+    return FALSE;
+
+  g_once (&once, create_pool, NULL);
+
+  context.draw = draw;
+  context.width = width = draw->destrect.w;
+  context.height = draw->destrect.h;
+
+  plane_init (&context.luma, source, 0);
+  mapping_init (&context.lmap, draw, &context.luma, srcrect->x, srcrect->y,
+      srcrect->w, srcrect->h, context.width, context.height);
+
+  memset (&context.chroma, 0, sizeof (context.chroma));
+  memset (&context.cmap, 0, sizeof (context.cmap));
+
+  if (is_yuv (source)) {
+    plane_init (&context.chroma, source, 1);
+
+    // Chroma is sampled per target chroma sample or per target pixel.
+    if (is_yuv (target))
+      mapping_init (&context.cmap, draw, &context.chroma, srcrect->x / 2.0,
+          srcrect->y / 2.0, srcrect->w / 2.0, srcrect->h / 2.0,
+          (context.width + 1) / 2, (context.height + 1) / 2);
+    else
+      mapping_init (&context.cmap, draw, &context.chroma, srcrect->x / 2.0,
+          srcrect->y / 2.0, srcrect->w / 2.0, srcrect->h / 2.0,
+          context.width, context.height);
+  }
+
+  // Source row for the vertical pass plus the intermediate target rows.
+  context.scratchsize = (context.luma.width * context.luma.channels) +
+      (width * 16) + 16;
+
+  n_slices = MIN (n_threads,
+      (guint) MAX (context.height / CPU_RENDER_MIN_SLICE_ROWS, 1));
+  rows = (context.height + n_slices - 1) / n_slices;
+  rows = (rows + 1) & ~1;
+
+  slices = g_newa (CpuSlice, n_slices);
+
+  g_mutex_init (&lock);
+  g_cond_init (&done);
+
+  for (idx = 0; idx < n_slices; idx++) {
+    slices[idx].context = &context;
+    slices[idx].start = MIN ((gint) idx * rows, context.height);
+    slices[idx].end = MIN ((gint) (idx + 1) * rows, context.height);
+    slices[idx].lock = &lock;
+    slices[idx].done = &done;
+    slices[idx].remaining = &remaining;
+  }
+
+  for (idx = 1; idx < n_slices; idx++) {
+    if (slices[idx].start >= slices[idx].end)
+      continue;
+
+    g_mutex_lock (&lock);
+    remaining++;
+    g_mutex_unlock (&lock);
+
+    g_thread_pool_push (pool, &slices[idx], NULL);
+  }
+
+  render_slice (&slices[0]);
+
+  g_mutex_lock (&lock);
+  while (remaining > 0)
+    g_cond_wait (&done, &lock);
+  g_mutex_unlock (&lock);
+
+  g_cond_clear (&done);
+  g_mutex_clear (&lock);
+
+  mapping_clear (&context.lmap);
+  mapping_clear (&context.cmap);
+
+  return TRUE;
+}
@@ -0,0 +1,119 @@
+/*
+* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __GST_C2D_CPU_RENDER_H__
+#define __GST_C2D_CPU_RENDER_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstC2dCpuRect GstC2dCpuRect;
+typedef struct _GstC2dCpuSurface GstC2dCpuSurface;
+typedef struct _GstC2dCpuDraw GstC2dCpuDraw;
+
+typedef enum {
+  GST_C2D_CPU_FORMAT_UNKNOWN,
+  GST_C2D_CPU_FORMAT_NV12,
+  GST_C2D_CPU_FORMAT_NV21,
+  GST_C2D_CPU_FORMAT_RGB,
+} GstC2dCpuFormat;
+
+struct _GstC2dCpuRect
+{
+  gint x;
+  gint y;
+  gint w;
+  gint h;
+};
+
+/**
+ * GstC2dCpuSurface:
+ * @format: pixel layout
+ * @width: width in pixels
+ * @height: height in pixels
+ * @planes: plane virtual addresses, only the first is used for RGB
+ * @strides: plane strides in bytes
+ * @bpp: packed RGB only, 3 or 4 bytes per pixel
+ * @offsets: packed RGB only, byte offsets of the red, green, blue and
+ *     alpha (or padding) components, -1 if the pixel has no fourth byte
+ * @alpha: packed RGB only, whether the fourth byte holds alpha
+ */
+struct _GstC2dCpuSurface
+{
+  GstC2dCpuFormat format;
+  gint            width;
+  gint            height;
+  guint8          *planes[2];
+  gint            strides[2];
+  guint           bpp;
+  gint            offsets[4];
+  gboolean        alpha;
+};
+
+/**
+ * GstC2dCpuDraw:
+ * @source: surface to read from
+ * @target: surface to write into
+ * @srcrect: region of @source
+ * @destrect: region of @target, in target orientation
+ * @flip_h: mirror the source horizontally
+ * @flip_v: mirror the source vertically
+ * @rotate: clockwise rotation in degrees, 0, 90, 180 or 270
+ * @bilinear: bilinear instead of nearest neighbour sampling
+ *
+ * Single blit with scaling, cropping, rotation, mirroring and conversion
+ * between NV12, NV21 and packed RGB formats.
+ */
+struct _GstC2dCpuDraw
+{
+  GstC2dCpuSurface source;
+  GstC2dCpuSurface target;
+  GstC2dCpuRect    srcrect;
+  GstC2dCpuRect    destrect;
+  gboolean         flip_h;
+  gboolean         flip_v;
+  guint            rotate;
+  gboolean         bilinear;
+};
+
+/**
+ * gst_c2d_cpu_render:
+ * @draw: the blit
+ *
+ * Executes @draw, splitting the target rows between worker threads.
+ *
+ * Returns: FALSE if the formats or regions are not supported.
+ */
+G_GNUC_INTERNAL gboolean
+gst_c2d_cpu_render (const GstC2dCpuDraw *draw);
+
+G_END_DECLS
+
+#endif /* __GST_C2D_CPU_RENDER_H__ */
@@ -0,0 +1,160 @@
+/*
+* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "c2d_driver.h"
+
+#include <dlfcn.h>
+#include <string.h>
+
+#include <gst/gst.h>
+
+#define GST_CAT_DEFAULT ensure_debug_category()
+
+static GstDebugCategory *
+ensure_debug_category (void)
+{
+  static gsize cat_gonce = 0;
+
+  if (g_once_init_enter (&cat_gonce)) {
+    gsize cat_done = (gsize) _gst_debug_category_new ("c2d-driver", 0,
+        "c2d-driver object");
+
+    g_once_init_leave (&cat_gonce, cat_done);
+  }
+
+  return (GstDebugCategory *) cat_gonce;
+}
+
+static gboolean
+load_symbol (gpointer* method, gpointer handle, const gchar* name)
+{
+  *(method) = dlsym (handle, name);
+  if (NULL == *(method)) {
+    GST_ERROR("Failed to link library method %s, error: %s!", name, dlerror());
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static gboolean
+load_library (GstC2dDriver * driver)
+{
+  gboolean success = TRUE;
+
+  // Load C2D library.
+  driver->handle = dlopen ("libC2D2.so", RTLD_NOW);
+  if (NULL == driver->handle) {
+    GST_ERROR ("Failed to open C2D library, error: %s!", dlerror());
+    return FALSE;
+  }
+
+  // Load C2D library symbols.
+  success &= load_symbol ((gpointer*)&driver->DriverInit, driver->handle,
+      "c2dDriverInit");
+  success &= load_symbol ((gpointer*)&driver->DriverDeInit, driver->handle,
+      "c2dDriverDeInit");
+  success &= load_symbol ((gpointer*)&driver->CreateSurface, driver->handle,
+      "c2dCreateSurface");
+  success &= load_symbol ((gpointer*)&driver->DestroySurface, driver->handle,
+      "c2dDestroySurface");
+  success &= load_symbol ((gpointer*)&driver->UpdateSurface, driver->handle,
+      "c2dUpdateSurface");
+  success &= load_symbol ((gpointer*)&driver->Draw, driver->handle,
+      "c2dDraw");
+  success &= load_symbol ((gpointer*)&driver->Flush, driver->handle,
+      "c2dFlush");
+  success &= load_symbol ((gpointer*)&driver->Finish, driver->handle,
+      "c2dFinish");
+  success &= load_symbol ((gpointer*)&driver->WaitTimestamp, driver->handle,
+      "c2dWaitTimestamp");
+  success &= load_symbol ((gpointer*)&driver->MapAddr, driver->handle,
+      "c2dMapAddr");
+  success &= load_symbol ((gpointer*)&driver->UnMapAddr, driver->handle,
+      "c2dUnMapAddr");
+  success &= load_symbol ((gpointer*)&driver->GetDriverCapabilities,
+      driver->handle, "c2dGetDriverCapabilities");
+
+  return success;
+}
+
+/**
+ * gst_c2d_driver_open:
+ * @name: (nullable): "cpu" for the CPU implementation, NULL or "c2d" for
+ *     the C2D library, "auto" for the C2D library with fallback to the CPU
+ *
+ * Returns: (transfer full) (nullable): the driver entry points, NULL if
+ *     the implementation could not be loaded.
+ */
+GstC2dDriver *
+gst_c2d_driver_open (const gchar * name)
+{
+  GstC2dDriver *driver = g_slice_new0 (GstC2dDriver);
+
+  if (g_strcmp0 (name, "cpu") == 0) {
+    driver->name = "cpu";
+    gst_c2d_cpu_driver_setup (driver);
+  } else {
+    driver->name = "c2d";
+
+    if (load_library (driver)) {
+      // Nothing to do, all entry points are resolved.
+    } else if (g_strcmp0 (name, "auto") == 0) {
+      GST_WARNING ("C2D library is not available, falling back to CPU");
+
+      if (driver->handle != NULL)
+        dlclose (driver->handle);
+
+      memset (driver, 0x00, sizeof (*driver));
+      driver->name = "cpu";
+      gst_c2d_cpu_driver_setup (driver);
+    } else {
+      gst_c2d_driver_close (driver);
+      return NULL;
+    }
+  }
+
+  GST_INFO ("Opened %s driver", driver->name);
+  return driver;
+}
+
+void
+gst_c2d_driver_close (GstC2dDriver * driver)
+{
+  if (driver->handle != NULL) {
+    dlclose (driver->handle);
+    driver->handle = NULL;
+  }
+
+  GST_INFO ("Closed %s driver", driver->name);
+  g_slice_free (GstC2dDriver, driver);
+}
@@ -0,0 +1,91 @@
+/*
+* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __GST_C2D_DRIVER_H__
+#define __GST_C2D_DRIVER_H__
+
+#include <stdint.h>
+#include <glib.h>
+
+#include <adreno/c2d2.h>
+#include <adreno/c2dExt.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstC2dDriver GstC2dDriver;
+
+/**
+ * GstC2dDriver:
+ * @name: name of the implementation, for logging
+ * @handle: library handle, NULL for built-in implementations
+ *
+ * Entry points of the C2D library used by the converter. They are either
+ * resolved from libC2D2.so or provided by the CPU implementation, which has
+ * the same submission and timestamp semantics and renders on the CPU.
+ * SetSurfaceFilter is optional and NULL for the C2D library.
+ */
+struct _GstC2dDriver
+{
+  const gchar           *name;
+  gpointer              handle;
+
+  C2D_API C2D_STATUS (*DriverInit) (C2D_DRIVER_SETUP_INFO *setup);
+  C2D_API C2D_STATUS (*DriverDeInit) (void);
+  C2D_API C2D_STATUS (*CreateSurface) (uint32* id, uint32 bits,
+                                       C2D_SURFACE_TYPE type,
+                                       void* definition);
+  C2D_API C2D_STATUS (*DestroySurface) (uint32 id);
+  C2D_API C2D_STATUS (*UpdateSurface) (uint32 id, uint32 bits,
+                                       C2D_SURFACE_TYPE type,
+                                       void* definition);
+  C2D_API C2D_STATUS (*Draw) (uint32 id, uint32 config, C2D_RECT* scissor,
+                              uint32 mask, uint32 color_key,
+                              C2D_OBJECT* objects, uint32 count);
+  C2D_API C2D_STATUS (*Flush) (uint32 id, c2d_ts_handle* timestamp);
+  C2D_API C2D_STATUS (*WaitTimestamp) (c2d_ts_handle timestamp);
+  C2D_API C2D_STATUS (*Finish) (uint32 id);
+  C2D_API C2D_STATUS (*MapAddr) (int32_t fd, void* vaddr, uint32 size,
+                                 uint32 offset, uint32 flags, void** gpuaddr);
+  C2D_API C2D_STATUS (*UnMapAddr) (void* gpuaddr);
+  C2D_API C2D_STATUS (*GetDriverCapabilities) (C2D_DRIVER_INFO* caps);
+  C2D_STATUS (*SetSurfaceFilter) (uint32 id, gboolean bilinear);
+};
+
+G_GNUC_INTERNAL GstC2dDriver *
+gst_c2d_driver_open      (const gchar *name);
+
+G_GNUC_INTERNAL void
+gst_c2d_driver_close     (GstC2dDriver *driver);
+
+G_GNUC_INTERNAL void
+gst_c2d_cpu_driver_setup (GstC2dDriver *driver);
+
+G_END_DECLS
+
+#endif /* __GST_C2D_DRIVER_H__ */
@@ -32,13 +32,12 @@
 #endif
 
 #include "c2d_video_converter.h"
+#include "c2d_driver.h"
 
 #include <stdint.h>
-#include <dlfcn.h>
 #include <unistd.h>
+#include <sys/stat.h>
 
-#include <adreno/c2d2.h>
-#include <adreno/c2dExt.h>
 #include <linux/msm_kgsl.h>
 #include <media/msm_media_info.h>
 
@@ -64,6 +63,7 @@
 #define DEFAULT_OPT_FLIP_HORIZONTAL FALSE
 #define DEFAULT_OPT_FLIP_VERTICAL   FALSE
 #define DEFAULT_OPT_ROTATE_MODE     GST_C2D_VIDEO_ROTATE_NONE
+#define DEFAULT_OPT_SCALE_METHOD    GST_C2D_VIDEO_SCALE_BILINEAR
 
 #define GET_OPT_FLIP_HORIZONTAL(c) get_opt_bool (c, \
     GST_C2D_VIDEO_CONVERTER_OPT_FLIP_HORIZONTAL, DEFAULT_OPT_FLIP_HORIZONTAL)
@@ -72,6 +72,9 @@
 #define GET_OPT_ROTATE_MODE(c) get_opt_enum(c, \
     GST_C2D_VIDEO_CONVERTER_OPT_ROTATE_MODE, GST_TYPE_C2D_VIDEO_ROTATE_MODE, \
     DEFAULT_OPT_ROTATE_MODE)
+#define GET_OPT_SCALE_METHOD(c) get_opt_enum(c, \
+    GST_C2D_VIDEO_CONVERTER_OPT_SCALE_METHOD, \
+    GST_TYPE_C2D_VIDEO_SCALE_METHOD, DEFAULT_OPT_SCALE_METHOD)
 #define GET_OPT_SRC_X(c, v) get_opt_int (c, \
     GST_C2D_VIDEO_CONVERTER_OPT_SRC_X, v)
 #define GET_OPT_SRC_Y(c, v) get_opt_int (c, \
@@ -89,6 +92,15 @@
 #define GET_OPT_DEST_HEIGHT(c, v) get_opt_int (c, \
     GST_C2D_VIDEO_CONVERTER_OPT_DEST_HEIGHT, v)
 
+#define GET_OPT_MAX_OUTPUTS(c) get_opt_int (c, \
+    GST_C2D_VIDEO_CONVERTER_OPT_MAX_OUTPUTS, 1)
+
+#define DEFAULT_OPT_SURFACE_CACHE_SIZE 32
+
+#define GET_OPT_SURFACE_CACHE_SIZE(c) get_opt_int (c, \
+    GST_C2D_VIDEO_CONVERTER_OPT_SURFACE_CACHE_SIZE, \
+    DEFAULT_OPT_SURFACE_CACHE_SIZE)
+
 #define DEFAULT_C2D_INIT_MAX_OBJECT    4
 #define DEFAULT_C2D_INIT_MAX_TEMPLATE  4
 
@@ -109,6 +121,60 @@ ensure_debug_category (void)
   return (GstDebugCategory *) cat_gonce;
 }
 
+typedef struct _GstC2dSurfaceKey GstC2dSurfaceKey;
+typedef struct _GstC2dSurface GstC2dSurface;
+
+// Protects the surface caches of all converters. Memory may be freed from
+// any thread and its weak reference notify may run after the converter of
+// the surface is freed.
+static GMutex surfaces_lock;
+
+typedef enum {
+  // In the cache of the converter.
+  GST_C2D_SURFACE_CACHED,
+  // Out of the cache, its C2D resources are being released.
+  GST_C2D_SURFACE_RELEASING,
+  // Released, kept only for the weak reference on its live memory.
+  GST_C2D_SURFACE_ORPHAN,
+} GstC2dSurfaceState;
+
+// Identity of a dma-buf region as seen by C2D. File descriptor numbers are
+// recycled, the device and inode of the dma-buf are not while it exists.
+struct _GstC2dSurfaceKey
+{
+  guint64               device;
+  guint64               inode;
+  gsize                 offset;
+  gsize                 size;
+  GstVideoFormat        format;
+  gint                  width;
+  gint                  height;
+  guint                 bits;
+};
+
+struct _GstC2dSurface
+{
+  GstC2dSurfaceKey      key;
+
+  // C2D surface ID and the GPU mapping it was created with.
+  guint                 id;
+  gpointer              gpuaddress;
+  gpointer              vaddress;
+
+  // Memory backing the surface, weak reference. Only removed while the
+  // memory is known to be alive, its notify may be running otherwise.
+  GstMemory             *memory;
+  GstC2dSurfaceState    state;
+
+  // Timestamp of the last submission which used the surface.
+  c2d_ts_handle         timestamp;
+
+  // Node in the LRU or orphan list of the converter. The converter is set
+  // to NULL when it is freed before the memory.
+  GList                 link;
+  GstC2dVideoConverter  *convert;
+};
+
 struct _GstC2dVideoConverter
 {
   GstVideoInfo          input;
@@ -125,40 +191,31 @@ struct _GstC2dVideoConverter
   gboolean              flip_v;
   GstC2dVideoRotateMode rotate;
 
+  GstC2dVideoScaleMethod scale;
+
   // Source and destination rectangle.
   GstVideoRectangle     srcrect;
   GstVideoRectangle     destrect;
 
-  // Map of virtual address and its corresponding GPU address.
-  GHashTable            *gpulist;
-
-  // Map of buffers and their corresponding C2D surface ID.
-  GHashTable            *insurfaces;
-  GHashTable            *outsurfaces;
-
-  // C2D library handle.
-  gpointer              c2dhandle;
-
-  // C2D library APIs.
-  C2D_API C2D_STATUS (*DriverInit) (C2D_DRIVER_SETUP_INFO *setup);
-  C2D_API C2D_STATUS (*DriverDeInit) (void);
-  C2D_API C2D_STATUS (*CreateSurface) (uint32* id, uint32 bits,
-                                       C2D_SURFACE_TYPE type,
-                                       void* definition);
-  C2D_API C2D_STATUS (*DestroySurface) (uint32 id);
-  C2D_API C2D_STATUS (*UpdateSurface) (uint32 id, uint32 bits,
-                                       C2D_SURFACE_TYPE type,
-                                       void* definition);
-  C2D_API C2D_STATUS (*Draw) (uint32 id, uint32 config, C2D_RECT* scissor,
-                              uint32 mask, uint32 color_key,
-                              C2D_OBJECT* objects, uint32 count);
-  C2D_API C2D_STATUS (*Flush) (uint32 id, c2d_ts_handle* timestamp);
-  C2D_API C2D_STATUS (*WaitTimestamp) (c2d_ts_handle timestamp);
-  C2D_API C2D_STATUS (*Finish) (uint32 id);
-  C2D_API C2D_STATUS (*MapAddr) (int32_t fd, void* vaddr, uint32 size,
-                                 uint32 offset, uint32 flags, void** gpuaddr);
-  C2D_API C2D_STATUS (*UnMapAddr) (void* gpuaddr);
-  C2D_API C2D_STATUS (*GetDriverCapabilities) (C2D_DRIVER_INFO* caps);
+  // Map of surface keys and their corresponding C2D surface.
+  GHashTable            *surfaces;
+  // Cached surfaces, most recently used first.
+  GQueue                lru;
+  // Surfaces of freed memory, released from the converter thread.
+  GList                 *stale;
+  // Released surfaces waiting for their memory to be freed.
+  GQueue                orphans;
+  guint                 capacity;
+
+  // Surface cache statistics.
+  guint64               hits;
+  guint64               misses;
+  guint64               evictions;
+  guint64               invalidations;
+
+  // C2D library entry points.
+  GstC2dDriver          *driver;
+  gboolean              initialized;
 };
 
 GType
@@ -179,6 +236,22 @@ gst_c2d_video_rotate_mode_get_type (void)
   return video_rotation_type;
 }
 
+GType
+gst_c2d_video_scale_method_get_type (void)
+{
+  static GType video_scale_type = 0;
+  static const GEnumValue methods[] = {
+    {GST_C2D_VIDEO_SCALE_BILINEAR, "Bilinear interpolation", "bilinear"},
+    {GST_C2D_VIDEO_SCALE_NEAREST, "Nearest neighbour", "nearest"},
+    {0, NULL, NULL},
+  };
+  if (!video_scale_type) {
+    video_scale_type =
+        g_enum_register_static ("GstC2dVideoScaleMethod", methods);
+  }
+  return video_scale_type;
+}
+
 static guint
 get_opt_int (GstC2dVideoConverter * convert, const gchar * opt, gint defval)
 {
@@ -213,7 +286,7 @@ map_gpu_address (GstC2dVideoConverter * convert, const GstVideoFrame * frame)
 
   gint fd = gst_fd_memory_get_fd (gst_buffer_peek_memory (frame->buffer, 0));
 
-  status = convert->MapAddr (fd, frame->map->data, frame->map->size, 0,
+  status = convert->driver->MapAddr (fd, frame->map->data, frame->map->size, 0,
       KGSL_USER_MEM_TYPE_ION, &gpuaddress);
   if (status != C2D_STATUS_OK) {
     GST_ERROR ("Failed to map buffer data %p with size %" G_GSIZE_FORMAT
@@ -226,19 +299,17 @@ map_gpu_address (GstC2dVideoConverter * convert, const GstVideoFrame * frame)
 }
 
 static void
-unmap_gpu_address (gpointer key, gpointer data, gpointer userdata)
+unmap_gpu_address (GstC2dVideoConverter * convert, gpointer gpuaddress)
 {
   C2D_STATUS status = C2D_STATUS_OK;
-  GstC2dVideoConverter *convert = userdata;
-  guint surface_id = GPOINTER_TO_UINT (key);
 
-  status = convert->UnMapAddr (data);
+  status = convert->driver->UnMapAddr (gpuaddress);
   if (status != C2D_STATUS_OK) {
-    GST_ERROR ("Failed to unmap GPU address %p for surface %x, error: %d",
-        data, surface_id, status);
+    GST_ERROR ("Failed to unmap GPU address %p, error: %d", gpuaddress,
+        status);
     return;
   }
-  GST_DEBUG ("Unmapped GPU address %p for surface %x", data, surface_id);
+  GST_DEBUG ("Unmapped GPU address %p", gpuaddress);
   return;
 }
 
@@ -341,15 +412,12 @@ gst_video_format_to_c2d_format (GstVideoFormat format)
 
 static guint
 create_surface (GstC2dVideoConverter * convert, const GstVideoFrame * frame,
-    guint bits)
+    gpointer gpuaddress, guint bits)
 {
   C2D_STATUS status = C2D_STATUS_OK;
   const gchar *format;
   guint surface_id;
 
-  gpointer gpuaddress = map_gpu_address (convert, frame);
-  g_return_val_if_fail (gpuaddress != NULL, 0);
-
   format = gst_video_format_to_string (GST_VIDEO_FRAME_FORMAT (frame));
 
   if (GST_VIDEO_INFO_IS_RGB (&frame->info)) {
@@ -383,7 +451,7 @@ create_surface (GstC2dVideoConverter * convert, const GstVideoFrame * frame,
     type = (C2D_SURFACE_TYPE)(C2D_SURFACE_RGB_HOST | C2D_SURFACE_WITH_PHYS);
 
     // Create RGB surface.
-    status = convert->CreateSurface(&surface_id, bits, type, &surface);
+    status = convert->driver->CreateSurface (&surface_id, bits, type, &surface);
   } else if (GST_VIDEO_INFO_IS_YUV (&frame->info)) {
     C2D_YUV_SURFACE_DEF surface = { 0, };
     C2D_SURFACE_TYPE type;
@@ -440,18 +508,14 @@ create_surface (GstC2dVideoConverter * convert, const GstVideoFrame * frame,
     type = (C2D_SURFACE_TYPE)(C2D_SURFACE_YUV_HOST | C2D_SURFACE_WITH_PHYS);
 
     // Create YUV surface.
-    status = convert->CreateSurface(&surface_id, bits, type, &surface);
+    status = convert->driver->CreateSurface (&surface_id, bits, type, &surface);
   }
 
   if (status != C2D_STATUS_OK) {
     GST_ERROR ("Failed to create C2D surface, error: %d!", status);
-    unmap_gpu_address (NULL, gpuaddress, convert);
     return 0;
   }
 
-  g_hash_table_insert (convert->gpulist, GUINT_TO_POINTER (surface_id),
-       gpuaddress);
-
   GST_DEBUG ("Created %s surface with id %x", (bits & C2D_SOURCE) ?
       "input" : "output", surface_id);
   return surface_id;
@@ -459,14 +523,11 @@ create_surface (GstC2dVideoConverter * convert, const GstVideoFrame * frame,
 
 static void
 update_surface (GstC2dVideoConverter * convert, const GstVideoFrame * frame,
-    guint surface_id, guint bits)
+    guint surface_id, gpointer gpuaddress, guint bits)
 {
   C2D_STATUS status = C2D_STATUS_OK;
   const gchar *format;
 
-  gpointer gpuaddress =
-      g_hash_table_lookup (convert->gpulist, GUINT_TO_POINTER (surface_id));
-
   format = gst_video_format_to_string (GST_VIDEO_FRAME_FORMAT (frame));
 
   if (GST_VIDEO_INFO_IS_RGB (&frame->info)) {
@@ -500,7 +561,7 @@ update_surface (GstC2dVideoConverter * convert, const GstVideoFrame * frame,
     type = (C2D_SURFACE_TYPE)(C2D_SURFACE_RGB_HOST | C2D_SURFACE_WITH_PHYS);
 
     // Create RGB surface.
-    status = convert->UpdateSurface(surface_id, bits, type, &surface);
+    status = convert->driver->UpdateSurface (surface_id, bits, type, &surface);
   } else if (GST_VIDEO_INFO_IS_YUV (&frame->info)) {
     C2D_YUV_SURFACE_DEF surface = { 0, };
     C2D_SURFACE_TYPE type;
@@ -557,7 +618,7 @@ update_surface (GstC2dVideoConverter * convert, const GstVideoFrame * frame,
     type = (C2D_SURFACE_TYPE)(C2D_SURFACE_YUV_HOST | C2D_SURFACE_WITH_PHYS);
 
     // Create YUV surface.
-    status = convert->UpdateSurface(surface_id, bits, type, &surface);
+    status = convert->driver->UpdateSurface (surface_id, bits, type, &surface);
   }
 
   if (status != C2D_STATUS_OK) {
@@ -570,24 +631,188 @@ update_surface (GstC2dVideoConverter * convert, const GstVideoFrame * frame,
 }
 
 static void
-destroy_surface (gpointer key, gpointer value, gpointer userdata)
+destroy_surface (GstC2dVideoConverter * convert, GstC2dSurface * surface)
 {
   C2D_STATUS status = C2D_STATUS_OK;
-  GstC2dVideoConverter *convert = userdata;
-  guint surface_id = GPOINTER_TO_UINT (value);
 
-  status = convert->DestroySurface(surface_id);
+  // The GPU may still be reading from or writing into the surface.
+  if (surface->timestamp != NULL) {
+    status = convert->driver->WaitTimestamp (surface->timestamp);
+    if (status != C2D_STATUS_OK)
+      GST_WARNING ("c2dWaitTimestamp failed for surface %x, error: %d!",
+          surface->id, status);
+  }
+
+  status = convert->driver->DestroySurface (surface->id);
   if (status != C2D_STATUS_OK) {
-    GST_ERROR ("Failed to destroy C2D surface %x for key %p, error: %d!",
-        surface_id, key, status);
-    return;
+    GST_ERROR ("Failed to destroy C2D surface %x, error: %d!", surface->id,
+        status);
+  } else {
+    GST_DEBUG ("Destroyed surface with id %x", surface->id);
   }
-  GST_DEBUG ("Destroyed surface with id %x", surface_id);
-  return;
+
+  unmap_gpu_address (convert, surface->gpuaddress);
+
+  // Memory may be freed right now on another thread, so its weak reference
+  // stays. The notify frees the surface together with the memory.
+  g_mutex_lock (&surfaces_lock);
+
+  if (surface->memory != NULL) {
+    surface->state = GST_C2D_SURFACE_ORPHAN;
+    g_queue_push_tail_link (&convert->orphans, &surface->link);
+    surface = NULL;
+  }
+
+  g_mutex_unlock (&surfaces_lock);
+
+  if (surface != NULL)
+    g_slice_free (GstC2dSurface, surface);
+}
+
+static void
+destroy_surfaces (GstC2dVideoConverter * convert, GList * surfaces)
+{
+  GList *list = NULL;
+
+  for (list = surfaces; list != NULL; list = list->next)
+    destroy_surface (convert, list->data);
+
+  g_list_free (surfaces);
+}
+
+static guint
+surface_key_hash (gconstpointer data)
+{
+  const GstC2dSurfaceKey *key = data;
+  guint hash = g_int64_hash (&key->inode);
+
+  hash = (hash * 31) + g_int64_hash (&key->device);
+  hash = (hash * 31) + key->offset;
+  hash = (hash * 31) + key->bits;
+  return hash;
+}
+
+static gboolean
+surface_key_equal (gconstpointer a, gconstpointer b)
+{
+  const GstC2dSurfaceKey *l_key = a, *r_key = b;
+
+  return (l_key->device == r_key->device) && (l_key->inode == r_key->inode) &&
+      (l_key->offset == r_key->offset) && (l_key->size == r_key->size) &&
+      (l_key->format == r_key->format) && (l_key->width == r_key->width) &&
+      (l_key->height == r_key->height) && (l_key->bits == r_key->bits);
+}
+
+static gboolean
+surface_key_init (GstC2dSurfaceKey * key, GstMemory * memory,
+    const GstVideoFrame * frame, guint bits)
+{
+  struct stat st;
+  gint fd = gst_fd_memory_get_fd (memory);
+
+  if (fstat (fd, &st) != 0) {
+    GST_ERROR ("Failed to get the identity of fd %d!", fd);
+    return FALSE;
+  }
+
+  key->device = st.st_dev;
+  key->inode = st.st_ino;
+  key->offset = memory->offset;
+  key->size = memory->size;
+  key->format = GST_VIDEO_FRAME_FORMAT (frame);
+  key->width = GST_VIDEO_FRAME_WIDTH (frame);
+  key->height = GST_VIDEO_FRAME_HEIGHT (frame);
+  key->bits = bits;
+
+  return TRUE;
 }
 
+static void surface_memory_destroyed (gpointer userdata, GstMiniObject * obj);
+
+// Removes the surface from the cache, the caller releases it with
+// destroy_surface(). Must be called with the surfaces lock held.
 static void
-construct_object (GstC2dVideoConverter * convert, guint surface_id,
+detach_surface (GstC2dVideoConverter * convert, GstC2dSurface * surface)
+{
+  g_hash_table_remove (convert->surfaces, &surface->key);
+  g_queue_unlink (&convert->lru, &surface->link);
+
+  surface->state = GST_C2D_SURFACE_RELEASING;
+}
+
+// Drops the surfaces orphaned by the memory, which the caller keeps alive.
+static void
+drop_orphans (GstC2dVideoConverter * convert, GstMemory * memory)
+{
+  GList *list = NULL, *orphans = NULL;
+
+  g_mutex_lock (&surfaces_lock);
+
+  for (list = convert->orphans.head; list != NULL; ) {
+    GstC2dSurface *surface = list->data;
+
+    list = list->next;
+
+    if (surface->memory == memory) {
+      g_queue_unlink (&convert->orphans, &surface->link);
+      orphans = g_list_prepend (orphans, surface);
+    }
+  }
+
+  g_mutex_unlock (&surfaces_lock);
+
+  for (list = orphans; list != NULL; list = list->next) {
+    GstC2dSurface *surface = list->data;
+
+    gst_mini_object_weak_unref (GST_MINI_OBJECT (memory),
+        surface_memory_destroyed, surface);
+    g_slice_free (GstC2dSurface, surface);
+  }
+
+  g_list_free (orphans);
+}
+
+static void
+surface_memory_destroyed (gpointer userdata, GstMiniObject * obj)
+{
+  GstC2dSurface *surface = userdata;
+  GstC2dVideoConverter *convert = NULL;
+  guint id = surface->id;
+
+  g_mutex_lock (&surfaces_lock);
+
+  // The weak reference is gone together with the memory.
+  surface->memory = NULL;
+  convert = surface->convert;
+
+  switch (surface->state) {
+    case GST_C2D_SURFACE_CACHED:
+      // C2D calls are left to the thread using the converter.
+      detach_surface (convert, surface);
+      convert->stale = g_list_prepend (convert->stale, surface);
+      convert->invalidations++;
+      surface = NULL;
+      break;
+    case GST_C2D_SURFACE_RELEASING:
+      // Freed by the thread releasing it.
+      surface = NULL;
+      break;
+    case GST_C2D_SURFACE_ORPHAN:
+      if (convert != NULL)
+        g_queue_unlink (&convert->orphans, &surface->link);
+      break;
+  }
+
+  g_mutex_unlock (&surfaces_lock);
+
+  if (surface != NULL)
+    g_slice_free (GstC2dSurface, surface);
+
+  GST_LOG ("Memory %p of surface %x freed", obj, id);
+}
+
+static void
+construct_object (const GstC2dVideoOutput * params, guint surface_id,
     C2D_OBJECT * object)
 {
   memset (object, 0x00, sizeof(*object));
@@ -597,46 +822,46 @@ construct_object (GstC2dVideoConverter * convert, guint surface_id,
       C2D_ALPHA_BLEND_NONE);
 
   // Setup the source rectangle.
-  object->source_rect.x = convert->srcrect.x << 16;
-  object->source_rect.y = convert->srcrect.y << 16;
-  object->source_rect.width = convert->srcrect.w << 16;
-  object->source_rect.height = convert->srcrect.h << 16;
+  object->source_rect.x = params->srcrect.x << 16;
+  object->source_rect.y = params->srcrect.y << 16;
+  object->source_rect.width = params->srcrect.w << 16;
+  object->source_rect.height = params->srcrect.h << 16;
 
   // Setup the target rectangle.
-  object->target_rect.x = convert->destrect.x << 16;
-  object->target_rect.y = convert->destrect.y << 16;
+  object->target_rect.x = params->destrect.x << 16;
+  object->target_rect.y = params->destrect.y << 16;
 
   // Apply the flip bits to the object configure mask if set.
   object->config_mask &= ~(C2D_MIRROR_V_BIT | C2D_MIRROR_H_BIT);
-  if (convert->flip_v) {
+  if (params->flip_v) {
     object->config_mask |= C2D_MIRROR_V_BIT;
     GST_LOG ("Input surface %x - flip vertically", surface_id);
   }
-  if (convert->flip_h) {
+  if (params->flip_h) {
     object->config_mask |= C2D_MIRROR_H_BIT;
     GST_LOG ("Input surface %x - flip horizontally", surface_id);
   }
 
-  switch (convert->rotate) {
+  switch (params->rotate) {
     case GST_C2D_VIDEO_ROTATE_90_CW:
       object->config_mask |= (C2D_OVERRIDE_GLOBAL_TARGET_ROTATE_CONFIG |
           C2D_OVERRIDE_TARGET_ROTATE_270);
-      object->target_rect.width = convert->destrect.h << 16;
-      object->target_rect.height = convert->destrect.w << 16;
+      object->target_rect.width = params->destrect.h << 16;
+      object->target_rect.height = params->destrect.w << 16;
       GST_LOG ("Input surface %x - rotate 90° clockwise", surface_id);
       break;
     case GST_C2D_VIDEO_ROTATE_180:
       object->config_mask |= (C2D_OVERRIDE_GLOBAL_TARGET_ROTATE_CONFIG |
           C2D_OVERRIDE_TARGET_ROTATE_180);
-      object->target_rect.width = convert->destrect.w << 16;
-      object->target_rect.height = convert->destrect.h << 16;
+      object->target_rect.width = params->destrect.w << 16;
+      object->target_rect.height = params->destrect.h << 16;
       GST_LOG ("Input surface %x - rotate 180°", surface_id);
       break;
     case GST_C2D_VIDEO_ROTATE_90_CCW:
       object->config_mask |= (C2D_OVERRIDE_GLOBAL_TARGET_ROTATE_CONFIG |
           C2D_OVERRIDE_TARGET_ROTATE_90);
-      object->target_rect.width = convert->destrect.h << 16;
-      object->target_rect.height = convert->destrect.w << 16;
+      object->target_rect.width = params->destrect.h << 16;
+      object->target_rect.height = params->destrect.w << 16;
       GST_LOG ("Input surface %x - rotate 90° counter-clockwise", surface_id);
       break;
     default:
@@ -645,8 +870,8 @@ construct_object (GstC2dVideoConverter * convert, guint surface_id,
           ~(C2D_OVERRIDE_GLOBAL_TARGET_ROTATE_CONFIG |
             C2D_OVERRIDE_TARGET_ROTATE_90 | C2D_OVERRIDE_TARGET_ROTATE_180 |
             C2D_OVERRIDE_TARGET_ROTATE_270);
-      object->target_rect.width = convert->destrect.w << 16;
-      object->target_rect.height = convert->destrect.h << 16;
+      object->target_rect.width = params->destrect.w << 16;
+      object->target_rect.height = params->destrect.h << 16;
       break;
   }
 
@@ -673,25 +898,14 @@ overwrite_configuration (GQuark field, const GValue * value, gpointer userdata)
   return TRUE;
 }
 
-static gboolean
-load_symbol (gpointer* method, gpointer handle, const gchar* name)
-{
-  *(method) = dlsym (handle, name);
-  if (NULL == *(method)) {
-    GST_ERROR("Failed to link library method %s, error: %s!", name, dlerror());
-    return FALSE;
-  }
-  return TRUE;
-}
-
 GstC2dVideoConverter *
 gst_c2d_video_converter_new (GstVideoInfo * input, GstVideoInfo * output,
     GstStructure * configuration)
 {
   GstC2dVideoConverter *convert;
   //const GstVideoFormatInfo *fin, *fout, *finfo;
-  gboolean success;
   C2D_DRIVER_SETUP_INFO setup;
+  gint maxoutputs = 0;
   C2D_DRIVER_INFO caps;
   C2D_STATUS status;
 
@@ -708,84 +922,40 @@ gst_c2d_video_converter_new (GstVideoInfo * input, GstVideoInfo * output,
   convert = g_slice_new0 (GstC2dVideoConverter);
   g_return_val_if_fail (convert != NULL, NULL);
 
-  // Load C2D library.
-  convert->c2dhandle = dlopen ("libC2D2.so", RTLD_NOW);
-  C2D_RETURN_NULL_IF_FAIL_WITH_MSG (convert->c2dhandle != NULL,
-      gst_c2d_video_converter_free (convert), "Failed to open C2D library, "
-      "error: %s!", dlerror());
-
-  // Load C2D library symbols.
-  success = load_symbol ((gpointer*)&convert->DriverInit, convert->c2dhandle,
-      "c2dDriverInit");
-  C2D_RETURN_NULL_IF_FAIL (success, gst_c2d_video_converter_free (convert));
-
-  success = load_symbol ((gpointer*)&convert->DriverDeInit, convert->c2dhandle,
-      "c2dDriverDeInit");
-  C2D_RETURN_NULL_IF_FAIL (success, gst_c2d_video_converter_free (convert));
-
-  success = load_symbol ((gpointer*)&convert->CreateSurface,
-      convert->c2dhandle, "c2dCreateSurface");
-  C2D_RETURN_NULL_IF_FAIL (success, gst_c2d_video_converter_free (convert));
+  g_queue_init (&convert->lru);
+  g_queue_init (&convert->orphans);
 
-  success = load_symbol ((gpointer*)&convert->DestroySurface,
-      convert->c2dhandle, "c2dDestroySurface");
-  C2D_RETURN_NULL_IF_FAIL (success, gst_c2d_video_converter_free (convert));
+  // Load C2D library or the CPU stand-in.
+  convert->driver = gst_c2d_driver_open ((configuration != NULL) ?
+      gst_structure_get_string (configuration,
+          GST_C2D_VIDEO_CONVERTER_OPT_DRIVER) : NULL);
+  C2D_RETURN_NULL_IF_FAIL_WITH_MSG (convert->driver != NULL,
+      gst_c2d_video_converter_free (convert), "Failed to open C2D driver!");
 
-  success = load_symbol ((gpointer*)&convert->UpdateSurface,
-      convert->c2dhandle, "c2dUpdateSurface");
-  C2D_RETURN_NULL_IF_FAIL (success, gst_c2d_video_converter_free (convert));
-
-  success = load_symbol ((gpointer*)&convert->Draw, convert->c2dhandle,
-      "c2dDraw");
-  C2D_RETURN_NULL_IF_FAIL (success, gst_c2d_video_converter_free (convert));
-
-  success = load_symbol ((gpointer*)&convert->Flush, convert->c2dhandle,
-      "c2dFlush");
-  C2D_RETURN_NULL_IF_FAIL (success, gst_c2d_video_converter_free (convert));
-
-  success = load_symbol ((gpointer*)&convert->Finish, convert->c2dhandle,
-      "c2dFinish");
-  C2D_RETURN_NULL_IF_FAIL (success, gst_c2d_video_converter_free (convert));
-
-  success = load_symbol ((gpointer*)&convert->WaitTimestamp,
-      convert->c2dhandle, "c2dWaitTimestamp");
-  C2D_RETURN_NULL_IF_FAIL (success, gst_c2d_video_converter_free (convert));
-
-  success = load_symbol ((gpointer*)&convert->MapAddr, convert->c2dhandle,
-      "c2dMapAddr");
-  C2D_RETURN_NULL_IF_FAIL (success, gst_c2d_video_converter_free (convert));
-
-  success = load_symbol ((gpointer*)&convert->UnMapAddr, convert->c2dhandle,
-      "c2dUnMapAddr");
-  C2D_RETURN_NULL_IF_FAIL (success, gst_c2d_video_converter_free (convert));
-
-  success = load_symbol ((gpointer*)&convert->GetDriverCapabilities,
-      convert->c2dhandle, "c2dGetDriverCapabilities");
-  C2D_RETURN_NULL_IF_FAIL (success, gst_c2d_video_converter_free (convert));
-
-  convert->insurfaces = g_hash_table_new (NULL, NULL);
-  C2D_RETURN_NULL_IF_FAIL_WITH_MSG (convert->insurfaces != NULL,
-      gst_c2d_video_converter_free (convert), "Failed to create hash table "
-      "for source surfaces!");
-
-  convert->outsurfaces = g_hash_table_new (NULL, NULL);
-  C2D_RETURN_NULL_IF_FAIL_WITH_MSG (convert->outsurfaces != NULL,
+  convert->surfaces = g_hash_table_new (surface_key_hash, surface_key_equal);
+  C2D_RETURN_NULL_IF_FAIL_WITH_MSG (convert->surfaces != NULL,
       gst_c2d_video_converter_free (convert), "Failed to create hash table "
-      "for target surfaces!");
-
-  convert->gpulist = g_hash_table_new (NULL, NULL);
-  C2D_RETURN_NULL_IF_FAIL_WITH_MSG (convert->gpulist != NULL,
-      gst_c2d_video_converter_free (convert), "Failed to create hash table "
-      "for GPU mapped addresses!");
+      "for surfaces!");
 
+  // Each output of a submission is drawn as a separate object.
   setup.max_object_list_needed = DEFAULT_C2D_INIT_MAX_OBJECT;
   setup.max_surface_template_needed = DEFAULT_C2D_INIT_MAX_TEMPLATE;
 
-  status = convert->DriverInit (&setup);
+  if (configuration != NULL &&
+      gst_structure_get_int (configuration,
+          GST_C2D_VIDEO_CONVERTER_OPT_MAX_OUTPUTS, &maxoutputs)) {
+    setup.max_object_list_needed =
+        MAX (setup.max_object_list_needed, (guint) maxoutputs);
+    setup.max_surface_template_needed =
+        MAX (setup.max_surface_template_needed, (guint) maxoutputs + 1);
+  }
+
+  status = convert->driver->DriverInit (&setup);
   C2D_RETURN_NULL_IF_FAIL_WITH_MSG (C2D_STATUS_OK == status,
       gst_c2d_video_converter_free (convert), "Failed to initialize driver!");
+  convert->initialized = TRUE;
 
-  status = convert->GetDriverCapabilities (&caps);
+  status = convert->driver->GetDriverCapabilities (&caps);
   if (C2D_STATUS_OK == status) {
     GST_DEBUG ("C2D_DRIVER Capabilities:");
     GST_DEBUG ("    Maximum dimensions: %ux%u", caps.max_surface_width,
@@ -866,31 +1036,47 @@ gst_c2d_video_converter_new (GstVideoInfo * input, GstVideoInfo * output,
 void
 gst_c2d_video_converter_free (GstC2dVideoConverter * convert)
 {
-  if (convert->insurfaces != NULL) {
-    g_hash_table_foreach (convert->insurfaces, destroy_surface, convert);
-    g_hash_table_destroy(convert->insurfaces);
-    convert->insurfaces = NULL;
-  }
+  if (convert->surfaces != NULL) {
+    GList *surfaces = NULL;
 
-  if (convert->outsurfaces != NULL) {
-    g_hash_table_foreach (convert->outsurfaces, destroy_surface, convert);
-    g_hash_table_destroy (convert->outsurfaces);
-    convert->outsurfaces = NULL;
-  }
+    g_mutex_lock (&surfaces_lock);
 
-  if (convert->gpulist != NULL) {
-    g_hash_table_foreach (convert->gpulist, unmap_gpu_address, convert);
-    g_hash_table_destroy (convert->gpulist);
-    convert->gpulist = NULL;
-  }
+    while (!g_queue_is_empty (&convert->lru)) {
+      GstC2dSurface *surface = g_queue_peek_head (&convert->lru);
+
+      detach_surface (convert, surface);
+      surfaces = g_list_prepend (surfaces, surface);
+    }
+
+    surfaces = g_list_concat (surfaces, convert->stale);
+    convert->stale = NULL;
+
+    g_mutex_unlock (&surfaces_lock);
+
+    destroy_surfaces (convert, surfaces);
 
-  if (convert->DriverDeInit != NULL) {
-    convert->DriverDeInit ();
+    // Orphans are left to the notify of their memory.
+    g_mutex_lock (&surfaces_lock);
+
+    while (!g_queue_is_empty (&convert->orphans)) {
+      GList *link = g_queue_pop_head_link (&convert->orphans);
+      GstC2dSurface *surface = link->data;
+
+      surface->convert = NULL;
+    }
+
+    g_mutex_unlock (&surfaces_lock);
+
+    g_hash_table_destroy (convert->surfaces);
+    convert->surfaces = NULL;
   }
 
-  if (convert->c2dhandle != NULL) {
-    dlclose (convert->c2dhandle);
-    convert->c2dhandle = NULL;
+  if (convert->driver != NULL) {
+    if (convert->initialized)
+      convert->driver->DriverDeInit ();
+
+    gst_c2d_driver_close (convert->driver);
+    convert->driver = NULL;
   }
 
   GST_INFO ("Destroyed C2D converter: %p", convert);
@@ -910,6 +1096,7 @@ gst_c2d_video_converter_set_config (GstC2dVideoConverter * convert,
   convert->flip_h = GET_OPT_FLIP_HORIZONTAL (convert);
   convert->flip_v = GET_OPT_FLIP_VERTICAL (convert);
   convert->rotate = GET_OPT_ROTATE_MODE (convert);
+  convert->scale = GET_OPT_SCALE_METHOD (convert);
 
   convert->srcrect.x  = GET_OPT_SRC_X (convert, 0);
   convert->srcrect.y  = GET_OPT_SRC_Y (convert, 0);
@@ -931,6 +1118,12 @@ gst_c2d_video_converter_set_config (GstC2dVideoConverter * convert,
   convert->destrect.h = (convert->destrect.h == 0) ? convert->outheight :
       MIN (convert->destrect.h, convert->outheight - convert->destrect.y);
 
+  // A submission must never evict the surfaces it is using.
+  g_mutex_lock (&surfaces_lock);
+  convert->capacity = MAX (GET_OPT_SURFACE_CACHE_SIZE (convert),
+      GET_OPT_MAX_OUTPUTS (convert) + 1);
+  g_mutex_unlock (&surfaces_lock);
+
   return TRUE;
 }
 
@@ -942,70 +1135,254 @@ gst_c2d_video_converter_get_config (GstC2dVideoConverter * convert)
   return convert->configuration;
 }
 
-void
-gst_c2d_video_converter_frame (GstC2dVideoConverter * convert,
-    const GstVideoFrame * inframe, GstVideoFrame * outframe)
+// Returns the C2D surface of the frame, creating it on first use and
+// evicting the least recently used surfaces above the cache capacity.
+static GstC2dSurface *
+get_surface (GstC2dVideoConverter * convert, const GstVideoFrame * frame,
+    guint bits)
 {
-  C2D_STATUS status = C2D_STATUS_OK;
+  GstC2dSurface *surface = NULL;
   GstMemory *memory = NULL;
-  guint fd, source_surface_id, target_surface_id;
-  C2D_OBJECT object;
+  GstC2dSurfaceKey key;
+  GList *stale = NULL;
+  gpointer gpuaddress = NULL;
 
-  g_return_if_fail (convert != NULL);
-  g_return_if_fail (inframe != NULL);
-  g_return_if_fail (outframe != NULL);
+  memory = gst_buffer_peek_memory (frame->buffer, 0);
+  g_return_val_if_fail (gst_is_fd_memory (memory), NULL);
 
-  memory = gst_buffer_peek_memory (inframe->buffer, 0);
-  g_return_if_fail (gst_is_fd_memory (memory));
+  if (!surface_key_init (&key, memory, frame, bits))
+    return NULL;
 
-  fd = gst_fd_memory_get_fd (memory);
+  g_mutex_lock (&surfaces_lock);
 
-  if (!g_hash_table_contains (convert->insurfaces, GUINT_TO_POINTER (fd))) {
-    source_surface_id = create_surface (convert, inframe, C2D_SOURCE);
-    g_return_if_fail (source_surface_id != 0);
+  stale = convert->stale;
+  convert->stale = NULL;
 
-    g_hash_table_insert (convert->insurfaces, GUINT_TO_POINTER (fd),
-        GUINT_TO_POINTER (source_surface_id));
+  surface = g_hash_table_lookup (convert->surfaces, &key);
+
+  // The GPU mapping is tied to the virtual address of the memory.
+  if (surface != NULL && surface->vaddress != frame->map->data) {
+    detach_surface (convert, surface);
+    stale = g_list_prepend (stale, surface);
+    surface = NULL;
+  }
+
+  if (surface != NULL) {
+    g_queue_unlink (&convert->lru, &surface->link);
+    g_queue_push_head_link (&convert->lru, &surface->link);
+    convert->hits++;
   } else {
-    source_surface_id = GPOINTER_TO_UINT (
-        g_hash_table_lookup (convert->insurfaces, GUINT_TO_POINTER (fd)));
-    update_surface (convert, inframe, source_surface_id, C2D_SOURCE);
+    convert->misses++;
   }
 
-  memory = gst_buffer_peek_memory (outframe->buffer, 0);
-  g_return_if_fail (gst_is_fd_memory (memory));
+  g_mutex_unlock (&surfaces_lock);
 
-  fd = gst_fd_memory_get_fd (memory);
+  destroy_surfaces (convert, stale);
+  stale = NULL;
 
-  if (!g_hash_table_contains (convert->outsurfaces, GUINT_TO_POINTER (fd))) {
-    target_surface_id = create_surface (convert, outframe, C2D_TARGET);
-    g_return_if_fail (target_surface_id != 0);
+  if (surface != NULL) {
+    update_surface (convert, frame, surface->id, surface->gpuaddress, bits);
+    return surface;
+  }
 
-    g_hash_table_insert (convert->outsurfaces, GUINT_TO_POINTER (fd),
-        GUINT_TO_POINTER (target_surface_id));
-  } else {
-    target_surface_id = GPOINTER_TO_UINT (
-        g_hash_table_lookup (convert->outsurfaces, GUINT_TO_POINTER (fd)));
-    update_surface (convert, outframe, target_surface_id, C2D_TARGET);
+  // Released surfaces of this memory would only wait for it to be freed.
+  drop_orphans (convert, memory);
+
+  gpuaddress = map_gpu_address (convert, frame);
+  g_return_val_if_fail (gpuaddress != NULL, NULL);
+
+  surface = g_slice_new0 (GstC2dSurface);
+  surface->key = key;
+  surface->gpuaddress = gpuaddress;
+  surface->vaddress = frame->map->data;
+  surface->memory = memory;
+  surface->link.data = surface;
+  surface->convert = convert;
+
+  surface->id = create_surface (convert, frame, gpuaddress, bits);
+  if (surface->id == 0) {
+    unmap_gpu_address (convert, gpuaddress);
+    g_slice_free (GstC2dSurface, surface);
+    return NULL;
   }
 
-  construct_object (convert, source_surface_id, &object);
+  gst_mini_object_weak_ref (GST_MINI_OBJECT (memory),
+      surface_memory_destroyed, surface);
 
-  GST_LOG ("Draw output surface %x", target_surface_id);
+  g_mutex_lock (&surfaces_lock);
 
-  status = convert->Draw (target_surface_id, 0, NULL, 0, 0, &object, 0);
-  if (status != C2D_STATUS_OK) {
-    GST_ERROR ("c2dDraw failed for target surface %x, , error: %d!",
-        target_surface_id, status);
-    return;
+  surface->state = GST_C2D_SURFACE_CACHED;
+  g_hash_table_insert (convert->surfaces, &surface->key, surface);
+  g_queue_push_head_link (&convert->lru, &surface->link);
+
+  while (g_queue_get_length (&convert->lru) > convert->capacity) {
+    GstC2dSurface *evicted = g_queue_peek_tail (&convert->lru);
+
+    detach_surface (convert, evicted);
+    stale = g_list_prepend (stale, evicted);
+    convert->evictions++;
+  }
+
+  g_mutex_unlock (&surfaces_lock);
+
+  destroy_surfaces (convert, stale);
+  return surface;
+}
+
+// Clamps the rectangle to the frame, zero width or height selects it whole.
+static void
+clamp_rectangle (GstVideoRectangle * rect, gint width, gint height)
+{
+  rect->w = (rect->w == 0) ? width : MIN (rect->w, width - rect->x);
+  rect->h = (rect->h == 0) ? height : MIN (rect->h, height - rect->y);
+}
+
+gpointer
+gst_c2d_video_converter_submit_frame (GstC2dVideoConverter * convert,
+    const GstVideoFrame * inframe, GstVideoFrame * outframe)
+{
+  GstC2dVideoOutput output;
+
+  g_return_val_if_fail (convert != NULL, NULL);
+  g_return_val_if_fail (outframe != NULL, NULL);
+
+  output.frame = outframe;
+  output.srcrect = convert->srcrect;
+  output.destrect = convert->destrect;
+  output.flip_h = convert->flip_h;
+  output.flip_v = convert->flip_v;
+  output.rotate = convert->rotate;
+
+  return gst_c2d_video_converter_submit_outputs (convert, inframe,
+      &output, 1);
+}
+
+gpointer
+gst_c2d_video_converter_submit_outputs (GstC2dVideoConverter * convert,
+    const GstVideoFrame * inframe, const GstC2dVideoOutput * outputs,
+    guint n_outputs)
+{
+  C2D_STATUS status = C2D_STATUS_OK;
+  GstC2dSurface *source = NULL, **targets = NULL;
+  GstC2dVideoOutput params;
+  C2D_OBJECT *objects = NULL;
+  c2d_ts_handle timestamp = NULL;
+  guint idx;
+
+  g_return_val_if_fail (convert != NULL, NULL);
+  g_return_val_if_fail (inframe != NULL, NULL);
+  g_return_val_if_fail (outputs != NULL && n_outputs > 0, NULL);
+
+  // The input surface is set up once for all outputs.
+  source = get_surface (convert, inframe, C2D_SOURCE);
+  g_return_val_if_fail (source != NULL, NULL);
+
+  // Objects must stay valid until the draws are flushed.
+  objects = g_newa (C2D_OBJECT, n_outputs);
+  targets = g_newa (GstC2dSurface *, n_outputs);
+
+  for (idx = 0; idx < n_outputs; idx++) {
+    g_return_val_if_fail (outputs[idx].frame != NULL, NULL);
+
+    targets[idx] = get_surface (convert, outputs[idx].frame, C2D_TARGET);
+    g_return_val_if_fail (targets[idx] != NULL, NULL);
+
+    params = outputs[idx];
+    clamp_rectangle (&params.srcrect, GST_VIDEO_FRAME_WIDTH (inframe),
+        GST_VIDEO_FRAME_HEIGHT (inframe));
+    clamp_rectangle (&params.destrect, GST_VIDEO_FRAME_WIDTH (params.frame),
+        GST_VIDEO_FRAME_HEIGHT (params.frame));
+
+    construct_object (&params, source->id, &objects[idx]);
+
+    // The C2D library picks the sampling itself.
+    if (convert->driver->SetSurfaceFilter != NULL)
+      convert->driver->SetSurfaceFilter (targets[idx]->id,
+          convert->scale == GST_C2D_VIDEO_SCALE_BILINEAR);
+
+    GST_LOG ("Draw output surface %x", targets[idx]->id);
+
+    status = convert->driver->Draw (targets[idx]->id, 0, NULL, 0, 0,
+        &objects[idx], 0);
+    if (status != C2D_STATUS_OK) {
+      GST_ERROR ("c2dDraw failed for target surface %x, , error: %d!",
+          targets[idx]->id, status);
+      return NULL;
+    }
   }
 
-  status = convert->Finish (target_surface_id);
+  // Submit the draws without waiting. Timestamps complete in submission
+  // order, so the last one tracks the completion of all outputs.
+  for (idx = 0; idx < n_outputs; idx++) {
+    status = convert->driver->Flush (targets[idx]->id, &timestamp);
+    if (status != C2D_STATUS_OK) {
+      GST_ERROR ("c2dFlush failed for target surface %x, , error: %d!",
+          targets[idx]->id, status);
+      return NULL;
+    }
+  }
+
+  // Surfaces are not destroyed before their last submission has finished.
+  source->timestamp = timestamp;
+  for (idx = 0; idx < n_outputs; idx++)
+    targets[idx]->timestamp = timestamp;
+
+  GST_LOG ("Submitted %u output surfaces, timestamp %p", n_outputs,
+      timestamp);
+  return (gpointer) timestamp;
+}
+
+gboolean
+gst_c2d_video_converter_wait_request (GstC2dVideoConverter * convert,
+    gpointer request_id)
+{
+  C2D_STATUS status = C2D_STATUS_OK;
+
+  g_return_val_if_fail (convert != NULL, FALSE);
+  g_return_val_if_fail (request_id != NULL, FALSE);
+
+  status = convert->driver->WaitTimestamp ((c2d_ts_handle) request_id);
   if (status != C2D_STATUS_OK) {
-    GST_ERROR ("c2dDraw finish failed for output surface %x, , error: %d!",
-        target_surface_id, status);
-    return;
+    GST_ERROR ("c2dWaitTimestamp failed for timestamp %p, error: %d!",
+        request_id, status);
+    return FALSE;
   }
 
-  GST_LOG ("Finished drawing output surface %x", target_surface_id);
+  GST_LOG ("Finished request with timestamp %p", request_id);
+  return TRUE;
+}
+
+void
+gst_c2d_video_converter_frame (GstC2dVideoConverter * convert,
+    const GstVideoFrame * inframe, GstVideoFrame * outframe)
+{
+  gpointer request_id = NULL;
+
+  request_id = gst_c2d_video_converter_submit_frame (convert, inframe,
+      outframe);
+  if (request_id == NULL)
+    return;
+
+  gst_c2d_video_converter_wait_request (convert, request_id);
+}
+
+GstStructure *
+gst_c2d_video_converter_get_stats (GstC2dVideoConverter * convert)
+{
+  GstStructure *stats = NULL;
+
+  g_return_val_if_fail (convert != NULL, NULL);
+
+  g_mutex_lock (&surfaces_lock);
+  stats = gst_structure_new ("c2d-surface-cache",
+      "surfaces", G_TYPE_UINT, g_queue_get_length (&convert->lru),
+      "capacity", G_TYPE_UINT, convert->capacity,
+      "hits", G_TYPE_UINT64, convert->hits,
+      "misses", G_TYPE_UINT64, convert->misses,
+      "evictions", G_TYPE_UINT64, convert->evictions,
+      "invalidations", G_TYPE_UINT64, convert->invalidations,
+      NULL);
+  g_mutex_unlock (&surfaces_lock);
+
+  return stats;
 }
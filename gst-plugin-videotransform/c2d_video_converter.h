@@ -79,6 +79,30 @@ GST_VIDEO_API GType gst_c2d_video_rotate_mode_get_type (void);
 #define GST_C2D_VIDEO_CONVERTER_OPT_ROTATE_MODE \
     "GstC2dVideoConverter.rotate-mode"
 
+/**
+ * GstC2dVideoScaleMethod:
+ * @GST_C2D_VIDEO_SCALE_BILINEAR: bilinear interpolation
+ * @GST_C2D_VIDEO_SCALE_NEAREST: nearest neighbour
+ *
+ * Different scaling methods, only the CPU driver takes them into account
+ */
+typedef enum {
+  GST_C2D_VIDEO_SCALE_BILINEAR,
+  GST_C2D_VIDEO_SCALE_NEAREST,
+} GstC2dVideoScaleMethod;
+
+GST_VIDEO_API GType gst_c2d_video_scale_method_get_type (void);
+#define GST_TYPE_C2D_VIDEO_SCALE_METHOD (gst_c2d_video_scale_method_get_type())
+
+/**
+ * GST_C2D_VIDEO_CONVERTER_OPT_SCALE_METHOD:
+ *
+ * #GST_TYPE_C2D_VIDEO_SCALE_METHOD, sampling used for scaling.
+ * Default is #GST_C2D_VIDEO_SCALE_BILINEAR.
+ */
+#define GST_C2D_VIDEO_CONVERTER_OPT_SCALE_METHOD \
+    "GstC2dVideoConverter.scale-method"
+
 /**
  * GST_C2D_VIDEO_CONVERTER_OPT_SRC_X:
  *
@@ -140,7 +164,62 @@ GST_VIDEO_API GType gst_c2d_video_rotate_mode_get_type (void);
 #define GST_C2D_VIDEO_CONVERTER_OPT_DEST_HEIGHT \
     "GstC2dVideoConverter.dest-height"
 
+/**
+ * GST_C2D_VIDEO_CONVERTER_OPT_DRIVER:
+ *
+ * #G_TYPE_STRING, implementation of the C2D entry points, only read when
+ * the converter is created. "c2d" loads the C2D library, "cpu" selects an
+ * implementation which renders on the CPU with the same submission and
+ * timestamp rules, "auto" loads the C2D library and falls back to the CPU
+ * when it is not available. Default is "c2d".
+ */
+#define GST_C2D_VIDEO_CONVERTER_OPT_DRIVER \
+    "GstC2dVideoConverter.driver"
+
+/**
+ * GST_C2D_VIDEO_CONVERTER_OPT_MAX_OUTPUTS:
+ *
+ * #G_TYPE_INT, maximum number of outputs drawn by a single
+ * gst_c2d_video_converter_submit_outputs() call, only read when the
+ * converter is created. Default is 1.
+ */
+#define GST_C2D_VIDEO_CONVERTER_OPT_MAX_OUTPUTS \
+    "GstC2dVideoConverter.max-outputs"
+
+/**
+ * GST_C2D_VIDEO_CONVERTER_OPT_SURFACE_CACHE_SIZE:
+ *
+ * #G_TYPE_INT, maximum number of C2D surfaces kept for buffers seen before,
+ * the least recently used are destroyed first. Never less than the number
+ * of surfaces used by a single submission. Default is 32.
+ */
+#define GST_C2D_VIDEO_CONVERTER_OPT_SURFACE_CACHE_SIZE \
+    "GstC2dVideoConverter.surface-cache-size"
+
 typedef struct _GstC2dVideoConverter GstC2dVideoConverter;
+typedef struct _GstC2dVideoOutput GstC2dVideoOutput;
+
+/**
+ * GstC2dVideoOutput:
+ * @frame: mapped output frame
+ * @srcrect: input region, zero width or height selects the whole input
+ * @destrect: output region, zero width or height selects the whole output
+ * @flip_h: flip output horizontally
+ * @flip_v: flip output vertically
+ * @rotate: output rotation
+ *
+ * One output of gst_c2d_video_converter_submit_outputs(). The settings
+ * override the converter configuration for this output only.
+ */
+struct _GstC2dVideoOutput
+{
+  GstVideoFrame         *frame;
+  GstVideoRectangle     srcrect;
+  GstVideoRectangle     destrect;
+  gboolean              flip_h;
+  gboolean              flip_v;
+  GstC2dVideoRotateMode rotate;
+};
 
 GST_VIDEO_API GstC2dVideoConverter *
 gst_c2d_video_converter_new        (GstVideoInfo *input,
@@ -162,6 +241,72 @@ gst_c2d_video_converter_frame      (GstC2dVideoConverter *convert,
                                     const GstVideoFrame *inframe,
                                     GstVideoFrame *outframe);
 
+/**
+ * gst_c2d_video_converter_submit_frame:
+ * @convert: the converter
+ * @inframe: input frame
+ * @outframe: output frame
+ *
+ * Submits the conversion of @inframe into @outframe without waiting for it
+ * to finish. Both frames must stay mapped until the request is waited for.
+ * Requests finish in the order they were submitted.
+ *
+ * Returns: (nullable): request ID to pass to
+ *     gst_c2d_video_converter_wait_request(), NULL on failure.
+ */
+GST_VIDEO_API gpointer
+gst_c2d_video_converter_submit_frame (GstC2dVideoConverter *convert,
+                                      const GstVideoFrame *inframe,
+                                      GstVideoFrame *outframe);
+
+/**
+ * gst_c2d_video_converter_submit_outputs:
+ * @convert: the converter
+ * @inframe: input frame
+ * @outputs: (array length=n_outputs): output frames and their settings
+ * @n_outputs: number of outputs, at most
+ *     #GST_C2D_VIDEO_CONVERTER_OPT_MAX_OUTPUTS
+ *
+ * Submits the conversion of @inframe into all @outputs at once. The input
+ * surface is set up only once and all draws are submitted before waiting.
+ * Same rules as for gst_c2d_video_converter_submit_frame() apply.
+ *
+ * Returns: (nullable): request ID covering all outputs, NULL on failure.
+ */
+GST_VIDEO_API gpointer
+gst_c2d_video_converter_submit_outputs (GstC2dVideoConverter *convert,
+                                        const GstVideoFrame *inframe,
+                                        const GstC2dVideoOutput *outputs,
+                                        guint n_outputs);
+
+/**
+ * gst_c2d_video_converter_wait_request:
+ * @convert: the converter
+ * @request_id: request ID returned by gst_c2d_video_converter_submit_frame()
+ *
+ * Blocks until the submitted conversion has finished. May be called from
+ * a thread other than the one submitting.
+ *
+ * Returns: TRUE if the conversion finished successfully.
+ */
+GST_VIDEO_API gboolean
+gst_c2d_video_converter_wait_request (GstC2dVideoConverter *convert,
+                                      gpointer request_id);
+
+/**
+ * gst_c2d_video_converter_get_stats:
+ * @convert: the converter
+ *
+ * Returns the surface cache counters: "surfaces", "capacity", "hits",
+ * "misses", "evictions" and "invalidations" of surfaces whose memory was
+ * freed.
+ *
+ * Returns: (transfer full): statistics structure, free with
+ *     gst_structure_free().
+ */
+GST_VIDEO_API GstStructure *
+gst_c2d_video_converter_get_stats (GstC2dVideoConverter *convert);
+
 G_END_DECLS
 
 #endif /* __GST_C2D_VIDEO_CONVERTER_H__ */
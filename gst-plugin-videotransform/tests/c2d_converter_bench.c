@@ -0,0 +1,245 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+
+#include "c2d_video_converter.h"
+#include "video_transform_buffer_pool.h"
+
+// Conversion time of the C2D library against the CPU driver.
+//
+// Usage: c2d_converter_bench [frames]
+//
+// Runs typical conversions through GstC2dVideoConverter once per driver,
+// on the buffers video transform allocates. The C2D library is skipped on
+// hosts where it cannot be loaded.
+
+#define DEFAULT_FRAMES 100
+#define WARMUP_FRAMES  5
+
+typedef struct _BenchCase BenchCase;
+
+struct _BenchCase {
+  const gchar           *name;
+  GstVideoFormat        informat;
+  gint                  inwidth;
+  gint                  inheight;
+  GstVideoFormat        outformat;
+  gint                  outwidth;
+  gint                  outheight;
+  GstC2dVideoRotateMode rotate;
+  gboolean              flip;
+};
+
+static const BenchCase cases[] = {
+  { "1080p NV12 to 720p NV12", GST_VIDEO_FORMAT_NV12, 1920, 1080,
+      GST_VIDEO_FORMAT_NV12, 1280, 720, GST_C2D_VIDEO_ROTATE_NONE, FALSE },
+  { "1080p NV12 to RGBA", GST_VIDEO_FORMAT_NV12, 1920, 1080,
+      GST_VIDEO_FORMAT_RGBA, 1920, 1080, GST_C2D_VIDEO_ROTATE_NONE, FALSE },
+  { "1080p NV12 rotate 90", GST_VIDEO_FORMAT_NV12, 1920, 1080,
+      GST_VIDEO_FORMAT_NV12, 1080, 1920, GST_C2D_VIDEO_ROTATE_90_CW, FALSE },
+  { "1080p NV12 flip", GST_VIDEO_FORMAT_NV12, 1920, 1080,
+      GST_VIDEO_FORMAT_NV12, 1920, 1080, GST_C2D_VIDEO_ROTATE_NONE, TRUE },
+  { "1080p NV12 to 300x300 RGB", GST_VIDEO_FORMAT_NV12, 1920, 1080,
+      GST_VIDEO_FORMAT_RGB, 300, 300, GST_C2D_VIDEO_ROTATE_NONE, FALSE },
+};
+
+static const gchar *drivers[] = { "c2d", "cpu" };
+
+// Same pool setup as the video transform output.
+static GstBufferPool *
+bench_pool_new (const GstVideoInfo * info)
+{
+  GstBufferPool *pool = NULL;
+  GstStructure *config = NULL;
+  GstAllocator *allocator = NULL;
+  GstCaps *caps = NULL;
+
+  pool = gst_vtrans_buffer_pool_new (GST_VTRANS_BUFFER_POOL_TYPE_ION);
+
+  // Hosts without ION.
+  if (pool == NULL)
+    pool = gst_vtrans_buffer_pool_new (GST_VTRANS_BUFFER_POOL_TYPE_MEMFD);
+
+  if (pool == NULL)
+    return NULL;
+
+  caps = gst_video_info_to_caps (info);
+  config = gst_buffer_pool_get_config (pool);
+  gst_buffer_pool_config_set_params (config, caps, info->size, 1, 1);
+  gst_caps_unref (caps);
+
+  allocator = gst_fd_allocator_new ();
+  gst_buffer_pool_config_set_allocator (config, allocator, NULL);
+  gst_buffer_pool_config_add_option (config, GST_BUFFER_POOL_OPTION_VIDEO_META);
+  g_object_unref (allocator);
+
+  if (!gst_buffer_pool_set_config (pool, config) ||
+      !gst_buffer_pool_set_active (pool, TRUE)) {
+    gst_object_unref (pool);
+    return NULL;
+  }
+
+  return pool;
+}
+
+// Returns the time per frame in milliseconds, negative if the driver or the
+// buffers are not available.
+static gdouble
+bench_run (const BenchCase * bench, const gchar * driver, guint n_frames)
+{
+  GstVideoInfo ininfo, outinfo;
+  GstBufferPool *inpool = NULL, *outpool = NULL;
+  GstBuffer *inbuffer = NULL, *outbuffer = NULL;
+  GstVideoFrame inframe, outframe;
+  GstC2dVideoConverter *convert = NULL;
+  GstStructure *options = NULL;
+  gint64 start = 0, elapsed = -1;
+  guint idx = 0;
+
+  gst_video_info_set_format (&ininfo, bench->informat, bench->inwidth,
+      bench->inheight);
+  gst_video_info_set_format (&outinfo, bench->outformat, bench->outwidth,
+      bench->outheight);
+
+  options = gst_structure_new ("bench",
+      GST_C2D_VIDEO_CONVERTER_OPT_DRIVER, G_TYPE_STRING, driver,
+      GST_C2D_VIDEO_CONVERTER_OPT_ROTATE_MODE, GST_TYPE_C2D_VIDEO_ROTATE_MODE,
+      bench->rotate,
+      GST_C2D_VIDEO_CONVERTER_OPT_FLIP_HORIZONTAL, G_TYPE_BOOLEAN,
+      bench->flip,
+      GST_C2D_VIDEO_CONVERTER_OPT_SCALE_METHOD,
+      GST_TYPE_C2D_VIDEO_SCALE_METHOD, GST_C2D_VIDEO_SCALE_BILINEAR,
+      NULL);
+
+  convert = gst_c2d_video_converter_new (&ininfo, &outinfo, options);
+  if (convert == NULL)
+    return -1.0;
+
+  inpool = bench_pool_new (&ininfo);
+  outpool = bench_pool_new (&outinfo);
+
+  if (inpool == NULL || outpool == NULL ||
+      gst_buffer_pool_acquire_buffer (inpool, &inbuffer, NULL) !=
+          GST_FLOW_OK ||
+      gst_buffer_pool_acquire_buffer (outpool, &outbuffer, NULL) !=
+          GST_FLOW_OK) {
+    g_printerr ("Failed to allocate %s buffers\n", bench->name);
+    goto cleanup;
+  }
+
+  if (!gst_video_frame_map (&inframe, &ininfo, inbuffer, GST_MAP_READ)) {
+    g_printerr ("Failed to map input buffer\n");
+    goto cleanup;
+  }
+
+  if (!gst_video_frame_map (&outframe, &outinfo, outbuffer, GST_MAP_WRITE)) {
+    g_printerr ("Failed to map output buffer\n");
+    gst_video_frame_unmap (&inframe);
+    goto cleanup;
+  }
+
+  for (idx = 0; idx < GST_VIDEO_FRAME_N_PLANES (&inframe); idx++) {
+    memset (GST_VIDEO_FRAME_PLANE_DATA (&inframe, idx), 0x80 + idx * 0x10,
+        GST_VIDEO_FRAME_PLANE_STRIDE (&inframe, idx) *
+        GST_VIDEO_FRAME_COMP_HEIGHT (&inframe, idx));
+  }
+
+  // First frames include the surface creation and GPU mapping.
+  for (idx = 0; idx < WARMUP_FRAMES; idx++)
+    gst_c2d_video_converter_frame (convert, &inframe, &outframe);
+
+  start = g_get_monotonic_time ();
+  for (idx = 0; idx < n_frames; idx++)
+    gst_c2d_video_converter_frame (convert, &inframe, &outframe);
+  elapsed = g_get_monotonic_time () - start;
+
+  gst_video_frame_unmap (&outframe);
+  gst_video_frame_unmap (&inframe);
+
+cleanup:
+  if (inbuffer != NULL)
+    gst_buffer_unref (inbuffer);
+
+  if (outbuffer != NULL)
+    gst_buffer_unref (outbuffer);
+
+  if (inpool != NULL) {
+    gst_buffer_pool_set_active (inpool, FALSE);
+    gst_object_unref (inpool);
+  }
+
+  if (outpool != NULL) {
+    gst_buffer_pool_set_active (outpool, FALSE);
+    gst_object_unref (outpool);
+  }
+
+  gst_c2d_video_converter_free (convert);
+
+  return (elapsed < 0) ? -1.0 : elapsed / 1000.0 / n_frames;
+}
+
+int
+main (int argc, char ** argv)
+{
+  guint n_frames = DEFAULT_FRAMES, idx = 0, num = 0;
+
+  gst_init (&argc, &argv);
+
+  if (argc > 1)
+    n_frames = strtoul (argv[1], NULL, 0);
+
+  if (n_frames == 0) {
+    g_printerr ("Usage: %s [frames]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  g_print ("%-28s %14s %14s\n", "", drivers[0], drivers[1]);
+
+  for (idx = 0; idx < G_N_ELEMENTS (cases); idx++) {
+    g_print ("%-28s", cases[idx].name);
+
+    for (num = 0; num < G_N_ELEMENTS (drivers); num++) {
+      gdouble msecs = bench_run (&cases[idx], drivers[num], n_frames);
+
+      if (msecs < 0.0)
+        g_print (" %14s", "n/a");
+      else
+        g_print (" %8.2f ms/fr", msecs);
+    }
+
+    g_print ("\n");
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,532 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "c2d_cpu_render.h"
+
+// Blits of the CPU renderer against reference results, for the SIMD build
+// and for the scalar one, which must produce the same pixels.
+
+// Second build of c2d_cpu_render.c with CPU_RENDER_NO_SIMD.
+G_GNUC_INTERNAL gboolean
+gst_c2d_cpu_render_scalar (const GstC2dCpuDraw *draw);
+
+typedef gboolean (*TestRenderFunc) (const GstC2dCpuDraw *draw);
+
+typedef struct _TestRenderer TestRenderer;
+typedef struct _TestLayout TestLayout;
+
+struct _TestRenderer {
+  const gchar     *name;
+  TestRenderFunc  render;
+};
+
+// Pixel layout of a surface, components are listed in memory order.
+struct _TestLayout {
+  GstC2dCpuFormat format;
+  const gchar     *order;
+  gboolean        alpha;
+};
+
+static const TestRenderer renderers[] = {
+  { "simd", gst_c2d_cpu_render },
+  { "scalar", gst_c2d_cpu_render_scalar },
+};
+
+static const TestLayout layouts[] = {
+  { GST_C2D_CPU_FORMAT_NV12, NULL, FALSE },
+  { GST_C2D_CPU_FORMAT_NV21, NULL, FALSE },
+  { GST_C2D_CPU_FORMAT_RGB, "RGBA", TRUE },
+  { GST_C2D_CPU_FORMAT_RGB, "BGRx", FALSE },
+  { GST_C2D_CPU_FORMAT_RGB, "RGB", FALSE },
+};
+
+#define N_LAYOUTS G_N_ELEMENTS (layouts)
+
+static const guint rotations[] = { 0, 90, 180, 270 };
+
+// Extra bytes at the end of every row, never written.
+#define STRIDE_PADDING 9
+
+static void
+surface_init (GstC2dCpuSurface * surface, const TestLayout * layout,
+    gint width, gint height)
+{
+  guint idx = 0;
+
+  memset (surface, 0, sizeof (*surface));
+  surface->format = layout->format;
+  surface->width = width;
+  surface->height = height;
+
+  if (layout->format == GST_C2D_CPU_FORMAT_RGB) {
+    surface->bpp = strlen (layout->order);
+    surface->alpha = layout->alpha;
+    surface->offsets[3] = -1;
+
+    for (idx = 0; idx < surface->bpp; idx++) {
+      const gchar *component = strchr ("RGBA", layout->order[idx]);
+
+      if (component != NULL)
+        surface->offsets[component - "RGBA"] = idx;
+    }
+
+    surface->strides[0] = width * surface->bpp + STRIDE_PADDING;
+    surface->planes[0] = g_malloc (surface->strides[0] * height);
+    return;
+  }
+
+  surface->strides[0] = width + STRIDE_PADDING;
+  surface->strides[1] = ((width + 1) & ~1) + STRIDE_PADDING;
+  surface->planes[0] = g_malloc (surface->strides[0] * height);
+  surface->planes[1] = g_malloc (surface->strides[1] * ((height + 1) / 2));
+}
+
+static gsize
+surface_plane_size (const GstC2dCpuSurface * surface, guint plane)
+{
+  if (plane == 0)
+    return surface->strides[0] * surface->height;
+
+  if (surface->format == GST_C2D_CPU_FORMAT_RGB)
+    return 0;
+
+  return surface->strides[1] * ((surface->height + 1) / 2);
+}
+
+static void
+surface_fill (GstC2dCpuSurface * surface, guint32 seed)
+{
+  GRand *rand = g_rand_new_with_seed (seed);
+  guint plane = 0;
+  gsize idx = 0;
+
+  for (plane = 0; plane < 2; plane++) {
+    for (idx = 0; idx < surface_plane_size (surface, plane); idx++)
+      surface->planes[plane][idx] = g_rand_int_range (rand, 0, 256);
+  }
+
+  g_rand_free (rand);
+}
+
+static void
+surface_copy (GstC2dCpuSurface * dest, const GstC2dCpuSurface * source)
+{
+  guint plane = 0;
+
+  *dest = *source;
+
+  for (plane = 0; plane < 2; plane++) {
+    gsize size = surface_plane_size (source, plane);
+
+    if (size == 0)
+      continue;
+
+    dest->planes[plane] = g_malloc (size);
+    memcpy (dest->planes[plane], source->planes[plane], size);
+  }
+}
+
+static gboolean
+surface_equal (const GstC2dCpuSurface * a, const GstC2dCpuSurface * b)
+{
+  guint plane = 0;
+
+  for (plane = 0; plane < 2; plane++) {
+    gsize size = surface_plane_size (a, plane);
+
+    if (size != 0 && memcmp (a->planes[plane], b->planes[plane], size) != 0)
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+static void
+surface_clear (GstC2dCpuSurface * surface)
+{
+  g_free (surface->planes[0]);
+  g_free (surface->planes[1]);
+}
+
+static void
+draw_init (GstC2dCpuDraw * draw, const GstC2dCpuSurface * source,
+    const GstC2dCpuSurface * target, guint rotate, guint flip,
+    gboolean bilinear)
+{
+  memset (draw, 0, sizeof (*draw));
+  draw->source = *source;
+  draw->target = *target;
+  draw->rotate = rotate;
+  draw->flip_h = (flip & 1) != 0;
+  draw->flip_v = (flip & 2) != 0;
+  draw->bilinear = bilinear;
+}
+
+// Source position shown by a destination pixel, in destination units of the
+// unrotated and unmirrored region, see mapping_init().
+static void
+reference_position (const GstC2dCpuDraw * draw, gint dx, gint dy, gint width,
+    gint height, gint * u, gint * v)
+{
+  gboolean swap = (draw->rotate == 90) || (draw->rotate == 270);
+  gint uwidth = swap ? height : width, uheight = swap ? width : height;
+
+  switch (draw->rotate) {
+    case 90:
+      *u = dy;
+      *v = uheight - 1 - dx;
+      break;
+    case 180:
+      *u = uwidth - 1 - dx;
+      *v = uheight - 1 - dy;
+      break;
+    case 270:
+      *u = uwidth - 1 - dy;
+      *v = dx;
+      break;
+    default:
+      *u = dx;
+      *v = dy;
+      break;
+  }
+
+  if (draw->flip_h)
+    *u = uwidth - 1 - *u;
+
+  if (draw->flip_v)
+    *v = uheight - 1 - *v;
+}
+
+// Every layout pair, rotation, mirroring and filter with down and up
+// scaling, regions at odd positions and widths that leave a SIMD tail.
+static void
+test_simd_matches_scalar (void)
+{
+  static const GstC2dCpuRect srcrects[] = {
+    { 7, 5, 181, 113 },
+    { 2, 3, 45, 29 },
+  };
+  static const GstC2dCpuRect destrects[] = {
+    { 4, 2, 97, 61 },
+    { 2, 6, 173, 119 },
+  };
+  GstC2dCpuSurface source, simd, scalar;
+  GstC2dCpuDraw draw;
+  guint in = 0, out = 0, rotate = 0, flip = 0, scale = 0;
+  gboolean bilinear = FALSE;
+
+  for (in = 0; in < N_LAYOUTS; in++) {
+    surface_init (&source, &layouts[in], 199, 125);
+    surface_fill (&source, in + 1);
+
+    for (out = 0; out < N_LAYOUTS; out++) {
+      surface_init (&simd, &layouts[out], 192, 192);
+      surface_fill (&simd, 100 + out);
+      surface_copy (&scalar, &simd);
+
+      for (rotate = 0; rotate < G_N_ELEMENTS (rotations); rotate++) {
+        for (flip = 0; flip < 4; flip++) {
+          for (scale = 0; scale < G_N_ELEMENTS (srcrects); scale++) {
+            for (bilinear = FALSE; bilinear <= TRUE; bilinear++) {
+              GstC2dCpuRect destrect = destrects[scale];
+
+              if ((rotations[rotate] % 180) != 0) {
+                destrect.w = destrects[scale].h;
+                destrect.h = destrects[scale].w;
+              }
+
+              draw_init (&draw, &source, &simd, rotations[rotate], flip,
+                  bilinear);
+              draw.srcrect = srcrects[scale];
+              draw.destrect = destrect;
+              g_assert_true (gst_c2d_cpu_render (&draw));
+
+              draw.target = scalar;
+              g_assert_true (gst_c2d_cpu_render_scalar (&draw));
+
+              if (!surface_equal (&simd, &scalar)) {
+                g_error ("Layout %u to %u, rotate %u, flip %u, scale %u, "
+                    "bilinear %d differs", in, out, rotations[rotate], flip,
+                    scale, bilinear);
+              }
+            }
+          }
+        }
+      }
+
+      surface_clear (&simd);
+      surface_clear (&scalar);
+    }
+
+    surface_clear (&source);
+  }
+}
+
+// Rotation and mirroring without scaling only move pixels, with either
+// filter. Chroma moves by whole samples as all regions are even.
+static void
+test_rotate_flip (gconstpointer data)
+{
+  const TestRenderer *renderer = data;
+  // NV12 and RGBA layouts.
+  static const guint yuv = 0, rgba = 2;
+  GstC2dCpuSurface source, target;
+  GstC2dCpuDraw draw;
+  guint idx = 0, layout = 0, rotate = 0, flip = 0;
+  gint dx = 0, dy = 0, u = 0, v = 0, width = 0, height = 0, num = 0;
+  gboolean bilinear = FALSE;
+
+  for (idx = 0; idx < 2; idx++) {
+    layout = (idx == 0) ? yuv : rgba;
+
+    surface_init (&source, &layouts[layout], 70, 46);
+    surface_fill (&source, 7);
+    surface_init (&target, &layouts[layout], 64, 64);
+
+    for (rotate = 0; rotate < G_N_ELEMENTS (rotations); rotate++) {
+      for (flip = 0; flip < 4; flip++) {
+        for (bilinear = FALSE; bilinear <= TRUE; bilinear++) {
+          const GstC2dCpuSurface *s = &source, *t = &target;
+
+          width = ((rotations[rotate] % 180) == 0) ? 42 : 26;
+          height = ((rotations[rotate] % 180) == 0) ? 26 : 42;
+
+          surface_fill (&target, 8);
+          draw_init (&draw, &source, &target, rotations[rotate], flip,
+              bilinear);
+          draw.srcrect = (GstC2dCpuRect) { 6, 4, 42, 26 };
+          draw.destrect = (GstC2dCpuRect) { 2, 4, width, height };
+          g_assert_true (renderer->render (&draw));
+
+          for (dy = 0; dy < height; dy++) {
+            for (dx = 0; dx < width; dx++) {
+              const guint8 *expected = NULL, *actual = NULL;
+
+              reference_position (&draw, dx, dy, width, height, &u, &v);
+
+              if (layout == rgba) {
+                expected = s->planes[0] + (4 + v) * s->strides[0] +
+                    (6 + u) * 4;
+                actual = t->planes[0] + (4 + dy) * t->strides[0] +
+                    (2 + dx) * 4;
+                g_assert_cmpmem (actual, 4, expected, 4);
+                continue;
+              }
+
+              expected = s->planes[0] + (4 + v) * s->strides[0] + 6 + u;
+              actual = t->planes[0] + (4 + dy) * t->strides[0] + 2 + dx;
+              g_assert_cmpuint (*actual, ==, *expected);
+            }
+          }
+
+          // Chroma of the YUV region, at half resolution.
+          for (dy = 0; layout == yuv && dy < height / 2; dy++) {
+            for (dx = 0; dx < width / 2; dx++) {
+              const guint8 *expected = NULL, *actual = NULL;
+
+              reference_position (&draw, dx, dy, width / 2, height / 2, &u,
+                  &v);
+              expected = s->planes[1] + (2 + v) * s->strides[1] +
+                  (3 + u) * 2;
+              actual = t->planes[1] + (2 + dy) * t->strides[1] +
+                  (1 + dx) * 2;
+
+              for (num = 0; num < 2; num++)
+                g_assert_cmpuint (actual[num], ==, expected[num]);
+            }
+          }
+        }
+      }
+    }
+
+    surface_clear (&source);
+    surface_clear (&target);
+  }
+}
+
+// Bilinear sample of a plane in double precision, clamped at the edges.
+static gdouble
+reference_bilinear (const guint8 * data, gint stride, gint width,
+    gint height, gint channels, gdouble x, gdouble y)
+{
+  gint x0, y0, x1, y1;
+  gdouble fx, fy, top, bottom;
+
+  x = CLAMP (x, 0.0, width - 1.0);
+  y = CLAMP (y, 0.0, height - 1.0);
+  x0 = (gint) floor (x);
+  y0 = (gint) floor (y);
+  x1 = MIN (x0 + 1, width - 1);
+  y1 = MIN (y0 + 1, height - 1);
+  fx = x - x0;
+  fy = y - y0;
+
+  top = data[y0 * stride + x0 * channels] * (1.0 - fx) +
+      data[y0 * stride + x1 * channels] * fx;
+  bottom = data[y1 * stride + x0 * channels] * (1.0 - fx) +
+      data[y1 * stride + x1 * channels] * fx;
+
+  return top * (1.0 - fy) + bottom * fy;
+}
+
+// Scaled luma against pixel center sampling, the renderer works with 16.16
+// positions and 8 bit weights.
+static void
+test_bilinear (gconstpointer data)
+{
+  const TestRenderer *renderer = data;
+  GstC2dCpuSurface source, target;
+  GstC2dCpuRect srcrect = { 5, 3, 101, 67 };
+  GstC2dCpuDraw draw;
+  guint rotate = 0, flip = 0;
+  gint dx = 0, dy = 0, u = 0, v = 0, width = 0, height = 0, diff = 0;
+  gdouble x = 0.0, y = 0.0;
+
+  surface_init (&source, &layouts[0], 120, 80);
+  surface_fill (&source, 11);
+  surface_init (&target, &layouts[0], 256, 256);
+
+  for (rotate = 0; rotate < G_N_ELEMENTS (rotations); rotate++) {
+    for (flip = 0; flip < 4; flip++) {
+      width = ((rotations[rotate] % 180) == 0) ? 250 : 46;
+      height = ((rotations[rotate] % 180) == 0) ? 46 : 250;
+
+      draw_init (&draw, &source, &target, rotations[rotate], flip, TRUE);
+      draw.srcrect = srcrect;
+      draw.destrect = (GstC2dCpuRect) { 0, 0, width, height };
+      g_assert_true (renderer->render (&draw));
+
+      for (dy = 0; dy < height; dy++) {
+        for (dx = 0; dx < width; dx++) {
+          gint uwidth = ((rotations[rotate] % 180) == 0) ? width : height;
+          gint uheight = ((rotations[rotate] % 180) == 0) ? height : width;
+          gint actual = target.planes[0][dy * target.strides[0] + dx];
+
+          reference_position (&draw, dx, dy, width, height, &u, &v);
+          x = srcrect.x + (u + 0.5) * srcrect.w / uwidth - 0.5;
+          y = srcrect.y + (v + 0.5) * srcrect.h / uheight - 0.5;
+
+          diff = MAX (diff, abs (actual - (gint) lround (reference_bilinear (
+              source.planes[0], source.strides[0], source.width,
+              source.height, 1, x, y))));
+        }
+      }
+    }
+  }
+
+  g_assert_cmpint (diff, <=, 2);
+
+  surface_clear (&source);
+  surface_clear (&target);
+}
+
+// BT.601 limited range conversion of every pixel, odd widths leave a tail
+// after the SIMD blocks.
+static void
+test_yuv_to_rgb (gconstpointer data)
+{
+  const TestRenderer *renderer = data;
+  GstC2dCpuSurface source, target;
+  GstC2dCpuDraw draw;
+  guint in = 0, out = 0;
+  gint x = 0, y = 0;
+
+  for (in = 0; in < 2; in++) {
+    surface_init (&source, &layouts[in], 203, 31);
+    surface_fill (&source, 21 + in);
+
+    for (out = 2; out < N_LAYOUTS; out++) {
+      surface_init (&target, &layouts[out], 203, 31);
+
+      draw_init (&draw, &source, &target, 0, 0, FALSE);
+      draw.srcrect = draw.destrect = (GstC2dCpuRect) { 0, 0, 203, 31 };
+      g_assert_true (renderer->render (&draw));
+
+      for (y = 0; y < 31; y++) {
+        for (x = 0; x < 203; x++) {
+          const guint8 *uv = source.planes[1] + (y / 2) * source.strides[1] +
+              (x / 2) * 2;
+          const guint8 *pixel = target.planes[0] + y * target.strides[0] +
+              x * target.bpp;
+          gint c = source.planes[0][y * source.strides[0] + x] - 16;
+          gint d = uv[in] - 128, e = uv[1 - in] - 128;
+
+          g_assert_cmpint (pixel[target.offsets[0]], ==,
+              CLAMP ((298 * c + 409 * e + 128) >> 8, 0, 255));
+          g_assert_cmpint (pixel[target.offsets[1]], ==,
+              CLAMP ((298 * c - 100 * d - 208 * e + 128) >> 8, 0, 255));
+          g_assert_cmpint (pixel[target.offsets[2]], ==,
+              CLAMP ((298 * c + 516 * d + 128) >> 8, 0, 255));
+        }
+      }
+
+      surface_clear (&target);
+    }
+
+    surface_clear (&source);
+  }
+}
+
+int
+main (int argc, char ** argv)
+{
+  guint idx = 0;
+
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/c2d-cpu-render/simd-matches-scalar",
+      test_simd_matches_scalar);
+
+  for (idx = 0; idx < G_N_ELEMENTS (renderers); idx++) {
+    gchar *path = NULL;
+
+    path = g_strdup_printf ("/c2d-cpu-render/%s/rotate-flip",
+        renderers[idx].name);
+    g_test_add_data_func (path, &renderers[idx], test_rotate_flip);
+    g_free (path);
+
+    path = g_strdup_printf ("/c2d-cpu-render/%s/bilinear",
+        renderers[idx].name);
+    g_test_add_data_func (path, &renderers[idx], test_bilinear);
+    g_free (path);
+
+    path = g_strdup_printf ("/c2d-cpu-render/%s/yuv-to-rgb",
+        renderers[idx].name);
+    g_test_add_data_func (path, &renderers[idx], test_yuv_to_rgb);
+    g_free (path);
+  }
+
+  return g_test_run ();
+}
@@ -0,0 +1,330 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <string.h>
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include <gst/allocators/allocators.h>
+
+#include "video_transform_buffer_pool.h"
+
+// Memory reuse of the video transform pool, on memfd memory which does not
+// need ION. NV12 frames of 320x240 take 115200 bytes, allocated in blocks of
+// the 131072 bytes size class.
+
+// Upper bound for the idle timeout of free memory, which is 5 seconds.
+#define IDLE_TRIM_WAIT (10 * G_TIME_SPAN_SECOND)
+
+static GstBufferPool *
+test_pool_new (GstBufferPool * previous)
+{
+  return gst_vtrans_buffer_pool_new_full (GST_VTRANS_BUFFER_POOL_TYPE_MEMFD,
+      previous);
+}
+
+// Same configuration as the video transform output pool.
+static void
+test_pool_configure (GstBufferPool * pool, gint width, gint height,
+    guint minbuffers)
+{
+  GstStructure *config = NULL;
+  GstAllocator *allocator = NULL;
+  GstVideoInfo info;
+  GstCaps *caps = NULL;
+
+  gst_video_info_set_format (&info, GST_VIDEO_FORMAT_NV12, width, height);
+  caps = gst_video_info_to_caps (&info);
+
+  config = gst_buffer_pool_get_config (pool);
+  gst_buffer_pool_config_set_params (config, caps, info.size, minbuffers, 0);
+  gst_caps_unref (caps);
+
+  allocator = gst_fd_allocator_new ();
+  gst_buffer_pool_config_set_allocator (config, allocator, NULL);
+  gst_buffer_pool_config_add_option (config, GST_BUFFER_POOL_OPTION_VIDEO_META);
+  g_object_unref (allocator);
+
+  g_assert_true (gst_buffer_pool_set_config (pool, config));
+  g_assert_true (gst_buffer_pool_set_active (pool, TRUE));
+}
+
+// Acquires a buffer, writes all of it and returns the FD of its memory.
+static gint
+test_pool_acquire (GstBufferPool * pool, GstBuffer ** buffer)
+{
+  GstMapInfo map;
+
+  g_assert_cmpint (gst_buffer_pool_acquire_buffer (pool, buffer, NULL), ==,
+      GST_FLOW_OK);
+
+  g_assert_true (gst_buffer_map (*buffer, &map, GST_MAP_WRITE));
+  memset (map.data, 0x80, map.size);
+  gst_buffer_unmap (*buffer, &map);
+
+  return gst_fd_memory_get_fd (gst_buffer_peek_memory (*buffer, 0));
+}
+
+static guint64
+test_pool_stat (GstBufferPool * pool, const gchar * name)
+{
+  GstStructure *stats = gst_vtrans_buffer_pool_get_stats (pool);
+  guint64 value = 0;
+  guint count = 0;
+
+  if (g_str_equal (name, "free-buffers")) {
+    g_assert_true (gst_structure_get_uint (stats, name, &count));
+    value = count;
+  } else {
+    g_assert_true (gst_structure_get_uint64 (stats, name, &value));
+  }
+
+  gst_structure_free (stats);
+  return value;
+}
+
+// Memory is reused for frames of the same size class, and for smaller
+// classes down to half of its own. Other sizes get new memory.
+static void
+test_size_classes (void)
+{
+  GstBufferPool *pool = test_pool_new (NULL);
+  GstBuffer *buffers[2] = { NULL, NULL };
+  gint fds[2], fd;
+
+  g_assert_nonnull (pool);
+
+  test_pool_configure (pool, 320, 240, 0);
+  fds[0] = test_pool_acquire (pool, &buffers[0]);
+  fds[1] = test_pool_acquire (pool, &buffers[1]);
+
+  g_assert_cmpuint (test_pool_stat (pool, "allocations"), ==, 2);
+  g_assert_cmpuint (test_pool_stat (pool, "reuses"), ==, 0);
+
+  gst_buffer_unref (buffers[0]);
+  gst_buffer_unref (buffers[1]);
+
+  // Deactivating the pool puts its memory on the free list.
+  g_assert_true (gst_buffer_pool_set_active (pool, FALSE));
+  g_assert_cmpuint (test_pool_stat (pool, "free-buffers"), ==, 2);
+  g_assert_cmpuint (test_pool_stat (pool, "free-bytes"), ==, 2 * 131072);
+
+  // 111360 bytes, in the 114688 bytes class.
+  test_pool_configure (pool, 320, 232, 0);
+  fd = test_pool_acquire (pool, &buffers[0]);
+
+  g_assert_true (fd == fds[0] || fd == fds[1]);
+  g_assert_cmpuint (test_pool_stat (pool, "allocations"), ==, 2);
+  g_assert_cmpuint (test_pool_stat (pool, "reuses"), ==, 1);
+  g_assert_cmpuint (test_pool_stat (pool, "free-buffers"), ==, 1);
+
+  gst_buffer_unref (buffers[0]);
+  g_assert_true (gst_buffer_pool_set_active (pool, FALSE));
+
+  // 460800 bytes, larger than the free memory.
+  test_pool_configure (pool, 640, 480, 0);
+  fd = test_pool_acquire (pool, &buffers[0]);
+
+  g_assert_true (fd != fds[0] && fd != fds[1]);
+  g_assert_cmpuint (test_pool_stat (pool, "allocations"), ==, 3);
+  g_assert_cmpuint (test_pool_stat (pool, "reuses"), ==, 1);
+
+  gst_buffer_unref (buffers[0]);
+  g_assert_true (gst_buffer_pool_set_active (pool, FALSE));
+
+  // 28800 bytes, in the 32768 bytes class which is less than half of the
+  // free blocks.
+  test_pool_configure (pool, 160, 120, 0);
+  fd = test_pool_acquire (pool, &buffers[0]);
+
+  g_assert_true (fd != fds[0] && fd != fds[1]);
+  g_assert_cmpuint (test_pool_stat (pool, "allocations"), ==, 4);
+  g_assert_cmpuint (test_pool_stat (pool, "reuses"), ==, 1);
+
+  gst_buffer_unref (buffers[0]);
+  g_assert_true (gst_buffer_pool_set_active (pool, FALSE));
+
+  g_assert_cmpuint (test_pool_stat (pool, "free-buffers"), ==, 4);
+  gst_object_unref (pool);
+}
+
+// The smallest of the fitting free blocks is taken.
+static void
+test_smallest_fit (void)
+{
+  GstBufferPool *small = test_pool_new (NULL);
+  GstBufferPool *large = NULL, *pool = NULL;
+  GstBuffer *buffers[2] = { NULL, NULL };
+  gint smallfd, largefd;
+
+  g_assert_nonnull (small);
+  large = test_pool_new (small);
+  g_assert_nonnull (large);
+
+  // 165888 bytes, in the 196608 bytes class.
+  test_pool_configure (large, 384, 288, 0);
+  largefd = test_pool_acquire (large, &buffers[0]);
+
+  test_pool_configure (small, 320, 240, 0);
+  smallfd = test_pool_acquire (small, &buffers[1]);
+
+  gst_buffer_unref (buffers[0]);
+  gst_buffer_unref (buffers[1]);
+
+  g_assert_true (gst_buffer_pool_set_active (large, FALSE));
+  g_assert_true (gst_buffer_pool_set_active (small, FALSE));
+  g_assert_cmpuint (test_pool_stat (small, "free-bytes"), ==, 131072 + 196608);
+
+  // Both blocks fit 320x240 frames.
+  pool = test_pool_new (small);
+  g_assert_nonnull (pool);
+
+  test_pool_configure (pool, 320, 240, 0);
+  g_assert_cmpint (test_pool_acquire (pool, &buffers[0]), ==, smallfd);
+  g_assert_cmpint (test_pool_acquire (pool, &buffers[1]), ==, largefd);
+  g_assert_cmpuint (test_pool_stat (pool, "reuses"), ==, 2);
+
+  gst_buffer_unref (buffers[0]);
+  gst_buffer_unref (buffers[1]);
+
+  gst_object_unref (pool);
+  gst_object_unref (large);
+  gst_object_unref (small);
+}
+
+// A pool replacing another on renegotiation takes over its memory, instead
+// of pre-allocating its minimum number of buffers.
+static void
+test_renegotiation (void)
+{
+  GstBufferPool *pool = test_pool_new (NULL);
+  GstBufferPool *newpool = NULL, *other = NULL;
+  GstBuffer *buffers[2] = { NULL, NULL };
+  gint fds[2], fd;
+
+  g_assert_nonnull (pool);
+
+  test_pool_configure (pool, 320, 240, 0);
+  fds[0] = test_pool_acquire (pool, &buffers[0]);
+  fds[1] = test_pool_acquire (pool, &buffers[1]);
+
+  gst_buffer_unref (buffers[0]);
+  gst_buffer_unref (buffers[1]);
+
+  // Created while the previous pool is still active, like on a caps change.
+  newpool = test_pool_new (pool);
+  g_assert_nonnull (newpool);
+
+  // Pools without a previous one have memory of their own.
+  other = test_pool_new (NULL);
+  g_assert_nonnull (other);
+  g_assert_cmpuint (test_pool_stat (other, "allocations"), ==, 0);
+  gst_object_unref (other);
+
+  g_assert_true (gst_buffer_pool_set_active (pool, FALSE));
+  gst_object_unref (pool);
+
+  // The freed memory outlives the previous pool.
+  g_assert_cmpuint (test_pool_stat (newpool, "allocations"), ==, 2);
+  g_assert_cmpuint (test_pool_stat (newpool, "free-buffers"), ==, 2);
+
+  test_pool_configure (newpool, 320, 236, 2);
+
+  fd = test_pool_acquire (newpool, &buffers[0]);
+  g_assert_true (fd == fds[0] || fd == fds[1]);
+
+  fd = test_pool_acquire (newpool, &buffers[1]);
+  g_assert_true (fd == fds[0] || fd == fds[1]);
+
+  g_assert_cmpuint (test_pool_stat (newpool, "allocations"), ==, 2);
+  g_assert_cmpuint (test_pool_stat (newpool, "reuses"), ==, 2);
+  g_assert_cmpuint (test_pool_stat (newpool, "prewarmed"), ==, 0);
+
+  gst_buffer_unref (buffers[0]);
+  gst_buffer_unref (buffers[1]);
+
+  gst_object_unref (newpool);
+}
+
+// Free memory is returned to the device once idle for the timeout.
+static void
+test_idle_trim (void)
+{
+  GstBufferPool *pool = test_pool_new (NULL);
+  GstBuffer *buffers[2] = { NULL, NULL };
+  gint64 deadline;
+
+  g_assert_nonnull (pool);
+
+  test_pool_configure (pool, 320, 240, 0);
+  test_pool_acquire (pool, &buffers[0]);
+  test_pool_acquire (pool, &buffers[1]);
+
+  gst_buffer_unref (buffers[0]);
+  gst_buffer_unref (buffers[1]);
+
+  g_assert_true (gst_buffer_pool_set_active (pool, FALSE));
+  g_assert_cmpuint (test_pool_stat (pool, "free-buffers"), ==, 2);
+  g_assert_cmpuint (test_pool_stat (pool, "trimmed"), ==, 0);
+
+  deadline = g_get_monotonic_time () + IDLE_TRIM_WAIT;
+
+  while (test_pool_stat (pool, "free-buffers") != 0 &&
+      g_get_monotonic_time () < deadline)
+    g_usleep (100 * G_TIME_SPAN_MILLISECOND);
+
+  g_assert_cmpuint (test_pool_stat (pool, "free-buffers"), ==, 0);
+  g_assert_cmpuint (test_pool_stat (pool, "free-bytes"), ==, 0);
+  g_assert_cmpuint (test_pool_stat (pool, "trimmed"), ==, 2);
+  g_assert_cmpuint (test_pool_stat (pool, "releases"), ==, 2);
+
+  // Trimmed memory is allocated again.
+  test_pool_configure (pool, 320, 240, 0);
+  test_pool_acquire (pool, &buffers[0]);
+
+  g_assert_cmpuint (test_pool_stat (pool, "allocations"), ==, 3);
+  g_assert_cmpuint (test_pool_stat (pool, "reuses"), ==, 0);
+
+  gst_buffer_unref (buffers[0]);
+  gst_object_unref (pool);
+}
+
+int
+main (int argc, char ** argv)
+{
+  gst_init (&argc, &argv);
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/vtrans-buffer-pool/size-classes", test_size_classes);
+  g_test_add_func ("/vtrans-buffer-pool/smallest-fit", test_smallest_fit);
+  g_test_add_func ("/vtrans-buffer-pool/renegotiation", test_renegotiation);
+  g_test_add_func ("/vtrans-buffer-pool/idle-trim", test_idle_trim);
+
+  return g_test_run ();
+}
@@ -0,0 +1,515 @@
+/*
+* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include <gst/allocators/allocators.h>
+
+#include <ml-meta/ml_meta.h>
+
+#include "video_transform.h"
+#include "video_transform_buffer_pool.h"
+
+// Pipelined conversions and metadata of the video transform element, on the
+// CPU driver and memfd memory so that neither the C2D library nor ION is
+// needed. The element is fed and drained through pads of the test.
+
+#define IN_CAPS \
+    "video/x-raw, format=NV12, width=320, height=240, framerate=30/1, " \
+    "pixel-aspect-ratio=1/1"
+#define OUT_CAPS \
+    "video/x-raw, format=NV12, width=160, height=120, pixel-aspect-ratio=1/1"
+#define ROTATED_CAPS \
+    "video/x-raw, format=NV12, width=120, height=160, pixel-aspect-ratio=1/1"
+
+#define FRAME_DURATION (GST_SECOND / 30)
+#define PIPELINE_DEPTH 4
+
+typedef struct _TestHarness TestHarness;
+
+struct _TestHarness
+{
+  GstElement    *element;
+  // Feeds the element and receives its output respectively.
+  GstPad        *srcpad;
+  GstPad        *sinkpad;
+  GstBufferPool *pool;
+  // Caps downstream asks for.
+  const gchar   *outcaps;
+
+  // Protects the fields below.
+  GMutex        lock;
+  // Output buffers, EOS and FLUSH_STOP events in arrival order.
+  GQueue        items;
+  guint         nbuffers;
+  // Buffers accepted before returning errors, 0 for no limit.
+  guint         maxbuffers;
+};
+
+static GstFlowReturn
+test_sink_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
+{
+  TestHarness *harness = gst_pad_get_element_private (pad);
+  GstFlowReturn ret = GST_FLOW_OK;
+
+  g_mutex_lock (&harness->lock);
+
+  if (harness->maxbuffers > 0 && harness->nbuffers >= harness->maxbuffers) {
+    gst_buffer_unref (buffer);
+    ret = GST_FLOW_ERROR;
+  } else {
+    g_queue_push_tail (&harness->items, buffer);
+    harness->nbuffers++;
+  }
+
+  g_mutex_unlock (&harness->lock);
+  return ret;
+}
+
+static gboolean
+test_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  TestHarness *harness = gst_pad_get_element_private (pad);
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_EOS:
+    case GST_EVENT_FLUSH_STOP:
+      g_mutex_lock (&harness->lock);
+      g_queue_push_tail (&harness->items, event);
+      g_mutex_unlock (&harness->lock);
+      break;
+    default:
+      gst_event_unref (event);
+      break;
+  }
+  return TRUE;
+}
+
+// Downstream asks for a downscale, so that every frame is converted.
+static gboolean
+test_sink_query (GstPad * pad, GstObject * parent, GstQuery * query)
+{
+  TestHarness *harness = gst_pad_get_element_private (pad);
+  GstCaps *caps = NULL, *filter = NULL;
+
+  if (GST_QUERY_TYPE (query) != GST_QUERY_CAPS)
+    return gst_pad_query_default (pad, parent, query);
+
+  gst_query_parse_caps (query, &filter);
+  caps = gst_caps_from_string (harness->outcaps);
+
+  if (filter != NULL) {
+    GstCaps *intersection = gst_caps_intersect_full (filter, caps,
+        GST_CAPS_INTERSECT_FIRST);
+    gst_caps_unref (caps);
+    caps = intersection;
+  }
+
+  gst_query_set_caps_result (query, caps);
+  gst_caps_unref (caps);
+  return TRUE;
+}
+
+static void
+test_harness_segment (TestHarness * harness)
+{
+  GstSegment segment;
+
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  g_assert_true (gst_pad_push_event (harness->srcpad,
+      gst_event_new_segment (&segment)));
+}
+
+static TestHarness *
+test_harness_new (guint depth, GstVideoTransformRotate rotate,
+    const gchar * outcaps)
+{
+  TestHarness *harness = g_new0 (TestHarness, 1);
+  GstStructure *config = NULL;
+  GstAllocator *allocator = NULL;
+  GstVideoInfo info;
+  GstCaps *caps = NULL;
+  GstPad *pad = NULL;
+
+  g_mutex_init (&harness->lock);
+  g_queue_init (&harness->items);
+  harness->outcaps = outcaps;
+
+  harness->element = g_object_new (GST_TYPE_VIDEO_TRANSFORM,
+      "backend", GST_VIDEO_TRANS_BACKEND_CPU, "pipeline-depth", depth,
+      "rotate", rotate, NULL);
+  gst_object_ref_sink (harness->element);
+
+  harness->srcpad = gst_pad_new ("src", GST_PAD_SRC);
+  harness->sinkpad = gst_pad_new ("sink", GST_PAD_SINK);
+
+  gst_pad_set_element_private (harness->sinkpad, harness);
+  gst_pad_set_chain_function (harness->sinkpad, test_sink_chain);
+  gst_pad_set_event_function (harness->sinkpad, test_sink_event);
+  gst_pad_set_query_function (harness->sinkpad, test_sink_query);
+
+  pad = gst_element_get_static_pad (harness->element, "sink");
+  g_assert_cmpint (gst_pad_link (harness->srcpad, pad), ==, GST_PAD_LINK_OK);
+  gst_object_unref (pad);
+
+  pad = gst_element_get_static_pad (harness->element, "src");
+  g_assert_cmpint (gst_pad_link (pad, harness->sinkpad), ==, GST_PAD_LINK_OK);
+  gst_object_unref (pad);
+
+  g_assert_true (gst_pad_set_active (harness->srcpad, TRUE));
+  g_assert_true (gst_pad_set_active (harness->sinkpad, TRUE));
+  g_assert_cmpint (gst_element_set_state (harness->element,
+      GST_STATE_PLAYING), ==, GST_STATE_CHANGE_SUCCESS);
+
+  // Input buffers on fd memory, as the converter maps them by their fd.
+  caps = gst_caps_from_string (IN_CAPS);
+  g_assert_true (gst_video_info_from_caps (&info, caps));
+
+  harness->pool =
+      gst_vtrans_buffer_pool_new (GST_VTRANS_BUFFER_POOL_TYPE_MEMFD);
+  g_assert_nonnull (harness->pool);
+
+  config = gst_buffer_pool_get_config (harness->pool);
+  gst_buffer_pool_config_set_params (config, caps, info.size, 0, 0);
+
+  allocator = gst_fd_allocator_new ();
+  gst_buffer_pool_config_set_allocator (config, allocator, NULL);
+  gst_buffer_pool_config_add_option (config, GST_BUFFER_POOL_OPTION_VIDEO_META);
+  g_object_unref (allocator);
+
+  g_assert_true (gst_buffer_pool_set_config (harness->pool, config));
+  g_assert_true (gst_buffer_pool_set_active (harness->pool, TRUE));
+
+  g_assert_true (gst_pad_push_event (harness->srcpad,
+      gst_event_new_stream_start ("videotransform-test")));
+  g_assert_true (gst_pad_push_event (harness->srcpad,
+      gst_event_new_caps (caps)));
+  gst_caps_unref (caps);
+
+  test_harness_segment (harness);
+  return harness;
+}
+
+static void
+test_harness_free (TestHarness * harness)
+{
+  g_assert_cmpint (gst_element_set_state (harness->element, GST_STATE_NULL),
+      ==, GST_STATE_CHANGE_SUCCESS);
+
+  gst_pad_set_active (harness->srcpad, FALSE);
+  gst_pad_set_active (harness->sinkpad, FALSE);
+
+  gst_object_unref (harness->element);
+  gst_object_unref (harness->srcpad);
+  gst_object_unref (harness->sinkpad);
+
+  g_queue_clear_full (&harness->items, (GDestroyNotify) gst_mini_object_unref);
+
+  gst_buffer_pool_set_active (harness->pool, FALSE);
+  gst_object_unref (harness->pool);
+
+  g_mutex_clear (&harness->lock);
+  g_free (harness);
+}
+
+static GstBuffer *
+test_harness_acquire (TestHarness * harness, guint index)
+{
+  GstBuffer *buffer = NULL;
+
+  g_assert_cmpint (gst_buffer_pool_acquire_buffer (harness->pool, &buffer,
+      NULL), ==, GST_FLOW_OK);
+
+  GST_BUFFER_PTS (buffer) = index * FRAME_DURATION;
+  GST_BUFFER_DURATION (buffer) = FRAME_DURATION;
+  return buffer;
+}
+
+static GstFlowReturn
+test_harness_push (TestHarness * harness, guint index)
+{
+  return gst_pad_push (harness->srcpad, test_harness_acquire (harness, index));
+}
+
+static void
+test_harness_flush (TestHarness * harness)
+{
+  g_assert_true (gst_pad_push_event (harness->srcpad,
+      gst_event_new_flush_start ()));
+  g_assert_true (gst_pad_push_event (harness->srcpad,
+      gst_event_new_flush_stop (TRUE)));
+
+  test_harness_segment (harness);
+}
+
+// Takes the next received item, which has to be a buffer with this index.
+static GstBuffer *
+test_harness_pop_buffer (TestHarness * harness, guint index)
+{
+  GstMiniObject *item = g_queue_pop_head (&harness->items);
+
+  g_assert_nonnull (item);
+  g_assert_true (GST_IS_BUFFER (item));
+  g_assert_cmpuint (GST_BUFFER_PTS (item), ==, index * FRAME_DURATION);
+
+  return GST_BUFFER_CAST (item);
+}
+
+static void
+test_harness_pop_event (TestHarness * harness, GstEventType type)
+{
+  GstMiniObject *item = g_queue_pop_head (&harness->items);
+
+  g_assert_nonnull (item);
+  g_assert_true (GST_IS_EVENT (item));
+  g_assert_cmpint (GST_EVENT_TYPE (item), ==, type);
+
+  gst_mini_object_unref (item);
+}
+
+// Buffers go out in input order, and EOS only after all of them.
+static void
+test_pipeline_order (void)
+{
+  TestHarness *harness = test_harness_new (PIPELINE_DEPTH,
+      GST_VIDEO_TRANS_ROTATE_NONE, OUT_CAPS);
+  GstBuffer *buffer = NULL;
+  guint idx;
+
+  for (idx = 0; idx < 4 * PIPELINE_DEPTH; idx++)
+    g_assert_cmpint (test_harness_push (harness, idx), ==, GST_FLOW_OK);
+
+  g_assert_true (gst_pad_push_event (harness->srcpad, gst_event_new_eos ()));
+
+  for (idx = 0; idx < 4 * PIPELINE_DEPTH; idx++) {
+    buffer = test_harness_pop_buffer (harness, idx);
+
+    // The input is continuous, so must be the output.
+    g_assert_false (GST_BUFFER_IS_DISCONT (buffer));
+    gst_buffer_unref (buffer);
+  }
+
+  test_harness_pop_event (harness, GST_EVENT_EOS);
+  g_assert_true (g_queue_is_empty (&harness->items));
+
+  test_harness_free (harness);
+}
+
+// Conversions in flight are finished before the flush completes, and none
+// of them is pushed after it.
+static void
+test_pipeline_flush (void)
+{
+  TestHarness *harness = test_harness_new (PIPELINE_DEPTH,
+      GST_VIDEO_TRANS_ROTATE_NONE, OUT_CAPS);
+  GstMiniObject *item = NULL;
+  guint idx;
+
+  for (idx = 0; idx < 2 * PIPELINE_DEPTH; idx++)
+    g_assert_cmpint (test_harness_push (harness, idx), ==, GST_FLOW_OK);
+
+  test_harness_flush (harness);
+
+  // Buffers pushed while flushing are dropped, the others are in order.
+  idx = 0;
+  while ((item = g_queue_pop_head (&harness->items)) != NULL &&
+      GST_IS_BUFFER (item)) {
+    g_assert_cmpuint (GST_BUFFER_PTS (item), >=, idx * FRAME_DURATION);
+    idx = GST_BUFFER_PTS (item) / FRAME_DURATION + 1;
+    gst_mini_object_unref (item);
+  }
+
+  g_assert_nonnull (item);
+  g_assert_cmpint (GST_EVENT_TYPE (item), ==, GST_EVENT_FLUSH_STOP);
+  gst_mini_object_unref (item);
+  g_assert_true (g_queue_is_empty (&harness->items));
+
+  // The flushing flow return of the dropped buffers is not reported.
+  for (idx = 0; idx < PIPELINE_DEPTH; idx++)
+    g_assert_cmpint (test_harness_push (harness, idx), ==, GST_FLOW_OK);
+
+  g_assert_true (gst_pad_push_event (harness->srcpad, gst_event_new_eos ()));
+
+  for (idx = 0; idx < PIPELINE_DEPTH; idx++)
+    gst_buffer_unref (test_harness_pop_buffer (harness, idx));
+
+  test_harness_pop_event (harness, GST_EVENT_EOS);
+  test_harness_free (harness);
+}
+
+// A downstream error is returned upstream once the buffers before it are
+// pushed, and from then on until a flush.
+static void
+test_pipeline_error (void)
+{
+  TestHarness *harness = test_harness_new (PIPELINE_DEPTH,
+      GST_VIDEO_TRANS_ROTATE_NONE, OUT_CAPS);
+  GstFlowReturn ret = GST_FLOW_OK;
+  guint idx;
+
+  harness->maxbuffers = PIPELINE_DEPTH;
+
+  for (idx = 0; idx < 4 * PIPELINE_DEPTH; idx++) {
+    ret = test_harness_push (harness, idx);
+    if (ret != GST_FLOW_OK)
+      break;
+  }
+
+  // Bounded by the number of conversions in flight.
+  g_assert_cmpint (ret, ==, GST_FLOW_ERROR);
+  g_assert_cmpuint (idx, <=, 2 * PIPELINE_DEPTH);
+  g_assert_cmpint (test_harness_push (harness, idx + 1), ==, GST_FLOW_ERROR);
+
+  for (idx = 0; idx < PIPELINE_DEPTH; idx++)
+    gst_buffer_unref (test_harness_pop_buffer (harness, idx));
+
+  // Conversions still in flight are rejected by the sink or the flush.
+  test_harness_flush (harness);
+
+  g_mutex_lock (&harness->lock);
+  harness->maxbuffers = 0;
+  g_mutex_unlock (&harness->lock);
+
+  test_harness_pop_event (harness, GST_EVENT_FLUSH_STOP);
+  g_assert_true (g_queue_is_empty (&harness->items));
+
+  g_assert_cmpint (test_harness_push (harness, 0), ==, GST_FLOW_OK);
+  g_assert_true (gst_pad_push_event (harness->srcpad, gst_event_new_eos ()));
+
+  gst_buffer_unref (test_harness_pop_buffer (harness, 0));
+  test_harness_pop_event (harness, GST_EVENT_EOS);
+
+  test_harness_free (harness);
+}
+
+// Only the first buffer after frames dropped by QoS is marked DISCONT.
+static void
+test_pipeline_discont (void)
+{
+  TestHarness *harness = test_harness_new (PIPELINE_DEPTH,
+      GST_VIDEO_TRANS_ROTATE_NONE, OUT_CAPS);
+  GstBuffer *buffer = NULL;
+  GstPad *pad = NULL;
+  guint idx;
+
+  for (idx = 0; idx < 4; idx++)
+    g_assert_cmpint (test_harness_push (harness, idx), ==, GST_FLOW_OK);
+
+  // Frames 4 and 5 are too late, their running time is not after 5.
+  pad = gst_element_get_static_pad (harness->element, "src");
+  gst_pad_send_event (pad, gst_event_new_qos (GST_QOS_TYPE_UNDERFLOW, 2.0,
+      FRAME_DURATION, 4 * FRAME_DURATION));
+  gst_object_unref (pad);
+
+  for (idx = 4; idx < 8; idx++)
+    g_assert_cmpint (test_harness_push (harness, idx), ==, GST_FLOW_OK);
+
+  g_assert_true (gst_pad_push_event (harness->srcpad, gst_event_new_eos ()));
+
+  for (idx = 0; idx < 8; idx++) {
+    if (idx == 4 || idx == 5)
+      continue;
+
+    buffer = test_harness_pop_buffer (harness, idx);
+
+    if (idx == 6)
+      g_assert_true (GST_BUFFER_IS_DISCONT (buffer));
+    else
+      g_assert_false (GST_BUFFER_IS_DISCONT (buffer));
+    gst_buffer_unref (buffer);
+  }
+
+  test_harness_pop_event (harness, GST_EVENT_EOS);
+  test_harness_free (harness);
+}
+
+// Inference results of a rotated frame are remapped to the output frame,
+// other metadata is copied as it is.
+static void
+test_meta_rotate (void)
+{
+  TestHarness *harness = test_harness_new (0, GST_VIDEO_TRANS_ROTATE_90_CW,
+      ROTATED_CAPS);
+  GstCaps *reference = gst_caps_from_string ("timestamp/x-videotransform");
+  GstReferenceTimestampMeta *tsmeta = NULL;
+  GstMLDetectionMeta *meta = NULL;
+  GstBuffer *buffer = NULL;
+  GSList *list = NULL;
+
+  // Top left quarter of the 320x240 input.
+  buffer = test_harness_acquire (harness, 0);
+  meta = gst_buffer_add_detection_meta (buffer);
+  meta->bounding_box.x = 0;
+  meta->bounding_box.y = 0;
+  meta->bounding_box.width = 80;
+  meta->bounding_box.height = 60;
+  gst_buffer_add_reference_timestamp_meta (buffer, reference, GST_SECOND,
+      GST_CLOCK_TIME_NONE);
+
+  g_assert_cmpint (gst_pad_push (harness->srcpad, buffer), ==, GST_FLOW_OK);
+  g_assert_true (gst_pad_push_event (harness->srcpad, gst_event_new_eos ()));
+
+  buffer = test_harness_pop_buffer (harness, 0);
+
+  // Top right corner of the rotated frame, scaled by half to 120x160.
+  list = gst_buffer_get_detection_meta (buffer);
+  g_assert_cmpuint (g_slist_length (list), ==, 1);
+
+  meta = (GstMLDetectionMeta *) list->data;
+  g_assert_cmpuint (meta->bounding_box.x, ==, 90);
+  g_assert_cmpuint (meta->bounding_box.y, ==, 0);
+  g_assert_cmpuint (meta->bounding_box.width, ==, 30);
+  g_assert_cmpuint (meta->bounding_box.height, ==, 40);
+  g_slist_free (list);
+
+  tsmeta = gst_buffer_get_reference_timestamp_meta (buffer, reference);
+  g_assert_nonnull (tsmeta);
+  g_assert_cmpuint (tsmeta->timestamp, ==, GST_SECOND);
+
+  gst_buffer_unref (buffer);
+  gst_caps_unref (reference);
+
+  test_harness_pop_event (harness, GST_EVENT_EOS);
+  test_harness_free (harness);
+}
+
+int
+main (int argc, char ** argv)
+{
+  gst_init (&argc, &argv);
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/videotransform/pipeline/order", test_pipeline_order);
+  g_test_add_func ("/videotransform/pipeline/flush", test_pipeline_flush);
+  g_test_add_func ("/videotransform/pipeline/error", test_pipeline_error);
+  g_test_add_func ("/videotransform/pipeline/discont", test_pipeline_discont);
+  g_test_add_func ("/videotransform/meta/rotate", test_meta_rotate);
+
+  return g_test_run ();
+}
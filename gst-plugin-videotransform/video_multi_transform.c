@@ -0,0 +1,907 @@
+/*
+* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "video_multi_transform.h"
+
+#include <ml-meta/ml_meta.h>
+
+#define GST_CAT_DEFAULT video_multi_transform_debug
+GST_DEBUG_CATEGORY_STATIC (video_multi_transform_debug);
+
+#define gst_video_multi_transform_parent_class parent_class
+G_DEFINE_TYPE (GstVideoMultiTransform, gst_video_multi_transform,
+    GST_TYPE_ELEMENT);
+G_DEFINE_TYPE (GstVideoMultiTransformPad, gst_video_multi_transform_pad,
+    GST_TYPE_PAD);
+
+#define DEFAULT_PROP_FLIP_HORIZONTAL  FALSE
+#define DEFAULT_PROP_FLIP_VERTICAL    FALSE
+#define DEFAULT_PROP_ROTATE_METHOD    GST_C2D_VIDEO_ROTATE_NONE
+#define DEFAULT_PROP_CROP_X           0
+#define DEFAULT_PROP_CROP_Y           0
+#define DEFAULT_PROP_CROP_WIDTH       0
+#define DEFAULT_PROP_CROP_HEIGHT      0
+#define DEFAULT_PROP_MIN_BUFFERS      2
+#define DEFAULT_PROP_MAX_BUFFERS      10
+
+#ifndef GST_CAPS_FEATURE_MEMORY_GBM
+#define GST_CAPS_FEATURE_MEMORY_GBM "memory:GBM"
+#endif
+
+#undef GST_VIDEO_SIZE_RANGE
+#define GST_VIDEO_SIZE_RANGE "(int) [ 1, 32767]"
+
+#define GST_VIDEO_FORMATS "{ BGRA, RGBA, BGR, RGB, NV12, NV21 }"
+
+enum
+{
+  PROP_PAD_0,
+  PROP_PAD_FLIP_HORIZONTAL,
+  PROP_PAD_FLIP_VERTICAL,
+  PROP_PAD_ROTATE_METHOD,
+  PROP_PAD_CROP_X,
+  PROP_PAD_CROP_Y,
+  PROP_PAD_CROP_WIDTH,
+  PROP_PAD_CROP_HEIGHT,
+};
+
+static GstStaticCaps gst_video_multi_transform_format_caps =
+    GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE (GST_VIDEO_FORMATS) ";"
+    GST_VIDEO_CAPS_MAKE_WITH_FEATURES ("ANY", GST_VIDEO_FORMATS));
+
+static GstCaps *
+gst_video_multi_transform_caps (void)
+{
+  static GstCaps *caps = NULL;
+  static volatile gsize inited = 0;
+  if (g_once_init_enter (&inited)) {
+    caps = gst_static_caps_get (&gst_video_multi_transform_format_caps);
+    g_once_init_leave (&inited, 1);
+  }
+  return caps;
+}
+
+static GstPadTemplate *
+gst_video_multi_transform_src_template (void)
+{
+  return gst_pad_template_new_with_gtype ("src_%u", GST_PAD_SRC,
+      GST_PAD_REQUEST, gst_video_multi_transform_caps (),
+      GST_TYPE_VIDEO_MULTI_TRANSFORM_PAD);
+}
+
+static GstPadTemplate *
+gst_video_multi_transform_sink_template (void)
+{
+  return gst_pad_template_new ("sink", GST_PAD_SINK, GST_PAD_ALWAYS,
+      gst_video_multi_transform_caps ());
+}
+
+static GstMLMetaRotate
+video_multi_transform_rotation_to_ml_meta_rotate (
+    GstC2dVideoRotateMode rotation)
+{
+  switch (rotation) {
+    case GST_C2D_VIDEO_ROTATE_90_CW:
+      return GST_ML_META_ROTATE_90_CW;
+    case GST_C2D_VIDEO_ROTATE_90_CCW:
+      return GST_ML_META_ROTATE_90_CCW;
+    case GST_C2D_VIDEO_ROTATE_180:
+      return GST_ML_META_ROTATE_180;
+    default:
+      break;
+  }
+  return GST_ML_META_ROTATE_NONE;
+}
+
+static void
+gst_video_multi_transform_pad_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstVideoMultiTransformPad *vpad = GST_VIDEO_MULTI_TRANSFORM_PAD (object);
+
+  GST_OBJECT_LOCK (vpad);
+  switch (prop_id) {
+    case PROP_PAD_FLIP_HORIZONTAL:
+      vpad->flip_h = g_value_get_boolean (value);
+      break;
+    case PROP_PAD_FLIP_VERTICAL:
+      vpad->flip_v = g_value_get_boolean (value);
+      break;
+    case PROP_PAD_ROTATE_METHOD:
+      vpad->rotation = g_value_get_enum (value);
+      break;
+    case PROP_PAD_CROP_X:
+      vpad->crop.x = g_value_get_uint (value);
+      break;
+    case PROP_PAD_CROP_Y:
+      vpad->crop.y = g_value_get_uint (value);
+      break;
+    case PROP_PAD_CROP_WIDTH:
+      vpad->crop.w = g_value_get_uint (value);
+      break;
+    case PROP_PAD_CROP_HEIGHT:
+      vpad->crop.h = g_value_get_uint (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (vpad);
+
+  // Crop and rotation change the output dimensions.
+  gst_pad_mark_reconfigure (GST_PAD (vpad));
+}
+
+static void
+gst_video_multi_transform_pad_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstVideoMultiTransformPad *vpad = GST_VIDEO_MULTI_TRANSFORM_PAD (object);
+
+  GST_OBJECT_LOCK (vpad);
+  switch (prop_id) {
+    case PROP_PAD_FLIP_HORIZONTAL:
+      g_value_set_boolean (value, vpad->flip_h);
+      break;
+    case PROP_PAD_FLIP_VERTICAL:
+      g_value_set_boolean (value, vpad->flip_v);
+      break;
+    case PROP_PAD_ROTATE_METHOD:
+      g_value_set_enum (value, vpad->rotation);
+      break;
+    case PROP_PAD_CROP_X:
+      g_value_set_uint (value, vpad->crop.x);
+      break;
+    case PROP_PAD_CROP_Y:
+      g_value_set_uint (value, vpad->crop.y);
+      break;
+    case PROP_PAD_CROP_WIDTH:
+      g_value_set_uint (value, vpad->crop.w);
+      break;
+    case PROP_PAD_CROP_HEIGHT:
+      g_value_set_uint (value, vpad->crop.h);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (vpad);
+}
+
+static void
+gst_video_multi_transform_pad_finalize (GObject * object)
+{
+  GstVideoMultiTransformPad *vpad = GST_VIDEO_MULTI_TRANSFORM_PAD (object);
+
+  // The streaming thread holds a reference while using the pool.
+  if (vpad->pool) {
+    gst_buffer_pool_set_active (vpad->pool, FALSE);
+    gst_object_unref (vpad->pool);
+  }
+
+  G_OBJECT_CLASS (gst_video_multi_transform_pad_parent_class)->finalize (
+      object);
+}
+
+static void
+gst_video_multi_transform_pad_class_init (
+    GstVideoMultiTransformPadClass * klass)
+{
+  GObjectClass *gobject = G_OBJECT_CLASS (klass);
+
+  gobject->set_property =
+      GST_DEBUG_FUNCPTR (gst_video_multi_transform_pad_set_property);
+  gobject->get_property =
+      GST_DEBUG_FUNCPTR (gst_video_multi_transform_pad_get_property);
+  gobject->finalize =
+      GST_DEBUG_FUNCPTR (gst_video_multi_transform_pad_finalize);
+
+  g_object_class_install_property (gobject, PROP_PAD_FLIP_HORIZONTAL,
+      g_param_spec_boolean ("flip-horizontal", "Flip horizontally",
+          "Flip video image horizontally", DEFAULT_PROP_FLIP_HORIZONTAL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject, PROP_PAD_FLIP_VERTICAL,
+      g_param_spec_boolean ("flip-vertical", "Flip vertically",
+          "Flip video image vertically", DEFAULT_PROP_FLIP_VERTICAL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject, PROP_PAD_ROTATE_METHOD,
+      g_param_spec_enum ("rotate", "Rotate clockwise", "Rotate video image",
+          GST_TYPE_C2D_VIDEO_ROTATE_MODE, DEFAULT_PROP_ROTATE_METHOD,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject, PROP_PAD_CROP_X,
+      g_param_spec_uint ("crop-x", "Crop X",
+          "Pixels to crop starting from X axis coordinate", 0, G_MAXUINT,
+          DEFAULT_PROP_CROP_X, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject, PROP_PAD_CROP_Y,
+      g_param_spec_uint ("crop-y", "Crop Y",
+          "Pixels to crop starting from Y axis coordinate", 0, G_MAXUINT,
+          DEFAULT_PROP_CROP_Y, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject, PROP_PAD_CROP_WIDTH,
+      g_param_spec_uint ("crop-width", "Crop Width",
+          "Width of the crop rectangle", 0, G_MAXUINT,
+          DEFAULT_PROP_CROP_WIDTH, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject, PROP_PAD_CROP_HEIGHT,
+      g_param_spec_uint ("crop-height", "Crop Height",
+          "Height of the crop rectangle", 0, G_MAXUINT,
+          DEFAULT_PROP_CROP_HEIGHT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+}
+
+static void
+gst_video_multi_transform_pad_init (GstVideoMultiTransformPad * vpad)
+{
+  vpad->flip_h = DEFAULT_PROP_FLIP_HORIZONTAL;
+  vpad->flip_v = DEFAULT_PROP_FLIP_VERTICAL;
+  vpad->rotation = DEFAULT_PROP_ROTATE_METHOD;
+  vpad->crop.x = DEFAULT_PROP_CROP_X;
+  vpad->crop.y = DEFAULT_PROP_CROP_Y;
+  vpad->crop.w = DEFAULT_PROP_CROP_WIDTH;
+  vpad->crop.h = DEFAULT_PROP_CROP_HEIGHT;
+
+  vpad->negotiated = FALSE;
+  gst_video_info_init (&vpad->info);
+  vpad->pool = NULL;
+}
+
+static gboolean
+gst_video_multi_transform_caps_has_feature (const GstCaps * caps,
+    const gchar * feature)
+{
+  guint idx = 0;
+
+  while (idx != gst_caps_get_size (caps)) {
+    GstCapsFeatures *const features = gst_caps_get_features (caps, idx);
+
+    // Skip ANY caps and return immediately if feature is present.
+    if (!gst_caps_features_is_any (features) &&
+        gst_caps_features_contains (features, feature))
+      return TRUE;
+
+    idx++;
+  }
+  return FALSE;
+}
+
+// The new pool reuses the memory of the previous one when possible.
+static GstBufferPool *
+gst_video_multi_transform_create_pool (GstVideoMultiTransform * vmtrans,
+    GstCaps * caps, GstBufferPool * previous)
+{
+  GstBufferPool *pool = NULL;
+  GstStructure *config = NULL;
+  GstAllocator *allocator = NULL;
+  GstVideoInfo info;
+
+  if (!gst_video_info_from_caps (&info, caps)) {
+    GST_ERROR_OBJECT (vmtrans, "Invalid caps %" GST_PTR_FORMAT, caps);
+    return NULL;
+  }
+
+  // If downstream supports GBM, allocate gbm memory.
+  if (gst_video_multi_transform_caps_has_feature (caps,
+          GST_CAPS_FEATURE_MEMORY_GBM)) {
+    GST_INFO_OBJECT (vmtrans, "Uses GBM memory");
+    pool = gst_vtrans_buffer_pool_new_full (GST_VTRANS_BUFFER_POOL_TYPE_GBM,
+        previous);
+  } else {
+    GST_INFO_OBJECT (vmtrans, "Uses ION memory");
+    pool = gst_vtrans_buffer_pool_new_full (GST_VTRANS_BUFFER_POOL_TYPE_ION,
+        previous);
+
+    if (NULL == pool) {
+      GST_WARNING_OBJECT (vmtrans, "ION is not available, using memfd");
+      pool = gst_vtrans_buffer_pool_new_full (
+          GST_VTRANS_BUFFER_POOL_TYPE_MEMFD, previous);
+    }
+  }
+
+  if (pool == NULL) {
+    GST_ERROR_OBJECT (vmtrans, "Failed to create buffer pool!");
+    return NULL;
+  }
+
+  config = gst_buffer_pool_get_config (pool);
+  gst_buffer_pool_config_set_params (config, caps, info.size,
+      DEFAULT_PROP_MIN_BUFFERS, DEFAULT_PROP_MAX_BUFFERS);
+
+  allocator = gst_fd_allocator_new ();
+  gst_buffer_pool_config_set_allocator (config, allocator, NULL);
+  gst_buffer_pool_config_add_option (config, GST_BUFFER_POOL_OPTION_VIDEO_META);
+
+  if (!gst_buffer_pool_set_config (pool, config)) {
+    GST_WARNING_OBJECT (vmtrans, "Failed to set pool configuration!");
+    g_object_unref (pool);
+    pool = NULL;
+  }
+  g_object_unref (allocator);
+
+  return pool;
+}
+
+// Picks the output caps of a source pad, preferring the input format and
+// the dimensions of the cropped and rotated input, and sets up its pool.
+static gboolean
+gst_video_multi_transform_negotiate_pad (GstVideoMultiTransform * vmtrans,
+    GstVideoMultiTransformPad * vpad)
+{
+  GstVideoInfo *ininfo = &vmtrans->ininfo;
+  GstCaps *tmplcaps = NULL, *caps = NULL;
+  GstBufferPool *pool = NULL;
+  GstStructure *structure = NULL;
+  GstVideoRectangle crop;
+  GstC2dVideoRotateMode rotation;
+  gint width, height;
+
+  GST_OBJECT_LOCK (vpad);
+  crop = vpad->crop;
+  rotation = vpad->rotation;
+  GST_OBJECT_UNLOCK (vpad);
+
+  width = (crop.w == 0) ? GST_VIDEO_INFO_WIDTH (ininfo) : crop.w;
+  height = (crop.h == 0) ? GST_VIDEO_INFO_HEIGHT (ininfo) : crop.h;
+
+  if (rotation == GST_C2D_VIDEO_ROTATE_90_CW ||
+      rotation == GST_C2D_VIDEO_ROTATE_90_CCW) {
+    gint tmp = width;
+    width = height;
+    height = tmp;
+  }
+
+  tmplcaps = gst_pad_get_pad_template_caps (GST_PAD (vpad));
+  caps = gst_pad_peer_query_caps (GST_PAD (vpad), tmplcaps);
+  gst_caps_unref (tmplcaps);
+
+  if (gst_caps_is_empty (caps)) {
+    GST_ERROR_OBJECT (vpad, "No caps supported downstream!");
+    gst_caps_unref (caps);
+    return FALSE;
+  }
+
+  caps = gst_caps_truncate (caps);
+  structure = gst_caps_get_structure (caps, 0);
+
+  gst_structure_fixate_field_string (structure, "format",
+      gst_video_format_to_string (GST_VIDEO_INFO_FORMAT (ininfo)));
+  gst_structure_fixate_field_nearest_int (structure, "width", width);
+  gst_structure_fixate_field_nearest_int (structure, "height", height);
+  gst_structure_fixate_field_nearest_fraction (structure, "framerate",
+      GST_VIDEO_INFO_FPS_N (ininfo), GST_VIDEO_INFO_FPS_D (ininfo));
+
+  if (gst_structure_has_field (structure, "pixel-aspect-ratio"))
+    gst_structure_fixate_field_nearest_fraction (structure,
+        "pixel-aspect-ratio", 1, 1);
+
+  caps = gst_caps_fixate (caps);
+
+  if (!gst_video_info_from_caps (&vpad->info, caps)) {
+    GST_ERROR_OBJECT (vpad, "Invalid caps %" GST_PTR_FORMAT, caps);
+    gst_caps_unref (caps);
+    return FALSE;
+  }
+
+  GST_DEBUG_OBJECT (vpad, "Negotiated caps %" GST_PTR_FORMAT, caps);
+
+  // Stored as sticky event even if the pad is not linked yet.
+  gst_pad_push_event (GST_PAD (vpad), gst_event_new_caps (caps));
+
+  pool = gst_video_multi_transform_create_pool (vmtrans, caps, vpad->pool);
+  gst_caps_unref (caps);
+
+  if (vpad->pool) {
+    gst_buffer_pool_set_active (vpad->pool, FALSE);
+    gst_object_unref (vpad->pool);
+  }
+
+  vpad->pool = pool;
+
+  if (!vpad->pool || !gst_buffer_pool_set_active (vpad->pool, TRUE)) {
+    GST_ERROR_OBJECT (vpad, "Failed to activate output video buffer pool!");
+    return FALSE;
+  }
+
+  vpad->negotiated = TRUE;
+  return TRUE;
+}
+
+static gboolean
+gst_video_multi_transform_create_converter (GstVideoMultiTransform * vmtrans,
+    guint n_outputs)
+{
+  GstStructure *options = gst_structure_new ("videomultitransform",
+      GST_C2D_VIDEO_CONVERTER_OPT_MAX_OUTPUTS, G_TYPE_INT, n_outputs,
+      NULL);
+
+  if (vmtrans->c2dconvert)
+    gst_c2d_video_converter_free (vmtrans->c2dconvert);
+
+  // Output settings are given per submission, the output info is unused.
+  vmtrans->c2dconvert = gst_c2d_video_converter_new (&vmtrans->ininfo,
+      &vmtrans->ininfo, options);
+  vmtrans->maxoutputs = (vmtrans->c2dconvert != NULL) ? n_outputs : 0;
+
+  return vmtrans->c2dconvert != NULL;
+}
+
+static GstFlowReturn
+gst_video_multi_transform_chain (GstPad * pad, GstObject * parent,
+    GstBuffer * inbuffer)
+{
+  GstVideoMultiTransform *vmtrans = GST_VIDEO_MULTI_TRANSFORM (parent);
+  GstVideoMultiTransformPad *vpad = NULL;
+  GstMLMetaTransformGeometry geometry;
+  GstC2dVideoOutput *outputs = NULL;
+  GstVideoFrame *outframes = NULL;
+  GstBuffer **outbuffers = NULL;
+  GstVideoFrame inframe;
+  GList *srcpads = NULL, *list = NULL;
+  GstFlowReturn ret = GST_FLOW_OK;
+  gpointer request_id = NULL;
+  gboolean success = FALSE;
+  guint idx, n_outputs = 0, n_mapped = 0;
+
+  if (!vmtrans->negotiated) {
+    GST_ELEMENT_ERROR (vmtrans, CORE, NEGOTIATION, (NULL),
+        ("No input caps set!"));
+    gst_buffer_unref (inbuffer);
+    return GST_FLOW_NOT_NEGOTIATED;
+  }
+
+  GST_OBJECT_LOCK (vmtrans);
+  srcpads = g_list_copy_deep (vmtrans->srcpads, (GCopyFunc) gst_object_ref,
+      NULL);
+  GST_OBJECT_UNLOCK (vmtrans);
+
+  n_outputs = g_list_length (srcpads);
+
+  if (n_outputs == 0) {
+    GST_LOG_OBJECT (vmtrans, "No source pads, dropping buffer");
+    gst_buffer_unref (inbuffer);
+    return GST_FLOW_OK;
+  }
+
+  for (list = srcpads; list != NULL; list = list->next) {
+    vpad = GST_VIDEO_MULTI_TRANSFORM_PAD (list->data);
+
+    if ((!vpad->negotiated || gst_pad_check_reconfigure (GST_PAD (vpad))) &&
+        !gst_video_multi_transform_negotiate_pad (vmtrans, vpad)) {
+      gst_pad_mark_reconfigure (GST_PAD (vpad));
+      ret = GST_FLOW_NOT_NEGOTIATED;
+      goto cleanup;
+    }
+  }
+
+  if ((vmtrans->c2dconvert == NULL || n_outputs > vmtrans->maxoutputs) &&
+      !gst_video_multi_transform_create_converter (vmtrans, n_outputs)) {
+    GST_ERROR_OBJECT (vmtrans, "Failed to create converter!");
+    ret = GST_FLOW_ERROR;
+    goto cleanup;
+  }
+
+  if (!gst_video_frame_map (&inframe, &vmtrans->ininfo, inbuffer,
+          GST_MAP_READ | GST_VIDEO_FRAME_MAP_FLAG_NO_REF)) {
+    GST_ERROR_OBJECT (vmtrans, "Failed to map input buffer!");
+    ret = GST_FLOW_ERROR;
+    goto cleanup;
+  }
+
+  outputs = g_newa (GstC2dVideoOutput, n_outputs);
+  outframes = g_newa (GstVideoFrame, n_outputs);
+  outbuffers = g_newa (GstBuffer *, n_outputs);
+
+  for (list = srcpads, idx = 0; list != NULL; list = list->next, idx++) {
+    vpad = GST_VIDEO_MULTI_TRANSFORM_PAD (list->data);
+
+    ret = gst_buffer_pool_acquire_buffer (vpad->pool, &outbuffers[idx], NULL);
+    if (ret != GST_FLOW_OK) {
+      GST_ERROR_OBJECT (vpad, "Failed to create output video buffer!");
+      goto unmap;
+    }
+
+    // Copy the flags and timestamps from the input buffer.
+    gst_buffer_copy_into (outbuffers[idx], inbuffer,
+        GST_BUFFER_COPY_FLAGS | GST_BUFFER_COPY_TIMESTAMPS, 0, -1);
+
+    GST_OBJECT_LOCK (vpad);
+    outputs[idx].srcrect = vpad->crop;
+    outputs[idx].flip_h = vpad->flip_h;
+    outputs[idx].flip_v = vpad->flip_v;
+    outputs[idx].rotate = vpad->rotation;
+    GST_OBJECT_UNLOCK (vpad);
+
+    outputs[idx].destrect.x = outputs[idx].destrect.y = 0;
+    outputs[idx].destrect.w = outputs[idx].destrect.h = 0;
+
+    // Carry over the inference results with coordinates in this output.
+    geometry.in_info = &vmtrans->ininfo;
+    geometry.out_info = &vpad->info;
+    geometry.crop = outputs[idx].srcrect;
+    geometry.flip_h = outputs[idx].flip_h;
+    geometry.flip_v = outputs[idx].flip_v;
+    geometry.rotate =
+        video_multi_transform_rotation_to_ml_meta_rotate (outputs[idx].rotate);
+
+    gst_buffer_transform_ml_meta (outbuffers[idx], inbuffer, &geometry);
+
+    if (!gst_video_frame_map (&outframes[idx], &vpad->info, outbuffers[idx],
+            GST_MAP_WRITE | GST_VIDEO_FRAME_MAP_FLAG_NO_REF)) {
+      GST_ERROR_OBJECT (vpad, "Failed to map output buffer!");
+      gst_buffer_unref (outbuffers[idx]);
+      ret = GST_FLOW_ERROR;
+      goto unmap;
+    }
+
+    outputs[idx].frame = &outframes[idx];
+    n_mapped++;
+  }
+
+  // All outputs are drawn from the same input surface in one submission.
+  request_id = gst_c2d_video_converter_submit_outputs (vmtrans->c2dconvert,
+      &inframe, outputs, n_outputs);
+  success = (request_id != NULL) &&
+      gst_c2d_video_converter_wait_request (vmtrans->c2dconvert, request_id);
+
+  if (!success) {
+    GST_ERROR_OBJECT (vmtrans, "Conversion failed!");
+    ret = GST_FLOW_ERROR;
+  }
+
+unmap:
+  gst_video_frame_unmap (&inframe);
+
+  for (idx = 0; idx < n_mapped; idx++)
+    gst_video_frame_unmap (&outframes[idx]);
+
+  if (ret != GST_FLOW_OK) {
+    for (idx = 0; idx < n_mapped; idx++)
+      gst_buffer_unref (outbuffers[idx]);
+    goto cleanup;
+  }
+
+  for (list = srcpads, idx = 0; list != NULL; list = list->next, idx++) {
+    GstFlowReturn padret = gst_pad_push (GST_PAD (list->data),
+        outbuffers[idx]);
+
+    GST_OBJECT_LOCK (vmtrans);
+    ret = gst_flow_combiner_update_pad_flow (vmtrans->combiner,
+        GST_PAD (list->data), padret);
+    GST_OBJECT_UNLOCK (vmtrans);
+  }
+
+cleanup:
+  g_list_free_full (srcpads, gst_object_unref);
+  gst_buffer_unref (inbuffer);
+
+  return ret;
+}
+
+static gboolean
+gst_video_multi_transform_sink_event (GstPad * pad, GstObject * parent,
+    GstEvent * event)
+{
+  GstVideoMultiTransform *vmtrans = GST_VIDEO_MULTI_TRANSFORM (parent);
+  GstCaps *caps = NULL;
+  GList *list = NULL;
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_CAPS:
+      gst_event_parse_caps (event, &caps);
+
+      vmtrans->negotiated =
+          gst_video_info_from_caps (&vmtrans->ininfo, caps);
+      gst_event_unref (event);
+
+      if (!vmtrans->negotiated) {
+        GST_ERROR_OBJECT (vmtrans, "Invalid caps %" GST_PTR_FORMAT, caps);
+        return FALSE;
+      }
+
+      GST_DEBUG_OBJECT (vmtrans, "Input caps %" GST_PTR_FORMAT, caps);
+
+      if (vmtrans->c2dconvert) {
+        gst_c2d_video_converter_free (vmtrans->c2dconvert);
+        vmtrans->c2dconvert = NULL;
+      }
+
+      // Output caps follow from the input, send them with the next buffer.
+      GST_OBJECT_LOCK (vmtrans);
+      for (list = vmtrans->srcpads; list != NULL; list = list->next)
+        GST_VIDEO_MULTI_TRANSFORM_PAD (list->data)->negotiated = FALSE;
+      GST_OBJECT_UNLOCK (vmtrans);
+
+      return TRUE;
+    case GST_EVENT_FLUSH_STOP:
+      GST_OBJECT_LOCK (vmtrans);
+      gst_flow_combiner_reset (vmtrans->combiner);
+      GST_OBJECT_UNLOCK (vmtrans);
+      break;
+    default:
+      break;
+  }
+
+  return gst_pad_event_default (pad, parent, event);
+}
+
+static gboolean
+gst_video_multi_transform_sink_query (GstPad * pad, GstObject * parent,
+    GstQuery * query)
+{
+  GstVideoMultiTransform *vmtrans = GST_VIDEO_MULTI_TRANSFORM (parent);
+  GstCaps *caps = NULL, *filter = NULL;
+  GstBufferPool *pool = NULL;
+  GstStructure *config = NULL;
+  gboolean needpool = FALSE;
+  guint size, minbuffers, maxbuffers;
+
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_CAPS:
+      // Any supported input can be converted into any output.
+      gst_query_parse_caps (query, &filter);
+      caps = gst_pad_get_pad_template_caps (pad);
+
+      if (filter) {
+        GstCaps *intersection = gst_caps_intersect_full (filter, caps,
+            GST_CAPS_INTERSECT_FIRST);
+        gst_caps_unref (caps);
+        caps = intersection;
+      }
+
+      gst_query_set_caps_result (query, caps);
+      gst_caps_unref (caps);
+      return TRUE;
+    case GST_QUERY_ALLOCATION:
+      gst_query_parse_allocation (query, &caps, &needpool);
+      if (!caps) {
+        GST_ERROR_OBJECT (vmtrans, "Failed to parse the allocation caps!");
+        return FALSE;
+      }
+
+      // Input buffers need to be fd backed, same as for videotransform.
+      pool = gst_video_multi_transform_create_pool (vmtrans, caps);
+      if (pool) {
+        config = gst_buffer_pool_get_config (pool);
+        gst_buffer_pool_config_get_params (config, NULL, &size, &minbuffers,
+            &maxbuffers);
+        gst_structure_free (config);
+
+        gst_query_add_allocation_pool (query, needpool ? pool : NULL, size,
+            minbuffers, 0);
+        gst_object_unref (pool);
+      }
+
+      gst_query_add_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL);
+      return TRUE;
+    default:
+      break;
+  }
+
+  return gst_pad_query_default (pad, parent, query);
+}
+
+static gboolean
+gst_video_multi_transform_src_query (GstPad * pad, GstObject * parent,
+    GstQuery * query)
+{
+  GstCaps *caps = NULL, *filter = NULL;
+
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_CAPS:
+      gst_query_parse_caps (query, &filter);
+      caps = gst_pad_get_pad_template_caps (pad);
+
+      if (filter) {
+        GstCaps *intersection = gst_caps_intersect_full (filter, caps,
+            GST_CAPS_INTERSECT_FIRST);
+        gst_caps_unref (caps);
+        caps = intersection;
+      }
+
+      gst_query_set_caps_result (query, caps);
+      gst_caps_unref (caps);
+      return TRUE;
+    default:
+      break;
+  }
+
+  return gst_pad_query_default (pad, parent, query);
+}
+
+static gboolean
+gst_video_multi_transform_copy_sticky (GstPad * pad, GstEvent ** event,
+    gpointer userdata)
+{
+  GstPad *srcpad = GST_PAD (userdata);
+
+  // Caps are negotiated separately for every source pad.
+  if (GST_EVENT_TYPE (*event) != GST_EVENT_CAPS)
+    gst_pad_store_sticky_event (srcpad, *event);
+
+  return TRUE;
+}
+
+static GstPad *
+gst_video_multi_transform_request_pad (GstElement * element,
+    GstPadTemplate * templ, const gchar * reqname, const GstCaps * caps)
+{
+  GstVideoMultiTransform *vmtrans = GST_VIDEO_MULTI_TRANSFORM (element);
+  GstPad *pad = NULL;
+  gchar *name = NULL;
+
+  GST_OBJECT_LOCK (vmtrans);
+  name = (reqname != NULL) ? g_strdup (reqname) :
+      g_strdup_printf ("src_%u", vmtrans->nextidx);
+  vmtrans->nextidx++;
+  GST_OBJECT_UNLOCK (vmtrans);
+
+  pad = g_object_new (GST_TYPE_VIDEO_MULTI_TRANSFORM_PAD, "name", name,
+      "direction", templ->direction, "template", templ, NULL);
+  g_free (name);
+
+  gst_pad_set_query_function (pad,
+      GST_DEBUG_FUNCPTR (gst_video_multi_transform_src_query));
+
+  if (!gst_element_add_pad (element, pad)) {
+    GST_ERROR_OBJECT (vmtrans, "Failed to add pad %s!", GST_PAD_NAME (pad));
+    gst_object_unref (pad);
+    return NULL;
+  }
+
+  GST_OBJECT_LOCK (vmtrans);
+  vmtrans->srcpads = g_list_append (vmtrans->srcpads, pad);
+  gst_flow_combiner_add_pad (vmtrans->combiner, pad);
+  GST_OBJECT_UNLOCK (vmtrans);
+
+  // Pads requested while streaming get the stream and segment events.
+  gst_pad_sticky_events_foreach (vmtrans->sinkpad,
+      gst_video_multi_transform_copy_sticky, pad);
+
+  GST_DEBUG_OBJECT (vmtrans, "Created pad %s", GST_PAD_NAME (pad));
+  return pad;
+}
+
+static void
+gst_video_multi_transform_release_pad (GstElement * element, GstPad * pad)
+{
+  GstVideoMultiTransform *vmtrans = GST_VIDEO_MULTI_TRANSFORM (element);
+
+  GST_DEBUG_OBJECT (vmtrans, "Releasing pad %s", GST_PAD_NAME (pad));
+
+  GST_OBJECT_LOCK (vmtrans);
+  vmtrans->srcpads = g_list_remove (vmtrans->srcpads, pad);
+  gst_flow_combiner_remove_pad (vmtrans->combiner, pad);
+  GST_OBJECT_UNLOCK (vmtrans);
+
+  gst_element_remove_pad (element, pad);
+}
+
+static GstStateChangeReturn
+gst_video_multi_transform_change_state (GstElement * element,
+    GstStateChange transition)
+{
+  GstVideoMultiTransform *vmtrans = GST_VIDEO_MULTI_TRANSFORM (element);
+  GstStateChangeReturn ret = GST_STATE_CHANGE_SUCCESS;
+  GList *list = NULL;
+
+  ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+  if (ret == GST_STATE_CHANGE_FAILURE)
+    return ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      if (vmtrans->c2dconvert) {
+        gst_c2d_video_converter_free (vmtrans->c2dconvert);
+        vmtrans->c2dconvert = NULL;
+      }
+      vmtrans->maxoutputs = 0;
+      vmtrans->negotiated = FALSE;
+
+      GST_OBJECT_LOCK (vmtrans);
+      for (list = vmtrans->srcpads; list != NULL; list = list->next)
+        GST_VIDEO_MULTI_TRANSFORM_PAD (list->data)->negotiated = FALSE;
+      gst_flow_combiner_reset (vmtrans->combiner);
+      GST_OBJECT_UNLOCK (vmtrans);
+      break;
+    default:
+      break;
+  }
+
+  return ret;
+}
+
+static void
+gst_video_multi_transform_finalize (GObject * object)
+{
+  GstVideoMultiTransform *vmtrans = GST_VIDEO_MULTI_TRANSFORM (object);
+
+  if (vmtrans->c2dconvert)
+    gst_c2d_video_converter_free (vmtrans->c2dconvert);
+
+  g_list_free (vmtrans->srcpads);
+  gst_flow_combiner_free (vmtrans->combiner);
+
+  G_OBJECT_CLASS (parent_class)->finalize (G_OBJECT (vmtrans));
+}
+
+static void
+gst_video_multi_transform_class_init (GstVideoMultiTransformClass * klass)
+{
+  GObjectClass *gobject            = G_OBJECT_CLASS (klass);
+  GstElementClass *element         = GST_ELEMENT_CLASS (klass);
+
+  gobject->finalize = GST_DEBUG_FUNCPTR (gst_video_multi_transform_finalize);
+
+  gst_element_class_set_static_metadata (element,
+      "Video multi transformer", "Filter/Effect/Converter/Video/Scaler",
+      "Resizes, colorspace converts, flips and rotates video into multiple "
+      "outputs in a single pass", "QTI");
+
+  gst_element_class_add_pad_template (element,
+      gst_video_multi_transform_sink_template ());
+  gst_element_class_add_pad_template (element,
+      gst_video_multi_transform_src_template ());
+
+  element->request_new_pad =
+      GST_DEBUG_FUNCPTR (gst_video_multi_transform_request_pad);
+  element->release_pad =
+      GST_DEBUG_FUNCPTR (gst_video_multi_transform_release_pad);
+  element->change_state =
+      GST_DEBUG_FUNCPTR (gst_video_multi_transform_change_state);
+
+  GST_DEBUG_CATEGORY_INIT (video_multi_transform_debug, "videomultitransform",
+      0, "QTI video multi transform");
+}
+
+static void
+gst_video_multi_transform_init (GstVideoMultiTransform * vmtrans)
+{
+  GstPadTemplate *templ = gst_element_class_get_pad_template (
+      GST_ELEMENT_GET_CLASS (vmtrans), "sink");
+
+  vmtrans->sinkpad = gst_pad_new_from_template (templ, "sink");
+  gst_pad_set_chain_function (vmtrans->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_video_multi_transform_chain));
+  gst_pad_set_event_function (vmtrans->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_video_multi_transform_sink_event));
+  gst_pad_set_query_function (vmtrans->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_video_multi_transform_sink_query));
+  gst_element_add_pad (GST_ELEMENT (vmtrans), vmtrans->sinkpad);
+
+  vmtrans->srcpads = NULL;
+  vmtrans->nextidx = 0;
+  vmtrans->combiner = gst_flow_combiner_new ();
+
+  vmtrans->negotiated = FALSE;
+  gst_video_info_init (&vmtrans->ininfo);
+
+  vmtrans->c2dconvert = NULL;
+  vmtrans->maxoutputs = 0;
+}
@@ -0,0 +1,117 @@
+/*
+* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __GST_QTI_VIDEO_MULTI_TRANSFORM_H__
+#define __GST_QTI_VIDEO_MULTI_TRANSFORM_H__
+
+#include <gst/gst.h>
+#include <gst/base/gstflowcombiner.h>
+#include <gst/video/video.h>
+
+#include "c2d_video_converter.h"
+#include "video_transform_buffer_pool.h"
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_VIDEO_MULTI_TRANSFORM \
+  (gst_video_multi_transform_get_type())
+#define GST_VIDEO_MULTI_TRANSFORM(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_VIDEO_MULTI_TRANSFORM, \
+      GstVideoMultiTransform))
+#define GST_VIDEO_MULTI_TRANSFORM_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_VIDEO_MULTI_TRANSFORM, \
+      GstVideoMultiTransformClass))
+#define GST_IS_VIDEO_MULTI_TRANSFORM(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_VIDEO_MULTI_TRANSFORM))
+#define GST_IS_VIDEO_MULTI_TRANSFORM_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_VIDEO_MULTI_TRANSFORM))
+#define GST_VIDEO_MULTI_TRANSFORM_CAST(obj) ((GstVideoMultiTransform *)(obj))
+
+#define GST_TYPE_VIDEO_MULTI_TRANSFORM_PAD \
+  (gst_video_multi_transform_pad_get_type())
+#define GST_VIDEO_MULTI_TRANSFORM_PAD(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_VIDEO_MULTI_TRANSFORM_PAD, \
+      GstVideoMultiTransformPad))
+#define GST_IS_VIDEO_MULTI_TRANSFORM_PAD(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_VIDEO_MULTI_TRANSFORM_PAD))
+
+typedef struct _GstVideoMultiTransform GstVideoMultiTransform;
+typedef struct _GstVideoMultiTransformClass GstVideoMultiTransformClass;
+typedef struct _GstVideoMultiTransformPad GstVideoMultiTransformPad;
+typedef struct _GstVideoMultiTransformPadClass GstVideoMultiTransformPadClass;
+
+struct _GstVideoMultiTransformPad {
+  GstPad                  parent;
+
+  /// Properties, protected by the object lock.
+  gboolean                flip_v;
+  gboolean                flip_h;
+  GstC2dVideoRotateMode   rotation;
+  GstVideoRectangle       crop;
+
+  // Negotiated output, only used from the streaming thread.
+  gboolean                negotiated;
+  GstVideoInfo            info;
+  GstBufferPool           *pool;
+};
+
+struct _GstVideoMultiTransformPadClass {
+  GstPadClass parent;
+};
+
+struct _GstVideoMultiTransform {
+  GstElement              parent;
+
+  GstPad                  *sinkpad;
+
+  // Source pads, protected by the object lock.
+  GList                   *srcpads;
+  guint                   nextidx;
+
+  GstFlowCombiner         *combiner;
+
+  // Negotiated input.
+  gboolean                negotiated;
+  GstVideoInfo            ininfo;
+
+  /// Converter drawing all outputs, recreated when the pads change.
+  GstC2dVideoConverter    *c2dconvert;
+  guint                   maxoutputs;
+};
+
+struct _GstVideoMultiTransformClass {
+  GstElementClass parent;
+};
+
+G_GNUC_INTERNAL GType gst_video_multi_transform_get_type (void);
+G_GNUC_INTERNAL GType gst_video_multi_transform_pad_get_type (void);
+
+G_END_DECLS
+
+#endif // __GST_QTI_VIDEO_MULTI_TRANSFORM_H__
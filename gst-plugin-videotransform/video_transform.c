@@ -32,10 +32,13 @@
 #endif
 
 #include "video_transform.h"
+#include "video_multi_transform.h"
 
 #include <string.h>
 #include <math.h>
 
+#include <ml-meta/ml_meta.h>
+
 #define GST_CAT_DEFAULT video_transform_debug
 GST_DEBUG_CATEGORY_STATIC (video_transform_debug);
 
@@ -43,6 +46,7 @@ GST_DEBUG_CATEGORY_STATIC (video_transform_debug);
 G_DEFINE_TYPE (GstVideoTransform, gst_video_transform, GST_TYPE_VIDEO_FILTER);
 
 #define GST_TYPE_VIDEO_TRANSFORM_ROTATE (gst_vtrans_rotate_get_type())
+#define GST_TYPE_VIDEO_TRANSFORM_BACKEND (gst_vtrans_backend_get_type())
 
 #define DEFAULT_PROP_FLIP_HORIZONTAL  FALSE
 #define DEFAULT_PROP_FLIP_VERTICAL    FALSE
@@ -53,6 +57,10 @@ G_DEFINE_TYPE (GstVideoTransform, gst_video_transform, GST_TYPE_VIDEO_FILTER);
 #define DEFAULT_PROP_CROP_HEIGHT      0
 #define DEFAULT_PROP_MIN_BUFFERS      2
 #define DEFAULT_PROP_MAX_BUFFERS      10
+#define DEFAULT_PROP_PIPELINE_DEPTH   0
+#define DEFAULT_PROP_SURFACE_CACHE    32
+#define DEFAULT_PROP_BACKEND          GST_VIDEO_TRANS_BACKEND_AUTO
+#define DEFAULT_PROP_SCALE_METHOD     GST_C2D_VIDEO_SCALE_BILINEAR
 
 #ifndef GST_CAPS_FEATURE_MEMORY_GBM
 #define GST_CAPS_FEATURE_MEMORY_GBM "memory:GBM"
@@ -75,6 +83,23 @@ enum
   PROP_CROP_Y,
   PROP_CROP_WIDTH,
   PROP_CROP_HEIGHT,
+  PROP_PIPELINE_DEPTH,
+  PROP_SURFACE_CACHE,
+  PROP_BACKEND,
+  PROP_SCALE_METHOD,
+  PROP_STATS,
+};
+
+typedef struct _GstVideoTransformRequest GstVideoTransformRequest;
+
+// Conversion in flight. The frames stay mapped until it finishes. Buffers
+// referencing their input are queued without ID to keep them in order.
+struct _GstVideoTransformRequest
+{
+  gpointer     id;
+  GstVideoFrame inframe;
+  GstVideoFrame outframe;
+  GstBuffer    *outbuffer;
 };
 
 static GstStaticCaps gst_video_transform_format_caps =
@@ -99,6 +124,24 @@ gst_vtrans_rotate_get_type (void)
   return video_rotation_type;
 }
 
+static GType
+gst_vtrans_backend_get_type (void)
+{
+  static GType video_backend_type = 0;
+  static const GEnumValue methods[] = {
+    {GST_VIDEO_TRANS_BACKEND_AUTO,
+        "C2D if the library is available, CPU otherwise", "auto"},
+    {GST_VIDEO_TRANS_BACKEND_C2D, "C2D on the GPU", "c2d"},
+    {GST_VIDEO_TRANS_BACKEND_CPU, "SIMD kernels on the CPU", "cpu"},
+    {0, NULL, NULL},
+  };
+  if (!video_backend_type) {
+    video_backend_type =
+        g_enum_register_static ("GstVideoTransformBackend", methods);
+  }
+  return video_backend_type;
+}
+
 static GstCaps *
 gst_video_transform_caps (void)
 {
@@ -143,11 +186,140 @@ video_transform_rotation_to_c2d_rotate_mode (GstVideoTransformRotate rotation)
   return GST_C2D_VIDEO_ROTATE_NONE;
 }
 
+static const gchar *
+video_transform_backend_to_driver (GstVideoTransformBackend backend)
+{
+  switch (backend) {
+    case GST_VIDEO_TRANS_BACKEND_C2D:
+      return "c2d";
+    case GST_VIDEO_TRANS_BACKEND_CPU:
+      return "cpu";
+    case GST_VIDEO_TRANS_BACKEND_AUTO:
+      return "auto";
+    default:
+      GST_WARNING ("Invalid backend %d!", backend);
+  }
+  return "auto";
+}
+
+static GstMLMetaRotate
+video_transform_rotation_to_ml_meta_rotate (GstVideoTransformRotate rotation)
+{
+  switch (rotation) {
+    case GST_VIDEO_TRANS_ROTATE_90_CW:
+      return GST_ML_META_ROTATE_90_CW;
+    case GST_VIDEO_TRANS_ROTATE_90_CCW:
+      return GST_ML_META_ROTATE_90_CCW;
+    case GST_VIDEO_TRANS_ROTATE_180:
+      return GST_ML_META_ROTATE_180;
+    default:
+      break;
+  }
+  return GST_ML_META_ROTATE_NONE;
+}
+
+// Pushes the output buffers in submission order as their conversions
+// finish. Requests still in flight are finished before the thread exits.
+static gpointer
+gst_video_transform_worker (gpointer userdata)
+{
+  GstVideoTransform *vtrans = GST_VIDEO_TRANSFORM (userdata);
+  GstPad *srcpad = GST_BASE_TRANSFORM_SRC_PAD (vtrans);
+  GstVideoTransformRequest *request = NULL;
+  GstFlowReturn ret = GST_FLOW_OK;
+  gboolean success = FALSE;
+
+  g_mutex_lock (&vtrans->lock);
+
+  while (TRUE) {
+    while (!vtrans->stopping && g_queue_is_empty (vtrans->requests))
+      g_cond_wait (&vtrans->wakeup, &vtrans->lock);
+
+    if (g_queue_is_empty (vtrans->requests))
+      break;
+
+    // Leave the request queued, it is in flight until pushed.
+    request = g_queue_peek_head (vtrans->requests);
+    g_mutex_unlock (&vtrans->lock);
+
+    if (request->id != NULL) {
+      success = gst_c2d_video_converter_wait_request (vtrans->c2dconvert,
+          request->id);
+
+      gst_video_frame_unmap (&request->outframe);
+      gst_video_frame_unmap (&request->inframe);
+    } else {
+      success = TRUE;
+    }
+
+    if (success) {
+      ret = gst_pad_push (srcpad, request->outbuffer);
+    } else {
+      // Upstream only sees the error with the next buffer, if there is any,
+      // so post it here.
+      GST_ELEMENT_ERROR (vtrans, STREAM, FAILED, (NULL),
+          ("Conversion failed!"));
+      gst_buffer_unref (request->outbuffer);
+      ret = GST_FLOW_ERROR;
+    }
+
+    g_slice_free (GstVideoTransformRequest, request);
+
+    g_mutex_lock (&vtrans->lock);
+    g_queue_pop_head (vtrans->requests);
+
+    // The output of a failed conversion is dropped.
+    if (!success)
+      vtrans->discont = TRUE;
+
+    if (ret != GST_FLOW_OK && vtrans->flowret == GST_FLOW_OK) {
+      GST_DEBUG_OBJECT (vtrans, "Push returned %s", gst_flow_get_name (ret));
+      vtrans->flowret = ret;
+    }
+    g_cond_broadcast (&vtrans->wakeup);
+  }
+
+  g_mutex_unlock (&vtrans->lock);
+  return NULL;
+}
+
+// Waits until all submitted conversions are finished and pushed.
+static void
+gst_video_transform_drain (GstVideoTransform * vtrans)
+{
+  g_mutex_lock (&vtrans->lock);
+
+  while (!g_queue_is_empty (vtrans->requests))
+    g_cond_wait (&vtrans->wakeup, &vtrans->lock);
+
+  g_mutex_unlock (&vtrans->lock);
+}
+
+static void
+gst_video_transform_stop_worker (GstVideoTransform * vtrans)
+{
+  if (!vtrans->worker)
+    return;
+
+  g_mutex_lock (&vtrans->lock);
+  vtrans->stopping = TRUE;
+  g_cond_broadcast (&vtrans->wakeup);
+  g_mutex_unlock (&vtrans->lock);
+
+  g_thread_join (vtrans->worker);
+  vtrans->worker = NULL;
+}
+
 static void
 gst_video_transform_finalize (GObject * object)
 {
   GstVideoTransform *vtrans = GST_VIDEO_TRANSFORM (object);
 
+  gst_video_transform_stop_worker (vtrans);
+  g_queue_free (vtrans->requests);
+  g_mutex_clear (&vtrans->lock);
+  g_cond_clear (&vtrans->wakeup);
+
   if (vtrans->c2dconvert)
     gst_c2d_video_converter_free (vtrans->c2dconvert);
 
@@ -202,6 +374,26 @@ gst_video_transform_set_property (GObject * object, guint prop_id,
       vtrans->crop.h = g_value_get_uint (value);
       GST_OBJECT_UNLOCK (vtrans);
       break;
+    case PROP_PIPELINE_DEPTH:
+      GST_OBJECT_LOCK (vtrans);
+      vtrans->depth = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (vtrans);
+      break;
+    case PROP_SURFACE_CACHE:
+      GST_OBJECT_LOCK (vtrans);
+      vtrans->cachesize = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (vtrans);
+      break;
+    case PROP_BACKEND:
+      GST_OBJECT_LOCK (vtrans);
+      vtrans->backend = g_value_get_enum (value);
+      GST_OBJECT_UNLOCK (vtrans);
+      break;
+    case PROP_SCALE_METHOD:
+      GST_OBJECT_LOCK (vtrans);
+      vtrans->scaling = g_value_get_enum (value);
+      GST_OBJECT_UNLOCK (vtrans);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -250,6 +442,59 @@ gst_video_transform_get_property (GObject * object, guint prop_id, GValue * valu
       g_value_set_uint (value, vtrans->crop.h);
       GST_OBJECT_UNLOCK (vtrans);
       break;
+    case PROP_PIPELINE_DEPTH:
+      GST_OBJECT_LOCK (vtrans);
+      g_value_set_uint (value, vtrans->depth);
+      GST_OBJECT_UNLOCK (vtrans);
+      break;
+    case PROP_SURFACE_CACHE:
+      GST_OBJECT_LOCK (vtrans);
+      g_value_set_uint (value, vtrans->cachesize);
+      GST_OBJECT_UNLOCK (vtrans);
+      break;
+    case PROP_BACKEND:
+      GST_OBJECT_LOCK (vtrans);
+      g_value_set_enum (value, vtrans->backend);
+      GST_OBJECT_UNLOCK (vtrans);
+      break;
+    case PROP_SCALE_METHOD:
+      GST_OBJECT_LOCK (vtrans);
+      g_value_set_enum (value, vtrans->scaling);
+      GST_OBJECT_UNLOCK (vtrans);
+      break;
+    case PROP_STATS:
+    {
+      GstStructure *stats = gst_structure_new_empty ("videotransform");
+      GstStructure *structure = NULL;
+
+      GST_OBJECT_LOCK (vtrans);
+
+      gst_structure_set (stats,
+          "passthrough-buffers", G_TYPE_UINT64, vtrans->npassthrough,
+          "crop-meta-buffers", G_TYPE_UINT64, vtrans->ncropmeta,
+          "video-meta-buffers", G_TYPE_UINT64, vtrans->nvideometa,
+          "converted-buffers", G_TYPE_UINT64, vtrans->nconverted,
+          NULL);
+
+      if (vtrans->c2dconvert != NULL) {
+        structure = gst_c2d_video_converter_get_stats (vtrans->c2dconvert);
+        gst_structure_set (stats, "surface-cache", GST_TYPE_STRUCTURE,
+            structure, NULL);
+        gst_structure_free (structure);
+      }
+
+      if (vtrans->outpool != NULL) {
+        structure = gst_vtrans_buffer_pool_get_stats (vtrans->outpool);
+        gst_structure_set (stats, "output-pool", GST_TYPE_STRUCTURE,
+            structure, NULL);
+        gst_structure_free (structure);
+      }
+
+      GST_OBJECT_UNLOCK (vtrans);
+
+      g_value_take_boxed (value, stats);
+      break;
+    }
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -275,8 +520,10 @@ gst_video_transform_caps_has_feature (const GstCaps * caps,
   return FALSE;
 }
 
+// The new pool reuses the memory of the previous one when possible.
 static GstBufferPool *
-gst_video_transform_create_pool (GstVideoTransform * vtrans, GstCaps * caps)
+gst_video_transform_create_pool (GstVideoTransform * vtrans, GstCaps * caps,
+    GstBufferPool * previous)
 {
   GstBufferPool *pool = NULL;
   GstStructure *config = NULL;
@@ -291,10 +538,25 @@ gst_video_transform_create_pool (GstVideoTransform * vtrans, GstCaps * caps)
   // If downstream allocation query supports GBM, allocate gbm memory.
   if (gst_video_transform_caps_has_feature (caps, GST_CAPS_FEATURE_MEMORY_GBM)) {
     GST_INFO_OBJECT (vtrans, "Video transform uses GBM memory");
-    pool = gst_vtrans_buffer_pool_new (GST_VTRANS_BUFFER_POOL_TYPE_GBM);
+    pool = gst_vtrans_buffer_pool_new_full (GST_VTRANS_BUFFER_POOL_TYPE_GBM,
+        previous);
   } else {
     GST_INFO_OBJECT (vtrans, "Video transform uses ION memory");
-    pool = gst_vtrans_buffer_pool_new (GST_VTRANS_BUFFER_POOL_TYPE_ION);
+    pool = gst_vtrans_buffer_pool_new_full (GST_VTRANS_BUFFER_POOL_TYPE_ION,
+        previous);
+  }
+
+  // Hosts without ION, e.g. when converting on the CPU.
+  if (NULL == pool && !gst_video_transform_caps_has_feature (caps,
+          GST_CAPS_FEATURE_MEMORY_GBM)) {
+    GST_WARNING_OBJECT (vtrans, "ION is not available, using memfd memory");
+    pool = gst_vtrans_buffer_pool_new_full (GST_VTRANS_BUFFER_POOL_TYPE_MEMFD,
+        previous);
+  }
+
+  if (NULL == pool) {
+    GST_ERROR_OBJECT (vtrans, "Failed to create buffer pool!");
+    return NULL;
   }
 
   config = gst_buffer_pool_get_config (pool);
@@ -346,20 +608,27 @@ gst_video_transform_propose_allocation (GstBaseTransform * trans,
     // Update the internal pool if any allocation attribute changed.
     if (vtrans->inpool && !gst_video_info_is_equal (
         gst_vtrans_buffer_pool_get_info (vtrans->inpool), &info)) {
+      pool = gst_video_transform_create_pool (vtrans, caps, vtrans->inpool);
       gst_object_unref (vtrans->inpool);
-      vtrans->inpool = gst_video_transform_create_pool (vtrans, caps);
+      vtrans->inpool = pool;
     } else {
       // Create buffer pool for input.
-      vtrans->inpool = gst_video_transform_create_pool (vtrans, caps);
+      vtrans->inpool = gst_video_transform_create_pool (vtrans, caps, NULL);
     }
 
+    if (NULL == vtrans->inpool)
+      return FALSE;
+
     // Get the size and allocator params from pool and set it in query.
     if (needpool) {
-      pool = gst_video_transform_create_pool (vtrans, caps);
+      pool = gst_video_transform_create_pool (vtrans, caps, vtrans->inpool);
     } else {
       pool = gst_object_ref (vtrans->inpool);
     }
 
+    if (NULL == pool)
+      return FALSE;
+
     config = gst_buffer_pool_get_config (pool);
     gst_buffer_pool_config_get_params (config, NULL, &size, &minbuffers,
         &maxbuffers);
@@ -401,13 +670,26 @@ gst_video_transform_decide_allocation (GstBaseTransform * trans,
     return FALSE;
   }
 
-  // Invalidate the cached pool if there is an allocation_query.
+  // A crop may reference the input when downstream reads these metas.
+  vtrans->videometa =
+      gst_query_find_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL);
+  vtrans->cropmeta = vtrans->videometa && gst_query_find_allocation_meta (
+      query, GST_VIDEO_CROP_META_API_TYPE, NULL);
+
+  GST_DEBUG_OBJECT (vtrans, "Downstream supports video meta: %d, crop "
+      "meta: %d", vtrans->videometa, vtrans->cropmeta);
+
+  // Replace the cached pool, keeping its memory for the new buffers.
+  pool = gst_video_transform_create_pool (vtrans, caps, vtrans->outpool);
+  if (NULL == pool)
+    return FALSE;
+
+  // Swapped under the object lock, the statistics are read from it.
+  GST_OBJECT_LOCK (vtrans);
   if (vtrans->outpool)
     gst_object_unref (vtrans->outpool);
-
-  // Create a new buffer pool.
-  pool = gst_video_transform_create_pool (vtrans, caps);
   vtrans->outpool = pool;
+  GST_OBJECT_UNLOCK (vtrans);
 
   // Get the configured pool properties in order to set in query.
   config = gst_buffer_pool_get_config (pool);
@@ -432,44 +714,331 @@ gst_video_transform_decide_allocation (GstBaseTransform * trans,
   return TRUE;
 }
 
+// Wraps the input memory in a buffer describing the cropped region, either
+// with a crop meta or with a video meta starting at its top left corner.
+static GstBuffer *
+gst_video_transform_reference_region (GstVideoTransform * vtrans,
+    GstBuffer * inbuffer)
+{
+  GstVideoInfo *info = &GST_VIDEO_FILTER_CAST (vtrans)->in_info;
+  const GstVideoFormatInfo *finfo = info->finfo;
+  GstVideoRectangle *region = &vtrans->region;
+  GstVideoMeta *vmeta = gst_buffer_get_video_meta (inbuffer);
+  GstVideoCropMeta *cmeta = NULL;
+  GstBuffer *buffer = NULL;
+  gsize offsets[GST_VIDEO_MAX_PLANES] = { 0, };
+  gint strides[GST_VIDEO_MAX_PLANES] = { 0, };
+  guint idx, plane;
+  gint x, y;
+
+  // Layout of the input frame, its video meta takes precedence.
+  for (idx = 0; idx < GST_VIDEO_INFO_N_PLANES (info); idx++) {
+    offsets[idx] = (vmeta != NULL) ? vmeta->offset[idx] :
+        GST_VIDEO_INFO_PLANE_OFFSET (info, idx);
+    strides[idx] = (vmeta != NULL) ? vmeta->stride[idx] :
+        GST_VIDEO_INFO_PLANE_STRIDE (info, idx);
+  }
+
+  // Shares the memory, which is no longer writable by either buffer.
+  buffer = gst_buffer_copy_region (inbuffer, GST_BUFFER_COPY_MEMORY, 0, -1);
+
+  if (vtrans->cropmeta) {
+    gst_buffer_add_video_meta_full (buffer, GST_VIDEO_FRAME_FLAG_NONE,
+        GST_VIDEO_INFO_FORMAT (info), GST_VIDEO_INFO_WIDTH (info),
+        GST_VIDEO_INFO_HEIGHT (info), GST_VIDEO_INFO_N_PLANES (info),
+        offsets, strides);
+
+    cmeta = gst_buffer_add_video_crop_meta (buffer);
+    cmeta->x = region->x;
+    cmeta->y = region->y;
+    cmeta->width = region->w;
+    cmeta->height = region->h;
+
+    GST_OBJECT_LOCK (vtrans);
+    vtrans->ncropmeta++;
+    GST_OBJECT_UNLOCK (vtrans);
+    return buffer;
+  }
+
+  // Components sharing a plane are subsampled alike, any of them will do.
+  for (idx = 0; idx < GST_VIDEO_FORMAT_INFO_N_COMPONENTS (finfo); idx++) {
+    plane = GST_VIDEO_FORMAT_INFO_PLANE (finfo, idx);
+
+    x = GST_VIDEO_FORMAT_INFO_SCALE_WIDTH (finfo, idx, region->x);
+    y = GST_VIDEO_FORMAT_INFO_SCALE_HEIGHT (finfo, idx, region->y);
+
+    offsets[plane] = ((vmeta != NULL) ? vmeta->offset[plane] :
+        GST_VIDEO_INFO_PLANE_OFFSET (info, plane)) + y * strides[plane] +
+        x * GST_VIDEO_FORMAT_INFO_PSTRIDE (finfo, idx);
+  }
+
+  gst_buffer_add_video_meta_full (buffer, GST_VIDEO_FRAME_FLAG_NONE,
+      GST_VIDEO_INFO_FORMAT (info), region->w, region->h,
+      GST_VIDEO_INFO_N_PLANES (info), offsets, strides);
+
+  GST_OBJECT_LOCK (vtrans);
+  vtrans->nvideometa++;
+  GST_OBJECT_UNLOCK (vtrans);
+  return buffer;
+}
+
+// Whether the output buffer references the input memory.
+static gboolean
+gst_video_transform_is_reference (GstBuffer * inbuffer, GstBuffer * outbuffer)
+{
+  return gst_buffer_n_memory (outbuffer) > 0 &&
+      gst_buffer_peek_memory (outbuffer, 0) ==
+      gst_buffer_peek_memory (inbuffer, 0);
+}
+
 static GstFlowReturn
 gst_video_transform_prepare_output_buffer (GstBaseTransform * trans,
     GstBuffer * inbuffer, GstBuffer ** outbuffer)
 {
   GstVideoTransform *vtrans = GST_VIDEO_TRANSFORM_CAST (trans);
+  GstVideoFilter *filter = GST_VIDEO_FILTER_CAST (trans);
   GstBufferPool *pool = vtrans->outpool;
+  GstMLMetaTransformGeometry geometry;
   GstFlowReturn ret = GST_FLOW_OK;
 
   if (gst_base_transform_is_passthrough (trans)) {
     GST_DEBUG_OBJECT (vtrans, "Passthrough, no need to do anything");
     *outbuffer = inbuffer;
+
+    GST_OBJECT_LOCK (vtrans);
+    vtrans->npassthrough++;
+    GST_OBJECT_UNLOCK (vtrans);
     return GST_FLOW_OK;
   }
 
-  if (!vtrans->c2dconvert) {
-    GST_WARNING_OBJECT (vtrans, "Converter not created!");
-    return GST_FLOW_NOT_NEGOTIATED;
+  if (vtrans->croponly && (vtrans->cropmeta || vtrans->videometa)) {
+    GST_LOG_OBJECT (vtrans, "Referencing the cropped input");
+    *outbuffer = gst_video_transform_reference_region (vtrans, inbuffer);
+  } else {
+    if (!vtrans->c2dconvert) {
+      GST_WARNING_OBJECT (vtrans, "Converter not created!");
+      return GST_FLOW_NOT_NEGOTIATED;
+    }
+
+    g_return_val_if_fail (pool != NULL, GST_FLOW_ERROR);
+
+    if (!gst_buffer_pool_is_active (pool) &&
+        !gst_buffer_pool_set_active (pool, TRUE)) {
+      GST_ERROR_OBJECT (vtrans, "Failed to activate output video buffer "
+          "pool!");
+      return GST_FLOW_ERROR;
+    }
+
+    ret = gst_buffer_pool_acquire_buffer (pool, outbuffer, NULL);
+    if (ret != GST_FLOW_OK) {
+      GST_ERROR_OBJECT (vtrans, "Failed to create output video buffer!");
+      return GST_FLOW_ERROR;
+    }
+
+    GST_OBJECT_LOCK (vtrans);
+    vtrans->nconverted++;
+    GST_OBJECT_UNLOCK (vtrans);
+  }
+
+  // Copy the flags, timestamps and the metadata accepted by transform_meta,
+  // the base class only does it for output buffers it prepares itself.
+  if (!GST_BASE_TRANSFORM_GET_CLASS (trans)->copy_metadata (trans, inbuffer,
+          *outbuffer))
+    GST_WARNING_OBJECT (vtrans, "Failed to copy metadata!");
+
+  // Carry over the inference results with coordinates in the output frame.
+  geometry.in_info = &filter->in_info;
+  geometry.out_info = &filter->out_info;
+  geometry.crop = vtrans->crop;
+  geometry.flip_h = vtrans->flip_h;
+  geometry.flip_v = vtrans->flip_v;
+  geometry.rotate =
+      video_transform_rotation_to_ml_meta_rotate (vtrans->rotation);
+
+  gst_buffer_transform_ml_meta (*outbuffer, inbuffer, &geometry);
+
+  return GST_FLOW_OK;
+}
+
+static gboolean
+gst_video_transform_start (GstBaseTransform * trans)
+{
+  GstVideoTransform *vtrans = GST_VIDEO_TRANSFORM_CAST (trans);
+  GError *error = NULL;
+  guint depth;
+
+  GST_OBJECT_LOCK (vtrans);
+  depth = vtrans->depth;
+  GST_OBJECT_UNLOCK (vtrans);
+
+  vtrans->stopping = FALSE;
+  vtrans->flowret = GST_FLOW_OK;
+  vtrans->discont = FALSE;
+
+  if (depth == 0)
+    return TRUE;
+
+  vtrans->worker = g_thread_try_new ("videotransform-worker",
+      gst_video_transform_worker, vtrans, &error);
+  if (!vtrans->worker) {
+    GST_ERROR_OBJECT (vtrans, "Failed to create worker thread: %s",
+        error->message);
+    g_error_free (error);
+    return FALSE;
+  }
+
+  GST_DEBUG_OBJECT (vtrans, "Up to %u conversions in flight", depth);
+  return TRUE;
+}
+
+static gboolean
+gst_video_transform_stop (GstBaseTransform * trans)
+{
+  GstVideoTransform *vtrans = GST_VIDEO_TRANSFORM_CAST (trans);
+
+  gst_video_transform_stop_worker (vtrans);
+  return TRUE;
+}
+
+static gboolean
+gst_video_transform_sink_event (GstBaseTransform * trans, GstEvent * event)
+{
+  GstVideoTransform *vtrans = GST_VIDEO_TRANSFORM_CAST (trans);
+
+  // Buffers in flight go out before any serialized event following them.
+  if (GST_EVENT_IS_SERIALIZED (event))
+    gst_video_transform_drain (vtrans);
+
+  if (GST_EVENT_TYPE (event) == GST_EVENT_FLUSH_STOP) {
+    g_mutex_lock (&vtrans->lock);
+    vtrans->flowret = GST_FLOW_OK;
+    vtrans->discont = FALSE;
+    g_mutex_unlock (&vtrans->lock);
+  }
+
+  return GST_BASE_TRANSFORM_CLASS (parent_class)->sink_event (trans, event);
+}
+
+static GstFlowReturn
+gst_video_transform_submit_input_buffer (GstBaseTransform * trans,
+    gboolean discont, GstBuffer * inbuffer)
+{
+  GstVideoTransform *vtrans = GST_VIDEO_TRANSFORM_CAST (trans);
+  GstFlowReturn ret = GST_FLOW_OK;
+
+  ret = GST_BASE_TRANSFORM_CLASS (parent_class)->submit_input_buffer (trans,
+      discont, inbuffer);
+
+  // Late buffers dropped by QoS never reach transform(), the next buffer
+  // the worker pushes starts a discontinuity.
+  if (ret == GST_BASE_TRANSFORM_FLOW_DROPPED && vtrans->worker) {
+    g_mutex_lock (&vtrans->lock);
+    vtrans->discont = TRUE;
+    g_mutex_unlock (&vtrans->lock);
   }
 
-  g_return_val_if_fail (pool != NULL, GST_FLOW_ERROR);
+  return ret;
+}
+
+static GstFlowReturn
+gst_video_transform_transform (GstBaseTransform * trans, GstBuffer * inbuffer,
+    GstBuffer * outbuffer)
+{
+  GstVideoTransform *vtrans = GST_VIDEO_TRANSFORM_CAST (trans);
+  GstVideoFilter *filter = GST_VIDEO_FILTER_CAST (trans);
+  GstVideoTransformRequest *request = NULL;
+  GstFlowReturn ret = GST_FLOW_OK;
+  gboolean reference = gst_video_transform_is_reference (inbuffer, outbuffer);
+  guint depth;
+
+  // Synchronous conversion through transform_frame, if there is anything
+  // to convert.
+  if (!vtrans->worker) {
+    if (reference)
+      return GST_FLOW_OK;
 
-  if (!gst_buffer_pool_is_active (pool) &&
-      !gst_buffer_pool_set_active (pool, TRUE)) {
-    GST_ERROR_OBJECT (vtrans, "Failed to activate output video buffer pool!");
+    return GST_BASE_TRANSFORM_CLASS (parent_class)->transform (trans,
+        inbuffer, outbuffer);
+  }
+
+  GST_OBJECT_LOCK (vtrans);
+  depth = MAX (vtrans->depth, 1);
+  GST_OBJECT_UNLOCK (vtrans);
+
+  g_mutex_lock (&vtrans->lock);
+
+  while (vtrans->flowret == GST_FLOW_OK &&
+      g_queue_get_length (vtrans->requests) >= depth)
+    g_cond_wait (&vtrans->wakeup, &vtrans->lock);
+
+  ret = vtrans->flowret;
+  g_mutex_unlock (&vtrans->lock);
+
+  if (ret != GST_FLOW_OK)
+    return ret;
+
+  request = g_slice_new0 (GstVideoTransformRequest);
+
+  // Nothing to convert, but earlier conversions must be pushed first.
+  if (reference)
+    goto queue;
+
+  // The frames keep a reference to their buffers while mapped.
+  if (!gst_video_frame_map (&request->inframe, &filter->in_info, inbuffer,
+          GST_MAP_READ)) {
+    GST_ERROR_OBJECT (vtrans, "Failed to map input buffer!");
+    g_slice_free (GstVideoTransformRequest, request);
     return GST_FLOW_ERROR;
   }
 
-  ret = gst_buffer_pool_acquire_buffer (pool, outbuffer, NULL);
-  if (ret != GST_FLOW_OK) {
-    GST_ERROR_OBJECT (vtrans, "Failed to create output video buffer!");
+  if (!gst_video_frame_map (&request->outframe, &filter->out_info, outbuffer,
+          GST_MAP_WRITE)) {
+    GST_ERROR_OBJECT (vtrans, "Failed to map output buffer!");
+    gst_video_frame_unmap (&request->inframe);
+    g_slice_free (GstVideoTransformRequest, request);
     return GST_FLOW_ERROR;
   }
 
-  // Copy the flags and timestamps from the input buffer.
-  gst_buffer_copy_into (*outbuffer, inbuffer,
-      GST_BUFFER_COPY_FLAGS | GST_BUFFER_COPY_TIMESTAMPS, 0, -1);
+  request->id = gst_c2d_video_converter_submit_frame (vtrans->c2dconvert,
+      &request->inframe, &request->outframe);
+  if (!request->id) {
+    GST_ERROR_OBJECT (vtrans, "Failed to submit conversion!");
+    gst_video_frame_unmap (&request->outframe);
+    gst_video_frame_unmap (&request->inframe);
+    g_slice_free (GstVideoTransformRequest, request);
+    return GST_FLOW_ERROR;
+  }
 
-  return GST_FLOW_OK;
+queue:
+  g_mutex_lock (&vtrans->lock);
+
+  // Every buffer returned as dropped makes the base class mark the next
+  // one it pushes, but only the first buffer after frames that were really
+  // dropped starts a discontinuity.
+  if (vtrans->discont)
+    GST_BUFFER_FLAG_SET (outbuffer, GST_BUFFER_FLAG_DISCONT);
+  vtrans->discont = FALSE;
+
+  request->outbuffer = gst_buffer_ref (outbuffer);
+  g_queue_push_tail (vtrans->requests, request);
+  g_cond_broadcast (&vtrans->wakeup);
+  g_mutex_unlock (&vtrans->lock);
+
+  // The worker pushes the buffer once the conversion finished.
+  return GST_BASE_TRANSFORM_FLOW_DROPPED;
+}
+
+static gboolean
+gst_video_transform_transform_meta (GstBaseTransform * trans,
+    GstBuffer * outbuffer, GstMeta * meta, GstBuffer * inbuffer)
+{
+  // ML metadata is remapped in prepare_output_buffer, a plain copy here
+  // would duplicate it with input frame coordinates.
+  if (gst_ml_meta_is_ml (meta))
+    return FALSE;
+
+  return GST_BASE_TRANSFORM_CLASS (parent_class)->transform_meta (trans,
+      outbuffer, meta, inbuffer);
 }
 
 static GstCaps *
@@ -529,6 +1098,34 @@ gst_video_transform_transform_caps (GstBaseTransform * trans,
   return result;
 }
 
+// Whether the output is the input region unchanged, aligned to the chroma
+// subsampling, so that it can be referenced instead of copied.
+static gboolean
+gst_video_transform_is_crop_only (GstVideoTransform * vtrans,
+    const GstVideoInfo * ininfo, const GstVideoInfo * outinfo)
+{
+  const GstVideoFormatInfo *finfo = ininfo->finfo;
+  GstVideoRectangle *region = &vtrans->region;
+  guint idx;
+
+  if (GST_VIDEO_INFO_FORMAT (ininfo) != GST_VIDEO_INFO_FORMAT (outinfo) ||
+      vtrans->flip_h || vtrans->flip_v ||
+      vtrans->rotation != GST_VIDEO_TRANS_ROTATE_NONE)
+    return FALSE;
+
+  if (region->w != GST_VIDEO_INFO_WIDTH (outinfo) ||
+      region->h != GST_VIDEO_INFO_HEIGHT (outinfo))
+    return FALSE;
+
+  for (idx = 0; idx < GST_VIDEO_FORMAT_INFO_N_COMPONENTS (finfo); idx++) {
+    if ((region->x % (1 << GST_VIDEO_FORMAT_INFO_W_SUB (finfo, idx))) != 0 ||
+        (region->y % (1 << GST_VIDEO_FORMAT_INFO_H_SUB (finfo, idx))) != 0)
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
 static gboolean
 gst_video_transform_set_info (GstVideoFilter * filter, GstCaps * in,
     GstVideoInfo * ininfo, GstCaps * out, GstVideoInfo * outinfo)
@@ -536,6 +1133,9 @@ gst_video_transform_set_info (GstVideoFilter * filter, GstCaps * in,
   GstVideoTransform *vtrans = GST_VIDEO_TRANSFORM (filter);
   gint from_dar_n, from_dar_d, to_dar_n, to_dar_d;
 
+  // Conversions in flight use the current converter.
+  gst_video_transform_drain (vtrans);
+
   if (!gst_util_fraction_multiply (ininfo->width, ininfo->height,
           ininfo->par_n, ininfo->par_d, &from_dar_n, &from_dar_d)) {
     GST_WARNING_OBJECT (vtrans, "Failed to calculate input DAR!");
@@ -548,10 +1148,22 @@ gst_video_transform_set_info (GstVideoFilter * filter, GstCaps * in,
     to_dar_n = to_dar_d = -1;
   }
 
-  if (ininfo->width == outinfo->width && ininfo->height == outinfo->height
-      && ininfo->finfo->format == outinfo->finfo->format && !vtrans->flip_h
-      && !vtrans->flip_v && vtrans->crop.w == 0 && vtrans->crop.h == 0
-      && vtrans->rotation == GST_VIDEO_TRANS_ROTATE_NONE) {
+  // Input region selected by the crop properties.
+  vtrans->region.x = MIN (vtrans->crop.x, ininfo->width - 1);
+  vtrans->region.y = MIN (vtrans->crop.y, ininfo->height - 1);
+  vtrans->region.w = (vtrans->crop.w == 0) ?
+      ininfo->width - vtrans->region.x :
+      MIN (vtrans->crop.w, ininfo->width - vtrans->region.x);
+  vtrans->region.h = (vtrans->crop.h == 0) ?
+      ininfo->height - vtrans->region.y :
+      MIN (vtrans->crop.h, ininfo->height - vtrans->region.y);
+
+  vtrans->croponly =
+      gst_video_transform_is_crop_only (vtrans, ininfo, outinfo);
+
+  if (vtrans->croponly && vtrans->region.w == ininfo->width &&
+      vtrans->region.h == ininfo->height) {
+    vtrans->croponly = FALSE;
     gst_base_transform_set_passthrough (GST_BASE_TRANSFORM (filter), TRUE);
   } else {
     GstStructure *options = gst_structure_new ("videotransform",
@@ -569,14 +1181,35 @@ gst_video_transform_set_info (GstVideoFilter * filter, GstCaps * in,
         vtrans->crop.w,
         GST_C2D_VIDEO_CONVERTER_OPT_SRC_HEIGHT, G_TYPE_INT,
         vtrans->crop.h,
+        GST_C2D_VIDEO_CONVERTER_OPT_SURFACE_CACHE_SIZE, G_TYPE_INT,
+        vtrans->cachesize,
+        GST_C2D_VIDEO_CONVERTER_OPT_DRIVER, G_TYPE_STRING,
+        video_transform_backend_to_driver (vtrans->backend),
+        GST_C2D_VIDEO_CONVERTER_OPT_SCALE_METHOD,
+        GST_TYPE_C2D_VIDEO_SCALE_METHOD, vtrans->scaling,
         NULL);
+    GstC2dVideoConverter *c2dconvert = NULL;
 
     gst_base_transform_set_passthrough (GST_BASE_TRANSFORM (filter), FALSE);
 
-    if (vtrans->c2dconvert)
-      gst_c2d_video_converter_free (vtrans->c2dconvert);
+    // The output memory would be of the input type, e.g. not GBM.
+    vtrans->croponly = vtrans->croponly && gst_caps_features_is_equal (
+        gst_caps_get_features (in, 0), gst_caps_get_features (out, 0));
 
-    vtrans->c2dconvert = gst_c2d_video_converter_new (ininfo, outinfo, options);
+    // Swapped under the object lock, the statistics are read from it.
+    GST_OBJECT_LOCK (vtrans);
+    c2dconvert = vtrans->c2dconvert;
+    vtrans->c2dconvert = NULL;
+    GST_OBJECT_UNLOCK (vtrans);
+
+    if (c2dconvert)
+      gst_c2d_video_converter_free (c2dconvert);
+
+    c2dconvert = gst_c2d_video_converter_new (ininfo, outinfo, options);
+
+    GST_OBJECT_LOCK (vtrans);
+    vtrans->c2dconvert = c2dconvert;
+    GST_OBJECT_UNLOCK (vtrans);
   }
 
   GST_DEBUG_OBJECT (vtrans, "From %dx%d (PAR: %d/%d, DAR: %d/%d), size %"
@@ -1530,6 +2163,39 @@ gst_video_transform_class_init (GstVideoTransformClass * klass)
           "Height of the crop rectangle", 0, G_MAXUINT,
           DEFAULT_PROP_CROP_HEIGHT,
           G_PARAM_CONSTRUCT | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject, PROP_PIPELINE_DEPTH,
+      g_param_spec_uint ("pipeline-depth", "Pipeline depth",
+          "Maximum number of conversions in flight, output buffers are pushed "
+          "from a separate thread as their conversion finishes. 0 converts "
+          "each frame synchronously. Applied when the element starts",
+          0, G_MAXUINT, DEFAULT_PROP_PIPELINE_DEPTH,
+          G_PARAM_CONSTRUCT | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject, PROP_SURFACE_CACHE,
+      g_param_spec_uint ("surface-cache-size", "Surface cache size",
+          "Maximum number of C2D surfaces kept for reuse across buffers, "
+          "the least recently used are destroyed first. Applied on the next "
+          "caps negotiation", 2, G_MAXINT, DEFAULT_PROP_SURFACE_CACHE,
+          G_PARAM_CONSTRUCT | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject, PROP_BACKEND,
+      g_param_spec_enum ("backend", "Backend",
+          "Implementation of the conversions, auto falls back to the CPU "
+          "when the C2D library is not available. Applied on the next caps "
+          "negotiation", GST_TYPE_VIDEO_TRANSFORM_BACKEND,
+          DEFAULT_PROP_BACKEND,
+          G_PARAM_CONSTRUCT | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject, PROP_SCALE_METHOD,
+      g_param_spec_enum ("scale-method", "Scale method",
+          "Sampling used for scaling by the CPU backend. Applied on the next "
+          "caps negotiation", GST_TYPE_C2D_VIDEO_SCALE_METHOD,
+          DEFAULT_PROP_SCALE_METHOD,
+          G_PARAM_CONSTRUCT | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Number of output buffers passed through, referencing the cropped "
+          "input and converted, surface cache statistics of the current "
+          "converter and allocation statistics of the output buffer pool",
+          GST_TYPE_STRUCTURE,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
 
   gst_element_class_set_static_metadata (element,
       "Video transformer", "Filter/Effect/Converter/Video/Scaler",
@@ -1549,6 +2215,14 @@ gst_video_transform_class_init (GstVideoTransformClass * klass)
   transform->transform_caps =
       GST_DEBUG_FUNCPTR (gst_video_transform_transform_caps);
   transform->fixate_caps = GST_DEBUG_FUNCPTR (gst_video_transform_fixate_caps);
+  transform->transform_meta =
+      GST_DEBUG_FUNCPTR (gst_video_transform_transform_meta);
+  transform->start = GST_DEBUG_FUNCPTR (gst_video_transform_start);
+  transform->stop = GST_DEBUG_FUNCPTR (gst_video_transform_stop);
+  transform->sink_event = GST_DEBUG_FUNCPTR (gst_video_transform_sink_event);
+  transform->submit_input_buffer =
+      GST_DEBUG_FUNCPTR (gst_video_transform_submit_input_buffer);
+  transform->transform = GST_DEBUG_FUNCPTR (gst_video_transform_transform);
 
   filter->set_info = GST_DEBUG_FUNCPTR (gst_video_transform_set_info);
   filter->transform_frame =
@@ -1565,6 +2239,18 @@ gst_video_transform_init (GstVideoTransform * videotransform)
   videotransform->crop.w = DEFAULT_PROP_CROP_WIDTH;
   videotransform->crop.h = DEFAULT_PROP_CROP_HEIGHT;
   videotransform->rotation = DEFAULT_PROP_ROTATE_METHOD;
+  videotransform->depth = DEFAULT_PROP_PIPELINE_DEPTH;
+  videotransform->cachesize = DEFAULT_PROP_SURFACE_CACHE;
+  videotransform->backend = DEFAULT_PROP_BACKEND;
+  videotransform->scaling = DEFAULT_PROP_SCALE_METHOD;
+
+  videotransform->worker = NULL;
+  g_mutex_init (&videotransform->lock);
+  g_cond_init (&videotransform->wakeup);
+  videotransform->requests = g_queue_new ();
+  videotransform->stopping = FALSE;
+  videotransform->flowret = GST_FLOW_OK;
+  videotransform->discont = FALSE;
 
   GST_DEBUG_CATEGORY_INIT (video_transform_debug, "videotransform", 0,
       "QTI video transform");
@@ -1574,7 +2260,9 @@ static gboolean
 plugin_init (GstPlugin * plugin)
 {
   return gst_element_register (plugin, "videotransform", GST_RANK_PRIMARY,
-          GST_TYPE_VIDEO_TRANSFORM);
+          GST_TYPE_VIDEO_TRANSFORM) &&
+      gst_element_register (plugin, "videomultitransform", GST_RANK_NONE,
+          GST_TYPE_VIDEO_MULTI_TRANSFORM);
 }
 
 GST_PLUGIN_DEFINE (
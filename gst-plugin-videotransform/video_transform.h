@@ -58,6 +58,12 @@ typedef enum {
   GST_VIDEO_TRANS_ROTATE_180,
 } GstVideoTransformRotate;
 
+typedef enum {
+  GST_VIDEO_TRANS_BACKEND_AUTO,
+  GST_VIDEO_TRANS_BACKEND_C2D,
+  GST_VIDEO_TRANS_BACKEND_CPU,
+} GstVideoTransformBackend;
+
 typedef struct _GstVideoTransform GstVideoTransform;
 typedef struct _GstVideoTransformClass GstVideoTransformClass;
 
@@ -76,6 +82,42 @@ struct _GstVideoTransform {
 
   /// Supported converters.
   GstC2dVideoConverter    *c2dconvert;
+
+  /// Maximum number of conversions in flight, 0 for synchronous conversion.
+  guint                   depth;
+
+  /// Maximum number of cached C2D surfaces.
+  guint                   cachesize;
+
+  /// Conversion implementation and its scaling method.
+  GstVideoTransformBackend backend;
+  GstC2dVideoScaleMethod  scaling;
+
+  /// Cropped input region, the output may reference it instead of a copy.
+  GstVideoRectangle       region;
+  gboolean                croponly;
+  /// Downstream handles GstVideoCropMeta and GstVideoMeta respectively.
+  gboolean                cropmeta;
+  gboolean                videometa;
+
+  /// Number of output buffers per path, protected by the object lock.
+  guint64                 npassthrough;
+  guint64                 ncropmeta;
+  guint64                 nvideometa;
+  guint64                 nconverted;
+
+  // Thread pushing the output buffers of finished conversions.
+  GThread                 *worker;
+  // Protects the fields below.
+  GMutex                  lock;
+  GCond                   wakeup;
+  // Submitted conversions, oldest first.
+  GQueue                  *requests;
+  gboolean                stopping;
+  // Last failed flow return of a push, reported to upstream.
+  GstFlowReturn           flowret;
+  // Frames were dropped since the last queued buffer.
+  gboolean                discont;
 };
 
 struct _GstVideoTransformClass {
@@ -30,14 +30,17 @@
 #include "video_transform_buffer_pool.h"
 
 #include <fcntl.h>
+#include <errno.h>
 #include <unistd.h>
 #include <sys/stat.h>
 #include <sys/ioctl.h>
+#include <sys/syscall.h>
 
 #include <gbm.h>
 #include <gbm_priv.h>
 #include <linux/ion.h>
 #include <linux/msm_ion.h>
+#include <linux/memfd.h>
 
 #define GST_IS_GBM_MEMORY_TYPE(type) \
     (type == g_quark_from_static_string (GST_VTRANS_BUFFER_POOL_TYPE_GBM))
@@ -45,26 +48,90 @@
 #define GST_IS_ION_MEMORY_TYPE(type) \
     (type == g_quark_from_static_string (GST_VTRANS_BUFFER_POOL_TYPE_ION))
 
+#define GST_IS_MEMFD_MEMORY_TYPE(type) \
+    (type == g_quark_from_static_string (GST_VTRANS_BUFFER_POOL_TYPE_MEMFD))
+
 #define DEFAULT_ION_ALIGNMENT 4096
 
+// Free memory unused for this long is returned to the device.
+#define DEFAULT_IDLE_TIMEOUT  (5 * G_TIME_SPAN_SECOND)
+
 GST_DEBUG_CATEGORY_STATIC (gst_vtrans_pool_debug);
 #define GST_CAT_DEFAULT gst_vtrans_pool_debug
 
+typedef struct _GstVTransDevice GstVTransDevice;
+typedef struct _GstVTransBlock GstVTransBlock;
+
+// Memory allocated from the device, wrapped by one buffer at a time.
+struct _GstVTransBlock
+{
+  gint           fd;
+  gsize          size;
+
+  // ION handle on the legacy ION ABI or GBM buffer object.
+  gpointer       handle;
+
+  // Layout of GBM buffer objects, they are only reused for the same one.
+  GstVideoFormat format;
+  gint           width;
+  gint           height;
+
+  // Monotonic time at which the block was put on the free list.
+  gint64         idle;
+};
+
+// Device shared by a pool and the pools replacing it on renegotiation,
+// together with the memory freed by any of them.
+struct _GstVTransDevice
+{
+  gint              refcount;
+  GQuark            memtype;
+
+  gint              devicefd;
+  struct gbm_device *gbmhandle;
+
+  // Serializes allocations and frees on the device.
+  GMutex            devlock;
+
+  // Protects the fields below.
+  GMutex            lock;
+  GCond             wakeup;
+
+  // Map of data FDs and blocks, both in use and free.
+  GHashTable        *blocks;
+  // Free blocks, most recently released first.
+  GList             *freelist;
+
+  // Pre-allocates blocks and trims the free list.
+  GThread           *worker;
+  gboolean          stopping;
+
+  // Blocks still to be pre-allocated, their layout and requesting pool.
+  guint             nprewarm;
+  GstVideoInfo      prewarm;
+  gpointer          prewarmer;
+
+  // Statistics.
+  guint64           allocations;
+  guint64           reuses;
+  guint64           prewarmed;
+  guint64           releases;
+  guint64           trimmed;
+  GstClockTime      latency;
+  GstClockTime      maxlatency;
+};
+
 struct _GstVTransBufferPoolPrivate
 {
   GstVideoInfo info;
   gboolean addmeta;
+  guint minbuffers;
 
   GstAllocator *allocator;
   GstAllocationParams params;
   GQuark memtype;
 
-  gint devicefd;
-  struct gbm_device *gbmhandle;
-
-  // Map of data FDs and ION handles on case ION memory is used OR
-  // map of data FDs and GBM buffer objects if GBM memory is used.
-  GHashTable *datamap;
+  GstVTransDevice *device;
 };
 
 #define gst_vtrans_buffer_pool_parent_class parent_class
@@ -124,140 +191,130 @@ gst_video_format_to_gbm_format (GstVideoFormat format)
   return -1;
 }
 
-static gboolean
-open_gbm_device (GstVTransBufferPool * vpool)
+// Rounds the size up to one of four classes per power of two, so that
+// memory of similar sized buffers is interchangeable.
+static gsize
+size_class (gsize size)
 {
-  GstVTransBufferPoolPrivate *priv = vpool->priv;
+  gsize step = 1;
+
+  if (size > DEFAULT_ION_ALIGNMENT * 4)
+    step = (gsize) 1 << (g_bit_storage (size - 1) - 3);
+
+  step = MAX (step, DEFAULT_ION_ALIGNMENT);
+  return ((size + step - 1) / step) * step;
+}
 
+static gboolean
+open_gbm_device (GstVTransDevice * device)
+{
   // Due to limitation in the GBM implementation we need to open /dev/ion
   // instead of /dev/dri/card0.
-  priv->devicefd = open ("/dev/ion", O_RDWR);
+  device->devicefd = open ("/dev/ion", O_RDWR);
 
-  if (priv->devicefd < 0) {
-    GST_WARNING_OBJECT (vpool, "Falling back to /dev/ion");
-    priv->devicefd = open ("/dev/ion", O_RDWR);
+  if (device->devicefd < 0) {
+    GST_WARNING ("Falling back to /dev/ion");
+    device->devicefd = open ("/dev/ion", O_RDWR);
   }
 
-  if (priv->devicefd < 0) {
-    GST_ERROR_OBJECT (vpool, "Failed to open GBM device FD!");
+  if (device->devicefd < 0) {
+    GST_ERROR ("Failed to open GBM device FD!");
     return FALSE;
   }
 
-  GST_INFO_OBJECT (vpool, "Opened GBM device FD %d", priv->devicefd);
+  GST_INFO ("Opened GBM device FD %d", device->devicefd);
 
-  priv->gbmhandle = gbm_create_device (priv->devicefd);
-  if (NULL == priv->gbmhandle) {
-    GST_ERROR_OBJECT (vpool, "Failed to create GBM handle!");
-    close (priv->devicefd);
+  device->gbmhandle = gbm_create_device (device->devicefd);
+  if (NULL == device->gbmhandle) {
+    GST_ERROR ("Failed to create GBM handle!");
+    close (device->devicefd);
+    device->devicefd = -1;
     return FALSE;
   }
 
-  priv->datamap = g_hash_table_new (NULL, NULL);
-
-  GST_INFO_OBJECT (vpool, "Created GBM handle %p", priv->gbmhandle);
+  GST_INFO ("Created GBM handle %p", device->gbmhandle);
   return TRUE;
 }
 
 static void
-close_gbm_device (GstVTransBufferPool * vpool)
+close_gbm_device (GstVTransDevice * device)
 {
-  GstVTransBufferPoolPrivate *priv = vpool->priv;
-
-  if (priv->gbmhandle != NULL) {
-    GST_INFO_OBJECT (vpool, "Closing GBM handle %p", priv->gbmhandle);
-    gbm_device_destroy (priv->gbmhandle);
+  if (device->gbmhandle != NULL) {
+    GST_INFO ("Closing GBM handle %p", device->gbmhandle);
+    gbm_device_destroy (device->gbmhandle);
   }
 
-  if (priv->devicefd >= 0) {
-    GST_INFO_OBJECT (vpool, "Closing GBM device FD %d", priv->devicefd);
-    close (priv->devicefd);
+  if (device->devicefd >= 0) {
+    GST_INFO ("Closing GBM device FD %d", device->devicefd);
+    close (device->devicefd);
   }
-
-  g_hash_table_destroy (priv->datamap);
 }
 
-static GstMemory *
-gbm_device_alloc (GstVTransBufferPool * vpool)
+static GstVTransBlock *
+gbm_device_alloc (GstVTransDevice * device, const GstVideoInfo * info)
 {
-  GstVTransBufferPoolPrivate *priv = vpool->priv;
-
+  GstVTransBlock *block = NULL;
   struct gbm_bo *bo;
-  gint gbmformat, usage, fd;
+  gint gbmformat, usage;
 
-  gbmformat = gst_video_format_to_gbm_format (GST_VIDEO_INFO_FORMAT (&priv->info));
+  gbmformat = gst_video_format_to_gbm_format (GST_VIDEO_INFO_FORMAT (info));
   g_return_val_if_fail (gbmformat >= 0, NULL);
 
   usage = GBM_BO_USE_RENDERING | GBM_BO_USE_SCANOUT;
 
-  bo = gbm_bo_create (priv->gbmhandle, GST_VIDEO_INFO_WIDTH (&priv->info),
-       GST_VIDEO_INFO_HEIGHT (&priv->info), gbmformat, usage);
+  bo = gbm_bo_create (device->gbmhandle, GST_VIDEO_INFO_WIDTH (info),
+       GST_VIDEO_INFO_HEIGHT (info), gbmformat, usage);
   if (NULL == bo) {
-    GST_ERROR_OBJECT (vpool, "Failed to allocate GBM memory!");
-    return FALSE;
+    GST_ERROR ("Failed to allocate GBM memory!");
+    return NULL;
   }
 
-  fd = gbm_bo_get_fd (bo);
+  block = g_slice_new0 (GstVTransBlock);
+  block->fd = gbm_bo_get_fd (bo);
+  block->size = GST_VIDEO_INFO_SIZE (info);
+  block->handle = bo;
+  block->format = GST_VIDEO_INFO_FORMAT (info);
+  block->width = GST_VIDEO_INFO_WIDTH (info);
+  block->height = GST_VIDEO_INFO_HEIGHT (info);
 
-  g_hash_table_insert (priv->datamap, GINT_TO_POINTER (fd), bo);
-
-  GST_DEBUG_OBJECT (vpool, "Allocated GBM memory FD %d", fd);
-
-  // Wrap the allocated FD in FD backed allocator.
-  return gst_fd_allocator_alloc (priv->allocator, fd, priv->info.size,
-      GST_FD_MEMORY_FLAG_DONT_CLOSE);
+  GST_DEBUG ("Allocated GBM memory FD %d", block->fd);
+  return block;
 }
 
 static void
-gbm_device_free (GstVTransBufferPool * vpool, gint fd)
+gbm_device_free (GstVTransDevice * device, GstVTransBlock * block)
 {
-  GstVTransBufferPoolPrivate *priv = vpool->priv;
-
-  GST_DEBUG_OBJECT (vpool, "Closing GBM memory FD %d", fd);
+  GST_DEBUG ("Closing GBM memory FD %d", block->fd);
 
-  struct gbm_bo *bo = g_hash_table_lookup (priv->datamap, GINT_TO_POINTER (fd));
-  gbm_bo_destroy (bo);
-
-  g_hash_table_remove (priv->datamap, GINT_TO_POINTER (fd));
+  gbm_bo_destroy (block->handle);
 }
 
 static gboolean
-open_ion_device (GstVTransBufferPool * vpool)
+open_ion_device (GstVTransDevice * device)
 {
-  GstVTransBufferPoolPrivate *priv = vpool->priv;
-
-  priv->devicefd = open ("/dev/ion", O_RDWR);
-  if (priv->devicefd < 0) {
-    GST_ERROR_OBJECT (vpool, "Failed to open ION device FD!");
+  device->devicefd = open ("/dev/ion", O_RDWR);
+  if (device->devicefd < 0) {
+    GST_ERROR ("Failed to open ION device FD!");
     return FALSE;
   }
 
-#ifndef TARGET_ION_ABI_VERSION
-  priv->datamap = g_hash_table_new (NULL, NULL);
-#endif
-
-  GST_INFO_OBJECT (vpool, "Opened ION device FD %d", priv->devicefd);
+  GST_INFO ("Opened ION device FD %d", device->devicefd);
   return TRUE;
 }
 
 static void
-close_ion_device (GstVTransBufferPool * vpool)
+close_ion_device (GstVTransDevice * device)
 {
-  GstVTransBufferPoolPrivate *priv = vpool->priv;
-
-  if (priv->devicefd >= 0) {
-    GST_INFO_OBJECT (vpool, "Closing ION device FD %d", priv->devicefd);
-    close (priv->devicefd);
+  if (device->devicefd >= 0) {
+    GST_INFO ("Closing ION device FD %d", device->devicefd);
+    close (device->devicefd);
   }
-
-#ifndef TARGET_ION_ABI_VERSION
-  g_hash_table_destroy (priv->datamap);
-#endif
 }
 
-static GstMemory *
-ion_device_alloc (GstVTransBufferPool * vpool)
+static GstVTransBlock *
+ion_device_alloc (GstVTransDevice * device, const GstVideoInfo * info)
 {
-  GstVTransBufferPoolPrivate *priv = vpool->priv;
+  GstVTransBlock *block = NULL;
   gint result = 0, fd = -1;
 
 #ifndef TARGET_ION_ABI_VERSION
@@ -265,63 +322,420 @@ ion_device_alloc (GstVTransBufferPool * vpool)
 #endif
   struct ion_allocation_data alloc_data;
 
-  alloc_data.len = GST_VIDEO_INFO_SIZE (&priv->info);
+  alloc_data.len = size_class (GST_VIDEO_INFO_SIZE (info));
 #ifndef TARGET_ION_ABI_VERSION
   alloc_data.align = DEFAULT_ION_ALIGNMENT;
 #endif
   alloc_data.heap_id_mask = ION_HEAP(ION_SYSTEM_HEAP_ID);
   alloc_data.flags = 0;
 
-  result = ioctl (priv->devicefd, ION_IOC_ALLOC, &alloc_data);
+  result = ioctl (device->devicefd, ION_IOC_ALLOC, &alloc_data);
   if (result != 0) {
-    GST_ERROR_OBJECT (vpool, "Failed to allocate ION memory!");
+    GST_ERROR ("Failed to allocate ION memory!");
     return NULL;
   }
 
 #ifndef TARGET_ION_ABI_VERSION
   fd_data.handle = alloc_data.handle;
 
-  result = ioctl (priv->devicefd, ION_IOC_MAP, &fd_data);
+  result = ioctl (device->devicefd, ION_IOC_MAP, &fd_data);
   if (result != 0) {
-    GST_ERROR_OBJECT (vpool, "Failed to map memory to FD!");
-    ioctl (priv->devicefd, ION_IOC_FREE, &alloc_data.handle);
+    GST_ERROR ("Failed to map memory to FD!");
+    ioctl (device->devicefd, ION_IOC_FREE, &alloc_data.handle);
     return NULL;
   }
 
   fd = fd_data.fd;
-
-  g_hash_table_insert (priv->datamap, GINT_TO_POINTER (fd),
-      GINT_TO_POINTER (alloc_data.handle));
 #else
   fd = alloc_data.fd;
 #endif
 
-  GST_DEBUG_OBJECT (vpool, "Allocated ION memory FD %d", fd);
+  block = g_slice_new0 (GstVTransBlock);
+  block->fd = fd;
+  block->size = alloc_data.len;
+#ifndef TARGET_ION_ABI_VERSION
+  block->handle = GINT_TO_POINTER (alloc_data.handle);
+#endif
 
-  // Wrap the allocated FD in FD backed allocator.
-  return gst_fd_allocator_alloc (priv->allocator, fd, priv->info.size,
-      GST_FD_MEMORY_FLAG_DONT_CLOSE);
+  GST_DEBUG ("Allocated ION memory FD %d", fd);
+  return block;
 }
 
 static void
-ion_device_free (GstVTransBufferPool * vpool, gint fd)
+ion_device_free (GstVTransDevice * device, GstVTransBlock * block)
 {
-  GstVTransBufferPoolPrivate *priv = vpool->priv;
-  
-  GST_DEBUG_OBJECT (vpool, "Closing ION memory FD %d", fd);
+  GST_DEBUG ("Closing ION memory FD %d", block->fd);
 
 #ifndef TARGET_ION_ABI_VERSION
-  ion_user_handle_t handle = GPOINTER_TO_INT (
-      g_hash_table_lookup (priv->datamap, GINT_TO_POINTER (fd)));
+  ion_user_handle_t handle = GPOINTER_TO_INT (block->handle);
 
-  if (ioctl (priv->devicefd, ION_IOC_FREE, &handle) < 0) {
-    GST_ERROR_OBJECT (vpool, "Failed to free handle for memory FD %d!", fd);
+  if (ioctl (device->devicefd, ION_IOC_FREE, &handle) < 0) {
+    GST_ERROR ("Failed to free handle for memory FD %d!", block->fd);
   }
-
-  g_hash_table_remove (priv->datamap, GINT_TO_POINTER (fd));
 #endif
-  
-  close (fd);
+
+  close (block->fd);
+}
+
+static GstVTransBlock *
+memfd_device_alloc (GstVTransDevice * device, const GstVideoInfo * info)
+{
+  GstVTransBlock *block = NULL;
+  gsize size = size_class (GST_VIDEO_INFO_SIZE (info));
+  gint fd = -1;
+
+  // Anonymous shared memory, for hosts without ION.
+  fd = syscall (SYS_memfd_create, "vtrans-buffer", MFD_CLOEXEC);
+  if (fd < 0) {
+    GST_ERROR ("Failed to create memfd, error: %s!", g_strerror (errno));
+    return NULL;
+  }
+
+  if (ftruncate (fd, size) != 0) {
+    GST_ERROR ("Failed to resize memfd to %" G_GSIZE_FORMAT " bytes, "
+        "error: %s!", size, g_strerror (errno));
+    close (fd);
+    return NULL;
+  }
+
+  block = g_slice_new0 (GstVTransBlock);
+  block->fd = fd;
+  block->size = size;
+
+  GST_DEBUG ("Allocated memfd memory FD %d", fd);
+  return block;
+}
+
+static void
+memfd_device_free (GstVTransDevice * device, GstVTransBlock * block)
+{
+  GST_DEBUG ("Closing memfd memory FD %d", block->fd);
+
+  close (block->fd);
+}
+
+static GstVTransBlock *
+device_alloc_block (GstVTransDevice * device, const GstVideoInfo * info)
+{
+  GstVTransBlock *block = NULL;
+  GstClockTime time = gst_util_get_timestamp ();
+
+  g_mutex_lock (&device->devlock);
+
+  if (GST_IS_GBM_MEMORY_TYPE (device->memtype)) {
+    block = gbm_device_alloc (device, info);
+  } else if (GST_IS_ION_MEMORY_TYPE (device->memtype)) {
+    block = ion_device_alloc (device, info);
+  } else if (GST_IS_MEMFD_MEMORY_TYPE (device->memtype)) {
+    block = memfd_device_alloc (device, info);
+  }
+
+  g_mutex_unlock (&device->devlock);
+
+  if (NULL == block)
+    return NULL;
+
+  time = GST_CLOCK_DIFF (time, gst_util_get_timestamp ());
+
+  g_mutex_lock (&device->lock);
+
+  g_hash_table_insert (device->blocks, GINT_TO_POINTER (block->fd), block);
+
+  device->allocations++;
+  device->latency += time;
+  device->maxlatency = MAX (device->maxlatency, time);
+
+  g_mutex_unlock (&device->lock);
+
+  GST_LOG ("Allocated %" G_GSIZE_FORMAT " bytes in %" GST_TIME_FORMAT,
+      block->size, GST_TIME_ARGS (time));
+  return block;
+}
+
+// The block must have been removed from the map of blocks.
+static void
+device_free_block (GstVTransDevice * device, GstVTransBlock * block)
+{
+  g_mutex_lock (&device->devlock);
+
+  if (GST_IS_GBM_MEMORY_TYPE (device->memtype)) {
+    gbm_device_free (device, block);
+  } else if (GST_IS_ION_MEMORY_TYPE (device->memtype)) {
+    ion_device_free (device, block);
+  } else if (GST_IS_MEMFD_MEMORY_TYPE (device->memtype)) {
+    memfd_device_free (device, block);
+  }
+
+  g_mutex_unlock (&device->devlock);
+
+  g_slice_free (GstVTransBlock, block);
+}
+
+// Whether a free block can back a buffer with the given layout. Memory is
+// reused for buffers down to half its size class, larger blocks are left
+// to be trimmed.
+static gboolean
+device_block_fits (GstVTransDevice * device, const GstVTransBlock * block,
+    const GstVideoInfo * info)
+{
+  if (GST_IS_GBM_MEMORY_TYPE (device->memtype))
+    return block->format == GST_VIDEO_INFO_FORMAT (info) &&
+        block->width == GST_VIDEO_INFO_WIDTH (info) &&
+        block->height == GST_VIDEO_INFO_HEIGHT (info);
+
+  return block->size >= GST_VIDEO_INFO_SIZE (info) &&
+      block->size <= size_class (GST_VIDEO_INFO_SIZE (info)) * 2;
+}
+
+// Removes the smallest fitting block from the free list. Must be called
+// with the device lock held.
+static GstVTransBlock *
+device_take_free_block (GstVTransDevice * device, const GstVideoInfo * info)
+{
+  GstVTransBlock *block = NULL;
+  GList *list = NULL, *best = NULL;
+
+  for (list = device->freelist; list != NULL; list = list->next) {
+    block = list->data;
+
+    if (!device_block_fits (device, block, info))
+      continue;
+
+    if (NULL == best ||
+        block->size < ((GstVTransBlock *) best->data)->size)
+      best = list;
+  }
+
+  if (NULL == best)
+    return NULL;
+
+  block = best->data;
+  device->freelist = g_list_delete_link (device->freelist, best);
+
+  return block;
+}
+
+static GstVTransBlock *
+device_acquire_block (GstVTransDevice * device, const GstVideoInfo * info)
+{
+  GstVTransBlock *block = NULL;
+
+  g_mutex_lock (&device->lock);
+
+  block = device_take_free_block (device, info);
+
+  if (block != NULL) {
+    device->reuses++;
+  } else if (device->nprewarm > 0 &&
+      gst_video_info_is_equal (&device->prewarm, info)) {
+    // Allocated here instead of by the worker, which is behind.
+    device->nprewarm--;
+  }
+
+  g_mutex_unlock (&device->lock);
+
+  if (NULL == block)
+    block = device_alloc_block (device, info);
+
+  return block;
+}
+
+static void
+device_release_block (GstVTransDevice * device, gint fd)
+{
+  GstVTransBlock *block = NULL;
+
+  g_mutex_lock (&device->lock);
+
+  block = g_hash_table_lookup (device->blocks, GINT_TO_POINTER (fd));
+
+  if (block != NULL) {
+    block->idle = g_get_monotonic_time ();
+    device->freelist = g_list_prepend (device->freelist, block);
+
+    // The worker trims the free list once the block turns idle.
+    g_cond_signal (&device->wakeup);
+  } else {
+    GST_ERROR ("Unknown memory FD %d!", fd);
+  }
+
+  g_mutex_unlock (&device->lock);
+}
+
+// Removes the free blocks idle since before the given time. Must be called
+// with the device lock held.
+static GList *
+device_take_idle_blocks (GstVTransDevice * device, gint64 time)
+{
+  GstVTransBlock *block = NULL;
+  GList *list = NULL, *next = NULL, *idle = NULL;
+
+  for (list = device->freelist; list != NULL; list = next) {
+    next = list->next;
+    block = list->data;
+
+    if (block->idle > time)
+      continue;
+
+    device->freelist = g_list_remove_link (device->freelist, list);
+    g_hash_table_remove (device->blocks, GINT_TO_POINTER (block->fd));
+
+    idle = g_list_concat (list, idle);
+  }
+
+  return idle;
+}
+
+static gpointer
+device_worker (gpointer userdata)
+{
+  GstVTransDevice *device = userdata;
+  GstVTransBlock *block = NULL;
+  GstVideoInfo info;
+  GList *list = NULL, *idle = NULL;
+  gint64 time, deadline;
+
+  g_mutex_lock (&device->lock);
+
+  while (!device->stopping) {
+    if (device->nprewarm > 0) {
+      device->nprewarm--;
+      info = device->prewarm;
+
+      g_mutex_unlock (&device->lock);
+      block = device_alloc_block (device, &info);
+      g_mutex_lock (&device->lock);
+
+      if (block != NULL) {
+        block->idle = g_get_monotonic_time ();
+        device->freelist = g_list_prepend (device->freelist, block);
+        device->prewarmed++;
+      } else {
+        device->nprewarm = 0;
+      }
+      continue;
+    }
+
+    time = g_get_monotonic_time ();
+    idle = device_take_idle_blocks (device, time - DEFAULT_IDLE_TIMEOUT);
+
+    if (idle != NULL) {
+      device->trimmed += g_list_length (idle);
+      device->releases += g_list_length (idle);
+
+      g_mutex_unlock (&device->lock);
+
+      for (list = idle; list != NULL; list = list->next)
+        device_free_block (device, list->data);
+
+      GST_DEBUG ("Trimmed %u idle buffers", g_list_length (idle));
+      g_list_free (idle);
+
+      g_mutex_lock (&device->lock);
+      continue;
+    }
+
+    // Sleep until the oldest free block turns idle or there is work.
+    list = g_list_last (device->freelist);
+
+    if (list != NULL) {
+      block = list->data;
+      deadline = block->idle + DEFAULT_IDLE_TIMEOUT;
+      g_cond_wait_until (&device->wakeup, &device->lock, deadline);
+    } else {
+      g_cond_wait (&device->wakeup, &device->lock);
+    }
+  }
+
+  g_mutex_unlock (&device->lock);
+  return NULL;
+}
+
+static GstVTransDevice *
+device_new (GQuark memtype)
+{
+  GstVTransDevice *device = g_slice_new0 (GstVTransDevice);
+  gboolean success = FALSE;
+
+  device->refcount = 1;
+  device->memtype = memtype;
+  device->devicefd = -1;
+
+  if (GST_IS_GBM_MEMORY_TYPE (memtype)) {
+    GST_INFO ("Using GBM memory");
+    success = open_gbm_device (device);
+  } else if (GST_IS_ION_MEMORY_TYPE (memtype)) {
+    GST_INFO ("Using ION memory");
+    success = open_ion_device (device);
+  } else if (GST_IS_MEMFD_MEMORY_TYPE (memtype)) {
+    GST_INFO ("Using memfd memory");
+    success = TRUE;
+  }
+
+  if (!success) {
+    g_slice_free (GstVTransDevice, device);
+    return NULL;
+  }
+
+  g_mutex_init (&device->devlock);
+  g_mutex_init (&device->lock);
+  g_cond_init (&device->wakeup);
+
+  device->blocks = g_hash_table_new (NULL, NULL);
+  device->worker = g_thread_new ("vtrans-pool", device_worker, device);
+
+  return device;
+}
+
+static GstVTransDevice *
+device_ref (GstVTransDevice * device)
+{
+  g_atomic_int_inc (&device->refcount);
+  return device;
+}
+
+static void
+device_unref (GstVTransDevice * device)
+{
+  GList *list = NULL;
+
+  if (!g_atomic_int_dec_and_test (&device->refcount))
+    return;
+
+  g_mutex_lock (&device->lock);
+  device->stopping = TRUE;
+  g_cond_signal (&device->wakeup);
+  g_mutex_unlock (&device->lock);
+
+  g_thread_join (device->worker);
+
+  // Buffers hold a reference to their pool, all blocks are free by now.
+  for (list = device->freelist; list != NULL; list = list->next) {
+    GstVTransBlock *block = list->data;
+
+    g_hash_table_remove (device->blocks, GINT_TO_POINTER (block->fd));
+    device_free_block (device, block);
+  }
+
+  g_list_free (device->freelist);
+
+  if (g_hash_table_size (device->blocks) != 0)
+    GST_ERROR ("Device destroyed with %u blocks in use!",
+        g_hash_table_size (device->blocks));
+
+  g_hash_table_destroy (device->blocks);
+
+  if (GST_IS_GBM_MEMORY_TYPE (device->memtype)) {
+    close_gbm_device (device);
+  } else if (GST_IS_ION_MEMORY_TYPE (device->memtype)) {
+    close_ion_device (device);
+  }
+
+  g_cond_clear (&device->wakeup);
+  g_mutex_clear (&device->lock);
+  g_mutex_clear (&device->devlock);
+
+  g_slice_free (GstVTransDevice, device);
 }
 
 static const gchar **
@@ -384,6 +798,7 @@ vtrans_buffer_pool_set_config (GstBufferPool * pool, GstStructure * config)
   priv->params = params;
   info.size = MAX (size, info.size);
   priv->info = info;
+  priv->minbuffers = minbuffers;
 
   // Remove cached allocator.
   if (priv->allocator)
@@ -402,6 +817,56 @@ vtrans_buffer_pool_set_config (GstBufferPool * pool, GstStructure * config)
   return GST_BUFFER_POOL_CLASS (parent_class)->set_config (pool, config);
 }
 
+static gboolean
+vtrans_buffer_pool_start (GstBufferPool * pool)
+{
+  GstVTransBufferPool *vpool = GST_VIDEO_TRANS_BUFFER_POOL_CAST (pool);
+  GstVTransBufferPoolPrivate *priv = vpool->priv;
+  GstVTransDevice *device = priv->device;
+  GList *list = NULL;
+  guint nfree = 0;
+
+  // Instead of allocating the minimum number of buffers here, the worker
+  // pre-allocates the memory missing from the free list. Buffers acquired
+  // before it is done are allocated on demand.
+  g_mutex_lock (&device->lock);
+
+  for (list = device->freelist; list != NULL; list = list->next)
+    nfree += device_block_fits (device, list->data, &priv->info) ? 1 : 0;
+
+  device->prewarm = priv->info;
+  device->prewarmer = vpool;
+  device->nprewarm = (priv->minbuffers > nfree) ? priv->minbuffers - nfree : 0;
+
+  if (device->nprewarm > 0)
+    g_cond_signal (&device->wakeup);
+
+  g_mutex_unlock (&device->lock);
+
+  GST_DEBUG_OBJECT (vpool, "Reusing %u free buffers, pre-allocating %u",
+      MIN (nfree, priv->minbuffers), device->nprewarm);
+  return TRUE;
+}
+
+static gboolean
+vtrans_buffer_pool_stop (GstBufferPool * pool)
+{
+  GstVTransBufferPool *vpool = GST_VIDEO_TRANS_BUFFER_POOL_CAST (pool);
+  GstVTransDevice *device = vpool->priv->device;
+
+  // Another pool sharing the device may have been started since.
+  g_mutex_lock (&device->lock);
+
+  if (device->prewarmer == vpool) {
+    device->nprewarm = 0;
+    device->prewarmer = NULL;
+  }
+
+  g_mutex_unlock (&device->lock);
+
+  return GST_BUFFER_POOL_CLASS (parent_class)->stop (pool);
+}
+
 static GstFlowReturn
 vtrans_buffer_pool_alloc (GstBufferPool * pool, GstBuffer ** buffer,
     GstBufferPoolAcquireParams * params)
@@ -409,20 +874,21 @@ vtrans_buffer_pool_alloc (GstBufferPool * pool, GstBuffer ** buffer,
   GstVTransBufferPool *vpool = GST_VIDEO_TRANS_BUFFER_POOL_CAST (pool);
   GstVTransBufferPoolPrivate *priv = vpool->priv;
   GstVideoInfo *info = &priv->info;
+  GstVTransBlock *block = NULL;
   GstMemory *memory = NULL;
   GstBuffer *newbuffer = NULL;
 
-  if (GST_IS_GBM_MEMORY_TYPE (priv->memtype)) {
-    memory = gbm_device_alloc (vpool);
-  } else if (GST_IS_ION_MEMORY_TYPE (priv->memtype)) {
-    memory = ion_device_alloc (vpool);
-  }
+  block = device_acquire_block (priv->device, info);
 
-  if (NULL == memory) {
+  if (NULL == block) {
     GST_WARNING_OBJECT (pool, "Failed to allocate memory!");
     return GST_FLOW_ERROR;
   }
 
+  // Wrap the allocated FD in FD backed allocator.
+  memory = gst_fd_allocator_alloc (priv->allocator, block->fd,
+      GST_VIDEO_INFO_SIZE (info), GST_FD_MEMORY_FLAG_DONT_CLOSE);
+
   // Create a GstBuffer.
   newbuffer = gst_buffer_new ();
 
@@ -450,11 +916,8 @@ vtrans_buffer_pool_free (GstBufferPool * pool, GstBuffer * buffer)
   GstVTransBufferPool *vpool = GST_VIDEO_TRANS_BUFFER_POOL_CAST (pool);
   gint fd = gst_fd_memory_get_fd (gst_buffer_peek_memory (buffer, 0));
 
-  if (GST_IS_GBM_MEMORY_TYPE (vpool->priv->memtype)) {
-    gbm_device_free (vpool, fd);
-  } else if (GST_IS_ION_MEMORY_TYPE (vpool->priv->memtype)) {
-    ion_device_free (vpool, fd);
-  }
+  // The memory is kept on the free list for later buffers.
+  device_release_block (vpool->priv->device, fd);
   gst_buffer_unref (buffer);
 }
 
@@ -466,15 +929,24 @@ gst_vtrans_buffer_pool_finalize (GObject * object)
 
   GST_INFO_OBJECT (vpool, "Finalize video buffer pool %p", vpool);
 
+  // Queued buffers return their memory to the device, free them first.
+  gst_buffer_pool_set_active (GST_BUFFER_POOL_CAST (vpool), FALSE);
+
   if (priv->allocator) {
     GST_INFO_OBJECT (vpool, "Free buffer pool allocator %p", priv->allocator);
     gst_object_unref (priv->allocator);
   }
 
-  if (GST_IS_GBM_MEMORY_TYPE (priv->memtype)) {
-    close_gbm_device (vpool);
-  } else if (GST_IS_ION_MEMORY_TYPE (priv->memtype)) {
-    close_ion_device (vpool);
+  if (priv->device != NULL) {
+    g_mutex_lock (&priv->device->lock);
+
+    if (priv->device->prewarmer == vpool) {
+      priv->device->nprewarm = 0;
+      priv->device->prewarmer = NULL;
+    }
+
+    g_mutex_unlock (&priv->device->lock);
+    device_unref (priv->device);
   }
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
@@ -490,6 +962,8 @@ gst_vtrans_buffer_pool_class_init (GstVTransBufferPoolClass * klass)
 
   pool->get_options = vtrans_buffer_pool_get_options;
   pool->set_config = vtrans_buffer_pool_set_config;
+  pool->start = vtrans_buffer_pool_start;
+  pool->stop = vtrans_buffer_pool_stop;
   pool->alloc_buffer = vtrans_buffer_pool_alloc;
   pool->free_buffer = vtrans_buffer_pool_free;
 
@@ -506,23 +980,29 @@ gst_vtrans_buffer_pool_init (GstVTransBufferPool * vpool)
 
 GstBufferPool *
 gst_vtrans_buffer_pool_new (const gchar * type)
+{
+  return gst_vtrans_buffer_pool_new_full (type, NULL);
+}
+
+GstBufferPool *
+gst_vtrans_buffer_pool_new_full (const gchar * type, GstBufferPool * previous)
 {
   GstVTransBufferPool *vpool;
-  gboolean success = FALSE;
+  GQuark memtype = g_quark_from_static_string (type);
 
   vpool = g_object_new (GST_TYPE_VTRANS_BUFFER_POOL, NULL);
-
-  vpool->priv->memtype = g_quark_from_static_string (type);
-
-  if (GST_IS_GBM_MEMORY_TYPE (vpool->priv->memtype)) {
-    GST_INFO_OBJECT (vpool, "Using GBM memory");
-    success = open_gbm_device (vpool);
-  } else if (GST_IS_ION_MEMORY_TYPE (vpool->priv->memtype)) {
-    GST_INFO_OBJECT (vpool, "Using ION memory");
-    success = open_ion_device (vpool);
+  vpool->priv->memtype = memtype;
+
+  if (previous != NULL && GST_IS_VIDEO_TRANS_BUFFER_POOL (previous) &&
+      GST_VIDEO_TRANS_BUFFER_POOL_CAST (previous)->priv->memtype == memtype) {
+    GST_INFO_OBJECT (vpool, "Sharing memory of pool %p", previous);
+    vpool->priv->device =
+        device_ref (GST_VIDEO_TRANS_BUFFER_POOL_CAST (previous)->priv->device);
+  } else {
+    vpool->priv->device = device_new (memtype);
   }
 
-  if (!success) {
+  if (NULL == vpool->priv->device) {
     gst_object_unref (vpool);
     return NULL;
   }
@@ -540,3 +1020,39 @@ gst_vtrans_buffer_pool_get_info (GstBufferPool * pool)
 
   return &vpool->priv->info;
 }
+
+GstStructure *
+gst_vtrans_buffer_pool_get_stats (GstBufferPool * pool)
+{
+  GstVTransBufferPool *vpool = GST_VIDEO_TRANS_BUFFER_POOL_CAST (pool);
+  GstVTransDevice *device = NULL;
+  GstStructure *stats = NULL;
+  GList *list = NULL;
+  guint64 nbytes = 0;
+
+  g_return_val_if_fail (vpool != NULL, NULL);
+
+  device = vpool->priv->device;
+  g_mutex_lock (&device->lock);
+
+  for (list = device->freelist; list != NULL; list = list->next)
+    nbytes += ((GstVTransBlock *) list->data)->size;
+
+  stats = gst_structure_new ("vtrans-buffer-pool",
+      "memory", G_TYPE_STRING, g_quark_to_string (device->memtype),
+      "allocations", G_TYPE_UINT64, device->allocations,
+      "reuses", G_TYPE_UINT64, device->reuses,
+      "prewarmed", G_TYPE_UINT64, device->prewarmed,
+      "releases", G_TYPE_UINT64, device->releases,
+      "trimmed", G_TYPE_UINT64, device->trimmed,
+      "free-buffers", G_TYPE_UINT, g_list_length (device->freelist),
+      "free-bytes", G_TYPE_UINT64, nbytes,
+      "alloc-latency-avg", G_TYPE_UINT64, (device->allocations > 0) ?
+          device->latency / device->allocations : 0,
+      "alloc-latency-max", G_TYPE_UINT64, device->maxlatency,
+      NULL);
+
+  g_mutex_unlock (&device->lock);
+
+  return stats;
+}
@@ -55,6 +55,7 @@ typedef struct _GstVTransBufferPoolPrivate GstVTransBufferPoolPrivate;
 
 #define GST_VTRANS_BUFFER_POOL_TYPE_ION "GstBufferPoolTypeIonMemory"
 #define GST_VTRANS_BUFFER_POOL_TYPE_GBM "GstBufferPoolTypeGbmMemory"
+#define GST_VTRANS_BUFFER_POOL_TYPE_MEMFD "GstBufferPoolTypeMemfdMemory"
 
 struct _GstVTransBufferPool
 {
@@ -73,6 +74,14 @@ GType gst_vtrans_buffer_pool_get_type (void);
 /// Creates a buffer pool for managing video frames.
 GstBufferPool * gst_vtrans_buffer_pool_new (const gchar * type);
 
+/// Creates a buffer pool which shares the device and the freed memory of
+/// the previous pool if it uses the same memory type, for renegotiation.
+GstBufferPool * gst_vtrans_buffer_pool_new_full (const gchar * type,
+                                                 GstBufferPool * previous);
+
+/// Retrieve allocation and reuse statistics of the pool memory.
+GstStructure * gst_vtrans_buffer_pool_get_stats (GstBufferPool * pool);
+
 /// Retrieve current set video configuration.
 const GstVideoInfo * gst_vtrans_buffer_pool_get_info (GstBufferPool * pool);
 